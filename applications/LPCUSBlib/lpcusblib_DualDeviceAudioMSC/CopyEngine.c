@@ -0,0 +1,445 @@
+/*
+ * @brief Pipelined file copy between the SD card and the USB disk
+ *
+ * @note
+ * Copyright(C) NXP Semiconductors, 2012
+ * All rights reserved.
+ *
+ * @par
+ * Software that is described herein is for illustrative purposes only
+ * which provides customers with programming information regarding the
+ * LPC products.  This software is supplied "AS IS" without any warranties of
+ * any kind, and NXP Semiconductors and its licensor disclaim any and
+ * all warranties, express or implied, including all implied warranties of
+ * merchantability, fitness for a particular purpose and non-infringement of
+ * intellectual property rights.  NXP Semiconductors assumes no responsibility
+ * or liability for the use of the software, conveys no license or rights under any
+ * patent, copyright, mask work right, or any other intellectual property rights in
+ * or to any products. NXP Semiconductors reserves the right to make changes
+ * in the software without notification. NXP Semiconductors also makes no
+ * representation or warranty that such application will be suitable for the
+ * specified use without further testing or modification.
+ *
+ * @par
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation is hereby granted, under NXP Semiconductors' and its
+ * licensor's relevant copyrights in the software, without fee, provided that it
+ * is used in conjunction with NXP Semiconductors microcontrollers.  This
+ * copyright, permission, and disclaimer notice must appear in all copies of
+ * this code.
+ */
+
+#include <string.h>
+#include "board.h"
+#include "CopyEngine.h"
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+/* The copy runs from a loop of small steps. The card reads the source by DMA on its own, started with
+   Chip_SDMMC_StartReadBlocksSG() and ended from the SDIO interrupt, while the loop writes the filled
+   buffers to the USB disk. A copy then takes about max(SD, USB) time instead of SD + USB.
+
+   The ring holds the source from Done (the oldest buffer, next to write) up to CopyReadPos. One card
+   read fills all the free buffers at once, it is cut where the file leaves a run of consecutive
+   clusters. The file system of the card is only used between two card reads: it maps the file to
+   card blocks, and the progress callback, which may use any volume, runs there too. The card volume
+   is locked while a read is in flight, and a read that does not end in time is aborted. A source
+   that is not on the card, or on the same volume as the destination, is read with f_read() a buffer
+   at a time. */
+
+#define COPY_RING_SIZE          (COPY_BUFFER_COUNT * COPY_BUFFER_SIZE)
+
+/* Most bytes of one card read, the DMA descriptors of the SD driver cover 64KB */
+#define COPY_READ_MAX           MIN(COPY_RING_SIZE, (SDIF_DMA_DESC_COUNT - 1) * MCI_DMADES1_MAXTR)
+
+static uint32_t CopyRing[COPY_RING_SIZE / sizeof(uint32_t)];	/* word aligned for DMA */
+static FSIZE_t CopyBase;						/* source offset at the start of the ring */
+static FSIZE_t CopyReadPos;						/* source offset of the next read */
+static DWORD CopyReadLen;						/* bytes of the card read in flight, 0 when none */
+static volatile bool CopyReadDone;
+static volatile uint32_t CopyReadStatus;
+static int32_t CopyReadDeadline;				/* RIT counter value the card read must end by */
+static bool CopyProgressDue;
+static uint32_t CopyLastTick;
+
+static FIL CopySrc, CopyDst;
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+/* Add the time since the last call to the job */
+static void copy_update_time(COPY_JOB_T *pJob)
+{
+	uint32_t now = Chip_RIT_GetCounter(LPC_RITIMER);
+
+	pJob->ElapsedTicks += (uint32_t) (now - CopyLastTick);
+	pJob->ElapsedMs = (DWORD) (pJob->ElapsedTicks / (SystemCoreClock / 1000));
+	CopyLastTick = now;
+}
+
+/* Ring address of a source offset held in the ring */
+static uint8_t *copy_ring_ptr(FSIZE_t Pos)
+{
+	return (uint8_t *) CopyRing + ((Pos - CopyBase) % COPY_RING_SIZE);
+}
+
+#ifdef CFG_SDCARD
+/* Completion of the card read, from the SDIO interrupt */
+static void copy_read_done(void *arg, uint32_t status)
+{
+	CopyReadStatus = status;
+	CopyReadDone = true;
+}
+
+/* Card block of the source at a block aligned offset and how many blocks of the file follow it on the
+   card, up to Max. The seek leaves the cluster of the byte before the file pointer in the file object,
+   so the pointer is put one block further. */
+static FRESULT copy_map(FSIZE_t Pos, uint32_t Max, DWORD *pBlock, uint32_t *pCount)
+{
+	FATFS *fs = CopySrc.fs;
+	DWORD clst, prev = 0, sect;
+	uint32_t count = 0, n;
+	FRESULT rc;
+
+	while ((count < Max) && (Pos < f_size(&CopySrc))) {
+		rc = f_lseek(&CopySrc, MIN(Pos + MMC_SECTOR_SIZE, f_size(&CopySrc)));
+		if (rc != FR_OK) {
+			return rc;
+		}
+		clst = CopySrc.clust;
+		if ((clst < 2) || (clst >= fs->n_fatent)) {
+			return FR_INT_ERR;
+		}
+		if (count && (clst != (prev + 1))) {
+			break;		/* the next fragment, for the next read */
+		}
+		sect = (DWORD) (Pos / MMC_SECTOR_SIZE) & (fs->csize - 1);
+		if (!count) {
+			*pBlock = fs->database + ((clst - 2) * fs->csize) + sect;
+		}
+		n = MIN(fs->csize - sect, Max - count);
+		count += n;
+		Pos += n * MMC_SECTOR_SIZE;
+		prev = clst;
+	}
+	*pCount = count;
+	return FR_OK;
+}
+
+/* Start the card read of the free part of the ring */
+static FRESULT copy_read_card(COPY_JOB_T *pJob, DWORD Len)
+{
+	IP_SDMMC_SG_T sg[2];
+	DWORD block, bytes, first;
+	uint32_t count, n = 0;
+	FRESULT rc;
+
+	rc = copy_map(CopyReadPos, (Len + MMC_SECTOR_SIZE - 1) / MMC_SECTOR_SIZE, &block, &count);
+	if (rc != FR_OK) {
+		return rc;
+	}
+	if (!count) {
+		return FR_INT_ERR;
+	}
+
+	/* whole blocks, the last one of the file may go past its end but not past its buffer */
+	bytes = count * MMC_SECTOR_SIZE;
+	first = COPY_RING_SIZE - (DWORD) ((CopyReadPos - CopyBase) % COPY_RING_SIZE);
+	sg[n].addr = MCI_BUS_ADDR(copy_ring_ptr(CopyReadPos));
+	sg[n++].size = MIN(bytes, first);
+	if (bytes > first) {
+		sg[n].addr = MCI_BUS_ADDR(CopyRing);
+		sg[n++].size = bytes - first;
+	}
+
+#if _FS_REENTRANT
+	/* FatFs calls on the card volume wait until copy_read_end() */
+	if (!ff_req_grant(CopySrc.fs->sobj)) {
+		return FR_TIMEOUT;
+	}
+#endif
+	CopyReadDone = false;
+	CopyReadStatus = 0;
+	CopyReadLen = (DWORD) MIN(bytes, pJob->Size - CopyReadPos);
+	CopyReadDeadline = (int32_t) Chip_RIT_GetCounter(LPC_RITIMER) +
+					   (int32_t) ((SystemCoreClock / 1000) * COPY_READ_TIMEOUT_MS);
+	if (!Chip_SDMMC_StartReadBlocksSG(LPC_SDMMC, sg, n, (int32_t) block, copy_read_done, NULL)) {
+		CopyReadLen = 0;
+#if _FS_REENTRANT
+		ff_rel_grant(CopySrc.fs->sobj);
+#endif
+		return FR_DISK_ERR;
+	}
+	return FR_OK;
+}
+
+/* Stop the card read in flight once its deadline has passed, safe across counter wrap */
+static void copy_read_check(COPY_JOB_T *pJob)
+{
+	if (((int32_t) Chip_RIT_GetCounter(LPC_RITIMER) - CopyReadDeadline) < 0) {
+		return;
+	}
+	if (pJob->Result == FR_OK) {
+		pJob->Result = FR_TIMEOUT;
+	}
+	/* the completion is called with an error, unless it came in meanwhile */
+	Chip_SDMMC_AbortXfer(LPC_SDMMC);
+}
+#endif /* CFG_SDCARD */
+
+/* Fill the free part of the ring, from the card in the background or else with f_read() */
+static void copy_read_start(COPY_JOB_T *pJob)
+{
+	DWORD len = (DWORD) (MIN(pJob->Done + COPY_RING_SIZE, pJob->Size) - CopyReadPos);
+	UINT br = 0;
+	FRESULT rc;
+
+#ifdef CFG_SDCARD
+	if ((CopySrc.fs->drv == COPY_CARD_DRIVE) && (CopyDst.fs != CopySrc.fs)) {
+		rc = copy_read_card(pJob, MIN(len, COPY_READ_MAX));
+		if (rc != FR_OK) {
+			pJob->Result = rc;
+		}
+		return;
+	}
+#endif
+
+	/* up to the end of the buffer of the read position */
+	len = MIN(len, COPY_BUFFER_SIZE - (DWORD) ((CopyReadPos - CopyBase) % COPY_BUFFER_SIZE));
+	rc = f_read(&CopySrc, copy_ring_ptr(CopyReadPos), (UINT) len, &br);
+	if ((rc == FR_OK) && (br < len)) {
+		rc = FR_INT_ERR;	/* the size was checked when the source was opened */
+	}
+	if (rc != FR_OK) {
+		pJob->Result = rc;
+		return;
+	}
+	CopyReadPos += br;
+}
+
+/* Take the data of a finished card read into the ring */
+static void copy_read_end(COPY_JOB_T *pJob)
+{
+	if (CopyReadStatus != 0) {
+		if (pJob->Result == FR_OK) {
+			pJob->Result = FR_DISK_ERR;
+		}
+	}
+	else {
+		CopyReadPos += CopyReadLen;
+	}
+	CopyReadLen = 0;
+#if _FS_REENTRANT
+	ff_rel_grant(CopySrc.fs->sobj);
+#endif
+}
+
+/* Wait for the card read in flight, the ring and the card are free after it */
+static void copy_read_wait(COPY_JOB_T *pJob)
+{
+	while (CopyReadLen && !CopyReadDone) {
+#ifdef CFG_SDCARD
+		copy_read_check(pJob);
+#endif
+	}
+	if (CopyReadLen) {
+		copy_read_end(pJob);
+	}
+}
+
+/* Write the oldest buffer to the destination once the ring holds all of it */
+static void copy_drain(COPY_JOB_T *pJob)
+{
+	UINT len = (UINT) MIN(COPY_BUFFER_SIZE - ((pJob->Done - CopyBase) % COPY_BUFFER_SIZE), pJob->Size - pJob->Done);
+	UINT bw = 0;
+	FRESULT rc;
+
+	if ((CopyReadPos - pJob->Done) < len) {
+		return;
+	}
+
+	rc = f_write(&CopyDst, copy_ring_ptr(pJob->Done), len, &bw);
+	pJob->Done += bw;
+	if ((rc == FR_OK) && (bw < len)) {
+		rc = FR_DENIED;		/* volume full */
+	}
+	if ((rc == FR_OK) && pJob->SyncInterval && ((pJob->Done - pJob->Synced) >= pJob->SyncInterval)) {
+		rc = f_sync(&CopyDst);
+		if (rc == FR_OK) {
+			pJob->Synced = pJob->Done;
+		}
+	}
+	if (rc != FR_OK) {
+		pJob->Result = rc;
+	}
+	else {
+		copy_update_time(pJob);
+		CopyProgressDue = true;
+	}
+}
+
+/* Open both files at the resume point of the job, the destination is cut back to what it really holds */
+static FRESULT copy_open(COPY_JOB_T *pJob)
+{
+	FRESULT rc;
+
+	rc = f_open(&CopySrc, pJob->SrcPath, FA_READ);
+	if (rc != FR_OK) {
+		return rc;
+	}
+	if (f_size(&CopySrc) < pJob->Size) {
+		/* Source is shorter than expected, copy what there is */
+		pJob->Size = f_size(&CopySrc);
+	}
+
+	rc = f_open(&CopyDst, pJob->DstPath, FA_WRITE | (pJob->Done ? FA_OPEN_ALWAYS : FA_CREATE_ALWAYS));
+	if (rc != FR_OK) {
+		f_close(&CopySrc);
+		return rc;
+	}
+
+	if (pJob->Done > f_size(&CopyDst)) {
+		pJob->Done = f_size(&CopyDst);
+	}
+	/* The card reads whole blocks, a copy resumes at the start of one */
+	pJob->Done -= pJob->Done % MMC_SECTOR_SIZE;
+	rc = f_lseek(&CopyDst, pJob->Done);
+	if (rc == FR_OK) {
+		rc = f_truncate(&CopyDst);
+	}
+	if ((rc == FR_OK) && !pJob->Done && pJob->Size) {
+		/* Reserve the whole file as one cluster run, the copy then streams to consecutive sectors with no
+		   FAT updates in between. Without a free run that long the clusters are taken as the data comes. */
+		rc = f_expand(&CopyDst, pJob->Size, 1);
+		if (rc == FR_DENIED) {
+			rc = FR_OK;
+		}
+	}
+	if (rc == FR_OK) {
+		rc = f_lseek(&CopySrc, pJob->Done);
+	}
+	pJob->Synced = pJob->Done;
+	if (rc != FR_OK) {
+		f_close(&CopyDst);
+		f_close(&CopySrc);
+	}
+	return rc;
+}
+
+/* Close both files, a failed FatFs object cannot be used again so errors always end here */
+static FRESULT copy_close(void)
+{
+	FRESULT rc = f_close(&CopyDst);
+
+	f_close(&CopySrc);
+	return rc;
+}
+
+/* Copy from the resume point until done or an error */
+static FRESULT copy_pass(COPY_JOB_T *pJob)
+{
+	FRESULT rc;
+
+	pJob->Result = copy_open(pJob);
+	if (pJob->Result != FR_OK) {
+		return pJob->Result;
+	}
+
+	CopyBase = CopyReadPos = pJob->Done;
+	CopyReadLen = 0;
+	CopyProgressDue = false;
+
+	while ((pJob->Result == FR_OK) && (pJob->Done < pJob->Size)) {
+#ifdef CFG_SDCARD
+		if (CopyReadLen && !CopyReadDone) {
+			copy_read_check(pJob);
+		}
+#endif
+		if (CopyReadLen && CopyReadDone) {
+			copy_read_end(pJob);
+		}
+		if (!CopyReadLen && (pJob->Result == FR_OK)) {
+			/* no card transfer in flight, the file systems are free to use */
+			if (CopyProgressDue && pJob->Progress) {
+				pJob->Progress(pJob);
+			}
+			CopyProgressDue = false;
+			if ((CopyReadPos < pJob->Size) && (CopyReadPos < (pJob->Done + COPY_RING_SIZE))) {
+				copy_read_start(pJob);
+			}
+		}
+		if ((pJob->Result == FR_OK) && (CopyReadPos > pJob->Done)) {
+			copy_drain(pJob);
+		}
+	}
+	copy_read_wait(pJob);
+	if (CopyProgressDue && pJob->Progress && (pJob->Result == FR_OK)) {
+		pJob->Progress(pJob);
+	}
+
+	if ((pJob->Result == FR_OK) && (f_size(&CopyDst) > pJob->Done)) {
+		/* The source was shorter than the space reserved for it */
+		pJob->Result = f_truncate(&CopyDst);
+	}
+	rc = copy_close();
+	if (rc == FR_OK) {
+		pJob->Synced = pJob->Done;
+	}
+	if (pJob->Result == FR_OK) {
+		pJob->Result = rc;
+	}
+	return pJob->Result;
+}
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Prepare a copy job */
+void CopyEngine_InitJob(COPY_JOB_T *pJob, const TCHAR *SrcPath, const TCHAR *DstPath, FSIZE_t Size,
+						COPY_PROGRESS_FUNC_T Progress)
+{
+	memset(pJob, 0, sizeof(COPY_JOB_T));
+	pJob->SrcPath = SrcPath;
+	pJob->DstPath = DstPath;
+	pJob->Size = Size;
+	pJob->Progress = Progress;
+}
+
+/* Copy a file, reading the card ahead while the USB disk is written */
+FRESULT CopyEngine_Run(COPY_JOB_T *pJob)
+{
+	uint8_t attempts = 0;
+
+	CopyLastTick = Chip_RIT_GetCounter(LPC_RITIMER);
+
+	while (copy_pass(pJob) != FR_OK) {
+		/* Reopen and continue from what reached the destination */
+		copy_update_time(pJob);
+		if ((pJob->Result == FR_NO_FILE) || (pJob->Result == FR_DENIED) || (++attempts > COPY_MAX_RETRIES)) {
+			return pJob->Result;
+		}
+		pJob->Retries++;
+		if (pJob->Progress) {
+			pJob->Progress(pJob);
+		}
+	}
+	copy_update_time(pJob);
+	return FR_OK;
+}
+
+/* Get the average copy rate of a job in KB/s */
+uint32_t CopyEngine_Throughput(const COPY_JOB_T *pJob)
+{
+	if (!pJob->ElapsedMs) {
+		return 0;
+	}
+	return (uint32_t) (((uint64_t) pJob->Done * 1000 / 1024) / pJob->ElapsedMs);
+}
@@ -0,0 +1,123 @@
+/*
+ * @brief Pipelined file copy between the SD card and the USB disk
+ *
+ * @note
+ * Copyright(C) NXP Semiconductors, 2012
+ * All rights reserved.
+ *
+ * @par
+ * Software that is described herein is for illustrative purposes only
+ * which provides customers with programming information regarding the
+ * LPC products.  This software is supplied "AS IS" without any warranties of
+ * any kind, and NXP Semiconductors and its licensor disclaim any and
+ * all warranties, express or implied, including all implied warranties of
+ * merchantability, fitness for a particular purpose and non-infringement of
+ * intellectual property rights.  NXP Semiconductors assumes no responsibility
+ * or liability for the use of the software, conveys no license or rights under any
+ * patent, copyright, mask work right, or any other intellectual property rights in
+ * or to any products. NXP Semiconductors reserves the right to make changes
+ * in the software without notification. NXP Semiconductors also makes no
+ * representation or warranty that such application will be suitable for the
+ * specified use without further testing or modification.
+ *
+ * @par
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation is hereby granted, under NXP Semiconductors' and its
+ * licensor's relevant copyrights in the software, without fee, provided that it
+ * is used in conjunction with NXP Semiconductors microcontrollers.  This
+ * copyright, permission, and disclaimer notice must appear in all copies of
+ * this code.
+ */
+
+#ifndef __COPY_ENGINE_H_
+#define __COPY_ENGINE_H_
+
+#include <stdint.h>
+#include "ff.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Size of one ring buffer, a multiple of the sector size so FatFs moves whole clusters by DMA */
+#ifndef COPY_BUFFER_SIZE
+#define COPY_BUFFER_SIZE        (8 * 1024)
+#endif
+
+/** Number of ring buffers: the SD card fills all the free ones in one read while the oldest is written to USB.
+    The ring is COPY_BUFFER_COUNT * COPY_BUFFER_SIZE of static RAM, 16KB here. */
+#ifndef COPY_BUFFER_COUNT
+#define COPY_BUFFER_COUNT       2
+#endif
+
+/** Physical drive of the SD card (FS_MMC): a source there is read by the card DMA in the background */
+#ifndef COPY_CARD_DRIVE
+#define COPY_CARD_DRIVE         1
+#endif
+
+/** Time a card read may take before the copy stops it and fails with FR_TIMEOUT, in ms */
+#ifndef COPY_READ_TIMEOUT_MS
+#define COPY_READ_TIMEOUT_MS    1000
+#endif
+
+/** Times a failed copy is reopened and resumed before it is given up */
+#ifndef COPY_MAX_RETRIES
+#define COPY_MAX_RETRIES        3
+#endif
+
+typedef struct COPY_JOB COPY_JOB_T;
+
+/** Progress callback, run after buffers reach the destination and when an error is retried. It runs while
+    no card transfer is in flight, so it may use the file systems. */
+typedef void (*COPY_PROGRESS_FUNC_T)(const COPY_JOB_T *pJob);
+
+/** One file copy. Done is the resume point: a job that failed can be passed to CopyEngine_Run() again. */
+struct COPY_JOB {
+	const TCHAR *SrcPath;			/* file to read, on the SD card */
+	const TCHAR *DstPath;			/* file to create, on the USB disk */
+	FSIZE_t Size;					/* bytes to copy */
+	FSIZE_t Done;					/* bytes committed to the destination */
+	DWORD SyncInterval;				/* flush the destination every this many bytes, 0 only when closed */
+	FSIZE_t Synced;					/* Done at the last flush, what survives the disk being pulled */
+	DWORD ElapsedMs;				/* time spent copying, over all runs */
+	uint64_t ElapsedTicks;			/* same in RIT ticks, kept by the engine */
+	uint8_t Retries;				/* errors recovered so far */
+	FRESULT Result;					/* last error, FR_OK while the copy goes well */
+	COPY_PROGRESS_FUNC_T Progress;	/* optional */
+};
+
+/**
+ * @brief	Prepare a copy job
+ * @param	pJob		: job to initialize
+ * @param	SrcPath		: source file
+ * @param	DstPath		: destination file, created or overwritten
+ * @param	Size		: number of bytes to copy
+ * @param	Progress	: progress callback, may be NULL
+ * @return	Nothing
+ */
+void CopyEngine_InitJob(COPY_JOB_T *pJob, const TCHAR *SrcPath, const TCHAR *DstPath, FSIZE_t Size,
+						COPY_PROGRESS_FUNC_T Progress);
+
+/**
+ * @brief	Copy a file, reading the card ahead while the USB disk is written
+ * @param	pJob		: job from CopyEngine_InitJob(), or a job that failed before to resume it
+ * @return	FR_OK when the whole file was copied, else the error that stopped the copy
+ * @note	The card is read with Chip_SDMMC_StartReadBlocksSG() while the job runs. The card volume is
+ *			locked during each read, so other FatFs calls on it wait for the read (or time out), but
+ *			nothing may use the card outside FatFs until the job returns. A copy resumes at the start of
+ *			a block.
+ */
+FRESULT CopyEngine_Run(COPY_JOB_T *pJob);
+
+/**
+ * @brief	Get the average copy rate of a job
+ * @param	pJob		: job to measure
+ * @return	Throughput in KB/s
+ */
+uint32_t CopyEngine_Throughput(const COPY_JOB_T *pJob);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __COPY_ENGINE_H_ */
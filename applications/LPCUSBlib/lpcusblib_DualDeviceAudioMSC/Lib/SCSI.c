@@ -85,9 +85,42 @@ static SCSI_Request_Sense_Response_t SenseData = {
 uint8_t disk_cache_a[512 * DISK_CACHE_BLOCK_COUNT]; // = (uint8_t *) DATA_RAM_START_ADDRESS;
 uint8_t disk_cache_b[512 * DISK_CACHE_BLOCK_COUNT]; // = (uint8_t *) DATA_RAM_START_ADDRESS;
 uint8_t *disk_cache_ptr;
-static uint32_t MSC_Get_Block_Count(void)
+static volatile uint32_t disk_write_status;
+static bool disk_flush_pending;
+
+#if (TOTAL_LUNS > 1)
+/* Partition of each LUN: the user area, the boot partitions and the general purpose partitions */
+static const uint8_t MSC_LUN_Part[TOTAL_LUNS] = {
+	MMC_PART_USER, MMC_PART_BOOT1, MMC_PART_BOOT2, MMC_PART_GP1, MMC_PART_GP1 + 1, MMC_PART_GP1 + 2, MMC_PART_GP1 + 3
+};
+#define MSC_LUN_PART(lun)   (MSC_LUN_Part[(lun)])
+#else
+#define MSC_LUN_PART(lun)   MMC_PART_USER
+#endif
+
+/* Blocks of a LUN, 0 when the card does not have its partition */
+static uint32_t MSC_Get_Block_Count(uint8_t LUN)
+{
+	return (uint32_t) Chip_SDMMC_GetPartBlocks(LPC_SDMMC, MSC_LUN_PART(LUN));
+}
+
+/* Writes the cache of an eMMC card after the host wrote to it, kept pending when it fails */
+static bool MSC_Flush_Cache(void)
+{
+	if (disk_flush_pending) {
+		if (Chip_SDMMC_FlushCache(LPC_SDMMC) != 0) {
+			return false;
+		}
+		disk_flush_pending = false;
+	}
+
+	return true;
+}
+
+/* Completion of a chunk written to the card, keeps the first error of the command */
+static void MSC_Write_Done(void *arg, uint32_t status)
 {
-	return (uint32_t) Chip_SDMMC_GetDeviceBlocks(LPC_SDMMC);
+	disk_write_status |= status;
 }
 
 #endif
@@ -108,6 +141,15 @@ bool SCSI_DecodeSCSICommand(USB_ClassInfo_MS_Device_t *const MSInterfaceInfo)
 {
 	bool CommandSuccess = false;
 
+#ifdef CFG_SDCARD
+	/* The cache of an eMMC card is flushed by the first command after the writes that is not a transfer: hosts
+	   seldom send SYNCHRONIZE CACHE to removable media but poll them with TEST UNIT READY */
+	if ((MSInterfaceInfo->State.CommandBlock.SCSICommandData[0] != SCSI_CMD_READ_10) &&
+		(MSInterfaceInfo->State.CommandBlock.SCSICommandData[0] != SCSI_CMD_WRITE_10)) {
+		MSC_Flush_Cache();
+	}
+#endif
+
 	/* Run the appropriate SCSI command hander function based on the passed command */
 	switch (MSInterfaceInfo->State.CommandBlock.SCSICommandData[0]) {
 	case SCSI_CMD_INQUIRY:
@@ -138,7 +180,26 @@ bool SCSI_DecodeSCSICommand(USB_ClassInfo_MS_Device_t *const MSInterfaceInfo)
 		CommandSuccess = SCSI_Command_ModeSense_6(MSInterfaceInfo);
 		break;
 
+#ifdef CFG_SDCARD
+	case SCSI_CMD_VENDOR_SDMMC_STATS:
+		CommandSuccess = SCSI_Command_SDMMC_Stats(MSInterfaceInfo);
+		break;
+
+	case SCSI_CMD_SYNCHRONIZE_CACHE_10:
+		CommandSuccess = SCSI_Command_Synchronize_Cache_10(MSInterfaceInfo);
+		break;
+#endif
+
 	case SCSI_CMD_TEST_UNIT_READY:
+#ifdef CFG_SDCARD
+		if (MSC_Get_Block_Count(MSInterfaceInfo->State.CommandBlock.LUN) == 0) {
+			/* The card does not have the partition of the LUN */
+			SCSI_SET_SENSE(SCSI_SENSE_KEY_NOT_READY,
+						   SCSI_ASENSE_MEDIUM_NOT_PRESENT,
+						   SCSI_ASENSEQ_NO_QUALIFIER);
+			break;
+		}
+#endif
 	case SCSI_CMD_PREVENT_ALLOW_MEDIUM_REMOVAL:
 	case SCSI_CMD_VERIFY_10:
 		/* These commands should just succeed, no handling required */
@@ -224,7 +285,16 @@ static bool SCSI_Command_Read_Capacity_10(USB_ClassInfo_MS_Device_t *const MSInt
 {
 	/** Under development, not working yet. */
 #ifdef CFG_SDCARD
-	uint32_t LastBlockAddressInLUN = MSC_Get_Block_Count() - 1;
+	uint32_t LastBlockAddressInLUN = MSC_Get_Block_Count(MSInterfaceInfo->State.CommandBlock.LUN) - 1;
+
+	if (LastBlockAddressInLUN == (uint32_t) -1) {
+		/* The card does not have the partition of the LUN */
+		SCSI_SET_SENSE(SCSI_SENSE_KEY_NOT_READY,
+					   SCSI_ASENSE_MEDIUM_NOT_PRESENT,
+					   SCSI_ASENSEQ_NO_QUALIFIER);
+
+		return false;
+	}
 #else
 	uint32_t LastBlockAddressInLUN = (LUN_MEDIA_BLOCKS - 1);
 #endif
@@ -300,7 +370,7 @@ static bool SCSI_Command_ReadWrite_10(USB_ClassInfo_MS_Device_t *const MSInterfa
 
 	/** Under development, not working yet. */
 #ifdef CFG_SDCARD
-	if (BlockAddress >= MSC_Get_Block_Count())
+	if (BlockAddress >= MSC_Get_Block_Count(MSInterfaceInfo->State.CommandBlock.LUN))
 #else
 	if (BlockAddress >= LUN_MEDIA_BLOCKS)
 #endif
@@ -313,13 +383,23 @@ static bool SCSI_Command_ReadWrite_10(USB_ClassInfo_MS_Device_t *const MSInterfa
 		return false;
 	}
 
-	#if (TOTAL_LUNS > 1)
+	#if (TOTAL_LUNS > 1) && !defined(CFG_SDCARD)
 	/* Adjust the given block address to the real media address based on the selected LUN */
 	BlockAddress += ((uint32_t) MSInterfaceInfo->State.CommandBlock.LUN * LUN_MEDIA_BLOCKS);
 	#endif
 
 	/** Under development, not working yet. */
 #ifdef CFG_SDCARD
+	/* The card is on the partition of the LUN for the transfer only, the other users of the card find it
+	   on its user area */
+	if (Chip_SDMMC_SetPartition(LPC_SDMMC, MSC_LUN_PART(MSInterfaceInfo->State.CommandBlock.LUN)) != 0) {
+		SCSI_SET_SENSE(SCSI_SENSE_KEY_MEDIUM_ERROR,
+					   SCSI_ASENSE_NO_ADDITIONAL_INFORMATION,
+					   SCSI_ASENSEQ_NO_QUALIFIER);
+
+		return false;
+	}
+
 	/* Determine if the packet is a READ (10) or WRITE (10) command, call appropriate function */
 	if (IsDataRead == DATA_READ) {
 		
@@ -342,10 +422,14 @@ static bool SCSI_Command_ReadWrite_10(USB_ClassInfo_MS_Device_t *const MSInterfa
 			BlockCount -= BlockChunk;
 			BlockAddress += BlockChunk;
 		}
+		Chip_SDMMC_SetPartition(LPC_SDMMC, MMC_PART_USER);
 	}
 	else {
 //		DEBUGOUT("Chip_SDMMC_WriteBlocks Addr=0x%x TotalBlocks=%d\n\r", BlockAddress, TotalBlocks);
+		/* Each chunk is written to the card from one buffer while the next one is received
+		   from the host in the other */
 		BlockCount = TotalBlocks;
+		disk_write_status = 0;
 		while(BlockCount)
 		{
 			if (disk_cache_ptr == disk_cache_a)
@@ -363,16 +447,29 @@ static bool SCSI_Command_ReadWrite_10(USB_ClassInfo_MS_Device_t *const MSInterfa
 								 0);
 			while (!Endpoint_IsOUTReceived(MSInterfaceInfo->Config.PortNumber)) {}
 				
-			/*Wait for the previous card program to finish*/
-			while (Chip_SDMMC_GetState(LPC_SDMMC) != SDMMC_TRAN_ST);
-				
-			Chip_SDMMC_WriteBlocks(LPC_SDMMC, (void *) disk_cache_ptr, BlockAddress, BlockChunk);
+			/*Wait for the previous chunk to be sent, the card programs it while the next one
+			  is received and the next write command waits for the end*/
+			while (Chip_SDMMC_XferPending(LPC_SDMMC)) {}
+
+			if (!Chip_SDMMC_StartWriteBlocks(LPC_SDMMC, (void *) disk_cache_ptr, BlockAddress, BlockChunk,
+											 MSC_Write_Done, NULL)) {
+				disk_write_status |= MCI_INT_HLE;
+			}
 			BlockCount -= BlockChunk;
 			BlockAddress += BlockChunk;
 		}
-		/*Wait for the previous card program to finish*/
-		while (Chip_SDMMC_GetState(LPC_SDMMC) != SDMMC_TRAN_ST);
-				
+		/*Wait for the last chunk to be sent, it is programmed while the next command is received*/
+		while (Chip_SDMMC_XferPending(LPC_SDMMC)) {}
+		Chip_SDMMC_SetPartition(LPC_SDMMC, MMC_PART_USER);
+		disk_flush_pending = true;
+
+		if (disk_write_status) {
+			SCSI_SET_SENSE(SCSI_SENSE_KEY_MEDIUM_ERROR,
+						   SCSI_ASENSE_NO_ADDITIONAL_INFORMATION,
+						   SCSI_ASENSEQ_NO_QUALIFIER);
+
+			return false;
+		}
 	}
 #else
 	uint32_t startaddr;
@@ -408,15 +505,93 @@ static bool SCSI_Command_ReadWrite_10(USB_ClassInfo_MS_Device_t *const MSInterfa
  */
 static bool SCSI_Command_ModeSense_6(USB_ClassInfo_MS_Device_t *const MSInterfaceInfo)
 {
-	/* Send an empty header response with the Write Protect flag status */
-	Endpoint_Write_8(MSInterfaceInfo->Config.PortNumber, 0x00);
-	Endpoint_Write_8(MSInterfaceInfo->Config.PortNumber, 0x00);
-	Endpoint_Write_8(MSInterfaceInfo->Config.PortNumber, DISK_READ_ONLY ? 0x80 : 0x00);
-	Endpoint_Write_8(MSInterfaceInfo->Config.PortNumber, 0x00);
+	uint8_t AllocationLength = MSInterfaceInfo->State.CommandBlock.SCSICommandData[4];
+	uint8_t ModeData[4 + SCSI_MODE_PAGE_CACHING_LENGTH];
+	uint8_t Length = 4;
+#ifdef CFG_SDCARD
+	uint8_t PageCode = MSInterfaceInfo->State.CommandBlock.SCSICommandData[2] & 0x3F;
+#endif
+
+	/* Header with the Write Protect flag status */
+	memset(ModeData, 0, sizeof(ModeData));
+	ModeData[2] = DISK_READ_ONLY ? 0x80 : 0x00;
+
+#ifdef CFG_SDCARD
+	/* The caching page with WCE set tells the host about the cache of an eMMC card */
+	if (((PageCode == SCSI_MODE_PAGE_CACHING) || (PageCode == SCSI_MODE_PAGE_ALL)) &&
+		(Chip_SDMMC_GetCardType(LPC_SDMMC) & CARD_TYPE_CACHE)) {
+		ModeData[Length]     = SCSI_MODE_PAGE_CACHING;
+		ModeData[Length + 1] = SCSI_MODE_PAGE_CACHING_LENGTH - 2;
+		ModeData[Length + 2] = 0x04;
+		Length += SCSI_MODE_PAGE_CACHING_LENGTH;
+	}
+#endif
+	ModeData[0] = Length - 1;
+
+	Length = MIN(Length, AllocationLength);
+	Endpoint_Write_Stream_LE(MSInterfaceInfo->Config.PortNumber, ModeData, Length, NULL);
 	Endpoint_ClearIN(MSInterfaceInfo->Config.PortNumber);
 
 	/* Update the bytes transferred counter and succeed the command */
-	MSInterfaceInfo->State.CommandBlock.DataTransferLength -= 4;
+	MSInterfaceInfo->State.CommandBlock.DataTransferLength -= Length;
+
+	return true;
+}
+
+#ifdef CFG_SDCARD
+/** Command processing for the vendor specific SD/MMC statistics command. This command returns the command counters and
+ *  latency histograms of the SD/MMC driver, and clears them when asked to.
+ */
+static bool SCSI_Command_SDMMC_Stats(USB_ClassInfo_MS_Device_t *const MSInterfaceInfo)
+{
+	static MCI_STATS_T Stats;
+	uint16_t AllocationLength = SwapEndian_16(*(uint16_t *) &MSInterfaceInfo->State.CommandBlock.SCSICommandData[7]);
+
+	/* The response is sent in whole blocks, like the data of a READ (10) */
+	if (AllocationLength != SCSI_SDMMC_STATS_LENGTH) {
+		SCSI_SET_SENSE(SCSI_SENSE_KEY_ILLEGAL_REQUEST,
+					   SCSI_ASENSE_INVALID_FIELD_IN_CDB,
+					   SCSI_ASENSEQ_NO_QUALIFIER);
+
+		return false;
+	}
+
+	Chip_SDMMC_GetStats(LPC_SDMMC, &Stats);
+	if (MSInterfaceInfo->State.CommandBlock.SCSICommandData[1] & (1 << 0)) {
+		Chip_SDMMC_ResetStats(LPC_SDMMC);
+	}
+
+	memset(disk_cache_a, 0, SCSI_SDMMC_STATS_LENGTH);
+	memcpy(disk_cache_a, &Stats, MIN(sizeof(Stats), SCSI_SDMMC_STATS_LENGTH));
+	while (!Endpoint_IsINReady(MSInterfaceInfo->Config.PortNumber)) {}
+	Endpoint_Streaming(MSInterfaceInfo->Config.PortNumber,
+					   disk_cache_a,
+					   VIRTUAL_MEMORY_BLOCK_SIZE,
+					   SCSI_SDMMC_STATS_LENGTH / VIRTUAL_MEMORY_BLOCK_SIZE,
+					   0);
+
+	/* Succeed the command and update the bytes transferred counter */
+	MSInterfaceInfo->State.CommandBlock.DataTransferLength -= SCSI_SDMMC_STATS_LENGTH;
+
+	return true;
+}
+
+/** Command processing for an issued SCSI SYNCHRONIZE CACHE (10) command. This command writes the data held in the cache of
+ *  an eMMC card to its flash, the whole card is flushed whatever the range asked for.
+ */
+static bool SCSI_Command_Synchronize_Cache_10(USB_ClassInfo_MS_Device_t *const MSInterfaceInfo)
+{
+	if (!MSC_Flush_Cache()) {
+		SCSI_SET_SENSE(SCSI_SENSE_KEY_MEDIUM_ERROR,
+					   SCSI_ASENSE_NO_ADDITIONAL_INFORMATION,
+					   SCSI_ASENSEQ_NO_QUALIFIER);
+
+		return false;
+	}
+
+	/* Succeed the command and update the bytes transferred counter */
+	MSInterfaceInfo->State.CommandBlock.DataTransferLength = 0;
 
 	return true;
 }
+#endif
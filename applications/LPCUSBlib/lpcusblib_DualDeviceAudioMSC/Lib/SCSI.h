@@ -48,6 +48,25 @@ extern "C" {
 
 #define VIRTUAL_MEMORY_BLOCK_SIZE           512
 
+/** Vendor specific SCSI command returning the statistics of the SD/MMC driver. The response is an MCI_STATS_T structure
+ *  (little endian) padded with 0x00 to SCSI_SDMMC_STATS_LENGTH bytes, the allocation length in bytes 7 and 8 of the
+ *  command must be that length. Bit 0 of byte 1 clears the statistics once they are read.
+ */
+#define SCSI_CMD_VENDOR_SDMMC_STATS         0xC0
+
+/** Length of the response to the SD/MMC statistics command, in whole blocks */
+#define SCSI_SDMMC_STATS_LENGTH             (2 * VIRTUAL_MEMORY_BLOCK_SIZE)
+
+/** SCSI Command Code for a SYNCHRONIZE CACHE (10) command. */
+#define SCSI_CMD_SYNCHRONIZE_CACHE_10       0x35
+
+/** Mode page telling the write cache state, returned by MODE SENSE (6). */
+#define SCSI_MODE_PAGE_CACHING              0x08
+#define SCSI_MODE_PAGE_CACHING_LENGTH       20
+
+/** Mode page code asking for all the pages. */
+#define SCSI_MODE_PAGE_ALL                  0x3F
+
 
 /** Macro to set the current SCSI sense data to the given key, additional sense code and additional sense qualifier. This
  *  is for convenience, as it allows for all three sense values (returned upon request to the host to give information about
@@ -142,6 +161,26 @@ static bool SCSI_Command_ReadWrite_10(USB_ClassInfo_MS_Device_t *const MSInterfa
  */
 static bool SCSI_Command_ModeSense_6(USB_ClassInfo_MS_Device_t *const MSInterfaceInfo);
 
+#ifdef CFG_SDCARD
+/** @brief	Command processing for the vendor specific SD/MMC statistics command. This command returns the command
+ *          counters and latency histograms of the SD/MMC driver, and clears them when asked to.
+ *
+ *  @param	MSInterfaceInfo :  Pointer to the Mass Storage class interface structure that the command is associated with
+ *
+ *  @return Boolean true if the command completed successfully, false otherwise.
+ */
+static bool SCSI_Command_SDMMC_Stats(USB_ClassInfo_MS_Device_t *const MSInterfaceInfo);
+
+/** @brief	Command processing for an issued SCSI SYNCHRONIZE CACHE (10) command. This command writes the data held in the
+ *          cache of an eMMC card to its flash.
+ *
+ *  @param	MSInterfaceInfo :  Pointer to the Mass Storage class interface structure that the command is associated with
+ *
+ *  @return Boolean true if the command completed successfully, false otherwise.
+ */
+static bool SCSI_Command_Synchronize_Cache_10(USB_ClassInfo_MS_Device_t *const MSInterfaceInfo);
+#endif
+
 #endif
 
 /**
@@ -208,8 +208,19 @@ extern "C" {
 /** LED mask for the library LED driver, to indicate that the USB interface is busy. */
 #define LEDMASK_USB_BUSY          LEDS_LED2
 
+/** Set to 1 to expose the boot and general purpose partitions of an eMMC card as LUNs 1 to 6, after the user area on
+ *  LUN 0. The partitions the card does not have report no medium.
+ */
+#ifndef MSC_MMC_PARTITION_LUNS
+#define MSC_MMC_PARTITION_LUNS    0
+#endif
+
 /** Total number of logical drives within the device - must be non-zero. */
+#if defined(CFG_SDCARD) && MSC_MMC_PARTITION_LUNS
+#define TOTAL_LUNS                7
+#else
 #define TOTAL_LUNS                1
+#endif
 
 /*		#define VIRTUAL_MEMORY_BYTES                (MassStorage_GetCapacity()) */
 /*		#define VIRTUAL_MEMORY_BLOCK_SIZE           512 */
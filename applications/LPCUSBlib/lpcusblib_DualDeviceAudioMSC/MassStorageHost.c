@@ -32,6 +32,8 @@
 #include "ff.h"
 #include "led.h"
 #include "sdmmc.h"
+#include "CopyEngine.h"
+#include "SyncEngine.h"
 
 /*****************************************************************************
  * Private types/enumerations/variables
@@ -52,14 +54,54 @@ USB_ClassInfo_MS_Host_t FlashDisk_MS_Interface = {
 	},
 };
 
+/** UAS interface wrapping FlashDisk_MS_Interface. Devices offering a UAS alternate setting are driven
+ *  through the tagged command queue, all others fall back to Bulk-Only Transport on FlashDisk_MS_Interface.
+ */
+USB_ClassInfo_UAS_Host_t FlashDisk_UAS_Interface = {
+	.Config = {
+		.DataINPipeNumber       = 1,
+		.DataOUTPipeNumber      = 2,
+		.CommandPipeNumber      = 3,
+		.StatusPipeNumber       = 4,
+		.PortNumber = 1,
+		.BOTInterface = &FlashDisk_MS_Interface,
+	},
+};
+
+/* Optional bring-up steps a device needs, learnt the first time it fails the fast path */
+#define MS_QUIRK_GET_MAX_LUN    (1 << 0)	/* Issue GET MAX LUN before using the device */
+#define MS_QUIRK_BOT_RESET      (1 << 1)	/* Reset the BOT interface after configuration */
+#define MS_QUIRK_REQUEST_SENSE  (1 << 2)	/* Clear pending sense data before the first command */
+#define MS_QUIRK_INQUIRY        (1 << 3)	/* Device will not become ready until INQUIRY was issued */
+#define MS_QUIRK_FULL_INIT      (MS_QUIRK_GET_MAX_LUN | MS_QUIRK_BOT_RESET | MS_QUIRK_REQUEST_SENSE | MS_QUIRK_INQUIRY)
+
+/* Number of devices remembered in the quirk cache */
+#define MS_QUIRK_CACHE_SIZE     8
+
+/* TEST UNIT READY backoff limits and overall timeout, in milliseconds */
+#define MS_READY_BACKOFF_MIN_MS 1
+#define MS_READY_BACKOFF_MAX_MS 64
+#define MS_READY_TIMEOUT_MS     5000
+
+/* Quirk cache entry, keyed by VID/PID and a hash of the serial number string */
+typedef struct {
+	uint16_t VendorID;
+	uint16_t ProductID;
+	uint32_t SerialHash;
+	uint8_t  Quirks;
+	uint8_t  InUse;
+} MS_QUIRK_ENTRY_T;
+
+static MS_QUIRK_ENTRY_T QuirkCache[MS_QUIRK_CACHE_SIZE];
+static uint8_t QuirkCacheNext;
+static MS_QUIRK_ENTRY_T *CurrentQuirk;
+
 static SCSI_Capacity_t DiskCapacity;
-static uint8_t buffer[8 * 1024];
 
 int MS_Host_DeviceEnumerated = 0;
 int FilesCopied = 0;
 
 STATIC FATFS USBfatFS, MMCfatFS;	/* File system object */
-STATIC FIL USBfileObj, MMCfileObj;	/* File object */
 
 /*****************************************************************************
  * Public types/enumerations/variables
@@ -78,6 +120,135 @@ static void die(FRESULT rc)
 #endif
 }
 
+/* Returns the RIT counter value reached after ms milliseconds */
+static int32_t ms_host_deadline(uint32_t ms)
+{
+	return (int32_t) Chip_RIT_GetCounter(LPC_RITIMER) + (int32_t) ((SystemCoreClock / 1000) * ms);
+}
+
+/* Checks whether a deadline from ms_host_deadline() has passed, safe across counter wrap */
+static bool ms_host_expired(int32_t deadline)
+{
+	return ((int32_t) Chip_RIT_GetCounter(LPC_RITIMER) - deadline) >= 0;
+}
+
+/* FNV-1a hash of the serial number string descriptor, 0 when the device has none */
+static uint32_t ms_host_serial_hash(const uint8_t corenum, uint8_t index)
+{
+	uint8_t  desc[64];
+	uint32_t hash = 0;
+	uint8_t  i;
+
+	if (!index || (USB_Host_GetDeviceStringDescriptor(corenum, index, desc, sizeof(desc)) != HOST_SENDCONTROL_Successful)) {
+		return 0;
+	}
+
+	hash = 2166136261UL;
+	for (i = 2; (i < desc[0]) && (i < sizeof(desc)); i++) {
+		hash = (hash ^ desc[i]) * 16777619UL;
+	}
+	return hash;
+}
+
+/* Find the quirk cache entry of the attached device, creating a fast path entry for a new one */
+static MS_QUIRK_ENTRY_T *ms_host_lookup_quirks(const uint8_t corenum)
+{
+	USB_Descriptor_Device_t DevDescriptor;
+	MS_QUIRK_ENTRY_T *entry;
+	uint32_t hash;
+	int i;
+
+	if (USB_Host_GetDeviceDescriptor(corenum, &DevDescriptor) != HOST_SENDCONTROL_Successful) {
+		return NULL;
+	}
+	hash = ms_host_serial_hash(corenum, DevDescriptor.SerialNumStrIndex);
+
+	for (i = 0; i < MS_QUIRK_CACHE_SIZE; i++) {
+		entry = &QuirkCache[i];
+		if (entry->InUse && (entry->VendorID == DevDescriptor.VendorID) &&
+			(entry->ProductID == DevDescriptor.ProductID) && (entry->SerialHash == hash)) {
+			return entry;
+		}
+	}
+
+	/* Not seen before, replace the oldest entry */
+	entry = &QuirkCache[QuirkCacheNext];
+	QuirkCacheNext = (QuirkCacheNext + 1) % MS_QUIRK_CACHE_SIZE;
+	entry->VendorID = DevDescriptor.VendorID;
+	entry->ProductID = DevDescriptor.ProductID;
+	entry->SerialHash = hash;
+	entry->Quirks = 0;
+	entry->InUse = 1;
+	return entry;
+}
+
+/* Runs the optional bring-up steps selected by quirks, returns 0 on failure */
+static int ms_host_optional_init(USB_ClassInfo_MS_Host_t *hDisk, uint8_t quirks)
+{
+	if (quirks & MS_QUIRK_GET_MAX_LUN) {
+		uint8_t MaxLUNIndex;
+		if (MS_Host_GetMaxLUN(hDisk, &MaxLUNIndex)) {
+			DEBUGOUT("Error retrieving max LUN index.\r\n");
+			return 0;
+		}
+		DEBUGOUT(("Total LUNs: %d - Using first LUN in device.\r\n"), (MaxLUNIndex + 1));
+	}
+
+	if (quirks & MS_QUIRK_BOT_RESET) {
+		if (MS_Host_ResetMSInterface(hDisk)) {
+			DEBUGOUT("Error resetting Mass Storage interface.\r\n");
+			return 0;
+		}
+	}
+
+	if (quirks & MS_QUIRK_REQUEST_SENSE) {
+		SCSI_Request_Sense_Response_t SenseData;
+		if (MS_Host_RequestSense(hDisk, 0, &SenseData) != 0) {
+			DEBUGOUT("Error retrieving device sense.\r\n");
+			return 0;
+		}
+	}
+
+	if (quirks & MS_QUIRK_INQUIRY) {
+		SCSI_Inquiry_Response_t InquiryData;
+		if (MS_Host_GetInquiryData(hDisk, 0, &InquiryData)) {
+			DEBUGOUT("Error retrieving device Inquiry data.\r\n");
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* Polls TEST UNIT READY with exponential backoff, returns 0 on timeout or a transport error */
+static int ms_host_wait_ready(DISK_HANDLE_T *hDisk, uint32_t tout)
+{
+	int32_t timeout = ms_host_deadline(tout);
+	uint32_t backoff = MS_READY_BACKOFF_MIN_MS;
+
+	for (;; ) {
+		uint8_t ErrorCode = UAS_Host_TestUnitReady(hDisk, 0);
+
+		if (!(ErrorCode)) {
+			return 1;
+		}
+
+		/* Check if an error other than a logical command error (device busy) received */
+		if ((ErrorCode != MS_ERROR_LOGICAL_CMD_FAILED) || ms_host_expired(timeout)) {
+			return 0;
+		}
+
+		/* Fetching the sense data clears a pending unit attention so the next poll can succeed */
+		SCSI_Request_Sense_Response_t SenseData;
+		UAS_Host_RequestSense(hDisk, 0, &SenseData);
+
+		int32_t wait = ms_host_deadline(backoff);
+		while (!ms_host_expired(wait)) {}
+		if (backoff < MS_READY_BACKOFF_MAX_MS) {
+			backoff <<= 1;
+		}
+	}
+}
+
 void MS_Host_Mount(void)
 {
 	int i;
@@ -145,7 +316,7 @@ void MS_Host_Dirlisting()
 				sprintf(buf, "   <dir>  %s\r\n", fno.fname);
 			}
 			else {
-				sprintf(buf, "   %8lu  %s\r\n", fno.fsize, fno.fname);
+				sprintf(buf, "   %8lu  %s\r\n", (unsigned long) fno.fsize, fno.fname);
 			}
 			DEBUGOUT(buf);
 		}
@@ -156,60 +327,40 @@ void MS_Host_Dirlisting()
 
 }
 
-void MS_Host_Copyfile(char *fname, int fsize)
+/* Blinks the LED while a copy makes progress and reports recovered errors */
+static void ms_host_copy_progress(const COPY_JOB_T *pJob)
+{
+	static int toggle = 0;
+
+	if (pJob->Result != FR_OK) {
+		DEBUGOUT("error %d at %lu KB, resuming...", pJob->Result, (unsigned long) (pJob->Done / 1024));
+		return;
+	}
+	Board_LED_Set(BlueLED, (toggle++ >> 3) & 1);
+}
+
+void MS_Host_Copyfile(char *fname, FSIZE_t fsize)
 {
 	FRESULT rc;		/* Result code */
-	UINT bw, br;
-	char buf[512];
-	int toggle = 0;
+	char src[64], dst[64];
+	COPY_JOB_T job;
 	
 	if (!fname || !fsize)
 		return;
 	
-	sprintf(buf, "%d:%s", FS_MMC, fname);
-	rc = f_open(&MMCfileObj, buf, FA_READ);
-	if (rc) {
-		DEBUGOUT("Unable to open %s on the MMC Disk\r\n", fname);
-		die(rc);
-	}
-	
-	sprintf(buf, "%d:%s", FS_USB, fname);
-	rc = f_open(&USBfileObj, buf, FA_WRITE | FA_CREATE_ALWAYS);
-	if (rc) {
-		DEBUGOUT("Unable to create %s on the USB Disk\r\n", fname);
-		rc = f_close(&MMCfileObj);
-		die(rc);
-	}
-
-	DEBUGOUT("Copying %s from MMC to USB  size=%d...", fname, fsize);
-	while(fsize)
-	{
-		/* Read a chunk of file */
-		rc = f_read(&MMCfileObj, buffer, sizeof buffer, &br);
-		if (rc || !br) {
-			die(rc);
-		}
-		rc = f_write(&USBfileObj, buffer, br, &bw);
-		if (rc || !bw) {
-			die(rc);
-		}
-		
-		Board_LED_Set(BlueLED, (toggle++ >> 3) & 1);
-
-		fsize -= br;
-	}
-	DEBUGOUT("done\r\n");
-	Board_LED_Set(BlueLED, LEDON);
+	sprintf(src, "%d:%s", FS_MMC, fname);
+	sprintf(dst, "%d:%s", FS_USB, fname);
+	CopyEngine_InitJob(&job, src, dst, fsize, ms_host_copy_progress);
 
-	rc = f_close(&MMCfileObj);
-	if (rc) {
-		die(rc);
-	}
-	rc = f_close(&USBfileObj);
+	DEBUGOUT("Copying %s from MMC to USB  size=%lu KB...", fname, (unsigned long) (fsize / 1024));
+	rc = CopyEngine_Run(&job);
 	if (rc) {
-		die(rc);
+		/* Leave the partial file, the next copy of the disk starts it again */
+		DEBUGOUT("failed (%d) after %lu KB\r\n", rc, (unsigned long) (job.Done / 1024));
+		return;
 	}
-
+	DEBUGOUT("done, %lu KB/s\r\n", (unsigned long) CopyEngine_Throughput(&job));
+	Board_LED_Set(BlueLED, LEDON);
 }
 
 /* Function to do the read/write to USB Disk */
@@ -249,6 +400,31 @@ void MS_Host_CopyFiles(void)
 	MS_Host_Dirlisting();
 }
 
+/* Bring the USB drive up to date with the MMC card, only new and changed files are copied */
+void MS_Host_SyncFiles(void)
+{
+	FRESULT rc;		/* Result code */
+	SYNC_JOB_T sync;
+
+	if (!MS_Host_DeviceEnumerated)
+		return;
+
+	SyncEngine_InitJob(&sync, FS_MMC, FS_USB, 0, ms_host_copy_progress);
+
+	DEBUGOUT("Syncing MMC to USB...");
+	rc = SyncEngine_Run(&sync);
+	if (rc) {
+		/* The manifest keeps the checkpoints, the next sync continues from there */
+		DEBUGOUT("failed (%d)", rc);
+	}
+	else {
+		DEBUGOUT("done");
+	}
+	DEBUGOUT(", %lu files: %lu copied (%lu resumed), %lu unchanged, %lu skipped, %lu KB\r\n",
+			 sync.Files, sync.Copied, sync.Resumed, sync.Unchanged, sync.Skipped, (unsigned long) (sync.Bytes / 1024));
+	Board_LED_Set(BlueLED, LEDON);
+}
+
 /*****************************************************************************
  * Public functions
  ****************************************************************************/
@@ -260,13 +436,13 @@ void MassStorageHostSetupHardware(void)
 {
 	SDMMCSetupHardware();
 
-	USB_Init(FlashDisk_MS_Interface.Config.PortNumber, USB_MODE_Host);
+	USB_Init(FlashDisk_UAS_Interface.Config.PortNumber, USB_MODE_Host);
 }
 
 /* HW set up function */
 void MassStorageHostShutdownHardware(void)
 {
-	USB_Disable(FlashDisk_MS_Interface.Config.PortNumber, USB_MODE_Host);
+	USB_Disable(FlashDisk_UAS_Interface.Config.PortNumber, USB_MODE_Host);
 }
 
 
@@ -284,6 +460,7 @@ void EVENT_USB_Host_DeviceAttached(const uint8_t corenum)
 void EVENT_USB_Host_DeviceUnattached(const uint8_t corenum)
 {
 	MS_Host_DeviceEnumerated = 0;
+	CurrentQuirk = NULL;
 	DEBUGOUT(("\r\nDevice Unattached on port %d\r\n"), corenum);
 	Board_LED_Set(BlueLED, LEDOFF);
 }
@@ -302,37 +479,30 @@ void EVENT_USB_Host_DeviceEnumerationComplete(const uint8_t corenum)
 		return;
 	}
 
-	FlashDisk_MS_Interface.Config.PortNumber = corenum;
-	if (MS_Host_ConfigurePipes(&FlashDisk_MS_Interface,
-							   ConfigDescriptorSize, ConfigDescriptorData) != MS_ENUMERROR_NoError) {
+	FlashDisk_UAS_Interface.Config.PortNumber = corenum;
+	if (UAS_Host_ConfigurePipes(&FlashDisk_UAS_Interface,
+								ConfigDescriptorSize, ConfigDescriptorData) != UAS_ENUMERROR_NoError) {
 		DEBUGOUT("Attached Device Not a Valid Mass Storage Device.\r\n");
 		return;
 	}
 
-	if (USB_Host_SetDeviceConfiguration(FlashDisk_MS_Interface.Config.PortNumber, 1) != HOST_SENDCONTROL_Successful) {
+	if (USB_Host_SetDeviceConfiguration(FlashDisk_UAS_Interface.Config.PortNumber, 1) != HOST_SENDCONTROL_Successful) {
 		DEBUGOUT("Error Setting Device Configuration.\r\n");
 		return;
 	}
 
-	uint8_t MaxLUNIndex;
-	if (MS_Host_GetMaxLUN(&FlashDisk_MS_Interface, &MaxLUNIndex)) {
-		DEBUGOUT("Error retrieving max LUN index.\r\n");
-		USB_Host_SetDeviceConfiguration(FlashDisk_MS_Interface.Config.PortNumber, 0);
+	if (UAS_Host_SelectAlternateSetting(&FlashDisk_UAS_Interface) != HOST_SENDCONTROL_Successful) {
+		DEBUGOUT("Error Selecting UAS Alternate Setting.\r\n");
+		USB_Host_SetDeviceConfiguration(FlashDisk_UAS_Interface.Config.PortNumber, 0);
 		return;
 	}
 
-	DEBUGOUT(("Total LUNs: %d - Using first LUN in device.\r\n"), (MaxLUNIndex + 1));
-
-	if (MS_Host_ResetMSInterface(&FlashDisk_MS_Interface)) {
-		DEBUGOUT("Error resetting Mass Storage interface.\r\n");
-		USB_Host_SetDeviceConfiguration(FlashDisk_MS_Interface.Config.PortNumber, 0);
-		return;
-	}
-
-	SCSI_Request_Sense_Response_t SenseData;
-	if (MS_Host_RequestSense(&FlashDisk_MS_Interface, 0, &SenseData) != 0) {
-		DEBUGOUT("Error retrieving device sense.\r\n");
-		USB_Host_SetDeviceConfiguration(FlashDisk_MS_Interface.Config.PortNumber, 0);
+	/* Only run the optional BOT/SCSI steps for devices that are known to need them, everything
+	   else is deferred to FSUSB_DiskAcquire() which falls back to the full sequence on failure */
+	CurrentQuirk = ms_host_lookup_quirks(FlashDisk_UAS_Interface.Config.PortNumber);
+	if (!UAS_Host_IsUAS(&FlashDisk_UAS_Interface) &&
+		!ms_host_optional_init(&FlashDisk_MS_Interface, CurrentQuirk ? CurrentQuirk->Quirks : MS_QUIRK_FULL_INIT)) {
+		USB_Host_SetDeviceConfiguration(FlashDisk_UAS_Interface.Config.PortNumber, 0);
 		return;
 	}
 
@@ -342,19 +512,13 @@ void EVENT_USB_Host_DeviceEnumerationComplete(const uint8_t corenum)
 // 		return;
 // 	}
 
-	SCSI_Inquiry_Response_t InquiryData;
-	if (MS_Host_GetInquiryData(&FlashDisk_MS_Interface, 0, &InquiryData)) {
-		DEBUGOUT("Error retrieving device Inquiry data.\r\n");
-		USB_Host_SetDeviceConfiguration(FlashDisk_MS_Interface.Config.PortNumber, 0);
-		return;
-	}
-
 	/* DEBUGOUT("Vendor \"%.8s\", Product \"%.16s\"\r\n", InquiryData.VendorID, InquiryData.ProductID); */
 	MS_Host_DeviceEnumerated = 1;
 	FilesCopied = 0;
 	Board_LED_Set(BlueLED, LEDON);
 
-	DEBUGOUT("Mass Storage Device Enumerated.\r\n");
+	DEBUGOUT(UAS_Host_IsUAS(&FlashDisk_UAS_Interface) ? "UAS Device Enumerated.\r\n" :
+			 "Mass Storage Device Enumerated.\r\n");
 }
 
 /** Event handler for the USB_HostError event. This indicates that a hardware error occurred while in host mode. */
@@ -388,14 +552,14 @@ void EVENT_USB_Host_DeviceEnumerationFailed(const uint8_t corenum,
 /* Get the disk data structure */
 DISK_HANDLE_T *FSUSB_DiskInit(void)
 {
-	return &FlashDisk_MS_Interface;
+	return &FlashDisk_UAS_Interface;
 }
 
 /* Wait for disk to be inserted */
 int FSUSB_DiskInsertWait(DISK_HANDLE_T *hDisk)
 {
 	while (USB_HostState[hDisk->Config.PortNumber] != HOST_STATE_Configured) {
-		MS_Host_USBTask(hDisk);
+		UAS_Host_USBTask(hDisk);
 		USB_USBTask(hDisk->Config.PortNumber, USB_MODE_Host);
 	}
 	return 1;
@@ -405,29 +569,27 @@ int FSUSB_DiskInsertWait(DISK_HANDLE_T *hDisk)
 int FSUSB_DiskAcquire(DISK_HANDLE_T *hDisk)
 {
 	DEBUGOUT("Waiting for ready...");
-	for (;; ) {
-		uint8_t ErrorCode = MS_Host_TestUnitReady(hDisk, 0);
-
-		if (!(ErrorCode)) {
-			break;
-		}
-
-		/* Check if an error other than a logical command error (device busy) received */
-		if (ErrorCode != MS_ERROR_LOGICAL_CMD_FAILED) {
+	if (!ms_host_wait_ready(hDisk, MS_READY_TIMEOUT_MS)) {
+		/* Fast path failed, remember the device needs the full sequence and retry once */
+		if (!CurrentQuirk || (CurrentQuirk->Quirks == MS_QUIRK_FULL_INIT) || UAS_Host_IsUAS(hDisk) ||
+			!ms_host_optional_init(hDisk->Config.BOTInterface, MS_QUIRK_FULL_INIT) ||
+			!ms_host_wait_ready(hDisk, MS_READY_TIMEOUT_MS)) {
 			DEBUGOUT("Failed\r\n");
 			USB_Host_SetDeviceConfiguration(hDisk->Config.PortNumber, 0);
 			return 0;
 		}
+		CurrentQuirk->Quirks = MS_QUIRK_FULL_INIT;
 	}
 	DEBUGOUT("Done.\r\n");
 
-	if (MS_Host_ReadDeviceCapacity(hDisk, 0, &DiskCapacity)) {
+	if (UAS_Host_ReadDeviceCapacity(hDisk, 0, &DiskCapacity)) {
 		DEBUGOUT("Error retrieving device capacity.\r\n");
 		USB_Host_SetDeviceConfiguration(hDisk->Config.PortNumber, 0);
 		return 0;
 	}
 
-	DEBUGOUT(("%lu blocks of %lu bytes.\r\n"), DiskCapacity.Blocks, DiskCapacity.BlockSize);
+	DEBUGOUT(("%lu blocks of %lu bytes.\r\n"), (unsigned long) DiskCapacity.Blocks,
+			 (unsigned long) DiskCapacity.BlockSize);
 	return 1;
 }
 
@@ -446,9 +608,9 @@ uint32_t FSUSB_DiskGetSectorSz(DISK_HANDLE_T *hDisk)
 /* Read sectors */
 int FSUSB_DiskReadSectors(DISK_HANDLE_T *hDisk, void *buff, uint32_t secStart, uint32_t numSec)
 {
-	if (MS_Host_ReadDeviceBlocks(hDisk, 0, secStart, numSec, DiskCapacity.BlockSize, buff)) {
+	if (UAS_Host_ReadDeviceBlocks(hDisk, 0, secStart, numSec, DiskCapacity.BlockSize, buff)) {
 		DEBUGOUT("Error reading device block.\r\n");
-		USB_Host_SetDeviceConfiguration(FlashDisk_MS_Interface.Config.PortNumber, 0);
+		USB_Host_SetDeviceConfiguration(hDisk->Config.PortNumber, 0);
 		return 0;
 	}
 	return 1;
@@ -457,7 +619,7 @@ int FSUSB_DiskReadSectors(DISK_HANDLE_T *hDisk, void *buff, uint32_t secStart, u
 /* Write Sectors */
 int FSUSB_DiskWriteSectors(DISK_HANDLE_T *hDisk, void *buff, uint32_t secStart, uint32_t numSec)
 {
-	if (MS_Host_WriteDeviceBlocks(hDisk, 0, secStart, numSec, DiskCapacity.BlockSize, buff)) {
+	if (UAS_Host_WriteDeviceBlocks(hDisk, 0, secStart, numSec, DiskCapacity.BlockSize, buff)) {
 		DEBUGOUT("Error writing device block.\r\n");
 		return 0;
 	}
@@ -467,8 +629,5 @@ int FSUSB_DiskWriteSectors(DISK_HANDLE_T *hDisk, void *buff, uint32_t secStart,
 /* Disk ready function */
 int FSUSB_DiskReadyWait(DISK_HANDLE_T *hDisk, int tout)
 {
-	volatile int i = tout * 100;
-	while (i--) {	/* Just delay */
-	}
-	return 1;
+	return ms_host_wait_ready(hDisk, tout);
 }
@@ -243,8 +243,10 @@ void MassStorageHostShutdownHardware(void);
 void MS_Host_Mount(void);
 void MS_Host_Unmount(void);
 void MS_Host_CopyFiles(void);
+void MS_Host_SyncFiles(void);
 
 extern USB_ClassInfo_MS_Host_t FlashDisk_MS_Interface;
+extern USB_ClassInfo_UAS_Host_t FlashDisk_UAS_Interface;
 extern int MS_Host_DeviceEnumerated;
 extern int FilesCopied;
 
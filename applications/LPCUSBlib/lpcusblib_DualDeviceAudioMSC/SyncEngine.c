@@ -0,0 +1,569 @@
+/*
+ * @brief Incremental sync of a directory tree from the SD card to the USB disk
+ *
+ * @note
+ * Copyright(C) NXP Semiconductors, 2012
+ * All rights reserved.
+ *
+ * @par
+ * Software that is described herein is for illustrative purposes only
+ * which provides customers with programming information regarding the
+ * LPC products.  This software is supplied "AS IS" without any warranties of
+ * any kind, and NXP Semiconductors and its licensor disclaim any and
+ * all warranties, express or implied, including all implied warranties of
+ * merchantability, fitness for a particular purpose and non-infringement of
+ * intellectual property rights.  NXP Semiconductors assumes no responsibility
+ * or liability for the use of the software, conveys no license or rights under any
+ * patent, copyright, mask work right, or any other intellectual property rights in
+ * or to any products. NXP Semiconductors reserves the right to make changes
+ * in the software without notification. NXP Semiconductors also makes no
+ * representation or warranty that such application will be suitable for the
+ * specified use without further testing or modification.
+ *
+ * @par
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation is hereby granted, under NXP Semiconductors' and its
+ * licensor's relevant copyrights in the software, without fee, provided that it
+ * is used in conjunction with NXP Semiconductors microcontrollers.  This
+ * copyright, permission, and disclaimer notice must appear in all copies of
+ * this code.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include "board.h"
+#include "SyncEngine.h"
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+/* A file is up to date when the destination has the size and time stamp of the source, copies set the
+   time stamp of the source on the destination once they complete. The manifest adds what the two trees
+   cannot tell: how far an interrupted copy got, and optionally a hash of the content. Its records are
+   indexed by a 16 bit path hash in RAM, so a lookup reads one record from the disk. */
+
+#define SYNC_MAGIC              0x324E5953	/* "SYN2", 64-bit sizes */
+#define SYNC_NO_RECORD          0xFFFFFFFF
+#define SYNC_HASH_SEED          2166136261UL
+
+/* Manifest header, followed by the records */
+typedef struct {
+	DWORD Magic;
+	DWORD RecordSize;
+} SYNC_HEADER_T;
+
+/* Manifest record of one file */
+typedef struct {
+	FSIZE_t Size;					/* source size */
+	FSIZE_t Done;					/* bytes safely on the destination, Size once the copy completed */
+	DWORD Hash;						/* hash of the source content, 0 when not computed */
+	WORD Date;						/* source time stamp */
+	WORD Time;
+	char Path[SYNC_PATH_MAX];		/* below the volume root, NUL padded */
+} SYNC_RECORD_T;
+
+static FIL SyncMan;
+static DWORD SyncCount;							/* records in the manifest */
+static DWORD SyncCursor;						/* record after the last one found, the walk order rarely changes */
+static bool SyncOverflow;						/* manifest holds more records than can be indexed */
+static uint16_t SyncKey[SYNC_RECORDS_MAX];		/* path hash of each record */
+static uint8_t SyncSeen[(SYNC_RECORDS_MAX + 7) / 8];	/* records whose file is still on the source */
+
+static SYNC_RECORD_T SyncRec;					/* record of the current file */
+static DWORD SyncIndex;							/* its index, SYNC_NO_RECORD when it has none */
+
+static DIR SyncDir[SYNC_DEPTH_MAX];
+static char SyncPath[SYNC_PATH_MAX];			/* current entry below the volume root */
+static char SyncSrc[SYNC_PATH_MAX + 4], SyncDst[SYNC_PATH_MAX + 4];
+#if _USE_LFN
+static char SyncLfn[_MAX_LFN + 1];
+#endif
+static uint32_t SyncBuf[SYNC_HASH_BUFFER_SIZE / sizeof(uint32_t)];	/* word aligned for DMA */
+static FIL SyncHashFile;						/* source being hashed, too large for the stack */
+
+static SYNC_JOB_T *SyncJob;
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+/* FNV-1a, continued from hash */
+static DWORD sync_hash(DWORD hash, const void *data, UINT len)
+{
+	const BYTE *p = (const BYTE *) data;
+
+	while (len--) {
+		hash ^= *p++;
+		hash *= 16777619;
+	}
+	return hash;
+}
+
+/* Index key of a path */
+static uint16_t sync_path_key(const char *path)
+{
+	DWORD hash = sync_hash(SYNC_HASH_SEED, path, strlen(path));
+
+	return (uint16_t) (hash ^ (hash >> 16));
+}
+
+/* Hash the content of a file, never 0 */
+static FRESULT sync_hash_file(const char *path, DWORD *pHash)
+{
+	DWORD hash = SYNC_HASH_SEED;
+	UINT br;
+	FRESULT rc;
+
+	rc = f_open(&SyncHashFile, path, FA_READ);
+	if (rc != FR_OK) {
+		return rc;
+	}
+	do {
+		rc = f_read(&SyncHashFile, SyncBuf, sizeof(SyncBuf), &br);
+		hash = sync_hash(hash, SyncBuf, br);
+	} while ((rc == FR_OK) && (br == sizeof(SyncBuf)));
+	f_close(&SyncHashFile);
+
+	*pHash = hash ? hash : 1;
+	return rc;
+}
+
+/* Build the source and destination paths of SyncPath */
+static void sync_make_paths(const SYNC_JOB_T *pSync)
+{
+	sprintf(SyncSrc, "%d:%s", pSync->SrcDrive, SyncPath);
+	sprintf(SyncDst, "%d:%s", pSync->DstDrive, SyncPath);
+}
+
+/* Read a manifest record */
+static FRESULT sync_read_record(DWORD idx, SYNC_RECORD_T *pRec)
+{
+	UINT br;
+	FRESULT rc;
+
+	rc = f_lseek(&SyncMan, sizeof(SYNC_HEADER_T) + (FSIZE_t) idx * sizeof(SYNC_RECORD_T));
+	if (rc == FR_OK) {
+		rc = f_read(&SyncMan, pRec, sizeof(SYNC_RECORD_T), &br);
+	}
+	if ((rc == FR_OK) && (br < sizeof(SYNC_RECORD_T))) {
+		rc = FR_INT_ERR;
+	}
+	return rc;
+}
+
+/* Write a manifest record, flushed to the disk when it has to survive the disk being pulled */
+static FRESULT sync_write_record(DWORD idx, const SYNC_RECORD_T *pRec, bool flush)
+{
+	UINT bw;
+	FRESULT rc;
+
+	rc = f_lseek(&SyncMan, sizeof(SYNC_HEADER_T) + (FSIZE_t) idx * sizeof(SYNC_RECORD_T));
+	if (rc == FR_OK) {
+		rc = f_write(&SyncMan, pRec, sizeof(SYNC_RECORD_T), &bw);
+	}
+	if ((rc == FR_OK) && (bw < sizeof(SYNC_RECORD_T))) {
+		rc = FR_DENIED;		/* volume full */
+	}
+	if ((rc == FR_OK) && flush) {
+		rc = f_sync(&SyncMan);
+	}
+	return rc;
+}
+
+/* Open the manifest of the destination and index its records, a missing or foreign one is started over */
+static FRESULT sync_open_manifest(const SYNC_JOB_T *pSync)
+{
+	SYNC_HEADER_T hdr;
+	DWORD count, i;
+	UINT br;
+	FRESULT rc;
+
+	SyncCount = SyncCursor = 0;
+	SyncOverflow = false;
+	memset(SyncSeen, 0, sizeof(SyncSeen));
+
+	sprintf(SyncDst, "%d:%s", pSync->DstDrive, SYNC_MANIFEST_NAME);
+	rc = f_open(&SyncMan, SyncDst, FA_READ | FA_WRITE | FA_OPEN_ALWAYS);
+	if (rc != FR_OK) {
+		return rc;
+	}
+
+	rc = f_read(&SyncMan, &hdr, sizeof(hdr), &br);
+	if ((rc == FR_OK) &&
+		((br < sizeof(hdr)) || (hdr.Magic != SYNC_MAGIC) || (hdr.RecordSize != sizeof(SYNC_RECORD_T)))) {
+		hdr.Magic = SYNC_MAGIC;
+		hdr.RecordSize = sizeof(SYNC_RECORD_T);
+		rc = f_lseek(&SyncMan, 0);
+		if (rc == FR_OK) {
+			rc = f_truncate(&SyncMan);
+		}
+		if (rc == FR_OK) {
+			rc = f_write(&SyncMan, &hdr, sizeof(hdr), &br);
+		}
+		if ((rc == FR_OK) && (br < sizeof(hdr))) {
+			rc = FR_DENIED;
+		}
+	}
+	else if (rc == FR_OK) {
+		/* Records follow the header, read them in one pass */
+		count = (DWORD) ((f_size(&SyncMan) - sizeof(hdr)) / sizeof(SYNC_RECORD_T));
+		if (count > SYNC_RECORDS_MAX) {
+			count = SYNC_RECORDS_MAX;
+			SyncOverflow = true;
+		}
+		for (i = 0; (rc == FR_OK) && (i < count); i++) {
+			rc = f_read(&SyncMan, &SyncRec, sizeof(SyncRec), &br);
+			SyncKey[i] = sync_path_key(SyncRec.Path);
+		}
+		SyncCount = count;
+	}
+
+	if (rc != FR_OK) {
+		f_close(&SyncMan);
+	}
+	return rc;
+}
+
+/* Drop the records of files no longer on the source and close the manifest */
+static FRESULT sync_close_manifest(bool compact)
+{
+	DWORD i, n = 0;
+	FRESULT rc = FR_OK;
+
+	if (compact && !SyncOverflow) {
+		for (i = 0; (rc == FR_OK) && (i < SyncCount); i++) {
+			if (!(SyncSeen[i >> 3] & (1 << (i & 7)))) {
+				continue;
+			}
+			if (i != n) {
+				rc = sync_read_record(i, &SyncRec);
+				if (rc == FR_OK) {
+					rc = sync_write_record(n, &SyncRec, false);
+				}
+			}
+			n++;
+		}
+		if ((rc == FR_OK) && (n < SyncCount)) {
+			rc = f_lseek(&SyncMan, sizeof(SYNC_HEADER_T) + (FSIZE_t) n * sizeof(SYNC_RECORD_T));
+			if (rc == FR_OK) {
+				rc = f_truncate(&SyncMan);
+			}
+		}
+	}
+
+	if (rc == FR_OK) {
+		rc = f_close(&SyncMan);
+	}
+	else {
+		f_close(&SyncMan);
+	}
+	return rc;
+}
+
+/* Find the record of SyncPath and load it into SyncRec, looking from the cursor first */
+static FRESULT sync_find_record(uint16_t key, DWORD *pIdx)
+{
+	DWORD i = SyncCursor, n;
+	FRESULT rc;
+
+	for (n = 0; n < SyncCount; n++, i++) {
+		if (i >= SyncCount) {
+			i = 0;
+		}
+		if (SyncKey[i] != key) {
+			continue;
+		}
+		rc = sync_read_record(i, &SyncRec);
+		if (rc != FR_OK) {
+			return rc;
+		}
+		if (!strncmp(SyncRec.Path, SyncPath, SYNC_PATH_MAX)) {
+			SyncSeen[i >> 3] |= 1 << (i & 7);
+			SyncCursor = i + 1;
+			*pIdx = i;
+			return FR_OK;
+		}
+	}
+	*pIdx = SYNC_NO_RECORD;
+	return FR_OK;
+}
+
+/* Fill SyncRec for the current file */
+static void sync_set_record(const FILINFO *pInfo, FSIZE_t done, DWORD hash)
+{
+	SyncRec.Size = pInfo->fsize;
+	SyncRec.Done = done;
+	SyncRec.Hash = hash;
+	SyncRec.Date = pInfo->fdate;
+	SyncRec.Time = pInfo->ftime;
+	strncpy(SyncRec.Path, SyncPath, SYNC_PATH_MAX);
+}
+
+/* Keep the manifest record up with what the copy has flushed to the destination */
+static void sync_copy_progress(const COPY_JOB_T *pJob)
+{
+	if ((SyncIndex != SYNC_NO_RECORD) && (pJob->Synced != SyncRec.Done)) {
+		SyncRec.Done = pJob->Synced;
+		/* A failed update leaves an older checkpoint, the copy only resumes from further back */
+		sync_write_record(SyncIndex, &SyncRec, true);
+	}
+	if (SyncJob->Progress) {
+		SyncJob->Progress(pJob);
+	}
+}
+
+/* Bring one file up to date, SyncPath names it */
+static FRESULT sync_file(SYNC_JOB_T *pSync, const FILINFO *pInfo)
+{
+	COPY_JOB_T job;
+	FILINFO dst;
+	DWORD idx, hash = 0;
+	FSIZE_t done = 0;
+	uint16_t key = sync_path_key(SyncPath);
+	bool have, complete, stamped;
+	FRESULT rc;
+
+	sync_make_paths(pSync);
+
+	rc = sync_find_record(key, &idx);
+	if (rc != FR_OK) {
+		return rc;
+	}
+	complete = (idx == SYNC_NO_RECORD) || (SyncRec.Done >= SyncRec.Size);
+	stamped = (idx != SYNC_NO_RECORD) && (SyncRec.Size == pInfo->fsize) &&
+			  (SyncRec.Date == pInfo->fdate) && (SyncRec.Time == pInfo->ftime);
+
+#if _USE_LFN
+	dst.lfname = NULL;
+	dst.lfsize = 0;
+#endif
+	rc = f_stat(SyncDst, &dst);
+	if ((rc == FR_NO_FILE) || (rc == FR_NO_PATH)) {
+		have = false;
+	}
+	else if (rc != FR_OK) {
+		return rc;
+	}
+	else if (dst.fattrib & AM_DIR) {
+		/* A directory of that name is in the way */
+		pSync->Skipped++;
+		return FR_OK;
+	}
+	else {
+		have = true;
+	}
+
+	if (have && complete && (dst.fsize == pInfo->fsize) && (dst.fdate == pInfo->fdate) && (dst.ftime == pInfo->ftime)) {
+		pSync->Unchanged++;
+		if (stamped && (SyncRec.Hash || !(pSync->Flags & SYNC_HASH))) {
+			return FR_OK;
+		}
+		/* Copied before the manifest knew it, the source was put back as it was, or the hash is missing */
+		if (pSync->Flags & SYNC_HASH) {
+			rc = sync_hash_file(SyncSrc, &hash);
+			if (rc != FR_OK) {
+				return rc;
+			}
+		}
+		if (idx == SYNC_NO_RECORD) {
+			if (SyncCount >= SYNC_RECORDS_MAX) {
+				return FR_OK;
+			}
+			idx = SyncCount++;
+			SyncKey[idx] = key;
+			SyncSeen[idx >> 3] |= 1 << (idx & 7);
+		}
+		sync_set_record(pInfo, pInfo->fsize, hash);
+		return sync_write_record(idx, &SyncRec, false);
+	}
+
+	if (pSync->Flags & SYNC_HASH) {
+		rc = sync_hash_file(SyncSrc, &hash);
+		if (rc != FR_OK) {
+			return rc;
+		}
+		if (have && complete && (idx != SYNC_NO_RECORD) && (SyncRec.Hash == hash) &&
+			(SyncRec.Size == pInfo->fsize) && (dst.fsize == pInfo->fsize)) {
+			/* Same content, only the time stamp moved */
+			rc = f_utime(SyncDst, pInfo);
+			if (rc == FR_OK) {
+				pSync->Unchanged++;
+				sync_set_record(pInfo, pInfo->fsize, hash);
+				rc = sync_write_record(idx, &SyncRec, false);
+			}
+			return rc;
+		}
+	}
+
+	/* Continue an interrupted copy of the same source from its last checkpoint */
+	if (have && !complete && stamped && (!hash || !SyncRec.Hash || (SyncRec.Hash == hash))) {
+		done = MIN(SyncRec.Done, dst.fsize);
+	}
+
+	if ((idx == SYNC_NO_RECORD) && (SyncCount < SYNC_RECORDS_MAX)) {
+		idx = SyncCount++;
+		SyncKey[idx] = key;
+		SyncSeen[idx >> 3] |= 1 << (idx & 7);
+	}
+	SyncIndex = idx;
+	sync_set_record(pInfo, done, hash);
+	if (idx != SYNC_NO_RECORD) {
+		rc = sync_write_record(idx, &SyncRec, true);
+		if (rc != FR_OK) {
+			return rc;
+		}
+	}
+
+	CopyEngine_InitJob(&job, SyncSrc, SyncDst, pInfo->fsize, sync_copy_progress);
+	job.Done = done;
+	job.SyncInterval = SYNC_CHECKPOINT_SIZE;
+	rc = CopyEngine_Run(&job);
+	if (job.Done > done) {
+		pSync->Bytes += job.Done - done;
+	}
+	if (rc == FR_OK) {
+		/* The time stamp of the source marks the copy complete for the next run */
+		rc = f_utime(SyncDst, pInfo);
+	}
+	if (rc == FR_OK) {
+		pSync->Copied++;
+		if (done) {
+			pSync->Resumed++;
+		}
+		SyncRec.Done = SyncRec.Size;
+	}
+	else {
+		SyncRec.Done = job.Synced;
+	}
+	if (idx != SYNC_NO_RECORD) {
+		FRESULT rc2 = sync_write_record(idx, &SyncRec, true);
+		if (rc == FR_OK) {
+			rc = rc2;
+		}
+	}
+	SyncIndex = SYNC_NO_RECORD;
+	return rc;
+}
+
+/* Open the source directory named by SyncPath, creating it on the destination */
+static FRESULT sync_open_dir(const SYNC_JOB_T *pSync, DIR *pDir)
+{
+	FRESULT rc;
+
+	sync_make_paths(pSync);
+	if (SyncPath[0]) {
+		rc = f_mkdir(SyncDst);
+		if ((rc != FR_OK) && (rc != FR_EXIST)) {
+			return rc;
+		}
+	}
+	return f_opendir(pDir, SyncSrc);
+}
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Prepare a sync run */
+void SyncEngine_InitJob(SYNC_JOB_T *pSync, BYTE SrcDrive, BYTE DstDrive, uint8_t Flags,
+						COPY_PROGRESS_FUNC_T Progress)
+{
+	memset(pSync, 0, sizeof(SYNC_JOB_T));
+	pSync->SrcDrive = SrcDrive;
+	pSync->DstDrive = DstDrive;
+	pSync->Flags = Flags;
+	pSync->Progress = Progress;
+}
+
+/* Bring the destination up to date with the source */
+FRESULT SyncEngine_Run(SYNC_JOB_T *pSync)
+{
+	FILINFO fno;
+	const char *name;
+	int depth = 0;
+	UINT len;
+	char *p;
+	FRESULT rc;
+
+	rc = sync_open_manifest(pSync);
+	if (rc != FR_OK) {
+		pSync->Result = rc;
+		return rc;
+	}
+	SyncJob = pSync;
+	SyncIndex = SYNC_NO_RECORD;
+
+	/* Walk the source depth first, one DIR per level */
+	SyncPath[0] = '\0';
+	rc = sync_open_dir(pSync, &SyncDir[0]);
+	while ((rc == FR_OK) && (depth >= 0)) {
+#if _USE_LFN
+		fno.lfname = SyncLfn;
+		fno.lfsize = sizeof(SyncLfn);
+#endif
+		rc = f_readdir(&SyncDir[depth], &fno);
+		if (rc != FR_OK) {
+			break;
+		}
+		if (!fno.fname[0]) {
+			/* End of the directory, back to the parent */
+			p = strrchr(SyncPath, '/');
+			if (p) {
+				*p = '\0';
+			}
+			depth--;
+			continue;
+		}
+		if (fno.fname[0] == '.') {
+			continue;
+		}
+#if _USE_LFN
+		name = *fno.lfname ? fno.lfname : fno.fname;
+#else
+		name = fno.fname;
+#endif
+
+		len = strlen(SyncPath);
+		if ((len + 1 + strlen(name) >= SYNC_PATH_MAX) || ((fno.fattrib & AM_DIR) && (depth + 1 >= SYNC_DEPTH_MAX))) {
+			pSync->Skipped++;
+			continue;
+		}
+		SyncPath[len] = '/';
+		strcpy(&SyncPath[len + 1], name);
+
+		if (fno.fattrib & AM_DIR) {
+			rc = sync_open_dir(pSync, &SyncDir[depth + 1]);
+			depth++;
+		}
+		else if (!strcmp(SyncPath, SYNC_MANIFEST_NAME)) {
+			/* Would overwrite the manifest in use */
+			pSync->Skipped++;
+			SyncPath[len] = '\0';
+		}
+		else {
+			pSync->Files++;
+			rc = sync_file(pSync, &fno);
+			if ((rc == FR_NO_PATH) || (rc == FR_INVALID_NAME)) {
+				/* The destination cannot take this name, carry on with the others */
+				pSync->Skipped++;
+				rc = FR_OK;
+			}
+			SyncPath[len] = '\0';
+		}
+	}
+
+	SyncJob = NULL;
+	if (rc == FR_OK) {
+		rc = sync_close_manifest(true);
+	}
+	else {
+		sync_close_manifest(false);
+	}
+	pSync->Result = rc;
+	return rc;
+}
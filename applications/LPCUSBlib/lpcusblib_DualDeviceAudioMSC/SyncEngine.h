@@ -0,0 +1,116 @@
+/*
+ * @brief Incremental sync of a directory tree from the SD card to the USB disk
+ *
+ * @note
+ * Copyright(C) NXP Semiconductors, 2012
+ * All rights reserved.
+ *
+ * @par
+ * Software that is described herein is for illustrative purposes only
+ * which provides customers with programming information regarding the
+ * LPC products.  This software is supplied "AS IS" without any warranties of
+ * any kind, and NXP Semiconductors and its licensor disclaim any and
+ * all warranties, express or implied, including all implied warranties of
+ * merchantability, fitness for a particular purpose and non-infringement of
+ * intellectual property rights.  NXP Semiconductors assumes no responsibility
+ * or liability for the use of the software, conveys no license or rights under any
+ * patent, copyright, mask work right, or any other intellectual property rights in
+ * or to any products. NXP Semiconductors reserves the right to make changes
+ * in the software without notification. NXP Semiconductors also makes no
+ * representation or warranty that such application will be suitable for the
+ * specified use without further testing or modification.
+ *
+ * @par
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation is hereby granted, under NXP Semiconductors' and its
+ * licensor's relevant copyrights in the software, without fee, provided that it
+ * is used in conjunction with NXP Semiconductors microcontrollers.  This
+ * copyright, permission, and disclaimer notice must appear in all copies of
+ * this code.
+ */
+
+#ifndef __SYNC_ENGINE_H_
+#define __SYNC_ENGINE_H_
+
+#include <stdint.h>
+#include "ff.h"
+#include "CopyEngine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Manifest kept in the root of the destination, one record per file the sync has seen */
+#ifndef SYNC_MANIFEST_NAME
+#define SYNC_MANIFEST_NAME      "/SYNC.MAN"
+#endif
+
+/** Longest path below the volume root, longer entries are left out */
+#ifndef SYNC_PATH_MAX
+#define SYNC_PATH_MAX           96
+#endif
+
+/** Deepest directory level walked, deeper directories are left out */
+#ifndef SYNC_DEPTH_MAX
+#define SYNC_DEPTH_MAX          8
+#endif
+
+/** Records indexed in RAM, files beyond are still copied but cannot be resumed */
+#ifndef SYNC_RECORDS_MAX
+#define SYNC_RECORDS_MAX        2048
+#endif
+
+/** Bytes of a file copied between two updates of its manifest record */
+#ifndef SYNC_CHECKPOINT_SIZE
+#define SYNC_CHECKPOINT_SIZE    (1024 * 1024)
+#endif
+
+/** Buffer used to hash the source when SYNC_HASH is set */
+#ifndef SYNC_HASH_BUFFER_SIZE
+#define SYNC_HASH_BUFFER_SIZE   (4 * 1024)
+#endif
+
+/** Sync flags */
+#define SYNC_HASH               (1 << 0)	/* Hash the content, files only re-stamped on the source are not copied */
+
+/** One sync run. The counters cover files only, directories are created as they are met. */
+typedef struct {
+	BYTE SrcDrive;					/* volume to read, the SD card */
+	BYTE DstDrive;					/* volume to update, the USB disk */
+	uint8_t Flags;					/* SYNC_xxx */
+	DWORD Files;					/* files found on the source */
+	DWORD Copied;					/* files copied, resumed ones included */
+	DWORD Resumed;					/* files continued from an interrupted run */
+	DWORD Unchanged;				/* files already up to date */
+	DWORD Skipped;					/* files left out: path too long or too deep */
+	FSIZE_t Bytes;					/* bytes written to the destination */
+	FRESULT Result;					/* error that stopped the run, FR_OK otherwise */
+	COPY_PROGRESS_FUNC_T Progress;	/* optional, passed to each copy */
+} SYNC_JOB_T;
+
+/**
+ * @brief	Prepare a sync run
+ * @param	pSync		: run to initialize
+ * @param	SrcDrive	: source volume number
+ * @param	DstDrive	: destination volume number
+ * @param	Flags		: SYNC_xxx flags
+ * @param	Progress	: copy progress callback, may be NULL
+ * @return	Nothing
+ */
+void SyncEngine_InitJob(SYNC_JOB_T *pSync, BYTE SrcDrive, BYTE DstDrive, uint8_t Flags,
+						COPY_PROGRESS_FUNC_T Progress);
+
+/**
+ * @brief	Bring the destination up to date with the source
+ * @param	pSync		: run from SyncEngine_InitJob()
+ * @return	FR_OK when every file was checked, else the error that stopped the run
+ * @note	A file is copied when it is new, or when its size or time stamp differs on the destination. An
+ *			interrupted copy is continued from the last checkpoint in the manifest on the next run.
+ */
+FRESULT SyncEngine_Run(SYNC_JOB_T *pSync);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SYNC_ENGINE_H_ */
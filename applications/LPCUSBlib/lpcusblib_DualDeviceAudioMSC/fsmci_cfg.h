@@ -41,6 +41,7 @@
 #include "ffconf.h"
 #include "diskio.h"
 #include "board.h"
+#include "sdmmc.h"
 
 typedef mci_card_struct CARD_HANDLE_T;
 
@@ -48,10 +49,11 @@ typedef mci_card_struct CARD_HANDLE_T;
  * @def		FSMCI_CardAcquire(hc)
  * @brief	Card acquire adapter function
  * LPC43xx/18xx implementation of the FSMCI adapter function, that
- * will successfully acquire/initialize the SD Card.
+ * will successfully acquire/initialize the SD Card. The card is shared
+ * with the USB device mode, it is acquired once.
  */
 #ifdef CFG_SDCARD
-#define FSMCI_CardAcquire(hc)          Chip_SDMMC_Acquire(LPC_SDMMC, hc)
+#define FSMCI_CardAcquire(hc)          SDMMCCardAcquire()
 #else
 #define FSMCI_CardAcquire(hc) 					NULL
 #endif
@@ -123,6 +125,12 @@ typedef mci_card_struct CARD_HANDLE_T;
 #define FSMCI_CardWriteSectors(hc, buf, startSector, numSector) \
         Chip_SDMMC_WriteBlocks(LPC_SDMMC, buf, startSector, numSector)
 
+/**
+ * @def		FSMCI_CardFlushCache(hc)
+ * @brief	Write the cache of an eMMC card to its flash, 1 on success
+ */
+#define FSMCI_CardFlushCache(hc)       (Chip_SDMMC_FlushCache(LPC_SDMMC) == 0)
+
 /**
  * @def		FSMCI_InitRealTimeClock()
  * @brief	Initialize the real time clock
@@ -151,13 +159,13 @@ STATIC INLINE int FSMCI_CardReadyWait(CARD_HANDLE_T *hCrd, int tout)
 	int32_t final = curr + ((SystemCoreClock / 1000) * tout);
 
 	if ((final < 0) && (curr > 0)) {
-		while (Chip_RIT_GetCounter(LPC_RITIMER) < (uint32_t) final) { if (Chip_SDMMC_GetState(LPC_SDMMC) != -1) break; }
+		while (Chip_RIT_GetCounter(LPC_RITIMER) < (uint32_t) final) { if (!Chip_SDMMC_CardBusy(LPC_SDMMC)) break; }
 	}
 	else {
-		while ((int32_t) Chip_RIT_GetCounter(LPC_RITIMER) < final) { if (Chip_SDMMC_GetState(LPC_SDMMC) != -1) break; }
+		while ((int32_t) Chip_RIT_GetCounter(LPC_RITIMER) < final) { if (!Chip_SDMMC_CardBusy(LPC_SDMMC)) break; }
 	}
 
-	return Chip_SDMMC_GetState(LPC_SDMMC) != -1;
+	return !Chip_SDMMC_CardBusy(LPC_SDMMC);
 }
 
 /**
@@ -48,7 +48,7 @@
 #define FS_MMC		1
 
 
-typedef USB_ClassInfo_MS_Host_t DISK_HANDLE_T;
+typedef USB_ClassInfo_UAS_Host_t DISK_HANDLE_T;
 
 /**
  * @brief	Enumerate and get the disk connected
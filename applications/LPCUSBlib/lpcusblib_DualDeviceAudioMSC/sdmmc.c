@@ -41,10 +41,28 @@
 unsigned char MMC_disk_reset(void);
 
 #ifdef CFG_SDCARD
+/* Writes of this many blocks or more are long sequential ones (FatFs multi-sector writes),
+   SD cards are asked to pre-erase them */
+#ifndef SDMMC_PRE_ERASE_BLOCKS
+#define SDMMC_PRE_ERASE_BLOCKS 16
+#endif
+
+/* The card info is kept over a warm reset, so the card still powered is taken back with
+   Chip_SDMMC_Reacquire() instead of being enumerated again. It goes to the .noinit section, which
+   the scatter file prj/uDisk.sct puts in a small UNINIT region of its own (RW_NOINIT). */
+#if defined(__CC_ARM)
+#define SDMMC_RETAINED __attribute__((section(".noinit"), zero_init))
+#else
+#define SDMMC_RETAINED __attribute__((section(".noinit")))
+#endif
+
 /* SDMMC card info structure */
-mci_card_struct sdcardinfo;
+mci_card_struct sdcardinfo SDMMC_RETAINED;
 static volatile int32_t sdio_wait_exit = 0;
+static int32_t sdmmc_ready;		/* controller set up */
+static int32_t sdmmc_acquired;	/* card acquired since */
 #endif
+static MCI_BUS_SELECT_FUNC_T sdmmc_bus_select;
 
 /*****************************************************************************
  * Public types/enumerations/variables
@@ -99,20 +117,34 @@ static uint32_t sdmmc_irq_driven_wait(void)
 	return status;
 }
 
+/* Sets the callbacks of a card info, forget clears the card acquired before as well */
+static void sdmmc_card_setup(mci_card_struct *pCard, MCI_BUS_SELECT_FUNC_T bus_select, int32_t forget)
+{
+	if (forget) {
+		memset(pCard, 0, sizeof(*pCard));
+	}
+	pCard->evsetup_cb = sdmmc_setup_wakeup;
+	pCard->waitfunc_cb = sdmmc_irq_driven_wait;
+	pCard->msdelay_func = sdmmc_waitms;
+	pCard->bus_select_cb = bus_select;
+	pCard->pre_erase_min = SDMMC_PRE_ERASE_BLOCKS;
+}
+
 #endif
 
 
-/* HW set up function */
+/* HW set up function, the device and the host modes share it and the card, so it runs once */
 void SDMMCSetupHardware(void)
 {
 
 //	DEBUGSTR("SDMMCSetupHardware()\r\n");
 
 #ifdef CFG_SDCARD
-	memset(&sdcardinfo, 0, sizeof(sdcardinfo));
-	sdcardinfo.evsetup_cb = sdmmc_setup_wakeup;
-	sdcardinfo.waitfunc_cb = sdmmc_irq_driven_wait;
-	sdcardinfo.msdelay_func = sdmmc_waitms;
+	if (sdmmc_ready) {
+		return;
+	}
+	sdmmc_ready = 1;
+	sdmmc_card_setup(&sdcardinfo, sdmmc_bus_select, 0);
 
 	/*  SD/MMC initialization */
 	Board_SDMMC_Init();
@@ -135,6 +167,10 @@ void SDMMCSetupHardware(void)
 void SDMMCShutdownHardware(void)
 {
 	Chip_SDMMC_DeInit(LPC_SDMMC);
+#ifdef CFG_SDCARD
+	sdmmc_ready = 0;
+	sdmmc_acquired = 0;
+#endif
 }
 
 void Green2Flashes()
@@ -158,10 +194,52 @@ void Green2Flashes()
 
 #ifdef CFG_SDCARD
 
+/* Set the function routing the bus to the card of the slot */
+void SDMMCSetBusSelect(MCI_BUS_SELECT_FUNC_T func)
+{
+	sdmmc_bus_select = func;
+	sdcardinfo.bus_select_cb = func;
+}
+
+/* Acquire another card of the SDIO bus, e.g. the second card behind a bus switch */
+uint32_t SDMMCAcquireCard(mci_card_struct *pCard, MCI_BUS_SELECT_FUNC_T bus_select)
+{
+	mci_card_struct *pCurrent = Chip_SDMMC_GetCard(LPC_SDMMC);
+	uint32_t acquired;
+
+	sdmmc_card_setup(pCard, bus_select, 1);
+	acquired = Chip_SDMMC_Acquire(LPC_SDMMC, pCard);
+
+	/* the calls of the mass storage and the file system keep running on the card they had */
+	if (pCurrent) {
+		Chip_SDMMC_SelectCard(LPC_SDMMC, pCurrent);
+	}
+	return acquired;
+}
+
+/* Acquire the card, once for the device and the host modes */
+uint32_t SDMMCCardAcquire(void)
+{
+	if (sdmmc_acquired) {
+		return 1;
+	}
+
+	/* The card of a warm reset is taken back in a few commands, any other is enumerated */
+	if (!Chip_SDMMC_Reacquire(LPC_SDMMC, &sdcardinfo)) {
+		sdmmc_card_setup(&sdcardinfo, sdmmc_bus_select, 1);
+		if (!Chip_SDMMC_Acquire(LPC_SDMMC, &sdcardinfo)) {
+			return 0;
+		}
+	}
+	sdmmc_acquired = 1;
+
+	return 1;
+}
+
 void SDMMCAcquire(void)
 {
 	/* Acquire the card once ready */
-	if (!Chip_SDMMC_Acquire(LPC_SDMMC, &sdcardinfo)) {
+	if (!SDMMCCardAcquire()) {
 		DEBUGOUT("Card Acquire failed...\r\n");
 		while (1) 
 		{
@@ -187,6 +265,12 @@ void SDIO_IRQHandler(void)
 	/* Set wait exit flag to tell wait function we are ready. In an RTOS,
 	   this would trigger wakeup of a thread waiting for the IRQ. */
 	NVIC_DisableIRQ(SDIO_IRQn);
+
+	/* A transfer started with Chip_SDMMC_StartRead/WriteBlocks() runs from here up to its completion */
+	if (Chip_SDMMC_XferPending(LPC_SDMMC)) {
+		Chip_SDMMC_IRQHandler(LPC_SDMMC);
+		return;
+	}
 	sdio_wait_exit = 1;
 }
 
@@ -5,6 +5,15 @@
 void SDMMCSetupHardware(void);
 void SDMMCAcquire(void);
 
+/* Acquire the card once for all its users, 1 when acquired */
+uint32_t SDMMCCardAcquire(void);
+
+/* Set the function routing the bus to the card of the slot, for two cards behind a bus switch */
+void SDMMCSetBusSelect(MCI_BUS_SELECT_FUNC_T func);
+
+/* Acquire another card of the SDIO bus, the card of the slot stays selected, 1 when acquired */
+uint32_t SDMMCAcquireCard(mci_card_struct *pCard, MCI_BUS_SELECT_FUNC_T bus_select);
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -0,0 +1,377 @@
+/*
+ * @brief SD card in SPI mode on an SSP port
+ *
+ * @note
+ * Copyright(C) NXP Semiconductors, 2012
+ * All rights reserved.
+ *
+ * @par
+ * Software that is described herein is for illustrative purposes only
+ * which provides customers with programming information regarding the
+ * LPC products.  This software is supplied "AS IS" without any warranties of
+ * any kind, and NXP Semiconductors and its licensor disclaim any and
+ * all warranties, express or implied, including all implied warranties of
+ * merchantability, fitness for a particular purpose and non-infringement of
+ * intellectual property rights.  NXP Semiconductors assumes no responsibility
+ * or liability for the use of the software, conveys no license or rights under any
+ * patent, copyright, mask work right, or any other intellectual property rights in
+ * or to any products. NXP Semiconductors reserves the right to make changes
+ * in the software without notification. NXP Semiconductors also makes no
+ * representation or warranty that such application will be suitable for the
+ * specified use without further testing or modification.
+ *
+ * @par
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation is hereby granted, under NXP Semiconductors' and its
+ * licensor's relevant copyrights in the software, without fee, provided that it
+ * is used in conjunction with NXP Semiconductors microcontrollers.  This
+ * copyright, permission, and disclaimer notice must appear in all copies of
+ * this code.
+ */
+
+#include "board.h"
+#include "sdspi.h"
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+/* SPI mode commands not used on the SDIO bus */
+#define SDSPI_READ_OCR          58
+#define SDSPI_ACMD              0x80	/* flag of the application commands, sent after CMD55 */
+
+/* Data tokens */
+#define SDSPI_TOKEN_START       0xFE	/* single block read and write, multiple block read */
+#define SDSPI_TOKEN_MULTI       0xFC	/* multiple block write */
+#define SDSPI_TOKEN_STOP        0xFD	/* end of a multiple block write */
+
+#define SDSPI_BLOCK_SIZE        512
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+/* Tells whether ms milliseconds have passed since the RIT count start */
+static int32_t sdspi_expired(uint32_t start, uint32_t ms)
+{
+	return (Chip_RIT_GetCounter(LPC_RITIMER) - start) >= ((SystemCoreClock / 1000) * ms);
+}
+
+/* Send one byte and get the one clocked in meanwhile */
+static uint8_t sdspi_xchg(SDSPI_CARD_T *pCard, uint8_t out)
+{
+	Chip_SSP_DATA_SETUP_T xf;
+	uint8_t in = 0xFF;
+
+	xf.tx_data = &out;
+	xf.tx_cnt = 0;
+	xf.rx_data = &in;
+	xf.rx_cnt = 0;
+	xf.length = 1;
+	Chip_SSP_RWFrames_Blocking(pCard->pSSP, &xf);
+
+	return in;
+}
+
+/* Wait until the card releases DO, it holds it low while busy programming */
+static int32_t sdspi_wait_ready(SDSPI_CARD_T *pCard, uint32_t ms)
+{
+	uint32_t start = Chip_RIT_GetCounter(LPC_RITIMER);
+
+	while (sdspi_xchg(pCard, 0xFF) != 0xFF) {
+		if (sdspi_expired(start, ms)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* Release the card, the clock after CS goes high makes it release DO */
+static void sdspi_deselect(SDSPI_CARD_T *pCard)
+{
+	Chip_GPIO_WritePortBit(LPC_GPIO_PORT, pCard->CsPort, pCard->CsPin, true);
+	sdspi_xchg(pCard, 0xFF);
+}
+
+/* Select the card and wait until it is ready for a command */
+static int32_t sdspi_select(SDSPI_CARD_T *pCard)
+{
+	Chip_GPIO_WritePortBit(LPC_GPIO_PORT, pCard->CsPort, pCard->CsPin, false);
+	sdspi_xchg(pCard, 0xFF);
+	if (sdspi_wait_ready(pCard, SDSPI_WRITE_TIMEOUT)) {
+		return 1;
+	}
+	sdspi_deselect(pCard);
+	return 0;
+}
+
+/* Send a command and get its R1 response, 0xFF when the card does not answer. The card stays selected
+   for the data phase, except for the stop of a read the command is sent on a new selection. */
+static uint8_t sdspi_command(SDSPI_CARD_T *pCard, uint8_t cmd, uint32_t arg)
+{
+	uint8_t frame[6];
+	uint8_t r1;
+	int32_t i;
+
+	if (cmd & SDSPI_ACMD) {
+		r1 = sdspi_command(pCard, MMC_APP_CMD, 0);
+		if (r1 > 1) {
+			return r1;
+		}
+		cmd &= ~SDSPI_ACMD;
+	}
+
+	if (cmd != MMC_STOP_TRANSMISSION) {
+		sdspi_deselect(pCard);
+		if (!sdspi_select(pCard)) {
+			return 0xFF;
+		}
+	}
+
+	/* only CMD0 and CMD8 are checked by the CRC while the card is in SPI mode */
+	frame[0] = 0x40 | cmd;
+	frame[1] = (uint8_t) (arg >> 24);
+	frame[2] = (uint8_t) (arg >> 16);
+	frame[3] = (uint8_t) (arg >> 8);
+	frame[4] = (uint8_t) arg;
+	frame[5] = (cmd == MMC_GO_IDLE_STATE) ? 0x95 : (cmd == SD_CMD8) ? 0x87 : 0x01;
+	for (i = 0; i < 6; i++) {
+		sdspi_xchg(pCard, frame[i]);
+	}
+	if (cmd == MMC_STOP_TRANSMISSION) {
+		sdspi_xchg(pCard, 0xFF);	/* stuff byte */
+	}
+
+	/* the response comes within 8 bytes */
+	i = 10;
+	do {
+		r1 = sdspi_xchg(pCard, 0xFF);
+	} while ((r1 & 0x80) && --i);
+
+	return r1;
+}
+
+/* Receive a data block after its start token */
+static int32_t sdspi_rx_block(SDSPI_CARD_T *pCard, uint8_t *buf, uint32_t len)
+{
+	uint32_t start = Chip_RIT_GetCounter(LPC_RITIMER);
+	uint8_t token;
+
+	do {
+		token = sdspi_xchg(pCard, 0xFF);
+	} while ((token == 0xFF) && !sdspi_expired(start, SDSPI_READ_TIMEOUT));
+	if (token != SDSPI_TOKEN_START) {
+		return 0;
+	}
+
+	if (Chip_SSP_ReadFrames_Blocking(pCard->pSSP, buf, len) != len) {
+		return 0;
+	}
+	sdspi_xchg(pCard, 0xFF);	/* CRC, not checked */
+	sdspi_xchg(pCard, 0xFF);
+
+	return 1;
+}
+
+/* Send a data block with its token, or the stop token alone (buf NULL) */
+static int32_t sdspi_tx_block(SDSPI_CARD_T *pCard, const uint8_t *buf, uint8_t token)
+{
+	uint8_t resp;
+
+	if (!sdspi_wait_ready(pCard, SDSPI_WRITE_TIMEOUT)) {
+		return 0;
+	}
+	sdspi_xchg(pCard, token);
+	if (!buf) {
+		return 1;
+	}
+
+	if (Chip_SSP_WriteFrames_Blocking(pCard->pSSP, (uint8_t *) buf, SDSPI_BLOCK_SIZE) != SDSPI_BLOCK_SIZE) {
+		return 0;
+	}
+	sdspi_xchg(pCard, 0xFF);	/* CRC, not checked */
+	sdspi_xchg(pCard, 0xFF);
+
+	/* data response: 0x05 accepted, 0x0B CRC error, 0x0D write error */
+	resp = sdspi_xchg(pCard, 0xFF);
+	return (resp & 0x1F) == 0x05;
+}
+
+/* Check a transfer and get the card address of its first block */
+static int32_t sdspi_check(SDSPI_CARD_T *pCard, int32_t start_block, int32_t num_blocks, uint32_t *addr)
+{
+	if (!pCard->Blocks || (start_block < 0) || (num_blocks <= 0) ||
+		((uint32_t) (start_block + num_blocks) > pCard->Blocks)) {
+		return 0;
+	}
+	*addr = pCard->HighCapacity ? (uint32_t) start_block : (uint32_t) start_block * SDSPI_BLOCK_SIZE;
+	return 1;
+}
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Set up the SSP port and the chip select of the SPI card */
+void SDSPI_Init(SDSPI_CARD_T *pCard)
+{
+	pCard->pSSP = SDSPI_SSP;
+	pCard->CsPort = SDSPI_CS_GPIO_PORT;
+	pCard->CsPin = SDSPI_CS_GPIO_PIN;
+	pCard->HighCapacity = 0;
+	pCard->Blocks = 0;
+
+	Board_SSP_Init(pCard->pSSP);
+	Chip_SCU_PinMux(SDSPI_CS_SCU_PORT, SDSPI_CS_SCU_PIN, MD_PLN_FAST, SDSPI_CS_SCU_FUNC);
+	Chip_GPIO_WritePortBit(LPC_GPIO_PORT, pCard->CsPort, pCard->CsPin, true);
+	Chip_GPIO_WriteDirBit(LPC_GPIO_PORT, pCard->CsPort, pCard->CsPin, true);
+
+	Chip_SSP_Init(pCard->pSSP);
+	Chip_SSP_Enable(pCard->pSSP);
+}
+
+/* Identify the card: CMD0, CMD8, ACMD41 until ready, CMD58 for the addressing and CMD9 for the size */
+uint32_t SDSPI_Acquire(SDSPI_CARD_T *pCard)
+{
+	uint8_t buf[16];
+	uint32_t hcs = 0, start, c_size;
+	uint8_t r1;
+	int32_t i;
+
+	pCard->HighCapacity = 0;
+	pCard->Blocks = 0;
+	Chip_SSP_Set_BitRate(pCard->pSSP, SDSPI_INIT_CLOCK);
+
+	/* 74 clocks or more with CS high before the first command */
+	Chip_GPIO_WritePortBit(LPC_GPIO_PORT, pCard->CsPort, pCard->CsPin, true);
+	for (i = 0; i < 10; i++) {
+		sdspi_xchg(pCard, 0xFF);
+	}
+
+	if (sdspi_command(pCard, MMC_GO_IDLE_STATE, 0) != 1) {
+		goto done;
+	}
+
+	/* SD 2.0 cards echo the check pattern of CMD8, older cards reject it as illegal */
+	if (sdspi_command(pCard, SD_CMD8, 0x1AA) == 1) {
+		for (i = 0; i < 4; i++) {
+			buf[i] = sdspi_xchg(pCard, 0xFF);
+		}
+		if ((buf[2] != 0x01) || (buf[3] != 0xAA)) {
+			goto done;
+		}
+		hcs = 1UL << 30;
+	}
+
+	start = Chip_RIT_GetCounter(LPC_RITIMER);
+	do {
+		r1 = sdspi_command(pCard, SDSPI_ACMD | SD_APP_OP_COND, hcs);
+	} while ((r1 == 1) && !sdspi_expired(start, SDSPI_INIT_TIMEOUT));
+	if (r1 != 0) {
+		goto done;
+	}
+
+	if (hcs) {
+		if (sdspi_command(pCard, SDSPI_READ_OCR, 0) != 0) {
+			goto done;
+		}
+		for (i = 0; i < 4; i++) {
+			buf[i] = sdspi_xchg(pCard, 0xFF);
+		}
+		pCard->HighCapacity = (buf[0] & 0x40) != 0;
+	}
+	if (!pCard->HighCapacity && (sdspi_command(pCard, MMC_SET_BLOCKLEN, SDSPI_BLOCK_SIZE) != 0)) {
+		goto done;
+	}
+
+	if ((sdspi_command(pCard, MMC_SEND_CSD, 0) != 0) || !sdspi_rx_block(pCard, buf, 16)) {
+		goto done;
+	}
+	if ((buf[0] >> 6) == 1) {
+		/* CSD 2.0: C_SIZE counts 512 KB units */
+		c_size = ((uint32_t) (buf[7] & 0x3F) << 16) | ((uint32_t) buf[8] << 8) | buf[9];
+		pCard->Blocks = (c_size + 1) << 10;
+	}
+	else {
+		/* CSD 1.0: (C_SIZE + 1) << (C_SIZE_MULT + 2) blocks of READ_BL_LEN */
+		c_size = ((uint32_t) (buf[6] & 0x03) << 10) | ((uint32_t) buf[7] << 2) | (buf[8] >> 6);
+		pCard->Blocks = (c_size + 1) <<
+						((((buf[9] & 0x03) << 1) | (buf[10] >> 7)) + 2 + (buf[5] & 0x0F) - 9);
+	}
+
+	Chip_SSP_Set_BitRate(pCard->pSSP, SDSPI_MAX_CLOCK);
+
+done:
+	sdspi_deselect(pCard);
+	return pCard->Blocks != 0;
+}
+
+/* Read blocks: CMD17 for one, CMD18 and CMD12 for more */
+int32_t SDSPI_ReadBlocks(SDSPI_CARD_T *pCard, void *buffer, int32_t start_block, int32_t num_blocks)
+{
+	uint8_t *buf = (uint8_t *) buffer;
+	uint32_t addr;
+	int32_t n = 0;
+
+	if (!sdspi_check(pCard, start_block, num_blocks, &addr)) {
+		return 0;
+	}
+
+	if (num_blocks == 1) {
+		if ((sdspi_command(pCard, MMC_READ_SINGLE_BLOCK, addr) == 0) &&
+			sdspi_rx_block(pCard, buf, SDSPI_BLOCK_SIZE)) {
+			n = 1;
+		}
+	}
+	else if (sdspi_command(pCard, MMC_READ_MULTIPLE_BLOCK, addr) == 0) {
+		while ((n < num_blocks) && sdspi_rx_block(pCard, buf + (n * SDSPI_BLOCK_SIZE), SDSPI_BLOCK_SIZE)) {
+			n++;
+		}
+		sdspi_command(pCard, MMC_STOP_TRANSMISSION, 0);
+	}
+	sdspi_deselect(pCard);
+
+	return (n == num_blocks) ? (num_blocks * SDSPI_BLOCK_SIZE) : 0;
+}
+
+/* Write blocks: CMD24 for one, CMD25 and the stop token for more */
+int32_t SDSPI_WriteBlocks(SDSPI_CARD_T *pCard, const void *buffer, int32_t start_block, int32_t num_blocks)
+{
+	const uint8_t *buf = (const uint8_t *) buffer;
+	uint32_t addr;
+	int32_t n = 0;
+
+	if (!sdspi_check(pCard, start_block, num_blocks, &addr)) {
+		return 0;
+	}
+
+	if (num_blocks == 1) {
+		if ((sdspi_command(pCard, MMC_WRITE_BLOCK, addr) == 0) &&
+			sdspi_tx_block(pCard, buf, SDSPI_TOKEN_START)) {
+			n = 1;
+		}
+	}
+	else if (sdspi_command(pCard, MMC_WRITE_MULTIPLE_BLOCK, addr) == 0) {
+		while ((n < num_blocks) && sdspi_tx_block(pCard, buf + (n * SDSPI_BLOCK_SIZE), SDSPI_TOKEN_MULTI)) {
+			n++;
+		}
+		if (!sdspi_tx_block(pCard, NULL, SDSPI_TOKEN_STOP)) {
+			n = 0;
+		}
+	}
+
+	/* the card programs the last blocks deselected, the select of the next command waits for it */
+	sdspi_deselect(pCard);
+
+	return (n == num_blocks) ? (num_blocks * SDSPI_BLOCK_SIZE) : 0;
+}
+
+/* Get the size of the card */
+int32_t SDSPI_GetDeviceBlocks(SDSPI_CARD_T *pCard)
+{
+	return (int32_t) pCard->Blocks;
+}
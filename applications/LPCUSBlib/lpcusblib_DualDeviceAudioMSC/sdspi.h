@@ -0,0 +1,130 @@
+/*
+ * @brief SD card in SPI mode on an SSP port
+ *
+ * @note
+ * Copyright(C) NXP Semiconductors, 2012
+ * All rights reserved.
+ *
+ * @par
+ * Software that is described herein is for illustrative purposes only
+ * which provides customers with programming information regarding the
+ * LPC products.  This software is supplied "AS IS" without any warranties of
+ * any kind, and NXP Semiconductors and its licensor disclaim any and
+ * all warranties, express or implied, including all implied warranties of
+ * merchantability, fitness for a particular purpose and non-infringement of
+ * intellectual property rights.  NXP Semiconductors assumes no responsibility
+ * or liability for the use of the software, conveys no license or rights under any
+ * patent, copyright, mask work right, or any other intellectual property rights in
+ * or to any products. NXP Semiconductors reserves the right to make changes
+ * in the software without notification. NXP Semiconductors also makes no
+ * representation or warranty that such application will be suitable for the
+ * specified use without further testing or modification.
+ *
+ * @par
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation is hereby granted, under NXP Semiconductors' and its
+ * licensor's relevant copyrights in the software, without fee, provided that it
+ * is used in conjunction with NXP Semiconductors microcontrollers.  This
+ * copyright, permission, and disclaimer notice must appear in all copies of
+ * this code.
+ */
+
+#ifndef __SDSPI_H_
+#define __SDSPI_H_
+
+#include "board.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** SSP port of the SPI card */
+#ifndef SDSPI_SSP
+#define SDSPI_SSP               LPC_SSP1
+#endif
+
+/** Chip select of the SPI card: P1.5 (the SSEL1 pin) driven as GPIO1[8], the SSP would raise its own
+    select between bytes while the card needs it low over whole commands and data blocks */
+#ifndef SDSPI_CS_SCU_PORT
+#define SDSPI_CS_SCU_PORT       0x1
+#define SDSPI_CS_SCU_PIN        5
+#define SDSPI_CS_SCU_FUNC       FUNC0
+#define SDSPI_CS_GPIO_PORT      1
+#define SDSPI_CS_GPIO_PIN       8
+#endif
+
+/** SPI clock while the card is identified, and once it is */
+#ifndef SDSPI_INIT_CLOCK
+#define SDSPI_INIT_CLOCK        400000
+#endif
+#ifndef SDSPI_MAX_CLOCK
+#define SDSPI_MAX_CLOCK         25000000
+#endif
+
+/** Milliseconds the card may take to leave the idle state, send a read block or finish programming */
+#ifndef SDSPI_INIT_TIMEOUT
+#define SDSPI_INIT_TIMEOUT      1000
+#endif
+#ifndef SDSPI_READ_TIMEOUT
+#define SDSPI_READ_TIMEOUT      100
+#endif
+#ifndef SDSPI_WRITE_TIMEOUT
+#define SDSPI_WRITE_TIMEOUT     500
+#endif
+
+/** An SD card on an SSP port, the SPI counterpart of mci_card_struct */
+typedef struct {
+	LPC_SSP_T *pSSP;
+	uint8_t CsPort;					/* GPIO port and bit of the chip select */
+	uint8_t CsPin;
+	uint8_t HighCapacity;			/* SDHC/SDXC: block addresses instead of byte addresses */
+	uint32_t Blocks;				/* size in 512 byte blocks, 0 until acquired */
+} SDSPI_CARD_T;
+
+/**
+ * @brief	Set up the SSP port and the chip select of the SPI card
+ * @param	pCard	: card to set up, on SDSPI_SSP and the SDSPI_CS_* pin
+ * @return	Nothing
+ */
+void SDSPI_Init(SDSPI_CARD_T *pCard);
+
+/**
+ * @brief	Identify the card and switch the bus to full speed
+ * @param	pCard	: card from SDSPI_Init()
+ * @return	1 when the card is ready for transfers, else 0
+ */
+uint32_t SDSPI_Acquire(SDSPI_CARD_T *pCard);
+
+/**
+ * @brief	Read blocks from the card
+ * @param	pCard		: acquired card
+ * @param	buffer		: data read
+ * @param	start_block	: first block
+ * @param	num_blocks	: number of blocks
+ * @return	Bytes read, 0 on error
+ */
+int32_t SDSPI_ReadBlocks(SDSPI_CARD_T *pCard, void *buffer, int32_t start_block, int32_t num_blocks);
+
+/**
+ * @brief	Write blocks to the card
+ * @param	pCard		: acquired card
+ * @param	buffer		: data to write
+ * @param	start_block	: first block
+ * @param	num_blocks	: number of blocks
+ * @return	Bytes written, 0 on error
+ * @note	The card programs the last blocks after this returns, the next command waits for the end.
+ */
+int32_t SDSPI_WriteBlocks(SDSPI_CARD_T *pCard, const void *buffer, int32_t start_block, int32_t num_blocks);
+
+/**
+ * @brief	Get the size of the card
+ * @param	pCard	: acquired card
+ * @return	Number of 512 byte blocks
+ */
+int32_t SDSPI_GetDeviceBlocks(SDSPI_CARD_T *pCard);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SDSPI_H_ */
@@ -63,7 +63,7 @@ int main(void)
 			
       case USB_MODE_Host :
       {
-        MS_Host_USBTask(&FlashDisk_MS_Interface);
+        UAS_Host_USBTask(&FlashDisk_UAS_Interface);
         USB_USBTask(FLASH_DISK_CORENUM,USB_MODE_Host);
       }
       break;
@@ -0,0 +1,628 @@
+/*
+ * @brief Test of the SD to USB copy engine of the application against the SD/MMC and EHCI models
+ *
+ * @note
+ * Copyright(C) NXP Semiconductors, 2012
+ * All rights reserved.
+ *
+ * @par
+ * Software that is described herein is for illustrative purposes only
+ * which provides customers with programming information regarding the
+ * LPC products.  This software is supplied "AS IS" without any warranties of
+ * any kind, and NXP Semiconductors and its licensor disclaim any and
+ * all warranties, express or implied, including all implied warranties of
+ * merchantability, fitness for a particular purpose and non-infringement of
+ * intellectual property rights.  NXP Semiconductors assumes no responsibility
+ * or liability for the use of the software, conveys no license or rights under any
+ * patent, copyright, mask work right, or any other intellectual property rights in
+ * or to any products. NXP Semiconductors reserves the right to make changes
+ * in the software without notification. NXP Semiconductors also makes no
+ * representation or warranty that such application will be suitable for the
+ * specified use without further testing or modification.
+ *
+ * @par
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation is hereby granted, under NXP Semiconductors' and its
+ * licensor's relevant copyrights in the software, without fee, provided that it
+ * is used in conjunction with NXP Semiconductors microcontrollers.  This
+ * copyright, permission, and disclaimer notice must appear in all copies of
+ * this code.
+ */
+
+/* Usage: copy_engine_test [SD image] [USB image]
+ *
+ * An SDHC card and a high speed Bulk-Only disk are modelled, both formatted, and a fragmented file is
+ * written to the card. CopyEngine.c copies it to the USB disk: in one go, with a data CRC error on a card
+ * read, with a card interrupt lost, resumed from the middle, and to a second file on the card. Each copy
+ * is read back and compared. The card reads in the background must hold the card volume and be done
+ * whenever the progress callback runs. SyncEngine.c then brings the USB disk up to date with the card: a
+ * run stopped by card read errors is resumed from its manifest checkpoint, and a manifest with more records
+ * than SYNC_RECORDS_MAX is kept as it is. Exits non-zero on any failure. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fsusb_cfg.h"
+#include "ff.h"
+#include "sdmmc_sim.h"
+#include "CopyEngine.h"
+#include "SyncEngine.h"
+
+#define TEST_PORT           0
+#define TEST_IMAGE_MB       32
+#define TEST_FILE_SIZE      ((768 * 1024) + 1234)
+#define TEST_CHUNK          (32 * 1024)
+#define TEST_FRAGMENT       3000			/* source written in pieces, a filler file in between */
+#define TEST_READY_TRIES    100
+#define TEST_WAIT_US        2000000			/* a command the model never ends */
+#define TEST_SYNC_STOP      40				/* progress call of a sync to stop the copy at */
+#define TEST_SYNC_FILES     (SYNC_RECORDS_MAX + 2)	/* small files, more than the manifest takes */
+
+static USB_ClassInfo_MS_Host_t TestMSInterface = {
+	.Config = {
+		.DataINPipeNumber       = 1,
+		.DataINPipeDoubleBank   = false,
+
+		.DataOUTPipeNumber      = 2,
+		.DataOUTPipeDoubleBank  = false,
+		.PortNumber = TEST_PORT,
+	},
+};
+
+static USB_ClassInfo_UAS_Host_t TestDisk = {
+	.Config = {
+		.DataINPipeNumber       = 1,
+		.DataOUTPipeNumber      = 2,
+		.CommandPipeNumber      = 3,
+		.StatusPipeNumber       = 4,
+		.PortNumber = TEST_PORT,
+		.BOTInterface = &TestMSInterface,
+	},
+};
+
+static SCSI_Capacity_t DiskCapacity;
+static volatile bool DiskEnumerated;
+
+uint32_t SystemCoreClock;
+mci_card_struct sdcardinfo;
+static volatile int32_t WaitExit;
+static volatile int32_t DropIrq;			/* lose the next interrupt of a started transfer */
+static volatile uint32_t CardReads;			/* started transfers ended from the interrupt */
+static volatile uint32_t UnlockedReads;		/* of which with the card volume not held */
+
+static int32_t VolumeLocks[_VOLUMES];
+static int32_t InjectAt;					/* progress call to inject an error at, 0 for none */
+static int32_t ProgressCalls;
+static int32_t ProgressBusy;				/* progress calls with the card or its volume in use */
+static uint32_t Failures;
+
+static FATFS UsbFS, CardFS;
+static FIL TestFile, FillFile;
+static uint8_t Buffer[TEST_CHUNK];
+static uint8_t CheckBuffer[TEST_CHUNK];
+
+#define CHECK(cond, what) \
+	do { \
+		if (!(cond)) { \
+			printf("  FAIL %s (%s:%d)\r\n", (what), __FILE__, __LINE__); \
+			Failures++; \
+		} \
+	} while (0)
+
+/*---------- Host stack events ----------*/
+void EVENT_USB_Host_DeviceEnumerationComplete(const uint8_t corenum)
+{
+	uint16_t ConfigDescriptorSize;
+	uint8_t  ConfigDescriptorData[512];
+
+	if ((USB_Host_GetDeviceConfigDescriptor(corenum, 1, &ConfigDescriptorSize, ConfigDescriptorData,
+											sizeof(ConfigDescriptorData)) != HOST_GETCONFIG_Successful) ||
+		(UAS_Host_ConfigurePipes(&TestDisk, ConfigDescriptorSize, ConfigDescriptorData) != UAS_ENUMERROR_NoError) ||
+		(USB_Host_SetDeviceConfiguration(corenum, 1) != HOST_SENDCONTROL_Successful) ||
+		(UAS_Host_SelectAlternateSetting(&TestDisk) != HOST_SENDCONTROL_Successful)) {
+		printf("Enumeration of the mass storage device failed\r\n");
+		return;
+	}
+	DiskEnumerated = true;
+}
+
+void EVENT_USB_Host_DeviceEnumerationFailed(const uint8_t corenum,
+											const uint8_t ErrorCode,
+											const uint8_t SubErrorCode)
+{
+	printf("Dev Enum Error %d/%d\r\n", ErrorCode, SubErrorCode);
+}
+
+/*---------- Disk glue of fs_usb.c, as in MassStorageHost.c ----------*/
+DISK_HANDLE_T *FSUSB_DiskInit(void)
+{
+	return &TestDisk;
+}
+
+int FSUSB_DiskInsertWait(DISK_HANDLE_T *hDisk)
+{
+	while (!DiskEnumerated) {
+		USB_USBTask(hDisk->Config.PortNumber, USB_MODE_Host);
+	}
+	return 1;
+}
+
+int FSUSB_DiskReadyWait(DISK_HANDLE_T *hDisk, int tout)
+{
+	int Tries;
+
+	(void) tout;
+	for (Tries = 0; Tries < TEST_READY_TRIES; Tries++) {
+		if (UAS_Host_TestUnitReady(hDisk, 0) == 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int FSUSB_DiskAcquire(DISK_HANDLE_T *hDisk)
+{
+	return FSUSB_DiskReadyWait(hDisk, 0) && !UAS_Host_ReadDeviceCapacity(hDisk, 0, &DiskCapacity);
+}
+
+uint32_t FSUSB_DiskGetSectorCnt(DISK_HANDLE_T *hDisk)
+{
+	return DiskCapacity.Blocks;
+}
+
+uint32_t FSUSB_DiskGetSectorSz(DISK_HANDLE_T *hDisk)
+{
+	return DiskCapacity.BlockSize;
+}
+
+int FSUSB_DiskReadSectors(DISK_HANDLE_T *hDisk, void *buff, uint32_t secStart, uint32_t numSec)
+{
+	return !UAS_Host_ReadDeviceBlocks(hDisk, 0, secStart, numSec, DiskCapacity.BlockSize, buff);
+}
+
+int FSUSB_DiskWriteSectors(DISK_HANDLE_T *hDisk, void *buff, uint32_t secStart, uint32_t numSec)
+{
+	return !UAS_Host_WriteDeviceBlocks(hDisk, 0, secStart, numSec, DiskCapacity.BlockSize, buff);
+}
+
+/*---------- Card glue of fs_mci.c and interrupt, as in sdmmc.c of the application ----------*/
+static void SDIO_IRQHandler(void)
+{
+	SdmmcSim_EnableIrq(0);
+
+	if (Chip_SDMMC_XferPending(LPC_SDMMC)) {
+		if (DropIrq) {
+			DropIrq = 0;
+			return;
+		}
+		Chip_SDMMC_IRQHandler(LPC_SDMMC);
+		if (!Chip_SDMMC_XferPending(LPC_SDMMC)) {
+			CardReads++;
+			if (!VolumeLocks[COPY_CARD_DRIVE]) {
+				UnlockedReads++;
+			}
+		}
+		return;
+	}
+	WaitExit = 1;
+}
+
+static void sdmmc_setup_wakeup(uint32_t bits)
+{
+	WaitExit = 0;
+	Chip_SDMMC_SetIntMask(LPC_SDMMC, bits);
+	SdmmcSim_EnableIrq(1);
+}
+
+static uint32_t sdmmc_irq_driven_wait(void)
+{
+	uint64_t end = SdmmcSim_GetTimeUs() + TEST_WAIT_US;
+
+	while (!WaitExit) {
+		if (SdmmcSim_GetTimeUs() > end) {
+			printf("  no SDIO interrupt, the model hangs\r\n");
+			exit(1);
+		}
+	}
+	return Chip_SDMMC_GetIntStatus(LPC_SDMMC);
+}
+
+static void sdmmc_waitms(uint32_t time)
+{
+	uint64_t end = SdmmcSim_GetTimeUs() + ((uint64_t) time * 1000);
+
+	while (SdmmcSim_GetTimeUs() < end) {}
+}
+
+uint32_t SDMMCCardAcquire(void)
+{
+	static uint32_t acquired;
+
+	if (!acquired) {
+		acquired = Chip_SDMMC_Acquire(LPC_SDMMC, &sdcardinfo);
+	}
+	return acquired;
+}
+
+/*---------- FatFs services, single threaded: a grant is only refused to a nested call ----------*/
+int ff_cre_syncobj(BYTE vol, _SYNC_t *sobj)
+{
+	*sobj = &VolumeLocks[vol];
+	return 1;
+}
+
+int ff_req_grant(_SYNC_t sobj)
+{
+	int32_t *lock = (int32_t *) sobj;
+
+	if (*lock) {
+		return 0;
+	}
+	*lock = 1;
+	return 1;
+}
+
+void ff_rel_grant(_SYNC_t sobj)
+{
+	*(int32_t *) sobj = 0;
+}
+
+int ff_del_syncobj(_SYNC_t sobj)
+{
+	return 1;
+}
+
+DWORD get_fattime(void)
+{
+	return ((DWORD) (2012 - 1980) << 25) | (1UL << 21) | (1UL << 16);
+}
+
+/*---------- Tests ----------*/
+static void fill_pattern(uint8_t *buffer, UINT length, FSIZE_t offset)
+{
+	UINT i;
+
+	for (i = 0; i < length; i++) {
+		buffer[i] = (uint8_t) (((offset + i) * 7) ^ ((offset + i) >> 9));
+	}
+}
+
+/* The source in pieces, with a piece of the filler after every third one so the clusters are not in a row */
+static int write_source(const char *path, FSIZE_t size)
+{
+	FSIZE_t done;
+	UINT bw, fw, n;
+	int32_t piece = 0;
+
+	if (f_open(&TestFile, path, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK) {
+		return 0;
+	}
+	if (f_open(&FillFile, "1:FILL.BIN", FA_CREATE_ALWAYS | FA_WRITE) != FR_OK) {
+		f_close(&TestFile);
+		return 0;
+	}
+	for (done = 0; done < size; done += bw) {
+		n = (UINT) MIN(TEST_FRAGMENT, size - done);
+		fill_pattern(Buffer, n, done);
+		if ((f_write(&TestFile, Buffer, n, &bw) != FR_OK) || (bw != n)) {
+			break;
+		}
+		if (((++piece % 3) == 0) && ((f_write(&FillFile, Buffer, 1536, &fw) != FR_OK) || (fw != 1536))) {
+			break;
+		}
+	}
+	f_close(&FillFile);
+	return (f_close(&TestFile) == FR_OK) && (done == size);
+}
+
+static int verify_file(const char *path, FSIZE_t size)
+{
+	FSIZE_t done;
+	UINT br;
+
+	if (f_open(&TestFile, path, FA_READ) != FR_OK) {
+		return 0;
+	}
+	if (f_size(&TestFile) != size) {
+		f_close(&TestFile);
+		return 0;
+	}
+	for (done = 0; done < size; done += br) {
+		if ((f_read(&TestFile, Buffer, TEST_CHUNK, &br) != FR_OK) || (br == 0)) {
+			break;
+		}
+		fill_pattern(CheckBuffer, br, done);
+		if (memcmp(Buffer, CheckBuffer, br)) {
+			break;
+		}
+	}
+	f_close(&TestFile);
+	return done == size;
+}
+
+static int make_image(const char *path, uint32_t megabytes)
+{
+	FILE *Image = fopen(path, "wb");
+	int ok;
+
+	if (Image == NULL) {
+		return 0;
+	}
+	ok = (fseeko(Image, (off_t) megabytes * 1024 * 1024 - 1, SEEK_SET) == 0) && (fputc(0, Image) == 0);
+	return (fclose(Image) == 0) && ok;
+}
+
+/* Runs after buffers reached the USB disk: the card and its volume must be free */
+static void copy_progress(const COPY_JOB_T *pJob)
+{
+	ProgressCalls++;
+	if (Chip_SDMMC_XferPending(LPC_SDMMC) || VolumeLocks[COPY_CARD_DRIVE]) {
+		ProgressBusy++;
+	}
+	if (ProgressCalls == InjectAt) {
+		SdmmcSim_InjectError(MMC_READ_MULTIPLE_BLOCK, MCI_INT_DCRC);
+	}
+	else if (ProgressCalls == -InjectAt) {
+		DropIrq = 1;
+	}
+}
+
+/* Copies the source with the engine, inject > 0 is the progress call to fail a card read at, < 0 the one
+   to lose a card interrupt at */
+static FRESULT run_copy(COPY_JOB_T *pJob, const char *dst, int32_t inject)
+{
+	FRESULT rc;
+
+	ProgressCalls = ProgressBusy = 0;
+	InjectAt = inject;
+	CardReads = UnlockedReads = 0;
+	if (!pJob->Done) {
+		CopyEngine_InitJob(pJob, "1:SRC.BIN", dst, TEST_FILE_SIZE, copy_progress);
+	}
+	rc = CopyEngine_Run(pJob);
+	DropIrq = 0;
+
+	CHECK(ProgressCalls > 0, "progress reported");
+	CHECK(ProgressBusy == 0, "progress only with the card and its volume free");
+	CHECK(UnlockedReads == 0, "card reads with the card volume held");
+	CHECK(!VolumeLocks[0] && !VolumeLocks[1], "volumes released");
+	return rc;
+}
+
+static void test_copy(void)
+{
+	COPY_JOB_T Job;
+
+	memset(&Job, 0, sizeof(Job));
+	CHECK(run_copy(&Job, "0:DST.BIN", 0) == FR_OK, "copy");
+	CHECK((Job.Done == TEST_FILE_SIZE) && (Job.Retries == 0), "copy done without retry");
+	CHECK(CardReads > 0, "source read in the background");
+	CHECK(verify_file("0:DST.BIN", TEST_FILE_SIZE), "copy data");
+	printf("  copy: %lu card reads, %lu KB/s\r\n", (unsigned long) CardReads,
+		   (unsigned long) CopyEngine_Throughput(&Job));
+}
+
+static void test_read_error(void)
+{
+	COPY_JOB_T Job;
+
+	memset(&Job, 0, sizeof(Job));
+	CHECK(run_copy(&Job, "0:ERR.BIN", 3) == FR_OK, "copy with a card read error");
+	CHECK(Job.Retries == 1, "read error retried");
+	CHECK(verify_file("0:ERR.BIN", TEST_FILE_SIZE), "copy data after the read error");
+	f_unlink("0:ERR.BIN");
+}
+
+static void test_lost_irq(void)
+{
+	COPY_JOB_T Job;
+
+	memset(&Job, 0, sizeof(Job));
+	CHECK(run_copy(&Job, "0:IRQ.BIN", -3) == FR_OK, "copy with a lost card interrupt");
+	CHECK(Job.Retries == 1, "read aborted at its deadline and retried");
+	CHECK(Job.ElapsedMs >= COPY_READ_TIMEOUT_MS, "abort after the deadline");
+	CHECK(!Chip_SDMMC_XferPending(LPC_SDMMC), "no card read left");
+	CHECK(verify_file("0:IRQ.BIN", TEST_FILE_SIZE), "copy data after the lost interrupt");
+	f_unlink("0:IRQ.BIN");
+}
+
+static void test_resume(void)
+{
+	COPY_JOB_T Job;
+
+	/* what a copy stopped in the middle leaves, the resume point need not be block aligned */
+	CopyEngine_InitJob(&Job, "1:SRC.BIN", "0:DST.BIN", TEST_FILE_SIZE, copy_progress);
+	Job.Done = (TEST_FILE_SIZE / 2) + 123;
+	CHECK(f_open(&TestFile, "0:DST.BIN", FA_WRITE) == FR_OK, "open the copy");
+	CHECK((f_lseek(&TestFile, Job.Done + 5000) == FR_OK) && (f_truncate(&TestFile) == FR_OK), "cut the copy");
+	CHECK(f_close(&TestFile) == FR_OK, "close the copy");
+
+	CHECK(run_copy(&Job, "0:DST.BIN", 0) == FR_OK, "resumed copy");
+	CHECK(Job.Done == TEST_FILE_SIZE, "resumed copy done");
+	CHECK(verify_file("0:DST.BIN", TEST_FILE_SIZE), "resumed copy data");
+}
+
+/* Fails every card read from the given progress call on, until the copy engine gives up */
+static void sync_progress(const COPY_JOB_T *pJob)
+{
+	ProgressCalls++;
+	if (InjectAt && (ProgressCalls >= InjectAt)) {
+		SdmmcSim_InjectError(MMC_READ_MULTIPLE_BLOCK, MCI_INT_DCRC);
+	}
+}
+
+static FRESULT run_sync(SYNC_JOB_T *pSync, uint8_t flags, int32_t stop)
+{
+	FRESULT rc;
+
+	ProgressCalls = 0;
+	InjectAt = stop;
+	SyncEngine_InitJob(pSync, COPY_CARD_DRIVE, 0, flags, sync_progress);
+	rc = SyncEngine_Run(pSync);
+	InjectAt = 0;
+	CHECK(!VolumeLocks[0] && !VolumeLocks[1], "volumes released after the sync");
+	return rc;
+}
+
+/* Size of the manifest in records, the record size is in its header */
+static DWORD manifest_records(void)
+{
+	DWORD hdr[2], records = 0;
+	UINT br;
+
+	if (f_open(&TestFile, "0:" SYNC_MANIFEST_NAME, FA_READ) != FR_OK) {
+		return 0;
+	}
+	if ((f_read(&TestFile, hdr, sizeof(hdr), &br) == FR_OK) && (br == sizeof(hdr)) && hdr[1]) {
+		records = (DWORD) ((f_size(&TestFile) - sizeof(hdr)) / hdr[1]);
+	}
+	f_close(&TestFile);
+	return records;
+}
+
+static void test_sync_resume(void)
+{
+	SYNC_JOB_T Sync;
+
+	/* the card holds the source alone */
+	f_unlink("1:DUP.BIN");
+	f_unlink("1:FILL.BIN");
+
+	CHECK(run_sync(&Sync, 0, TEST_SYNC_STOP) != FR_OK, "sync stopped by card read errors");
+	CHECK((Sync.Files == 1) && (Sync.Copied == 0), "stopped sync copied nothing");
+	CHECK((Sync.Bytes > 0) && (Sync.Bytes < TEST_FILE_SIZE), "stopped sync got part of the way");
+	CHECK(manifest_records() == 1, "checkpoint of the stopped copy in the manifest");
+
+	CHECK(run_sync(&Sync, 0, 0) == FR_OK, "resumed sync");
+	CHECK((Sync.Copied == 1) && (Sync.Resumed == 1), "copy resumed from its checkpoint");
+	CHECK((Sync.Bytes > 0) && (Sync.Bytes < TEST_FILE_SIZE), "only the rest copied");
+	CHECK(verify_file("0:SRC.BIN", TEST_FILE_SIZE), "resumed sync data");
+
+	/* up to date, the hash of the source is added to its record */
+	CHECK(run_sync(&Sync, SYNC_HASH, 0) == FR_OK, "sync with hashes");
+	CHECK((Sync.Unchanged == 1) && (Sync.Copied == 0) && (Sync.Bytes == 0), "nothing to copy");
+	CHECK(run_sync(&Sync, SYNC_HASH, 0) == FR_OK, "second sync with hashes");
+	CHECK(Sync.Unchanged == 1, "hashed copy unchanged");
+}
+
+static void test_sync_overflow(void)
+{
+	SYNC_JOB_T Sync;
+	char path[16];
+	DWORD hdr[2];
+	UINT bw, i;
+	int ok = 1;
+
+	CHECK(f_mkdir("1:MANY") == FR_OK, "make the directory");
+	for (i = 0; i < TEST_SYNC_FILES; i++) {
+		sprintf(path, "1:MANY/F%u.BIN", i);
+		fill_pattern(Buffer, 100 + i, 0);
+		ok &= (f_open(&TestFile, path, FA_CREATE_ALWAYS | FA_WRITE) == FR_OK) &&
+			  (f_write(&TestFile, Buffer, 100 + i, &bw) == FR_OK) && (f_close(&TestFile) == FR_OK);
+	}
+	CHECK(ok, "write the small files");
+
+	/* records for the first files only, the others are copied all the same */
+	CHECK(run_sync(&Sync, 0, 0) == FR_OK, "sync of more files than records");
+	CHECK((Sync.Files == TEST_SYNC_FILES + 1) && (Sync.Copied == TEST_SYNC_FILES) && (Sync.Unchanged == 1),
+		  "small files copied");
+	CHECK(manifest_records() == SYNC_RECORDS_MAX, "manifest full");
+	CHECK(verify_file("0:MANY/F9.BIN", 109), "small file data");
+	CHECK(run_sync(&Sync, 0, 0) == FR_OK, "sync with the manifest full");
+	CHECK((Sync.Unchanged == TEST_SYNC_FILES + 1) && (Sync.Copied == 0), "all unchanged with the manifest full");
+
+	/* a manifest of a build taking more records: the records past the index are kept when one goes */
+	ok = (f_open(&TestFile, "0:" SYNC_MANIFEST_NAME, FA_READ | FA_WRITE) == FR_OK) &&
+		 (f_read(&TestFile, hdr, sizeof(hdr), &bw) == FR_OK) && (hdr[1] <= sizeof(Buffer)) &&
+		 (f_read(&TestFile, Buffer, hdr[1], &bw) == FR_OK) && (bw == hdr[1]) &&
+		 (f_lseek(&TestFile, f_size(&TestFile)) == FR_OK);
+	for (i = 0; ok && (i < 2); i++) {
+		ok = (f_write(&TestFile, Buffer, hdr[1], &bw) == FR_OK) && (bw == hdr[1]);
+	}
+	CHECK((f_close(&TestFile) == FR_OK) && ok, "add records past the index");
+	CHECK(f_unlink("1:MANY/F0.BIN") == FR_OK, "remove a source file");
+	CHECK(run_sync(&Sync, 0, 0) == FR_OK, "sync with the manifest overflowing");
+	CHECK((Sync.Files == TEST_SYNC_FILES) && (Sync.Unchanged == TEST_SYNC_FILES) && (Sync.Copied == 0),
+		  "all unchanged with the manifest overflowing");
+	CHECK(manifest_records() == SYNC_RECORDS_MAX + 2, "overflowing manifest not compacted");
+}
+
+static void test_same_volume(void)
+{
+	COPY_JOB_T Job;
+
+	/* the destination on the card too: no read in the background, it would hold the volume of the writes */
+	memset(&Job, 0, sizeof(Job));
+	CHECK(run_copy(&Job, "1:DUP.BIN", 0) == FR_OK, "copy on the card");
+	CHECK(CardReads == 0, "no background read on one volume");
+	CHECK(verify_file("1:DUP.BIN", TEST_FILE_SIZE), "copy data on the card");
+}
+
+int main(int argc, char *argv[])
+{
+	const char *CardImage = (argc > 1) ? argv[1] : "copy_engine_test_sd.img";
+	const char *DiskImage = (argc > 2) ? argv[2] : "copy_engine_test_usb.img";
+	SIM_USB_DEVICE_T *pDevice;
+	SDMMC_SIM_CFG_T cfg;
+
+	if (!make_image(CardImage, TEST_IMAGE_MB) || !make_image(DiskImage, TEST_IMAGE_MB) ||
+		((pDevice = Sim_BOTDeviceCreate(DiskImage, 512)) == NULL)) {
+		printf("Cannot create the images\r\n");
+		return 1;
+	}
+
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.Image = CardImage;
+	cfg.Type = SDMMC_SIM_SDHC;
+	cfg.BaseClock = 100000000;
+	cfg.CmdLatency = 5;
+	cfg.ReadLatency = 100;
+	cfg.WriteBusy = 200;
+	cfg.WriteBusyBlock = 5;
+	cfg.SwitchBusy = 100;
+	cfg.InitPolls = 2;
+	cfg.HighSpeed = 1;
+	cfg.Cmd23 = 1;
+	if (SdmmcSim_Start(&cfg) == NULL) {
+		printf("Cannot start the card model\r\n");
+		return 1;
+	}
+	SystemCoreClock = cfg.BaseClock;
+	SdmmcSim_SetIrqHandler(SDIO_IRQHandler);
+	sdcardinfo.evsetup_cb = sdmmc_setup_wakeup;
+	sdcardinfo.waitfunc_cb = sdmmc_irq_driven_wait;
+	sdcardinfo.msdelay_func = sdmmc_waitms;
+	Chip_SDMMC_Init(LPC_SDMMC);
+
+	USB_Init(TEST_PORT, USB_MODE_Host);
+	Sim_AttachDevice(TEST_PORT, pDevice);
+
+	if ((f_mount(0, &UsbFS) != FR_OK) || (f_mkfs(0, 0, 0) != FR_OK) ||
+		(f_mount(COPY_CARD_DRIVE, &CardFS) != FR_OK) || (f_mkfs(COPY_CARD_DRIVE, 0, 4096) != FR_OK)) {
+		printf("Cannot format the disks\r\n");
+		return 1;
+	}
+	if (!write_source("1:SRC.BIN", TEST_FILE_SIZE)) {
+		printf("Writing the source file failed\r\n");
+		return 1;
+	}
+
+	test_copy();
+	test_read_error();
+	test_lost_irq();
+	test_resume();
+	test_same_volume();
+	test_sync_resume();
+	test_sync_overflow();
+
+	f_mount(0, NULL);
+	f_mount(COPY_CARD_DRIVE, NULL);
+	Sim_DetachDevice(TEST_PORT);
+	USB_Disable(TEST_PORT, USB_MODE_Host);
+	Sim_BOTDeviceDestroy(pDevice);
+	SdmmcSim_Stop();
+
+	printf("%lu failures\r\n", (unsigned long) Failures);
+	return Failures ? 1 : 0;
+}
@@ -0,0 +1,1025 @@
+/*
+ * @brief Test of FatFs on RAM disks
+ *
+ * @note
+ * Copyright(C) NXP Semiconductors, 2012
+ * All rights reserved.
+ *
+ * @par
+ * Software that is described herein is for illustrative purposes only
+ * which provides customers with programming information regarding the
+ * LPC products.  This software is supplied "AS IS" without any warranties of
+ * any kind, and NXP Semiconductors and its licensor disclaim any and
+ * all warranties, express or implied, including all implied warranties of
+ * merchantability, fitness for a particular purpose and non-infringement of
+ * intellectual property rights.  NXP Semiconductors assumes no responsibility
+ * or liability for the use of the software, conveys no license or rights under any
+ * patent, copyright, mask work right, or any other intellectual property rights in
+ * or to any products. NXP Semiconductors reserves the right to make changes
+ * in the software without notification. NXP Semiconductors also makes no
+ * representation or warranty that such application will be suitable for the
+ * specified use without further testing or modification.
+ *
+ * @par
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation is hereby granted, under NXP Semiconductors' and its
+ * licensor's relevant copyrights in the software, without fee, provided that it
+ * is used in conjunction with NXP Semiconductors microcontrollers.  This
+ * copyright, permission, and disclaimer notice must appear in all copies of
+ * this code.
+ */
+
+/* Usage: fatfs_sim_test
+ *
+ * ff.c runs on two RAM disks in place of diskio.c, with the options of ffconf.h. The disks count the
+ * calls made to them and fail a chosen write, the tests check the allocator and the caches of ff.c on
+ * the volumes they lay out. FAT volumes are made by f_mkfs(), exFAT ones by format_exfat() here.
+ * The volume locks are those of ff_sync.c, with calls nested in a disk read. Exits non-zero on any
+ * failure. */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ff.h"
+#include "ff_sync.h"
+#include "diskio.h"
+
+#define TEST_SECTORS        16384			/* 8MB per disk */
+#define TEST_SECTOR_SIZE    512
+
+/* exFAT volume made by format_exfat(): 4KB clusters, the bitmap, the up-case table and the root
+ * directory in the first three clusters */
+#define EXFAT_FAT_OFS       24				/* after the boot region and its backup */
+#define EXFAT_HEAP_OFS      128
+#define EXFAT_CLUSTER_SHIFT 3
+#define EXFAT_CLUSTERS      ((TEST_SECTORS - EXFAT_HEAP_OFS) >> EXFAT_CLUSTER_SHIFT)
+#define EXFAT_FAT_SIZE      (((EXFAT_CLUSTERS + 2) * 4 + TEST_SECTOR_SIZE - 1) / TEST_SECTOR_SIZE)
+#define EXFAT_UPCASE_CHARS  128
+
+/* RAM disk and what was asked of it */
+typedef struct {
+	BYTE Data[TEST_SECTORS][TEST_SECTOR_SIZE];
+	uint32_t Reads;							/* disk_read() calls */
+	uint32_t Writes;						/* disk_write() calls */
+	uint32_t SectorWrites[TEST_SECTORS];	/* times each sector was written */
+	UINT MaxRead;							/* most sectors in one disk_read() */
+	UINT MaxWrite;							/* most sectors in one disk_write() */
+	DWORD FailSector;						/* a write to this sector fails once, 0 for none */
+} RAM_DISK_T;
+
+static RAM_DISK_T Disks[_VOLUMES];
+static void (*DiskHook)(void);			/* run once from the next disk_read() of HookDrive */
+static BYTE HookDrive;
+static uint32_t SimIPSR;					/* exception number FatFs runs at, 0 for thread mode */
+static uint32_t SimCounter;
+static uint32_t Failures;
+
+static FATFS TestFS, TestFS1;
+static FIL TestFile, TestFile2;
+static BYTE Buffer[64 * TEST_SECTOR_SIZE];
+static BYTE LargeBuffer[2][600 * TEST_SECTOR_SIZE];
+
+#define CHECK(cond, what) \
+	do { \
+		if (!(cond)) { \
+			printf("  FAIL %s (%s:%d)\r\n", (what), __FILE__, __LINE__); \
+			Failures++; \
+		} \
+	} while (0)
+
+/*---------- Disk functions of FatFs ----------*/
+DSTATUS disk_initialize(BYTE drv)
+{
+	return (drv < _VOLUMES) ? 0 : STA_NOINIT;
+}
+
+DSTATUS disk_status(BYTE drv)
+{
+	return (drv < _VOLUMES) ? 0 : STA_NOINIT;
+}
+
+DRESULT disk_read(BYTE drv, BYTE *buff, DWORD sector, UINT count)
+{
+	RAM_DISK_T *pDisk = &Disks[drv];
+
+	if ((drv >= _VOLUMES) || !count || (sector + count > TEST_SECTORS)) {
+		return RES_PARERR;
+	}
+	if (DiskHook && (drv == HookDrive)) {
+		void (*hook)(void) = DiskHook;
+
+		DiskHook = NULL;
+		hook();
+	}
+	pDisk->Reads++;
+	if (count > pDisk->MaxRead) {
+		pDisk->MaxRead = count;
+	}
+	memcpy(buff, pDisk->Data[sector], count * TEST_SECTOR_SIZE);
+	return RES_OK;
+}
+
+DRESULT disk_write(BYTE drv, const BYTE *buff, DWORD sector, UINT count)
+{
+	RAM_DISK_T *pDisk = &Disks[drv];
+	UINT i;
+
+	if ((drv >= _VOLUMES) || !count || (sector + count > TEST_SECTORS)) {
+		return RES_PARERR;
+	}
+	pDisk->Writes++;
+	if (count > pDisk->MaxWrite) {
+		pDisk->MaxWrite = count;
+	}
+	for (i = 0; i < count; i++) {
+		pDisk->SectorWrites[sector + i]++;
+	}
+	if (pDisk->FailSector && (pDisk->FailSector >= sector) && (pDisk->FailSector < sector + count)) {
+		pDisk->FailSector = 0;
+		return RES_ERROR;
+	}
+	memcpy(pDisk->Data[sector], buff, count * TEST_SECTOR_SIZE);
+	return RES_OK;
+}
+
+DRESULT disk_ioctl(BYTE drv, BYTE ctrl, void *buff)
+{
+	if (drv >= _VOLUMES) {
+		return RES_PARERR;
+	}
+	switch (ctrl) {
+	case CTRL_SYNC:
+		return RES_OK;
+
+	case GET_SECTOR_COUNT:
+		*(DWORD *) buff = TEST_SECTORS;
+		return RES_OK;
+
+	case GET_SECTOR_SIZE:
+		*(WORD *) buff = TEST_SECTOR_SIZE;
+		return RES_OK;
+
+	case GET_BLOCK_SIZE:
+		*(DWORD *) buff = 1;
+		return RES_OK;
+
+	default:
+		return RES_PARERR;
+	}
+}
+
+DWORD get_fattime(void)
+{
+	return ((DWORD) (2012 - 1980) << 25) | (1UL << 21) | (1UL << 16);
+}
+
+/*---------- Core of the volume locks of ff_sync.c ----------*/
+uint32_t SystemCoreClock = 1000000;
+
+uint32_t FatfsSim_GetIPSR(void)
+{
+	return SimIPSR;
+}
+
+/* The RI timer moves a millisecond each time it is read */
+uint32_t FatfsSim_GetCounter(void)
+{
+	SimCounter += SystemCoreClock / 1000;
+	return SimCounter;
+}
+
+/*---------- Helpers ----------*/
+/* Format drive 0 with one sector per cluster and mount it again */
+static int format_volume(void)
+{
+	memset(&Disks[0], 0, sizeof(Disks[0]));
+	return (f_mount(0, &TestFS) == FR_OK) && (f_mkfs(0, 1, TEST_SECTOR_SIZE) == FR_OK) &&
+		   (f_mount(0, &TestFS) == FR_OK);
+}
+
+/* Write a file of a number of clusters and return its first cluster, 0 on error */
+static DWORD write_file(const char *path, DWORD clusters)
+{
+	UINT chunk, bw;
+	DWORD left, sclust;
+
+	if (f_open(&TestFile, path, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK) {
+		return 0;
+	}
+	left = clusters * TestFS.csize * TEST_SECTOR_SIZE;		/* (volume mounted by now) */
+	while (left) {
+		chunk = (left > sizeof(Buffer)) ? sizeof(Buffer) : left;
+		memset(Buffer, (int) left, chunk);
+		if ((f_write(&TestFile, Buffer, chunk, &bw) != FR_OK) || (bw != chunk)) {
+			f_close(&TestFile);
+			return 0;
+		}
+		left -= chunk;
+	}
+	sclust = TestFile.sclust;
+	return (f_close(&TestFile) == FR_OK) ? sclust : 0;
+}
+
+static DWORD free_clusters(void)
+{
+	DWORD nfree;
+	FATFS *fs;
+
+	return (f_getfree("0:", &nfree, &fs) == FR_OK) ? nfree : 0xFFFFFFFF;
+}
+
+/*---------- Free cluster map ----------*/
+/* Lay out A(1) GAP(64) B(1) HOLE(1) C(1) RUN(100) and a filler to the end of the volume, then free GAP,
+ * HOLE and RUN. The next allocation starts from the end of the volume. Returns the first cluster of GAP. */
+static DWORD layout_gaps(void)
+{
+	DWORD gap, nfree;
+
+	if (!format_volume() || !write_file("0:A.BIN", 1) || !(gap = write_file("0:GAP.BIN", 64)) ||
+		!write_file("0:B.BIN", 1) || !write_file("0:HOLE.BIN", 1) || !write_file("0:C.BIN", 1) ||
+		!write_file("0:RUN.BIN", 100)) {
+		return 0;
+	}
+	nfree = free_clusters();
+	if (!nfree || (nfree == 0xFFFFFFFF) || !write_file("0:FILL.BIN", nfree) || free_clusters() ||
+		(f_unlink("0:GAP.BIN") != FR_OK) || (f_unlink("0:HOLE.BIN") != FR_OK) ||
+		(f_unlink("0:RUN.BIN") != FR_OK)) {
+		return 0;
+	}
+	return gap;
+}
+
+/* A write of 64 clusters takes GAP in one run and fails on the disk */
+static FRESULT write_aborted(DWORD gap)
+{
+	FRESULT res;
+	UINT bw;
+
+	if (f_open(&TestFile, "0:BIG.BIN", FA_CREATE_ALWAYS | FA_WRITE) != FR_OK) {
+		return FR_INT_ERR;
+	}
+	Disks[0].FailSector = TestFS.database + (gap + 8 - 2) * TestFS.csize;
+	res = f_write(&TestFile, Buffer, sizeof(Buffer), &bw);
+	Disks[0].FailSector = 0;
+	f_close(&TestFile);
+	return res;
+}
+
+/* The run size wanted by the aborted write must not be applied to the next allocation: the directory
+ * created after it goes to HOLE, not to the start of RUN. */
+static void test_freemap_abort(void)
+{
+	DWORD gap;
+	DIR dir;
+
+	printf("Free map: allocation after an aborted write\r\n");
+	gap = layout_gaps();
+	CHECK(gap != 0, "volume laid out");
+	CHECK(write_aborted(gap) == FR_DISK_ERR, "write fails on the disk");
+	CHECK(TestFS.alloc_hint == 0, "run size dropped on the error");
+
+	CHECK(f_mkdir("0:SUB") == FR_OK, "create a directory");
+	CHECK((f_opendir(&dir, "0:SUB") == FR_OK) && (dir.sclust == gap + 65), "directory in the first free cluster");
+}
+
+/* A freed group must be found again whatever the map said of it before */
+static void test_freemap_refill(void)
+{
+	DWORD gap, nfree;
+
+	printf("Free map: freed clusters found again after an aborted write\r\n");
+	gap = layout_gaps();
+	CHECK(gap != 0, "volume laid out");
+	CHECK(f_unlink("0:FILL.BIN") == FR_OK, "delete the filler");
+	CHECK(write_aborted(gap) == FR_DISK_ERR, "write fails on the disk");
+	CHECK(f_unlink("0:BIG.BIN") == FR_OK, "delete the failed file");
+
+	nfree = free_clusters();
+	CHECK(write_file("0:ALL.BIN", nfree) != 0, "every free cluster allocated");
+	CHECK(free_clusters() == 0, "volume full");
+}
+
+/*---------- Window cache ----------*/
+/* Sector writes to the FAT area, all copies */
+static uint32_t fat_writes(void)
+{
+	uint32_t i, n = 0;
+
+	for (i = 0; i < TestFS.fsize * TestFS.n_fats; i++) {
+		n += Disks[0].SectorWrites[TestFS.fatbase + i];
+	}
+	return n;
+}
+
+/* The FAT copies on the disk are the same */
+static int fat_mirrored(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < TestFS.fsize; i++) {
+		if (memcmp(Disks[0].Data[TestFS.fatbase + i], Disks[0].Data[TestFS.fatbase + TestFS.fsize + i],
+				   TEST_SECTOR_SIZE)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* Cluster k of file f holds bytes f * 31 + k */
+static int append_cluster(FIL *pFile, int f, DWORD k)
+{
+	UINT bw;
+
+	memset(Buffer, (int) (f * 31 + k), TEST_SECTOR_SIZE);
+	return (f_write(pFile, Buffer, TEST_SECTOR_SIZE, &bw) == FR_OK) && (bw == TEST_SECTOR_SIZE);
+}
+
+static int check_clusters(const char *path, int f, DWORD clusters)
+{
+	DWORD k;
+	UINT br, i;
+	int ok;
+
+	if (f_open(&TestFile, path, FA_READ) != FR_OK) {
+		return 0;
+	}
+	ok = (TestFile.fsize == clusters * TEST_SECTOR_SIZE);
+	for (k = 0; ok && (k < clusters); k++) {
+		ok = (f_read(&TestFile, Buffer, TEST_SECTOR_SIZE, &br) == FR_OK) && (br == TEST_SECTOR_SIZE);
+		for (i = 0; ok && (i < TEST_SECTOR_SIZE); i++) {
+			ok = (Buffer[i] == (BYTE) (f * 31 + k));
+		}
+	}
+	return (f_close(&TestFile) == FR_OK) && ok;
+}
+
+/* Two files grown a cluster at a time in turn over 8 FAT sectors: the dirty FAT sectors parked behind the
+ * window are written once they are evicted, to both copies, and the rest on close */
+static void test_wincache_mirror(void)
+{
+	DWORD k;
+	uint32_t writes;
+	int ok = 1;
+
+	printf("Window cache: FAT mirror write-back\r\n");
+	CHECK(format_volume(), "format");
+	CHECK(f_open(&TestFile, "0:ODD.BIN", FA_CREATE_ALWAYS | FA_WRITE) == FR_OK, "open a file");
+	CHECK(f_open(&TestFile2, "0:EVEN.BIN", FA_CREATE_ALWAYS | FA_WRITE) == FR_OK, "open a second file");
+	CHECK(TestFS.n_fats == 2, "two FAT copies");
+
+	writes = fat_writes();
+	for (k = 0; ok && (k < 1000); k++) {
+		ok = append_cluster(&TestFile, 1, k) && append_cluster(&TestFile2, 2, k);
+	}
+	CHECK(ok, "files grown");
+	writes = fat_writes() - writes;
+	CHECK(writes > 0, "dirty FAT sectors evicted");
+	CHECK(writes <= 2 * 16, "each FAT sector written about once");
+	CHECK(fat_mirrored(), "evicted FAT sectors on both copies");
+
+	CHECK((f_close(&TestFile) == FR_OK) && (f_close(&TestFile2) == FR_OK), "close");
+	CHECK(fat_mirrored(), "FAT copies the same after close");
+	CHECK(f_unlink("0:ODD.BIN") == FR_OK, "delete a file");
+	CHECK(fat_mirrored(), "FAT copies the same after delete");
+
+	CHECK(f_mount(0, &TestFS) == FR_OK, "remount");
+	CHECK(check_clusters("0:EVEN.BIN", 2, 1000), "file read back");
+	CHECK(free_clusters() == TestFS.n_fatent - 2 - 1000, "free clusters after remount");
+}
+
+/*---------- Directory index ----------*/
+static int create_files(const char *dir, UINT first, UINT count)
+{
+	char path[32];
+	UINT i;
+
+	for (i = first; i < first + count; i++) {
+		sprintf(path, "0:%s/F%u.TXT", dir, i);
+		if ((f_open(&TestFile, path, FA_CREATE_NEW | FA_WRITE) != FR_OK) || (f_close(&TestFile) != FR_OK)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+#define FIND_ERROR          0xFFFFFFFF
+
+/* Look up files first..first+count-1, every step-th one deleted. Returns the sector reads, FIND_ERROR
+ * if one is found wrong. */
+static uint32_t find_files(const char *dir, UINT first, UINT count, UINT step)
+{
+	char path[32];
+	FILINFO info;
+	FRESULT res;
+	uint32_t reads = Disks[0].Reads;
+	UINT i;
+
+	for (i = first; i < first + count; i++) {
+		sprintf(path, "0:%s/F%u.TXT", dir, i);
+		res = f_stat(path, &info);
+		if (res != ((step && !(i % step)) ? FR_NO_FILE : FR_OK)) {
+			return FIND_ERROR;
+		}
+	}
+	return Disks[0].Reads - reads;
+}
+
+static DWORD dir_cluster(const char *path)
+{
+	DIR dir;
+
+	return (f_opendir(&dir, path) == FR_OK) ? dir.sclust : 0;
+}
+
+/* 600 files in a directory spanning 38 sectors, more than the window cache holds: once the directory is
+ * indexed a lookup reads at most one sector, creations and deletions keep the index right, and a lookup in
+ * another directory of more than a sector or a remount drops it */
+static void test_dirindex(void)
+{
+	char path[32];
+	DWORD sub;
+	uint32_t reads;
+	UINT i;
+
+	printf("Directory index: large directory\r\n");
+	CHECK(format_volume() && (f_mkdir("0:BIG") == FR_OK), "format and create a directory");
+	CHECK(create_files("BIG", 0, 600), "create 600 files");
+	sub = dir_cluster("0:BIG");
+	CHECK(TestFS.dix_valid && (TestFS.dix_clu == sub), "directory indexed");
+
+	reads = find_files("BIG", 0, 600, 0);
+	CHECK(reads <= 600, "at most a sector read a lookup");
+	reads = Disks[0].Reads;
+	CHECK(f_stat("0:BIG/NONE.TXT", NULL) == FR_NO_FILE, "missing file not found");
+	CHECK(Disks[0].Reads - reads <= 2, "missing file found missing on the index");
+
+	for (i = 0; i < 600; i += 3) {
+		sprintf(path, "0:BIG/F%u.TXT", i);
+		CHECK(f_unlink(path) == FR_OK, "delete");
+	}
+	CHECK(find_files("BIG", 0, 600, 3) != FIND_ERROR, "deleted files gone, the others found");
+	CHECK(create_files("BIG", 1000, 200), "create in the deleted entries");
+	CHECK(find_files("BIG", 1000, 200, 0) <= 200, "new files found on the index");
+	CHECK(find_files("BIG", 0, 600, 3) != FIND_ERROR, "old files still found");
+
+	CHECK((f_mkdir("0:OTHER") == FR_OK) && create_files("OTHER", 0, 20), "create a second directory");
+	CHECK(f_stat("0:OTHER/NONE.TXT", NULL) == FR_NO_FILE, "lookup in the second directory");
+	CHECK(TestFS.dix_valid && (TestFS.dix_clu == dir_cluster("0:OTHER")), "index moved to it");
+	CHECK(find_files("BIG", 1000, 200, 0) != FIND_ERROR, "files found after the index moved");
+	CHECK(f_stat("0:BIG/NONE.TXT", NULL) == FR_NO_FILE, "missing file not found");
+	CHECK(TestFS.dix_valid && (TestFS.dix_clu == sub), "directory indexed again on a whole scan");
+
+	CHECK(f_mount(0, &TestFS) == FR_OK, "remount");
+	CHECK(find_files("BIG", 0, 600, 3) != FIND_ERROR, "files found after remount");
+	CHECK(TestFS.dix_valid && (TestFS.dix_clu == sub), "directory indexed after remount");
+}
+
+/* A directory with more entries than the index takes is not indexed and still searched */
+static void test_dirindex_full(void)
+{
+	UINT count = _DIRINDEX_SIZE / 3 / 4 * 3 + 64;
+
+	printf("Directory index: directory too large for the index\r\n");
+	CHECK(format_volume() && (f_mkdir("0:HUGE") == FR_OK), "format and create a directory");
+	CHECK(create_files("HUGE", 0, count), "create the files");
+	CHECK(find_files("HUGE", 0, count, 0) != FIND_ERROR, "files found");
+	CHECK(!TestFS.dix_valid || (TestFS.dix_clu != dir_cluster("0:HUGE")), "directory not indexed");
+}
+
+/*---------- Multiple sector transfers ----------*/
+/* A contiguous file is written and read in transfers of more than 255 sectors, the old clip of the BYTE
+ * sector count, and a fragmented one in one transfer a run */
+static void test_multi_sector(void)
+{
+	DWORD gap;
+	uint32_t calls;
+	UINT i, bw;
+
+	printf("Disk transfers of many sectors\r\n");
+	for (i = 0; i < sizeof(LargeBuffer[0]); i++) {
+		LargeBuffer[0][i] = (BYTE) (i * 7 + (i >> 9));
+	}
+	CHECK(format_volume(), "format");
+	CHECK(f_open(&TestFile, "0:LARGE.BIN", FA_CREATE_ALWAYS | FA_WRITE) == FR_OK, "open");
+	calls = Disks[0].Writes;
+	CHECK((f_write(&TestFile, LargeBuffer[0], sizeof(LargeBuffer[0]), &bw) == FR_OK) &&
+		  (bw == sizeof(LargeBuffer[0])), "write 600 sectors");
+	CHECK(Disks[0].Writes - calls <= 2, "in one disk write");
+	CHECK(Disks[0].MaxWrite == 600, "of 600 sectors");
+	CHECK(f_close(&TestFile) == FR_OK, "close");
+
+	CHECK(f_open(&TestFile, "0:LARGE.BIN", FA_READ) == FR_OK, "open");
+	calls = Disks[0].Reads;
+	CHECK((f_read(&TestFile, LargeBuffer[1], sizeof(LargeBuffer[1]), &bw) == FR_OK) &&
+		  (bw == sizeof(LargeBuffer[1])), "read 600 sectors");
+	CHECK(Disks[0].Reads - calls <= 2, "in one disk read");
+	CHECK(Disks[0].MaxRead == 600, "of 600 sectors");
+	CHECK(f_close(&TestFile) == FR_OK, "close");
+	CHECK(!memcmp(LargeBuffer[0], LargeBuffer[1], sizeof(LargeBuffer[0])), "data read back");
+
+	/* Free space: GAP of 64 clusters, HOLE of one, then the rest of the volume */
+	gap = layout_gaps();
+	CHECK(gap != 0, "volume laid out");
+	CHECK(f_unlink("0:FILL.BIN") == FR_OK, "delete the filler");
+	CHECK(f_open(&TestFile, "0:FRAG.BIN", FA_CREATE_ALWAYS | FA_WRITE) == FR_OK, "open");
+	CHECK(f_write(&TestFile, LargeBuffer[0], 64 * TEST_SECTOR_SIZE, &bw) == FR_OK, "fill the gap");
+	CHECK(TestFile.sclust == gap, "first part in the gap");
+	CHECK((f_write(&TestFile, LargeBuffer[0] + 64 * TEST_SECTOR_SIZE, sizeof(LargeBuffer[0]) - 64 * TEST_SECTOR_SIZE,
+				   &bw) == FR_OK) && (bw == sizeof(LargeBuffer[0]) - 64 * TEST_SECTOR_SIZE), "write the rest");
+	CHECK(f_close(&TestFile) == FR_OK, "close");
+
+	memset(LargeBuffer[1], 0, sizeof(LargeBuffer[1]));
+	CHECK(f_open(&TestFile, "0:FRAG.BIN", FA_READ) == FR_OK, "open");
+	calls = Disks[0].Reads;
+	CHECK((f_read(&TestFile, LargeBuffer[1], sizeof(LargeBuffer[1]), &bw) == FR_OK) &&
+		  (bw == sizeof(LargeBuffer[1])), "read the fragmented file");
+	CHECK(Disks[0].Reads - calls <= 4, "one disk read a fragment");
+	CHECK(f_close(&TestFile) == FR_OK, "close");
+	CHECK(!memcmp(LargeBuffer[0], LargeBuffer[1], sizeof(LargeBuffer[0])), "fragmented data read back");
+}
+
+/*---------- Contiguous allocation ----------*/
+/* f_expand() on a new file, returns its first cluster, 0 if refused */
+static DWORD expand_file(const char *path, DWORD clusters, FRESULT *pRes)
+{
+	DWORD sclust = 0;
+
+	*pRes = f_open(&TestFile, path, FA_CREATE_ALWAYS | FA_WRITE);
+	if (*pRes == FR_OK) {
+		*pRes = f_expand(&TestFile, (FSIZE_t) clusters * TestFS.csize * TEST_SECTOR_SIZE, 1);
+		sclust = TestFile.sclust;
+		if (f_close(&TestFile) != FR_OK) {
+			*pRes = FR_INT_ERR;
+		}
+	}
+	return sclust;
+}
+
+/* Free clusters counted on the FAT, not taken from the free count of the volume */
+static DWORD fat_free_clusters(void)
+{
+	TestFS.free_clust = 0xFFFFFFFF;
+	return free_clusters();
+}
+
+/* The run goes to the first free space long enough, past shorter ones */
+static void test_expand_fragmented(void)
+{
+	DWORD gap, nfree;
+	FRESULT res;
+
+	printf("Contiguous allocation: fragmented volume\r\n");
+	gap = layout_gaps();
+	CHECK(gap != 0, "volume laid out");
+	nfree = free_clusters();
+	CHECK(expand_file("0:E80.BIN", 80, &res) == gap + 67, "80 clusters in RUN, past GAP and HOLE");
+	CHECK(res == FR_OK, "expanded");
+	CHECK(expand_file("0:E64.BIN", 64, &res) == gap, "64 clusters in GAP");
+	CHECK(expand_file("0:E20.BIN", 20, &res) == gap + 67 + 80, "20 clusters in the rest of RUN");
+	CHECK(expand_file("0:E2.BIN", 2, &res) == 0, "no run of 2 left");
+	CHECK(res == FR_DENIED, "refused");
+	CHECK((free_clusters() == nfree - 164) && (fat_free_clusters() == nfree - 164), "free count");
+	CHECK(f_mount(0, &TestFS) == FR_OK, "remount");
+	CHECK(check_clusters("0:E2.BIN", 0, 0), "refused file empty");
+}
+
+/* The only run long enough holds the search start: it is followed round the end of the volume */
+static void test_expand_wrap(void)
+{
+	DWORD gap;
+	FRESULT res;
+
+	printf("Contiguous allocation: run across the search start\r\n");
+	gap = layout_gaps();
+	CHECK(gap != 0, "volume laid out");
+	CHECK(expand_file("0:R.BIN", 100, &res) == gap + 67, "RUN taken");
+	CHECK(expand_file("0:Y.BIN", 40, &res) == gap, "start of GAP taken");
+	CHECK((f_unlink("0:Y.BIN") == FR_OK) && (TestFS.last_clust == gap + 39), "freed, the search starts in GAP");
+	CHECK(expand_file("0:E64.BIN", 64, &res) == gap, "64 clusters in GAP");
+	CHECK(res == FR_OK, "expanded");
+	CHECK(free_clusters() == 1, "only HOLE left");
+}
+
+/* A full volume refuses the run and a disk error while linking it gives it all back */
+static void test_expand_full(void)
+{
+	DWORD nfree, sclust;
+	FRESULT res;
+
+	printf("Contiguous allocation: full volume and disk error\r\n");
+	CHECK(format_volume(), "format");
+	nfree = free_clusters();
+	Disks[0].FailSector = TestFS.fatbase + 6;	/* FAT16 entries of clusters 1536 to 1791 */
+	CHECK(expand_file("0:ERR.BIN", 3000, &res) == 0, "disk error while linking");
+	CHECK(res == FR_DISK_ERR, "reported");
+	CHECK(!Disks[0].FailSector, "the error hit the run");
+	CHECK(f_unlink("0:ERR.BIN") == FR_OK, "delete the file");
+	CHECK(f_mount(0, &TestFS) == FR_OK, "remount");
+	CHECK(fat_free_clusters() == nfree, "run given back");
+
+	CHECK(write_file("0:FILL.BIN", nfree) != 0, "fill the volume");
+	CHECK(expand_file("0:FULL.BIN", 1, &res) == 0, "no cluster left");
+	CHECK(res == FR_DENIED, "refused");
+	CHECK(expand_file("0:HUGE.BIN", TestFS.n_fatent, &res) == 0, "more than the volume");
+	CHECK(res == FR_DENIED, "refused");
+	CHECK(fat_free_clusters() == 0, "nothing freed or lost");
+	CHECK(f_unlink("0:FILL.BIN") == FR_OK, "delete the filler");
+	sclust = expand_file("0:ALL.BIN", nfree, &res);
+	CHECK((res == FR_OK) && (sclust == 2), "the whole volume in one run");
+	CHECK(fat_free_clusters() == 0, "volume full");
+}
+
+/*---------- exFAT ----------*/
+static void st_le(BYTE *p, uint64_t value, UINT bytes)
+{
+	while (bytes--) {
+		*p++ = (BYTE) value;
+		value >>= 8;
+	}
+}
+
+static DWORD exfat_sum(DWORD sum, const BYTE *p, UINT bytes, int boot)
+{
+	UINT i;
+
+	for (i = 0; i < bytes; i++) {
+		if (boot && ((i == 106) || (i == 107) || (i == 112))) {
+			continue;						/* VolumeFlags and PercentInUse */
+		}
+		sum = ((sum & 1) ? 0x80000000 : 0) + (sum >> 1) + p[i];
+	}
+	return sum;
+}
+
+/* Cluster c of the exFAT volume on drive 0 */
+static BYTE *exfat_cluster(DWORD c)
+{
+	return Disks[0].Data[EXFAT_HEAP_OFS + ((c - 2) << EXFAT_CLUSTER_SHIFT)];
+}
+
+/* Format drive 0 as exFAT the way the specification lays it out (f_mkfs() makes FAT volumes only) */
+static void format_exfat(void)
+{
+	BYTE *p;
+	DWORD sum;
+	UINT i;
+
+	memset(&Disks[0], 0, sizeof(Disks[0]));
+
+	/* Main boot region: boot sector, 8 extended boot sectors, OEM and reserved sectors, checksum */
+	p = Disks[0].Data[0];
+	p[0] = 0xEB; p[1] = 0x76; p[2] = 0x90;
+	memcpy(p + 3, "EXFAT   ", 8);
+	st_le(p + 72, TEST_SECTORS, 8);						/* VolumeLength */
+	st_le(p + 80, EXFAT_FAT_OFS, 4);					/* FatOffset */
+	st_le(p + 84, EXFAT_FAT_SIZE, 4);					/* FatLength */
+	st_le(p + 88, EXFAT_HEAP_OFS, 4);					/* ClusterHeapOffset */
+	st_le(p + 92, EXFAT_CLUSTERS, 4);					/* ClusterCount */
+	st_le(p + 96, 4, 4);								/* FirstClusterOfRootDirectory */
+	st_le(p + 100, 0x20121231, 4);						/* VolumeSerialNumber */
+	st_le(p + 104, 0x0100, 2);							/* FileSystemRevision 1.00 */
+	p[108] = 9;											/* BytesPerSectorShift */
+	p[109] = EXFAT_CLUSTER_SHIFT;						/* SectorsPerClusterShift */
+	p[110] = 1;											/* NumberOfFats */
+	p[111] = 0x80;										/* DriveSelect */
+	st_le(p + 510, 0xAA55, 2);
+	for (i = 1; i <= 8; i++) {
+		st_le(Disks[0].Data[i] + 508, 0xAA550000, 4);
+	}
+	for (sum = 0, i = 0; i < 11; i++) {
+		sum = exfat_sum(sum, Disks[0].Data[i], TEST_SECTOR_SIZE, !i);
+	}
+	for (i = 0; i < TEST_SECTOR_SIZE; i += 4) {
+		st_le(Disks[0].Data[11] + i, sum, 4);
+	}
+	memcpy(Disks[0].Data[12], Disks[0].Data[0], 12 * TEST_SECTOR_SIZE);	/* Backup boot region */
+
+	/* FAT: media and reserved entries, then the bitmap, the up-case table and the root, a cluster each */
+	p = Disks[0].Data[EXFAT_FAT_OFS];
+	st_le(p, 0xFFFFFFF8, 4);
+	for (i = 1; i <= 4; i++) {
+		st_le(p + i * 4, 0xFFFFFFFF, 4);
+	}
+
+	/* Allocation bitmap: clusters 2 to 4 in use */
+	exfat_cluster(2)[0] = 0x07;
+
+	/* Up-case table of the ASCII characters */
+	p = exfat_cluster(3);
+	for (i = 0; i < EXFAT_UPCASE_CHARS; i++) {
+		st_le(p + i * 2, ((i >= 'a') && (i <= 'z')) ? i - 'a' + 'A' : i, 2);
+	}
+	sum = exfat_sum(0, p, EXFAT_UPCASE_CHARS * 2, 0);
+
+	/* Root directory: empty volume label, bitmap and up-case table entries */
+	p = exfat_cluster(4);
+	p[0] = 0x83;
+	p[32] = 0x81;
+	st_le(p + 32 + 20, 2, 4);
+	st_le(p + 32 + 24, (EXFAT_CLUSTERS + 7) / 8, 8);
+	p[64] = 0x82;
+	st_le(p + 64 + 4, sum, 4);
+	st_le(p + 64 + 20, 3, 4);
+	st_le(p + 64 + 24, EXFAT_UPCASE_CHARS * 2, 8);
+}
+
+/* Cluster c marked in use on the bitmap on the disk */
+static int exfat_in_use(DWORD c)
+{
+	return (exfat_cluster(2)[(c - 2) / 8] >> ((c - 2) % 8)) & 1;
+}
+
+static int write_pattern(const char *path, BYTE mode, FSIZE_t ofs, UINT size)
+{
+	UINT bw;
+
+	return (f_open(&TestFile, path, mode) == FR_OK) && (f_lseek(&TestFile, ofs) == FR_OK) &&
+		   (f_write(&TestFile, LargeBuffer[0] + ofs, size, &bw) == FR_OK) && (bw == size) &&
+		   (f_close(&TestFile) == FR_OK);
+}
+
+static int check_pattern(const char *path, UINT size)
+{
+	UINT br;
+
+	memset(LargeBuffer[1], 0, size);
+	return (f_open(&TestFile, path, FA_READ) == FR_OK) && (TestFile.fsize == size) &&
+		   (f_read(&TestFile, LargeBuffer[1], size, &br) == FR_OK) && (br == size) &&
+		   (f_close(&TestFile) == FR_OK) && !memcmp(LargeBuffer[0], LargeBuffer[1], size);
+}
+
+/* Read, write, extend and delete on an exFAT volume, checked again after a remount */
+static void test_exfat(void)
+{
+	DWORD nfree, sclust;
+	UINT i;
+
+	printf("exFAT: read, write, extend and delete\r\n");
+	for (i = 0; i < sizeof(LargeBuffer[0]); i++) {
+		LargeBuffer[0][i] = (BYTE) (i * 13 + (i >> 12));
+	}
+	format_exfat();
+	CHECK(f_mount(0, &TestFS) == FR_OK, "mount");
+	nfree = free_clusters();
+	CHECK(TestFS.fs_type == FS_EXFAT, "exFAT volume");
+	CHECK(nfree == EXFAT_CLUSTERS - 3, "free clusters");
+
+	/* A contiguous file, then one in a directory */
+	CHECK(write_pattern("0:DATA.BIN", FA_CREATE_ALWAYS | FA_WRITE, 0, 100000), "write a file");
+	CHECK(check_pattern("0:DATA.BIN", 100000), "read it back");
+	CHECK((f_mkdir("0:SUB") == FR_OK) && write_pattern("0:SUB/A.BIN", FA_CREATE_ALWAYS | FA_WRITE, 0, 5000),
+		  "write a file in a directory");
+
+	/* Grow the first file behind the second one: its chain goes on the FAT */
+	CHECK(write_pattern("0:DATA.BIN", FA_WRITE, 100000, 150000), "append");
+	CHECK(f_open(&TestFile, "0:EXP.BIN", FA_CREATE_ALWAYS | FA_WRITE) == FR_OK, "open");
+	CHECK(f_expand(&TestFile, 64 * 1024, 1) == FR_OK, "expand a new file");
+	sclust = TestFile.sclust;
+	CHECK(f_close(&TestFile) == FR_OK, "close");
+	CHECK(f_open(&TestFile, "0:SEEK.BIN", FA_CREATE_ALWAYS | FA_WRITE) == FR_OK, "open");
+	CHECK((f_lseek(&TestFile, 40000) == FR_OK) && (TestFile.fsize == 40000), "extend by seeking");
+	CHECK(f_close(&TestFile) == FR_OK, "close");
+
+	CHECK(f_mount(0, &TestFS) == FR_OK, "remount");
+	CHECK(check_pattern("0:DATA.BIN", 250000), "appended file after remount");
+	CHECK(check_pattern("0:SUB/A.BIN", 5000), "file in the directory after remount");
+	CHECK((f_open(&TestFile, "0:EXP.BIN", FA_READ) == FR_OK) && (TestFile.fsize == 64 * 1024) &&
+		  (TestFile.sclust == sclust) && (f_close(&TestFile) == FR_OK), "expanded file after remount");
+	CHECK(exfat_in_use(sclust) && exfat_in_use(sclust + 15), "expanded clusters in use");
+	CHECK(free_clusters() == nfree - (62 + 2 + 1 + 16 + 10), "free clusters in use by the files");
+
+	/* Delete all and get the space back */
+	CHECK((f_unlink("0:DATA.BIN") == FR_OK) && (f_unlink("0:EXP.BIN") == FR_OK) &&
+		  (f_unlink("0:SEEK.BIN") == FR_OK) && (f_unlink("0:SUB/A.BIN") == FR_OK) && (f_unlink("0:SUB") == FR_OK),
+		  "delete the files");
+	CHECK(!exfat_in_use(sclust) && !exfat_in_use(sclust + 15), "expanded clusters free");
+	CHECK(free_clusters() == nfree, "free clusters after delete");
+	CHECK(f_mount(0, &TestFS) == FR_OK, "remount");
+	CHECK((f_stat("0:DATA.BIN", NULL) == FR_NO_FILE) && (free_clusters() == nfree), "volume empty after remount");
+}
+
+/*---------- Volume locks ----------*/
+static FRESULT NestedRes;
+static const char *NestedPath;
+static uint32_t NestedIPSR;
+static uint32_t Waits;
+
+/* FatFs call from inside a disk read, at the exception number of NestedIPSR */
+static void nested_call(void)
+{
+	FILINFO info;
+	uint32_t ipsr = SimIPSR;
+
+	SimIPSR = NestedIPSR;
+	NestedRes = f_stat(NestedPath, &info);
+	SimIPSR = ipsr;
+}
+
+static void count_wait(void)
+{
+	Waits++;
+}
+
+/* f_stat() of 0:FILE.BIN with a call on path nested in its first disk read. Returns the result of the
+ * nested call, and the milliseconds it took in *pMs. */
+static FRESULT stat_nested(const char *path, uint32_t ipsr, uint32_t *pMs)
+{
+	FILINFO info;
+	uint32_t counter;
+
+	CHECK(f_mount(0, &TestFS) == FR_OK, "remount, the next call reads the disk");
+	NestedRes = FR_INT_ERR;
+	NestedPath = path;
+	NestedIPSR = ipsr;
+	HookDrive = 0;
+	DiskHook = nested_call;
+	counter = SimCounter;
+	CHECK(f_stat("0:FILE.BIN", &info) == FR_OK, "outer call");
+	CHECK(!DiskHook, "nested call made");
+	*pMs = (SimCounter - counter) / (SystemCoreClock / 1000);
+	return NestedRes;
+}
+
+static int format_both(void)
+{
+	memset(&Disks[1], 0, sizeof(Disks[1]));
+	return format_volume() && write_file("0:FILE.BIN", 1) && (f_mount(1, &TestFS1) == FR_OK) &&
+		   (f_mkfs(1, 1, TEST_SECTOR_SIZE) == FR_OK) &&
+		   (f_open(&TestFile2, "1:FILE.BIN", FA_CREATE_ALWAYS | FA_WRITE) == FR_OK) &&
+		   (f_close(&TestFile2) == FR_OK);
+}
+
+/* A call nested in a call on the same volume fails at once in the same context, waits for the lock and
+ * times out with a wait function or from another context, and a call on the other volume goes through */
+static void test_sync_nested(void)
+{
+	FILINFO info;
+	uint32_t ms;
+
+	printf("Volume locks: nested calls\r\n");
+	CHECK(format_both(), "format both volumes");
+
+	CHECK(stat_nested("0:FILE.BIN", 0, &ms) == FR_TIMEOUT, "nested call on the same volume refused");
+	CHECK(ms == 0, "at once");
+	CHECK(stat_nested("1:FILE.BIN", 0, &ms) == FR_OK, "nested call on the other volume");
+
+	ff_sync_set_wait(count_wait);
+	Waits = 0;
+	CHECK(stat_nested("0:FILE.BIN", 0, &ms) == FR_TIMEOUT, "nested call with a wait function times out");
+	CHECK((ms >= _FS_TIMEOUT) && (ms <= _FS_TIMEOUT + 2), "after _FS_TIMEOUT");
+	CHECK(Waits >= _FS_TIMEOUT - 1, "waiting in the wait function");
+	ff_sync_set_wait(NULL);
+
+	CHECK(stat_nested("0:FILE.BIN", 16 + 6, &ms) == FR_TIMEOUT, "call from an interrupt times out");
+	CHECK((ms >= _FS_TIMEOUT) && (ms <= _FS_TIMEOUT + 2), "after _FS_TIMEOUT");
+	CHECK(stat_nested("1:FILE.BIN", 16 + 6, &ms) == FR_OK, "call from an interrupt on the other volume");
+
+	CHECK((f_stat("0:FILE.BIN", &info) == FR_OK) && (f_stat("1:FILE.BIN", &info) == FR_OK),
+		  "both volumes free after the nested calls");
+}
+
+/* Copy up to size bytes from TestFile to TestFile2 in chunks of 3000 bytes */
+static int copy_chunks(UINT size)
+{
+	UINT done, br, bw;
+
+	for (done = 0; done < size; done += br) {
+		if ((f_read(&TestFile, Buffer, (size - done > 3000) ? 3000 : size - done, &br) != FR_OK) || !br ||
+			(f_write(&TestFile2, Buffer, br, &bw) != FR_OK) || (bw != br)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* A file copied between the volumes a chunk at a time with both files open. Halfway the source volume
+ * is remounted: its file is closed by that, the copy on the other volume goes on. */
+static void test_sync_two_volumes(void)
+{
+	UINT i, half = sizeof(LargeBuffer[0]) / 2, br;
+
+	printf("Volume locks: two volumes used together\r\n");
+	for (i = 0; i < sizeof(LargeBuffer[0]); i++) {
+		LargeBuffer[0][i] = (BYTE) (i * 5 + (i >> 10));
+	}
+	CHECK(format_both(), "format both volumes");
+	CHECK(write_pattern("0:SRC.BIN", FA_CREATE_ALWAYS | FA_WRITE, 0, sizeof(LargeBuffer[0])), "write the source");
+	CHECK(f_open(&TestFile, "0:SRC.BIN", FA_READ) == FR_OK, "open the source");
+	CHECK(f_open(&TestFile2, "1:DST.BIN", FA_CREATE_ALWAYS | FA_WRITE) == FR_OK, "open the copy");
+	CHECK(copy_chunks(half), "copy the first half");
+
+	CHECK((f_mount(0, NULL) == FR_OK) && (f_mount(0, &TestFS) == FR_OK), "remount the source volume");
+	CHECK(f_read(&TestFile, Buffer, 1, &br) == FR_INVALID_OBJECT, "source file closed by it");
+	CHECK((f_open(&TestFile, "0:SRC.BIN", FA_READ) == FR_OK) && (f_lseek(&TestFile, half) == FR_OK),
+		  "open the source again");
+	CHECK(copy_chunks(sizeof(LargeBuffer[0]) - half), "copy the second half");
+
+	CHECK((f_close(&TestFile) == FR_OK) && (f_close(&TestFile2) == FR_OK), "close both");
+	CHECK(check_pattern("1:DST.BIN", sizeof(LargeBuffer[0])), "copy read back");
+}
+
+/* Mutexes of an RTOS in place of the built-in locks, not recursive */
+typedef struct {
+	int32_t Created;
+	int32_t Taken;
+	int32_t Takes;
+	int32_t Gives;
+	DWORD Timeout;
+} TEST_MUTEX_T;
+
+static TEST_MUTEX_T Mutex[_VOLUMES];
+
+static void *mutex_create(BYTE vol)
+{
+	Mutex[vol].Created++;
+	return &Mutex[vol];
+}
+
+static int mutex_take(void *obj, DWORD ms)
+{
+	TEST_MUTEX_T *pMutex = (TEST_MUTEX_T *) obj;
+
+	pMutex->Timeout = ms;
+	pMutex->Takes++;
+	if (pMutex->Taken) {
+		return 0;
+	}
+	pMutex->Taken = 1;
+	return 1;
+}
+
+static void mutex_give(void *obj)
+{
+	TEST_MUTEX_T *pMutex = (TEST_MUTEX_T *) obj;
+
+	pMutex->Gives++;
+	pMutex->Taken = 0;
+}
+
+static void mutex_delete(void *obj)
+{
+	((TEST_MUTEX_T *) obj)->Created--;
+}
+
+static const FF_SYNC_OPS_T MutexOps = {mutex_create, mutex_take, mutex_give, mutex_delete};
+
+/* With the mutexes a nested call is refused by the mutex, and each grant is given back */
+static void test_sync_ops(void)
+{
+	uint32_t ms;
+
+	printf("Volume locks: RTOS mutexes\r\n");
+	CHECK(format_both(), "format both volumes");
+	ff_sync_set_ops(&MutexOps);
+	CHECK((f_mount(0, &TestFS) == FR_OK) && (f_mount(1, &TestFS1) == FR_OK), "mount with the mutexes");
+	CHECK((Mutex[0].Created == 1) && (Mutex[1].Created == 1), "a mutex a volume");
+
+	CHECK(stat_nested("0:FILE.BIN", 0, &ms) == FR_TIMEOUT, "nested call on the same volume refused");
+	CHECK(stat_nested("1:FILE.BIN", 0, &ms) == FR_OK, "nested call on the other volume");
+	CHECK(Mutex[0].Timeout == _FS_TIMEOUT, "taken with _FS_TIMEOUT");
+	CHECK((Mutex[0].Takes > 0) && (Mutex[0].Gives == Mutex[0].Takes - 1) && !Mutex[0].Taken,
+		  "every grant given back, the refused one excepted");
+	CHECK((Mutex[1].Gives == Mutex[1].Takes) && !Mutex[1].Taken, "every grant on the other volume given back");
+
+	ff_sync_set_ops(NULL);
+	CHECK((f_mount(0, &TestFS) == FR_OK) && (f_mount(1, &TestFS1) == FR_OK), "mount with the built-in locks");
+	CHECK((Mutex[0].Created == 0) && (Mutex[1].Created == 0), "mutexes deleted");
+}
+
+/* Dropping or replacing the volume forgets the run of a pending write */
+static void test_freemap_mount(void)
+{
+	printf("Free map: run size on mount\r\n");
+	CHECK(format_volume(), "format");
+	TestFS.alloc_hint = 64;
+	CHECK(f_mount(0, NULL) == FR_OK, "unmount");
+	CHECK(TestFS.alloc_hint == 0, "run size dropped on unmount");
+	TestFS.alloc_hint = 64;
+	CHECK(f_mount(0, &TestFS) == FR_OK, "mount");
+	CHECK(TestFS.alloc_hint == 0, "run size dropped on mount");
+}
+
+int main(void)
+{
+	test_freemap_abort();
+	test_freemap_refill();
+	test_freemap_mount();
+	test_wincache_mirror();
+	test_dirindex();
+	test_dirindex_full();
+	test_multi_sector();
+	test_exfat();
+	test_expand_fragmented();
+	test_expand_wrap();
+	test_expand_full();
+	test_sync_nested();
+	test_sync_two_volumes();
+	test_sync_ops();
+
+	f_mount(0, NULL);
+	f_mount(1, NULL);
+
+	printf("%lu failures\r\n", (unsigned long) Failures);
+	return Failures ? 1 : 0;
+}
@@ -0,0 +1,405 @@
+/*
+ * @brief Test of the SD/MMC driver against the SDIO controller and card model
+ *
+ * @note
+ * Copyright(C) NXP Semiconductors, 2012
+ * All rights reserved.
+ *
+ * @par
+ * Software that is described herein is for illustrative purposes only
+ * which provides customers with programming information regarding the
+ * LPC products.  This software is supplied "AS IS" without any warranties of
+ * any kind, and NXP Semiconductors and its licensor disclaim any and
+ * all warranties, express or implied, including all implied warranties of
+ * merchantability, fitness for a particular purpose and non-infringement of
+ * intellectual property rights.  NXP Semiconductors assumes no responsibility
+ * or liability for the use of the software, conveys no license or rights under any
+ * patent, copyright, mask work right, or any other intellectual property rights in
+ * or to any products. NXP Semiconductors reserves the right to make changes
+ * in the software without notification. NXP Semiconductors also makes no
+ * representation or warranty that such application will be suitable for the
+ * specified use without further testing or modification.
+ *
+ * @par
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation is hereby granted, under NXP Semiconductors' and its
+ * licensor's relevant copyrights in the software, without fee, provided that it
+ * is used in conjunction with NXP Semiconductors microcontrollers.  This
+ * copyright, permission, and disclaimer notice must appear in all copies of
+ * this code.
+ */
+
+/* Usage: sdmmc_sim_test [image]
+ *
+ * An SDSC, an SDHC and an MMC 4.5 card are modelled in turn on a blank image. Each is acquired, written
+ * and read back with single and multiple block commands, with the started (interrupt driven) transfers,
+ * with errors injected on the bus, with a started transfer aborted, with the card held busy after its
+ * writes and with packed writes (Chip_SDMMC_WriteBlocksPacked()). The driver statistics are checked
+ * against what was sent. Exits non-zero on any failure. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "chip.h"
+#include "sdmmc_sim.h"
+
+#define TEST_IMAGE_BLOCKS   32768			/* 16MB */
+#define TEST_MAX_BLOCKS     64
+#define TEST_WAIT_US        2000000			/* a command or transfer the model never ends */
+#define TEST_WRITE_BUSY     10000			/* card busy after a write, in usec, well above a time slice of a loaded host */
+#define TEST_PACKED_WRITES  10				/* more than PACKED_WRITE_MAX, two packed commands */
+
+static LPC_SDMMC_T *pSDMMC;
+static mci_card_struct CardInfo;
+static volatile int32_t WaitExit;
+static volatile int32_t XferDone;
+static volatile uint32_t XferStatus;
+static uint32_t Failures;
+
+static uint8_t WriteBuffer[TEST_MAX_BLOCKS * MMC_SECTOR_SIZE] __attribute__((aligned(4)));
+static uint8_t ReadBuffer[TEST_MAX_BLOCKS * MMC_SECTOR_SIZE] __attribute__((aligned(4)));
+
+#define CHECK(cond, what) \
+	do { \
+		if (!(cond)) { \
+			printf("  FAIL %s (%s:%d)\r\n", (what), __FILE__, __LINE__); \
+			Failures++; \
+		} \
+	} while (0)
+
+/*---------- Card callbacks and interrupt, as in sdmmc.c of the application ----------*/
+static void SDIO_IRQHandler(void)
+{
+	SdmmcSim_EnableIrq(0);
+
+	/* A transfer started with Chip_SDMMC_StartRead/WriteBlocks() runs from here up to its completion */
+	if (Chip_SDMMC_XferPending(pSDMMC)) {
+		Chip_SDMMC_IRQHandler(pSDMMC);
+		return;
+	}
+	WaitExit = 1;
+}
+
+static void sdmmc_setup_wakeup(uint32_t bits)
+{
+	WaitExit = 0;
+	Chip_SDMMC_SetIntMask(pSDMMC, bits);
+	SdmmcSim_EnableIrq(1);
+}
+
+static uint32_t sdmmc_irq_driven_wait(void)
+{
+	uint64_t end = SdmmcSim_GetTimeUs() + TEST_WAIT_US;
+
+	while (!WaitExit) {
+		if (SdmmcSim_GetTimeUs() > end) {
+			printf("  no SDIO interrupt, the model hangs\r\n");
+			exit(1);
+		}
+	}
+	return Chip_SDMMC_GetIntStatus(pSDMMC);
+}
+
+static void sdmmc_waitms(uint32_t time)
+{
+	uint64_t end = SdmmcSim_GetTimeUs() + ((uint64_t) time * 1000);
+
+	while (SdmmcSim_GetTimeUs() < end) {}
+}
+
+static void xfer_done(void *arg, uint32_t status)
+{
+	XferStatus = status;
+	XferDone = 1;
+}
+
+static int32_t xfer_wait(void)
+{
+	uint64_t end = SdmmcSim_GetTimeUs() + TEST_WAIT_US;
+
+	while (!XferDone) {
+		if (SdmmcSim_GetTimeUs() > end) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*---------- Tests ----------*/
+static void fill(uint8_t *buf, uint32_t bytes, uint32_t seed)
+{
+	uint32_t i;
+
+	for (i = 0; i < bytes; i++) {
+		seed = (seed * 1103515245) + 12345;
+		buf[i] = (uint8_t) (seed >> 16);
+	}
+}
+
+static int32_t read_compare(int32_t block, int32_t count)
+{
+	memset(ReadBuffer, 0, count * MMC_SECTOR_SIZE);
+	return (Chip_SDMMC_ReadBlocks(pSDMMC, ReadBuffer, block, count) == (count * MMC_SECTOR_SIZE)) &&
+		   (memcmp(WriteBuffer, ReadBuffer, count * MMC_SECTOR_SIZE) == 0);
+}
+
+static void test_acquire(uint32_t type)
+{
+	uint32_t card_type;
+
+	CHECK(Chip_SDMMC_Acquire(pSDMMC, &CardInfo), "acquire");
+	card_type = Chip_SDMMC_GetCardType(pSDMMC);
+	CHECK(Chip_SDMMC_GetDeviceBlocks(pSDMMC) == TEST_IMAGE_BLOCKS, "device size");
+	CHECK(((card_type & CARD_TYPE_SD) != 0) == (type != SDMMC_SIM_MMC), "SD or MMC");
+	CHECK(((card_type & CARD_TYPE_HC) != 0) == (type != SDMMC_SIM_SDSC), "block or byte addresses");
+	CHECK(card_type & (CARD_TYPE_4BIT | CARD_TYPE_8BIT), "wide bus");
+	CHECK(card_type & CARD_TYPE_HS, "high speed");
+	printf("  acquired, type %03lx, %lu blocks, %lu Hz\r\n", (unsigned long) card_type,
+		   (unsigned long) Chip_SDMMC_GetDeviceBlocks(pSDMMC), (unsigned long) CardInfo.speed);
+}
+
+static void test_read_write(void)
+{
+	fill(WriteBuffer, sizeof(WriteBuffer), 1);
+	CHECK(Chip_SDMMC_WriteBlocks(pSDMMC, WriteBuffer, 100, TEST_MAX_BLOCKS) == sizeof(WriteBuffer), "multiple block write");
+	CHECK(read_compare(100, TEST_MAX_BLOCKS), "multiple block read");
+
+	fill(WriteBuffer, MMC_SECTOR_SIZE, 2);
+	CHECK(Chip_SDMMC_WriteBlocks(pSDMMC, WriteBuffer, 300, 1) == MMC_SECTOR_SIZE, "single block write");
+	CHECK(read_compare(300, 1), "single block read");
+
+	/* the last blocks of the card, and a transfer past its end that is refused */
+	fill(WriteBuffer, 8 * MMC_SECTOR_SIZE, 3);
+	CHECK(Chip_SDMMC_WriteBlocks(pSDMMC, WriteBuffer, TEST_IMAGE_BLOCKS - 8, 8) == (8 * MMC_SECTOR_SIZE), "write at the end");
+	CHECK(read_compare(TEST_IMAGE_BLOCKS - 8, 8), "read at the end");
+	CHECK(Chip_SDMMC_ReadBlocks(pSDMMC, ReadBuffer, TEST_IMAGE_BLOCKS - 4, 8) == 0, "read past the end refused");
+	CHECK(Chip_SDMMC_GetState(pSDMMC) == SDMMC_TRAN_ST, "card in trans state");
+}
+
+static void test_started(void)
+{
+	fill(WriteBuffer, sizeof(WriteBuffer), 4);
+	XferDone = 0;
+	CHECK(Chip_SDMMC_StartWriteBlocks(pSDMMC, WriteBuffer, 1000, TEST_MAX_BLOCKS, xfer_done, NULL) == sizeof(WriteBuffer),
+		  "started write");
+	CHECK(Chip_SDMMC_XferPending(pSDMMC), "write in flight");
+	CHECK(xfer_wait() && (XferStatus == 0), "started write completion");
+
+	memset(ReadBuffer, 0, sizeof(ReadBuffer));
+	XferDone = 0;
+	CHECK(Chip_SDMMC_StartReadBlocks(pSDMMC, ReadBuffer, 1000, TEST_MAX_BLOCKS, xfer_done, NULL) == sizeof(ReadBuffer),
+		  "started read");
+
+	/* the blocking calls are refused while it runs, they would take over its descriptors */
+	CHECK(Chip_SDMMC_XferPending(pSDMMC), "read in flight");
+	CHECK(Chip_SDMMC_ReadBlocks(pSDMMC, WriteBuffer, 3000, 8) == 0, "blocking read refused");
+	CHECK(Chip_SDMMC_WriteBlocks(pSDMMC, WriteBuffer, 3000, 8) == 0, "blocking write refused");
+	CHECK(xfer_wait() && (XferStatus == 0), "started read completion");
+	CHECK(memcmp(WriteBuffer, ReadBuffer, sizeof(ReadBuffer)) == 0, "started read data");
+	CHECK(!Chip_SDMMC_XferPending(pSDMMC), "nothing left in flight");
+}
+
+static void test_errors(void)
+{
+	MCI_STATS_T stats;
+
+	fill(WriteBuffer, 16 * MMC_SECTOR_SIZE, 5);
+	CHECK(Chip_SDMMC_WriteBlocks(pSDMMC, WriteBuffer, 2000, 16) == (16 * MMC_SECTOR_SIZE), "write before the errors");
+	Chip_SDMMC_ResetStats(pSDMMC);
+
+	/* a data CRC error fails the read, the card recovers for the next one */
+	SdmmcSim_InjectError(MMC_READ_MULTIPLE_BLOCK, MCI_INT_DCRC);
+	CHECK(Chip_SDMMC_ReadBlocks(pSDMMC, ReadBuffer, 2000, 16) == 0, "read with a CRC error fails");
+	CHECK(read_compare(2000, 16), "read after the CRC error");
+
+	/* a card that does not answer a write */
+	SdmmcSim_InjectError(MMC_WRITE_MULTIPLE_BLOCK, MCI_INT_RTO);
+	CHECK(Chip_SDMMC_WriteBlocks(pSDMMC, WriteBuffer, 2000, 16) == 0, "write without response fails");
+	CHECK(Chip_SDMMC_WriteBlocks(pSDMMC, WriteBuffer, 2000, 16) == (16 * MMC_SECTOR_SIZE), "write after the timeout");
+	CHECK(read_compare(2000, 16), "data after the timeout");
+
+	/* a started read that fails reports the error to its completion */
+	SdmmcSim_InjectError(MMC_READ_MULTIPLE_BLOCK, MCI_INT_DCRC);
+	XferDone = 0;
+	CHECK(Chip_SDMMC_StartReadBlocks(pSDMMC, ReadBuffer, 2000, 16, xfer_done, NULL) == (16 * MMC_SECTOR_SIZE),
+		  "started read with a CRC error");
+	CHECK(xfer_wait() && (XferStatus & MCI_INT_DCRC), "completion with the CRC error");
+	CHECK(read_compare(2000, 16), "read after the started read failed");
+
+	Chip_SDMMC_GetStats(pSDMMC, &stats);
+	CHECK(stats.cmd[MCI_STAT_READ_MULTIPLE].crc_errors == 2, "CRC errors booked");
+	CHECK(stats.cmd[MCI_STAT_WRITE_MULTIPLE].timeouts == 1, "timeout booked");
+
+	/* a started read whose interrupt is lost is aborted, the next transfer finds the card again */
+	XferDone = 0;
+	CHECK(Chip_SDMMC_StartReadBlocks(pSDMMC, ReadBuffer, 2000, 16, xfer_done, NULL) == (16 * MMC_SECTOR_SIZE),
+		  "started read to abort");
+	SdmmcSim_EnableIrq(0);
+	sdmmc_waitms(50);
+	CHECK(Chip_SDMMC_XferPending(pSDMMC) && !XferDone, "read without its interrupt still in flight");
+	Chip_SDMMC_AbortXfer(pSDMMC);
+	CHECK(XferDone && (XferStatus & MCI_INT_DTO), "completion of the aborted read");
+	CHECK(!Chip_SDMMC_XferPending(pSDMMC), "nothing in flight after the abort");
+	CHECK(read_compare(2000, 16), "read after the abort");
+}
+
+static void test_busy(void)
+{
+	MCI_STATS_T stats;
+	SDMMC_SIM_STATS_T sim;
+
+	Chip_SDMMC_ResetStats(pSDMMC);
+	fill(WriteBuffer, 32 * MMC_SECTOR_SIZE, 6);
+
+	/* each read right after a write waits for the card to program it */
+	CHECK(Chip_SDMMC_WriteBlocks(pSDMMC, WriteBuffer, 4000, 32) == (32 * MMC_SECTOR_SIZE), "write before busy");
+	CHECK(read_compare(4000, 32), "read while busy");
+	CHECK(Chip_SDMMC_WriteBlocks(pSDMMC, WriteBuffer, 5000, 1) == MMC_SECTOR_SIZE, "single write before busy");
+	CHECK(read_compare(5000, 1), "single read while busy");
+
+	Chip_SDMMC_GetStats(pSDMMC, &stats);
+	SdmmcSim_GetStats(&sim);
+	CHECK(stats.busy_waits >= 2, "busy waits booked");
+	CHECK(stats.busy_us >= TEST_WRITE_BUSY, "busy time booked");
+	CHECK(stats.busy_max_us <= (sim.BusyUs + (TEST_WRITE_BUSY / 2)), "busy time within the model's");
+	CHECK((stats.cmd[MCI_STAT_READ_MULTIPLE].count == 1) && (stats.cmd[MCI_STAT_READ_MULTIPLE].time_us > 0),
+		  "read latency booked");
+	printf("  %lu busy waits for %lu us, longest %lu us, 32 block read %lu us\r\n", (unsigned long) stats.busy_waits,
+		   (unsigned long) stats.busy_us, (unsigned long) stats.busy_max_us,
+		   (unsigned long) stats.cmd[MCI_STAT_READ_MULTIPLE].time_us);
+}
+
+/* Short writes scattered over the card, sent with Chip_SDMMC_WriteBlocksPacked() */
+static uint32_t packed_writes(MCI_PACKED_WRITE_T *writes, uint32_t seed)
+{
+	uint32_t i, blocks = 0;
+
+	fill(WriteBuffer, sizeof(WriteBuffer), seed);
+	for (i = 0; i < TEST_PACKED_WRITES; i++) {
+		writes[i].buffer = WriteBuffer + (blocks * MMC_SECTOR_SIZE);
+		writes[i].start_block = 8000 + (i * 997) % 5000;
+		writes[i].num_blocks = 1 + (i % 4);
+		blocks += writes[i].num_blocks;
+	}
+	return blocks * MMC_SECTOR_SIZE;
+}
+
+static int32_t packed_compare(const MCI_PACKED_WRITE_T *writes)
+{
+	uint32_t i;
+	int32_t bytes;
+
+	for (i = 0; i < TEST_PACKED_WRITES; i++) {
+		bytes = writes[i].num_blocks * MMC_SECTOR_SIZE;
+		memset(ReadBuffer, 0, bytes);
+		if ((Chip_SDMMC_ReadBlocks(pSDMMC, ReadBuffer, writes[i].start_block, writes[i].num_blocks) != bytes) ||
+			(memcmp(writes[i].buffer, ReadBuffer, bytes) != 0)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static void test_packed(uint32_t type)
+{
+	MCI_PACKED_WRITE_T writes[TEST_PACKED_WRITES];
+	MCI_STATS_T stats;
+	uint32_t sent, bytes;
+
+	/* MMC 4.5 gets two packed commands, SD cards a command per write */
+	bytes = packed_writes(writes, 7);
+	Chip_SDMMC_ResetStats(pSDMMC);
+	CHECK(Chip_SDMMC_WriteBlocksPacked(pSDMMC, writes, TEST_PACKED_WRITES) == bytes, "packed write");
+	Chip_SDMMC_GetStats(pSDMMC, &stats);
+	sent = stats.cmd[MCI_STAT_WRITE_SINGLE].count + stats.cmd[MCI_STAT_WRITE_MULTIPLE].count;
+	CHECK(sent == ((type == SDMMC_SIM_MMC) ? 2 : TEST_PACKED_WRITES), "write commands of the packed write");
+	CHECK(packed_compare(writes), "data of the packed write");
+
+	/* a packed command that fails is sent again one write at a time, an SD write that fails is an error */
+	bytes = packed_writes(writes, 8);
+	SdmmcSim_InjectError(MMC_WRITE_MULTIPLE_BLOCK, MCI_INT_DCRC);
+	if (type == SDMMC_SIM_MMC) {
+		CHECK(Chip_SDMMC_WriteBlocksPacked(pSDMMC, writes, TEST_PACKED_WRITES) == bytes, "packed write after an error");
+	}
+	else {
+		CHECK(Chip_SDMMC_WriteBlocksPacked(pSDMMC, writes, TEST_PACKED_WRITES) == 0, "failed write reported");
+		CHECK(Chip_SDMMC_WriteBlocksPacked(pSDMMC, writes, TEST_PACKED_WRITES) == bytes, "writes sent again");
+	}
+	CHECK(packed_compare(writes), "data of the packed write after an error");
+	printf("  %u packed writes in %lu write commands\r\n", TEST_PACKED_WRITES, (unsigned long) sent);
+}
+
+static int32_t run_card(const char *image, uint32_t type, const char *name)
+{
+	SDMMC_SIM_CFG_T cfg;
+	SDMMC_SIM_STATS_T sim;
+	uint32_t failures = Failures;
+	int fd;
+
+	/* a blank card */
+	fd = open(image, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if ((fd < 0) || (ftruncate(fd, (off_t) TEST_IMAGE_BLOCKS * MMC_SECTOR_SIZE) != 0)) {
+		printf("Cannot create %s\r\n", image);
+		exit(1);
+	}
+	close(fd);
+
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.Image = image;
+	cfg.Type = type;
+	cfg.CmdLatency = 5;
+	cfg.ReadLatency = 100;
+	cfg.WriteBusy = TEST_WRITE_BUSY;
+	cfg.WriteBusyBlock = 10;
+	cfg.SwitchBusy = 100;
+	cfg.InitPolls = 3;
+	cfg.HighSpeed = 1;
+	cfg.Cmd23 = 1;
+	cfg.MmcRev = 6;
+
+	printf("%s\r\n", name);
+	pSDMMC = SdmmcSim_Start(&cfg);
+	if (!pSDMMC) {
+		printf("Cannot start the model on %s\r\n", image);
+		exit(1);
+	}
+	SdmmcSim_SetIrqHandler(SDIO_IRQHandler);
+
+	memset(&CardInfo, 0, sizeof(CardInfo));
+	CardInfo.evsetup_cb = sdmmc_setup_wakeup;
+	CardInfo.waitfunc_cb = sdmmc_irq_driven_wait;
+	CardInfo.msdelay_func = sdmmc_waitms;
+	Chip_SDMMC_Init(pSDMMC);
+
+	test_acquire(type);
+	if (Failures == failures) {
+		test_read_write();
+		test_started();
+		test_errors();
+		test_busy();
+		test_packed(type);
+	}
+
+	SdmmcSim_GetStats(&sim);
+	printf("  model: %lu commands, %lu blocks read, %lu written, %lu CRC errors\r\n", (unsigned long) sim.Commands,
+		   (unsigned long) sim.BlocksRead, (unsigned long) sim.BlocksWritten, (unsigned long) sim.CrcErrors);
+	Chip_SDMMC_DeInit(pSDMMC);
+	SdmmcSim_Stop();
+
+	return Failures == failures;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *image = (argc > 1) ? argv[1] : "sdmmc_sim_test.img";
+
+	run_card(image, SDMMC_SIM_SDSC, "SDSC card");
+	run_card(image, SDMMC_SIM_SDHC, "SDHC card");
+	run_card(image, SDMMC_SIM_MMC, "MMC 4.5 card");
+
+	printf("%lu failures\r\n", (unsigned long) Failures);
+	return Failures ? 1 : 0;
+}
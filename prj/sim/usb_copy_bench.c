@@ -0,0 +1,362 @@
+/*
+ * @brief FatFs copy benchmark of the USB mass storage host stack against the EHCI controller model
+ *
+ * @note
+ * Copyright(C) NXP Semiconductors, 2012
+ * All rights reserved.
+ *
+ * @par
+ * Software that is described herein is for illustrative purposes only
+ * which provides customers with programming information regarding the
+ * LPC products.  This software is supplied "AS IS" without any warranties of
+ * any kind, and NXP Semiconductors and its licensor disclaim any and
+ * all warranties, express or implied, including all implied warranties of
+ * merchantability, fitness for a particular purpose and non-infringement of
+ * intellectual property rights.  NXP Semiconductors assumes no responsibility
+ * or liability for the use of the software, conveys no license or rights under any
+ * patent, copyright, mask work right, or any other intellectual property rights in
+ * or to any products. NXP Semiconductors reserves the right to make changes
+ * in the software without notification. NXP Semiconductors also makes no
+ * representation or warranty that such application will be suitable for the
+ * specified use without further testing or modification.
+ *
+ * @par
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation is hereby granted, under NXP Semiconductors' and its
+ * licensor's relevant copyrights in the software, without fee, provided that it
+ * is used in conjunction with NXP Semiconductors microcontrollers.  This
+ * copyright, permission, and disclaimer notice must appear in all copies of
+ * this code.
+ */
+
+/* Usage: usb_copy_bench [image] [image MB] [file MB] [buffer KB]
+ *
+ * A disk image is formatted, attached as a high speed Bulk-Only mass storage device, and a file is written,
+ * copied to a second file with f_read()/f_write() and both are read back and compared. The copy is timed on
+ * the bus (125us per microframe run by the model) and on the wall clock. Exits non-zero on any failure. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fsusb_cfg.h"
+#include "ff.h"
+
+#define BENCH_PORT          0
+#define BENCH_MAX_BUFFER    (256 * 1024)
+#define BENCH_READY_TRIES   100
+
+static USB_ClassInfo_MS_Host_t BenchMSInterface = {
+	.Config = {
+		.DataINPipeNumber       = 1,
+		.DataINPipeDoubleBank   = false,
+
+		.DataOUTPipeNumber      = 2,
+		.DataOUTPipeDoubleBank  = false,
+		.PortNumber = BENCH_PORT,
+	},
+};
+
+static USB_ClassInfo_UAS_Host_t BenchDisk = {
+	.Config = {
+		.DataINPipeNumber       = 1,
+		.DataOUTPipeNumber      = 2,
+		.CommandPipeNumber      = 3,
+		.StatusPipeNumber       = 4,
+		.PortNumber = BENCH_PORT,
+		.BOTInterface = &BenchMSInterface,
+	},
+};
+
+static SCSI_Capacity_t DiskCapacity;
+static volatile bool DiskEnumerated;
+static uint32_t AttachMicroframes;
+
+static FATFS BenchFS;
+static FIL SrcFile, DstFile;
+static uint8_t CopyBuffer[BENCH_MAX_BUFFER];
+static uint8_t CheckBuffer[BENCH_MAX_BUFFER];
+
+/*---------- Host stack events ----------*/
+void EVENT_USB_Host_DeviceEnumerationComplete(const uint8_t corenum)
+{
+	uint16_t ConfigDescriptorSize;
+	uint8_t  ConfigDescriptorData[512];
+
+	if ((USB_Host_GetDeviceConfigDescriptor(corenum, 1, &ConfigDescriptorSize, ConfigDescriptorData,
+											sizeof(ConfigDescriptorData)) != HOST_GETCONFIG_Successful) ||
+		(UAS_Host_ConfigurePipes(&BenchDisk, ConfigDescriptorSize, ConfigDescriptorData) != UAS_ENUMERROR_NoError) ||
+		(USB_Host_SetDeviceConfiguration(corenum, 1) != HOST_SENDCONTROL_Successful) ||
+		(UAS_Host_SelectAlternateSetting(&BenchDisk) != HOST_SENDCONTROL_Successful)) {
+		printf("Enumeration of the mass storage device failed\r\n");
+		return;
+	}
+	DiskEnumerated = true;
+}
+
+void EVENT_USB_Host_DeviceEnumerationFailed(const uint8_t corenum,
+											const uint8_t ErrorCode,
+											const uint8_t SubErrorCode)
+{
+	printf("Dev Enum Error %d/%d\r\n", ErrorCode, SubErrorCode);
+}
+
+/*---------- Disk glue of fs_usb.c, as in MassStorageHost.c ----------*/
+DISK_HANDLE_T *FSUSB_DiskInit(void)
+{
+	return &BenchDisk;
+}
+
+int FSUSB_DiskInsertWait(DISK_HANDLE_T *hDisk)
+{
+	SIM_EHCI_STATS_T Stats;
+
+	while (!DiskEnumerated) {
+		USB_USBTask(hDisk->Config.PortNumber, USB_MODE_Host);
+	}
+	if (!AttachMicroframes) {
+		Sim_GetStats(hDisk->Config.PortNumber, &Stats);
+		AttachMicroframes = Stats.Microframes;
+	}
+	return 1;
+}
+
+int FSUSB_DiskReadyWait(DISK_HANDLE_T *hDisk, int tout)
+{
+	int Tries;
+
+	(void) tout;
+	for (Tries = 0; Tries < BENCH_READY_TRIES; Tries++) {
+		if (UAS_Host_TestUnitReady(hDisk, 0) == 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int FSUSB_DiskAcquire(DISK_HANDLE_T *hDisk)
+{
+	return FSUSB_DiskReadyWait(hDisk, 0) && !UAS_Host_ReadDeviceCapacity(hDisk, 0, &DiskCapacity);
+}
+
+uint32_t FSUSB_DiskGetSectorCnt(DISK_HANDLE_T *hDisk)
+{
+	return DiskCapacity.Blocks;
+}
+
+uint32_t FSUSB_DiskGetSectorSz(DISK_HANDLE_T *hDisk)
+{
+	return DiskCapacity.BlockSize;
+}
+
+int FSUSB_DiskReadSectors(DISK_HANDLE_T *hDisk, void *buff, uint32_t secStart, uint32_t numSec)
+{
+	return !UAS_Host_ReadDeviceBlocks(hDisk, 0, secStart, numSec, DiskCapacity.BlockSize, buff);
+}
+
+int FSUSB_DiskWriteSectors(DISK_HANDLE_T *hDisk, void *buff, uint32_t secStart, uint32_t numSec)
+{
+	return !UAS_Host_WriteDeviceBlocks(hDisk, 0, secStart, numSec, DiskCapacity.BlockSize, buff);
+}
+
+/*---------- Only the USB drive is present ----------*/
+DSTATUS MMC_disk_initialize(void)
+{
+	return STA_NOINIT;
+}
+
+DSTATUS MMC_disk_status(void)
+{
+	return STA_NOINIT;
+}
+
+DRESULT MMC_disk_read(BYTE *buff, DWORD sector, UINT count)
+{
+	return RES_NOTRDY;
+}
+
+DRESULT MMC_disk_write(const BYTE *buff, DWORD sector, UINT count)
+{
+	return RES_NOTRDY;
+}
+
+DRESULT MMC_disk_ioctl(BYTE ctrl, void *buff)
+{
+	return RES_NOTRDY;
+}
+
+/*---------- FatFs services, single threaded ----------*/
+int ff_cre_syncobj(BYTE vol, _SYNC_t *sobj)
+{
+	*sobj = &BenchFS;
+	return 1;
+}
+
+int ff_req_grant(_SYNC_t sobj)
+{
+	return 1;
+}
+
+void ff_rel_grant(_SYNC_t sobj)
+{}
+
+int ff_del_syncobj(_SYNC_t sobj)
+{
+	return 1;
+}
+
+DWORD get_fattime(void)
+{
+	return ((DWORD) (2012 - 1980) << 25) | (1UL << 21) | (1UL << 16);
+}
+
+/*---------- Benchmark ----------*/
+static void fill_pattern(uint8_t *buffer, UINT length, FSIZE_t offset)
+{
+	UINT i;
+
+	for (i = 0; i < length; i++) {
+		buffer[i] = (uint8_t) (((offset + i) * 7) ^ ((offset + i) >> 9));
+	}
+}
+
+static int write_source(const char *path, FSIZE_t size, UINT chunk)
+{
+	FSIZE_t done;
+	UINT bw;
+
+	if (f_open(&SrcFile, path, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK) {
+		return 0;
+	}
+	for (done = 0; done < size; done += bw) {
+		UINT n = (UINT) MIN(chunk, size - done);
+
+		fill_pattern(CopyBuffer, n, done);
+		if ((f_write(&SrcFile, CopyBuffer, n, &bw) != FR_OK) || (bw != n)) {
+			f_close(&SrcFile);
+			return 0;
+		}
+	}
+	return f_close(&SrcFile) == FR_OK;
+}
+
+static int copy_file(const char *src, const char *dst, UINT chunk)
+{
+	UINT br, bw;
+
+	if (f_open(&SrcFile, src, FA_READ) != FR_OK) {
+		return 0;
+	}
+	if (f_open(&DstFile, dst, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK) {
+		f_close(&SrcFile);
+		return 0;
+	}
+	do {
+		if ((f_read(&SrcFile, CopyBuffer, chunk, &br) != FR_OK) ||
+			(f_write(&DstFile, CopyBuffer, br, &bw) != FR_OK) || (bw != br)) {
+			br = 0;
+			bw = 1;
+		}
+	} while (br == chunk);
+	f_close(&SrcFile);
+	return (f_close(&DstFile) == FR_OK) && (bw == br);
+}
+
+static int verify_file(const char *path, FSIZE_t size, UINT chunk)
+{
+	FSIZE_t done;
+	UINT br;
+
+	if (f_open(&SrcFile, path, FA_READ) != FR_OK) {
+		return 0;
+	}
+	if (f_size(&SrcFile) != size) {
+		f_close(&SrcFile);
+		return 0;
+	}
+	for (done = 0; done < size; done += br) {
+		if ((f_read(&SrcFile, CopyBuffer, chunk, &br) != FR_OK) || (br == 0)) {
+			break;
+		}
+		fill_pattern(CheckBuffer, br, done);
+		if (memcmp(CopyBuffer, CheckBuffer, br)) {
+			break;
+		}
+	}
+	f_close(&SrcFile);
+	return done == size;
+}
+
+static int make_image(const char *path, uint32_t megabytes)
+{
+	FILE *Image = fopen(path, "wb");
+	int ok;
+
+	if (Image == NULL) {
+		return 0;
+	}
+	ok = (fseeko(Image, (off_t) megabytes * 1024 * 1024 - 1, SEEK_SET) == 0) && (fputc(0, Image) == 0);
+	return (fclose(Image) == 0) && ok;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *ImagePath = (argc > 1) ? argv[1] : "usb_copy_bench.img";
+	uint32_t ImageMB = (argc > 2) ? (uint32_t) atoi(argv[2]) : 64;
+	FSIZE_t FileSize = (FSIZE_t) ((argc > 3) ? atoi(argv[3]) : 16) * 1024 * 1024;
+	UINT Chunk = (UINT) ((argc > 4) ? atoi(argv[4]) : 32) * 1024;
+	SIM_USB_DEVICE_T *pDevice;
+	SIM_EHCI_STATS_T Stats;
+	double BusSeconds, WallSeconds;
+
+	if ((Chunk == 0) || (Chunk > BENCH_MAX_BUFFER) || (FileSize == 0) || (ImageMB < 2 * (FileSize >> 20) + 2)) {
+		printf("usage: %s [image] [image MB] [file MB] [buffer KB <= %d], the image needs room for two files\r\n",
+			   argv[0], BENCH_MAX_BUFFER / 1024);
+		return 2;
+	}
+	if (!make_image(ImagePath, ImageMB) || ((pDevice = Sim_BOTDeviceCreate(ImagePath, 512)) == NULL)) {
+		printf("Cannot create the disk image %s\r\n", ImagePath);
+		return 1;
+	}
+
+	USB_Init(BENCH_PORT, USB_MODE_Host);
+	Sim_ResetStats(BENCH_PORT);
+	Sim_AttachDevice(BENCH_PORT, pDevice);
+
+	if ((f_mount(0, &BenchFS) != FR_OK) || (f_mkfs(0, 0, 0) != FR_OK)) {
+		printf("Cannot format the disk\r\n");
+		return 1;
+	}
+	printf("attach to enumerated: %.1f ms bus\r\n", AttachMicroframes * 0.125);
+	if (!write_source("SRC.BIN", FileSize, Chunk)) {
+		printf("Writing the source file failed\r\n");
+		return 1;
+	}
+
+	Sim_ResetStats(BENCH_PORT);
+	if (!copy_file("SRC.BIN", "DST.BIN", Chunk)) {
+		printf("Copy failed\r\n");
+		return 1;
+	}
+	Sim_GetStats(BENCH_PORT, &Stats);
+
+	if (!verify_file("SRC.BIN", FileSize, Chunk) || !verify_file("DST.BIN", FileSize, Chunk)) {
+		printf("Data compare failed\r\n");
+		return 1;
+	}
+
+	BusSeconds = Stats.Microframes * 125e-6;
+	WallSeconds = Stats.WallMs * 1e-3;
+	printf("copy %lu KB with %u KB buffers: %lu qTDs, %lu IRQs, %lu NAKs\r\n", (unsigned long) (FileSize >> 10),
+		   Chunk >> 10, (unsigned long) Stats.QtdProcessed, (unsigned long) Stats.Interrupts,
+		   (unsigned long) Stats.Naks);
+	printf("copy bus %.3f s = %.2f MB/s, wall %.3f s = %.2f MB/s\r\n",
+		   BusSeconds, BusSeconds > 0 ? FileSize / BusSeconds / 1e6 : 0.0,
+		   WallSeconds, WallSeconds > 0 ? FileSize / WallSeconds / 1e6 : 0.0);
+
+	f_mount(0, NULL);
+	Sim_DetachDevice(BENCH_PORT);
+	USB_Disable(BENCH_PORT, USB_MODE_Host);
+	Sim_BOTDeviceDestroy(pDevice);
+	return 0;
+}
@@ -223,6 +223,9 @@
 			MS_CSCP_BulkOnlyTransportProtocol = 0x50, /**< Descriptor Protocol value indicating that the device or interface
 			                                           *   belongs to the Bulk Only Transport protocol of the Mass Storage class.
 			                                           */
+			MS_CSCP_UASProtocol               = 0x62, /**< Descriptor Protocol value indicating that the device or interface
+			                                           *   belongs to the USB Attached SCSI protocol of the Mass Storage class.
+			                                           */
 		};
 	
 		/** Enum for the Mass Storage class specific control requests that can be issued by the USB bus host. */
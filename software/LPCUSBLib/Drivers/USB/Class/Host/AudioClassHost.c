@@ -103,6 +103,7 @@ uint8_t Audio_Host_ConfigurePipes(USB_ClassInfo_Audio_Host_t* const AudioInterfa
 		uint8_t  Type;
 		uint8_t  Token;
 		uint8_t  EndpointAddress;
+		uint8_t  InterruptPeriod;
 		bool     DoubleBanked;
 
 		if (PipeNum == AudioInterfaceInfo->Config.DataINPipeNumber)
@@ -112,6 +113,7 @@ uint8_t Audio_Host_ConfigurePipes(USB_ClassInfo_Audio_Host_t* const AudioInterfa
 			Token           = PIPE_TOKEN_IN;
 			Type            = EP_TYPE_ISOCHRONOUS;
 			DoubleBanked    = true;
+			InterruptPeriod = DataINEndpoint->PollingIntervalMS;
 
 			AudioInterfaceInfo->State.DataINPipeSize = DataINEndpoint->EndpointSize;
 		}
@@ -122,6 +124,7 @@ uint8_t Audio_Host_ConfigurePipes(USB_ClassInfo_Audio_Host_t* const AudioInterfa
 			Token           = PIPE_TOKEN_OUT;
 			Type            = EP_TYPE_ISOCHRONOUS;
 			DoubleBanked    = true;
+			InterruptPeriod = DataOUTEndpoint->PollingIntervalMS;
 
 			AudioInterfaceInfo->State.DataOUTPipeSize = DataOUTEndpoint->EndpointSize;
 		}
@@ -131,7 +134,7 @@ uint8_t Audio_Host_ConfigurePipes(USB_ClassInfo_Audio_Host_t* const AudioInterfa
 		}
 		
 		if (!(Pipe_ConfigurePipe(portnum,PipeNum, Type, Token, EndpointAddress, Size,
-		                         DoubleBanked ? PIPE_BANK_DOUBLE : PIPE_BANK_SINGLE)))
+		                         DoubleBanked ? PIPE_BANK_DOUBLE : PIPE_BANK_SINGLE, InterruptPeriod)))
 		{
 			return AUDIO_ENUMERROR_PipeConfigurationFailed;
 		}
@@ -115,7 +115,7 @@ uint8_t MIDI_Host_ConfigurePipes(USB_ClassInfo_MIDI_Host_t* const MIDIInterfaceI
 		}
 
 		if (!(Pipe_ConfigurePipe(portnum,PipeNum, Type, Token, EndpointAddress, Size,
-		                         DoubleBanked ? PIPE_BANK_DOUBLE : PIPE_BANK_SINGLE)))
+		                         DoubleBanked ? PIPE_BANK_DOUBLE : PIPE_BANK_SINGLE, 0)))
 		{
 			return MIDI_ENUMERROR_PipeConfigurationFailed;
 		}
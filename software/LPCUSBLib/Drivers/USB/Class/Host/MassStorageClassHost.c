@@ -116,7 +116,7 @@ uint8_t MS_Host_ConfigurePipes(USB_ClassInfo_MS_Host_t* const MSInterfaceInfo,
 		}
 
 		if (!(Pipe_ConfigurePipe(portnum,PipeNum, Type, Token, EndpointAddress, Size,
-		                         DoubleBanked ? PIPE_BANK_DOUBLE : PIPE_BANK_SINGLE)))
+		                         DoubleBanked ? PIPE_BANK_DOUBLE : PIPE_BANK_SINGLE, 0)))
 		{
 			return MS_ENUMERROR_PipeConfigurationFailed;
 		}
@@ -272,7 +272,7 @@ static uint8_t MS_Host_SendReceiveData(USB_ClassInfo_MS_Host_t* const MSInterfac
                                        MS_CommandBlockWrapper_t* const SCSICommandBlock,
                                        void* BufferPtr)
 {
-	uint16_t BytesRem  = le32_to_cpu(SCSICommandBlock->DataTransferLength);
+	uint32_t BytesRem  = le32_to_cpu(SCSICommandBlock->DataTransferLength);
 	uint8_t portnum = MSInterfaceInfo->Config.PortNumber;
 #if defined(__LPC177X_8X__) || defined(__LPC407X_8X__)
 	uint8_t  ErrorCode = PIPE_RWSTREAM_NoError;
@@ -288,8 +288,17 @@ static uint8_t MS_Host_SendReceiveData(USB_ClassInfo_MS_Host_t* const MSInterfac
 		Pipe_SelectPipe(portnum,MSInterfaceInfo->Config.DataINPipeNumber);
 		Pipe_Unfreeze();
 
-		if ((ErrorCode = Pipe_Read_Stream_LE(portnum,BufferPtr, BytesRem, NULL)) != PIPE_RWSTREAM_NoError)
-		  return ErrorCode;
+		/* The pipe streams take 16-bit lengths, a long READ is read in parts */
+		while (BytesRem)
+		{
+			uint16_t Length = MIN(BytesRem, MS_STREAM_CHUNK_SIZE);
+
+			if ((ErrorCode = Pipe_Read_Stream_LE(portnum,BufferPtr, Length, NULL)) != PIPE_RWSTREAM_NoError)
+			  return ErrorCode;
+
+			BufferPtr = (uint8_t*)BufferPtr + Length;
+			BytesRem -= Length;
+		}
 
 		Pipe_ClearIN(portnum);
 	}
@@ -298,8 +307,16 @@ static uint8_t MS_Host_SendReceiveData(USB_ClassInfo_MS_Host_t* const MSInterfac
 		Pipe_SelectPipe(portnum,MSInterfaceInfo->Config.DataOUTPipeNumber);
 		Pipe_Unfreeze();
 
-		if ((ErrorCode = Pipe_Write_Stream_LE(portnum,BufferPtr, BytesRem, NULL)) != PIPE_RWSTREAM_NoError)
-		  return ErrorCode;
+		while (BytesRem)
+		{
+			uint16_t Length = MIN(BytesRem, MS_STREAM_CHUNK_SIZE);
+
+			if ((ErrorCode = Pipe_Write_Stream_LE(portnum,BufferPtr, Length, NULL)) != PIPE_RWSTREAM_NoError)
+			  return ErrorCode;
+
+			BufferPtr = (uint8_t*)BufferPtr + Length;
+			BytesRem -= Length;
+		}
 
 		Pipe_ClearOUT(portnum);
 
@@ -587,7 +604,7 @@ uint8_t MS_Host_PreventAllowMediumRemoval(USB_ClassInfo_MS_Host_t* const MSInter
 uint8_t MS_Host_ReadDeviceBlocks(USB_ClassInfo_MS_Host_t* const MSInterfaceInfo,
                                  const uint8_t LUNIndex,
                                  const uint32_t BlockAddress,
-                                 const uint8_t Blocks,
+                                 const uint16_t Blocks,
                                  const uint16_t BlockSize,
                                  void* BlockBuffer)
 {
@@ -611,8 +628,8 @@ uint8_t MS_Host_ReadDeviceBlocks(USB_ClassInfo_MS_Host_t* const MSInterfaceInfo,
 					(BlockAddress >> 8),
 					(BlockAddress & 0xFF),  // LSB of Block Address
 					0x00,                   // Reserved
-					0x00,                   // MSB of Total Blocks to Read
-					Blocks,                 // LSB of Total Blocks to Read
+					(Blocks >> 8),          // MSB of Total Blocks to Read
+					(Blocks & 0xFF),        // LSB of Total Blocks to Read
 					0x00                    // Unused (control)
 				}
 		};
@@ -626,7 +643,7 @@ uint8_t MS_Host_ReadDeviceBlocks(USB_ClassInfo_MS_Host_t* const MSInterfaceInfo,
 uint8_t MS_Host_WriteDeviceBlocks(USB_ClassInfo_MS_Host_t* const MSInterfaceInfo,
                                   const uint8_t LUNIndex,
                                   const uint32_t BlockAddress,
-                                  const uint8_t Blocks,
+                                  const uint16_t Blocks,
                                   const uint16_t BlockSize,
                                   const void* BlockBuffer)
 {
@@ -650,8 +667,8 @@ uint8_t MS_Host_WriteDeviceBlocks(USB_ClassInfo_MS_Host_t* const MSInterfaceInfo
 					(BlockAddress >> 8),
 					(BlockAddress & 0xFF),  // LSB of Block Address
 					0x00,                   // Reserved
-					0x00,                   // MSB of Total Blocks to Write
-					Blocks,                 // LSB of Total Blocks to Write
+					(Blocks >> 8),          // MSB of Total Blocks to Write
+					(Blocks & 0xFF),        // LSB of Total Blocks to Write
 					0x00                    // Unused (control)
 				}
 		};
@@ -252,7 +252,7 @@
 			 *  @param MSInterfaceInfo : Pointer to a structure containing a MS Class host configuration and state.
 			 *  @param LUNIndex        : LUN index within the device the command is being issued to.
 			 *  @param BlockAddress    : Starting block address within the device to read from.
-			 *  @param Blocks          : Total number of blocks to read.
+			 *  @param Blocks          : Total number of blocks to read, up to 65535 in one READ (10) command.
 			 *  @param BlockSize       : Size in bytes of each block within the device.
 			 *  @param BlockBuffer     : Pointer to where the read data from the device should be stored.
 			 *
@@ -261,7 +261,7 @@
 			uint8_t MS_Host_ReadDeviceBlocks(USB_ClassInfo_MS_Host_t* const MSInterfaceInfo,
 			                                 const uint8_t LUNIndex,
 			                                 const uint32_t BlockAddress,
-			                                 const uint8_t Blocks,
+			                                 const uint16_t Blocks,
 			                                 const uint16_t BlockSize,
 			                                 void* BlockBuffer) ATTR_NON_NULL_PTR_ARG(1) ATTR_NON_NULL_PTR_ARG(6);
 
@@ -273,7 +273,7 @@
 			 *  @param MSInterfaceInfo : Pointer to a structure containing a MS Class host configuration and state.
 			 *  @param LUNIndex        : LUN index within the device the command is being issued to.
 			 *  @param BlockAddress    : Starting block address within the device to write to.
-			 *  @param Blocks          : Total number of blocks to read.
+			 *  @param Blocks          : Total number of blocks to write, up to 65535 in one WRITE (10) command.
 			 *  @param BlockSize       : Size in bytes of each block within the device.
 			 *  @param BlockBuffer     : Pointer to where the data to write should be sourced from.
 			 *
@@ -282,7 +282,7 @@
 			uint8_t MS_Host_WriteDeviceBlocks(USB_ClassInfo_MS_Host_t* const MSInterfaceInfo,
 			                                  const uint8_t LUNIndex,
 			                                  const uint32_t BlockAddress,
-			                                  const uint8_t Blocks,
+			                                  const uint16_t Blocks,
 			                                  const uint16_t BlockSize,
 			                                  const void* BlockBuffer) ATTR_NON_NULL_PTR_ARG(1) ATTR_NON_NULL_PTR_ARG(6);
 
@@ -304,6 +304,7 @@
 	#if !defined(__DOXYGEN__)
 		/* Macros: */
 			#define MS_COMMAND_DATA_TIMEOUT_MS        10000
+			#define MS_STREAM_CHUNK_SIZE              0x8000	/* Part of a data phase per 16-bit pipe stream call */
 
 		/* Function Prototypes: */
 			#if defined(__INCLUDE_FROM_MASSSTORAGE_HOST_C)
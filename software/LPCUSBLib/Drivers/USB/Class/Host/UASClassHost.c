@@ -0,0 +1,891 @@
+/*
+ * @brief Host mode driver for the USB Attached SCSI (UAS) protocol of the Mass Storage Class
+ *
+ * @note
+ * Copyright(C) NXP Semiconductors, 2012
+ * All rights reserved.
+ *
+ * @par
+ * Software that is described herein is for illustrative purposes only
+ * which provides customers with programming information regarding the
+ * LPC products.  This software is supplied "AS IS" without any warranties of
+ * any kind, and NXP Semiconductors and its licensor disclaim any and
+ * all warranties, express or implied, including all implied warranties of
+ * merchantability, fitness for a particular purpose and non-infringement of
+ * intellectual property rights.  NXP Semiconductors assumes no responsibility
+ * or liability for the use of the software, conveys no license or rights under any
+ * patent, copyright, mask work right, or any other intellectual property rights in
+ * or to any products. NXP Semiconductors reserves the right to make changes
+ * in the software without notification. NXP Semiconductors also makes no
+ * representation or warranty that such application will be suitable for the
+ * specified use without further testing or modification.
+ *
+ * @par
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation is hereby granted, under NXP Semiconductors' and its
+ * licensor's relevant copyrights in the software, without fee, provided that it
+ * is used in conjunction with NXP Semiconductors microcontrollers.  This
+ * copyright, permission, and disclaimer notice must appear in all copies of
+ * this code.
+ */
+
+
+#define  __INCLUDE_FROM_USB_DRIVER
+#include "../../Core/USBMode.h"
+
+#if defined(USB_CAN_BE_HOST)
+
+#define  __INCLUDE_FROM_MS_DRIVER
+#define  __INCLUDE_FROM_UAS_HOST_C
+#include "UASClassHost.h"
+
+/* Offsets inside the Command and Sense IUs */
+#define UAS_IU_TAG_OFFSET           2
+#define UAS_CMD_IU_LUN_OFFSET       8
+#define UAS_CMD_IU_CDB_OFFSET       16
+#define UAS_SENSE_IU_STATUS_OFFSET  6
+#define UAS_SENSE_IU_LENGTH_OFFSET  14
+#define UAS_SENSE_IU_DATA_OFFSET    16
+#define UAS_RESPONSE_IU_CODE_OFFSET 7
+#define UAS_TM_IU_FUNCTION_OFFSET   4
+#define UAS_TM_IU_TASK_TAG_OFFSET   6
+
+/* Response codes of a task management function that did its job */
+#define UAS_TMF_RESPONSE_COMPLETE   0x00
+#define UAS_TMF_RESPONSE_SUCCEEDED  0x08
+
+uint8_t UAS_Host_ConfigurePipes(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+                                uint16_t ConfigDescriptorSize,
+                                void* ConfigDescriptorData)
+{
+	USB_Descriptor_Endpoint_t*  Endpoints[UAS_PIPEID_DataOUT + 1] = { NULL };
+	USB_Descriptor_Endpoint_t*  LastEndpoint = NULL;
+	USB_Descriptor_Interface_t* UASInterface = NULL;
+	uint16_t BytesRem       = ConfigDescriptorSize;
+	void*    DescriptorData = ConfigDescriptorData;
+	uint8_t  portnum        = UASInterfaceInfo->Config.PortNumber;
+
+	memset(&UASInterfaceInfo->State, 0x00, sizeof(UASInterfaceInfo->State));
+
+	if (DESCRIPTOR_TYPE(ConfigDescriptorData) != DTYPE_Configuration)
+	  return UAS_ENUMERROR_InvalidConfigDescriptor;
+
+#if !defined(__LPC177X_8X__) && !defined(__LPC407X_8X__)
+	/* Look for an alternate setting with the UAS protocol and the four pipe usage descriptors */
+	while (BytesRem && !(Endpoints[UAS_PIPEID_Command] && Endpoints[UAS_PIPEID_Status] &&
+	                     Endpoints[UAS_PIPEID_DataIN]  && Endpoints[UAS_PIPEID_DataOUT]))
+	{
+		USB_GetNextDescriptor(&BytesRem, &DescriptorData);
+
+		if (!(BytesRem))
+		  break;
+
+		switch (DESCRIPTOR_TYPE(DescriptorData))
+		{
+			case DTYPE_Interface:
+			{
+				USB_Descriptor_Interface_t* Interface = DESCRIPTOR_PCAST(DescriptorData, USB_Descriptor_Interface_t);
+
+				if ((Interface->Class    == MS_CSCP_MassStorageClass)        &&
+				    (Interface->SubClass == MS_CSCP_SCSITransparentSubclass) &&
+				    (Interface->Protocol == MS_CSCP_UASProtocol))
+				{
+					UASInterface = Interface;
+				}
+				else
+				{
+					UASInterface = NULL;
+				}
+
+				memset(Endpoints, 0x00, sizeof(Endpoints));
+				LastEndpoint = NULL;
+				break;
+			}
+
+			case DTYPE_Endpoint:
+				if (UASInterface)
+				{
+					USB_Descriptor_Endpoint_t* Endpoint = DESCRIPTOR_PCAST(DescriptorData, USB_Descriptor_Endpoint_t);
+
+					LastEndpoint = ((Endpoint->Attributes & EP_TYPE_MASK) == EP_TYPE_BULK) ? Endpoint : NULL;
+				}
+				break;
+
+			case UAS_DTYPE_PipeUsage:
+				if (UASInterface && LastEndpoint)
+				{
+					uint8_t PipeID = DESCRIPTOR_PCAST(DescriptorData, UAS_Descriptor_PipeUsage_t)->PipeID;
+
+					if ((PipeID >= UAS_PIPEID_Command) && (PipeID <= UAS_PIPEID_DataOUT))
+					  Endpoints[PipeID] = LastEndpoint;
+				}
+				break;
+		}
+	}
+#endif
+
+	if (!(UASInterface) || !(Endpoints[UAS_PIPEID_Command] && Endpoints[UAS_PIPEID_Status] &&
+	                         Endpoints[UAS_PIPEID_DataIN]  && Endpoints[UAS_PIPEID_DataOUT]))
+	{
+		/* No UAS alternate setting, drive the device through Bulk-Only Transport */
+		USB_ClassInfo_MS_Host_t* BOTInterface = UASInterfaceInfo->Config.BOTInterface;
+		uint8_t ErrorCode;
+
+		if (BOTInterface == NULL)
+		  return UAS_ENUMERROR_NoCompatibleInterfaceFound;
+
+		BOTInterface->Config.PortNumber = portnum;
+
+		if ((ErrorCode = MS_Host_ConfigurePipes(BOTInterface, ConfigDescriptorSize,
+		                                        ConfigDescriptorData)) != MS_ENUMERROR_NoError)
+		{
+			return ErrorCode;
+		}
+
+		UASInterfaceInfo->State.InterfaceNumber = BOTInterface->State.InterfaceNumber;
+		UASInterfaceInfo->State.IsActive = true;
+
+		return UAS_ENUMERROR_NoError;
+	}
+
+	for (uint8_t PipeID = UAS_PIPEID_Command; PipeID <= UAS_PIPEID_DataOUT; PipeID++)
+	{
+		USB_Descriptor_Endpoint_t* Endpoint = Endpoints[PipeID];
+		uint16_t Size = le16_to_cpu(Endpoint->EndpointSize);
+		uint8_t  PipeNum;
+		uint8_t  Token;
+
+		switch (PipeID)
+		{
+			case UAS_PIPEID_Command:
+				PipeNum = UASInterfaceInfo->Config.CommandPipeNumber;
+				UASInterfaceInfo->State.CommandPipeSize = Size;
+				break;
+			case UAS_PIPEID_Status:
+				PipeNum = UASInterfaceInfo->Config.StatusPipeNumber;
+				UASInterfaceInfo->State.StatusPipeSize = Size;
+				break;
+			case UAS_PIPEID_DataIN:
+				PipeNum = UASInterfaceInfo->Config.DataINPipeNumber;
+				UASInterfaceInfo->State.DataINPipeSize = Size;
+				break;
+			default:
+				PipeNum = UASInterfaceInfo->Config.DataOUTPipeNumber;
+				UASInterfaceInfo->State.DataOUTPipeSize = Size;
+				break;
+		}
+
+		Token = ((Endpoint->EndpointAddress & ENDPOINT_DIR_MASK) == ENDPOINT_DIR_IN) ? PIPE_TOKEN_IN : PIPE_TOKEN_OUT;
+
+		if (!(Pipe_ConfigurePipe(portnum, PipeNum, EP_TYPE_BULK, Token, Endpoint->EndpointAddress, Size,
+		                         PIPE_BANK_SINGLE, 0)))
+		{
+			return UAS_ENUMERROR_PipeConfigurationFailed;
+		}
+	}
+
+	UASInterfaceInfo->State.InterfaceNumber  = UASInterface->InterfaceNumber;
+	UASInterfaceInfo->State.AlternateSetting = UASInterface->AlternateSetting;
+	UASInterfaceInfo->State.IsUAS    = true;
+	UASInterfaceInfo->State.IsActive = true;
+
+	return UAS_ENUMERROR_NoError;
+}
+
+uint8_t UAS_Host_SelectAlternateSetting(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo)
+{
+	if (!(UASInterfaceInfo->State.IsUAS) || !(UASInterfaceInfo->State.AlternateSetting))
+	  return HOST_SENDCONTROL_Successful;
+
+	return USB_Host_SetInterfaceAltSetting(UASInterfaceInfo->Config.PortNumber,
+	                                       UASInterfaceInfo->State.InterfaceNumber,
+	                                       UASInterfaceInfo->State.AlternateSetting);
+}
+
+static UAS_Host_Request_t* UAS_Host_GetRequest(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+                                               const uint8_t Tag)
+{
+	if (!(Tag) || (Tag > UAS_HOST_MAX_QUEUE_DEPTH))
+	  return NULL;
+
+	return &UASInterfaceInfo->State.Requests[Tag - 1];
+}
+
+static uint8_t UAS_Host_StartTransfer(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+                                      const uint8_t PipeNumber,
+                                      void* Buffer,
+                                      const uint32_t Length)
+{
+	uint8_t  portnum = UASInterfaceInfo->Config.PortNumber;
+	uint16_t packsize;
+
+	if (PipeNumber == UASInterfaceInfo->Config.DataINPipeNumber)
+	  packsize = UASInterfaceInfo->State.DataINPipeSize;
+	else if (PipeNumber == UASInterfaceInfo->Config.DataOUTPipeNumber)
+	  packsize = UASInterfaceInfo->State.DataOUTPipeSize;
+	else if (PipeNumber == UASInterfaceInfo->Config.CommandPipeNumber)
+	  packsize = UASInterfaceInfo->State.CommandPipeSize;
+	else
+	  packsize = UASInterfaceInfo->State.StatusPipeSize;
+
+	Pipe_SelectPipe(portnum, PipeNumber);
+
+	return Pipe_Streaming(portnum, (uint8_t*)Buffer, Length, packsize);
+}
+
+static HCD_STATUS UAS_Host_GetTransferStatus(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+                                             const uint8_t PipeNumber)
+{
+	return HcdGetPipeStatus(PipeInfo[UASInterfaceInfo->Config.PortNumber][PipeNumber].PipeHandle);
+}
+
+static void UAS_Host_RecoverPipe(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+                                 const uint8_t PipeNumber)
+{
+	uint8_t portnum = UASInterfaceInfo->Config.PortNumber;
+
+	Pipe_SelectPipe(portnum, PipeNumber);
+	Pipe_ClearStall(portnum);
+	USB_Host_ClearEndpointStall(portnum, Pipe_GetBoundEndpointAddress(portnum));
+}
+
+static void UAS_Host_CompleteRequest(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+                                     UAS_Host_Request_t* const Request,
+                                     const uint8_t ErrorCode)
+{
+	(void)UASInterfaceInfo;
+
+	Request->ErrorCode = ErrorCode;
+	Request->State     = UAS_REQ_Complete;
+}
+
+static uint8_t UAS_Host_QueueResult(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+                                    const uint8_t ErrorCode,
+                                    uint8_t* const Tag)
+{
+	for (uint8_t i = 0; i < UAS_HOST_MAX_QUEUE_DEPTH; i++)
+	{
+		UAS_Host_Request_t* Request = &UASInterfaceInfo->State.Requests[i];
+
+		if (Request->State == UAS_REQ_Free)
+		{
+			UAS_Host_CompleteRequest(UASInterfaceInfo, Request, ErrorCode);
+			*Tag = i + 1;
+			return PIPE_RWSTREAM_NoError;
+		}
+	}
+
+	return UAS_ERROR_QUEUE_FULL;
+}
+
+static uint8_t UAS_Host_QueueCommand(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+                                     const uint8_t LUNIndex,
+                                     const uint8_t* const CDB,
+                                     const uint8_t CDBLength,
+                                     const bool DataIN,
+                                     void* Buffer,
+                                     const uint32_t Length,
+                                     uint8_t* const Tag)
+{
+	UAS_Host_Request_t* Request = NULL;
+	uint8_t    portnum = UASInterfaceInfo->Config.PortNumber;
+	uint8_t    ErrorCode;
+	uint8_t    Slot;
+	HCD_STATUS Status;
+
+	if ((USB_HostState[portnum] != HOST_STATE_Configured) || !(UASInterfaceInfo->State.IsActive))
+	  return HOST_SENDCONTROL_DeviceDisconnected;
+
+	for (Slot = 0; Slot < UAS_HOST_MAX_QUEUE_DEPTH; Slot++)
+	{
+		if (UASInterfaceInfo->State.Requests[Slot].State == UAS_REQ_Free)
+		{
+			Request = &UASInterfaceInfo->State.Requests[Slot];
+			break;
+		}
+	}
+
+	if (Request == NULL)
+	  return UAS_ERROR_QUEUE_FULL;
+
+	/* Command IU: SIMPLE task attribute, single level LUN, CDB of up to 16 bytes */
+	memset(Request->CommandIU, 0x00, sizeof(Request->CommandIU));
+	Request->CommandIU[0]                         = UAS_IU_Command;
+	Request->CommandIU[UAS_IU_TAG_OFFSET]         = 0;
+	Request->CommandIU[UAS_IU_TAG_OFFSET + 1]     = Slot + 1;
+	Request->CommandIU[UAS_CMD_IU_LUN_OFFSET + 1] = LUNIndex;
+	memcpy(&Request->CommandIU[UAS_CMD_IU_CDB_OFFSET], CDB, MIN(CDBLength, 16));
+
+	Request->DataIN    = DataIN;
+	Request->Buffer    = (Length ? Buffer : NULL);
+	Request->Length    = Length;
+	Request->ErrorCode = PIPE_RWSTREAM_NoError;
+	Request->State     = UAS_REQ_CommandSent;
+
+	if ((ErrorCode = UAS_Host_StartTransfer(UASInterfaceInfo, UASInterfaceInfo->Config.CommandPipeNumber,
+	                                        Request->CommandIU, UAS_COMMAND_IU_SIZE)) != PIPE_RWSTREAM_NoError)
+	{
+		Request->State = UAS_REQ_Free;
+		return ErrorCode;
+	}
+
+	while ((Status = UAS_Host_GetTransferStatus(UASInterfaceInfo, UASInterfaceInfo->Config.CommandPipeNumber))
+	       == HCD_STATUS_TRANSFER_QUEUED)
+	{
+		if (USB_HostState[portnum] == HOST_STATE_Unattached)
+		{
+			Request->State = UAS_REQ_Free;
+			return PIPE_RWSTREAM_DeviceDisconnected;
+		}
+	}
+
+	if (Status != HCD_STATUS_OK)
+	{
+		UAS_Host_RecoverPipe(UASInterfaceInfo, UASInterfaceInfo->Config.CommandPipeNumber);
+		Request->State = UAS_REQ_Free;
+		return PIPE_RWSTREAM_PipeStalled;
+	}
+
+	*Tag = Slot + 1;
+
+	/* Arm the status pipe straight away so the device can answer */
+	UAS_Host_USBTask(UASInterfaceInfo);
+
+	return PIPE_RWSTREAM_NoError;
+}
+
+static void UAS_Host_ProcessStatusIU(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo)
+{
+	uint8_t* IU     = UASInterfaceInfo->State.StatusIU;
+	uint16_t Length = PipeInfo[UASInterfaceInfo->Config.PortNumber][UASInterfaceInfo->Config.StatusPipeNumber].ByteTransfered;
+	UAS_Host_Request_t* Request;
+
+	if ((Length < 4) || IU[UAS_IU_TAG_OFFSET])
+	  return;
+
+	if (IU[UAS_IU_TAG_OFFSET + 1] == UAS_TASK_MGMT_TAG)
+	{
+		if ((IU[0] == UAS_IU_Response) && (Length > UAS_RESPONSE_IU_CODE_OFFSET))
+		  UASInterfaceInfo->State.TaskMgmtResponse = IU[UAS_RESPONSE_IU_CODE_OFFSET];
+
+		return;
+	}
+
+	Request = UAS_Host_GetRequest(UASInterfaceInfo, IU[UAS_IU_TAG_OFFSET + 1]);
+
+	/* IUs of an aborted command are dropped, the abort decides when its slot is free again */
+	if ((Request == NULL) || (Request->State == UAS_REQ_Free) || (Request->State == UAS_REQ_Complete) ||
+	    (Request->State == UAS_REQ_Aborted))
+	{
+		return;
+	}
+
+	switch (IU[0])
+	{
+		case UAS_IU_ReadReady:
+		case UAS_IU_WriteReady:
+			if (Request->State == UAS_REQ_CommandSent)
+			  Request->State = UAS_REQ_DataReady;
+			break;
+
+		case UAS_IU_Sense:
+			if (IU[UAS_SENSE_IU_STATUS_OFFSET] == MS_SCSI_COMMAND_Pass)
+			{
+				UAS_Host_CompleteRequest(UASInterfaceInfo, Request, PIPE_RWSTREAM_NoError);
+			}
+			else
+			{
+				uint16_t SenseLength = (IU[UAS_SENSE_IU_LENGTH_OFFSET] << 8) | IU[UAS_SENSE_IU_LENGTH_OFFSET + 1];
+
+				/* Sense data is delivered with the status, keep it for UAS_Host_RequestSense() */
+				SenseLength = MIN(SenseLength, sizeof(SCSI_Request_Sense_Response_t));
+				SenseLength = MIN(SenseLength, (Length > UAS_SENSE_IU_DATA_OFFSET) ? (Length - UAS_SENSE_IU_DATA_OFFSET) : 0);
+
+				memset(&UASInterfaceInfo->State.SenseData, 0x00, sizeof(SCSI_Request_Sense_Response_t));
+				memcpy(&UASInterfaceInfo->State.SenseData, &IU[UAS_SENSE_IU_DATA_OFFSET], SenseLength);
+
+				UAS_Host_CompleteRequest(UASInterfaceInfo, Request, MS_ERROR_LOGICAL_CMD_FAILED);
+			}
+			break;
+
+		case UAS_IU_Response:
+			UAS_Host_CompleteRequest(UASInterfaceInfo, Request, IU[UAS_RESPONSE_IU_CODE_OFFSET] ?
+			                         MS_ERROR_LOGICAL_CMD_FAILED : PIPE_RWSTREAM_NoError);
+			break;
+	}
+}
+
+void UAS_Host_USBTask(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo)
+{
+	uint8_t    portnum    = UASInterfaceInfo->Config.PortNumber;
+	bool       NeedStatus = false;
+	HCD_STATUS Status;
+
+	if ((USB_HostState[portnum] != HOST_STATE_Configured) || !(UASInterfaceInfo->State.IsActive) ||
+	    !(UASInterfaceInfo->State.IsUAS))
+	{
+		return;
+	}
+
+	/* Collect finished data phases first, the Sense IU of a command always follows its data */
+	for (uint8_t Dir = 0; Dir < 2; Dir++)
+	{
+		uint8_t* OwnerTag = Dir ? &UASInterfaceInfo->State.DataOUTTag : &UASInterfaceInfo->State.DataINTag;
+		uint8_t  PipeNum  = Dir ? UASInterfaceInfo->Config.DataOUTPipeNumber : UASInterfaceInfo->Config.DataINPipeNumber;
+
+		if (*OwnerTag && ((Status = UAS_Host_GetTransferStatus(UASInterfaceInfo, PipeNum)) != HCD_STATUS_TRANSFER_QUEUED))
+		{
+			UAS_Host_Request_t* Request = UAS_Host_GetRequest(UASInterfaceInfo, *OwnerTag);
+
+			*OwnerTag = 0;
+
+			if (Status != HCD_STATUS_OK)
+			{
+				UAS_Host_RecoverPipe(UASInterfaceInfo, PipeNum);
+				UAS_Host_CompleteRequest(UASInterfaceInfo, Request, PIPE_RWSTREAM_PipeStalled);
+			}
+			else if (Request->State == UAS_REQ_DataPhase)
+			{
+				Request->State = UAS_REQ_WaitStatus;
+			}
+		}
+	}
+
+	if (UASInterfaceInfo->State.StatusPending &&
+	    ((Status = UAS_Host_GetTransferStatus(UASInterfaceInfo, UASInterfaceInfo->Config.StatusPipeNumber)) != HCD_STATUS_TRANSFER_QUEUED))
+	{
+		UASInterfaceInfo->State.StatusPending = false;
+
+		if (Status == HCD_STATUS_OK)
+		{
+			UAS_Host_ProcessStatusIU(UASInterfaceInfo);
+		}
+		else
+		{
+			UAS_Host_RecoverPipe(UASInterfaceInfo, UASInterfaceInfo->Config.StatusPipeNumber);
+
+			for (uint8_t i = 0; i < UAS_HOST_MAX_QUEUE_DEPTH; i++)
+			{
+				UAS_Host_Request_t* Request = &UASInterfaceInfo->State.Requests[i];
+
+				if ((Request->State != UAS_REQ_Free) && (Request->State != UAS_REQ_Complete) &&
+				    (Request->State != UAS_REQ_Aborted))
+				{
+					UAS_Host_CompleteRequest(UASInterfaceInfo, Request, PIPE_RWSTREAM_PipeStalled);
+				}
+			}
+		}
+	}
+
+	/* Start the data phases the device asked for, one per direction at a time */
+	for (uint8_t i = 0; i < UAS_HOST_MAX_QUEUE_DEPTH; i++)
+	{
+		UAS_Host_Request_t* Request = &UASInterfaceInfo->State.Requests[i];
+
+		if (Request->State == UAS_REQ_DataReady)
+		{
+			uint8_t* OwnerTag = Request->DataIN ? &UASInterfaceInfo->State.DataINTag : &UASInterfaceInfo->State.DataOUTTag;
+			uint8_t  PipeNum  = Request->DataIN ? UASInterfaceInfo->Config.DataINPipeNumber : UASInterfaceInfo->Config.DataOUTPipeNumber;
+
+			if (Request->Buffer == NULL)
+			{
+				Request->State = UAS_REQ_WaitStatus;
+			}
+			else if (!(*OwnerTag) &&
+			         (UAS_Host_StartTransfer(UASInterfaceInfo, PipeNum, Request->Buffer, Request->Length) == PIPE_RWSTREAM_NoError))
+			{
+				*OwnerTag      = i + 1;
+				Request->State = UAS_REQ_DataPhase;
+			}
+		}
+
+		if ((Request->State != UAS_REQ_Free) && (Request->State != UAS_REQ_Complete) &&
+		    (Request->State != UAS_REQ_Aborted))
+		{
+			NeedStatus = true;
+		}
+	}
+
+	if (UASInterfaceInfo->State.TaskMgmtResponse == UAS_TASK_MGMT_PENDING)
+	  NeedStatus = true;
+
+	/* Keep a read queued on the status pipe while any command still expects an IU */
+	if (NeedStatus && !(UASInterfaceInfo->State.StatusPending))
+	{
+		if (UAS_Host_StartTransfer(UASInterfaceInfo, UASInterfaceInfo->Config.StatusPipeNumber,
+		                           UASInterfaceInfo->State.StatusIU, UAS_STATUS_IU_SIZE) == PIPE_RWSTREAM_NoError)
+		{
+			UASInterfaceInfo->State.StatusPending = true;
+		}
+	}
+}
+
+static void UAS_Host_ReleaseDataPipe(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+                                     const uint8_t Tag)
+{
+	uint8_t portnum = UASInterfaceInfo->Config.PortNumber;
+
+	/* Cancel the transfer queued for the tag, the controller must not touch its buffer any more */
+	for (uint8_t Dir = 0; Dir < 2; Dir++)
+	{
+		uint8_t* OwnerTag = Dir ? &UASInterfaceInfo->State.DataOUTTag : &UASInterfaceInfo->State.DataINTag;
+		uint8_t  PipeNum  = Dir ? UASInterfaceInfo->Config.DataOUTPipeNumber : UASInterfaceInfo->Config.DataINPipeNumber;
+
+		if (*OwnerTag == Tag)
+		{
+			HcdCancelTransfer(PipeInfo[portnum][PipeNum].PipeHandle);
+			*OwnerTag = 0;
+		}
+	}
+}
+
+static uint8_t UAS_Host_TaskManagement(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+                                       const uint8_t Function,
+                                       const uint8_t LUNIndex,
+                                       const uint8_t TaskTag)
+{
+	uint8_t*   IU                  = UASInterfaceInfo->State.TaskMgmtIU;
+	uint16_t   TimeoutMSRem        = UAS_TASK_MGMT_TIMEOUT_MS;
+	uint16_t   PreviousFrameNumber = USB_Host_GetFrameNumber();
+	uint8_t    portnum             = UASInterfaceInfo->Config.PortNumber;
+	uint8_t    ErrorCode;
+	HCD_STATUS Status;
+
+	memset(IU, 0x00, UAS_TASK_MGMT_IU_SIZE);
+	IU[0]                             = UAS_IU_TaskManagement;
+	IU[UAS_IU_TAG_OFFSET + 1]         = UAS_TASK_MGMT_TAG;
+	IU[UAS_TM_IU_FUNCTION_OFFSET]     = Function;
+	IU[UAS_TM_IU_TASK_TAG_OFFSET + 1] = TaskTag;
+	IU[UAS_CMD_IU_LUN_OFFSET + 1]     = LUNIndex;
+
+	if ((ErrorCode = UAS_Host_StartTransfer(UASInterfaceInfo, UASInterfaceInfo->Config.CommandPipeNumber,
+	                                        IU, UAS_TASK_MGMT_IU_SIZE)) != PIPE_RWSTREAM_NoError)
+	{
+		return ErrorCode;
+	}
+
+	while ((Status = UAS_Host_GetTransferStatus(UASInterfaceInfo, UASInterfaceInfo->Config.CommandPipeNumber))
+	       == HCD_STATUS_TRANSFER_QUEUED)
+	{
+		if (USB_HostState[portnum] == HOST_STATE_Unattached)
+		  return PIPE_RWSTREAM_DeviceDisconnected;
+	}
+
+	if (Status != HCD_STATUS_OK)
+	{
+		UAS_Host_RecoverPipe(UASInterfaceInfo, UASInterfaceInfo->Config.CommandPipeNumber);
+		return PIPE_RWSTREAM_PipeStalled;
+	}
+
+	/* The Response IU comes on the status pipe, kept armed by the task while the function is pending */
+	UASInterfaceInfo->State.TaskMgmtResponse = UAS_TASK_MGMT_PENDING;
+
+	while (UASInterfaceInfo->State.TaskMgmtResponse == UAS_TASK_MGMT_PENDING)
+	{
+		UAS_Host_USBTask(UASInterfaceInfo);
+
+		uint16_t CurrentFrameNumber = USB_Host_GetFrameNumber();
+
+		if (CurrentFrameNumber != PreviousFrameNumber)
+		{
+			PreviousFrameNumber = CurrentFrameNumber;
+
+			if (!(TimeoutMSRem--))
+			{
+				UASInterfaceInfo->State.TaskMgmtResponse = 0;
+				return PIPE_RWSTREAM_Timeout;
+			}
+		}
+
+		if (USB_HostState[portnum] == HOST_STATE_Unattached)
+		{
+			UASInterfaceInfo->State.TaskMgmtResponse = 0;
+			return PIPE_RWSTREAM_DeviceDisconnected;
+		}
+	}
+
+	if ((UASInterfaceInfo->State.TaskMgmtResponse != UAS_TMF_RESPONSE_COMPLETE) &&
+	    (UASInterfaceInfo->State.TaskMgmtResponse != UAS_TMF_RESPONSE_SUCCEEDED))
+	{
+		return MS_ERROR_LOGICAL_CMD_FAILED;
+	}
+
+	return PIPE_RWSTREAM_NoError;
+}
+
+static void UAS_Host_AbortRequest(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+                                  const uint8_t Tag)
+{
+	UAS_Host_Request_t* Request  = UAS_Host_GetRequest(UASInterfaceInfo, Tag);
+	uint8_t             LUNIndex = Request->CommandIU[UAS_CMD_IU_LUN_OFFSET + 1];
+
+	/* IUs still coming for the tag are dropped from now on */
+	Request->State = UAS_REQ_Aborted;
+	UAS_Host_ReleaseDataPipe(UASInterfaceInfo, Tag);
+
+	/* A detached device sends nothing more, the slot can be used again straight away */
+	if (USB_HostState[UASInterfaceInfo->Config.PortNumber] == HOST_STATE_Unattached)
+	{
+		Request->State = UAS_REQ_Free;
+		return;
+	}
+
+	if (UAS_Host_TaskManagement(UASInterfaceInfo, UAS_TMF_AbortTask, LUNIndex, Tag) == PIPE_RWSTREAM_NoError)
+	{
+		Request->State = UAS_REQ_Free;
+		return;
+	}
+
+	if (UAS_Host_TaskManagement(UASInterfaceInfo, UAS_TMF_LogicalUnitReset, LUNIndex, 0) != PIPE_RWSTREAM_NoError)
+	  return;
+
+	/* The reset dropped every command of the logical unit, none of them gets a Sense IU */
+	for (uint8_t i = 0; i < UAS_HOST_MAX_QUEUE_DEPTH; i++)
+	{
+		UAS_Host_Request_t* Other = &UASInterfaceInfo->State.Requests[i];
+
+		if ((Other->CommandIU[UAS_CMD_IU_LUN_OFFSET + 1] != LUNIndex) || (Other->State == UAS_REQ_Free) ||
+		    (Other->State == UAS_REQ_Complete))
+		{
+			continue;
+		}
+
+		UAS_Host_ReleaseDataPipe(UASInterfaceInfo, i + 1);
+
+		if (Other->State == UAS_REQ_Aborted)
+		  Other->State = UAS_REQ_Free;
+		else
+		  UAS_Host_CompleteRequest(UASInterfaceInfo, Other, PIPE_RWSTREAM_IncompleteTransfer);
+	}
+}
+
+uint8_t UAS_Host_WaitForRequest(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+                                const uint8_t Tag)
+{
+	UAS_Host_Request_t* Request = UAS_Host_GetRequest(UASInterfaceInfo, Tag);
+	uint16_t TimeoutMSRem        = UAS_COMMAND_DATA_TIMEOUT_MS;
+	uint16_t PreviousFrameNumber = USB_Host_GetFrameNumber();
+	uint8_t  portnum             = UASInterfaceInfo->Config.PortNumber;
+	uint8_t  ErrorCode;
+
+	if ((Request == NULL) || (Request->State == UAS_REQ_Free))
+	  return PIPE_RWSTREAM_IncompleteTransfer;
+
+	while (Request->State != UAS_REQ_Complete)
+	{
+		UAS_Host_USBTask(UASInterfaceInfo);
+
+		uint16_t CurrentFrameNumber = USB_Host_GetFrameNumber();
+
+		if (CurrentFrameNumber != PreviousFrameNumber)
+		{
+			PreviousFrameNumber = CurrentFrameNumber;
+
+			if (!(TimeoutMSRem--))
+			{
+				UAS_Host_AbortRequest(UASInterfaceInfo, Tag);
+				return PIPE_RWSTREAM_Timeout;
+			}
+		}
+
+		if (USB_HostState[portnum] == HOST_STATE_Unattached)
+		{
+			UAS_Host_AbortRequest(UASInterfaceInfo, Tag);
+			return PIPE_RWSTREAM_DeviceDisconnected;
+		}
+	}
+
+	ErrorCode      = Request->ErrorCode;
+	Request->State = UAS_REQ_Free;
+
+	return ErrorCode;
+}
+
+static uint8_t UAS_Host_SendCommand(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+                                    const uint8_t LUNIndex,
+                                    const uint8_t* const CDB,
+                                    const uint8_t CDBLength,
+                                    const bool DataIN,
+                                    void* Buffer,
+                                    const uint32_t Length)
+{
+	uint8_t ErrorCode;
+	uint8_t Tag;
+
+	if ((ErrorCode = UAS_Host_QueueCommand(UASInterfaceInfo, LUNIndex, CDB, CDBLength, DataIN,
+	                                       Buffer, Length, &Tag)) != PIPE_RWSTREAM_NoError)
+	{
+		return ErrorCode;
+	}
+
+	return UAS_Host_WaitForRequest(UASInterfaceInfo, Tag);
+}
+
+uint8_t UAS_Host_QueueReadBlocks(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+                                 const uint8_t LUNIndex,
+                                 const uint32_t BlockAddress,
+                                 const uint16_t Blocks,
+                                 const uint16_t BlockSize,
+                                 void* BlockBuffer,
+                                 uint8_t* const Tag)
+{
+	if (!(UASInterfaceInfo->State.IsUAS))
+	{
+		return UAS_Host_QueueResult(UASInterfaceInfo,
+		                            MS_Host_ReadDeviceBlocks(UASInterfaceInfo->Config.BOTInterface, LUNIndex,
+		                                                     BlockAddress, Blocks, BlockSize, BlockBuffer), Tag);
+	}
+
+	uint8_t CDB[10] =
+		{
+			SCSI_CMD_READ_10,
+			0x00,                   // Unused (control bits, all off)
+			(BlockAddress >> 24),   // MSB of Block Address
+			(BlockAddress >> 16),
+			(BlockAddress >> 8),
+			(BlockAddress & 0xFF),  // LSB of Block Address
+			0x00,                   // Unused (reserved)
+			(Blocks >> 8),          // MSB of Total Blocks to Read
+			(Blocks & 0xFF),        // LSB of Total Blocks to Read
+			0x00                    // Unused (control)
+		};
+
+	return UAS_Host_QueueCommand(UASInterfaceInfo, LUNIndex, CDB, sizeof(CDB), true, BlockBuffer,
+	                             ((uint32_t)Blocks * BlockSize), Tag);
+}
+
+uint8_t UAS_Host_QueueWriteBlocks(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+                                  const uint8_t LUNIndex,
+                                  const uint32_t BlockAddress,
+                                  const uint16_t Blocks,
+                                  const uint16_t BlockSize,
+                                  const void* BlockBuffer,
+                                  uint8_t* const Tag)
+{
+	if (!(UASInterfaceInfo->State.IsUAS))
+	{
+		return UAS_Host_QueueResult(UASInterfaceInfo,
+		                            MS_Host_WriteDeviceBlocks(UASInterfaceInfo->Config.BOTInterface, LUNIndex,
+		                                                      BlockAddress, Blocks, BlockSize, BlockBuffer), Tag);
+	}
+
+	uint8_t CDB[10] =
+		{
+			SCSI_CMD_WRITE_10,
+			0x00,                   // Unused (control bits, all off)
+			(BlockAddress >> 24),   // MSB of Block Address
+			(BlockAddress >> 16),
+			(BlockAddress >> 8),
+			(BlockAddress & 0xFF),  // LSB of Block Address
+			0x00,                   // Unused (reserved)
+			(Blocks >> 8),          // MSB of Total Blocks to Write
+			(Blocks & 0xFF),        // LSB of Total Blocks to Write
+			0x00                    // Unused (control)
+		};
+
+	return UAS_Host_QueueCommand(UASInterfaceInfo, LUNIndex, CDB, sizeof(CDB), false, (void*)BlockBuffer,
+	                             ((uint32_t)Blocks * BlockSize), Tag);
+}
+
+uint8_t UAS_Host_TestUnitReady(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+                               const uint8_t LUNIndex)
+{
+	if (!(UASInterfaceInfo->State.IsUAS))
+	  return MS_Host_TestUnitReady(UASInterfaceInfo->Config.BOTInterface, LUNIndex);
+
+	uint8_t CDB[6] = { SCSI_CMD_TEST_UNIT_READY, 0x00, 0x00, 0x00, 0x00, 0x00 };
+
+	return UAS_Host_SendCommand(UASInterfaceInfo, LUNIndex, CDB, sizeof(CDB), true, NULL, 0);
+}
+
+uint8_t UAS_Host_GetInquiryData(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+                                const uint8_t LUNIndex,
+                                SCSI_Inquiry_Response_t* const InquiryData)
+{
+	if (!(UASInterfaceInfo->State.IsUAS))
+	  return MS_Host_GetInquiryData(UASInterfaceInfo->Config.BOTInterface, LUNIndex, InquiryData);
+
+	uint8_t CDB[6] = { SCSI_CMD_INQUIRY, 0x00, 0x00, 0x00, sizeof(SCSI_Inquiry_Response_t), 0x00 };
+
+	return UAS_Host_SendCommand(UASInterfaceInfo, LUNIndex, CDB, sizeof(CDB), true, InquiryData,
+	                            sizeof(SCSI_Inquiry_Response_t));
+}
+
+uint8_t UAS_Host_ReadDeviceCapacity(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+                                    const uint8_t LUNIndex,
+                                    SCSI_Capacity_t* const DeviceCapacity)
+{
+	uint8_t ErrorCode;
+
+	if (!(UASInterfaceInfo->State.IsUAS))
+	  return MS_Host_ReadDeviceCapacity(UASInterfaceInfo->Config.BOTInterface, LUNIndex, DeviceCapacity);
+
+	uint8_t CDB[10] = { SCSI_CMD_READ_CAPACITY_10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+
+	if ((ErrorCode = UAS_Host_SendCommand(UASInterfaceInfo, LUNIndex, CDB, sizeof(CDB), true, DeviceCapacity,
+	                                      sizeof(SCSI_Capacity_t))) != PIPE_RWSTREAM_NoError)
+	{
+		return ErrorCode;
+	}
+
+	DeviceCapacity->Blocks    = BE32_TO_CPU(DeviceCapacity->Blocks);
+	DeviceCapacity->BlockSize = BE32_TO_CPU(DeviceCapacity->BlockSize);
+
+	return PIPE_RWSTREAM_NoError;
+}
+
+uint8_t UAS_Host_RequestSense(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+                              const uint8_t LUNIndex,
+                              SCSI_Request_Sense_Response_t* const SenseData)
+{
+	if (!(UASInterfaceInfo->State.IsUAS))
+	  return MS_Host_RequestSense(UASInterfaceInfo->Config.BOTInterface, LUNIndex, SenseData);
+
+	if ((USB_HostState[UASInterfaceInfo->Config.PortNumber] != HOST_STATE_Configured) || !(UASInterfaceInfo->State.IsActive))
+	  return HOST_SENDCONTROL_DeviceDisconnected;
+
+	memcpy(SenseData, &UASInterfaceInfo->State.SenseData, sizeof(SCSI_Request_Sense_Response_t));
+	memset(&UASInterfaceInfo->State.SenseData, 0x00, sizeof(SCSI_Request_Sense_Response_t));
+
+	return PIPE_RWSTREAM_NoError;
+}
+
+uint8_t UAS_Host_ReadDeviceBlocks(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+                                  const uint8_t LUNIndex,
+                                  const uint32_t BlockAddress,
+                                  const uint16_t Blocks,
+                                  const uint16_t BlockSize,
+                                  void* BlockBuffer)
+{
+	uint8_t ErrorCode;
+	uint8_t Tag;
+
+	if ((ErrorCode = UAS_Host_QueueReadBlocks(UASInterfaceInfo, LUNIndex, BlockAddress, Blocks, BlockSize,
+	                                          BlockBuffer, &Tag)) != PIPE_RWSTREAM_NoError)
+	{
+		return ErrorCode;
+	}
+
+	return UAS_Host_WaitForRequest(UASInterfaceInfo, Tag);
+}
+
+uint8_t UAS_Host_WriteDeviceBlocks(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+                                   const uint8_t LUNIndex,
+                                   const uint32_t BlockAddress,
+                                   const uint16_t Blocks,
+                                   const uint16_t BlockSize,
+                                   const void* BlockBuffer)
+{
+	uint8_t ErrorCode;
+	uint8_t Tag;
+
+	if ((ErrorCode = UAS_Host_QueueWriteBlocks(UASInterfaceInfo, LUNIndex, BlockAddress, Blocks, BlockSize,
+	                                           BlockBuffer, &Tag)) != PIPE_RWSTREAM_NoError)
+	{
+		return ErrorCode;
+	}
+
+	return UAS_Host_WaitForRequest(UASInterfaceInfo, Tag);
+}
+
+#endif
@@ -0,0 +1,469 @@
+/*
+ * @brief Host mode driver for the USB Attached SCSI (UAS) protocol of the Mass Storage Class
+ *
+ * @note
+ * Copyright(C) NXP Semiconductors, 2012
+ * All rights reserved.
+ *
+ * @par
+ * Software that is described herein is for illustrative purposes only
+ * which provides customers with programming information regarding the
+ * LPC products.  This software is supplied "AS IS" without any warranties of
+ * any kind, and NXP Semiconductors and its licensor disclaim any and
+ * all warranties, express or implied, including all implied warranties of
+ * merchantability, fitness for a particular purpose and non-infringement of
+ * intellectual property rights.  NXP Semiconductors assumes no responsibility
+ * or liability for the use of the software, conveys no license or rights under any
+ * patent, copyright, mask work right, or any other intellectual property rights in
+ * or to any products. NXP Semiconductors reserves the right to make changes
+ * in the software without notification. NXP Semiconductors also makes no
+ * representation or warranty that such application will be suitable for the
+ * specified use without further testing or modification.
+ *
+ * @par
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation is hereby granted, under NXP Semiconductors' and its
+ * licensor's relevant copyrights in the software, without fee, provided that it
+ * is used in conjunction with NXP Semiconductors microcontrollers.  This
+ * copyright, permission, and disclaimer notice must appear in all copies of
+ * this code.
+ */
+
+/** @ingroup Group_USBClassMS
+ *  @defgroup Group_USBClassUASHost USB Attached SCSI Host Mode Driver
+ *
+ *  @section Sec_Dependencies Module Source Dependencies
+ *  The following files must be built with any user project that uses this module:
+ *    - LPCUSBlib/Drivers/USB/Class/Host/UASClassHost.c <i>(Makefile source module name: LPCUSBlib_SRC_USBCLASS)</i>
+ *    - LPCUSBlib/Drivers/USB/Class/Host/MassStorageClassHost.c <i>(Makefile source module name: LPCUSBlib_SRC_USBCLASS)</i>
+ *
+ *  @section Sec_ModDescription Module Description
+ *  Host Mode USB Class driver framework interface for the USB Attached SCSI protocol of the Mass Storage class.
+ *  Commands are sent as tagged information units over separate command, status and data pipes, so that up to
+ *  @ref UAS_HOST_MAX_QUEUE_DEPTH commands can be in flight at once. Devices without a UAS alternate setting are
+ *  driven through the Bulk-Only Transport driver instead, transparently to the caller.
+ *
+ *  @{
+ */
+
+#ifndef __UAS_CLASS_HOST_H__
+#define __UAS_CLASS_HOST_H__
+
+	/* Includes: */
+		#include "../../USB.h"
+		#include "../Common/MassStorageClassCommon.h"
+		#include "MassStorageClassHost.h"
+
+	/* Enable C linkage for C++ Compilers: */
+		#if defined(__cplusplus)
+			extern "C" {
+		#endif
+
+	/* Preprocessor Checks: */
+		#if !defined(__INCLUDE_FROM_MS_DRIVER)
+			#error Do not include this file directly. Include LPCUSBlib/Drivers/USB.h instead.
+		#endif
+
+	/* Public Interface - May be used in end-application: */
+		/* Macros: */
+			#if !defined(UAS_HOST_MAX_QUEUE_DEPTH) || defined(__DOXYGEN__)
+			/** Maximum number of tagged commands kept in flight on a UAS device. This value may be overridden in
+			 *  the user project makefile as the value of the @ref UAS_HOST_MAX_QUEUE_DEPTH token, and passed to
+			 *  the compiler using the -D switch.
+			 */
+				#define UAS_HOST_MAX_QUEUE_DEPTH          4
+			#endif
+
+			/** Error code for the queueing functions, indicating that all command slots are in use. */
+			#define UAS_ERROR_QUEUE_FULL                 0x81
+
+			/** Descriptor type of the UAS Pipe Usage descriptor that follows each endpoint of a UAS interface. */
+			#define UAS_DTYPE_PipeUsage                  0x24
+
+			/** Size in bytes of a Command IU carrying a CDB of up to 16 bytes. */
+			#define UAS_COMMAND_IU_SIZE                  32
+
+			/** Size in bytes of the buffer used to receive IUs on the status pipe. */
+			#define UAS_STATUS_IU_SIZE                   64
+
+			/** Size in bytes of a Task Management IU. */
+			#define UAS_TASK_MGMT_IU_SIZE                16
+
+		/* Enums: */
+			/** Enum for the Pipe ID values of the UAS Pipe Usage descriptor. */
+			enum UAS_PipeID_t
+			{
+				UAS_PIPEID_Command                   = 1, /**< Pipe carries Command and Task Management IUs. */
+				UAS_PIPEID_Status                    = 2, /**< Pipe carries Sense, Response and Ready IUs. */
+				UAS_PIPEID_DataIN                    = 3, /**< Pipe carries device-to-host data. */
+				UAS_PIPEID_DataOUT                   = 4, /**< Pipe carries host-to-device data. */
+			};
+
+			/** Enum for the Information Unit identifiers of the UAS protocol. */
+			enum UAS_IU_ID_t
+			{
+				UAS_IU_Command                       = 0x01, /**< Command IU, host to device. */
+				UAS_IU_Sense                         = 0x03, /**< Sense IU, completion status of a command. */
+				UAS_IU_Response                      = 0x04, /**< Response IU, result of a task management function. */
+				UAS_IU_TaskManagement                = 0x05, /**< Task Management IU, host to device. */
+				UAS_IU_ReadReady                     = 0x06, /**< Device is ready to send the data of a tagged command. */
+				UAS_IU_WriteReady                    = 0x07, /**< Device is ready to receive the data of a tagged command. */
+			};
+
+			/** Enum for the task management functions sent in a Task Management IU. */
+			enum UAS_TaskManagementFunction_t
+			{
+				UAS_TMF_AbortTask                    = 0x01, /**< Drop the command with the given tag. */
+				UAS_TMF_LogicalUnitReset             = 0x08, /**< Drop all the commands of the logical unit and reset it. */
+			};
+
+			/** Enum for the processing state of a queued UAS command. */
+			enum UAS_Host_RequestState_t
+			{
+				UAS_REQ_Free                         = 0, /**< Slot is unused. */
+				UAS_REQ_CommandSent                  = 1, /**< Command IU sent, waiting for a Ready or Sense IU. */
+				UAS_REQ_DataReady                    = 2, /**< Device is ready for the data phase, waiting for the data pipe. */
+				UAS_REQ_DataPhase                    = 3, /**< Data phase in progress. */
+				UAS_REQ_WaitStatus                   = 4, /**< Data phase finished, waiting for the Sense IU. */
+				UAS_REQ_Complete                     = 5, /**< Command finished, result is in the ErrorCode field. */
+				UAS_REQ_Aborted                      = 6, /**< Command timed out and is being aborted. The slot stays out of use
+				                                           *   when the device does not confirm the abort, until the interface is
+				                                           *   configured again, as the device may still answer for its tag.
+				                                           */
+			};
+
+			enum UAS_Host_EnumerationFailure_ErrorCodes_t
+			{
+				UAS_ENUMERROR_NoError                    = 0, /**< Configuration Descriptor was processed successfully. */
+				UAS_ENUMERROR_InvalidConfigDescriptor    = 1, /**< The device returned an invalid Configuration Descriptor. */
+				UAS_ENUMERROR_NoCompatibleInterfaceFound = 2, /**< Neither a UAS nor a Bulk-Only Mass Storage interface was found. */
+				UAS_ENUMERROR_PipeConfigurationFailed    = 3, /**< One or more pipes for the specified interface could not be configured correctly. */
+			};
+
+		/* Type Defines: */
+			/** @brief UAS Pipe Usage Descriptor.
+			 *
+			 *  Class specific descriptor that follows each endpoint descriptor of a UAS interface, telling which
+			 *  of the four UAS pipes the endpoint implements.
+			 */
+			typedef ATTR_IAR_PACKED struct
+			{
+				USB_Descriptor_Header_t Header; /**< Descriptor header, including type and size. */
+				uint8_t PipeID; /**< Value from the @ref UAS_PipeID_t enum. */
+				uint8_t Reserved;
+			} ATTR_PACKED UAS_Descriptor_PipeUsage_t;
+
+			/** @brief State of one queued UAS command. */
+			typedef struct
+			{
+				uint8_t  State; /**< Value from the @ref UAS_Host_RequestState_t enum. */
+				uint8_t  ErrorCode; /**< Result of the command once complete, as returned by the blocking functions. */
+				bool     DataIN; /**< Indicates if the data phase of the command is device-to-host. */
+				void*    Buffer; /**< Data buffer of the command, NULL if it has no data phase. */
+				uint32_t Length; /**< Length in bytes of the data phase. */
+				uint8_t  CommandIU[UAS_COMMAND_IU_SIZE]; /**< Command IU, must stay valid while it is being sent. */
+			} UAS_Host_Request_t;
+
+			/** @brief UAS Class Host Mode Configuration and State Structure.
+			 *
+			 *  Class state structure. An instance of this structure should be made within the user application,
+			 *  and passed to each of the UAS class driver functions as the \c UASInterfaceInfo parameter. The
+			 *  Bulk-Only Transport instance given in the configuration is used when the attached device has no
+			 *  UAS alternate setting.
+			 */
+			typedef struct
+			{
+				struct
+				{
+					uint8_t  CommandPipeNumber; /**< Pipe number of the UAS command pipe. */
+					uint8_t  StatusPipeNumber; /**< Pipe number of the UAS status pipe. */
+					uint8_t  DataINPipeNumber; /**< Pipe number of the UAS IN data pipe. */
+					uint8_t  DataOUTPipeNumber; /**< Pipe number of the UAS OUT data pipe. */
+					uint8_t  PortNumber; /**< Port number that this interface is running. */
+
+					USB_ClassInfo_MS_Host_t* BOTInterface; /**< Bulk-Only Transport instance used as fallback. */
+				} Config; /**< Config data for the USB class interface within the device. All elements in this section
+				           *   <b>must</b> be set or the interface will fail to enumerate and operate correctly.
+				           */
+				struct
+				{
+					bool     IsActive; /**< Indicates if the current interface instance is connected to an attached device, valid
+					                    *   after @ref UAS_Host_ConfigurePipes() is called and the Host state machine is in the
+					                    *   Configured state.
+					                    */
+					bool     IsUAS; /**< Indicates if the device is driven through UAS rather than Bulk-Only Transport. */
+					uint8_t  InterfaceNumber; /**< Interface index of the UAS interface within the attached device. */
+					uint8_t  AlternateSetting; /**< Alternate setting of the UAS interface. */
+
+					uint16_t CommandPipeSize; /**< Size in bytes of the UAS command pipe. */
+					uint16_t StatusPipeSize; /**< Size in bytes of the UAS status pipe. */
+					uint16_t DataINPipeSize; /**< Size in bytes of the UAS IN data pipe. */
+					uint16_t DataOUTPipeSize; /**< Size in bytes of the UAS OUT data pipe. */
+
+					bool     StatusPending; /**< Indicates if a read is queued on the status pipe. */
+					uint8_t  DataINTag; /**< Tag of the command owning the IN data pipe, 0 when idle. */
+					uint8_t  DataOUTTag; /**< Tag of the command owning the OUT data pipe, 0 when idle. */
+					uint8_t  StatusIU[UAS_STATUS_IU_SIZE]; /**< Receive buffer of the status pipe. */
+					uint8_t  TaskMgmtIU[UAS_TASK_MGMT_IU_SIZE]; /**< Task Management IU, must stay valid while it is being sent. */
+					uint8_t  TaskMgmtResponse; /**< Response code of the last task management function, 0xFF while pending. */
+
+					UAS_Host_Request_t Requests[UAS_HOST_MAX_QUEUE_DEPTH]; /**< Command slots, slot n uses tag n + 1. */
+					SCSI_Request_Sense_Response_t SenseData; /**< Sense data of the last command that failed. */
+				} State; /**< State data for the USB class interface within the device. All elements in this section
+						  *   <b>may</b> be set to initial values, but may also be ignored to default to sane values when
+						  *   the interface is enumerated.
+						  */
+			} USB_ClassInfo_UAS_Host_t;
+
+		/* Function Prototypes: */
+			/** @brief Host interface configuration routine. Looks for a UAS alternate setting in the Configuration Descriptor
+			 *  of the attached device and configures its four pipes. When the device has none, the Bulk-Only Transport
+			 *  instance from the configuration is set up instead through @ref MS_Host_ConfigurePipes(). This should be
+			 *  called once after the stack has enumerated the attached device, while the host state machine is in the
+			 *  Addressed state.
+			 *
+			 *  @param UASInterfaceInfo     : Pointer to a structure containing a UAS Class host configuration and state.
+			 *  @param ConfigDescriptorSize : Length of the attached device's Configuration Descriptor.
+			 *  @param ConfigDescriptorData : Pointer to a buffer containing the attached device's Configuration Descriptor.
+			 *
+			 *  @return A value from the @ref UAS_Host_EnumerationFailure_ErrorCodes_t enum.
+			 */
+			uint8_t UAS_Host_ConfigurePipes(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+			                                uint16_t ConfigDescriptorSize,
+			                                void* ConfigDescriptorData) ATTR_NON_NULL_PTR_ARG(1) ATTR_NON_NULL_PTR_ARG(3);
+
+			/** @brief Selects the UAS alternate setting found by @ref UAS_Host_ConfigurePipes(). This must be called after the
+			 *  device configuration has been set, and does nothing for Bulk-Only devices.
+			 *
+			 *  @param UASInterfaceInfo : Pointer to a structure containing a UAS Class host configuration and state.
+			 *
+			 *  @return A value from the @ref USB_Host_SendControlErrorCodes_t enum.
+			 */
+			uint8_t UAS_Host_SelectAlternateSetting(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo) ATTR_NON_NULL_PTR_ARG(1);
+
+			/** @brief Queues a READ (10) command without waiting for it to complete. The buffer must stay valid until
+			 *  @ref UAS_Host_WaitForRequest() has returned for the tag. On Bulk-Only devices the command is executed
+			 *  immediately and its result kept for @ref UAS_Host_WaitForRequest().
+			 *
+			 *  @param UASInterfaceInfo : Pointer to a structure containing a UAS Class host configuration and state.
+			 *  @param LUNIndex         : LUN index within the device the command is being issued to.
+			 *  @param BlockAddress     : Starting block address within the device to read from.
+			 *  @param Blocks           : Total number of blocks to read, up to 65535 in one READ (10) command.
+			 *  @param BlockSize        : Size in bytes of each block within the device.
+			 *  @param BlockBuffer      : Pointer to where the read data from the device should be stored.
+			 *  @param Tag              : Location where the tag of the queued command is stored.
+			 *
+			 *  @return A value from the @ref Pipe_Stream_RW_ErrorCodes_t enum or @ref UAS_ERROR_QUEUE_FULL.
+			 */
+			uint8_t UAS_Host_QueueReadBlocks(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+			                                 const uint8_t LUNIndex,
+			                                 const uint32_t BlockAddress,
+			                                 const uint16_t Blocks,
+			                                 const uint16_t BlockSize,
+			                                 void* BlockBuffer,
+			                                 uint8_t* const Tag) ATTR_NON_NULL_PTR_ARG(1) ATTR_NON_NULL_PTR_ARG(6)
+			                                 ATTR_NON_NULL_PTR_ARG(7);
+
+			/** @brief Queues a WRITE (10) command without waiting for it to complete, see @ref UAS_Host_QueueReadBlocks().
+			 *
+			 *  @param UASInterfaceInfo : Pointer to a structure containing a UAS Class host configuration and state.
+			 *  @param LUNIndex         : LUN index within the device the command is being issued to.
+			 *  @param BlockAddress     : Starting block address within the device to write to.
+			 *  @param Blocks           : Total number of blocks to write, up to 65535 in one WRITE (10) command.
+			 *  @param BlockSize        : Size in bytes of each block within the device.
+			 *  @param BlockBuffer      : Pointer to where the data to write should be sourced from.
+			 *  @param Tag              : Location where the tag of the queued command is stored.
+			 *
+			 *  @return A value from the @ref Pipe_Stream_RW_ErrorCodes_t enum or @ref UAS_ERROR_QUEUE_FULL.
+			 */
+			uint8_t UAS_Host_QueueWriteBlocks(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+			                                  const uint8_t LUNIndex,
+			                                  const uint32_t BlockAddress,
+			                                  const uint16_t Blocks,
+			                                  const uint16_t BlockSize,
+			                                  const void* BlockBuffer,
+			                                  uint8_t* const Tag) ATTR_NON_NULL_PTR_ARG(1) ATTR_NON_NULL_PTR_ARG(6)
+			                                  ATTR_NON_NULL_PTR_ARG(7);
+
+			/** @brief Waits for a queued command to complete and releases its slot. A command that does not complete in
+			 *  time is aborted before this returns: its data transfer is cancelled, so the buffer may be used again, and
+			 *  the device is asked to drop the command with ABORT TASK, or a LOGICAL UNIT RESET when it does not answer
+			 *  that. Other commands of the logical unit end with @ref PIPE_RWSTREAM_IncompleteTransfer after a reset.
+			 *
+			 *  @param UASInterfaceInfo : Pointer to a structure containing a UAS Class host configuration and state.
+			 *  @param Tag              : Tag returned when the command was queued.
+			 *
+			 *  @return A value from the @ref Pipe_Stream_RW_ErrorCodes_t enum or @ref MS_ERROR_LOGICAL_CMD_FAILED.
+			 */
+			uint8_t UAS_Host_WaitForRequest(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+			                                const uint8_t Tag) ATTR_NON_NULL_PTR_ARG(1);
+
+			/** @brief Sends a TEST UNIT READY command to the device, see @ref MS_Host_TestUnitReady().
+			 *
+			 *  @param UASInterfaceInfo : Pointer to a structure containing a UAS Class host configuration and state.
+			 *  @param LUNIndex         : LUN index within the device the command is being issued to.
+			 *
+			 *  @return A value from the @ref Pipe_Stream_RW_ErrorCodes_t enum or @ref MS_ERROR_LOGICAL_CMD_FAILED if not ready.
+			 */
+			uint8_t UAS_Host_TestUnitReady(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+			                               const uint8_t LUNIndex) ATTR_NON_NULL_PTR_ARG(1);
+
+			/** @brief Retrieves the device's inquiry data, see @ref MS_Host_GetInquiryData().
+			 *
+			 *  @param UASInterfaceInfo : Pointer to a structure containing a UAS Class host configuration and state.
+			 *  @param LUNIndex         : LUN index within the device the command is being issued to.
+			 *  @param InquiryData      : Location where the read inquiry data should be stored.
+			 *
+			 *  @return A value from the @ref Pipe_Stream_RW_ErrorCodes_t enum or @ref MS_ERROR_LOGICAL_CMD_FAILED.
+			 */
+			uint8_t UAS_Host_GetInquiryData(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+			                                const uint8_t LUNIndex,
+			                                SCSI_Inquiry_Response_t* const InquiryData) ATTR_NON_NULL_PTR_ARG(1)
+			                                ATTR_NON_NULL_PTR_ARG(3);
+
+			/** @brief Retrieves the total capacity of the device, see @ref MS_Host_ReadDeviceCapacity().
+			 *
+			 *  @param UASInterfaceInfo : Pointer to a structure containing a UAS Class host configuration and state.
+			 *  @param LUNIndex         : LUN index within the device the command is being issued to.
+			 *  @param DeviceCapacity   : Pointer to the location where the capacity information should be stored.
+			 *
+			 *  @return A value from the @ref Pipe_Stream_RW_ErrorCodes_t enum or @ref MS_ERROR_LOGICAL_CMD_FAILED if not ready.
+			 */
+			uint8_t UAS_Host_ReadDeviceCapacity(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+			                                    const uint8_t LUNIndex,
+			                                    SCSI_Capacity_t* const DeviceCapacity) ATTR_NON_NULL_PTR_ARG(1)
+			                                    ATTR_NON_NULL_PTR_ARG(3);
+
+			/** @brief Retrieves the device sense data. On UAS devices this returns the sense data delivered with the last
+			 *  failed command, which is where UAS reports it, without sending another command.
+			 *
+			 *  @param UASInterfaceInfo : Pointer to a structure containing a UAS Class host configuration and state.
+			 *  @param LUNIndex         : LUN index within the device the command is being issued to.
+			 *  @param SenseData        : Pointer to the location where the sense information should be stored.
+			 *
+			 *  @return A value from the @ref Pipe_Stream_RW_ErrorCodes_t enum or @ref MS_ERROR_LOGICAL_CMD_FAILED if not ready.
+			 */
+			uint8_t UAS_Host_RequestSense(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+			                              const uint8_t LUNIndex,
+			                              SCSI_Request_Sense_Response_t* const SenseData) ATTR_NON_NULL_PTR_ARG(1)
+			                              ATTR_NON_NULL_PTR_ARG(3);
+
+			/** @brief Reads blocks of data from the device's medium and waits for completion.
+			 *
+			 *  @param UASInterfaceInfo : Pointer to a structure containing a UAS Class host configuration and state.
+			 *  @param LUNIndex         : LUN index within the device the command is being issued to.
+			 *  @param BlockAddress     : Starting block address within the device to read from.
+			 *  @param Blocks           : Total number of blocks to read, up to 65535 in one READ (10) command.
+			 *  @param BlockSize        : Size in bytes of each block within the device.
+			 *  @param BlockBuffer      : Pointer to where the read data from the device should be stored.
+			 *
+			 *  @return A value from the @ref Pipe_Stream_RW_ErrorCodes_t enum or @ref MS_ERROR_LOGICAL_CMD_FAILED if not ready.
+			 */
+			uint8_t UAS_Host_ReadDeviceBlocks(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+			                                  const uint8_t LUNIndex,
+			                                  const uint32_t BlockAddress,
+			                                  const uint16_t Blocks,
+			                                  const uint16_t BlockSize,
+			                                  void* BlockBuffer) ATTR_NON_NULL_PTR_ARG(1) ATTR_NON_NULL_PTR_ARG(6);
+
+			/** @brief Writes blocks of data to the device's medium and waits for completion.
+			 *
+			 *  @param UASInterfaceInfo : Pointer to a structure containing a UAS Class host configuration and state.
+			 *  @param LUNIndex         : LUN index within the device the command is being issued to.
+			 *  @param BlockAddress     : Starting block address within the device to write to.
+			 *  @param Blocks           : Total number of blocks to write, up to 65535 in one WRITE (10) command.
+			 *  @param BlockSize        : Size in bytes of each block within the device.
+			 *  @param BlockBuffer      : Pointer to where the data to write should be sourced from.
+			 *
+			 *  @return A value from the @ref Pipe_Stream_RW_ErrorCodes_t enum or @ref MS_ERROR_LOGICAL_CMD_FAILED if not ready.
+			 */
+			uint8_t UAS_Host_WriteDeviceBlocks(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+			                                   const uint8_t LUNIndex,
+			                                   const uint32_t BlockAddress,
+			                                   const uint16_t Blocks,
+			                                   const uint16_t BlockSize,
+			                                   const void* BlockBuffer) ATTR_NON_NULL_PTR_ARG(1) ATTR_NON_NULL_PTR_ARG(6);
+
+			/** @brief General management task for a given UAS host class interface. It collects Ready and Sense IUs from the
+			 *  status pipe and starts the data phases of queued commands. This should be called frequently in the main program
+			 *  loop, before the master USB management task @ref USB_USBTask().
+			 *
+			 *  @param UASInterfaceInfo : Pointer to a structure containing a UAS Class host configuration and state.
+			 *	@return	Nothing
+			 */
+			void UAS_Host_USBTask(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo) ATTR_NON_NULL_PTR_ARG(1);
+
+		/* Inline Functions: */
+			/** @brief Indicates if the attached device is driven through UAS.
+			 *
+			 *  @param UASInterfaceInfo : Pointer to a structure containing a UAS Class host configuration and state.
+			 *  @return Boolean \c true if the device uses UAS, \c false if it uses Bulk-Only Transport.
+			 */
+			static inline bool UAS_Host_IsUAS(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo) ATTR_NON_NULL_PTR_ARG(1) ATTR_ALWAYS_INLINE;
+			static inline bool UAS_Host_IsUAS(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo)
+			{
+				return UASInterfaceInfo->State.IsUAS;
+			}
+
+	/* Private Interface - For use in library only: */
+	#if !defined(__DOXYGEN__)
+		/* Macros: */
+			#define UAS_COMMAND_DATA_TIMEOUT_MS       MS_COMMAND_DATA_TIMEOUT_MS
+			#define UAS_TASK_MGMT_TIMEOUT_MS          1000
+			#define UAS_TASK_MGMT_TAG                 (UAS_HOST_MAX_QUEUE_DEPTH + 1)
+			#define UAS_TASK_MGMT_PENDING             0xFF
+
+		/* Function Prototypes: */
+			#if defined(__INCLUDE_FROM_UAS_HOST_C)
+				static uint8_t UAS_Host_QueueCommand(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+				                                     const uint8_t LUNIndex,
+				                                     const uint8_t* const CDB,
+				                                     const uint8_t CDBLength,
+				                                     const bool DataIN,
+				                                     void* Buffer,
+				                                     const uint32_t Length,
+				                                     uint8_t* const Tag) ATTR_NON_NULL_PTR_ARG(1) ATTR_NON_NULL_PTR_ARG(3)
+				                                     ATTR_NON_NULL_PTR_ARG(8);
+				static uint8_t UAS_Host_SendCommand(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+				                                    const uint8_t LUNIndex,
+				                                    const uint8_t* const CDB,
+				                                    const uint8_t CDBLength,
+				                                    const bool DataIN,
+				                                    void* Buffer,
+				                                    const uint32_t Length) ATTR_NON_NULL_PTR_ARG(1) ATTR_NON_NULL_PTR_ARG(3);
+				static uint8_t UAS_Host_StartTransfer(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+				                                      const uint8_t PipeNumber,
+				                                      void* Buffer,
+				                                      const uint32_t Length) ATTR_NON_NULL_PTR_ARG(1);
+				static HCD_STATUS UAS_Host_GetTransferStatus(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+				                                             const uint8_t PipeNumber) ATTR_NON_NULL_PTR_ARG(1);
+				static void UAS_Host_ProcessStatusIU(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo) ATTR_NON_NULL_PTR_ARG(1);
+				static void UAS_Host_CompleteRequest(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+				                                     UAS_Host_Request_t* const Request,
+				                                     const uint8_t ErrorCode) ATTR_NON_NULL_PTR_ARG(1) ATTR_NON_NULL_PTR_ARG(2);
+				static uint8_t UAS_Host_QueueResult(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+				                                    const uint8_t ErrorCode,
+				                                    uint8_t* const Tag) ATTR_NON_NULL_PTR_ARG(1) ATTR_NON_NULL_PTR_ARG(3);
+				static void UAS_Host_RecoverPipe(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+				                                 const uint8_t PipeNumber) ATTR_NON_NULL_PTR_ARG(1);
+				static UAS_Host_Request_t* UAS_Host_GetRequest(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+				                                               const uint8_t Tag) ATTR_NON_NULL_PTR_ARG(1);
+				static void UAS_Host_ReleaseDataPipe(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+				                                     const uint8_t Tag) ATTR_NON_NULL_PTR_ARG(1);
+				static uint8_t UAS_Host_TaskManagement(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+				                                       const uint8_t Function,
+				                                       const uint8_t LUNIndex,
+				                                       const uint8_t TaskTag) ATTR_NON_NULL_PTR_ARG(1);
+				static void UAS_Host_AbortRequest(USB_ClassInfo_UAS_Host_t* const UASInterfaceInfo,
+				                                  const uint8_t Tag) ATTR_NON_NULL_PTR_ARG(1);
+			#endif
+	#endif
+
+	/* Disable C linkage for C++ Compilers: */
+		#if defined(__cplusplus)
+			}
+		#endif
+
+#endif
+
+/** @} */
@@ -65,6 +65,11 @@
 
 		#if defined(USB_CAN_BE_HOST)
 			#include "Host/MassStorageClassHost.h"
+
+			/* The BOT host driver is built without the UAS layer stacked on top of it */
+			#if !defined(__INCLUDE_FROM_MASSSTORAGE_HOST_C)
+				#include "Host/UASClassHost.h"
+			#endif
 		#endif
 
 #endif
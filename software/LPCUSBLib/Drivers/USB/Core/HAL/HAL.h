@@ -52,6 +52,9 @@
 #elif defined(__LPC11U1X__) || defined(__LPC11U2X_3X__) || defined(__LPC1347__)
 	#include "LPC11UXX/HAL_LPC11Uxx.h"
 #endif
+#if defined(__USB_SIM__)
+	#include "SIM/HAL_Sim.h"
+#endif
 /* Function Prototypes: */
 /**
  * @brief  	This function is called by void USB_Init(void) to do the initialization for chip's USB core.
@@ -29,7 +29,7 @@
  * this code.
  */
 
-#if defined(__LPC18XX__) || defined(__LPC43XX__)
+#if (defined(__LPC18XX__) || defined(__LPC43XX__)) && !defined(__USB_SIM__)
 
 #include "../HAL.h"
 #include "../../USBTask.h"
@@ -0,0 +1,632 @@
+/*
+ * @brief HAL USB functions and EHCI controller model for running the host stack off-target
+ *
+ * @note
+ * Copyright(C) NXP Semiconductors, 2012
+ * All rights reserved.
+ *
+ * @par
+ * Software that is described herein is for illustrative purposes only
+ * which provides customers with programming information regarding the
+ * LPC products.  This software is supplied "AS IS" without any warranties of
+ * any kind, and NXP Semiconductors and its licensor disclaim any and
+ * all warranties, express or implied, including all implied warranties of
+ * merchantability, fitness for a particular purpose and non-infringement of
+ * intellectual property rights.  NXP Semiconductors assumes no responsibility
+ * or liability for the use of the software, conveys no license or rights under any
+ * patent, copyright, mask work right, or any other intellectual property rights in
+ * or to any products. NXP Semiconductors reserves the right to make changes
+ * in the software without notification. NXP Semiconductors also makes no
+ * representation or warranty that such application will be suitable for the
+ * specified use without further testing or modification.
+ *
+ * @par
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation is hereby granted, under NXP Semiconductors' and its
+ * licensor's relevant copyrights in the software, without fee, provided that it
+ * is used in conjunction with NXP Semiconductors microcontrollers.  This
+ * copyright, permission, and disclaimer notice must appear in all copies of
+ * this code.
+ */
+
+#if defined(__USB_SIM__)
+
+#include <pthread.h>
+#include <signal.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../HAL.h"
+#include "../../USBTask.h"
+
+#define SIM_PTR(Addr)               ((volatile uint32_t *) Sim_BusPtr(Addr))
+#define SIM_MAX_LINKS               256			/* guard against broken lists */
+#define SIM_HS_UFRAME_BYTES         7500		/* bus time of a high speed microframe */
+#define SIM_FS_UFRAME_BYTES         188			/* a full speed frame spread over 8 microframes */
+#define SIM_PACKET_OVERHEAD         32			/* token, handshake and inter-packet gap */
+#define SIM_PORT_RESET_UFRAMES      80			/* 10 ms of bus reset */
+#define SIM_USB_TIMEOUT             (-3)		/* transaction error, no device answered */
+
+/* EHCI register bits (EHCI.h is private to the driver) */
+#define SIM_USBCMD_RunStop          0x00000001UL
+#define SIM_USBCMD_HostReset        0x00000002UL
+#define SIM_USBCMD_PeriodEnable     0x00000010UL
+#define SIM_USBCMD_AsyncEnable      0x00000020UL
+#define SIM_USBCMD_AsyncDoorbell    0x00000040UL
+#define SIM_USBSTS_UsbErrorInt      0x00000002UL
+#define SIM_USBSTS_PortChange       0x00000004UL
+#define SIM_USBSTS_FrameRollover    0x00000008UL
+#define SIM_USBSTS_AsyncAdvance     0x00000020UL
+#define SIM_USBSTS_HCHalted         0x00001000UL
+#define SIM_USBSTS_PeriodStatus     0x00004000UL
+#define SIM_USBSTS_AsyncStatus      0x00008000UL
+#define SIM_USBSTS_UsbAsyncInt      0x00040000UL
+#define SIM_USBSTS_UsbPeriodInt     0x00080000UL
+#define SIM_USBINTR_ALL             0x000C00BFUL
+#define SIM_PORTSC_Connect          0x00000001UL
+#define SIM_PORTSC_ConnectChange    0x00000002UL
+#define SIM_PORTSC_Enable           0x00000004UL
+#define SIM_PORTSC_EnableChange     0x00000008UL
+#define SIM_PORTSC_OvercurrentChange 0x00000020UL
+#define SIM_PORTSC_Reset            0x00000100UL
+#define SIM_PORTSC_Speed            0x0C000000UL
+
+/* Descriptor words, see EHCI specification 3.5 and 3.6 */
+#define SIM_LINK_TERMINATE          0x00000001UL
+#define SIM_LINK_TYPE(Link)         (((Link) >> 1) & 0x03)
+#define SIM_LINK_ADDR(Link)         ((Link) & ~0x1FUL)
+#define SIM_QTD_ACTIVE              0x00000080UL
+#define SIM_QTD_HALTED              0x00000040UL
+#define SIM_QTD_XACT_ERR            0x00000008UL
+#define SIM_QTD_PID(Token)          (((Token) >> 8) & 0x03)
+#define SIM_QTD_CPAGE(Token)        (((Token) >> 12) & 0x07)
+#define SIM_QTD_IOC                 0x00008000UL
+#define SIM_QTD_BYTES(Token)        (((Token) >> 16) & 0x7FFF)
+#define SIM_QTD_TOGGLE              0x80000000UL
+#define SIM_QH_DTC                  0x00004000UL
+#define SIM_ITD_ACTIVE              0x80000000UL
+#define SIM_ITD_IOC                 0x00008000UL
+#define SIM_SITD_ACTIVE             0x00000080UL
+#define SIM_SITD_IOC                0x80000000UL
+
+typedef struct {
+	pthread_t Thread;
+	volatile bool Running;
+	volatile bool IrqEnabled;
+	volatile bool InIrq;
+	SIM_USB_DEVICE_T *volatile pDevice;
+	uint32_t ResetCountdown;
+	SIM_EHCI_STATS_T Stats;
+	struct timespec StatsStart;
+} SIM_EHCI_T;
+
+static IP_USBHS_001_T SimUsbRegs[LPC18_43_MAX_USB_CORE];
+static SIM_EHCI_T SimEhci[LPC18_43_MAX_USB_CORE];
+static pthread_t SimCpuThread;
+static uintptr_t SimBusRegion[SIM_BUS_REGIONS];		/* base of each region with bit 0 set, 0 while unused */
+
+IP_USBHS_001_T * const USB_REG_BASE_ADDR[LPC18_43_MAX_USB_CORE] = {&SimUsbRegs[0], &SimUsbRegs[1]};
+
+/* Registers are shared with the driver thread, the model only sets or clears its own bits atomically */
+static inline void SimRegSet(volatile uint32_t *pReg, uint32_t bits)
+{
+	__sync_fetch_and_or((uint32_t *) pReg, bits);
+}
+
+static inline void SimRegClear(volatile uint32_t *pReg, uint32_t bits)
+{
+	__sync_fetch_and_and((uint32_t *) pReg, ~bits);
+}
+
+static uint32_t SimElapsedMs(const struct timespec *pStart)
+{
+	struct timespec Now;
+
+	clock_gettime(CLOCK_MONOTONIC, &Now);
+	return (uint32_t) ((Now.tv_sec - pStart->tv_sec) * 1000 + (Now.tv_nsec - pStart->tv_nsec) / 1000000);
+}
+
+/*---------- Bus addresses ----------*/
+/* Descriptors hold 32-bit addresses while host pointers may be 64-bit. The top bits of a bus address select a
+   region, the low bits are those of the pointer, so page offsets and alignment are the same in both. Region 0
+   is not used: the driver takes a list end (address 0 once aligned) for a NULL pointer */
+uint32_t Sim_BusAddr(const void *Ptr)
+{
+	uintptr_t Base = (uintptr_t) Ptr & ~(((uintptr_t) 1 << SIM_BUS_REGION_BITS) - 1);
+	uint32_t Region;
+
+	if (Ptr == NULL) {
+		return 0;
+	}
+	for (Region = 1; Region < SIM_BUS_REGIONS; Region++) {
+		if (SimBusRegion[Region] == 0) {	/*-- the driver and its interrupt handler may race for a free slot --*/
+			__sync_bool_compare_and_swap(&SimBusRegion[Region], 0, Base | 1);
+		}
+		if (SimBusRegion[Region] == (Base | 1)) {
+			return (Region << SIM_BUS_REGION_BITS) | (uint32_t) ((uintptr_t) Ptr - Base);
+		}
+	}
+	fprintf(stderr, "HAL_Sim: more than %d memory regions handed to the controller\n", SIM_BUS_REGIONS - 1);
+	abort();
+}
+
+void *Sim_BusPtr(uint32_t Addr)
+{
+	uintptr_t Base = SimBusRegion[Addr >> SIM_BUS_REGION_BITS] & ~(uintptr_t) 1;
+
+	if (Base == 0) {
+		return NULL;
+	}
+	return (void *) (Base + (Addr & ((1UL << SIM_BUS_REGION_BITS) - 1)));
+}
+
+/*---------- Interrupt delivery ----------*/
+/* Runs on the driver thread, which is preempted like by the NVIC. The driver acknowledges status bits with
+   read-modify-write, which cannot clear a RAM register, so the bits it was interrupted for are cleared here */
+static void SimIrqSignal(int sig)
+{
+	uint8_t corenum;
+
+	for (corenum = 0; corenum < LPC18_43_MAX_USB_CORE; corenum++) {
+		if (SimEhci[corenum].InIrq) {
+			uint32_t Latched = USB_REG(corenum)->USBSTS_H & USB_REG(corenum)->USBINTR_H;
+
+			if (USB_CurrentMode[corenum] == USB_MODE_Host) {
+				HcdIrqHandler(corenum);
+			}
+			SimRegClear(&USB_REG(corenum)->USBSTS_H, Latched);
+			if (Latched & SIM_USBSTS_PortChange) {
+				SimRegClear(&USB_REG(corenum)->PORTSC1_H,
+							SIM_PORTSC_ConnectChange | SIM_PORTSC_EnableChange | SIM_PORTSC_OvercurrentChange);
+			}
+			SimEhci[corenum].InIrq = false;
+		}
+	}
+}
+
+static void SimRaiseInterrupt(uint8_t corenum)
+{
+	SIM_EHCI_T *pHc = &SimEhci[corenum];
+
+	if (!pHc->IrqEnabled ||
+		!(USB_REG(corenum)->USBSTS_H & USB_REG(corenum)->USBINTR_H & SIM_USBINTR_ALL)) {
+		return;
+	}
+
+	pHc->Stats.Interrupts++;
+	pHc->InIrq = true;
+	pthread_kill(SimCpuThread, SIGUSR1);
+	while (pHc->InIrq && pHc->Running) {
+		sched_yield();
+	}
+}
+
+/*---------- Data buffer of the qTD overlay ----------*/
+static void SimBufferCopy(volatile uint32_t *pOverlay, uint8_t *data, uint32_t length, bool ToMemory)
+{
+	uint32_t Page = SIM_QTD_CPAGE(pOverlay[2]);
+	uint32_t Offset = pOverlay[3] & 0xFFF;
+
+	while (length && Page < 5) {
+		uint8_t *pMem = (uint8_t *) Sim_BusPtr((pOverlay[3 + Page] & ~0xFFFUL) + Offset);
+		uint32_t Chunk = MIN(length, 0x1000 - Offset);
+
+		if (ToMemory) {
+			memcpy(pMem, data, Chunk);
+		}
+		else {
+			memcpy(data, pMem, Chunk);
+		}
+		data += Chunk;
+		length -= Chunk;
+		Offset = 0;
+		Page++;
+	}
+}
+
+static void SimBufferAdvance(volatile uint32_t *pOverlay, uint32_t length)
+{
+	uint32_t Position = (pOverlay[3] & 0xFFF) + length;
+	uint32_t Page = SIM_QTD_CPAGE(pOverlay[2]) + (Position >> 12);
+
+	pOverlay[3] = (pOverlay[3] & ~0xFFFUL) | (Position & 0xFFF);
+	pOverlay[2] = (pOverlay[2] & ~(0x07UL << 12)) | ((Page & 0x07) << 12);
+}
+
+/*---------- Queue head execution ----------*/
+static void SimRetireQtd(uint8_t corenum, volatile uint32_t *pQhd, bool Periodic)
+{
+	volatile uint32_t *pOverlay = &pQhd[4];
+
+	SIM_PTR(pQhd[3])[2] = pOverlay[2];		/* write the transfer state back to the qTD */
+	SimEhci[corenum].Stats.QtdProcessed++;
+
+	if (pOverlay[2] & SIM_QTD_HALTED) {
+		SimRegSet(&USB_REG(corenum)->USBSTS_H, SIM_USBSTS_UsbErrorInt);
+	}
+	else if (pOverlay[2] & SIM_QTD_IOC) {
+		SimRegSet(&USB_REG(corenum)->USBSTS_H, Periodic ? SIM_USBSTS_UsbPeriodInt : SIM_USBSTS_UsbAsyncInt);
+	}
+}
+
+/* Run the qTDs of a queue head until it NAKs, runs out of work or the microframe is spent. MaxPackets limits
+   an interrupt endpoint to its transactions per microframe, 0 for asynchronous queue heads */
+static void SimRunQhd(uint8_t corenum, volatile uint32_t *pQhd, int32_t *pBudget, uint32_t MaxPackets, bool Periodic)
+{
+	SIM_EHCI_T *pHc = &SimEhci[corenum];
+	volatile uint32_t *pOverlay = &pQhd[4];
+	uint32_t Address = pQhd[1] & 0x7F;
+	uint32_t EndpointNumber = (pQhd[1] >> 8) & 0x0F;
+	uint32_t MaxPacket = (pQhd[1] >> 16) & 0x7FF;
+	uint32_t Packets = 0;
+	uint8_t Packet[1024];
+
+	for (;;) {
+		SIM_USB_DEVICE_T *pDev = pHc->pDevice;
+		uint32_t Token, Pid, Remain, Length;
+		int32_t Result;
+
+		if (!(pOverlay[2] & SIM_QTD_ACTIVE)) {	/*-- fetch the next qTD into the overlay --*/
+			uint32_t Next = pOverlay[0];
+			volatile uint32_t *pQtd;
+			uint32_t Toggle = pOverlay[2] & SIM_QTD_TOGGLE;
+			uint8_t i;
+
+			if ((pOverlay[2] & SIM_QTD_HALTED) || (Next & SIM_LINK_TERMINATE)) {
+				return;
+			}
+			pQtd = SIM_PTR(SIM_LINK_ADDR(Next));
+			if (!(pQtd[2] & SIM_QTD_ACTIVE)) {
+				return;
+			}
+			pQhd[3] = SIM_LINK_ADDR(Next);
+			for (i = 0; i < 8; i++) {
+				pOverlay[i] = pQtd[i];
+			}
+			if (!(pQhd[1] & SIM_QH_DTC)) {	/*-- toggle is kept in the queue head --*/
+				pOverlay[2] = (pOverlay[2] & ~SIM_QTD_TOGGLE) | Toggle;
+			}
+		}
+
+		Token = pOverlay[2];
+		Pid = SIM_QTD_PID(Token);
+		Remain = SIM_QTD_BYTES(Token);
+		Length = (Pid == 2) ? 8 : MIN(Remain, MaxPacket);
+
+		if ((*pBudget < (int32_t) (Length + SIM_PACKET_OVERHEAD)) || (MaxPackets && (Packets == MaxPackets))) {
+			return;
+		}
+		*pBudget -= Length + SIM_PACKET_OVERHEAD;
+		Packets++;
+
+		if ((pDev == NULL) || (pDev->Address != Address) || !(USB_REG(corenum)->PORTSC1_H & SIM_PORTSC_Enable)) {
+			Result = SIM_USB_TIMEOUT;	/*-- nobody answers --*/
+		}
+		else if (Pid == 2) {	/*-- SETUP --*/
+			SimBufferCopy(pOverlay, Packet, 8, false);
+			pDev->Setup(pDev, Packet);
+			Result = 8;
+		}
+		else if (Pid == 0) {	/*-- OUT --*/
+			SimBufferCopy(pOverlay, Packet, Length, false);
+			Result = pDev->Out(pDev, EndpointNumber, Packet, Length);
+			if (Result >= 0) {
+				Result = Length;
+				pHc->Stats.BytesOut += Length;
+			}
+		}
+		else {	/*-- IN --*/
+			Result = pDev->In(pDev, EndpointNumber, Packet, Length);
+			if (Result > 0) {
+				Result = MIN((uint32_t) Result, Length);
+				SimBufferCopy(pOverlay, Packet, Result, true);
+				pHc->Stats.BytesIn += Result;
+			}
+		}
+
+		if (Result == SIM_USB_NAK) {
+			pHc->Stats.Naks++;
+			return;
+		}
+		if (Result < 0) {
+			pOverlay[2] = (Token & ~SIM_QTD_ACTIVE) | SIM_QTD_HALTED | ((Result == SIM_USB_STALL) ? 0 : SIM_QTD_XACT_ERR);
+			SimRetireQtd(corenum, pQhd, Periodic);
+			return;
+		}
+
+		SimBufferAdvance(pOverlay, Result);
+		Remain -= MIN((uint32_t) Result, Remain);
+		pOverlay[2] = ((pOverlay[2] & ~(0x7FFFUL << 16)) | (Remain << 16)) ^ SIM_QTD_TOGGLE;
+
+		if ((Remain == 0) || ((uint32_t) Result < Length)) {	/*-- done, or a short packet ended it --*/
+			pOverlay[2] &= ~SIM_QTD_ACTIVE;
+			if (((uint32_t) Result < Length) && !(pOverlay[1] & SIM_LINK_TERMINATE)) {
+				pOverlay[0] = pOverlay[1];
+			}
+			SimRetireQtd(corenum, pQhd, Periodic);
+		}
+	}
+}
+
+/*---------- Schedules ----------*/
+static void SimRunAsync(uint8_t corenum, int32_t *pBudget)
+{
+	uint32_t Head = SIM_LINK_ADDR(USB_REG(corenum)->ASYNCLISTADDR);
+	uint32_t Link = Head;
+	uint32_t n;
+
+	for (n = 0; n < SIM_MAX_LINKS && *pBudget > 0; n++) {
+		volatile uint32_t *pQhd = SIM_PTR(Link);
+
+		SimRunQhd(corenum, pQhd, pBudget, 0, false);
+		if (pQhd[0] & SIM_LINK_TERMINATE) {
+			break;
+		}
+		Link = SIM_LINK_ADDR(pQhd[0]);
+		if (Link == Head) {	/*-- one pass per microframe --*/
+			break;
+		}
+	}
+}
+
+static void SimRunPeriodic(uint8_t corenum, int32_t *pBudget)
+{
+	IP_USBHS_001_T *pRegs = USB_REG(corenum);
+	uint32_t SizeBits = ((pRegs->USBCMD_H >> 2) & 0x03) | (((pRegs->USBCMD_H >> 15) & 0x01) << 2);
+	uint32_t Frame = (pRegs->FRINDEX_H >> 3) & ((1024 >> SizeBits) - 1);
+	uint32_t uFrame = pRegs->FRINDEX_H & 0x07;
+	uint32_t Link = SIM_PTR(SIM_LINK_ADDR(pRegs->PERIODICLISTBASE) & ~0xFFFUL)[Frame];
+	uint32_t n;
+
+	for (n = 0; n < SIM_MAX_LINKS && !(Link & SIM_LINK_TERMINATE); n++) {
+		volatile uint32_t *p = SIM_PTR(SIM_LINK_ADDR(Link));
+
+		switch (SIM_LINK_TYPE(Link)) {
+		case 0:	/*-- iTD: no isochronous device is modelled, IN transactions complete empty --*/
+			if (p[1 + uFrame] & SIM_ITD_ACTIVE) {
+				if (p[10] & (1UL << 11)) {	/*-- direction bit of buffer page 1 --*/
+					p[1 + uFrame] &= ~(0xFFFUL << 16);
+				}
+				p[1 + uFrame] &= ~SIM_ITD_ACTIVE;
+				SimEhci[corenum].Stats.IsoProcessed++;
+				if (p[1 + uFrame] & SIM_ITD_IOC) {
+					SimRegSet(&pRegs->USBSTS_H, SIM_USBSTS_UsbPeriodInt);
+				}
+			}
+			break;
+
+		case 1:	/*-- interrupt queue head, polled in the microframes of its S-mask --*/
+			if (p[2] & (1UL << uFrame)) {
+				SimRunQhd(corenum, p, pBudget, MAX((p[2] >> 30) & 0x03, 1), true);
+			}
+			break;
+
+		case 2:	/*-- siTD: completes in the first microframe of the frame, IN data stays empty --*/
+			if ((uFrame == 0) && (p[3] & SIM_SITD_ACTIVE)) {
+				p[3] &= ~SIM_SITD_ACTIVE;
+				SimEhci[corenum].Stats.IsoProcessed++;
+				if (p[3] & SIM_SITD_IOC) {
+					SimRegSet(&pRegs->USBSTS_H, SIM_USBSTS_UsbPeriodInt);
+				}
+			}
+			break;
+
+		default:
+			break;
+		}
+		Link = p[0];
+	}
+}
+
+/*---------- Controller ----------*/
+static void SimHandleCommand(uint8_t corenum)
+{
+	IP_USBHS_001_T *pRegs = USB_REG(corenum);
+
+	if (pRegs->USBCMD_H & SIM_USBCMD_HostReset) {
+		pRegs->USBINTR_H = 0;
+		pRegs->FRINDEX_H = 0;
+		pRegs->USBSTS_H = SIM_USBSTS_HCHalted;
+		pRegs->USBCMD_H = 0;
+		return;
+	}
+
+	if (pRegs->USBCMD_H & SIM_USBCMD_RunStop) {
+		SimRegClear(&pRegs->USBSTS_H, SIM_USBSTS_HCHalted);
+	}
+	else {
+		SimRegSet(&pRegs->USBSTS_H, SIM_USBSTS_HCHalted);
+	}
+
+	/*-- Schedule status follows the enable bits, the driver waits on it before touching a list --*/
+	if (pRegs->USBCMD_H & SIM_USBCMD_AsyncEnable) {
+		SimRegSet(&pRegs->USBSTS_H, SIM_USBSTS_AsyncStatus);
+	}
+	else {
+		SimRegClear(&pRegs->USBSTS_H, SIM_USBSTS_AsyncStatus);
+	}
+	if (pRegs->USBCMD_H & SIM_USBCMD_PeriodEnable) {
+		SimRegSet(&pRegs->USBSTS_H, SIM_USBSTS_PeriodStatus);
+	}
+	else {
+		SimRegClear(&pRegs->USBSTS_H, SIM_USBSTS_PeriodStatus);
+	}
+
+	/*-- The model holds no cached queue heads, so the async list has advanced as soon as it is asked --*/
+	if (pRegs->USBCMD_H & SIM_USBCMD_AsyncDoorbell) {
+		SimRegClear(&pRegs->USBCMD_H, SIM_USBCMD_AsyncDoorbell);
+		SimRegSet(&pRegs->USBSTS_H, SIM_USBSTS_AsyncAdvance);
+	}
+}
+
+static void SimHandlePort(uint8_t corenum)
+{
+	IP_USBHS_001_T *pRegs = USB_REG(corenum);
+	SIM_EHCI_T *pHc = &SimEhci[corenum];
+	SIM_USB_DEVICE_T *pDev = pHc->pDevice;
+	bool Connected = (pRegs->PORTSC1_H & SIM_PORTSC_Connect) != 0;
+
+	if ((pDev != NULL) != Connected) {
+		if (pDev) {
+			SimRegClear(&pRegs->PORTSC1_H, SIM_PORTSC_Speed);
+			SimRegSet(&pRegs->PORTSC1_H, SIM_PORTSC_Connect | SIM_PORTSC_ConnectChange | ((uint32_t) pDev->Speed << 26));
+		}
+		else {
+			SimRegClear(&pRegs->PORTSC1_H, SIM_PORTSC_Connect | SIM_PORTSC_Enable);
+			SimRegSet(&pRegs->PORTSC1_H, SIM_PORTSC_ConnectChange | SIM_PORTSC_EnableChange);
+		}
+		SimRegSet(&pRegs->USBSTS_H, SIM_USBSTS_PortChange);
+	}
+
+	if (pRegs->PORTSC1_H & SIM_PORTSC_Reset) {
+		if (pHc->ResetCountdown == 0) {
+			pHc->ResetCountdown = SIM_PORT_RESET_UFRAMES;
+		}
+		else if (--pHc->ResetCountdown == 0) {
+			if (pDev) {
+				pDev->Address = 0;
+				pDev->Reset(pDev);
+				SimRegSet(&pRegs->PORTSC1_H, SIM_PORTSC_Enable);
+			}
+			SimRegClear(&pRegs->PORTSC1_H, SIM_PORTSC_Reset);
+		}
+	}
+}
+
+static void SimRunMicroframe(uint8_t corenum)
+{
+	IP_USBHS_001_T *pRegs = USB_REG(corenum);
+	SIM_USB_DEVICE_T *pDev = SimEhci[corenum].pDevice;
+	int32_t Budget = (pDev && (pDev->Speed != HIGH_SPEED)) ? SIM_FS_UFRAME_BYTES : SIM_HS_UFRAME_BYTES;
+	uint32_t SizeBits = ((pRegs->USBCMD_H >> 2) & 0x03) | (((pRegs->USBCMD_H >> 15) & 0x01) << 2);
+	uint32_t FrIndex = (pRegs->FRINDEX_H + 1) & 0x3FFF;
+
+	pRegs->FRINDEX_H = FrIndex;
+	if ((FrIndex & ((8192 >> SizeBits) - 1)) == 0) {
+		SimRegSet(&pRegs->USBSTS_H, SIM_USBSTS_FrameRollover);
+	}
+	SimEhci[corenum].Stats.Microframes++;
+
+	/*-- Periodic transfers go first in every microframe, the asynchronous list gets the rest --*/
+	if (pRegs->USBSTS_H & SIM_USBSTS_PeriodStatus) {
+		SimRunPeriodic(corenum, &Budget);
+	}
+	if (pRegs->USBSTS_H & SIM_USBSTS_AsyncStatus) {
+		SimRunAsync(corenum, &Budget);
+	}
+}
+
+static void *SimControllerThread(void *arg)
+{
+	uint8_t corenum = (uint8_t) (uintptr_t) arg;
+	SIM_EHCI_T *pHc = &SimEhci[corenum];
+
+	while (pHc->Running) {
+		SimHandleCommand(corenum);
+		SimHandlePort(corenum);
+		if (!(USB_REG(corenum)->USBSTS_H & SIM_USBSTS_HCHalted)) {
+			SimRunMicroframe(corenum);
+		}
+		SimRaiseInterrupt(corenum);
+		sched_yield();
+	}
+	return NULL;
+}
+
+/*---------- HAL ----------*/
+#if defined(USB_CAN_BE_DEVICE)
+void HAL_USBConnect(uint8_t corenum, uint32_t con)
+{}
+
+#endif
+
+void HAL_USBInit(uint8_t corenum)
+{
+	SIM_EHCI_T *pHc = &SimEhci[corenum];
+
+	if (!pHc->Running) {
+		struct sigaction Action;
+
+		memset(&Action, 0, sizeof(Action));
+		Action.sa_handler = SimIrqSignal;
+		Action.sa_flags = SA_RESTART;
+		sigaction(SIGUSR1, &Action, NULL);
+		SimCpuThread = pthread_self();
+
+		memset((void *) USB_REG(corenum), 0, sizeof(IP_USBHS_001_T));
+		USB_REG(corenum)->USBSTS_H = SIM_USBSTS_HCHalted;
+		Sim_ResetStats(corenum);
+
+		pHc->Running = true;
+		pthread_create(&pHc->Thread, NULL, SimControllerThread, (void *) (uintptr_t) corenum);
+	}
+}
+
+void HAL_USBDeInit(uint8_t corenum, uint8_t mode)
+{
+	SIM_EHCI_T *pHc = &SimEhci[corenum];
+
+	HAL_DisableUSBInterrupt(corenum);
+	if (pHc->Running) {
+		pHc->Running = false;
+		pthread_join(pHc->Thread, NULL);
+	}
+}
+
+void HAL_EnableUSBInterrupt(uint8_t corenum)
+{
+	SimEhci[corenum].IrqEnabled = true;
+}
+
+void HAL_DisableUSBInterrupt(uint8_t corenum)
+{
+	SimEhci[corenum].IrqEnabled = false;
+}
+
+/*---------- Model control ----------*/
+void Sim_AttachDevice(uint8_t corenum, SIM_USB_DEVICE_T *pDev)
+{
+	pDev->Address = 0;
+	pDev->Reset(pDev);
+	SimEhci[corenum].pDevice = pDev;
+}
+
+void Sim_DetachDevice(uint8_t corenum)
+{
+	SimEhci[corenum].pDevice = NULL;
+}
+
+void Sim_GetStats(uint8_t corenum, SIM_EHCI_STATS_T *pStats)
+{
+	*pStats = SimEhci[corenum].Stats;
+	pStats->WallMs = SimElapsedMs(&SimEhci[corenum].StatsStart);
+}
+
+void Sim_ResetStats(uint8_t corenum)
+{
+	memset(&SimEhci[corenum].Stats, 0, sizeof(SIM_EHCI_STATS_T));
+	clock_gettime(CLOCK_MONOTONIC, &SimEhci[corenum].StatsStart);
+}
+
+void Sim_PrintStats(uint8_t corenum)
+{
+	SIM_EHCI_STATS_T Stats;
+	double Bytes, BusSeconds, WallSeconds;
+
+	Sim_GetStats(corenum, &Stats);
+	Bytes = (double) (Stats.BytesIn + Stats.BytesOut);
+	BusSeconds = Stats.Microframes * 125e-6;
+	WallSeconds = Stats.WallMs * 1e-3;
+
+	printf("USB%u: %lu qTDs, %lu iso, %lu IRQs, %lu NAKs\r\n", corenum, (unsigned long) Stats.QtdProcessed,
+		   (unsigned long) Stats.IsoProcessed, (unsigned long) Stats.Interrupts, (unsigned long) Stats.Naks);
+	printf("USB%u: %.0f bytes (%.0f in, %.0f out), bus %.3f s = %.2f MB/s, wall %.3f s = %.2f MB/s\r\n", corenum,
+		   Bytes, (double) Stats.BytesIn, (double) Stats.BytesOut,
+		   BusSeconds, BusSeconds > 0 ? Bytes / BusSeconds / 1e6 : 0.0,
+		   WallSeconds, WallSeconds > 0 ? Bytes / WallSeconds / 1e6 : 0.0);
+}
+
+#endif /*__USB_SIM__*/
@@ -0,0 +1,155 @@
+/*
+ * @brief HAL USB functions for running the host stack against a software model of the EHCI controller
+ *
+ * @note
+ * Copyright(C) NXP Semiconductors, 2012
+ * All rights reserved.
+ *
+ * @par
+ * Software that is described herein is for illustrative purposes only
+ * which provides customers with programming information regarding the
+ * LPC products.  This software is supplied "AS IS" without any warranties of
+ * any kind, and NXP Semiconductors and its licensor disclaim any and
+ * all warranties, express or implied, including all implied warranties of
+ * merchantability, fitness for a particular purpose and non-infringement of
+ * intellectual property rights.  NXP Semiconductors assumes no responsibility
+ * or liability for the use of the software, conveys no license or rights under any
+ * patent, copyright, mask work right, or any other intellectual property rights in
+ * or to any products. NXP Semiconductors reserves the right to make changes
+ * in the software without notification. NXP Semiconductors also makes no
+ * representation or warranty that such application will be suitable for the
+ * specified use without further testing or modification.
+ *
+ * @par
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation is hereby granted, under NXP Semiconductors' and its
+ * licensor's relevant copyrights in the software, without fee, provided that it
+ * is used in conjunction with NXP Semiconductors microcontrollers.  This
+ * copyright, permission, and disclaimer notice must appear in all copies of
+ * this code.
+ */
+
+ /** @ingroup Group_HAL_LPC
+ *  @defgroup Group_HAL_SIM Hardware Abstraction Layer for the EHCI controller model
+ *  @brief Off-target port of the host stack: the USB register blocks live in RAM and a controller thread walks
+ *  the asynchronous and periodic schedules the way the LPC18xx EHCI does, against devices implemented in
+ *  software. Build the library and application with __LPC18XX__ and __USB_SIM__ defined, use HAL/SIM/HAL_Sim.c
+ *  instead of HAL/LPC18XX/HAL_LPC18xx.c and link with pthreads, prj/sim/Makefile does so. Descriptors hold
+ *  32-bit addresses: on a 64-bit host the driver converts with Sim_BusAddr() and Sim_BusPtr(). Interrupts are delivered as a signal to the thread that called USB_Init(), so the driver is
+ *  preempted exactly as by the NVIC.
+ *  @{
+ */
+
+#ifndef __HAL_SIM_H__
+#define __HAL_SIM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef __BSS
+	#define __BSS(x)
+#endif
+
+/* Transaction results of a simulated endpoint other than a byte count */
+#define SIM_USB_NAK                 (-1)	/* endpoint not ready, the transaction is retried later */
+#define SIM_USB_STALL               (-2)	/* endpoint halted, the qTD is retired with the Halted bit */
+
+typedef struct st_SimUsbDevice SIM_USB_DEVICE_T;
+
+/** A device plugged on the root port of the controller model. Transactions are handed over one packet at a time. */
+struct st_SimUsbDevice {
+	uint8_t Speed;				/* HCD_USB_SPEED reported in PORTSC */
+	uint8_t Address;			/* transactions to any other address time out */
+	void    (*Reset)(SIM_USB_DEVICE_T *pDev);
+	void    (*Setup)(SIM_USB_DEVICE_T *pDev, const uint8_t *pRequest);
+	int32_t (*In)(SIM_USB_DEVICE_T *pDev, uint8_t EndpointNumber, uint8_t *buffer, uint32_t length);
+	int32_t (*Out)(SIM_USB_DEVICE_T *pDev, uint8_t EndpointNumber, const uint8_t *buffer, uint32_t length);
+};
+
+/** Memory regions a bus address can point into (region 0 stands for NULL), each SIM_BUS_REGION_BITS wide */
+#define SIM_BUS_REGIONS             8
+#define SIM_BUS_REGION_BITS         29
+
+/** Counters of the controller model, see Sim_PrintStats() */
+typedef struct {
+	uint32_t Microframes;		/* microframes run, bus time is 125us each */
+	uint32_t QtdProcessed;		/* qTDs retired */
+	uint32_t IsoProcessed;		/* iTD transactions and siTDs retired */
+	uint32_t Interrupts;		/* interrupts delivered to HcdIrqHandler() */
+	uint32_t Naks;				/* NAKed transactions */
+	uint64_t BytesIn;			/* payload moved from device to host */
+	uint64_t BytesOut;			/* payload moved from host to device */
+	uint32_t WallMs;			/* wall clock time since the counters were reset */
+} SIM_EHCI_STATS_T;
+
+/**
+ * @brief	32-bit address the controller model is given for a descriptor or buffer
+ * @param	Ptr			: host pointer
+ * @return	Bus address: the low SIM_BUS_REGION_BITS of the pointer and the index of its region above them
+ * @note	Regions are taken on first use and kept, a program touches a few (static data, heap, stacks).
+ *			Safe to call from the interrupt handler.
+ */
+uint32_t Sim_BusAddr(const void *Ptr);
+
+/**
+ * @brief	Host pointer of a bus address made by Sim_BusAddr()
+ * @param	Addr		: bus address
+ * @return	Host pointer
+ */
+void *Sim_BusPtr(uint32_t Addr);
+
+/**
+ * @brief	Plug a device on the root port, the driver sees a connect change
+ * @param	corenum		: USB port number
+ * @param	pDev		: simulated device, must stay valid until Sim_DetachDevice()
+ * @return	Nothing
+ */
+void Sim_AttachDevice(uint8_t corenum, SIM_USB_DEVICE_T *pDev);
+
+/**
+ * @brief	Unplug the device from the root port
+ * @param	corenum		: USB port number
+ * @return	Nothing
+ */
+void Sim_DetachDevice(uint8_t corenum);
+
+/**
+ * @brief	Read the controller model counters
+ * @param	corenum		: USB port number
+ * @param	pStats		: filled with the counters
+ * @return	Nothing
+ */
+void Sim_GetStats(uint8_t corenum, SIM_EHCI_STATS_T *pStats);
+
+/**
+ * @brief	Clear the controller model counters and restart the wall clock
+ * @param	corenum		: USB port number
+ * @return	Nothing
+ */
+void Sim_ResetStats(uint8_t corenum);
+
+/**
+ * @brief	Print qTDs processed, interrupts raised and throughput in bus time and wall time
+ * @param	corenum		: USB port number
+ * @return	Nothing
+ */
+void Sim_PrintStats(uint8_t corenum);
+
+/**
+ * @brief	Create a high speed Bulk-Only Transport mass storage device backed by an image file
+ * @param	ImagePath	: disk image, opened for read and write, its size gives the capacity
+ * @param	BlockSize	: logical block size reported by READ CAPACITY
+ * @return	Device to pass to Sim_AttachDevice(), NULL if the image cannot be opened
+ */
+SIM_USB_DEVICE_T *Sim_BOTDeviceCreate(const char *ImagePath, uint16_t BlockSize);
+
+/**
+ * @brief	Close the image file and free a device made by Sim_BOTDeviceCreate()
+ * @param	pDev		: device to destroy, must be detached
+ * @return	Nothing
+ */
+void Sim_BOTDeviceDestroy(SIM_USB_DEVICE_T *pDev);
+
+#endif	// __HAL_SIM_H__
+
+/** @} */
@@ -0,0 +1,580 @@
+/*
+ * @brief Simulated Bulk-Only Transport mass storage device for the EHCI controller model
+ *
+ * @note
+ * Copyright(C) NXP Semiconductors, 2012
+ * All rights reserved.
+ *
+ * @par
+ * Software that is described herein is for illustrative purposes only
+ * which provides customers with programming information regarding the
+ * LPC products.  This software is supplied "AS IS" without any warranties of
+ * any kind, and NXP Semiconductors and its licensor disclaim any and
+ * all warranties, express or implied, including all implied warranties of
+ * merchantability, fitness for a particular purpose and non-infringement of
+ * intellectual property rights.  NXP Semiconductors assumes no responsibility
+ * or liability for the use of the software, conveys no license or rights under any
+ * patent, copyright, mask work right, or any other intellectual property rights in
+ * or to any products. NXP Semiconductors reserves the right to make changes
+ * in the software without notification. NXP Semiconductors also makes no
+ * representation or warranty that such application will be suitable for the
+ * specified use without further testing or modification.
+ *
+ * @par
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation is hereby granted, under NXP Semiconductors' and its
+ * licensor's relevant copyrights in the software, without fee, provided that it
+ * is used in conjunction with NXP Semiconductors microcontrollers.  This
+ * copyright, permission, and disclaimer notice must appear in all copies of
+ * this code.
+ */
+
+#if defined(__USB_SIM__)
+
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "HAL_Sim.h"
+
+#define BOT_BULK_IN_EP              1
+#define BOT_BULK_OUT_EP             2
+#define BOT_MAX_PACKET              512
+#define BOT_CBW_SIGNATURE           0x43425355UL
+#define BOT_CSW_SIGNATURE           0x53425355UL
+#define BOT_BUFFER_SIZE             65536
+
+#define BOT_MIN2(a, b)              (((a) < (b)) ? (a) : (b))
+#define BOT_MIN3(a, b, c)           BOT_MIN2(BOT_MIN2(a, b), c)
+
+typedef enum {
+	BOT_STATE_CBW,
+	BOT_STATE_DATA_IN,
+	BOT_STATE_DATA_OUT,
+	BOT_STATE_CSW
+} BOT_STATE;
+
+typedef struct {
+	SIM_USB_DEVICE_T Device;	/* must stay first, the callbacks cast back from it */
+	FILE *Image;
+	uint64_t Blocks;
+	uint16_t BlockSize;
+
+	/*-- Control pipe --*/
+	uint8_t Configuration;
+	uint8_t PendingAddress;
+	uint8_t Control[64];
+	uint32_t ControlLength;
+	uint32_t ControlOffset;
+	bool ControlIn;
+	bool ControlStatusPending;
+	bool Ep0Stalled;
+	bool EpInHalted;
+	bool EpOutHalted;
+
+	/*-- Bulk-Only Transport --*/
+	BOT_STATE State;
+	uint32_t Tag;
+	uint32_t DataLength;		/* host expected length from the CBW */
+	uint32_t DataDone;
+	uint8_t Status;
+	uint8_t SenseKey;
+	uint8_t Asc;
+
+	/*-- Current SCSI data phase --*/
+	uint8_t Response[64];
+	uint32_t ResponseLength;
+	uint64_t Lba;
+	uint32_t BlocksLeft;
+	bool IsMediaAccess;
+	uint8_t Buffer[BOT_BUFFER_SIZE];
+	uint32_t BufferLength;
+	uint32_t BufferOffset;
+} SIM_BOT_DEVICE_T;
+
+static const uint8_t BOTDeviceDescriptor[18] = {
+	18, 0x01, 0x00, 0x02, 0x00, 0x00, 0x00, 64,
+	0xC9, 0x1F, 0x0E, 0x00, 0x00, 0x01,		/* VID 0x1FC9, PID 0x000E, bcdDevice 1.00 */
+	0x00, 0x00, 0x00, 0x01
+};
+
+static const uint8_t BOTConfigDescriptor[32] = {
+	9, 0x02, 32, 0, 1, 1, 0, 0x80, 50,
+	9, 0x04, 0, 0, 2, 0x08, 0x06, 0x50, 0,	/* Mass Storage, SCSI transparent, Bulk-Only */
+	7, 0x05, 0x80 | BOT_BULK_IN_EP, 0x02, BOT_MAX_PACKET & 0xFF, BOT_MAX_PACKET >> 8, 0,
+	7, 0x05, BOT_BULK_OUT_EP, 0x02, BOT_MAX_PACKET & 0xFF, BOT_MAX_PACKET >> 8, 0
+};
+
+static uint32_t GetBE32(const uint8_t *p)
+{
+	return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+static void PutBE32(uint8_t *p, uint32_t v)
+{
+	p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+}
+
+static void PutLE32(uint8_t *p, uint32_t v)
+{
+	p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+/*---------- Control endpoint ----------*/
+static void BOTReset(SIM_USB_DEVICE_T *pDevice)
+{
+	SIM_BOT_DEVICE_T *pBot = (SIM_BOT_DEVICE_T *) pDevice;
+
+	pBot->Configuration = 0;
+	pBot->ControlLength = pBot->ControlOffset = 0;
+	pBot->ControlStatusPending = false;
+	pBot->Ep0Stalled = pBot->EpInHalted = pBot->EpOutHalted = false;
+	pBot->State = BOT_STATE_CBW;
+	pBot->SenseKey = pBot->Asc = 0;
+}
+
+static void BOTControlReply(SIM_BOT_DEVICE_T *pBot, const uint8_t *data, uint32_t length, uint16_t wLength)
+{
+	pBot->ControlLength = (length < wLength) ? length : wLength;
+	memcpy(pBot->Control, data, pBot->ControlLength);
+}
+
+static void BOTSetup(SIM_USB_DEVICE_T *pDevice, const uint8_t *pRequest)
+{
+	SIM_BOT_DEVICE_T *pBot = (SIM_BOT_DEVICE_T *) pDevice;
+	uint8_t bmRequestType = pRequest[0], bRequest = pRequest[1];
+	uint16_t wValue = pRequest[2] | (pRequest[3] << 8);
+	uint16_t wIndex = pRequest[4] | (pRequest[5] << 8);
+	uint16_t wLength = pRequest[6] | (pRequest[7] << 8);
+	uint8_t Zero[2] = {0, 0};
+
+	pBot->Ep0Stalled = false;
+	pBot->ControlLength = pBot->ControlOffset = 0;
+	pBot->ControlIn = (bmRequestType & 0x80) != 0;
+	pBot->ControlStatusPending = true;
+	pBot->PendingAddress = pDevice->Address;
+
+	switch ((bmRequestType & 0x60) | bRequest) {
+	case 0x06:	/*-- GET_DESCRIPTOR --*/
+		if ((wValue >> 8) == 0x01) {
+			BOTControlReply(pBot, BOTDeviceDescriptor, sizeof(BOTDeviceDescriptor), wLength);
+		}
+		else if ((wValue >> 8) == 0x02) {
+			BOTControlReply(pBot, BOTConfigDescriptor, sizeof(BOTConfigDescriptor), wLength);
+		}
+		else {
+			pBot->Ep0Stalled = true;
+		}
+		break;
+
+	case 0x05:	/*-- SET_ADDRESS, takes effect after the status stage --*/
+		pBot->PendingAddress = wValue & 0x7F;
+		break;
+
+	case 0x09:	/*-- SET_CONFIGURATION --*/
+		pBot->Configuration = wValue & 0xFF;
+		pBot->EpInHalted = pBot->EpOutHalted = false;
+		break;
+
+	case 0x08:	/*-- GET_CONFIGURATION --*/
+		BOTControlReply(pBot, &pBot->Configuration, 1, wLength);
+		break;
+
+	case 0x00:	/*-- GET_STATUS --*/
+		if (((bmRequestType & 0x1F) == 0x02) && ((wIndex & 0x7F) == BOT_BULK_IN_EP)) {
+			Zero[0] = pBot->EpInHalted;
+		}
+		else if (((bmRequestType & 0x1F) == 0x02) && ((wIndex & 0x7F) == BOT_BULK_OUT_EP)) {
+			Zero[0] = pBot->EpOutHalted;
+		}
+		BOTControlReply(pBot, Zero, 2, wLength);
+		break;
+
+	case 0x01:	/*-- CLEAR_FEATURE(ENDPOINT_HALT) --*/
+		if ((wIndex & 0x7F) == BOT_BULK_IN_EP) {
+			pBot->EpInHalted = false;
+		}
+		else if ((wIndex & 0x7F) == BOT_BULK_OUT_EP) {
+			pBot->EpOutHalted = false;
+		}
+		break;
+
+	case 0x0B:	/*-- SET_INTERFACE, alternate setting 0 only --*/
+		pBot->Ep0Stalled = (wValue != 0);
+		break;
+
+	case 0x20 | 0xFE:	/*-- Get Max LUN --*/
+		BOTControlReply(pBot, Zero, 1, wLength);
+		break;
+
+	case 0x20 | 0xFF:	/*-- Bulk-Only Mass Storage Reset --*/
+		pBot->State = BOT_STATE_CBW;
+		break;
+
+	default:
+		pBot->Ep0Stalled = true;
+		break;
+	}
+}
+
+static int32_t BOTControlIn(SIM_BOT_DEVICE_T *pBot, uint8_t *buffer, uint32_t length)
+{
+	uint32_t Count;
+
+	if (pBot->Ep0Stalled) {
+		return SIM_USB_STALL;
+	}
+	if (!pBot->ControlIn) {	/*-- status stage of a no-data or OUT request --*/
+		pBot->ControlStatusPending = false;
+		pBot->Device.Address = pBot->PendingAddress;
+		return 0;
+	}
+	Count = pBot->ControlLength - pBot->ControlOffset;
+	Count = (Count < length) ? Count : length;
+	memcpy(buffer, &pBot->Control[pBot->ControlOffset], Count);
+	pBot->ControlOffset += Count;
+	return Count;
+}
+
+static int32_t BOTControlOut(SIM_BOT_DEVICE_T *pBot, uint32_t length)
+{
+	if (pBot->Ep0Stalled) {
+		return SIM_USB_STALL;
+	}
+	if (pBot->ControlIn) {	/*-- status stage of an IN request --*/
+		pBot->ControlStatusPending = false;
+	}
+	return length;
+}
+
+/*---------- SCSI commands ----------*/
+static void BOTSense(SIM_BOT_DEVICE_T *pBot, uint8_t SenseKey, uint8_t Asc)
+{
+	pBot->Status = (SenseKey != 0) ? 1 : 0;
+	pBot->SenseKey = SenseKey;
+	pBot->Asc = Asc;
+}
+
+static bool BOTMediaRange(SIM_BOT_DEVICE_T *pBot, uint64_t Lba, uint32_t Blocks)
+{
+	if ((Lba + Blocks) > pBot->Blocks) {
+		BOTSense(pBot, 0x05, 0x21);	/*-- ILLEGAL REQUEST, LBA out of range --*/
+		return false;
+	}
+	pBot->Lba = Lba;
+	pBot->BlocksLeft = Blocks;
+	pBot->IsMediaAccess = true;
+	pBot->BufferLength = pBot->BufferOffset = 0;
+	return true;
+}
+
+static void BOTCommand(SIM_BOT_DEVICE_T *pBot, const uint8_t *Cdb)
+{
+	uint8_t *r = pBot->Response;
+	uint64_t LastLba = pBot->Blocks - 1;
+
+	memset(r, 0, sizeof(pBot->Response));
+	pBot->ResponseLength = 0;
+	pBot->IsMediaAccess = false;
+	pBot->BlocksLeft = 0;
+	BOTSense(pBot, 0, 0);
+
+	switch (Cdb[0]) {
+	case 0x12:	/*-- INQUIRY --*/
+		r[1] = 0x80;	/*-- removable --*/
+		r[2] = 0x04;
+		r[3] = 0x02;
+		r[4] = 31;
+		memcpy(&r[8], "NXP     ", 8);
+		memcpy(&r[16], "Sim BOT Disk    ", 16);
+		memcpy(&r[32], "1.00", 4);
+		pBot->ResponseLength = 36;
+		break;
+
+	case 0x00:	/*-- TEST UNIT READY --*/
+	case 0x1E:	/*-- PREVENT ALLOW MEDIUM REMOVAL --*/
+	case 0x2F:	/*-- VERIFY(10) --*/
+	case 0x1D:	/*-- SEND DIAGNOSTIC --*/
+	case 0x1B:	/*-- START STOP UNIT --*/
+	case 0x35:	/*-- SYNCHRONIZE CACHE(10) --*/
+		if (Cdb[0] == 0x35) {
+			fflush(pBot->Image);
+		}
+		break;
+
+	case 0x03:	/*-- REQUEST SENSE, reports and clears the last error --*/
+		r[0] = 0x70;
+		r[2] = pBot->SenseKey;
+		r[7] = 10;
+		r[12] = pBot->Asc;
+		pBot->ResponseLength = 18;
+		pBot->SenseKey = pBot->Asc = 0;
+		break;
+
+	case 0x25:	/*-- READ CAPACITY(10) --*/
+		PutBE32(&r[0], (LastLba > 0xFFFFFFFFULL) ? 0xFFFFFFFFUL : (uint32_t) LastLba);
+		PutBE32(&r[4], pBot->BlockSize);
+		pBot->ResponseLength = 8;
+		break;
+
+	case 0x9E:	/*-- READ CAPACITY(16) --*/
+		PutBE32(&r[0], (uint32_t) (LastLba >> 32));
+		PutBE32(&r[4], (uint32_t) LastLba);
+		PutBE32(&r[8], pBot->BlockSize);
+		pBot->ResponseLength = 32;
+		break;
+
+	case 0x1A:	/*-- MODE SENSE(6), no pages, not write protected --*/
+		r[0] = 3;
+		pBot->ResponseLength = 4;
+		break;
+
+	case 0x5A:	/*-- MODE SENSE(10) --*/
+		r[1] = 6;
+		pBot->ResponseLength = 8;
+		break;
+
+	case 0x28:	/*-- READ(10) --*/
+	case 0x2A:	/*-- WRITE(10) --*/
+		BOTMediaRange(pBot, GetBE32(&Cdb[2]), (Cdb[7] << 8) | Cdb[8]);
+		break;
+
+	case 0x88:	/*-- READ(16) --*/
+	case 0x8A:	/*-- WRITE(16) --*/
+		BOTMediaRange(pBot, ((uint64_t) GetBE32(&Cdb[2]) << 32) | GetBE32(&Cdb[6]), GetBE32(&Cdb[10]));
+		break;
+
+	default:
+		BOTSense(pBot, 0x05, 0x20);	/*-- ILLEGAL REQUEST, invalid command --*/
+		break;
+	}
+}
+
+/* Refill the buffer from the image for the next part of a READ */
+static bool BOTMediaFill(SIM_BOT_DEVICE_T *pBot)
+{
+	uint32_t Blocks = BOT_BUFFER_SIZE / pBot->BlockSize;
+
+	Blocks = (Blocks < pBot->BlocksLeft) ? Blocks : pBot->BlocksLeft;
+	if ((fseeko(pBot->Image, (off_t) (pBot->Lba * pBot->BlockSize), SEEK_SET) != 0) ||
+		(fread(pBot->Buffer, pBot->BlockSize, Blocks, pBot->Image) != Blocks)) {
+		BOTSense(pBot, 0x03, 0x11);	/*-- MEDIUM ERROR, unrecovered read error --*/
+		return false;
+	}
+	pBot->Lba += Blocks;
+	pBot->BlocksLeft -= Blocks;
+	pBot->BufferLength = Blocks * pBot->BlockSize;
+	pBot->BufferOffset = 0;
+	return true;
+}
+
+/* Write the buffered part of a WRITE to the image */
+static void BOTMediaFlush(SIM_BOT_DEVICE_T *pBot)
+{
+	uint32_t Blocks = pBot->BufferLength / pBot->BlockSize;
+
+	if (Blocks == 0) {
+		return;
+	}
+	if ((fseeko(pBot->Image, (off_t) (pBot->Lba * pBot->BlockSize), SEEK_SET) != 0) ||
+		(fwrite(pBot->Buffer, pBot->BlockSize, Blocks, pBot->Image) != Blocks)) {
+		BOTSense(pBot, 0x03, 0x0C);	/*-- MEDIUM ERROR, write error --*/
+	}
+	pBot->Lba += Blocks;
+	pBot->BlocksLeft -= Blocks;
+	pBot->BufferLength = 0;
+}
+
+/*---------- Bulk endpoints ----------*/
+static void BOTDataPhaseDone(SIM_BOT_DEVICE_T *pBot)
+{
+	pBot->State = BOT_STATE_CSW;
+}
+
+static int32_t BOTBulkIn(SIM_BOT_DEVICE_T *pBot, uint8_t *buffer, uint32_t length)
+{
+	uint8_t *Csw = buffer;
+	uint32_t Count;
+
+	if (pBot->EpInHalted) {
+		return SIM_USB_STALL;
+	}
+
+	switch (pBot->State) {
+	case BOT_STATE_DATA_IN:
+		if (pBot->IsMediaAccess) {
+			if ((pBot->BufferOffset == pBot->BufferLength) && ((pBot->BlocksLeft == 0) || !BOTMediaFill(pBot))) {
+				pBot->EpInHalted = (pBot->DataDone < pBot->DataLength);
+				BOTDataPhaseDone(pBot);
+				return pBot->EpInHalted ? SIM_USB_STALL : SIM_USB_NAK;
+			}
+			Count = pBot->BufferLength - pBot->BufferOffset;
+			Count = BOT_MIN3(Count, length, pBot->DataLength - pBot->DataDone);
+			memcpy(buffer, &pBot->Buffer[pBot->BufferOffset], Count);
+			pBot->BufferOffset += Count;
+		}
+		else {
+			Count = (pBot->ResponseLength > pBot->DataDone) ? (pBot->ResponseLength - pBot->DataDone) : 0;
+			Count = BOT_MIN3(Count, length, pBot->DataLength - pBot->DataDone);
+			memcpy(buffer, &pBot->Response[pBot->DataDone], Count);
+		}
+		pBot->DataDone += Count;
+
+		/*-- Data shorter than the host asked for: end with a short packet and stall the rest --*/
+		if ((pBot->DataDone == pBot->DataLength) ||
+			(!pBot->IsMediaAccess && (pBot->DataDone >= pBot->ResponseLength)) ||
+			(pBot->IsMediaAccess && (pBot->BlocksLeft == 0) && (pBot->BufferOffset == pBot->BufferLength))) {
+			if ((pBot->DataDone < pBot->DataLength) && (Count == length)) {
+				pBot->EpInHalted = true;
+			}
+			BOTDataPhaseDone(pBot);
+		}
+		return Count;
+
+	case BOT_STATE_CSW:
+		if (length < 13) {
+			return SIM_USB_STALL;
+		}
+		PutLE32(&Csw[0], BOT_CSW_SIGNATURE);
+		PutLE32(&Csw[4], pBot->Tag);
+		PutLE32(&Csw[8], pBot->DataLength - pBot->DataDone);
+		Csw[12] = pBot->Status;
+		pBot->State = BOT_STATE_CBW;
+		return 13;
+
+	default:
+		return SIM_USB_NAK;
+	}
+}
+
+static int32_t BOTBulkOut(SIM_BOT_DEVICE_T *pBot, const uint8_t *buffer, uint32_t length)
+{
+	uint32_t Count;
+
+	if (pBot->EpOutHalted) {
+		return SIM_USB_STALL;
+	}
+
+	switch (pBot->State) {
+	case BOT_STATE_CBW:
+		if ((length != 31) || ((buffer[0] | (buffer[1] << 8) | (buffer[2] << 16) | ((uint32_t) buffer[3] << 24)) !=
+							   BOT_CBW_SIGNATURE)) {
+			pBot->EpInHalted = pBot->EpOutHalted = true;	/*-- invalid CBW, wait for a reset recovery --*/
+			return SIM_USB_STALL;
+		}
+		pBot->Tag = buffer[4] | (buffer[5] << 8) | (buffer[6] << 16) | ((uint32_t) buffer[7] << 24);
+		pBot->DataLength = buffer[8] | (buffer[9] << 8) | (buffer[10] << 16) | ((uint32_t) buffer[11] << 24);
+		pBot->DataDone = 0;
+		BOTCommand(pBot, &buffer[15]);
+
+		if (pBot->DataLength == 0) {
+			pBot->State = BOT_STATE_CSW;
+		}
+		else if (buffer[12] & 0x80) {
+			pBot->State = BOT_STATE_DATA_IN;
+			if ((pBot->Status != 0) || (pBot->ResponseLength == 0 && !pBot->IsMediaAccess)) {
+				pBot->EpInHalted = true;	/*-- nothing to send, the host clears the stall and reads the CSW --*/
+				pBot->State = BOT_STATE_CSW;
+			}
+		}
+		else {
+			pBot->State = BOT_STATE_DATA_OUT;
+			if (!pBot->IsMediaAccess) {
+				pBot->EpOutHalted = true;
+				pBot->State = BOT_STATE_CSW;
+			}
+		}
+		return length;
+
+	case BOT_STATE_DATA_OUT:
+		Count = BOT_MIN3(length, BOT_BUFFER_SIZE - pBot->BufferLength, pBot->DataLength - pBot->DataDone);
+		memcpy(&pBot->Buffer[pBot->BufferLength], buffer, Count);
+		pBot->BufferLength += Count;
+		pBot->DataDone += Count;
+		if ((pBot->BufferLength == BOT_BUFFER_SIZE) ||
+			((pBot->BufferLength / pBot->BlockSize) >= pBot->BlocksLeft) ||
+			(pBot->DataDone == pBot->DataLength)) {
+			BOTMediaFlush(pBot);
+		}
+		if ((pBot->DataDone == pBot->DataLength) || (pBot->BlocksLeft == 0)) {
+			BOTDataPhaseDone(pBot);
+		}
+		return length;
+
+	default:
+		return SIM_USB_NAK;
+	}
+}
+
+static int32_t BOTIn(SIM_USB_DEVICE_T *pDevice, uint8_t EndpointNumber, uint8_t *buffer, uint32_t length)
+{
+	SIM_BOT_DEVICE_T *pBot = (SIM_BOT_DEVICE_T *) pDevice;
+
+	if (EndpointNumber == 0) {
+		return BOTControlIn(pBot, buffer, length);
+	}
+	if ((EndpointNumber == BOT_BULK_IN_EP) && pBot->Configuration) {
+		return BOTBulkIn(pBot, buffer, length);
+	}
+	return SIM_USB_STALL;
+}
+
+static int32_t BOTOut(SIM_USB_DEVICE_T *pDevice, uint8_t EndpointNumber, const uint8_t *buffer, uint32_t length)
+{
+	SIM_BOT_DEVICE_T *pBot = (SIM_BOT_DEVICE_T *) pDevice;
+
+	if (EndpointNumber == 0) {
+		return BOTControlOut(pBot, length);
+	}
+	if ((EndpointNumber == BOT_BULK_OUT_EP) && pBot->Configuration) {
+		return BOTBulkOut(pBot, buffer, length);
+	}
+	return SIM_USB_STALL;
+}
+
+SIM_USB_DEVICE_T *Sim_BOTDeviceCreate(const char *ImagePath, uint16_t BlockSize)
+{
+	SIM_BOT_DEVICE_T *pBot;
+	FILE *Image = fopen(ImagePath, "r+b");
+	off_t Size;
+
+	if ((Image == NULL) || (BlockSize == 0) || (BOT_BUFFER_SIZE % BlockSize)) {
+		if (Image) {
+			fclose(Image);
+		}
+		return NULL;
+	}
+	fseeko(Image, 0, SEEK_END);
+	Size = ftello(Image);
+
+	pBot = calloc(1, sizeof(SIM_BOT_DEVICE_T));
+	if ((pBot == NULL) || (Size < BlockSize)) {
+		free(pBot);
+		fclose(Image);
+		return NULL;
+	}
+	pBot->Image = Image;
+	pBot->BlockSize = BlockSize;
+	pBot->Blocks = (uint64_t) Size / BlockSize;
+	pBot->Device.Speed = 2;	/*-- HIGH_SPEED --*/
+	pBot->Device.Reset = BOTReset;
+	pBot->Device.Setup = BOTSetup;
+	pBot->Device.In = BOTIn;
+	pBot->Device.Out = BOTOut;
+	return &pBot->Device;
+}
+
+void Sim_BOTDeviceDestroy(SIM_USB_DEVICE_T *pDev)
+{
+	SIM_BOT_DEVICE_T *pBot = (SIM_BOT_DEVICE_T *) pDev;
+
+	if (pBot) {
+		fclose(pBot->Image);
+		free(pBot);
+	}
+}
+
+#endif /*__USB_SIM__*/
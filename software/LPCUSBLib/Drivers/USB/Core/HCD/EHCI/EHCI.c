@@ -51,13 +51,20 @@ PRAGMA_ALIGN_4096
 NextLinkPointer PeriodFrameList0[FRAME_LIST_SIZE] ATTR_ALIGNED(4096) __BSS(USBRAM_SECTION);		/* Period Frame List */
 PRAGMA_ALIGN_4096
 NextLinkPointer PeriodFrameList1[FRAME_LIST_SIZE] ATTR_ALIGNED(4096) __BSS(USBRAM_SECTION);		/* Period Frame List */
-Pipe_Stream_Handle_T PipeStreaming[MAX_USB_CORE];
+Pipe_Stream_Handle_T PipeStreaming[MAX_USB_CORE][HCD_MAX_QHD];	/* Per queue head, so bulk pipes can stream concurrently */
+Iso_Stream_Handle_T IsoStreaming[MAX_USB_CORE][HCD_MAX_QHD];	/* Double-buffered stream of ISO pipes */
+Periodic_Schedule_T PeriodicSchedule[MAX_USB_CORE][HCD_MAX_QHD];	/* Frames and microframes booked by each periodic pipe */
+uint8_t FrameListShrink[MAX_USB_CORE];				/* Frame list in use holds FRAME_LIST_SIZE >> FrameListShrink entries */
+static bool HostStarted[MAX_USB_CORE];				/* Frame list size is fixed while the host driver is up */
+static uint16_t uFrameLoad[MAX_USB_CORE][HCD_BANDWIDTH_FRAMES][8];	/* Periodic bytes booked in each microframe (HS) */
+static uint16_t FsFrameLoad[MAX_USB_CORE][HCD_BANDWIDTH_FRAMES];	/* Periodic bytes booked in each full speed frame behind the TT */
 /*=======================================================================*/
 /* G L O B A L   F U N C T I O N S                                       */
 /*=======================================================================*/
 HCD_STATUS HcdInitDriver(uint8_t HostID)
 {
 	EHciHostReset(HostID);
+	HostStarted[HostID] = true;
 	return EHciHostInit(HostID);
 }
 
@@ -66,10 +73,34 @@ HCD_STATUS HcdDeInitDriver(uint8_t HostID)
 	USB_REG(HostID)->USBSTS_H = 0xFFFFFFFF;				/* clear all current interrupts */
 	USB_REG(HostID)->PORTSC1_H &= ~(1 << 12);			/* clear port power */
 	USB_REG(HostID)->USBMODE_H =   (1 << 0);				/* set USB mode reserve */
+	HostStarted[HostID] = false;
 
 	return HCD_STATUS_OK;
 }
 
+HCD_STATUS HcdSetFrameListSize(uint8_t HostID, uint16_t Entries)
+{
+	uint8_t Shrink;
+
+	if (HostID >= MAX_USB_CORE) {
+		ASSERT_STATUS_OK_MESSAGE(HCD_STATUS_PARAMETER_INVALID, "Invalid HostID");
+	}
+	if (HostStarted[HostID]) {
+		ASSERT_STATUS_OK_MESSAGE(HCD_STATUS_PARAMETER_INVALID, "Frame list size can only change before USB_Init");
+	}
+
+	/*-- Only shorter lists fit in the storage, the controller supports down to 8 entries.
+	   A longer list needs a build with a smaller FRAMELIST_SIZE_BITS. --*/
+	for (Shrink = 0; (FRAME_LIST_SIZE >> Shrink) > Entries && (FRAME_LIST_SIZE >> Shrink) > 8; Shrink++) {}
+	if ((FRAME_LIST_SIZE >> Shrink) != Entries) {
+		ASSERT_STATUS_OK_MESSAGE(HCD_STATUS_PARAMETER_INVALID,
+								 "Frame list size must be a power of 2 from 8 up to 1024 >> FRAMELIST_SIZE_BITS");
+	}
+
+	FrameListShrink[HostID] = Shrink;
+	return HCD_STATUS_OK;
+}
+
 HCD_STATUS HcdRhPortEnable(uint8_t HostID)
 {
 	return HCD_STATUS_OK;
@@ -159,28 +190,35 @@ HCD_STATUS HcdOpenPipe(uint8_t HostID,
 		DisableAsyncSchedule(HostID);
 		InsertLinkPointer(&HcdAsyncHead(HostID)->Horizontal, &HcdQHD(HostID, HeadIdx)->Horizontal, QHD_TYPE);
 		EnableAsyncSchedule(HostID);
+		memset(&PipeStreaming[HostID][HeadIdx], 0, sizeof(Pipe_Stream_Handle_T));
 		break;
 
 	case INTERRUPT_TRANSFER:
 		ASSERT_STATUS_OK(AllocQhd(HostID, DeviceAddr, DeviceSpeed, EndpointNumber, TransferType, TransferDir,
 								  MaxPacketSize, Interval, Mult, HSHubDevAddr, HSHubPortNum, &HeadIdx) );
+		if (ReservePeriodicBandwidth(HostID, HeadIdx, Interval) != HCD_STATUS_OK) {
+			FreeQhd(HostID, HeadIdx);
+			ASSERT_STATUS_OK_MESSAGE(HCD_STATUS_NOT_ENOUGH_BANDWIDTH, "Periodic schedule cannot fit this interrupt endpoint");
+		}
 		DisablePeriodSchedule(HostID);
-		InsertLinkPointer(&HcdIntHead(HostID)->Horizontal, &HcdQHD(HostID, HeadIdx)->Horizontal, QHD_TYPE);
+		LinkPeriodicQhd(HostID, HeadIdx);
 		EnablePeriodSchedule(HostID);
-		memset(&PipeStreaming[HostID], 0, sizeof(Pipe_Stream_Handle_T));
+		memset(&PipeStreaming[HostID][HeadIdx], 0, sizeof(Pipe_Stream_Handle_T));
 		break;
 
 	case ISOCHRONOUS_TRANSFER:
-#ifndef __TEST__
-		if (( DeviceSpeed == HIGH_SPEED) || ( TransferDir == IN_TRANSFER) ) {	/* TODO currently not support HS due to lack of device for testing */
-			ASSERT_STATUS_OK_MESSAGE(HCD_STATUS_TRANSFER_TYPE_NOT_SUPPORTED,
-									 "Highspeed ISO and ISO IN is not supported yet, due to lack of testing");
-		}
-#endif
 		ASSERT_STATUS_OK(AllocQhd(HostID, DeviceAddr, DeviceSpeed, EndpointNumber, TransferType, TransferDir,
 								  MaxPacketSize, Interval, Mult, HSHubDevAddr, HSHubPortNum, &HeadIdx) );
+		if (ReservePeriodicBandwidth(HostID, HeadIdx, Interval) != HCD_STATUS_OK) {
+			FreeQhd(HostID, HeadIdx);
+			ASSERT_STATUS_OK_MESSAGE(HCD_STATUS_NOT_ENOUGH_BANDWIDTH, "Periodic schedule cannot fit this ISO endpoint");
+		}
+		memset(&IsoStreaming[HostID][HeadIdx], 0, sizeof(Iso_Stream_Handle_T));
 		EnablePeriodSchedule(HostID);
 		break;
+
+	default:
+		return HCD_STATUS_PARAMETER_INVALID;
 	}
 
 	PipehandleCreate(pPipeHandle, HostID, TransferType, HeadIdx);
@@ -200,10 +238,12 @@ HCD_STATUS HcdClosePipe(uint32_t PipeHandle)
 	case BULK_TRANSFER:
 	case INTERRUPT_TRANSFER:
 		RemoveQueueHead(HostID, HeadIdx);
+		ReleasePeriodicBandwidth(HostID, HeadIdx);
 		USB_REG(HostID)->USBCMD_H |= EHC_USBCMD_IntAsyncAdvanceDoorbell;	/* DoorBell Handshake: Queue Head will only be free in AsyncAdvanceIsr */
 		break;
 
 	case ISOCHRONOUS_TRANSFER:
+		ReleasePeriodicBandwidth(HostID, HeadIdx);
 		FreeQhd(HostID, HeadIdx);
 		DisablePeriodSchedule(HostID);
 		break;
@@ -211,6 +251,46 @@ HCD_STATUS HcdClosePipe(uint32_t PipeHandle)
 	return HCD_STATUS_OK;
 }
 
+HCD_STATUS HcdSetPipeInterval(uint32_t PipeHandle, uint8_t Interval)
+{
+	uint8_t HostID, HeadIdx;
+	HCD_TRANSFER_TYPE XferType;
+	uint8_t OldInterval;
+	HCD_STATUS status;
+
+	ASSERT_STATUS_OK(PipehandleParse(PipeHandle, &HostID, &XferType, &HeadIdx) );
+
+	if ((XferType == CONTROL_TRANSFER) || (XferType == BULK_TRANSFER)) {
+		return HCD_STATUS_OK;
+	}
+	OldInterval = PeriodicSchedule[HostID][HeadIdx].Interval;
+	if (Interval == OldInterval) {
+		return HCD_STATUS_OK;
+	}
+
+	if ((XferType == ISOCHRONOUS_TRANSFER) &&
+		(IsoStreaming[HostID][HeadIdx].Callback || (HcdQHD(HostID, HeadIdx)->status == HCD_STATUS_TRANSFER_QUEUED))) {
+		ASSERT_STATUS_OK_MESSAGE(HCD_STATUS_PARAMETER_INVALID, "ISO pipe is busy");
+	}
+
+	/*-- Re-plan from scratch, the old placement is always available again if the new one does not fit --*/
+	DisablePeriodSchedule(HostID);
+	if (XferType == INTERRUPT_TRANSFER) {
+		UnlinkPeriodicQhd(HostID, HeadIdx);
+	}
+	ReleasePeriodicBandwidth(HostID, HeadIdx);
+	status = ReservePeriodicBandwidth(HostID, HeadIdx, Interval);
+	if (status != HCD_STATUS_OK) {
+		ReservePeriodicBandwidth(HostID, HeadIdx, OldInterval);
+	}
+	if (XferType == INTERRUPT_TRANSFER) {
+		LinkPeriodicQhd(HostID, HeadIdx);
+	}
+	EnablePeriodSchedule(HostID);
+
+	return status;
+}
+
 HCD_STATUS HcdCancelTransfer(uint32_t PipeHandle)
 {
 	uint8_t HostID, HeadIdx;
@@ -218,17 +298,22 @@ HCD_STATUS HcdCancelTransfer(uint32_t PipeHandle)
 
 	ASSERT_STATUS_OK(PipehandleParse(PipeHandle, &HostID, &XferType, &HeadIdx) );
 
+	/*-- IsoStreamIsr() requeues stream buffers into the frame list, keep it out while TDs are unlinked --*/
+	HAL_DisableUSBInterrupt(HostID);
 	DisableSchedule(HostID, (XferType == INTERRUPT_TRANSFER) || (XferType == ISOCHRONOUS_TRANSFER) ? 1 : 0);
 
 	if (XferType == ISOCHRONOUS_TRANSFER) {	/* ISOCHRONOUS_TRANSFER */
 		uint32_t i;
-		for (i = 0; i < FRAME_LIST_SIZE; i++) {	/*-- Foreach link in Period List Base --*/
+
+		IsoStreaming[HostID][HeadIdx].Callback = NULL;	/*-- cancelling also ends a stream --*/
+		IsoStreaming[HostID][HeadIdx].Pending = 0;
+		for (i = 0; i < EHCI_FRAME_LIST_SIZE(HostID); i++) {	/*-- Foreach link in Period List Base --*/
 			NextLinkPointer *pNextPointer = &EHCI_FRAME_LIST(HostID)[i];
 
 			/*-- Foreach Itd/SItd in the link--*/
 			while ( isValidLink(pNextPointer->Link) && pNextPointer->Type != QHD_TYPE) {
 				if (pNextPointer->Type == ITD_TYPE) {	/*-- Highspeed ISO --*/
-					PHCD_HS_ITD pItd = (PHCD_HS_ITD) Align32(pNextPointer->Link);
+					PHCD_HS_ITD pItd = (PHCD_HS_ITD) HcdBusPtr(Align32(pNextPointer->Link));
 
 					if (HeadIdx == pItd->IhdIdx) {
 						/*-- remove matched ITD --*/
@@ -238,7 +323,7 @@ HCD_STATUS HcdCancelTransfer(uint32_t PipeHandle)
 					}
 				}
 				else if (pNextPointer->Type == SITD_TYPE) {	/*-- Split ISO --*/
-					PHCD_SITD pSItd = (PHCD_SITD) Align32(pNextPointer->Link);
+					PHCD_SITD pSItd = (PHCD_SITD) HcdBusPtr(Align32(pNextPointer->Link));
 
 					if (HeadIdx == pSItd->IhdIdx) {
 						/*-- removed matched SITD --*/
@@ -247,7 +332,7 @@ HCD_STATUS HcdCancelTransfer(uint32_t PipeHandle)
 						continue;	/*-- skip advance pNextPointer due to TD removal --*/
 					}
 				}
-				pNextPointer = (NextLinkPointer *) Align32(pNextPointer->Link);
+				pNextPointer = (NextLinkPointer *) HcdBusPtr(Align32(pNextPointer->Link));
 			}
 		}
 	}
@@ -256,7 +341,7 @@ HCD_STATUS HcdCancelTransfer(uint32_t PipeHandle)
 
 		/*-- Foreach Qtd in Qhd --*/ /*---------- Deactivate all queued TDs ----------*/
 		while ( isValidLink(TdLink) ) {
-			PHCD_QTD pQtd = (PHCD_QTD) Align32(TdLink);
+			PHCD_QTD pQtd = (PHCD_QTD) HcdBusPtr(Align32(TdLink));
 			TdLink = pQtd->NextQtd;
 
 			pQtd->Active = 0;
@@ -267,6 +352,7 @@ HCD_STATUS HcdCancelTransfer(uint32_t PipeHandle)
 	}
 
 	EnableSchedule(HostID, (XferType == INTERRUPT_TRANSFER) || (XferType == ISOCHRONOUS_TRANSFER) ? 1 : 0);
+	HAL_EnableUSBInterrupt(HostID);
 	return HCD_STATUS_OK;
 }
 
@@ -304,14 +390,14 @@ HCD_STATUS HcdControlTransfer(uint32_t PipeHandle,
 	ASSERT_STATUS_OK(AllocQTD(HostID, &StatusTdIdx, NULL, 0, direction ? OUT_TRANSFER : IN_TRANSFER, 1, 1) );	/* Status TD: Direction=opposite of data direction - DataToggle=11b (always DATA1) */
 
 	/* Hook TDs Together */
-	HcdQTD(HostID, SetupTdIdx)->NextQtd = (uint32_t) HcdQTD(HostID, DataTdIdx);
-	HcdQTD(HostID, DataTdIdx)->NextQtd = (uint32_t) HcdQTD(HostID, StatusTdIdx);
+	HcdQTD(HostID, SetupTdIdx)->NextQtd = HcdBusAddr(HcdQTD(HostID, DataTdIdx));
+	HcdQTD(HostID, DataTdIdx)->NextQtd = HcdBusAddr(HcdQTD(HostID, StatusTdIdx));
 
 	HcdQHD(HostID, QhdIdx)->status = (uint32_t) HCD_STATUS_TRANSFER_QUEUED;
 
 	/* Hook TDs to QHD */
-	HcdQHD(HostID, QhdIdx)->FirstQtd = Align32( (uint32_t) HcdQTD(HostID, SetupTdIdx) );
-	HcdQHD(HostID, QhdIdx)->Overlay.NextQtd = (uint32_t) HcdQTD(HostID, SetupTdIdx);
+	HcdQHD(HostID, QhdIdx)->FirstQtd = Align32( HcdBusAddr(HcdQTD(HostID, SetupTdIdx)) );
+	HcdQHD(HostID, QhdIdx)->Overlay.NextQtd = HcdBusAddr(HcdQTD(HostID, SetupTdIdx));
 
 	/* wait for semaphore compete TDs */
 	ASSERT_STATUS_OK(WaitForTransferComplete(HostID, QhdIdx) );
@@ -337,20 +423,26 @@ HCD_STATUS HcdDataTransfer(uint32_t PipeHandle,
 
 	ExpectedLength = (length != HCD_ENDPOINT_MAXPACKET_XFER_LEN) ? length : HcdQHD(HostID, HeadIdx)->MaxPackageSize;
 
+	if ((XferType == ISOCHRONOUS_TRANSFER) && IsoStreaming[HostID][HeadIdx].Callback) {
+		ASSERT_STATUS_OK_MESSAGE(HCD_STATUS_PARAMETER_INVALID, "Pipe is streaming, call HcdIsoStreamStop() first");
+	}
+
 	HcdQHD(HostID, HeadIdx)->status = (uint32_t) HCD_STATUS_TRANSFER_QUEUED;
 
 	if (XferType == ISOCHRONOUS_TRANSFER) {
+		uint32_t FrameIdx = NextPeriodicFrame(HostID, HeadIdx, (USB_REG(HostID)->FRINDEX_H >> 3) + HCD_ISO_SCHEDULE_SLOP);
+
 		if ( HcdQHD(HostID, HeadIdx)->EndpointSpeed == HIGH_SPEED ) {	/*-- Highspeed ISO --*/
-			ASSERT_STATUS_OK(QueueITDs(HostID, HeadIdx, buffer, ExpectedLength) );
+			ASSERT_STATUS_OK(QueueITDs(HostID, HeadIdx, buffer, ExpectedLength, 0, &FrameIdx) );
 		}
 		else {	/*-- Full/Low Speed ISO --*/
-			ASSERT_STATUS_OK(QueueSITDs(HostID, HeadIdx, buffer, ExpectedLength) );
+			ASSERT_STATUS_OK(QueueSITDs(HostID, HeadIdx, buffer, ExpectedLength, 0, &FrameIdx) );
 		}
 	}
 	else {	/*-- Control / Bulk / Interrupt --*/
 		if(XferType == BULK_TRANSFER)
 		{
-			ASSERT_STATUS_OK( QueueQTDs(HostID, &DataTdIdx, buffer, ExpectedLength,
+			ASSERT_STATUS_OK( QueueQTDs(HostID, HeadIdx, &DataTdIdx, buffer, ExpectedLength,
 									HcdQHD(HostID,HeadIdx)->Direction ? IN_TRANSFER : OUT_TRANSFER, 0) );
 		}
 		else
@@ -359,8 +451,8 @@ HCD_STATUS HcdDataTransfer(uint32_t PipeHandle,
 								  HcdQHD(HostID, HeadIdx)->Direction ? IN_TRANSFER : OUT_TRANSFER, 0, 1) );
 		}
 		/*---------- Hook to Queue Head ----------*/
-		HcdQHD(HostID, HeadIdx)->FirstQtd = Align32( (uint32_t) HcdQTD(HostID, DataTdIdx) );	/* used as TD head to clean up TD chain when transfer done */
-		HcdQHD(HostID, HeadIdx)->Overlay.NextQtd = (uint32_t) HcdQTD(HostID, DataTdIdx);
+		HcdQHD(HostID, HeadIdx)->FirstQtd = Align32( HcdBusAddr(HcdQTD(HostID, DataTdIdx)) );	/* used as TD head to clean up TD chain when transfer done */
+		HcdQHD(HostID, HeadIdx)->Overlay.NextQtd = HcdBusAddr(HcdQTD(HostID, DataTdIdx));
 	}
 
 	HcdQHD(HostID, HeadIdx)->pActualTransferCount = pActualTransferred;	/* TODO Actual Length get rid of this */
@@ -430,8 +522,8 @@ static HCD_STATUS AllocQhd(uint8_t HostID,
 		   *pQhdIdx)->ControlEndpointFlag = (DeviceSpeed != HIGH_SPEED && TransferType == CONTROL_TRANSFER) ? 1 : 0;
 	HcdQHD(HostID, *pQhdIdx)->NakCountReload = 0;	/* infinite NAK/NYET */
 
-	/*-- Currently All interrupt endpoints will be served as 1 (micro)frame polling, thus Interval parameter is ignored --*/
-	/*-- For High Speed Interval should be used to compute the uFrameSMask --*/
+	/*-- High speed interrupt endpoints get the microframes booked by ReservePeriodicBandwidth(), the frames
+	     they are polled in come from where LinkPeriodicQhd() hooks them into the frame list --*/
 	HcdQHD(HostID,
 		   *pQhdIdx)->uFrameSMask =
 		(TransferType == INTERRUPT_TRANSFER) ? (DeviceSpeed == HIGH_SPEED ? 0xFF : 0x01) : 0;
@@ -455,21 +547,30 @@ static HCD_STATUS AllocQhd(uint8_t HostID,
 static HCD_STATUS InsertLinkPointer(NextLinkPointer *pList, NextLinkPointer *pNew, uint8_t type)
 {
 	pNew->Link = pList->Link;
-	pList->Link = Align32( (uint32_t) pNew);
+	pList->Link = Align32( HcdBusAddr(pNew));
 	pList->Type = type;
 	return HCD_STATUS_OK;
 }
 
 static HCD_STATUS RemoveQueueHead(uint8_t HostID, uint8_t QhdIdx)
 {
-	PHCD_QHD pQhd = IsInterruptQhd(HostID, QhdIdx) ? HcdIntHead(HostID) : HcdAsyncHead(HostID);
+	PHCD_QHD pQhd = HcdAsyncHead(HostID);
+
+	if (IsInterruptQhd(HostID, QhdIdx)) {
+		DisablePeriodSchedule(HostID);
+		UnlinkPeriodicQhd(HostID, QhdIdx);
+		EnablePeriodSchedule(HostID);
+		HcdQHD(HostID, QhdIdx)->status = (uint32_t) HCD_STATUS_TO_BE_REMOVED;	/* Will be remove in AsyncAdvanceIsr - make use of IAAD */
+		return HCD_STATUS_OK;
+	}
+
 	/*-- Foreach Qhd in async list --*/
 	while ( isValidLink(pQhd->Horizontal.Link) &&
-			Align32(pQhd->Horizontal.Link) != (uint32_t) HcdQHD(HostID, QhdIdx) &&
-			Align32(pQhd->Horizontal.Link) != (uint32_t) HcdAsyncHead(HostID) ) {
-		pQhd = (PHCD_QHD) Align32(pQhd->Horizontal.Link);
+			Align32(pQhd->Horizontal.Link) != HcdBusAddr(HcdQHD(HostID, QhdIdx)) &&
+			Align32(pQhd->Horizontal.Link) != HcdBusAddr(HcdAsyncHead(HostID)) ) {
+		pQhd = (PHCD_QHD) HcdBusPtr(Align32(pQhd->Horizontal.Link));
 	}
-	if (  Align32(pQhd->Horizontal.Link) != (uint32_t) HcdQHD(HostID, QhdIdx) ) {
+	if (  Align32(pQhd->Horizontal.Link) != HcdBusAddr(HcdQHD(HostID, QhdIdx)) ) {
 		return HCD_STATUS_PARAMETER_INVALID;
 	}
 
@@ -514,8 +615,8 @@ static HCD_STATUS AllocQTD(uint8_t HostID,
 		HcdQTD(HostID, *pTdIdx)->DataToggle = DataToggle;
 		HcdQTD(HostID, *pTdIdx)->IntOnComplete = IOC;
 
-		HcdQTD(HostID, *pTdIdx)->BufferPointer[0] = (uint32_t) BufferPointer;
-		BytesInPage = 0x1000 - Offset4k((uint32_t) BufferPointer);
+		HcdQTD(HostID, *pTdIdx)->BufferPointer[0] = HcdBusAddr(BufferPointer);
+		BytesInPage = 0x1000 - Offset4k(HcdBusAddr(BufferPointer));
 		xferLen -= MIN(xferLen, BytesInPage);	/*-- Trim down xferlen to be multiple of 4k --*/
 
 		for (idx = 1; idx <= 4 && xferLen > 0; idx++) {
@@ -531,6 +632,7 @@ static HCD_STATUS AllocQTD(uint8_t HostID,
 }
 
 static HCD_STATUS QueueQTDs (uint8_t HostID,
+							 uint8_t QhdIdx,
 							 uint32_t* pTdIdx,
 							 uint8_t* dataBuff,
 							 uint32_t xferLen,
@@ -538,14 +640,15 @@ static HCD_STATUS QueueQTDs (uint8_t HostID,
 							 uint8_t DataToggle)
 {
 	uint32_t TailTdIdx=0xFFFFFFFF;
+	Pipe_Stream_Handle_T *pStream = &PipeStreaming[HostID][QhdIdx];
 
 	while (xferLen > 0)
 	{
 		uint32_t TdLen;
-		uint32_t MaxTDLen = QTD_MAX_XFER_LENGTH - Offset4k((uint32_t)dataBuff);
+		uint32_t MaxTDLen = QTD_MAX_XFER_LENGTH - Offset4k(HcdBusAddr(dataBuff));
 
-		if(PipeStreaming[HostID].PacketSize > 0)
-			TdLen = MIN(xferLen, PipeStreaming[HostID].PacketSize);
+		if(pStream->PacketSize > 0)
+			TdLen = MIN(xferLen, pStream->PacketSize);
 		else
 			TdLen = MIN(xferLen, MaxTDLen);
 		xferLen -= TdLen;
@@ -560,15 +663,15 @@ static HCD_STATUS QueueQTDs (uint8_t HostID,
 			uint32_t NewTdIDx;
 			if(HCD_STATUS_OK == AllocQTD(HostID, &NewTdIDx, dataBuff, TdLen, PIDCode, DataToggle, (xferLen==0) ? 1 : 0))
 			{
-				HcdQTD(HostID,TailTdIdx)->NextQtd = Align32((uint32_t) HcdQTD(HostID,NewTdIDx));
+				HcdQTD(HostID,TailTdIdx)->NextQtd = Align32(HcdBusAddr(HcdQTD(HostID,NewTdIDx)));
 				TailTdIdx = NewTdIDx;
 			}
 			else
 			{
-				PipeStreaming[HostID].BufferAddress = (uint32_t)dataBuff;
-				PipeStreaming[HostID].RemainBytes = xferLen + TdLen;
-				PipeStreaming[HostID].DataToggle = DataToggle;
-				HcdQTD(HostID,HCD_MAX_QTD - 1)->IntOnComplete = 1;
+				pStream->BufferAddress = HcdBusAddr(dataBuff);
+				pStream->RemainBytes = xferLen + TdLen;
+				pStream->DataToggle = DataToggle;
+				HcdQTD(HostID,TailTdIdx)->IntOnComplete = 1;	/* resume from RemoveCompletedQTD() */
 				break;
 			}
 		}
@@ -578,7 +681,7 @@ static HCD_STATUS QueueQTDs (uint8_t HostID,
 	}
 	if(xferLen == 0)
 	{
-		memset(&PipeStreaming[HostID], 0, sizeof(Pipe_Stream_Handle_T));
+		memset(pStream, 0, sizeof(Pipe_Stream_Handle_T));
 	}
 	return HCD_STATUS_OK;
 }
@@ -594,43 +697,54 @@ HCD_STATUS AllocHsItd(uint8_t HostID,
 					  uint8_t IhdIdx,
 					  uint8_t *dataBuff,
 					  uint32_t TDLen,
-					  uint8_t XactPerITD,
+					  uint8_t BufferIdx,
 					  uint8_t IntOnComplete)
 {
 	for ((*pTdIdx) = 0; (*pTdIdx) < HCD_MAX_HS_ITD && HcdHsITD(HostID, *pTdIdx)->inUse; (*pTdIdx)++) {}
 	if ((*pTdIdx) < HCD_MAX_HS_ITD) {
-		uint8_t i;
-		uint8_t XactStep = 8 / XactPerITD;
+		PHCD_HS_ITD pItd = HcdHsITD(HostID, *pTdIdx);
+		uint8_t uFrameMask = PeriodicSchedule[HostID][IhdIdx].uFrameMask;
 		uint32_t MaxXactLen = HcdQHD(HostID, IhdIdx)->MaxPackageSize * HcdQHD(HostID, IhdIdx)->Mult;
+		uint32_t BasePage = Align4k( HcdBusAddr(dataBuff));
+		uint8_t i;
 
-		memset(HcdHsITD(HostID, *pTdIdx), 0, sizeof(HCD_HS_ITD));
+		memset(pItd, 0, sizeof(HCD_HS_ITD));
 
-		HcdHsITD(HostID, *pTdIdx)->inUse = 1;
-		HcdHsITD(HostID, *pTdIdx)->IhdIdx = IhdIdx;
+		pItd->inUse = 1;
+		pItd->IhdIdx = IhdIdx;
+		pItd->BufferIdx = BufferIdx;
+
+		pItd->Horizontal.Link = LINK_TERMINATE;
+		for (i = 0; TDLen > 0 && i < 8; i++) {
+			uint32_t XactLen;
+			uint32_t Page;
+
+			if (!(uFrameMask & (1 << i))) {	/*-- microframe not booked for this endpoint --*/
+				continue;
+			}
 
-		HcdHsITD(HostID, *pTdIdx)->Horizontal.Link = LINK_TERMINATE;
-		for (i = 0; TDLen > 0 && i < 8; i += XactStep) {
-			uint32_t XactLen = MIN(TDLen, MaxXactLen);
+			XactLen = MIN(TDLen, MaxXactLen);
 			TDLen -= XactLen;
 
-			HcdHsITD(HostID, *pTdIdx)->BufferPointer[i] = Align4k( (uint32_t) dataBuff);
+			/*-- Pages are shared by all transactions, a transaction may run into the following page --*/
+			Page = (Align4k( HcdBusAddr(dataBuff)) - BasePage) >> 12;
+			pItd->BufferPointer[Page] = Align4k( HcdBusAddr(dataBuff));
+			if (Page < 6) {
+				pItd->BufferPointer[Page + 1] = Align4k( HcdBusAddr(dataBuff)) + 0x1000;
+			}
 
-			HcdHsITD(HostID, *pTdIdx)->Transaction[i].Offset = ( (uint32_t) dataBuff ) & 4095;
-			HcdHsITD(HostID, *pTdIdx)->Transaction[i].PageSelect = i;
-			HcdHsITD(HostID, *pTdIdx)->Transaction[i].IntOnComplete = (IntOnComplete && TDLen == 0) ? 1 : 0;
-			HcdHsITD(HostID, *pTdIdx)->Transaction[i].Length = XactLen;
-			HcdHsITD(HostID, *pTdIdx)->Transaction[i].Active = 1;
+			pItd->Transaction[i].Offset = Offset4k( HcdBusAddr(dataBuff));
+			pItd->Transaction[i].PageSelect = Page;
+			pItd->Transaction[i].IntOnComplete = (IntOnComplete && TDLen == 0) ? 1 : 0;
+			pItd->Transaction[i].Length = XactLen;
+			pItd->Transaction[i].Active = 1;
 
 			dataBuff += XactLen;
 		}
 
-		HcdHsITD(HostID, *pTdIdx)->BufferPointer[0] |= (HcdQHD(HostID, IhdIdx)->EndpointNumber << 8) | HcdQHD(HostID,
-																											  IhdIdx)->
-													   DeviceAddress;
-		HcdHsITD(HostID,
-				 *pTdIdx)->BufferPointer[1] |=
-			(HcdQHD(HostID, IhdIdx)->Direction << 1) | HcdQHD(HostID, IhdIdx)->MaxPackageSize;
-		HcdHsITD(HostID, *pTdIdx)->BufferPointer[2] |= HcdQHD(HostID, IhdIdx)->Mult;
+		pItd->BufferPointer[0] |= (HcdQHD(HostID, IhdIdx)->EndpointNumber << 8) | HcdQHD(HostID, IhdIdx)->DeviceAddress;
+		pItd->BufferPointer[1] |= (HcdQHD(HostID, IhdIdx)->Direction << 11) | HcdQHD(HostID, IhdIdx)->MaxPackageSize;
+		pItd->BufferPointer[2] |= HcdQHD(HostID, IhdIdx)->Mult;
 
 		return HCD_STATUS_OK;
 	}
@@ -639,34 +753,29 @@ HCD_STATUS AllocHsItd(uint8_t HostID,
 	}
 }
 
-static HCD_STATUS QueueITDs(uint8_t HostID, uint8_t IhdIdx, uint8_t *dataBuff, uint32_t xferLen)
+static HCD_STATUS QueueITDs(uint8_t HostID,
+							uint8_t IhdIdx,
+							uint8_t *dataBuff,
+							uint32_t xferLen,
+							uint8_t BufferIdx,
+							uint32_t *pFrameIdx)
 {
-	uint32_t MaxTDLen;
-	uint32_t FrameIdx;
-
-#if 0	/* Maximum bandwidth (Interval = 1) regardless of Interval value */
-	uint8_t XactPerITD;
-	uint32_t FramePeriod;
-	if (HcdQHD(IhdIdx)->Interval < 4) {	/*-- Period < 8 --*/
-		XactPerITD = 1 << ( 4 - HcdQHD(IhdIdx)->Interval );		/*-- Interval 1 => 8, 2 => 4, 3 => 2 --*/
-		FramePeriod = 1;
-	}
-	else {
-		XactPerITD = 1;
-		FramePeriod = 1 << ( HcdQHD(IhdIdx)->Interval - 4 );	/*-- Frame step 4 => 1, 5 => 2, 6 => 3 --*/
+	Iso_Stream_Handle_T *pIso = &IsoStreaming[HostID][IhdIdx];
+	Periodic_Schedule_T *pSched = &PeriodicSchedule[HostID][IhdIdx];
+	uint32_t ListSize = EHCI_FRAME_LIST_SIZE(HostID);
+	uint32_t MaxTDLen = 0;
+	uint8_t i;
+
+	for (i = 0; i < 8; i++) {	/*-- one transaction per booked microframe --*/
+		if (pSched->uFrameMask & (1 << i)) {
+			MaxTDLen += HcdQHD(HostID, IhdIdx)->MaxPackageSize * HcdQHD(HostID, IhdIdx)->Mult;
+		}
 	}
-#else
-	#define XactPerITD      8
-	#define FramePeriod     1
-#endif
 
-	MaxTDLen = XactPerITD * HcdQHD(HostID, IhdIdx)->MaxPackageSize * HcdQHD(HostID, IhdIdx)->Mult;
-	FrameIdx = USB_REG(HostID)->FRINDEX_H >> 3;
-
-	if (xferLen > MaxTDLen * FRAME_LIST_SIZE) {	/*-- Data length overflow the Period FRAME LIST  --*/
+	if (xferLen > MaxTDLen * (ListSize / pSched->FramePeriod)) {	/*-- Data length overflow the Period FRAME LIST  --*/
 		ASSERT_STATUS_OK_MESSAGE(
 			HCD_STATUS_DATA_OVERFLOW,
-			"ISO data length overflows the Period Frame List size, Please increase size by FRAMELIST_SIZE_BITS or reduce data length");
+			"ISO data length overflows the Period Frame List size, Please increase the frame list size or reduce data length");
 	}
 
 	while (xferLen > 0) {
@@ -676,11 +785,16 @@ static HCD_STATUS QueueITDs(uint8_t HostID, uint8_t IhdIdx, uint8_t *dataBuff, u
 		TDLen = MIN(xferLen, MaxTDLen);
 		xferLen -= TDLen;
 
-		ASSERT_STATUS_OK(AllocHsItd(HostID, &TdIdx, IhdIdx, dataBuff, TDLen, XactPerITD, xferLen ? 0 : 1) );
+		ASSERT_STATUS_OK(AllocHsItd(HostID, &TdIdx, IhdIdx, dataBuff, TDLen, BufferIdx, xferLen ? 0 : 1) );
 
-		FrameIdx = (FrameIdx + FramePeriod) % FRAME_LIST_SIZE;
 		/*-- Hook ITD to Period List Base --*/
-		InsertLinkPointer(&EHCI_FRAME_LIST(HostID)[FrameIdx], &HcdHsITD(HostID, TdIdx)->Horizontal, ITD_TYPE);
+		*pFrameIdx %= ListSize;
+		InsertLinkPointer(&EHCI_FRAME_LIST(HostID)[*pFrameIdx], &HcdHsITD(HostID, TdIdx)->Horizontal, ITD_TYPE);
+		*pFrameIdx = (*pFrameIdx + pSched->FramePeriod) % ListSize;
+
+		if (xferLen == 0) {
+			pIso->LastTd[BufferIdx] = HcdHsITD(HostID, TdIdx);
+		}
 		dataBuff += TDLen;
 	}
 
@@ -698,6 +812,7 @@ static HCD_STATUS AllocSItd(uint8_t HostID,
 							uint8_t HeadIdx,
 							uint8_t *dataBuff,
 							uint32_t TDLen,
+							uint8_t BufferIdx,
 							uint8_t IntOnComplete)
 {
 #define TCount_Pos 0
@@ -712,6 +827,7 @@ static HCD_STATUS AllocSItd(uint8_t HostID,
 
 		HcdSITD(HostID, *pTdIdx)->inUse = 1;
 		HcdSITD(HostID, *pTdIdx)->IhdIdx = HeadIdx;
+		HcdSITD(HostID, *pTdIdx)->BufferIdx = BufferIdx;
 
 		/*-- Word 1 --*/
 		HcdSITD(HostID, *pTdIdx)->Horizontal.Link = LINK_TERMINATE;
@@ -722,16 +838,22 @@ static HCD_STATUS AllocSItd(uint8_t HostID,
 		HcdSITD(HostID, *pTdIdx)->PortNumber = HcdQHD(HostID, HeadIdx)->PortNumber;
 		HcdSITD(HostID, *pTdIdx)->Direction = HcdQHD(HostID, HeadIdx)->Direction;
 		/*-- Word 3 --*/
-		HcdSITD(HostID, *pTdIdx)->uFrameSMask = (1 << TCount) - 1;
-		HcdSITD(HostID, *pTdIdx)->uFrameCMask = 0;
+		if (HcdQHD(HostID, HeadIdx)->Direction) {	/*-- IN: one Start Split, Complete Splits from uFrame2 on --*/
+			HcdSITD(HostID, *pTdIdx)->uFrameSMask = 0x01;
+			HcdSITD(HostID, *pTdIdx)->uFrameCMask = ((1 << MIN(TCount + 1, 6)) - 1) << 2;
+		}
+		else {	/*-- OUT: one Start Split per 188 bytes --*/
+			HcdSITD(HostID, *pTdIdx)->uFrameSMask = (1 << TCount) - 1;
+			HcdSITD(HostID, *pTdIdx)->uFrameCMask = 0;
+		}
 		/*-- Word 4 --*/
 		HcdSITD(HostID, *pTdIdx)->Active = 1;
 		HcdSITD(HostID, *pTdIdx)->TotalBytesToTransfer = TDLen;
 		HcdSITD(HostID, *pTdIdx)->IntOnComplete = IntOnComplete;
 		/*-- Word 5 --*/
-		HcdSITD(HostID, *pTdIdx)->BufferPointer[0] = (uint32_t) dataBuff;
+		HcdSITD(HostID, *pTdIdx)->BufferPointer[0] = HcdBusAddr(dataBuff);
 		/*-- Word 6 --*/
-		HcdSITD(HostID, *pTdIdx)->BufferPointer[1] = Align4k( ((uint32_t) dataBuff) + TDLen);
+		HcdSITD(HostID, *pTdIdx)->BufferPointer[1] = Align4k( HcdBusAddr(dataBuff) + TDLen);
 
 		HcdSITD(HostID, *pTdIdx)->BufferPointer[1] |= TCount << TCount_Pos;
 		HcdSITD(HostID, *pTdIdx)->BufferPointer[1] |= (TCount > 1 ? 1 : 0 ) << TPos_Pos;/*-- TPosition - More than 1 split --> Begin Encoding, Otherwise All Encoding  --*/
@@ -749,30 +871,23 @@ static HCD_STATUS AllocSItd(uint8_t HostID,
 	}
 }
 
-static HCD_STATUS QueueSITDs(uint8_t HostID, uint8_t HeadIdx, uint8_t *dataBuff, uint32_t xferLen)
+static HCD_STATUS QueueSITDs(uint8_t HostID,
+							 uint8_t HeadIdx,
+							 uint8_t *dataBuff,
+							 uint32_t xferLen,
+							 uint8_t BufferIdx,
+							 uint32_t *pFrameIdx)
 {
-	uint32_t FrameIdx;
+	Iso_Stream_Handle_T *pIso = &IsoStreaming[HostID][HeadIdx];
+	Periodic_Schedule_T *pSched = &PeriodicSchedule[HostID][HeadIdx];
+	uint32_t ListSize = EHCI_FRAME_LIST_SIZE(HostID);
 
-#if 0	/* Maximum bandwidth (Interval = 1) regardless of Interval value */
-	uint8_t XactPerITD;
-	uint32_t FramePeriod;
-	if (HcdQHD(IhdIdx)->Interval < 4) {	/*-- Period < 8 --*/
-		FramePeriod = 1;
-	}
-	else {
-		FramePeriod = 1 << ( HcdQHD(IhdIdx)->Interval - 4 );	/*-- Frame step 4 => 1, 5 => 2, 6 => 3 --*/
-	}
-#else
-	#define FramePeriod     1
-#endif
-
-	if (xferLen > HcdQHD(HostID, HeadIdx)->MaxPackageSize * FRAME_LIST_SIZE) {	/*-- Data length overflow the Period FRAME LIST  --*/
+	if (xferLen > HcdQHD(HostID, HeadIdx)->MaxPackageSize * (ListSize / pSched->FramePeriod)) {	/*-- Data length overflow the Period FRAME LIST  --*/
 		ASSERT_STATUS_OK_MESSAGE(
 			HCD_STATUS_DATA_OVERFLOW,
-			"ISO data length overflows the Period Frame List size, Please increase size by FRAMELIST_SIZE_BITS or reduce data length");
+			"ISO data length overflows the Period Frame List size, Please increase the frame list size or reduce data length");
 	}
 
-	FrameIdx = USB_REG(HostID)->FRINDEX_H >> 3;
 	while (xferLen) {
 		uint32_t TdIdx;
 		uint32_t TDLen;
@@ -780,16 +895,301 @@ static HCD_STATUS QueueSITDs(uint8_t HostID, uint8_t HeadIdx, uint8_t *dataBuff,
 		TDLen = MIN(xferLen, HcdQHD(HostID, HeadIdx)->MaxPackageSize);
 		xferLen -= TDLen;
 
-		ASSERT_STATUS_OK(AllocSItd(HostID, &TdIdx, HeadIdx, dataBuff, TDLen, xferLen ? 0 : 1) );
+		ASSERT_STATUS_OK(AllocSItd(HostID, &TdIdx, HeadIdx, dataBuff, TDLen, BufferIdx, xferLen ? 0 : 1) );
 
-		FrameIdx = (FrameIdx + FramePeriod) % FRAME_LIST_SIZE;
 		/*-- Hook SITD to Period List Base --*/
-		InsertLinkPointer(&EHCI_FRAME_LIST(HostID)[FrameIdx], &HcdSITD(HostID, TdIdx)->Horizontal, SITD_TYPE);
+		*pFrameIdx %= ListSize;
+		InsertLinkPointer(&EHCI_FRAME_LIST(HostID)[*pFrameIdx], &HcdSITD(HostID, TdIdx)->Horizontal, SITD_TYPE);
+		*pFrameIdx = (*pFrameIdx + pSched->FramePeriod) % ListSize;
+
+		if (xferLen == 0) {
+			pIso->LastTd[BufferIdx] = HcdSITD(HostID, TdIdx);
+		}
 		dataBuff += TDLen;
 	}
 	return HCD_STATUS_OK;
 }
 
+/*---------- Periodic Schedule Planner ----------*/
+/*-- Book an interrupt or ISO pipe: try every frame phase (and microframe for high speed), keep the placement
+     whose busiest slot over the booked window is the least loaded, refuse the pipe if that slot would overflow --*/
+static HCD_STATUS ReservePeriodicBandwidth(uint8_t HostID, uint8_t HeadIdx, uint8_t Interval)
+{
+	Periodic_Schedule_T *pSched = &PeriodicSchedule[HostID][HeadIdx];
+	PHCD_QHD pQhd = HcdQHD(HostID, HeadIdx);
+	uint32_t Window = MIN(EHCI_FRAME_LIST_SIZE(HostID), HCD_BANDWIDTH_FRAMES);
+	bool HighSpeed = (pQhd->EndpointSpeed == HIGH_SPEED);
+	uint32_t uFramePeriod, BookPeriod, uPhases;
+	uint32_t Phase, uPhase, Frame, i;
+	uint32_t Peak, BestPeak = 0xFFFFFFFF, BestPhase = 0;
+	uint8_t Mask, BestMask = 0;
+
+	memset(pSched, 0, sizeof(Periodic_Schedule_T));
+	Interval = MAX(Interval, 1);
+
+	if (HighSpeed) {	/*-- bInterval: 2^(n-1) microframes --*/
+		uFramePeriod = 1 << (MIN(Interval, 16) - 1);
+		pSched->Bandwidth = pQhd->MaxPackageSize * pQhd->Mult;
+	}
+	else {
+		if (IsInterruptQhd(HostID, HeadIdx)) {	/*-- bInterval frames, polled at the power of 2 not above it --*/
+			for (uFramePeriod = 8; uFramePeriod * 2 <= Interval * 8; uFramePeriod <<= 1) {}
+		}
+		else {	/*-- ISO bInterval: 2^(n-1) frames --*/
+			uFramePeriod = 8 << (MIN(Interval, 16) - 1);
+		}
+		pSched->Bandwidth = pQhd->MaxPackageSize * (pQhd->EndpointSpeed == LOW_SPEED ? 8 : 1);
+	}
+	pSched->FramePeriod = MIN(MAX(uFramePeriod >> 3, 1), EHCI_FRAME_LIST_SIZE(HostID));
+	BookPeriod = MIN(pSched->FramePeriod, Window);
+	uPhases = HighSpeed ? MIN(uFramePeriod, 8) : 1;
+
+	for (Phase = 0; Phase < BookPeriod; Phase++) {
+		for (uPhase = 0; uPhase < uPhases; uPhase++) {
+			Mask = 0;
+			for (i = uPhase; i < 8; i += uPhases) {
+				Mask |= (1 << i);
+			}
+
+			Peak = 0;
+			for (Frame = Phase; Frame < Window; Frame += BookPeriod) {
+				if (HighSpeed) {
+					for (i = 0; i < 8; i++) {
+						if (Mask & (1 << i)) {
+							Peak = MAX(Peak, uFrameLoad[HostID][Frame][i]);
+						}
+					}
+				}
+				else {	/*-- split transactions: budget is the full speed frame behind the transaction translator --*/
+					Peak = MAX(Peak, FsFrameLoad[HostID][Frame]);
+				}
+			}
+
+			if (Peak < BestPeak) {
+				BestPeak = Peak;
+				BestPhase = Phase;
+				BestMask = Mask;
+			}
+		}
+	}
+
+	if (BestPeak + pSched->Bandwidth > (HighSpeed ? HCD_HS_UFRAME_BUDGET : HCD_FS_FRAME_BUDGET)) {
+		return HCD_STATUS_NOT_ENOUGH_BANDWIDTH;
+	}
+
+	pSched->FramePhase = BestPhase;
+	pSched->uFrameMask = HighSpeed ? BestMask : 0;
+	pSched->Interval = Interval;
+	for (Frame = BestPhase; Frame < Window; Frame += BookPeriod) {
+		if (HighSpeed) {
+			for (i = 0; i < 8; i++) {
+				if (BestMask & (1 << i)) {
+					uFrameLoad[HostID][Frame][i] += pSched->Bandwidth;
+				}
+			}
+		}
+		else {
+			FsFrameLoad[HostID][Frame] += pSched->Bandwidth;
+		}
+	}
+
+	if (HighSpeed && IsInterruptQhd(HostID, HeadIdx)) {
+		pQhd->uFrameSMask = BestMask;
+	}
+	return HCD_STATUS_OK;
+}
+
+static void ReleasePeriodicBandwidth(uint8_t HostID, uint8_t HeadIdx)
+{
+	Periodic_Schedule_T *pSched = &PeriodicSchedule[HostID][HeadIdx];
+	uint32_t Window = MIN(EHCI_FRAME_LIST_SIZE(HostID), HCD_BANDWIDTH_FRAMES);
+	uint32_t BookPeriod, Frame, i;
+
+	if (pSched->Interval == 0) {	/*-- control/bulk pipe, nothing booked --*/
+		return;
+	}
+
+	BookPeriod = MIN(pSched->FramePeriod, Window);
+	for (Frame = pSched->FramePhase; Frame < Window; Frame += BookPeriod) {
+		if (HcdQHD(HostID, HeadIdx)->EndpointSpeed == HIGH_SPEED) {
+			for (i = 0; i < 8; i++) {
+				if (pSched->uFrameMask & (1 << i)) {
+					uFrameLoad[HostID][Frame][i] -= pSched->Bandwidth;
+				}
+			}
+		}
+		else {
+			FsFrameLoad[HostID][Frame] -= pSched->Bandwidth;
+		}
+	}
+	memset(pSched, 0, sizeof(Periodic_Schedule_T));
+}
+
+/*-- Hook an interrupt Qhd into every frame of its phase. A frame lists its ISO TDs first, then Qhds from the
+     longest period to the shortest and ends at the static 1ms Qhd. Frames sharing a Qhd then share everything
+     behind it, so its single Horizontal link serves all of them and the frame list forms a tree --*/
+static void LinkPeriodicQhd(uint8_t HostID, uint8_t HeadIdx)
+{
+	Periodic_Schedule_T *pSched = &PeriodicSchedule[HostID][HeadIdx];
+	PHCD_QHD pQhd = HcdQHD(HostID, HeadIdx);
+	uint32_t Frame;
+
+	for (Frame = pSched->FramePhase; Frame < EHCI_FRAME_LIST_SIZE(HostID); Frame += pSched->FramePeriod) {
+		NextLinkPointer *pPrev = &EHCI_FRAME_LIST(HostID)[Frame];
+
+		while ( isValidLink(pPrev->Link) && Align32(pPrev->Link) != HcdBusAddr(pQhd) ) {
+			if (pPrev->Type == QHD_TYPE) {
+				PHCD_QHD pNext = (PHCD_QHD) HcdBusPtr(Align32(pPrev->Link));
+
+				if ((pNext == HcdIntHead(HostID)) ||
+					(PeriodicSchedule[HostID][pNext - HcdQHD(HostID, 0)].FramePeriod <= pSched->FramePeriod)) {
+					break;
+				}
+			}
+			pPrev = (NextLinkPointer *) HcdBusPtr(Align32(pPrev->Link));
+		}
+
+		if (Align32(pPrev->Link) != HcdBusAddr(pQhd)) {	/*-- not already reached through an earlier frame --*/
+			InsertLinkPointer(pPrev, &pQhd->Horizontal, QHD_TYPE);
+		}
+	}
+}
+
+static void UnlinkPeriodicQhd(uint8_t HostID, uint8_t HeadIdx)
+{
+	Periodic_Schedule_T *pSched = &PeriodicSchedule[HostID][HeadIdx];
+	PHCD_QHD pQhd = HcdQHD(HostID, HeadIdx);
+	uint32_t Frame;
+
+	for (Frame = pSched->FramePhase; Frame < EHCI_FRAME_LIST_SIZE(HostID); Frame += pSched->FramePeriod) {
+		NextLinkPointer *pPrev = &EHCI_FRAME_LIST(HostID)[Frame];
+
+		while ( isValidLink(pPrev->Link) && Align32(pPrev->Link) != HcdBusAddr(pQhd) ) {
+			pPrev = (NextLinkPointer *) HcdBusPtr(Align32(pPrev->Link));
+		}
+		if (isValidLink(pPrev->Link)) {	/*-- frames sharing the predecessor are already unlinked --*/
+			pPrev->Link = pQhd->Horizontal.Link;
+		}
+	}
+}
+
+/*---------- ISO Streaming ----------*/
+static HCD_STATUS QueueIsoBuffer(uint8_t HostID, uint8_t HeadIdx, uint8_t BufferIdx)
+{
+	Iso_Stream_Handle_T *pIso = &IsoStreaming[HostID][HeadIdx];
+	uint32_t FrameIdx = pIso->NextFrame;
+	uint8_t Other = BufferIdx ^ 1;
+
+	/*-- Nothing left in flight (first buffer or an underrun): restart just ahead of the controller,
+	     otherwise continue right behind the other buffer so the stream has no gap --*/
+	if (!(pIso->Pending & (1 << Other)) || !IsIsoBufferActive(HostID, HeadIdx, Other)) {
+		FrameIdx = NextPeriodicFrame(HostID, HeadIdx, (USB_REG(HostID)->FRINDEX_H >> 3) + HCD_ISO_SCHEDULE_SLOP);
+	}
+	pIso->StartFrame[BufferIdx] = FrameIdx;
+
+	if (HcdQHD(HostID, HeadIdx)->EndpointSpeed == HIGH_SPEED) {
+		ASSERT_STATUS_OK(QueueITDs(HostID, HeadIdx, pIso->Buffer[BufferIdx], pIso->Length, BufferIdx, &FrameIdx) );
+	}
+	else {
+		ASSERT_STATUS_OK(QueueSITDs(HostID, HeadIdx, pIso->Buffer[BufferIdx], pIso->Length, BufferIdx, &FrameIdx) );
+	}
+
+	pIso->NextFrame = FrameIdx;
+	pIso->Pending |= (1 << BufferIdx);
+	return HCD_STATUS_OK;
+}
+
+/*-- Unlink the TDs of a finished buffer, pack the IN data and hand the buffer to the application --*/
+static void CompleteIsoBuffer(uint8_t HostID, uint8_t HeadIdx, uint8_t BufferIdx)
+{
+	Iso_Stream_Handle_T *pIso = &IsoStreaming[HostID][HeadIdx];
+	Periodic_Schedule_T *pSched = &PeriodicSchedule[HostID][HeadIdx];
+	PHCD_QHD pQhd = HcdQHD(HostID, HeadIdx);
+	uint32_t MaxXactLen = pQhd->MaxPackageSize * pQhd->Mult;
+	uint8_t *pSlot = pIso->Buffer[BufferIdx];		/* where the controller was told to put the packet */
+	uint8_t *pPacked = pIso->Buffer[BufferIdx];		/* where the packet ends up after packing */
+	uint32_t Remain = pIso->Length;
+	uint32_t FrameIdx = pIso->StartFrame[BufferIdx];
+	uint32_t PipeHandle;
+	uint32_t n;
+
+	for (n = 0; n < pIso->FramesPerBuffer; n++) {
+		NextLinkPointer *pNextPointer = &EHCI_FRAME_LIST(HostID)[FrameIdx];
+
+		/*-- Foreach Itd/SItd in the link--*/
+		while ( isValidLink(pNextPointer->Link) && pNextPointer->Type != QHD_TYPE ) {
+			if (pNextPointer->Type == ITD_TYPE) {	/*-- Highspeed ISO --*/
+				PHCD_HS_ITD pItd = (PHCD_HS_ITD) HcdBusPtr(Align32(pNextPointer->Link));
+
+				if ((pItd->IhdIdx == HeadIdx) && (pItd->BufferIdx == BufferIdx)) {
+					uint8_t i;
+
+					for (i = 0; i < 8 && Remain; i++) {
+						if (pSched->uFrameMask & (1 << i)) {
+							uint32_t XactLen = MIN(Remain, MaxXactLen);
+							uint32_t Actual = XactLen;
+
+							if (pQhd->Direction) {	/*-- IN: controller wrote back the received length --*/
+								Actual = (pItd->Transaction[i].Error || pItd->Transaction[i].Babble ||
+										  pItd->Transaction[i].BufferError) ? 0 : MIN(pItd->Transaction[i].Length, XactLen);
+								if (pPacked != pSlot) {
+									memmove(pPacked, pSlot, Actual);
+								}
+							}
+							pPacked += Actual;
+							pSlot += XactLen;
+							Remain -= XactLen;
+						}
+					}
+					pNextPointer->Link = pItd->Horizontal.Link;
+					FreeHsItd(pItd);
+					break;
+				}
+			}
+			else if (pNextPointer->Type == SITD_TYPE) {	/*-- Split ISO --*/
+				PHCD_SITD pSItd = (PHCD_SITD) HcdBusPtr(Align32(pNextPointer->Link));
+
+				if ((pSItd->IhdIdx == HeadIdx) && (pSItd->BufferIdx == BufferIdx)) {
+					uint32_t XactLen = MIN(Remain, pQhd->MaxPackageSize);
+					uint32_t Actual = XactLen;
+
+					if (pQhd->Direction) {	/*-- IN: TotalBytesToTransfer counts down what was not received --*/
+						Actual = (pSItd->ERR || pSItd->Babble || pSItd->BufferError || pSItd->TransactionError) ?
+								 0 : XactLen - MIN(pSItd->TotalBytesToTransfer, XactLen);
+						if (pPacked != pSlot) {
+							memmove(pPacked, pSlot, Actual);
+						}
+					}
+					pPacked += Actual;
+					pSlot += XactLen;
+					Remain -= XactLen;
+
+					pNextPointer->Link = pSItd->Horizontal.Link;
+					FreeSItd(pSItd);
+					break;
+				}
+			}
+			pNextPointer = (NextLinkPointer *) HcdBusPtr(Align32(pNextPointer->Link));
+		}
+		FrameIdx = (FrameIdx + pSched->FramePeriod) % EHCI_FRAME_LIST_SIZE(HostID);
+	}
+	pIso->Pending &= ~(1 << BufferIdx);
+
+	PipehandleCreate(&PipeHandle, HostID, ISOCHRONOUS_TRANSFER, HeadIdx);
+	pIso->Buffer[BufferIdx] = pIso->Callback(PipeHandle, pIso->Buffer[BufferIdx],
+											 (uint32_t) (pPacked - pIso->Buffer[BufferIdx]));
+
+	/*-- Callback may have stopped the stream or declined to give another buffer --*/
+	if (pIso->Callback && pIso->Buffer[BufferIdx] &&
+		(QueueIsoBuffer(HostID, HeadIdx, BufferIdx) == HCD_STATUS_OK)) {
+		return;
+	}
+	if (!pIso->Pending) {	/*-- stream has drained --*/
+		pIso->Callback = NULL;
+		pQhd->status = HCD_STATUS_OK;
+	}
+}
+
 static HCD_STATUS WaitForTransferComplete(uint8_t HostID, uint8_t EdIdx)/* TODO indentical to OHCI now */
 {
 
@@ -886,6 +1286,31 @@ static __INLINE bool IsInterruptQhd(uint8_t HostID, uint8_t QhdIdx)
 	return HcdQHD(HostID, QhdIdx)->uFrameSMask;
 }
 
+static __INLINE uint32_t NextPeriodicFrame(uint8_t HostID, uint8_t HeadIdx, uint32_t FrameIdx)
+{
+	Periodic_Schedule_T *pSched = &PeriodicSchedule[HostID][HeadIdx];
+
+	/*-- First frame at or after FrameIdx that the planner booked for this pipe --*/
+	FrameIdx += (pSched->FramePhase - FrameIdx) & (pSched->FramePeriod - 1);
+	return FrameIdx % EHCI_FRAME_LIST_SIZE(HostID);
+}
+
+static __INLINE bool IsIsoBufferActive(uint8_t HostID, uint8_t HeadIdx, uint8_t BufferIdx)
+{
+	if (HcdQHD(HostID, HeadIdx)->EndpointSpeed == HIGH_SPEED) {
+		PHCD_HS_ITD pItd = (PHCD_HS_ITD) IsoStreaming[HostID][HeadIdx].LastTd[BufferIdx];
+		uint8_t i;
+
+		for (i = 0; i < 8; i++) {
+			if (pItd->Transaction[i].Active) {
+				return true;
+			}
+		}
+		return false;
+	}
+	return ((PHCD_SITD) IsoStreaming[HostID][HeadIdx].LastTd[BufferIdx])->Active;
+}
+
 void    HcdIrqHandler(uint8_t HostID)
 {
 	uint32_t IntStatus;
@@ -941,9 +1366,10 @@ static void RemoveCompletedQTD(uint8_t HostID, PHCD_QHD pQhd)
 	PHCD_QTD pQtd;
 	uint32_t TdLink = pQhd->FirstQtd;
 	bool is_data_remain = false;
+	uint8_t QhdIdx = (uint8_t) (pQhd - HcdQHD(HostID, 0));
 
 	/*-- Foreach Qtd in Qhd --*/
-	while( (isValidLink(TdLink), pQtd = (PHCD_QTD) Align32(TdLink) ) &&
+	while( (isValidLink(TdLink), pQtd = (PHCD_QTD) HcdBusPtr(Align32(TdLink)) ) &&
 			pQtd->Active == 0)
 	{
 		TdLink = pQtd->NextQtd;
@@ -953,7 +1379,7 @@ static void RemoveCompletedQTD(uint8_t HostID, PHCD_QHD pQhd)
 
 		if (pQtd->IntOnComplete)
 		{
-			if(PipeStreaming[HostID].RemainBytes > 0)
+			if(PipeStreaming[HostID][QhdIdx].RemainBytes > 0)
 				is_data_remain = true;
 			else
 				pQhd->status = HCD_STATUS_OK;
@@ -968,12 +1394,12 @@ static void RemoveCompletedQTD(uint8_t HostID, PHCD_QHD pQhd)
 	if(is_data_remain)
 	{
 		uint32_t pQtd;
-		QueueQTDs(HostID, &pQtd,(uint8_t*)PipeStreaming[HostID].BufferAddress,
-				PipeStreaming[HostID].RemainBytes,
+		QueueQTDs(HostID, QhdIdx, &pQtd,(uint8_t *) HcdBusPtr(PipeStreaming[HostID][QhdIdx].BufferAddress),
+				PipeStreaming[HostID][QhdIdx].RemainBytes,
 				pQhd->Direction ? IN_TRANSFER : OUT_TRANSFER,
-				PipeStreaming[HostID].DataToggle);
-		pQhd->FirstQtd = Align32( (uint32_t) HcdQTD(HostID,pQtd) );
-		pQhd->Overlay.NextQtd = (uint32_t) HcdQTD(HostID,pQtd);
+				PipeStreaming[HostID][QhdIdx].DataToggle);
+		pQhd->FirstQtd = Align32( HcdBusAddr(HcdQTD(HostID,pQtd)) );
+		pQhd->Overlay.NextQtd = HcdBusAddr(HcdQTD(HostID,pQtd));
 	}	
 }
 
@@ -984,7 +1410,7 @@ static void RemoveErrorQTD(PHCD_QHD pQhd)
 	bool errorfound = false;
 
 	/*-- Scan error Qtd in Qhd --*/
-	while ( (isValidLink(TdLink), pQtd = (PHCD_QTD) Align32(TdLink) ) &&
+	while ( (isValidLink(TdLink), pQtd = (PHCD_QTD) HcdBusPtr(Align32(TdLink)) ) &&
 			pQtd->Active == 0) {
 		TdLink = pQtd->NextQtd;
 
@@ -997,7 +1423,7 @@ static void RemoveErrorQTD(PHCD_QHD pQhd)
 	if (errorfound) {
 		TdLink = pQhd->FirstQtd;
 		while (isValidLink(TdLink)) {
-			pQtd = (PHCD_QTD) Align32(TdLink);
+			pQtd = (PHCD_QTD) HcdBusPtr(Align32(TdLink));
 			TdLink = pQtd->NextQtd;
 			pQtd->Active = 0;
 			pQtd->IntOnComplete = 0;
@@ -1015,8 +1441,8 @@ static void AsyncScheduleIsr(uint8_t HostID)
 
 	/*-- Foreach Qhd in async list --*/
 	while ( isValidLink(pQhd->Horizontal.Link) &&
-			Align32(pQhd->Horizontal.Link) != (uint32_t) HcdAsyncHead(HostID) ) {
-		pQhd = (PHCD_QHD) Align32(pQhd->Horizontal.Link);
+			Align32(pQhd->Horizontal.Link) != HcdBusAddr(HcdAsyncHead(HostID)) ) {
+		pQhd = (PHCD_QHD) HcdBusPtr(Align32(pQhd->Horizontal.Link));
 		RemoveCompletedQTD(HostID,pQhd);
 	}
 }
@@ -1026,15 +1452,16 @@ static void PeriodScheduleIsr(uint8_t HostID)
 	uint32_t i;
 
 	/*ISOCHRONOUS*/
-	for (i = 0; i < FRAME_LIST_SIZE; i++) {	/*-- Foreach link in Period List Base --*/
+	for (i = 0; i < EHCI_FRAME_LIST_SIZE(HostID); i++) {	/*-- Foreach link in Period List Base --*/
 		NextLinkPointer *pNextPointer = &EHCI_FRAME_LIST(HostID)[i];
 
 		/*-- Foreach Itd/SItd in the link--*/
 		while ( isValidLink(pNextPointer->Link) && pNextPointer->Type != QHD_TYPE ) {
 			if (pNextPointer->Type == ITD_TYPE) {	/*-- Highspeed ISO --*/
-				PHCD_HS_ITD pItd = (PHCD_HS_ITD) Align32(pNextPointer->Link);
+				PHCD_HS_ITD pItd = (PHCD_HS_ITD) HcdBusPtr(Align32(pNextPointer->Link));
 
-				if ((pItd->Transaction[0].Active == 0) && (pItd->Transaction[1].Active == 0) &&
+				if ((IsoStreaming[HostID][pItd->IhdIdx].Callback == NULL) &&	/*-- stream TDs are retired by IsoStreamIsr() --*/
+					(pItd->Transaction[0].Active == 0) && (pItd->Transaction[1].Active == 0) &&
 					( pItd->Transaction[2].Active == 0) && ( pItd->Transaction[3].Active == 0) &&
 					( pItd->Transaction[4].Active == 0) && ( pItd->Transaction[5].Active == 0) &&
 					( pItd->Transaction[6].Active == 0) && ( pItd->Transaction[7].Active == 0) ) {
@@ -1052,9 +1479,9 @@ static void PeriodScheduleIsr(uint8_t HostID)
 				}
 			}
 			else if (pNextPointer->Type == SITD_TYPE) {	/*-- Split ISO --*/
-				PHCD_SITD pSItd = (PHCD_SITD) Align32(pNextPointer->Link);
+				PHCD_SITD pSItd = (PHCD_SITD) HcdBusPtr(Align32(pNextPointer->Link));
 
-				if (pSItd->Active == 0) {
+				if ((IsoStreaming[HostID][pSItd->IhdIdx].Callback == NULL) && (pSItd->Active == 0)) {
 					if (pSItd->IntOnComplete) {
 						/*-- request complete, signal on Iso Head --*/
 						HcdQHD(HostID, pSItd->IhdIdx)->status = HCD_STATUS_OK;
@@ -1067,18 +1494,35 @@ static void PeriodScheduleIsr(uint8_t HostID)
 				}
 			}
 
-			pNextPointer = (NextLinkPointer *) Align32(pNextPointer->Link);
+			pNextPointer = (NextLinkPointer *) HcdBusPtr(Align32(pNextPointer->Link));
 		}
 	}
+	IsoStreamIsr(HostID);
 
 	/*INTERRUPT*/
-	{
-		PHCD_QHD pQhd = HcdIntHead(HostID);
+	/*-- Queue heads sit in several frames of the tree, visit each once by index --*/
+	for (i = 0; i < HCD_MAX_QHD; i++) {
+		if (HcdQHD(HostID, i)->inUse && IsInterruptQhd(HostID, i) &&
+			(HcdQHD(HostID, i)->status != HCD_STATUS_TO_BE_REMOVED)) {
+			RemoveCompletedQTD(HostID, HcdQHD(HostID, i));
+		}
+	}
+}
+
+static void IsoStreamIsr(uint8_t HostID)
+{
+	uint8_t HeadIdx;
+
+	for (HeadIdx = 0; HeadIdx < HCD_MAX_QHD; HeadIdx++) {
+		Iso_Stream_Handle_T *pIso = &IsoStreaming[HostID][HeadIdx];
 
-		/*-- Foreach Qhd in list --*/
-		while ( isValidLink(pQhd->Horizontal.Link) ) {
-			pQhd = (PHCD_QHD) Align32(pQhd->Horizontal.Link);
-			RemoveCompletedQTD(HostID,pQhd);
+		/*-- Buffers complete in the order they were queued, both may be done if the interrupt was late --*/
+		while (pIso->Callback && (pIso->Pending & (1 << pIso->Oldest)) &&
+			   !IsIsoBufferActive(HostID, HeadIdx, pIso->Oldest)) {
+			uint8_t BufferIdx = pIso->Oldest;
+
+			pIso->Oldest ^= 1;
+			CompleteIsoBuffer(HostID, HeadIdx, BufferIdx);
 		}
 	}
 }
@@ -1089,8 +1533,8 @@ static void UsbErrorIsr(uint8_t HostID)
 
 	/*-- Foreach Qhd in async list --*/
 	while ( isValidLink(pQhd->Horizontal.Link) &&
-			Align32(pQhd->Horizontal.Link) != (uint32_t) HcdAsyncHead(HostID) ) {
-		pQhd = (PHCD_QHD) Align32(pQhd->Horizontal.Link);
+			Align32(pQhd->Horizontal.Link) != HcdBusAddr(HcdAsyncHead(HostID)) ) {
+		pQhd = (PHCD_QHD) HcdBusPtr(Align32(pQhd->Horizontal.Link));
 		RemoveErrorQTD(pQhd);
 	}
 }
@@ -1147,6 +1591,7 @@ static __INLINE HCD_STATUS EHciHostReset(uint8_t HostID)
 static __INLINE HCD_STATUS EHciHostInit(uint8_t HostID)
 {
 	uint32_t idx;
+	uint32_t SizeBits;
 
 	/*---------- Host Data Structure Init ----------*/
 	//	memset(&ehci_data[HostID], 0, sizeof(EHCI_HOST_DATA_T) );
@@ -1161,14 +1606,14 @@ static __INLINE HCD_STATUS EHciHostInit(uint8_t HostID)
 
 	/*---------- Asynchronous List ----------*/
 	/*-- Static Head Qhd with Halted/inactive --*/
-	HcdAsyncHead(HostID)->Horizontal.Link = Align32( (uint32_t) HcdAsyncHead(HostID) );
+	HcdAsyncHead(HostID)->Horizontal.Link = Align32( HcdBusAddr(HcdAsyncHead(HostID)) );
 	HcdAsyncHead(HostID)->Horizontal.Type = QHD_TYPE;
 	HcdAsyncHead(HostID)->HeadReclamationFlag = 1;
 	HcdAsyncHead(HostID)->Overlay.NextQtd = LINK_TERMINATE;		/* Terminate Links */
 	HcdAsyncHead(HostID)->Overlay.AlterNextQtd = LINK_TERMINATE;	/* Terminate Links */
 	HcdAsyncHead(HostID)->Overlay.Halted = 1;
 
-	USB_REG(HostID)->ASYNCLISTADDR = (uint32_t) HcdAsyncHead(HostID);
+	USB_REG(HostID)->ASYNCLISTADDR = HcdBusAddr(HcdAsyncHead(HostID));
 
 	/*---------- Periodic List ----------*/
 	/*-- Static Interrupt Qhd (1 ms) --*/
@@ -1178,16 +1623,22 @@ static __INLINE HCD_STATUS EHciHostInit(uint8_t HostID)
 	HcdIntHead(HostID)->Overlay.Halted = 1;
 	HcdIntHead(HostID)->uFrameSMask = 1;
 
-	for (idx = 0; idx < FRAME_LIST_SIZE; idx++) {			/* Attach 1 ms Interrupt Qhd to Period Frame List */
-		EHCI_FRAME_LIST(HostID)[idx].Link = Align32( (uint32_t) HcdIntHead(HostID) );
+	/*-- Every frame ends at the static Qhd, interrupt Qhds are linked in front of it by LinkPeriodicQhd() --*/
+	for (idx = 0; idx < EHCI_FRAME_LIST_SIZE(HostID); idx++) {			/* Attach 1 ms Interrupt Qhd to Period Frame List */
+		EHCI_FRAME_LIST(HostID)[idx].Link = Align32( HcdBusAddr(HcdIntHead(HostID)) );
 		EHCI_FRAME_LIST(HostID)[idx].Type = QHD_TYPE;
 	}
 
-	USB_REG(HostID)->PERIODICLISTBASE = Align4k( (uint32_t) EHCI_FRAME_LIST(HostID) );
+	USB_REG(HostID)->PERIODICLISTBASE = Align4k( HcdBusAddr(EHCI_FRAME_LIST(HostID)) );
+
+	memset(uFrameLoad[HostID], 0, sizeof(uFrameLoad[HostID]));
+	memset(FsFrameLoad[HostID], 0, sizeof(FsFrameLoad[HostID]));
+	memset(PeriodicSchedule[HostID], 0, sizeof(PeriodicSchedule[HostID]));
 
 	/*---------- USBCMD ----------*/
+	SizeBits = FRAMELIST_SIZE_BITS + FrameListShrink[HostID];
 	USB_REG(HostID)->USBCMD_H =    EHC_USBCMD_AsynScheduleEnable |
-								 ((FRAMELIST_SIZE_BITS % 4) << 2) | ((FRAMELIST_SIZE_BITS / 4) << 15);
+								 ((SizeBits % 4) << 2) | ((SizeBits / 4) << 15);
 
 	/*---------- CONFIGFLAG ----------*/
 	/* LPC18xx doesn't has CONFIGFLAG register */
@@ -1247,9 +1698,100 @@ void HcdSetStreamPacketSize(uint32_t PipeHandle, uint16_t packetsize)
 	uint8_t HostID = 0, HeadIdx;
 	HCD_TRANSFER_TYPE XferType;
 
-	PipehandleParse(PipeHandle, &HostID, &XferType, &HeadIdx);
+	if (PipehandleParse(PipeHandle, &HostID, &XferType, &HeadIdx) != HCD_STATUS_OK) {
+		return;
+	}
+
+	PipeStreaming[HostID][HeadIdx].PacketSize = packetsize;
+}
+
+HCD_STATUS HcdIsoStreamStart(uint32_t PipeHandle,
+							 uint8_t *const buffer0,
+							 uint8_t *const buffer1,
+							 uint32_t const length,
+							 HCD_ISO_CALLBACK callback)
+{
+	uint8_t HostID, HeadIdx;
+	HCD_TRANSFER_TYPE XferType;
+	Iso_Stream_Handle_T *pIso;
+	uint32_t MaxTDLen;
+	uint32_t MaxTD;
+	HCD_STATUS status;
+	uint8_t i;
+
+	if ((buffer0 == NULL) || (buffer1 == NULL) || (length == 0) || (callback == NULL)) {
+		ASSERT_STATUS_OK_MESSAGE(HCD_STATUS_PARAMETER_INVALID, "Stream buffers, length and callback are required");
+	}
+
+	ASSERT_STATUS_OK(PipehandleParse(PipeHandle, &HostID, &XferType, &HeadIdx) );
+
+	if (XferType != ISOCHRONOUS_TRANSFER) {
+		ASSERT_STATUS_OK_MESSAGE(HCD_STATUS_TRANSFER_TYPE_NOT_SUPPORTED, "Only isochronous pipes can stream");
+	}
+
+	pIso = &IsoStreaming[HostID][HeadIdx];
+	if (pIso->Callback || (HcdQHD(HostID, HeadIdx)->status == HCD_STATUS_TRANSFER_QUEUED)) {
+		ASSERT_STATUS_OK_MESSAGE(HCD_STATUS_PARAMETER_INVALID, "Pipe is busy");
+	}
+
+	if (HcdQHD(HostID, HeadIdx)->EndpointSpeed == HIGH_SPEED) {
+		MaxTD = HCD_MAX_HS_ITD;
+		MaxTDLen = 0;
+		for (i = 0; i < 8; i++) {
+			if (PeriodicSchedule[HostID][HeadIdx].uFrameMask & (1 << i)) {
+				MaxTDLen += HcdQHD(HostID, HeadIdx)->MaxPackageSize * HcdQHD(HostID, HeadIdx)->Mult;
+			}
+		}
+	}
+	else {
+		MaxTD = HCD_MAX_SITD;
+		MaxTDLen = HcdQHD(HostID, HeadIdx)->MaxPackageSize;
+	}
+
+	/*-- Both buffers must be in the frame list at once, with some room ahead of the controller --*/
+	pIso->FramesPerBuffer = (length + MaxTDLen - 1) / MaxTDLen;
+	if ((2 * pIso->FramesPerBuffer * PeriodicSchedule[HostID][HeadIdx].FramePeriod + HCD_ISO_SCHEDULE_SLOP) >
+		EHCI_FRAME_LIST_SIZE(HostID)) {
+		ASSERT_STATUS_OK_MESSAGE(HCD_STATUS_DATA_OVERFLOW,
+								 "ISO stream buffers overflow half the Period Frame List, reduce length or increase the list size");
+	}
+	if ((2 * pIso->FramesPerBuffer) > MaxTD) {
+		ASSERT_STATUS_OK_MESSAGE(HCD_STATUS_NOT_ENOUGH_ITD, "Not enough ITD/SITD for two stream buffers of this length");
+	}
+
+	pIso->Length = length;
+	pIso->Buffer[0] = buffer0;
+	pIso->Buffer[1] = buffer1;
+	pIso->Pending = 0;
+	pIso->Oldest = 0;
+	pIso->Callback = callback;
+	HcdQHD(HostID, HeadIdx)->status = (uint32_t) HCD_STATUS_TRANSFER_QUEUED;
+
+	/*-- The first buffer can complete and be requeued by IsoStreamIsr() before the second one is linked --*/
+	HAL_DisableUSBInterrupt(HostID);
+	status = QueueIsoBuffer(HostID, HeadIdx, 0);
+	if (status == HCD_STATUS_OK) {
+		status = QueueIsoBuffer(HostID, HeadIdx, 1);
+	}
+	HAL_EnableUSBInterrupt(HostID);
+
+	if (status != HCD_STATUS_OK) {
+		HcdIsoStreamStop(PipeHandle);
+		ASSERT_STATUS_OK_MESSAGE(HCD_STATUS_NOT_ENOUGH_ITD, "Failed to queue ISO stream buffers");
+	}
+	return HCD_STATUS_OK;
+}
+
+HCD_STATUS HcdIsoStreamStop(uint32_t PipeHandle)
+{
+	uint8_t HostID, HeadIdx;
+	HCD_TRANSFER_TYPE XferType;
+
+	ASSERT_STATUS_OK(PipehandleParse(PipeHandle, &HostID, &XferType, &HeadIdx) );
+	ASSERT_STATUS_OK(HcdCancelTransfer(PipeHandle) );	/*-- also clears the stream --*/
 
-	PipeStreaming[HostID].PacketSize = packetsize;
+	HcdQHD(HostID, HeadIdx)->status = HCD_STATUS_OK;
+	return HCD_STATUS_OK;
 }
 
 #endif // __LPC_EHCI__
@@ -50,11 +50,24 @@
 #define HCD_MAX_QHD					HCD_MAX_ENDPOINT		/* USBD_USB_HC_EHCI */
 //#define	HCD_MAX_QTD					(HCD_MAX_ENDPOINT+3)	/* USBD_USB_HC_EHCI */
 #define	HCD_MAX_QTD					8						/* USBD_USB_HC_EHCI */
-#define	HCD_MAX_HS_ITD				4						/* USBD_USB_HC_EHCI */
-#define HCD_MAX_SITD				16						/* USBD_USB_HC_EHCI */
+#ifndef HCD_MAX_HS_ITD
+#define	HCD_MAX_HS_ITD				16						/* USBD_USB_HC_EHCI: 2 x 8 frames of double-buffered HS ISO */
+#endif
+#ifndef HCD_MAX_SITD
+#define HCD_MAX_SITD				32						/* USBD_USB_HC_EHCI: 2 x 16 frames of double-buffered FS ISO */
+#endif
+
+#define HCD_HS_UFRAME_BUDGET		6000		/* Bytes of periodic payload allowed per microframe (80% of 7500) */
+#define HCD_FS_FRAME_BUDGET			1157		/* Bytes of periodic payload allowed per full speed frame behind the TT */
+#define HCD_ISO_SCHEDULE_SLOP		2			/* Frames ahead of FRINDEX a (re)started ISO stream is scheduled */
 
-#define FRAMELIST_SIZE_BITS         5			/* (0:1024) - (1:512) - (2:256) - (3:128) - (4:64) - (5:32) - (6:16) - (7:8) */
+#ifndef FRAMELIST_SIZE_BITS
+#define FRAMELIST_SIZE_BITS         5			/* Largest list: (0:1024) - (1:512) - (2:256) - (3:128) - (4:64) - (5:32) - (6:16) - (7:8) */
+#endif
 #define FRAME_LIST_SIZE             (1024 >> FRAMELIST_SIZE_BITS)
+#ifndef HCD_BANDWIDTH_FRAMES
+#define HCD_BANDWIDTH_FRAMES        32			/* Frames the periodic planner books, longer periods are booked as this one */
+#endif
 
 /**********************/
 /* USBCMD Register */
@@ -300,7 +313,8 @@ typedef struct st_EHCD_ITD {
 	/*---------- HCD Area ----------*/
 	uint32_t inUse;
 	uint32_t IhdIdx;
-	uint32_t reserved[6];
+	uint32_t BufferIdx;		/* stream buffer this ITD belongs to */
+	uint32_t reserved[5];
 } ATTR_ALIGNED (32) HCD_HS_ITD, *PHCD_HS_ITD;
 
 typedef struct st_EHCD_SITD {
@@ -360,7 +374,8 @@ typedef struct st_EHCD_SITD {
 	/*-- HCD ARERA 4 bytes --*/
 	uint8_t inUse;
 	uint8_t IhdIdx;
-	uint8_t reserved2[2];
+	uint8_t BufferIdx;		/* stream buffer this SITD belongs to */
+	uint8_t reserved2;
 } ATTR_ALIGNED (32) HCD_SITD, *PHCD_SITD;
 
 typedef struct st_EHCI_HOST_DATA {
@@ -393,14 +408,39 @@ typedef struct st_PipeStreamHandle {
 	uint8_t  DataToggle;
 } Pipe_Stream_Handle_T;
 
+typedef struct st_PeriodicSchedule {
+	uint16_t FramePeriod;		/* frames between two services of the pipe, power of 2 up to the frame list size */
+	uint16_t FramePhase;		/* first frame list index serving the pipe, less than FramePeriod */
+	uint16_t Bandwidth;			/* bytes booked in each served (micro)frame, low speed counts 8 times */
+	uint8_t  uFrameMask;		/* microframes booked inside a served frame (HS only) */
+	uint8_t  Interval;			/* bInterval the schedule was planned for, 0 when nothing is booked */
+} Periodic_Schedule_T;
+
+typedef struct st_IsoStreamHandle {
+	/*-- Double-buffered stream, Callback is NULL when not streaming --*/
+	uint8_t  Pending;			/* bit n is set while Buffer[n] is queued */
+	uint8_t  Oldest;			/* buffer expected to complete first */
+	uint16_t NextFrame;			/* frame list index the next buffer starts at */
+	uint16_t StartFrame[2];
+	uint16_t FramesPerBuffer;
+	uint32_t Length;
+	uint8_t  *Buffer[2];
+	void     *LastTd[2];		/* TD carrying the IOC of each buffer */
+	HCD_ISO_CALLBACK Callback;
+} Iso_Stream_Handle_T;
+
 /*=======================================================================*/
 /*  LOCAL   S Y M B O L   D E C L A R A T I O N S                        */
 /*=======================================================================*/
 extern EHCI_HOST_DATA_T ehci_data[MAX_USB_CORE];
+extern Iso_Stream_Handle_T IsoStreaming[MAX_USB_CORE][HCD_MAX_QHD];
+extern Periodic_Schedule_T PeriodicSchedule[MAX_USB_CORE][HCD_MAX_QHD];
+extern uint8_t FrameListShrink[MAX_USB_CORE];
 // extern EHCI_HOST_DATA_T ehci_data;
 extern NextLinkPointer      PeriodFrameList0[FRAME_LIST_SIZE];		/* Period Frame List */
 extern NextLinkPointer      PeriodFrameList1[FRAME_LIST_SIZE];		/* Period Frame List */
 #define EHCI_FRAME_LIST(HostID)     ((HostID) ? PeriodFrameList1 : PeriodFrameList0 )
+#define EHCI_FRAME_LIST_SIZE(HostID)    (FRAME_LIST_SIZE >> FrameListShrink[HostID])	/* entries in use, see HcdSetFrameListSize() */
 
 /*=======================================================================*/
 /*  G L O B A L   S Y M B O L   D E C L A R A T I O N S                  */
@@ -457,6 +497,8 @@ static INLINE bool        isValidLink(uint32_t link);
 
 static INLINE bool IsInterruptQhd (uint8_t HostID, uint8_t QhdIdx);
 
+static INLINE bool IsIsoBufferActive(uint8_t HostID, uint8_t HeadIdx, uint8_t BufferIdx);
+
 /********************************* Queue Head & Queue TD *********************************/
 static void FreeQhd(uint8_t HostID, uint8_t QhdIdx);
 
@@ -488,6 +530,7 @@ static HCD_STATUS AllocQTD (uint8_t HostID,
 							uint8_t IOC);
 
 static HCD_STATUS QueueQTDs (uint8_t HostID,
+							 uint8_t QhdIdx,
 							 uint32_t* pTdIdx,
 							 uint8_t* dataBuff,
 							 uint32_t xferLen,
@@ -502,10 +545,15 @@ static HCD_STATUS AllocHsItd(uint8_t HostID,
 							 uint8_t IhdIdx,
 							 uint8_t *dataBuff,
 							 uint32_t TDLen,
-							 uint8_t XactPerITD,
+							 uint8_t BufferIdx,
 							 uint8_t IntOnComplete);
 
-static HCD_STATUS QueueITDs(uint8_t HostID, uint8_t IhdIdx, uint8_t *dataBuff, uint32_t xferLen);
+static HCD_STATUS QueueITDs(uint8_t HostID,
+							uint8_t IhdIdx,
+							uint8_t *dataBuff,
+							uint32_t xferLen,
+							uint8_t BufferIdx,
+							uint32_t *pFrameIdx);
 
 static void FreeSItd(PHCD_SITD pSItd);
 
@@ -514,9 +562,32 @@ static HCD_STATUS AllocSItd(uint8_t HostID,
 							uint8_t HeadIdx,
 							uint8_t *dataBuff,
 							uint32_t TDLen,
+							uint8_t BufferIdx,
 							uint8_t IntOnComplete);
 
-static HCD_STATUS QueueSITDs(uint8_t HostID, uint8_t HeadIdx, uint8_t *dataBuff, uint32_t xferLen);
+static HCD_STATUS QueueSITDs(uint8_t HostID,
+							 uint8_t HeadIdx,
+							 uint8_t *dataBuff,
+							 uint32_t xferLen,
+							 uint8_t BufferIdx,
+							 uint32_t *pFrameIdx);
+
+/********************************* Periodic Schedule Planner *********************************/
+static HCD_STATUS ReservePeriodicBandwidth(uint8_t HostID, uint8_t HeadIdx, uint8_t Interval);
+
+static void ReleasePeriodicBandwidth(uint8_t HostID, uint8_t HeadIdx);
+
+static void LinkPeriodicQhd(uint8_t HostID, uint8_t HeadIdx);
+
+static void UnlinkPeriodicQhd(uint8_t HostID, uint8_t HeadIdx);
+
+static INLINE uint32_t NextPeriodicFrame(uint8_t HostID, uint8_t HeadIdx, uint32_t FrameIdx);
+
+static HCD_STATUS QueueIsoBuffer(uint8_t HostID, uint8_t HeadIdx, uint8_t BufferIdx);
+
+static void CompleteIsoBuffer(uint8_t HostID, uint8_t HeadIdx, uint8_t BufferIdx);
+
+static void IsoStreamIsr(uint8_t HostID);
 
 /********************************* Transfer Routines *********************************/
 static HCD_STATUS WaitForTransferComplete(uint8_t HostID, uint8_t EpIdx);
@@ -148,9 +148,17 @@ typedef enum {
 	HCD_STATUS_TRANSFER_TYPE_NOT_SUPPORTED,	/**< USB transfer set up status: transfer is not supported */
 
 	HCD_STATUS_PIPEHANDLE_INVALID,			/**< USB transfer set up status: pipe handle information is not valid */
-	HCD_STATUS_PARAMETER_INVALID			/**< USB transfer set up status: wrong supply parameters */
+	HCD_STATUS_PARAMETER_INVALID,			/**< USB transfer set up status: wrong supply parameters */
+	HCD_STATUS_NOT_ENOUGH_BANDWIDTH			/**< USB transfer set up status: periodic schedule is fully booked */
 } HCD_STATUS;
 
+/** Completion callback of an isochronous stream started by \ref HcdIsoStreamStart(). It is called from the
+ *  USB interrupt with the buffer that has just been transferred and the number of bytes it holds (IN data is
+ *  packed at the start of the buffer). The returned buffer is queued behind the one still in flight, returning
+ *  the same pointer recycles it and returning NULL stops the stream once the other buffer completes.
+ */
+typedef uint8_t *(*HCD_ISO_CALLBACK)(uint32_t PipeHandle, uint8_t *buffer, uint32_t ActualLength);
+
 /**
  * @brief  Initiate host driver
  *
@@ -167,6 +175,19 @@ HCD_STATUS HcdInitDriver (uint8_t HostID);
  */
 HCD_STATUS HcdDeInitDriver(uint8_t HostID);
 
+/**
+ * @brief  Select the number of entries of the periodic frame list
+ *		   Must be called before the host driver is initiated (USB_Init), the choice is kept across re-init
+ *
+ * The list can only be made shorter than the storage reserved at build time, 1024 >> FRAMELIST_SIZE_BITS
+ * entries on EHCI. A longer list needs a build with a smaller FRAMELIST_SIZE_BITS.
+ *
+ * @param  HostID		: USB port number
+ * @param  Entries		: power of 2 from 8 up to the size the driver was built with
+ * @return \ref HCD_STATUS code, HCD_STATUS_PARAMETER_INVALID for a longer list or while the host driver is up
+ */
+HCD_STATUS HcdSetFrameListSize(uint8_t HostID, uint16_t Entries);
+
 /**
  * @brief  Interrupt service routine for host mode
  * 		   This function must be called in chip's USB interrupt routine
@@ -255,9 +276,20 @@ HCD_STATUS HcdOpenPipe(uint8_t HostID,
  */
 HCD_STATUS HcdClosePipe(uint32_t PipeHandle);
 
+/**
+ * @brief  Re-schedule a periodic pipe with a new polling interval
+ *
+ * @param  PipeHandle	: encoded pipe handle information
+ * @param  Interval		: bInterval of the endpoint descriptor, ignored for control and bulk pipes
+ * @return \ref HCD_STATUS code, the pipe keeps its previous schedule on failure
+ */
+HCD_STATUS HcdSetPipeInterval(uint32_t PipeHandle, uint8_t Interval);
+
 /**
  * @brief  Cancel a processing transfer
  *
+ * The USB interrupt of the host is masked while the schedule is edited and enabled again on return.
+ *
  * @param  PipeHandle	: encoded pipe handle information
  * @return \ref HCD_STATUS code
  */
@@ -314,6 +346,32 @@ HCD_STATUS HcdGetPipeStatus(uint32_t PipeHandle);
  */
 void HcdSetStreamPacketSize(uint32_t PipeHandle, uint16_t packetsize);
 
+/**
+ * @brief  Start a double-buffered isochronous stream on an isochronous pipe
+ *
+ * @param  PipeHandle	: encoded pipe handle information
+ * @param  buffer0		: first buffer, queued immediately
+ * @param  buffer1		: second buffer, queued right behind buffer0
+ * @param  length		: size of each buffer, must fit in half of the period frame list
+ * @param  callback		: called from the interrupt each time a buffer completes
+ * @return \ref HCD_STATUS code
+ */
+HCD_STATUS HcdIsoStreamStart(uint32_t PipeHandle,
+							 uint8_t *const buffer0,
+							 uint8_t *const buffer1,
+							 uint32_t const length,
+							 HCD_ISO_CALLBACK callback);
+
+/**
+ * @brief  Stop an isochronous stream and drop the buffers still queued
+ *
+ * The USB interrupt of the host is masked while the frame list is edited and enabled again on return.
+ *
+ * @param  PipeHandle	: encoded pipe handle information
+ * @return \ref HCD_STATUS code
+ */
+HCD_STATUS HcdIsoStreamStop(uint32_t PipeHandle);
+
 #ifdef LPCUSBlib_DEBUG
 	#define hcd_printf          printf
 void assert_status_ok_message(HCD_STATUS status,
@@ -368,6 +426,36 @@ HCD_STATUS OpenPipe_VerifyParameters(uint8_t HostID,
 									 uint8_t Interval,
 									 uint8_t Mult);
 
+/**
+ * @brief  Address of a descriptor or data buffer as written in the controller's lists and registers
+ *
+ * @param  Ptr			: descriptor or buffer
+ * @return 32-bit bus address
+ */
+static INLINE uint32_t HcdBusAddr(const void *Ptr)
+{
+#if defined(__USB_SIM__)
+	return Sim_BusAddr(Ptr);		/* the off-target host may have 64-bit pointers */
+#else
+	return (uint32_t) Ptr;
+#endif
+}
+
+/**
+ * @brief  Pointer to a descriptor or data buffer found in the controller's lists
+ *
+ * @param  Addr			: 32-bit bus address
+ * @return descriptor or buffer
+ */
+static INLINE void *HcdBusPtr(uint32_t Addr)
+{
+#if defined(__USB_SIM__)
+	return Sim_BusPtr(Addr);
+#else
+	return (void *) Addr;
+#endif
+}
+
 /**
  * @brief  Modify an address to a desired alignment
  *
@@ -118,6 +118,12 @@ HCD_STATUS HcdDeInitDriver(uint8_t HostID)
 	return HCD_STATUS_OK;
 }
 
+HCD_STATUS HcdSetFrameListSize(uint8_t HostID, uint16_t Entries)
+{
+	/*-- HCCA interrupt table is fixed by the OHCI specification --*/
+	return (Entries == 32) ? HCD_STATUS_OK : HCD_STATUS_PARAMETER_INVALID;
+}
+
 HCD_STATUS HcdOpenPipe(uint8_t HostID,
 					   uint8_t DeviceAddr,
 					   HCD_USB_SPEED DeviceSpeed,
@@ -237,6 +243,14 @@ HCD_STATUS HcdClosePipe(uint32_t PipeHandle)
 	return HCD_STATUS_OK;
 }
 
+HCD_STATUS HcdSetPipeInterval(uint32_t PipeHandle, uint8_t Interval)
+{
+	uint8_t HostID, EdIdx;
+
+	/*-- Interrupt EDs are polled every frame regardless of the interval (see HcdOpenPipe) --*/
+	return PipehandleParse(PipeHandle, &HostID, &EdIdx);
+}
+
 HCD_STATUS HcdClearEndpointHalt(uint32_t PipeHandle)
 {
 	uint8_t HostID, EdIdx;
@@ -1062,4 +1076,18 @@ void HcdSetStreamPacketSize(uint32_t PipeHandle, uint16_t packetsize)
 {
 }
 
+HCD_STATUS HcdIsoStreamStart(uint32_t PipeHandle,
+							 uint8_t *const buffer0,
+							 uint8_t *const buffer1,
+							 uint32_t const length,
+							 HCD_ISO_CALLBACK callback)
+{
+	return HCD_STATUS_TRANSFER_TYPE_NOT_SUPPORTED;	/* only implemented for EHCI */
+}
+
+HCD_STATUS HcdIsoStreamStop(uint32_t PipeHandle)
+{
+	return HcdCancelTransfer(PipeHandle);
+}
+
 #endif
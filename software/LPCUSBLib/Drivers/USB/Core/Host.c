@@ -37,6 +37,13 @@
 #define  __INCLUDE_FROM_HOST_C
 #include "Host.h"
 
+/* Milliseconds from a value of HcdGetFrameNumber(): FRINDEX of the EHCI counts 125 us micro-frames */
+#if defined(__LPC_EHCI__)
+#define HOST_FRAME_MS(frame)    ((frame) >> 3)
+#else
+#define HOST_FRAME_MS(frame)    (frame)
+#endif
+
 //static uint8_t CurrentHostID = 0;
 uint8_t USB_Host_ControlPipeSize[MAX_USB_CORE];
 
@@ -50,6 +57,8 @@ void USB_Host_ProcessNextHostState(uint8_t corenum)
 	uint8_t SubErrorCode = HOST_ENUMERROR_NoError;
 
 	static uint16_t WaitMSRemaining;
+	static uint16_t DebounceMSRemaining;
+	static uint16_t SettleFrame;
 	static uint8_t  PostWaitState;
 
 	switch (USB_HostState[corenum]) {
@@ -68,26 +77,44 @@ void USB_Host_ProcessNextHostState(uint8_t corenum)
 		break;
 
 	case HOST_STATE_Powered:
-		WaitMSRemaining = HOST_DEVICE_SETTLE_DELAY_MS;
+		WaitMSRemaining     = HOST_DEVICE_SETTLE_DELAY_MS;
+		DebounceMSRemaining = HOST_DEVICE_DEBOUNCE_MS;
+		SettleFrame         = (uint16_t) HOST_FRAME_MS(HcdGetFrameNumber(corenum));
 
 		USB_HostState[corenum] = HOST_STATE_Powered_WaitForDeviceSettle;
 		break;
 
-	case HOST_STATE_Powered_WaitForDeviceSettle:
-		if (WaitMSRemaining--) {
-			Delay_MS(1);
+	case HOST_STATE_Powered_WaitForDeviceSettle: {
+		/* The port is sampled on every pass of the host task and the milliseconds are counted on the
+		   frame counter: settle ends as soon as the connect status has stayed asserted for the whole
+		   debounce interval, HOST_DEVICE_SETTLE_DELAY_MS is only the upper bound for slow devices */
+		HCD_USB_SPEED DeviceSpeed;
+		uint16_t CurrentFrame = (uint16_t) HOST_FRAME_MS(HcdGetFrameNumber(corenum));
+
+		if (HcdGetDeviceSpeed(corenum, &DeviceSpeed) != HCD_STATUS_OK) {
+			DebounceMSRemaining = HOST_DEVICE_DEBOUNCE_MS;	/* Connect status glitched, restart the interval */
+		}
+		else if ((CurrentFrame != SettleFrame) && DebounceMSRemaining) {
+			DebounceMSRemaining--;
+		}
+		if ((CurrentFrame != SettleFrame) && WaitMSRemaining) {
+			WaitMSRemaining--;
+		}
+		SettleFrame = CurrentFrame;
+
+		if (DebounceMSRemaining && WaitMSRemaining) {
 			break;
 		}
-		else {
-			USB_Host_VBUS_Manual_Off();
 
-			USB_OTGPAD_On();
-			USB_Host_VBUS_Auto_Enable();
-			USB_Host_VBUS_Auto_On();
+		USB_Host_VBUS_Manual_Off();
 
-			USB_HostState[corenum] = HOST_STATE_Powered_WaitForConnect;
-		}
-		break;
+		USB_OTGPAD_On();
+		USB_Host_VBUS_Auto_Enable();
+		USB_Host_VBUS_Auto_On();
+
+		USB_HostState[corenum] = HOST_STATE_Powered_WaitForConnect;
+	}
+	break;
 
 	case HOST_STATE_Powered_WaitForConnect:
 		HOST_TASK_NONBLOCK_WAIT(corenum, 100, HOST_STATE_Powered_DoReset);
@@ -105,7 +132,7 @@ void USB_Host_ProcessNextHostState(uint8_t corenum)
 	case HOST_STATE_Powered_ConfigPipe:
 		if (!Pipe_ConfigurePipe(corenum, PIPE_CONTROLPIPE, EP_TYPE_CONTROL,
 								PIPE_TOKEN_SETUP, ENDPOINT_CONTROLEP,
-								PIPE_CONTROLPIPE_DEFAULT_SIZE, PIPE_BANK_SINGLE) ) {
+								PIPE_CONTROLPIPE_DEFAULT_SIZE, PIPE_BANK_SINGLE, 0) ) {
 			ErrorCode    = HOST_ENUMERROR_PipeConfigError;
 			SubErrorCode = 0;
 			break;
@@ -142,7 +169,7 @@ void USB_Host_ProcessNextHostState(uint8_t corenum)
 	case HOST_STATE_Default_PostReset:
 		if (!Pipe_ConfigurePipe(corenum, PIPE_CONTROLPIPE, EP_TYPE_CONTROL,
 								PIPE_TOKEN_SETUP, ENDPOINT_CONTROLEP,
-								USB_Host_ControlPipeSize[corenum], PIPE_BANK_SINGLE) ) {
+								USB_Host_ControlPipeSize[corenum], PIPE_BANK_SINGLE, 0) ) {
 			ErrorCode    = HOST_ENUMERROR_PipeConfigError;
 			SubErrorCode = 0;
 			break;
@@ -169,7 +196,7 @@ void USB_Host_ProcessNextHostState(uint8_t corenum)
 	case HOST_STATE_Default_PostAddressSet:
 		Pipe_ConfigurePipe(corenum, PIPE_CONTROLPIPE, EP_TYPE_CONTROL,
 						   PIPE_TOKEN_SETUP, ENDPOINT_CONTROLEP,
-						   USB_Host_ControlPipeSize[corenum], PIPE_BANK_SINGLE);
+						   USB_Host_ControlPipeSize[corenum], PIPE_BANK_SINGLE, 0);
 
 		USB_Host_SetDeviceAddress(USB_HOST_DEVICEADDRESS);
 
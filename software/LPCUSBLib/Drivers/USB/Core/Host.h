@@ -139,10 +139,11 @@
 					#endif
 
 					#if !defined(HOST_DEVICE_SETTLE_DELAY_MS) || defined(__DOXYGEN__)
-		/** Constant for the delay in milliseconds after a device is connected before the library
-		 *  will start the enumeration process. Some devices require a delay of up to 5 seconds
-		 *  after connection before the enumeration process can start or incorrect operation will
-		 *  occur.
+		/** Constant for the maximum delay in milliseconds after a device is connected before the library
+		 *  will start the enumeration process. The settle period normally ends earlier, once the port has
+		 *  reported a stable connection for @ref HOST_DEVICE_DEBOUNCE_MS. Some devices require a delay of
+		 *  up to 5 seconds after connection before the enumeration process can start or incorrect operation
+		 *  will occur.
 		 *
 		 *  The default delay value may be overridden in the user project makefile by defining the
 		 *  \c HOST_DEVICE_SETTLE_DELAY_MS token to the required delay in milliseconds, and passed to the
@@ -151,6 +152,18 @@
 						#define HOST_DEVICE_SETTLE_DELAY_MS        1000
 					#endif
 
+					#if !defined(HOST_DEVICE_DEBOUNCE_MS) || defined(__DOXYGEN__)
+		/** Constant for the connection debounce interval in milliseconds (TATTDB in the USB 2.0 specification).
+		 *  The port connect status must stay asserted for this whole period before the device is considered
+		 *  settled; any glitch restarts the interval.
+		 *
+		 *  The default value may be overridden in the user project makefile by defining the
+		 *  \c HOST_DEVICE_DEBOUNCE_MS token to the required delay in milliseconds, and passed to the
+		 *  compiler using the -D switch.
+		 */
+						#define HOST_DEVICE_DEBOUNCE_MS            100
+					#endif
+
 		/** Enum for the error codes for the @ref EVENT_USB_Host_HostError() event.
 		 *
 		 *  @see @ref Group_Events for more information on this event.
@@ -48,7 +48,8 @@ bool Pipe_ConfigurePipe(const uint8_t corenum,
 						const uint8_t Token,
 						const uint8_t EndpointNumber,
 						const uint16_t Size,
-						const uint8_t Banks)
+						const uint8_t Banks,
+						const uint8_t Interval)
 {
 	if ( HCD_STATUS_OK == HcdOpenPipe(corenum,				/* HostID */
 									  (( Type == EP_TYPE_CONTROL) &&
@@ -58,9 +59,9 @@ bool Pipe_ConfigurePipe(const uint8_t corenum,
 									  EndpointNumber,				/* EndpointNo */
 									  (HCD_TRANSFER_TYPE) Type,		/* TransferType */
 									  (HCD_TRANSFER_DIR) Token,		/* TransferDir */
-									  Size,							/* MaxPacketSize */
-									  1,							/* Interval */
-									  1,							/* Mult */
+									  Size & 0x7FF,					/* MaxPacketSize */
+									  Interval ? Interval : 1,		/* Interval: bInterval, 0 for control and bulk pipes */
+									  (Type == EP_TYPE_ISOCHRONOUS) ? ((Size >> 11) & 0x03) + 1 : 1,	/* Mult: HS ISO additional transactions in wMaxPacketSize[12:11] */
 									  0,							/* HSHubDevAddr */
 									  0,							/* HSHubPortNum */
 									  &PipeInfo[corenum][Number].PipeHandle			  /* PipeHandle */)
@@ -69,6 +70,7 @@ bool Pipe_ConfigurePipe(const uint8_t corenum,
 		PipeInfo[corenum][Number].BufferSize = (Type == EP_TYPE_BULK || Type == EP_TYPE_CONTROL) ? PIPE_MAX_SIZE : Size;/* XXX Some devices could have configuration descriptor > 235 bytes (eps speaker, webcame). If not deal with those, not need to have such large pipe size for control */
 		PipeInfo[corenum][Number].Buffer = USB_Memory_Alloc(PipeInfo[corenum][Number].BufferSize,0);
 		PipeInfo[corenum][Number].EndponitAddress = EndpointNumber;
+		pipeselected[corenum] = Number;
 		if (PipeInfo[corenum][Number].Buffer == NULL) {
 			return false;
 		}
@@ -91,6 +93,11 @@ void Pipe_ClosePipe(const uint8_t corenum, uint8_t pipenum)
 	}
 }
 
+bool Pipe_SetInterruptPeriod(const uint8_t corenum, const uint8_t Milliseconds)
+{
+	return HcdSetPipeInterval(PipeInfo[corenum][pipeselected[corenum]].PipeHandle, Milliseconds) == HCD_STATUS_OK;
+}
+
 void Pipe_ClearPipes(void)
 {}
 
@@ -402,18 +402,6 @@
 			return PipeInfo[corenum][pipeselected[corenum]].EndponitAddress;
 		}
 
-		/**
-		 * @brief  Sets the period between interrupts for an INTERRUPT type pipe to a specified number of milliseconds
-		 * @param  Milliseconds : Number of milliseconds between each pipe poll.
-		 * @return Nothing
-		 */
-		static inline void Pipe_SetInterruptPeriod(const uint8_t Milliseconds) ATTR_ALWAYS_INLINE;
-
-		static inline void Pipe_SetInterruptPeriod(const uint8_t Milliseconds)
-		{
-			// TODO implement later
-		}
-
 		/**
 		 * @brief  Returns a mask indicating which pipe's interrupt periods have elapsed, indicating that the pipe should
 		 * be serviced.
@@ -972,6 +960,8 @@
 		 * @param  Banks :           Number of banks to use for the pipe being configured, a \c PIPE_BANK_* mask. More banks
 		 *                          uses more USB DPRAM, but offers better performance. Isochronous type pipes <b>must</b>
 		 *                          have at least two banks.
+		 * @param  Interval :        bInterval of the endpoint descriptor for INTERRUPT and ISOCHRONOUS pipes, the pipe is
+		 *                          placed in the host periodic schedule at this interval. 0 for CONTROL and BULK pipes.
 		 *  @note When the \c ORDERED_EP_CONFIG compile time option is used, Pipes <b>must</b> be configured in ascending order,
 		 *        or bank corruption will occur.
 		 *        \n\n
@@ -995,10 +985,22 @@
 								const uint8_t Token,
 								const uint8_t EndpointNumber,
 								const uint16_t Size,
-								const uint8_t Banks);
+								const uint8_t Banks,
+								const uint8_t Interval);
 
 		void Pipe_ClosePipe(const uint8_t corenum, uint8_t pipenum);
 
+		/**
+		 * @brief  Sets the polling interval of the currently selected INTERRUPT or ISOCHRONOUS pipe, the pipe
+		 *         is moved to the frames and microframes the host periodic schedule finds room for.
+		 * @param  corenum		: USB port number
+		 * @param  Milliseconds : bInterval of the endpoint: milliseconds for full/low speed interrupt pipes,
+		 *                        2^(n-1) (micro)frames for high speed and isochronous pipes.
+		 * @return Boolean \c true if the pipe was rescheduled, \c false if the schedule is too busy (the pipe
+		 *         keeps polling at its previous interval).
+		 */
+		bool Pipe_SetInterruptPeriod(const uint8_t corenum, const uint8_t Milliseconds);
+
 		/**
 		 * @brief  Spin-loops until the currently selected non-control pipe is ready for the next packed of data to be read
 		 *  or written to it, aborting in the case of an error condition (such as a timeout or device disconnect).
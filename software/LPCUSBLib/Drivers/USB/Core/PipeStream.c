@@ -221,4 +221,18 @@ uint8_t Pipe_Streaming(uint8_t corenum, uint8_t* const buffer, uint32_t const tr
 	else return PIPE_RWSTREAM_IncompleteTransfer;
 }
 
+uint8_t Pipe_StartIsoStream(uint8_t corenum, uint8_t* const buffer0, uint8_t* const buffer1, uint32_t const length,
+							HCD_ISO_CALLBACK callback)
+{
+	if (HCD_STATUS_OK == HcdIsoStreamStart(PipeInfo[corenum][pipeselected[corenum]].PipeHandle,
+										   buffer0, buffer1, length, callback))
+		return PIPE_RWSTREAM_NoError;
+	else return PIPE_RWSTREAM_IncompleteTransfer;
+}
+
+void Pipe_StopIsoStream(uint8_t corenum)
+{
+	HcdIsoStreamStop(PipeInfo[corenum][pipeselected[corenum]].PipeHandle);
+}
+
 #endif
@@ -77,6 +77,7 @@
 			};
 
 		#include "USBTask.h"
+		#include "HCD/HCD.h"
 		/* Function Prototypes: */
 		/** \name Stream functions for null data */
 		//@{
@@ -455,6 +456,25 @@
 		 * @return A value from the @ref Pipe_Stream_RW_ErrorCodes_t enum
 		 */
 		 uint8_t Pipe_Streaming(uint8_t corenum, uint8_t* const buffer, uint32_t const transferlength, uint16_t const packetsize);
+
+		/**
+		 * @brief  Start a double-buffered stream on the currently selected isochronous pipe
+		 * @param  corenum :		streaming USB core number
+		 * @param  buffer0 :		First buffer to transfer
+		 * @param  buffer1 :		Second buffer, queued right behind buffer0
+		 * @param  length :			Size in bytes of each buffer
+		 * @param  callback : 		Called from the USB interrupt with each completed buffer, returns the next buffer to queue
+		 * @return A value from the @ref Pipe_Stream_RW_ErrorCodes_t enum
+		 */
+		 uint8_t Pipe_StartIsoStream(uint8_t corenum, uint8_t* const buffer0, uint8_t* const buffer1, uint32_t const length,
+									 HCD_ISO_CALLBACK callback);
+
+		/**
+		 * @brief  Stop the stream of the currently selected isochronous pipe
+		 * @param  corenum :		streaming USB core number
+		 * @return Nothing
+		 */
+		 void Pipe_StopIsoStream(uint8_t corenum);
 		 
 		//@}
 
@@ -77,8 +77,8 @@ typedef struct MemBlockInfo_t {
 
 #define  HEADER_SIZE                (sizeof(sMemBlockInfo))
 #define  HEADER_POINTER(x)          ((uint8_t *)x - sizeof(sMemBlockInfo))
-#define  NEXT_BLOCK(x)            	((PMemBlockInfo) ( ((x)->next==0) ? 0 : ((uint32_t)head +(x)->next) ))
-#define  LINK_TO_THIS_BLOCK(x)      (((uint32_t)(x))-((uint32_t)head))
+#define  NEXT_BLOCK(x)            	((PMemBlockInfo) ( ((x)->next==0) ? 0 : ((uintptr_t)head +(x)->next) ))
+#define  LINK_TO_THIS_BLOCK(x)      (((uintptr_t)(x))-((uintptr_t)head))
 
 PRAGMA_ALIGN_4
 static uint8_t USB_Mem_Buffer[USBRAM_BUFFER_SIZE] ATTR_ALIGNED(4) __BSS(USBRAM_SECTION);
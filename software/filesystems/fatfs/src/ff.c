@@ -133,7 +133,42 @@
 #define LEAVE_FF(fs, res)	return res
 #endif
 
+#if _USE_FREEMAP
+#define	ABORT(fs, res)		{ fp->flag |= FA__ERROR; (fs)->alloc_hint = 0; LEAVE_FF(fs, res); }	/* Drop the run the write wanted */
+#else
 #define	ABORT(fs, res)		{ fp->flag |= FA__ERROR; LEAVE_FF(fs, res); }
+#endif
+
+
+/* Free cluster map */
+#if _USE_FREEMAP
+#if _FS_READONLY
+#error _USE_FREEMAP must be 0 on read-only cfg.
+#endif
+#define FREEMAP_TRIES	8	/* Free runs examined before the longest one is taken */
+#endif
+
+
+/* Directory name index */
+#if _USE_DIRINDEX
+#define DIX_SLOTS	(_DIRINDEX_SIZE / 3)
+#if DIX_SLOTS < 16
+#error Wrong _DIRINDEX_SIZE setting
+#endif
+#endif
+
+
+/* exFAT volumes */
+#if _FS_EXFAT
+#define MAX_EXFAT		0x7FFFFFFD	/* Maximum number of clusters of exFAT */
+#define XCHAIN_END		0x7FFFFFFF	/* Link returned for the last cluster of a contiguous chain */
+#define XALLOC_TRIES	8			/* Free runs examined on the bitmap before the longest one is taken */
+#if _USE_LFN
+#define XUPPER(w)		ff_wtoupper(w)
+#else
+#define XUPPER(w)		(IsLower(w) ? (w) - 0x20 : (w))
+#endif
+#endif
 
 
 /* File access control feature */
@@ -141,12 +176,6 @@
 #if _FS_READONLY
 #error _FS_LOCK must be 0 on read-only cfg.
 #endif
-typedef struct {
-	FATFS *fs;				/* File ID 1, volume (NULL:blank entry) */
-	DWORD clu;				/* File ID 2, directory */
-	WORD idx;				/* File ID 3, directory index */
-	WORD ctr;				/* File open counter, 0:none, 0x01..0xFF:read open count, 0x100:write mode */
-} FILESEM;
 #endif
 
 
@@ -455,6 +484,41 @@ typedef struct {
 #define	DDE					0xE5	/* Deleted directory entry mark in DIR_Name[0] */
 #define	NDDE				0x05	/* Replacement of the character collides with DDE */
 
+#define BPB_VolOfsEx		64	/* exFAT: Volume offset from top of the drive [sector] (8) */
+#define BPB_TotSecEx		72	/* exFAT: Volume size [sector] (8) */
+#define BPB_FatOfsEx		80	/* exFAT: FAT offset from top of the volume [sector] (4) */
+#define BPB_FatSzEx			84	/* exFAT: FAT size [sector] (4) */
+#define BPB_DataOfsEx		88	/* exFAT: Data offset from top of the volume [sector] (4) */
+#define BPB_NumClusEx		92	/* exFAT: Number of clusters (4) */
+#define BPB_RootClusEx		96	/* exFAT: Root directory start cluster (4) */
+#define BPB_FSVerEx			104	/* exFAT: File system version (2) */
+#define BPB_BytsPerSecEx	108	/* exFAT: Log2 of sector size in unit of byte (1) */
+#define BPB_SecPerClusEx	109	/* exFAT: Log2 of cluster size in unit of sector (1) */
+#define BPB_NumFATsEx		110	/* exFAT: Number of FATs (1) */
+
+#define	XDIR_Type			0	/* exFAT: Type of the directory entry (1) */
+#define	XDIR_NumSec			1	/* exFAT: Number of secondary entries of the set (1) */
+#define	XDIR_SetSum			2	/* exFAT: Sum of the entry set (2) */
+#define	XDIR_Attr			4	/* exFAT: File attribute (2) */
+#define	XDIR_CrtTime		8	/* exFAT: Created time (4) */
+#define	XDIR_ModTime		12	/* exFAT: Modified time (4) */
+#define	XDIR_AccTime		16	/* exFAT: Last accessed time (4) */
+#define	XDIR_GenFlags		33	/* exFAT: General flags of the stream extension entry (1) */
+#define	XDIR_NumName		35	/* exFAT: Number of name characters (1) */
+#define	XDIR_NameHash		36	/* exFAT: Hash of the up-cased name (2) */
+#define	XDIR_ValidFileSize	40	/* exFAT: Valid data length (8) */
+#define	XDIR_FstClus		52	/* exFAT: First cluster of the data (4) */
+#define	XDIR_FileSize		56	/* exFAT: File/Directory size (8) */
+#define	XDIR_NameChar		2	/* exFAT: Name characters in the file name entry (30) */
+#define	XDIR_BmpClus		20	/* exFAT: First cluster of the allocation bitmap (4) */
+#define	XDIR_BmpSize		24	/* exFAT: Size of the allocation bitmap (8) */
+#define	ET_BITMAP			0x81	/* exFAT: Allocation bitmap entry type */
+#define	ET_FILEDIR			0x85	/* exFAT: File and directory entry type */
+#define	ET_STREAM			0xC0	/* exFAT: Stream extension entry type */
+#define	ET_FILENAME			0xC1	/* exFAT: File name entry type */
+#define	XGF_ALLOC			0x01	/* exFAT: Allocation possible flag in XDIR_GenFlags */
+#define	XGF_NOFAT			0x02	/* exFAT: NoFatChain flag in XDIR_GenFlags, the data is contiguous */
+
 
 /*------------------------------------------------------------*/
 /* Module private work area                                   */
@@ -479,11 +543,6 @@ static
 BYTE CurrVol;			/* Current drive */
 #endif
 
-#if _FS_LOCK
-static
-FILESEM	Files[_FS_LOCK];	/* File lock semaphores */
-#endif
-
 #if _USE_LFN == 0			/* No LFN feature */
 #define	DEF_NAMEBUF			BYTE sfn[12]
 #define INIT_BUF(dobj)		(dobj).fn = sfn
@@ -613,14 +672,14 @@ FRESULT chk_lock (	/* Check if the file can be accessed */
 	int acc			/* Desired access (0:Read, 1:Write, 2:Delete/Rename) */
 )
 {
+	FATFS *fs = dj->fs;
 	UINT i, be;
 
-	/* Search file semaphore table */
+	/* Search the file lock table of the volume */
 	for (i = be = 0; i < _FS_LOCK; i++) {
-		if (Files[i].fs) {	/* Existing entry */
-			if (Files[i].fs == dj->fs &&	 	/* Check if the file matched with an open file */
-				Files[i].clu == dj->sclust &&
-				Files[i].idx == dj->index) break;
+		if (fs->flk_ctr[i]) {	/* Existing entry */
+			if (fs->flk_clu[i] == dj->sclust &&	/* Check if the file matched with an open file */
+				fs->flk_idx[i] == dj->index) break;
 		} else {			/* Blank entry */
 			be++;
 		}
@@ -629,16 +688,18 @@ FRESULT chk_lock (	/* Check if the file can be accessed */
 		return (be || acc == 2) ? FR_OK : FR_TOO_MANY_OPEN_FILES;	/* Is there a blank entry for new file? */
 
 	/* The file has been opened. Reject any open against writing file and all write mode open */
-	return (acc || Files[i].ctr == 0x100) ? FR_LOCKED : FR_OK;
+	return (acc || fs->flk_ctr[i] == 0x100) ? FR_LOCKED : FR_OK;
 }
 
 
 static
-int enq_lock (void)	/* Check if an entry is available for a new file */
+int enq_lock (	/* Check if an entry is available for a new file */
+	FATFS *fs	/* File system object */
+)
 {
 	UINT i;
 
-	for (i = 0; i < _FS_LOCK && Files[i].fs; i++) ;
+	for (i = 0; i < _FS_LOCK && fs->flk_ctr[i]; i++) ;
 	return (i == _FS_LOCK) ? 0 : 1;
 }
 
@@ -649,27 +710,26 @@ UINT inc_lock (	/* Increment file open counter and returns its index (0:int erro
 	int acc		/* Desired access mode (0:Read, !0:Write) */
 )
 {
+	FATFS *fs = dj->fs;
 	UINT i;
 
 
 	for (i = 0; i < _FS_LOCK; i++) {	/* Find the file */
-		if (Files[i].fs == dj->fs &&
-			Files[i].clu == dj->sclust &&
-			Files[i].idx == dj->index) break;
+		if (fs->flk_ctr[i] &&
+			fs->flk_clu[i] == dj->sclust &&
+			fs->flk_idx[i] == dj->index) break;
 	}
 
 	if (i == _FS_LOCK) {				/* Not opened. Register it as new. */
-		for (i = 0; i < _FS_LOCK && Files[i].fs; i++) ;
+		for (i = 0; i < _FS_LOCK && fs->flk_ctr[i]; i++) ;
 		if (i == _FS_LOCK) return 0;	/* No space to register (int err) */
-		Files[i].fs = dj->fs;
-		Files[i].clu = dj->sclust;
-		Files[i].idx = dj->index;
-		Files[i].ctr = 0;
+		fs->flk_clu[i] = dj->sclust;
+		fs->flk_idx[i] = dj->index;
 	}
 
-	if (acc && Files[i].ctr) return 0;	/* Access violation (int err) */
+	if (acc && fs->flk_ctr[i]) return 0;	/* Access violation (int err) */
 
-	Files[i].ctr = acc ? 0x100 : Files[i].ctr + 1;	/* Set semaphore value */
+	fs->flk_ctr[i] = acc ? 0x100 : fs->flk_ctr[i] + 1;	/* Set semaphore value */
 
 	return i + 1;
 }
@@ -677,6 +737,7 @@ UINT inc_lock (	/* Increment file open counter and returns its index (0:int erro
 
 static
 FRESULT dec_lock (	/* Decrement file open counter */
+	FATFS *fs,		/* File system object */
 	UINT i			/* Semaphore index */
 )
 {
@@ -685,11 +746,10 @@ FRESULT dec_lock (	/* Decrement file open counter */
 
 
 	if (--i < _FS_LOCK) {
-		n = Files[i].ctr;
+		n = fs->flk_ctr[i];
 		if (n == 0x100) n = 0;
 		if (n) n--;
-		Files[i].ctr = n;
-		if (!n) Files[i].fs = 0;
+		fs->flk_ctr[i] = n;		/* The entry is blank when it reaches 0 */
 		res = FR_OK;
 	} else {
 		res = FR_INT_ERR;
@@ -703,11 +763,7 @@ void clear_lock (	/* Clear lock entries of the volume */
 	FATFS *fs
 )
 {
-	UINT i;
-
-	for (i = 0; i < _FS_LOCK; i++) {
-		if (Files[i].fs == fs) Files[i].fs = 0;
-	}
+	mem_set(fs->flk_ctr, 0, sizeof fs->flk_ctr);
 }
 #endif
 
@@ -717,6 +773,161 @@ void clear_lock (	/* Clear lock entries of the volume */
 /* Change window offset                                                  */
 /*-----------------------------------------------------------------------*/
 
+#if _USE_WINCACHE
+#if !_FS_READONLY
+static
+FRESULT wc_write (	/* FR_OK: successful, FR_DISK_ERR: failed */
+	FATFS *fs,		/* File system object */
+	const BYTE *buf,	/* Sector data */
+	DWORD sect		/* Sector number */
+)
+{
+	BYTE nf;
+
+
+	if (disk_write(fs->drv, buf, sect, 1) != RES_OK)
+		return FR_DISK_ERR;
+	fs->wc_wrt++;
+	if (sect < (fs->fatbase + fs->fsize)) {	/* In FAT area */
+		for (nf = fs->n_fats; nf > 1; nf--) {	/* Reflect the change to all FAT copies */
+			sect += fs->fsize;
+			disk_write(fs->drv, buf, sect, 1);
+			fs->wc_wrt++;
+		}
+	}
+	return FR_OK;
+}
+#endif
+
+
+static
+void wc_swap (
+	FATFS *fs,		/* File system object */
+	BYTE i			/* Cache line to exchange with the window */
+)
+{
+	BYTE *d = fs->win, *s = fs->wc_buf[i], b;
+	UINT n = SS(fs);
+	DWORD sect;
+
+
+	do { b = *d; *d++ = *s; *s++ = b; } while (--n);
+	sect = fs->winsect; fs->winsect = fs->wc_sect[i]; fs->wc_sect[i] = sect;
+	b = fs->wflag; fs->wflag = fs->wc_dirty[i]; fs->wc_dirty[i] = b;
+	fs->wc_age[i] = ++fs->wc_clock;
+}
+
+
+static
+FRESULT move_window (
+	FATFS *fs,		/* File system object */
+	DWORD sector	/* Sector number to make appearance in the fs->win[] */
+)					/* Move to zero only writes back dirty window */
+{
+	BYTE i, v;
+
+
+	if (fs->winsect) {		/* The window supersedes a cached copy of its sector (it may have been relabeled) */
+		for (i = 0; i < _WINCACHE_WAYS; i++) {
+			if (fs->wc_sect[i] == fs->winsect) fs->wc_sect[i] = 0;
+		}
+	}
+	if (!sector) {
+#if !_FS_READONLY
+		if (fs->wflag) {	/* Write back dirty window if needed */
+			if (wc_write(fs, fs->win, fs->winsect) != FR_OK)
+				return FR_DISK_ERR;
+			fs->wflag = 0;
+		}
+#endif
+		return FR_OK;
+	}
+	if (sector == fs->winsect) {	/* Already in the window */
+		fs->wc_hit++;
+		return FR_OK;
+	}
+
+	for (i = 0; i < _WINCACHE_WAYS && fs->wc_sect[i] != sector; i++) ;
+	if (i < _WINCACHE_WAYS) {		/* Cached, bring it to the window */
+		wc_swap(fs, i);
+		fs->wc_hit++;
+		return FR_OK;
+	}
+
+	if (fs->winsect) {		/* Park the window in an empty line, else in the least recently used one (clean first) */
+		for (v = i = 0; i < _WINCACHE_WAYS; i++) {
+			if (!fs->wc_sect[i]) { v = i; break; }
+			if (fs->wc_dirty[i] < fs->wc_dirty[v] ||
+				(fs->wc_dirty[i] == fs->wc_dirty[v] && fs->wc_age[i] < fs->wc_age[v])) v = i;
+		}
+#if !_FS_READONLY
+		if (fs->wc_sect[v] && fs->wc_dirty[v]) {	/* Write back the evicted line */
+			if (wc_write(fs, fs->wc_buf[v], fs->wc_sect[v]) != FR_OK)
+				return FR_DISK_ERR;
+			fs->wc_dirty[v] = 0;
+		}
+#endif
+		wc_swap(fs, v);
+	}
+	fs->winsect = 0;
+	fs->wflag = 0;
+	if (disk_read(fs->drv, fs->win, sector, 1) != RES_OK)
+		return FR_DISK_ERR;
+	fs->winsect = sector;
+	fs->wc_miss++;
+
+	return FR_OK;
+}
+
+
+#if !_FS_READONLY
+static
+FRESULT wc_flush (	/* FR_OK: successful, FR_DISK_ERR: failed */
+	FATFS *fs		/* File system object */
+)
+{
+	BYTE i;
+
+
+	for (i = 0; i < _WINCACHE_WAYS; i++) {
+		if (fs->wc_sect[i] && fs->wc_dirty[i]) {
+			if (wc_write(fs, fs->wc_buf[i], fs->wc_sect[i]) != FR_OK)
+				return FR_DISK_ERR;
+			fs->wc_dirty[i] = 0;
+		}
+	}
+	return FR_OK;
+}
+#endif
+
+
+#if _FS_TINY && !_FS_READONLY
+static
+void wc_direct (
+	FATFS *fs,		/* File system object */
+	BYTE *buf,		/* Data transferred by a multiple sector read or write */
+	DWORD sect,		/* Start sector */
+	UINT cc,		/* Number of sectors */
+	BYTE wr			/* 0:Read (replace with dirty cached sectors), 1:Write (refresh cached sectors) */
+)
+{
+	BYTE i;
+
+
+	for (i = 0; i < _WINCACHE_WAYS; i++) {
+		if (fs->wc_sect[i] && fs->wc_sect[i] - sect < cc) {
+			if (wr) {
+				mem_cpy(fs->wc_buf[i], buf + ((fs->wc_sect[i] - sect) * SS(fs)), SS(fs));
+				fs->wc_dirty[i] = 0;
+			} else if (fs->wc_dirty[i]) {
+				mem_cpy(buf + ((fs->wc_sect[i] - sect) * SS(fs)), fs->wc_buf[i], SS(fs));
+			}
+		}
+	}
+}
+#endif
+
+#else	/* _USE_WINCACHE */
 static
 FRESULT move_window (
 	FATFS *fs,		/* File system object */
@@ -751,6 +962,7 @@ FRESULT move_window (
 
 	return FR_OK;
 }
+#endif
 
 
 
@@ -768,6 +980,9 @@ FRESULT sync (	/* FR_OK: successful, FR_DISK_ERR: failed */
 
 
 	res = move_window(fs, 0);
+#if _USE_WINCACHE
+	if (res == FR_OK) res = wc_flush(fs);	/* Write back deferred sectors */
+#endif
 	if (res == FR_OK) {
 		/* Update FSInfo sector if needed */
 		if (fs->fs_type == FS_FAT32 && fs->fsi_flag) {
@@ -813,6 +1028,32 @@ DWORD clust2sect (	/* !=0: Sector number, 0: Failed - invalid cluster# */
 
 
 
+/*-----------------------------------------------------------------------*/
+/* FAT handling - Free cluster map                                       */
+/*-----------------------------------------------------------------------*/
+
+#if _USE_FREEMAP
+static
+void fmap_init (
+	FATFS *fs		/* File system object */
+)
+{
+	fs->fmap_shift = 0;				/* Fit the groups to the map */
+	while (((fs->n_fatent - 1) >> fs->fmap_shift) >= _FREEMAP_SIZE * 8)
+		fs->fmap_shift++;
+	mem_set(fs->fmap, 0, _FREEMAP_SIZE);	/* Nothing known yet */
+	fs->alloc_hint = 0;
+}
+
+
+#define fmap_full(fs, clst)		((fs)->fmap[((clst) >> (fs)->fmap_shift) / 8] & (1 << (((clst) >> (fs)->fmap_shift) % 8)))
+#define fmap_set(fs, clst)		((fs)->fmap[((clst) >> (fs)->fmap_shift) / 8] |= (BYTE)(1 << (((clst) >> (fs)->fmap_shift) % 8)))
+#define fmap_clear(fs, clst)	((fs)->fmap[((clst) >> (fs)->fmap_shift) / 8] &= (BYTE)~(1 << (((clst) >> (fs)->fmap_shift) % 8)))
+#endif	/* _USE_FREEMAP */
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* FAT access - Read value of a FAT entry                                */
 /*-----------------------------------------------------------------------*/
@@ -848,6 +1089,13 @@ DWORD get_fat (	/* 0xFFFFFFFF:Disk error, 1:Internal error, Else:Cluster status
 		if (move_window(fs, fs->fatbase + (clst / (SS(fs) / 4)))) break;
 		p = &fs->win[clst * 4 % SS(fs)];
 		return LD_DWORD(p) & 0x0FFFFFFF;
+#if _FS_EXFAT
+	case FS_EXFAT :
+		if (move_window(fs, fs->fatbase + (clst / (SS(fs) / 4)))) break;
+		p = &fs->win[clst * 4 % SS(fs)];
+		if (LD_DWORD(p) >= 0xFFFFFFF7) return XCHAIN_END;	/* Bad cluster or end of chain, keep clear of the error codes */
+		return LD_DWORD(p);
+#endif
 	}
 
 	return 0xFFFFFFFF;	/* An error occurred at the disk I/O layer */
@@ -902,14 +1150,30 @@ FRESULT put_fat (
 			res = move_window(fs, fs->fatbase + (clst / (SS(fs) / 4)));
 			if (res != FR_OK) break;
 			p = &fs->win[clst * 4 % SS(fs)];
-			val |= LD_DWORD(p) & 0xF0000000;
+			val = (val & 0x0FFFFFFF) | (LD_DWORD(p) & 0xF0000000);
+			ST_DWORD(p, val);
+			break;
+#if _FS_EXFAT
+		case FS_EXFAT :
+			res = move_window(fs, fs->fatbase + (clst / (SS(fs) / 4)));
+			if (res != FR_OK) break;
+			p = &fs->win[clst * 4 % SS(fs)];
 			ST_DWORD(p, val);
 			break;
+#endif
 
 		default :
 			res = FR_INT_ERR;
 		}
 		fs->wflag = 1;
+#if _USE_FREEMAP
+		if (res == FR_OK) {
+			if (val == 0)
+				fmap_clear(fs, clst);		/* The group has a free cluster now */
+			else if (fs->fmap_shift == 0)
+				fmap_set(fs, clst);			/* One cluster per bit, the map is exact */
+		}
+#endif
 	}
 
 	return res;
@@ -919,6 +1183,91 @@ FRESULT put_fat (
 
 
 
+/*-----------------------------------------------------------------------*/
+/* exFAT handling - Allocation bitmap                                    */
+/*-----------------------------------------------------------------------*/
+#if _FS_EXFAT && !_FS_READONLY
+static
+FRESULT change_bitmap (	/* FR_OK:Successful, FR_DISK_ERR:Disk error, FR_INT_ERR:A bit was in the new state already */
+	FATFS *fs,		/* File system object */
+	DWORD clst,		/* First cluster# to change */
+	DWORD ncl,		/* Number of clusters to change */
+	BYTE bv			/* 1:Mark in use, 0:Mark free */
+)
+{
+	DWORD sect;
+	UINT i;
+	BYTE bm;
+
+
+	clst -= 2;
+	sect = fs->bitbase + clst / 8 / SS(fs);
+	i = clst / 8 % SS(fs);
+	bm = (BYTE)(1 << (clst % 8));
+	for (;;) {
+		if (move_window(fs, sect++)) return FR_DISK_ERR;
+		do {
+			do {
+				if (bv == ((fs->win[i] & bm) != 0)) return FR_INT_ERR;	/* Cross-linked or broken chain */
+				fs->win[i] ^= bm;
+				fs->wflag = 1;
+				if (--ncl == 0) return FR_OK;
+			} while (bm <<= 1);
+			bm = 1;
+		} while (++i < SS(fs));
+		i = 0;
+	}
+}
+
+
+static
+DWORD find_bitmap (	/* 0:No free cluster, >=2:First cluster# of a free run, 0xFFFFFFFF:Disk error */
+	FATFS *fs,		/* File system object */
+	DWORD clst,		/* Cluster# to search after (a run from the next one continues its chain) */
+	DWORD *ncl		/* Number of clusters wanted, returns the length of the run found (up to wanted) */
+)
+{
+	DWORD c, e, rcl, run, bcl, brun, bit;
+	BYTE pass, tries, bm;
+
+
+	if (clst < 2 || clst >= fs->n_fatent) clst = 1;
+	bcl = brun = 0; tries = 0; rcl = 0;
+	for (pass = 0; pass < 2; pass++) {	/* Up to the end of the volume, then from the top, a run does not wrap */
+		c = pass ? 2 : clst + 1;
+		e = pass ? clst + 1 : fs->n_fatent;
+		for (run = 0; c <= e; c++) {
+			if (c < e) {
+				bit = c - 2;
+				if (move_window(fs, fs->bitbase + bit / 8 / SS(fs))) return 0xFFFFFFFF;
+				bm = fs->win[bit / 8 % SS(fs)];
+				if (!run && bm == 0xFF && !(bit % 8) && c + 8 <= e) {	/* Skip a byte of clusters in use */
+					c += 7; continue;
+				}
+				if (!(bm & (1 << (bit % 8)))) {	/* A free cluster */
+					if (!run) rcl = c;
+					if (++run < *ncl) continue;
+				}
+			}
+			if (run) {						/* End of a free run */
+				if (run > brun) {
+					bcl = rcl; brun = run;
+				}
+				if (run >= *ncl || rcl == clst + 1 || ++tries >= XALLOC_TRIES) {
+					pass = 2; break;
+				}
+				run = 0;
+			}
+		}
+	}
+	*ncl = brun;
+	return bcl;
+}
+#endif /* _FS_EXFAT && !_FS_READONLY */
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* FAT handling - Remove a cluster chain                                 */
 /*-----------------------------------------------------------------------*/
@@ -934,6 +1283,9 @@ FRESULT remove_chain (
 #if _USE_ERASE
 	DWORD scl = clst, ecl = clst, rt[2];
 #endif
+#if _FS_EXFAT
+	DWORD xscl = clst, xecl = clst;
+#endif
 
 	if (clst < 2 || clst >= fs->n_fatent) {	/* Check range */
 		res = FR_INT_ERR;
@@ -951,6 +1303,17 @@ FRESULT remove_chain (
 				fs->free_clust++;
 				fs->fsi_flag = 1;
 			}
+#if _FS_EXFAT
+			if (fs->fs_type == FS_EXFAT) {		/* Free it on the allocation bitmap, a run at a time */
+				if (xecl + 1 == nxt) {
+					xecl = nxt;
+				} else {
+					res = change_bitmap(fs, xscl, xecl - xscl + 1, 0);
+					if (res != FR_OK) break;
+					xscl = xecl = nxt;
+				}
+			}
+#endif
 #if _USE_ERASE
 			if (ecl + 1 == nxt) {	/* Is next cluster contiguous? */
 				ecl = nxt;
@@ -984,6 +1347,10 @@ DWORD create_chain (	/* 0:No free cluster, 1:Internal error, 0xFFFFFFFF:Disk err
 {
 	DWORD cs, ncl, scl;
 	FRESULT res;
+#if _USE_FREEMAP
+	DWORD want, mask, gcl, bcl, brun, run;
+	BYTE tries;
+#endif
 
 
 	if (clst == 0) {		/* Create a new chain */
@@ -997,6 +1364,56 @@ DWORD create_chain (	/* 0:No free cluster, 1:Internal error, 0xFFFFFFFF:Disk err
 		scl = clst;
 	}
 
+#if _USE_FREEMAP
+	want = fs->alloc_hint ? fs->alloc_hint : 1;
+	mask = ((DWORD)1 << fs->fmap_shift) - 1;
+	gcl = 0; bcl = 0; brun = 0; tries = 0;
+	ncl = scl;				/* Start cluster */
+	for (;;) {
+		ncl++;							/* Next cluster */
+		if (ncl >= fs->n_fatent) {		/* Wrap around */
+			ncl = 2; gcl = 0;
+			if (ncl > scl) break;		/* No more free cluster */
+		}
+		if (fmap_full(fs, ncl)) {		/* Skip a group known to have no free cluster */
+			run = (ncl | mask) + 1;
+			if (run > fs->n_fatent) run = fs->n_fatent;
+			if (scl >= ncl && scl < run) break;	/* Came round to the start point */
+			ncl = run - 1; gcl = 0;
+			continue;
+		}
+		if ((ncl & mask) == 0 || ncl == 2) gcl = ncl;	/* Scanning a group from its top */
+		cs = get_fat(fs, ncl);			/* Get the cluster status */
+		if (cs == 0xFFFFFFFF || cs == 1)/* An error occurred */
+			return cs;
+		if (cs == 0) {					/* Found a free cluster */
+			if (ncl == clst + 1) {		/* Continues the chain, take it */
+				bcl = ncl; brun = 1;
+				break;
+			}
+			gcl = 0;
+			for (run = 1; run < want && ncl + run < fs->n_fatent; run++) {	/* Measure the free run */
+				cs = get_fat(fs, ncl + run);
+				if (cs == 0xFFFFFFFF || cs == 1) return cs;
+				if (cs) break;
+			}
+			if (run > brun) {			/* Longest run so far */
+				bcl = ncl; brun = run;
+			}
+			if (run >= want || ++tries >= FREEMAP_TRIES) break;
+			if (scl >= ncl && scl < ncl + run) break;	/* Came round to the start point */
+			ncl += run - 1;				/* Continue after the run */
+			continue;
+		}
+		if (gcl && ((ncl & mask) == mask || ncl == fs->n_fatent - 1)) {
+			fmap_set(fs, ncl);			/* Whole group scanned without a free cluster */
+			gcl = 0;
+		}
+		if (ncl == scl) break;			/* No more free cluster */
+	}
+	if (!brun) return 0;				/* No free cluster */
+	ncl = bcl;
+#else
 	ncl = scl;				/* Start cluster */
 	for (;;) {
 		ncl++;							/* Next cluster */
@@ -1010,6 +1427,7 @@ DWORD create_chain (	/* 0:No free cluster, 1:Internal error, 0xFFFFFFFF:Disk err
 			return cs;
 		if (ncl == scl) return 0;		/* No free cluster */
 	}
+#endif
 
 	res = put_fat(fs, ncl, 0x0FFFFFFF);	/* Mark the new cluster "last link" */
 	if (res == FR_OK && clst != 0) {
@@ -1031,53 +1449,274 @@ DWORD create_chain (	/* 0:No free cluster, 1:Internal error, 0xFFFFFFFF:Disk err
 
 
 
+
 /*-----------------------------------------------------------------------*/
-/* FAT handling - Convert offset into cluster with link map table        */
+/* exFAT handling - Follow or stretch a chain that may be contiguous     */
 /*-----------------------------------------------------------------------*/
+/* An exFAT object with the NoFatChain flag has no links on the FAT, its
+/  clusters are sclust..cend. It stays so while it grows in place and its
+/  chain is written to the FAT when a cluster has to be taken elsewhere. */
 
-#if _USE_FASTSEEK
+#if _FS_EXFAT
 static
-DWORD clmt_clust (	/* <2:Error, >=2:Cluster number */
-	FIL* fp,		/* Pointer to the file object */
-	DWORD ofs		/* File offset to be converted to cluster# */
+DWORD next_clust (	/* Same as get_fat() or create_chain(), XCHAIN_END:End of a contiguous chain */
+	FATFS *fs,		/* File system object */
+	DWORD sclust,	/* Top cluster of the chain */
+	DWORD *cend,	/* Last cluster of a contiguous chain (0:on the FAT), updated as it grows */
+	DWORD clst,		/* Cluster# to follow. 0 means create a new chain on stretch. */
+	BYTE stretch	/* 1:Stretch the chain like create_chain() */
 )
 {
-	DWORD cl, ncl, *tbl;
+	DWORD ncl;
+#if !_FS_READONLY
+	DWORD cl;
+	FRESULT res;
+#endif
 
 
-	tbl = fp->cltbl + 1;	/* Top of CLMT */
-	cl = ofs / SS(fp->fs) / fp->fs->csize;	/* Cluster order from top of the file */
-	for (;;) {
-		ncl = *tbl++;			/* Number of cluters in the fragment */
-		if (!ncl) return 0;		/* End of table? (error) */
-		if (cl < ncl) break;	/* In this fragment? */
-		cl -= ncl; tbl++;		/* Next fragment */
+	if (fs->fs_type != FS_EXFAT) {		/* FAT12/16/32 */
+#if !_FS_READONLY
+		if (stretch) return create_chain(fs, clst);
+#endif
+		return get_fat(fs, clst);
 	}
-	return cl + *tbl;	/* Return the cluster number */
-}
-#endif	/* _USE_FASTSEEK */
 
+	if (clst && *cend) {				/* Contiguous chain, no FAT access */
+		if (clst < *cend) return clst + 1;
+		if (!stretch) return XCHAIN_END;
+	}
+	else if (clst) {					/* Chain on the FAT */
+		ncl = get_fat(fs, clst);
+		if (!stretch || ncl == 0xFFFFFFFF) return ncl;
+		if (ncl < 2) return 1;			/* It is an invalid cluster */
+		if (ncl < fs->n_fatent) return ncl;	/* It is already followed by next cluster */
+	}
+#if _FS_READONLY
+	return 1;
+#else
+#if _USE_FREEMAP
+	cl = fs->alloc_hint ? fs->alloc_hint : 1;
+#else
+	cl = 1;
+#endif
+	ncl = find_bitmap(fs, clst ? clst : fs->last_clust, &cl);	/* Take a free cluster on the bitmap */
+	if (ncl == 0 || ncl == 0xFFFFFFFF) return ncl;
+	res = change_bitmap(fs, ncl, 1, 1);
+	if (res == FR_OK) {
+		if (!clst || (*cend && ncl == clst + 1)) {	/* New chain or still contiguous */
+			*cend = ncl;
+		}
+		else if (*cend) {				/* Fragmented, write the contiguous part to the FAT */
+			for (cl = sclust; res == FR_OK && cl < clst; cl++)
+				res = put_fat(fs, cl, cl + 1);
+			*cend = 0;
+		}
+		if (res == FR_OK && !*cend) {	/* Link the new cluster on the FAT */
+			res = put_fat(fs, ncl, 0xFFFFFFFF);
+			if (res == FR_OK) res = put_fat(fs, clst, ncl);
+		}
+	}
+	if (res == FR_OK) {
+		fs->last_clust = ncl;
+		if (fs->free_clust != 0xFFFFFFFF) fs->free_clust--;
+	} else {
+		ncl = (res == FR_DISK_ERR) ? 0xFFFFFFFF : 1;
+	}
 
+	return ncl;
+#endif
+}
 
-/*-----------------------------------------------------------------------*/
-/* Directory handling - Set directory index                              */
-/*-----------------------------------------------------------------------*/
 
+#if !_FS_READONLY
 static
-FRESULT dir_sdi (
-	DIR *dj,		/* Pointer to directory object */
-	WORD idx		/* Index of directory table */
+FRESULT remove_xchain (
+	FATFS *fs,			/* File system object */
+	DWORD clst,			/* Top cluster of the chain */
+	DWORD cend			/* Last cluster of a contiguous chain (0:on the FAT) */
 )
 {
-	DWORD clst;
-	WORD ic;
+	FRESULT res;
+
+
+	if (fs->fs_type != FS_EXFAT || !cend)
+		return remove_chain(fs, clst);
+	if (clst < 2 || cend < clst || cend >= fs->n_fatent) return FR_INT_ERR;
+	res = change_bitmap(fs, clst, cend - clst + 1, 0);
+	if (res == FR_OK && fs->free_clust != 0xFFFFFFFF)
+		fs->free_clust += cend - clst + 1;
+	return res;
+}
+#endif
+
+#define FOLLOW_CLUST(obj, clst)		next_clust((obj)->fs, (obj)->sclust, &(obj)->cend, clst, 0)
+#define STRETCH_CLUST(obj, clst)	next_clust((obj)->fs, (obj)->sclust, &(obj)->cend, clst, 1)
+#define REMOVE_CHAIN(obj)			remove_xchain((obj)->fs, (obj)->sclust, (obj)->cend)
+#else
+#define FOLLOW_CLUST(obj, clst)		get_fat((obj)->fs, clst)
+#define STRETCH_CLUST(obj, clst)	create_chain((obj)->fs, clst)
+#define REMOVE_CHAIN(obj)			remove_chain((obj)->fs, (obj)->sclust)
+#endif /* _FS_EXFAT */
+
+
+
+/*-----------------------------------------------------------------------*/
+/* FAT handling - Convert offset into cluster with link map table        */
+/*-----------------------------------------------------------------------*/
+
+#if _USE_FASTSEEK
+static
+DWORD clmt_clust (	/* <2:Error, >=2:Cluster number */
+	FIL* fp,		/* Pointer to the file object */
+	FSIZE_t ofs		/* File offset to be converted to cluster# */
+)
+{
+	DWORD cl, ncl, *tbl;
+
+
+	tbl = fp->cltbl + 1;	/* Top of CLMT */
+	cl = (DWORD)(ofs / SS(fp->fs) / fp->fs->csize);	/* Cluster order from top of the file */
+	for (;;) {
+		ncl = *tbl++;			/* Number of cluters in the fragment */
+		if (!ncl) return 0;		/* End of table? (error) */
+		if (cl < ncl) break;	/* In this fragment? */
+		cl -= ncl; tbl++;		/* Next fragment */
+	}
+	return cl + *tbl;	/* Return the cluster number */
+}
+#endif	/* _USE_FASTSEEK */
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* FAT handling - Cluster extent cache of the file object                */
+/*-----------------------------------------------------------------------*/
+
+#if _USE_EXTCACHE
+static
+void ext_add (
+	FIL* fp,		/* Pointer to the file object */
+	DWORD ci,		/* Cluster order from top of the file */
+	DWORD clst		/* Cluster number at that order */
+)
+{
+	BYTE n = fp->ext_n;
+
+
+	if (ci != fp->ext_ncl) return;		/* The cache only grows at its end */
+	if (n && fp->ext_clst[n - 1] + fp->ext_len[n - 1] == clst) {
+		fp->ext_len[n - 1]++;			/* Stretch the last extent */
+	} else {
+		if (n >= _EXTCACHE_SIZE) return;	/* No room for a new fragment */
+		fp->ext_clst[n] = clst;
+		fp->ext_len[n] = 1;
+		fp->ext_n = n + 1;
+	}
+	fp->ext_ncl++;
+}
+
+
+static
+DWORD ext_find (	/* 0:Not cached, >=2:Cluster number */
+	FIL* fp,		/* Pointer to the file object */
+	DWORD ci		/* Cluster order from top of the file */
+)
+{
+	BYTE i;
+
+
+	if (ci >= fp->ext_ncl) return 0;
+	for (i = 0; ci >= fp->ext_len[i]; i++)
+		ci -= fp->ext_len[i];
+	return fp->ext_clst[i] + ci;
+}
+
+
+static
+void ext_trim (
+	FIL* fp,		/* Pointer to the file object */
+	DWORD ncl		/* Number of clusters left in the chain */
+)
+{
+	BYTE i;
+
+
+	if (ncl >= fp->ext_ncl) return;
+	fp->ext_ncl = ncl;
+	for (i = 0; i < fp->ext_n && ncl > fp->ext_len[i]; i++)
+		ncl -= fp->ext_len[i];
+	if (ncl) fp->ext_len[i++] = ncl;
+	fp->ext_n = i;
+}
+
+
+static
+DWORD ext_next (	/* Same as get_fat() or create_chain() */
+	FIL* fp,		/* Pointer to the file object */
+	DWORD ci,		/* Cluster order from top of the file */
+	DWORD prev,		/* Cluster number at ci - 1 */
+	BYTE stretch	/* 1:Stretch the chain like create_chain() */
+)
+{
+	DWORD cl;
+
+
+	cl = ext_find(fp, ci);
+	if (cl) return cl;					/* Cache hit */
+#if !_FS_READONLY
+	cl = stretch ? STRETCH_CLUST(fp, prev) : FOLLOW_CLUST(fp, prev);
+#else
+	cl = FOLLOW_CLUST(fp, prev);
+#endif
+	if (cl >= 2 && cl < fp->fs->n_fatent)
+		ext_add(fp, ci, cl);
+	return cl;
+}
+
+
+static
+DWORD ext_run (		/* >=1:Number of contiguous clusters from the current cluster, 0xFFFFFFFF:Disk error */
+	FIL* fp,		/* Pointer to the file object */
+	DWORD want,		/* Number of clusters wanted */
+	BYTE stretch	/* 1:Allocate clusters at the end of the chain */
+)
+{
+	DWORD ci, cl, ncl, n;
+
+
+	ci = (DWORD)(fp->fptr / SS(fp->fs) / fp->fs->csize);
+	cl = fp->clust;
+	for (n = 1; n < want; n++, cl = ncl) {
+		ncl = ext_next(fp, ci + n, cl, stretch);
+		if (ncl == 0xFFFFFFFF) return ncl;
+		if (ncl != cl + 1) break;		/* Fragment boundary, end of chain or disk full */
+	}
+	return n;
+}
+#endif	/* _USE_EXTCACHE */
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Directory handling - Set directory index                              */
+/*-----------------------------------------------------------------------*/
+
+static
+FRESULT dir_sdi (
+	DIR *dj,		/* Pointer to directory object */
+	WORD idx		/* Index of directory table */
+)
+{
+	DWORD clst;
+	UINT ic;
 
 
 	dj->index = idx;
 	clst = dj->sclust;
 	if (clst == 1 || clst >= dj->fs->n_fatent)	/* Check start cluster range */
 		return FR_INT_ERR;
-	if (!clst && dj->fs->fs_type == FS_FAT32)	/* Replace cluster# 0 with root cluster# if in FAT32 */
+	if (!clst && dj->fs->fs_type >= FS_FAT32)	/* Replace cluster# 0 with root cluster# if in FAT32/exFAT */
 		clst = dj->fs->dirbase;
 
 	if (clst == 0) {	/* Static table (root-dir in FAT12/16) */
@@ -1089,7 +1728,7 @@ FRESULT dir_sdi (
 	else {				/* Dynamic table (sub-dirs or root-dir in FAT32) */
 		ic = SS(dj->fs) / SZ_DIR * dj->fs->csize;	/* Entries per cluster */
 		while (idx >= ic) {	/* Follow cluster chain */
-			clst = get_fat(dj->fs, clst);				/* Get next cluster */
+			clst = FOLLOW_CLUST(dj, clst);				/* Get next cluster */
 			if (clst == 0xFFFFFFFF) return FR_DISK_ERR;	/* Disk error */
 			if (clst < 2 || clst >= dj->fs->n_fatent)	/* Reached to end of table or int error */
 				return FR_INT_ERR;
@@ -1135,14 +1774,14 @@ FRESULT dir_next (	/* FR_OK:Succeeded, FR_NO_FILE:End of table, FR_DENIED:EOT an
 		}
 		else {					/* Dynamic table */
 			if (((i / (SS(dj->fs) / SZ_DIR)) & (dj->fs->csize - 1)) == 0) {	/* Cluster changed? */
-				clst = get_fat(dj->fs, dj->clust);				/* Get next cluster */
+				clst = FOLLOW_CLUST(dj, dj->clust);			/* Get next cluster */
 				if (clst <= 1) return FR_INT_ERR;
 				if (clst == 0xFFFFFFFF) return FR_DISK_ERR;
 				if (clst >= dj->fs->n_fatent) {					/* When it reached end of dynamic table */
 #if !_FS_READONLY
-					BYTE c;
+					UINT c;
 					if (!stretch) return FR_NO_FILE;			/* When do not stretch, report EOT */
-					clst = create_chain(dj->fs, dj->clust);		/* Stretch cluster chain */
+					clst = STRETCH_CLUST(dj, dj->clust);		/* Stretch cluster chain */
 					if (clst == 0) return FR_DENIED;			/* No free cluster */
 					if (clst == 1) return FR_INT_ERR;
 					if (clst == 0xFFFFFFFF) return FR_DISK_ERR;
@@ -1156,6 +1795,9 @@ FRESULT dir_next (	/* FR_OK:Succeeded, FR_NO_FILE:End of table, FR_DENIED:EOT an
 						dj->fs->winsect++;
 					}
 					dj->fs->winsect -= c;						/* Rewind window address */
+#if _FS_EXFAT
+					dj->xgrow++;								/* The directory size in its parent has to follow */
+#endif
 #else
 					return FR_NO_FILE;			/* Report EOT */
 #endif
@@ -1179,6 +1821,13 @@ FRESULT dir_next (	/* FR_OK:Succeeded, FR_NO_FILE:End of table, FR_DENIED:EOT an
 /* Directory handling - Load/Store start cluster number                  */
 /*-----------------------------------------------------------------------*/
 
+/* Attribute of the object found in the directory */
+#if _FS_EXFAT
+#define OBJ_ATTR(dj)	((dj)->fs->fs_type == FS_EXFAT ? (dj)->xent[XDIR_Attr] : (dj)->dir[DIR_Attr])
+#else
+#define OBJ_ATTR(dj)	((dj)->dir[DIR_Attr])
+#endif
+
 static
 DWORD ld_clust (
 	FATFS *fs,	/* Pointer to the fs object */
@@ -1381,6 +2030,543 @@ BYTE sum_sfn (
 
 
 
+/*-----------------------------------------------------------------------*/
+/* exFAT handling - Directory entry set                                  */
+/*-----------------------------------------------------------------------*/
+/* An exFAT object is an entry set: a file entry, a stream extension entry
+/  and the name entries. dj->xent[] holds a copy of the first two and
+/  dj->xindex is the index of the file entry. After a find, read or
+/  register, dj->index points the last entry of the set. */
+
+#if _FS_EXFAT
+static
+WORD xdir_sum (		/* Sum of the entry set so far */
+	WORD sum,		/* Sum of the previous entries */
+	const BYTE *dir,	/* Entry to be added */
+	BYTE first		/* 1:File entry, its SetSum field is not summed */
+)
+{
+	UINT i;
+
+
+	for (i = 0; i < SZ_DIR; i++) {
+		if (first && (i == XDIR_SetSum || i == XDIR_SetSum + 1)) continue;
+		sum = ((sum & 1) ? 0x8000 : 0) + (sum >> 1) + dir[i];
+	}
+	return sum;
+}
+
+
+static
+WORD xname_hash (	/* Hash of the up-cased name */
+	const WCHAR *name,	/* Name in Unicode */
+	UINT len		/* Number of characters */
+)
+{
+	WORD sum = 0;
+	WCHAR w;
+
+
+	while (len--) {
+		w = *name++;
+		w = XUPPER(w);
+		sum = ((sum & 1) ? 0x8000 : 0) + (sum >> 1) + (w & 0xFF);
+		sum = ((sum & 1) ? 0x8000 : 0) + (sum >> 1) + (w >> 8);
+	}
+	return sum;
+}
+
+
+static
+int xname_sfn (		/* 0:The name does not fit 8.3 in ASCII, 1:Converted */
+	const WCHAR *name,	/* Name in Unicode */
+	UINT len,		/* Number of characters */
+	BYTE *sfn		/* SFN in directory form with the lower case flags in sfn[NS] */
+)
+{
+	UINT i, si, di, ni;
+	BYTE b = 0;
+	WCHAR w;
+
+
+	mem_set(sfn, ' ', 11);
+	for (di = len; di && name[di - 1] != '.'; di--) ;	/* Find extension (di=0:no extension) */
+	if (di == 1) return 0;
+	i = 0; ni = 8;
+	for (si = 0; si < len; si++) {
+		w = name[si];
+		if (si + 1 == di) {				/* Enter extension section */
+			if (!i) return 0;
+			i = 8; ni = 11; b <<= 2;
+			continue;
+		}
+		if (i >= ni || w <= ' ' || w >= 0x7F || chk_chr("\"*+,./:;<=>\?[\\]|", w)) return 0;
+		if (IsUpper(w)) b |= 2;
+		if (IsLower(w)) {
+			b |= 1; w -= 0x20;
+		}
+		sfn[i++] = (BYTE)w;
+	}
+	if (!i || (ni == 11 && i == 8)) return 0;	/* Empty body or extension */
+	if (ni == 8) b <<= 2;
+	sfn[NS] = 0;
+	if ((b & 0x03) == 0x01) sfn[NS] |= NS_EXT;	/* Extension has only small capital */
+	if ((b & 0x0C) == 0x04) sfn[NS] |= NS_BODY;	/* Body has only small capital */
+	return 1;
+}
+
+
+#if !_USE_LFN
+static
+UINT xsfn_name (	/* Number of characters, 0:Not an ASCII name */
+	const BYTE *sfn,	/* SFN in directory form with the lower case flags in sfn[NS] */
+	WCHAR *name		/* Name in Unicode (up to 12 characters, not terminated) */
+)
+{
+	UINT i, n = 0;
+	BYTE c, lc;
+
+
+	for (i = 0; i < 11; i++) {
+		c = sfn[i];
+		if (c == ' ') {
+			if (i >= 8) break;
+			i = 7; continue;			/* End of body */
+		}
+		if (c < ' ' || c >= 0x7F) return 0;
+		if (i == 8) name[n++] = '.';
+		lc = (i < 8) ? (sfn[NS] & NS_BODY) : (sfn[NS] & NS_EXT);
+		name[n++] = (lc && IsUpper(c)) ? c + 0x20 : c;
+	}
+	return n;
+}
+#endif
+
+
+static
+DWORD xdir_cend (	/* Last cluster of a contiguous object, 0:On the FAT or no cluster */
+	FATFS *fs,		/* File system object */
+	const BYTE *xent	/* File and stream extension entries of the object */
+)
+{
+	DWORD bcs, ncl, scl;
+
+
+	scl = LD_DWORD(xent+XDIR_FstClus);
+	if (!(xent[XDIR_GenFlags] & XGF_NOFAT) || scl < 2) return 0;
+	bcs = (DWORD)fs->csize * SS(fs);
+	ncl = (DWORD)((LD_QWORD(xent+XDIR_FileSize) + bcs - 1) / bcs);
+	return ncl ? scl + ncl - 1 : 0;
+}
+
+
+static
+void xdir_enter (
+	DIR *dj			/* Directory object pointing a sub-directory found in it */
+)
+{
+	dj->pclust = dj->sclust;			/* Keep where its entry set is */
+	dj->pcend = dj->cend;
+	dj->pindex = dj->xindex;
+	dj->sclust = LD_DWORD(dj->xent+XDIR_FstClus);
+	dj->cend = xdir_cend(dj->fs, dj->xent);
+}
+
+
+static
+FRESULT xdir_scan (	/* FR_OK:An object is found, FR_NO_FILE:End of table, FR_DISK_ERR, FR_INT_ERR */
+	DIR *dj,		/* Directory object, the scan starts at its current entry */
+	BYTE find		/* 0:Read the next object, 1:Find the object named in dj->lfn or dj->fn */
+)
+{
+	FRESULT res;
+	BYTE c, *dir, rem, nsec;
+	WORD sum, hash;
+	UINT ni, nlen, klen, i;
+	WCHAR w, *key, *nbuf;
+#if _USE_LFN
+	nbuf = dj->lfn;
+	key = dj->lfn;
+	for (klen = 0; find && key[klen]; klen++) ;
+#else
+	WCHAR kbuf[12], sbuf[12];
+	nbuf = sbuf;
+	key = kbuf;
+	klen = find ? xsfn_name(dj->fn, kbuf) : 0;
+	if (find && !klen) return FR_NO_FILE;	/* Cannot be on an exFAT volume */
+#endif
+	hash = xname_hash(key, klen);
+	sum = 0; ni = nlen = 0; rem = nsec = 0;
+
+	for (;;) {
+		res = move_window(dj->fs, dj->sect);
+		if (res != FR_OK) break;
+		dir = dj->dir;
+		c = dir[XDIR_Type];
+		if (c == 0) { res = FR_NO_FILE; break; }	/* Reached to end of table */
+		if (rem && (rem == nsec ? c != ET_STREAM : (c & 0xC0) != 0xC0))
+			rem = 0;						/* Broken set, look at this entry anew */
+		if (!rem) {
+			if (c == ET_FILEDIR && dir[XDIR_NumSec] >= 2) {	/* Top of a set */
+				mem_cpy(dj->xent, dir, SZ_DIR);
+				sum = xdir_sum(0, dir, 1);
+				dj->xindex = dj->index;
+				rem = nsec = dir[XDIR_NumSec];
+			}
+		} else {
+			sum = xdir_sum(sum, dir, 0);
+			if (c == ET_STREAM) {
+				mem_cpy(dj->xent + SZ_DIR, dir, SZ_DIR);
+				nlen = dir[XDIR_NumName - SZ_DIR]; ni = 0;
+				if (find ? (nlen != klen || LD_WORD(dir+XDIR_NameHash-SZ_DIR) != hash)
+#if _USE_LFN
+						: (!nlen || nlen > _MAX_LFN))
+#else
+						: (!nlen || nlen > 12))
+#endif
+					rem = 1;				/* Skip the set */
+			}
+			if (c == ET_FILENAME) {		/* Pick or compare the name characters */
+				for (i = 0; i < 15 && ni < nlen; i++, ni++) {
+					w = LD_WORD(dir+XDIR_NameChar+i*2);
+					if (find) {
+						if (XUPPER(w) != XUPPER(key[ni])) break;
+					} else {
+						nbuf[ni] = w;
+					}
+				}
+				if (i < 15 && ni < nlen) rem = 1;	/* Name mismatched */
+			}
+			if (--rem == 0 && ni == nlen && nlen && sum == LD_WORD(dj->xent+XDIR_SetSum)) {	/* Valid set */
+#if _USE_LFN
+				dj->lfn_idx = dj->xindex;
+				if (!find) dj->lfn[nlen] = 0;
+				break;
+#else
+				if (find) break;
+				if (xname_sfn(sbuf, nlen, dj->fn)) break;	/* Only 8.3 names can be listed */
+#endif
+			}
+		}
+		res = dir_next(dj, 0);			/* Next entry */
+		if (res != FR_OK) break;
+	}
+	return res;
+}
+
+
+#if !_FS_READONLY
+static
+FRESULT xdir_load (	/* Load the set at dj->xindex into dj->xent[] */
+	DIR *dj			/* Directory object */
+)
+{
+	FRESULT res;
+
+
+	res = dir_sdi(dj, dj->xindex);
+	if (res == FR_OK) res = move_window(dj->fs, dj->sect);
+	if (res == FR_OK) {
+		mem_cpy(dj->xent, dj->dir, SZ_DIR);
+		res = dir_next(dj, 0);
+		if (res == FR_OK) res = move_window(dj->fs, dj->sect);
+		if (res == FR_OK) {
+			mem_cpy(dj->xent + SZ_DIR, dj->dir, SZ_DIR);
+			if (dj->xent[XDIR_Type] != ET_FILEDIR || dj->xent[SZ_DIR] != ET_STREAM || dj->xent[XDIR_NumSec] < 2)
+				res = FR_INT_ERR;
+		}
+	}
+	if (res == FR_NO_FILE) res = FR_INT_ERR;
+	return res;
+}
+
+
+static
+FRESULT xdir_store (	/* Write dj->xent[] back to the set at dj->xindex */
+	DIR *dj			/* Directory object */
+)
+{
+	FRESULT res;
+	WORD idx = dj->index, sum = 0;
+	UINT n, ne = dj->xent[XDIR_NumSec] + 1;
+
+
+	res = dir_sdi(dj, dj->xindex);
+	for (n = 0; res == FR_OK; ) {		/* Put the file and stream entries and sum the set */
+		res = move_window(dj->fs, dj->sect);
+		if (res != FR_OK) break;
+		if (n < 2) {
+			mem_cpy(dj->dir, dj->xent + n * SZ_DIR, SZ_DIR);
+			dj->fs->wflag = 1;
+		}
+		sum = xdir_sum(sum, dj->dir, (BYTE)(n == 0));
+		if (++n == ne) break;
+		res = dir_next(dj, 0);
+	}
+	if (res == FR_OK) res = dir_sdi(dj, dj->xindex);
+	if (res == FR_OK) res = move_window(dj->fs, dj->sect);
+	if (res == FR_OK) {					/* Put the sum */
+		ST_WORD(dj->xent+XDIR_SetSum, sum);
+		ST_WORD(dj->dir+XDIR_SetSum, sum);
+		dj->fs->wflag = 1;
+		res = dir_sdi(dj, idx);
+	}
+	if (res == FR_NO_FILE) res = FR_INT_ERR;
+	return res;
+}
+
+
+static
+FRESULT xdir_register (	/* FR_OK:Successful, FR_DENIED:No free entry, FR_DISK_ERR:Disk error */
+	DIR *dj				/* Target directory with object name to be created */
+)
+{
+	FRESULT res;
+	UINT n, ne, len, i;
+	WORD is;
+	DWORD tm, bcs;
+	WCHAR *name;
+	DIR pdj;
+#if _USE_LFN
+	name = dj->lfn;
+	for (len = 0; name[len]; len++) ;
+	if (_FS_RPATH && (dj->fn[NS] & NS_DOT)) return FR_INVALID_NAME;	/* Cannot create dot entry */
+#else
+	WCHAR nbuf[12];
+	name = nbuf;
+	len = xsfn_name(dj->fn, nbuf);
+	if (dj->fn[NS] & NS_DOT) len = 0;
+#endif
+	if (!len || len > 255) return FR_INVALID_NAME;
+
+	ne = 2 + (len + 14) / 15;			/* Reserve contiguous free entries for the set */
+	dj->xgrow = 0;
+	res = dir_sdi(dj, 0);
+	if (res != FR_OK) return res;
+	n = is = 0;
+	do {
+		res = move_window(dj->fs, dj->sect);
+		if (res != FR_OK) break;
+		if (!(dj->dir[XDIR_Type] & 0x80)) {	/* Is it a free entry? */
+			if (n == 0) is = dj->index;
+			if (++n == ne) break;
+		} else {
+			n = 0;
+		}
+		res = dir_next(dj, 1);			/* Next entry with table stretch */
+	} while (res == FR_OK);
+	if (res != FR_OK) return res;
+
+	mem_set(dj->xent, 0, 2 * SZ_DIR);	/* Create the set */
+	dj->xent[XDIR_Type] = ET_FILEDIR;
+	dj->xent[XDIR_NumSec] = (BYTE)(ne - 1);
+	tm = get_fattime();
+	ST_DWORD(dj->xent+XDIR_CrtTime, tm);
+	ST_DWORD(dj->xent+XDIR_ModTime, tm);
+	ST_DWORD(dj->xent+XDIR_AccTime, tm);
+	dj->xent[SZ_DIR] = ET_STREAM;
+	dj->xent[XDIR_GenFlags] = XGF_ALLOC;
+	dj->xent[XDIR_NumName] = (BYTE)len;
+	ST_WORD(dj->xent+XDIR_NameHash, xname_hash(name, len));
+	dj->xindex = is;
+
+	res = dir_sdi(dj, is);
+	for (n = 0; res == FR_OK; ) {		/* Put the name entries, the first two are put by xdir_store() */
+		res = move_window(dj->fs, dj->sect);
+		if (res != FR_OK) break;
+		if (n >= 2) {
+			mem_set(dj->dir, 0, SZ_DIR);
+			dj->dir[XDIR_Type] = ET_FILENAME;
+			for (i = 0; i < 15 && (n - 2) * 15 + i < len; i++) {
+				ST_WORD(dj->dir+XDIR_NameChar+i*2, name[(n - 2) * 15 + i]);
+			}
+			dj->fs->wflag = 1;
+		}
+		if (++n == ne) break;
+		res = dir_next(dj, 0);
+	}
+	if (res == FR_OK) res = xdir_store(dj);
+
+	if (res == FR_OK && dj->xgrow) {	/* The table has been stretched, update its size in the parent */
+#if _FS_RPATH
+		if (dj->sclust == dj->fs->cdir) dj->fs->cdc_cend = dj->cend;
+#endif
+		if (dj->sclust && dj->pindex != 0xFFFF) {	/* Sub-directory */
+			pdj.fs = dj->fs;
+			pdj.sclust = dj->pclust; pdj.cend = dj->pcend; pdj.xindex = dj->pindex;
+			res = xdir_load(&pdj);
+			if (res == FR_OK) {
+				bcs = (DWORD)dj->fs->csize * SS(dj->fs);
+				tm = LD_DWORD(pdj.xent+XDIR_FileSize) + (DWORD)dj->xgrow * bcs;
+				ST_QWORD(pdj.xent+XDIR_FileSize, tm);
+				ST_QWORD(pdj.xent+XDIR_ValidFileSize, tm);
+				pdj.xent[XDIR_GenFlags] = dj->cend ? XGF_ALLOC | XGF_NOFAT : XGF_ALLOC;
+				res = xdir_store(&pdj);
+			}
+		}
+		dj->xgrow = 0;
+	}
+	return res;
+}
+
+
+#if !_FS_MINIMIZE
+static
+FRESULT xdir_remove (	/* FR_OK:Successful, FR_DISK_ERR:A disk error */
+	DIR *dj				/* Directory object pointing the last entry of the set */
+)
+{
+	FRESULT res;
+	WORD last = dj->index;
+
+
+	res = dir_sdi(dj, dj->xindex);
+	while (res == FR_OK) {
+		res = move_window(dj->fs, dj->sect);
+		if (res != FR_OK) break;
+		dj->dir[XDIR_Type] &= 0x7F;		/* Mark the entry "not in use" */
+		dj->fs->wflag = 1;
+		if (dj->index >= last) break;
+		res = dir_next(dj, 0);
+	}
+	if (res == FR_NO_FILE) res = FR_INT_ERR;
+	return res;
+}
+#endif
+#endif /* !_FS_READONLY */
+#endif /* _FS_EXFAT */
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Directory handling - Name index                                       */
+/*-----------------------------------------------------------------------*/
+#if _USE_DIRINDEX
+
+#define dix_owns(dj)	((dj)->fs->dix_valid && (dj)->fs->dix_clu == (dj)->sclust)
+
+static
+DWORD dix_hash (
+	const BYTE *fn	/* SFN {file[8],ext[3]} */
+)
+{
+	DWORD h = 2166136261UL;
+	UINT n = 11;
+
+	do h = (h ^ *fn++) * 16777619UL; while (--n);
+	return h;
+}
+
+
+static
+int dix_add (		/* 1:Added, 0:Index is full */
+	FATFS *fs,		/* File system object */
+	WORD idx,		/* Index of the SFN entry */
+	const BYTE *fn	/* SFN of the entry */
+)
+{
+	DWORD h = dix_hash(fn);
+	UINT i = h % DIX_SLOTS;
+
+
+	if (idx >= 0xFFFE || fs->dix_used >= DIX_SLOTS / 4 * 3) return 0;
+	while (fs->dix_slot[i] && fs->dix_slot[i] != 0xFFFF) {
+		if (++i == DIX_SLOTS) i = 0;
+	}
+	if (!fs->dix_slot[i]) fs->dix_used++;
+	fs->dix_slot[i] = idx + 1;
+	fs->dix_tag[i] = (BYTE)(h >> 24);
+	return 1;
+}
+
+
+#if !_FS_READONLY && !_FS_MINIMIZE
+static
+void dix_del (
+	FATFS *fs,		/* File system object */
+	WORD idx,		/* Index of the SFN entry */
+	const BYTE *fn	/* SFN of the entry */
+)
+{
+	UINT i = dix_hash(fn) % DIX_SLOTS;
+
+
+	while (fs->dix_slot[i]) {
+		if (fs->dix_slot[i] == idx + 1) {
+			fs->dix_slot[i] = 0xFFFF;	/* Leave a deleted mark to keep the probe chain */
+			break;
+		}
+		if (++i == DIX_SLOTS) i = 0;
+	}
+}
+#endif
+
+
+static
+void dix_start (
+	DIR *dj			/* Directory to be indexed by the following scan */
+)
+{
+	FATFS *fs = dj->fs;
+
+
+	mem_set(fs->dix_slot, 0, sizeof fs->dix_slot);
+	fs->dix_used = 0;
+	fs->dix_free = 0xFFFF;
+	fs->dix_valid = 0;	/* Not valid until the scan completes */
+	fs->dix_clu = dj->sclust;
+}
+
+
+static
+int dix_scan (		/* 1:Continue, 0:Index abandoned */
+	DIR *dj,		/* Directory object pointing the entry */
+	BYTE *dir		/* The entry */
+)
+{
+	if (dir[DIR_Name] == 0 || dir[DIR_Name] == DDE) {	/* Blank entry */
+		if (dj->fs->dix_free == 0xFFFF) dj->fs->dix_free = dj->index;
+		return 1;
+	}
+	if (dir[DIR_Attr] & AM_VOL) return 1;	/* Volume label or LFN entry */
+	return dix_add(dj->fs, dj->index, dir);
+}
+
+
+static
+FRESULT dix_find (	/* FR_OK:Found, FR_NO_FILE:Not found, else:Error */
+	DIR *dj			/* Indexed directory with the SFN to be found */
+)
+{
+	FRESULT res;
+	DWORD h = dix_hash(dj->fn);
+	UINT i = h % DIX_SLOTS;
+	WORD idx;
+
+
+	while ((idx = dj->fs->dix_slot[i]) != 0) {
+		if (idx != 0xFFFF && dj->fs->dix_tag[i] == (BYTE)(h >> 24)) {	/* Candidate, check the entry */
+			res = dir_sdi(dj, idx - 1);
+			if (res == FR_OK) res = move_window(dj->fs, dj->sect);
+			if (res != FR_OK) return res;
+			if (dj->dir[DIR_Name] != DDE && !(dj->dir[DIR_Attr] & AM_VOL) && !mem_cmp(dj->dir, dj->fn, 11)) {
+#if _USE_LFN
+				dj->lfn_idx = 0xFFFF;
+#endif
+				return FR_OK;
+			}
+		}
+		if (++i == DIX_SLOTS) i = 0;
+	}
+	return FR_NO_FILE;
+}
+
+#endif	/* _USE_DIRINDEX */
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Directory handling - Find an object in the directory                  */
 /*-----------------------------------------------------------------------*/
@@ -1395,6 +2581,25 @@ FRESULT dir_find (
 #if _USE_LFN
 	BYTE a, ord, sum;
 #endif
+#if _USE_DIRINDEX
+	int build;
+#endif
+
+#if _FS_EXFAT
+	if (dj->fs->fs_type == FS_EXFAT) {	/* Entry sets on exFAT */
+		res = dir_sdi(dj, 0);
+		return (res == FR_OK) ? xdir_scan(dj, 1) : res;
+	}
+#endif
+#if _USE_DIRINDEX
+#if _USE_LFN
+	if (dix_owns(dj) && !dj->lfn && !(dj->fn[NS] & NS_LOSS))	/* Find an SFN on the index */
+#else
+	if (dix_owns(dj))				/* Find on the index */
+#endif
+		return dix_find(dj);
+	build = dix_owns(dj) ? 2 : 0;	/* 0:Not indexed, 1:Indexing, 2:Do not index */
+#endif
 
 	res = dir_sdi(dj, 0);			/* Rewind directory object */
 	if (res != FR_OK) return res;
@@ -1403,10 +2608,24 @@ FRESULT dir_find (
 	ord = sum = 0xFF;
 #endif
 	do {
+#if _USE_DIRINDEX
+		if (!build && dj->index == SS(dj->fs) / SZ_DIR) {	/* Larger than a sector, index it from the top */
+			dix_start(dj);
+			build = 1;
+			res = dir_sdi(dj, 0);
+			if (res != FR_OK) break;
+#if _USE_LFN
+			ord = sum = 0xFF;
+#endif
+		}
+#endif
 		res = move_window(dj->fs, dj->sect);
 		if (res != FR_OK) break;
 		dir = dj->dir;					/* Ptr to the directory entry of current index */
 		c = dir[DIR_Name];
+#if _USE_DIRINDEX
+		if (build == 1 && !dix_scan(dj, dir)) build = 2;	/* Too many entries */
+#endif
 		if (c == 0) { res = FR_NO_FILE; break; }	/* Reached to end of table */
 #if _USE_LFN	/* LFN configuration */
 		a = dir[DIR_Attr] & AM_MASK;
@@ -1436,6 +2655,12 @@ FRESULT dir_find (
 		res = dir_next(dj, 0);		/* Next entry */
 	} while (res == FR_OK);
 
+#if _USE_DIRINDEX
+	if (build == 1 && res == FR_NO_FILE) {	/* The whole directory has been indexed */
+		if (dj->fs->dix_free == 0xFFFF) dj->fs->dix_free = dj->index;	/* No blank entry, search from the last one */
+		dj->fs->dix_valid = 1;
+	}
+#endif
 	return res;
 }
 
@@ -1458,6 +2683,13 @@ FRESULT dir_read (
 #endif
 
 	res = FR_NO_FILE;
+#if _FS_EXFAT
+	if (dj->fs->fs_type == FS_EXFAT) {	/* Entry sets on exFAT */
+		if (dj->sect) res = xdir_scan(dj, 0);
+		if (res != FR_OK) dj->sect = 0;
+		return res;
+	}
+#endif
 	while (dj->sect) {
 		res = move_window(dj->fs, dj->sect);
 		if (res != FR_OK) break;
@@ -1516,6 +2748,9 @@ FRESULT dir_register (	/* FR_OK:Successful, FR_DENIED:No free entry or too many
 	WCHAR *lfn;
 
 
+#if _FS_EXFAT
+	if (dj->fs->fs_type == FS_EXFAT) return xdir_register(dj);	/* Entry sets on exFAT */
+#endif
 	fn = dj->fn; lfn = dj->lfn;
 	mem_cpy(sn, fn, 12);
 
@@ -1542,7 +2777,11 @@ FRESULT dir_register (	/* FR_OK:Successful, FR_DENIED:No free entry or too many
 	}
 
 	/* Reserve contiguous entries */
+#if _USE_DIRINDEX
+	res = dir_sdi(dj, dix_owns(dj) ? dj->fs->dix_free : 0);
+#else
 	res = dir_sdi(dj, 0);
+#endif
 	if (res != FR_OK) return res;
 	n = is = 0;
 	do {
@@ -1574,7 +2813,14 @@ FRESULT dir_register (	/* FR_OK:Successful, FR_DENIED:No free entry or too many
 	}
 
 #else	/* Non LFN configuration */
+#if _FS_EXFAT
+	if (dj->fs->fs_type == FS_EXFAT) return xdir_register(dj);	/* Entry sets on exFAT */
+#endif
+#if _USE_DIRINDEX
+	res = dir_sdi(dj, dix_owns(dj) ? dj->fs->dix_free : 0);
+#else
 	res = dir_sdi(dj, 0);
+#endif
 	if (res == FR_OK) {
 		do {	/* Find a blank entry for the SFN */
 			res = move_window(dj->fs, dj->sect);
@@ -1596,6 +2842,16 @@ FRESULT dir_register (	/* FR_OK:Successful, FR_DENIED:No free entry or too many
 			dir[DIR_NTres] = *(dj->fn+NS) & (NS_BODY | NS_EXT);	/* Put NT flag */
 #endif
 			dj->fs->wflag = 1;
+#if _USE_DIRINDEX
+			if (dix_owns(dj)) {
+#if _USE_LFN
+				if (is == dj->fs->dix_free) dj->fs->dix_free = dj->index;	/* Entries up to the new SFN are in use */
+#else
+				dj->fs->dix_free = dj->index;
+#endif
+				if (!dix_add(dj->fs, dj->index, dir)) dj->fs->dix_valid = 0;	/* Drop the index when it gets full */
+			}
+#endif
 		}
 	}
 
@@ -1619,12 +2875,21 @@ FRESULT dir_remove (	/* FR_OK: Successful, FR_DISK_ERR: A disk error */
 #if _USE_LFN	/* LFN configuration */
 	WORD i;
 
+#if _FS_EXFAT
+	if (dj->fs->fs_type == FS_EXFAT) return xdir_remove(dj);	/* Entry sets on exFAT */
+#endif
 	i = dj->index;	/* SFN index */
 	res = dir_sdi(dj, (WORD)((dj->lfn_idx == 0xFFFF) ? i : dj->lfn_idx));	/* Goto the SFN or top of the LFN entries */
 	if (res == FR_OK) {
+#if _USE_DIRINDEX
+		if (dix_owns(dj) && dj->index < dj->fs->dix_free) dj->fs->dix_free = dj->index;
+#endif
 		do {
 			res = move_window(dj->fs, dj->sect);
 			if (res != FR_OK) break;
+#if _USE_DIRINDEX
+			if (dj->index == i && dix_owns(dj)) dix_del(dj->fs, i, dj->dir);
+#endif
 			*dj->dir = DDE;			/* Mark the entry "deleted" */
 			dj->fs->wflag = 1;
 			if (dj->index >= i) break;	/* When reached SFN, all entries of the object has been deleted. */
@@ -1634,10 +2899,19 @@ FRESULT dir_remove (	/* FR_OK: Successful, FR_DISK_ERR: A disk error */
 	}
 
 #else			/* Non LFN configuration */
+#if _FS_EXFAT
+	if (dj->fs->fs_type == FS_EXFAT) return xdir_remove(dj);	/* Entry sets on exFAT */
+#endif
 	res = dir_sdi(dj, dj->index);
 	if (res == FR_OK) {
 		res = move_window(dj->fs, dj->sect);
 		if (res == FR_OK) {
+#if _USE_DIRINDEX
+			if (dix_owns(dj)) {
+				dix_del(dj->fs, dj->index, dj->dir);
+				if (dj->index < dj->fs->dix_free) dj->fs->dix_free = dj->index;
+			}
+#endif
 			*dj->dir = DDE;			/* Mark the entry "deleted" */
 			dj->fs->wflag = 1;
 		}
@@ -1878,12 +3152,33 @@ void get_fileinfo (		/* No return code */
 	UINT i;
 	BYTE nt, *dir;
 	TCHAR *p, c;
+#if _FS_EXFAT
+	DWORD tm;
+#if _USE_LFN
+	BYTE xsfn[12];
+#endif
+#endif
 
 
 	p = fno->fname;
 	if (dj->sect) {
 		dir = dj->dir;
 		nt = dir[DIR_NTres];		/* NT flag */
+#if _FS_EXFAT
+		if (dj->fs->fs_type == FS_EXFAT) {	/* SFN made from the name of the entry set */
+#if _USE_LFN
+			for (i = 0; dj->lfn[i]; i++) ;
+			if (!xname_sfn(dj->lfn, i, xsfn)) {	/* No 8.3 form, the SFN is "?" */
+				mem_set(xsfn, ' ', 11);
+				xsfn[0] = '?'; xsfn[NS] = 0;
+			}
+			dir = xsfn;
+#else
+			dir = dj->fn;					/* Put by dir_read() or create_name() */
+#endif
+			nt = dir[NS];
+		}
+#endif
 		for (i = 0; i < 8; i++) {	/* Copy name body */
 			c = dir[i];
 			if (c == ' ') break;
@@ -1912,10 +3207,21 @@ void get_fileinfo (		/* No return code */
 				*p++ = c;
 			}
 		}
-		fno->fattrib = dir[DIR_Attr];				/* Attribute */
-		fno->fsize = LD_DWORD(dir+DIR_FileSize);	/* Size */
-		fno->fdate = LD_WORD(dir+DIR_WrtDate);		/* Date */
-		fno->ftime = LD_WORD(dir+DIR_WrtTime);		/* Time */
+#if _FS_EXFAT
+		if (dj->fs->fs_type == FS_EXFAT) {
+			fno->fattrib = dj->xent[XDIR_Attr];				/* Attribute */
+			fno->fsize = LD_QWORD(dj->xent+XDIR_FileSize);	/* Size */
+			tm = LD_DWORD(dj->xent+XDIR_ModTime);
+			fno->fdate = (WORD)(tm >> 16);					/* Date */
+			fno->ftime = (WORD)tm;							/* Time */
+		} else
+#endif
+		{
+			fno->fattrib = dir[DIR_Attr];				/* Attribute */
+			fno->fsize = LD_DWORD(dir+DIR_FileSize);	/* Size */
+			fno->fdate = LD_WORD(dir+DIR_WrtDate);		/* Date */
+			fno->ftime = LD_WORD(dir+DIR_WrtTime);		/* Time */
+		}
 	}
 	*p = 0;		/* Terminate SFN str by a \0 */
 
@@ -1971,6 +3277,17 @@ FRESULT follow_path (	/* FR_OK(0): successful, !=0: error code */
 	if (*path == '/' || *path == '\\')	/* Strip heading separator if exist */
 		path++;
 	dj->sclust = 0;						/* Start from the root dir */
+#endif
+#if _FS_EXFAT
+	dj->cend = 0; dj->pindex = 0xFFFF;	/* The root dir is on the FAT and has no entry set */
+#if _FS_RPATH
+	if (dj->sclust) {
+		dj->cend = dj->fs->cdc_cend;
+		dj->pclust = dj->fs->cdc_pclust;
+		dj->pcend = dj->fs->cdc_pcend;
+		dj->pindex = dj->fs->cdc_pindex;
+	}
+#endif
 #endif
 
 	if ((UINT)*path < ' ') {			/* Nul path means the start directory itself */
@@ -1980,6 +3297,17 @@ FRESULT follow_path (	/* FR_OK(0): successful, !=0: error code */
 		for (;;) {
 			res = create_name(dj, &path);	/* Get a segment */
 			if (res != FR_OK) break;
+#if _FS_EXFAT && _FS_RPATH
+			if (dj->fs->fs_type == FS_EXFAT && (dj->fn[NS] & NS_DOT)) {	/* exFAT has no dot entries */
+				if (dj->fn[1] == '.') {		/* ".." is not supported */
+					res = FR_NO_PATH; break;
+				}
+				res = dir_sdi(dj, 0);		/* "." is the directory itself */
+				dj->dir = 0;
+				if (res != FR_OK || (dj->fn[NS] & NS_LAST)) break;
+				continue;
+			}
+#endif
 			res = dir_find(dj);				/* Find it */
 			ns = *(dj->fn+NS);
 			if (res != FR_OK) {				/* Failed to find the object */
@@ -1995,6 +3323,15 @@ FRESULT follow_path (	/* FR_OK(0): successful, !=0: error code */
 				break;
 			}
 			if (ns & NS_LAST) break;			/* Last segment match. Function completed. */
+#if _FS_EXFAT
+			if (dj->fs->fs_type == FS_EXFAT) {
+				if (!(dj->xent[XDIR_Attr] & AM_DIR)) {	/* Cannot follow because it is a file */
+					res = FR_NO_PATH; break;
+				}
+				xdir_enter(dj);
+				continue;
+			}
+#endif
 			dir = dj->dir;						/* There is next segment. Follow the sub directory */
 			if (!(dir[DIR_Attr] & AM_DIR)) {	/* Cannot follow because it is a file */
 				res = FR_NO_PATH; break;
@@ -2028,6 +3365,10 @@ BYTE check_fs (	/* 0:FAT-VBR, 1:Any BR but not FAT, 2:Not a BR, 3:Disk error */
 		return 0;
 	if ((LD_DWORD(&fs->win[BS_FilSysType32]) & 0xFFFFFF) == 0x544146)
 		return 0;
+#if _FS_EXFAT
+	if (!mem_cmp(&fs->win[BS_OEMName], "EXFAT   ", 8))	/* Check "EXFAT" string */
+		return 0;
+#endif
 
 	return 1;
 }
@@ -2035,6 +3376,70 @@ BYTE check_fs (	/* 0:FAT-VBR, 1:Any BR but not FAT, 2:Not a BR, 3:Disk error */
 
 
 
+/*-----------------------------------------------------------------------*/
+/* Load an exFAT boot record into the file system object                 */
+/*-----------------------------------------------------------------------*/
+#if _FS_EXFAT
+static
+FRESULT mount_exfat (	/* FR_OK:Successful, FR_NO_FILESYSTEM:Not a valid exFAT volume, FR_DISK_ERR */
+	FATFS *fs,		/* File system object with the boot record in the window */
+	DWORD bsect		/* Sector# of the boot record */
+)
+{
+	QWORD maxlba;
+	DWORD nclst, bcl, ncl, i;
+	BYTE b, *dir;
+	UINT ss;
+
+
+	for (b = 0, ss = SS(fs); ss > 1; ss >>= 1) b++;
+	if (fs->win[BPB_BytsPerSecEx] != b) return FR_NO_FILESYSTEM;	/* (Sector size must be equal to the physical one) */
+	if (LD_WORD(fs->win+BPB_FSVerEx) >> 8 != 1) return FR_NO_FILESYSTEM;	/* (Revision 1.xx only) */
+	maxlba = LD_QWORD(fs->win+BPB_TotSecEx) + bsect;
+	if (maxlba >= 0x100000000ULL) return FR_NO_FILESYSTEM;	/* (The volume must be within 32-bit LBA) */
+	fs->fsize = LD_DWORD(fs->win+BPB_FatSzEx);				/* Sectors per FAT */
+	fs->n_fats = fs->win[BPB_NumFATsEx];
+	if (fs->n_fats != 1) return FR_NO_FILESYSTEM;			/* (Second FAT of TexFAT is not supported) */
+	b = fs->win[BPB_SecPerClusEx];
+	if (b > 15) return FR_NO_FILESYSTEM;					/* (Sectors per cluster must fit csize) */
+	fs->csize = 1 << b;
+	nclst = LD_DWORD(fs->win+BPB_NumClusEx);
+	if (!nclst || nclst > MAX_EXFAT) return FR_NO_FILESYSTEM;
+	fs->n_fatent = nclst + 2;
+	fs->n_rootdir = 0;
+	fs->fatbase = bsect + LD_DWORD(fs->win+BPB_FatOfsEx);
+	fs->database = bsect + LD_DWORD(fs->win+BPB_DataOfsEx);
+	if (maxlba < (QWORD)fs->database + (QWORD)nclst * fs->csize) return FR_NO_FILESYSTEM;
+	if (fs->fsize < (fs->n_fatent * 4 + SS(fs) - 1) / SS(fs)) return FR_NO_FILESYSTEM;
+	fs->dirbase = LD_DWORD(fs->win+BPB_RootClusEx);		/* Root directory start cluster */
+	if (fs->dirbase < 2 || fs->dirbase >= fs->n_fatent) return FR_NO_FILESYSTEM;
+
+	/* Find the allocation bitmap entry in the first cluster of the root directory */
+	dir = 0;
+	for (i = 0; i < (DWORD)fs->csize * (SS(fs) / SZ_DIR); i++) {
+		if (move_window(fs, clust2sect(fs, fs->dirbase) + i / (SS(fs) / SZ_DIR))) return FR_DISK_ERR;
+		dir = fs->win + i % (SS(fs) / SZ_DIR) * SZ_DIR;
+		if (dir[XDIR_Type] == ET_BITMAP || dir[XDIR_Type] == 0) break;
+	}
+	if (!dir || dir[XDIR_Type] != ET_BITMAP) return FR_NO_FILESYSTEM;
+	bcl = LD_DWORD(dir+XDIR_BmpClus);
+	if (bcl < 2 || bcl >= fs->n_fatent) return FR_NO_FILESYSTEM;
+	if (LD_QWORD(dir+XDIR_BmpSize) < (nclst + 7) / 8) return FR_NO_FILESYSTEM;
+	ncl = (DWORD)((LD_QWORD(dir+XDIR_BmpSize) + (DWORD)fs->csize * SS(fs) - 1) / ((DWORD)fs->csize * SS(fs)));
+	fs->bitbase = clust2sect(fs, bcl);
+
+	/* The bitmap is accessed by sector#, check if it is contiguous */
+	for (i = bcl; --ncl; i++) {
+		if (move_window(fs, fs->fatbase + i / (SS(fs) / 4))) return FR_DISK_ERR;
+		if (LD_DWORD(fs->win + i % (SS(fs) / 4) * 4) != i + 1) return FR_NO_FILESYSTEM;
+	}
+	return FR_OK;
+}
+#endif
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Check if the file system object is valid or not                       */
 /*-----------------------------------------------------------------------*/
@@ -2053,6 +3458,9 @@ FRESULT chk_mounted (	/* FR_OK(0): successful, !=0: any error occurred */
 	WORD nrsv;
 	const TCHAR *p = *path;
 	FATFS *fs;
+#if _FS_EXFAT
+	FRESULT res;
+#endif
 
 
 	/* Get logical drive number from the path name */
@@ -2115,57 +3523,72 @@ FRESULT chk_mounted (	/* FR_OK(0): successful, !=0: any error occurred */
 	}
 	if (fmt == 3) return FR_DISK_ERR;
 	if (fmt) return FR_NO_FILESYSTEM;		/* No FAT volume is found */
+	fs->winsect = 0;						/* Invalidate sector cache */
+	fs->wflag = 0;
+#if _USE_WINCACHE
+	mem_set(fs->wc_sect, 0, sizeof fs->wc_sect);
+	fs->wc_hit = fs->wc_miss = fs->wc_wrt = 0;
+#endif
 
 	/* An FAT volume is found. Following code initializes the file system object */
 
-	if (LD_WORD(fs->win+BPB_BytsPerSec) != SS(fs))		/* (BPB_BytsPerSec must be equal to the physical sector size) */
-		return FR_NO_FILESYSTEM;
-
-	fasize = LD_WORD(fs->win+BPB_FATSz16);				/* Number of sectors per FAT */
-	if (!fasize) fasize = LD_DWORD(fs->win+BPB_FATSz32);
-	fs->fsize = fasize;
-
-	fs->n_fats = b = fs->win[BPB_NumFATs];				/* Number of FAT copies */
-	if (b != 1 && b != 2) return FR_NO_FILESYSTEM;		/* (Must be 1 or 2) */
-	fasize *= b;										/* Number of sectors for FAT area */
-
-	fs->csize = b = fs->win[BPB_SecPerClus];			/* Number of sectors per cluster */
-	if (!b || (b & (b - 1))) return FR_NO_FILESYSTEM;	/* (Must be power of 2) */
-
-	fs->n_rootdir = LD_WORD(fs->win+BPB_RootEntCnt);	/* Number of root directory entries */
-	if (fs->n_rootdir % (SS(fs) / SZ_DIR)) return FR_NO_FILESYSTEM;	/* (BPB_RootEntCnt must be sector aligned) */
-
-	tsect = LD_WORD(fs->win+BPB_TotSec16);				/* Number of sectors on the volume */
-	if (!tsect) tsect = LD_DWORD(fs->win+BPB_TotSec32);
-
-	nrsv = LD_WORD(fs->win+BPB_RsvdSecCnt);				/* Number of reserved sectors */
-	if (!nrsv) return FR_NO_FILESYSTEM;					/* (BPB_RsvdSecCnt must not be 0) */
-
-	/* Determine the FAT sub type */
-	sysect = nrsv + fasize + fs->n_rootdir / (SS(fs) / SZ_DIR);	/* RSV+FAT+DIR */
-	if (tsect < sysect) return FR_NO_FILESYSTEM;		/* (Invalid volume size) */
-	nclst = (tsect - sysect) / fs->csize;				/* Number of clusters */
-	if (!nclst) return FR_NO_FILESYSTEM;				/* (Invalid volume size) */
-	fmt = FS_FAT12;
-	if (nclst >= MIN_FAT16) fmt = FS_FAT16;
-	if (nclst >= MIN_FAT32) fmt = FS_FAT32;
-
-	/* Boundaries and Limits */
-	fs->n_fatent = nclst + 2;							/* Number of FAT entries */
-	fs->database = bsect + sysect;						/* Data start sector */
-	fs->fatbase = bsect + nrsv; 						/* FAT start sector */
-	if (fmt == FS_FAT32) {
-		if (fs->n_rootdir) return FR_NO_FILESYSTEM;		/* (BPB_RootEntCnt must be 0) */
-		fs->dirbase = LD_DWORD(fs->win+BPB_RootClus);	/* Root directory start cluster */
-		szbfat = fs->n_fatent * 4;						/* (Required FAT size) */
-	} else {
-		if (!fs->n_rootdir)	return FR_NO_FILESYSTEM;	/* (BPB_RootEntCnt must not be 0) */
-		fs->dirbase = fs->fatbase + fasize;				/* Root directory start sector */
-		szbfat = (fmt == FS_FAT16) ?					/* (Required FAT size) */
-			fs->n_fatent * 2 : fs->n_fatent * 3 / 2 + (fs->n_fatent & 1);
+#if _FS_EXFAT
+	if (!mem_cmp(fs->win+BS_OEMName, "EXFAT   ", 8)) {	/* An exFAT volume */
+		res = mount_exfat(fs, bsect);
+		if (res != FR_OK) return res;
+		fmt = FS_EXFAT;
+	} else
+#endif
+	{
+		if (LD_WORD(fs->win+BPB_BytsPerSec) != SS(fs))		/* (BPB_BytsPerSec must be equal to the physical sector size) */
+			return FR_NO_FILESYSTEM;
+
+		fasize = LD_WORD(fs->win+BPB_FATSz16);				/* Number of sectors per FAT */
+		if (!fasize) fasize = LD_DWORD(fs->win+BPB_FATSz32);
+		fs->fsize = fasize;
+
+		fs->n_fats = b = fs->win[BPB_NumFATs];				/* Number of FAT copies */
+		if (b != 1 && b != 2) return FR_NO_FILESYSTEM;		/* (Must be 1 or 2) */
+		fasize *= b;										/* Number of sectors for FAT area */
+
+		fs->csize = b = fs->win[BPB_SecPerClus];			/* Number of sectors per cluster */
+		if (!b || (b & (b - 1))) return FR_NO_FILESYSTEM;	/* (Must be power of 2) */
+
+		fs->n_rootdir = LD_WORD(fs->win+BPB_RootEntCnt);	/* Number of root directory entries */
+		if (fs->n_rootdir % (SS(fs) / SZ_DIR)) return FR_NO_FILESYSTEM;	/* (BPB_RootEntCnt must be sector aligned) */
+
+		tsect = LD_WORD(fs->win+BPB_TotSec16);				/* Number of sectors on the volume */
+		if (!tsect) tsect = LD_DWORD(fs->win+BPB_TotSec32);
+
+		nrsv = LD_WORD(fs->win+BPB_RsvdSecCnt);				/* Number of reserved sectors */
+		if (!nrsv) return FR_NO_FILESYSTEM;					/* (BPB_RsvdSecCnt must not be 0) */
+
+		/* Determine the FAT sub type */
+		sysect = nrsv + fasize + fs->n_rootdir / (SS(fs) / SZ_DIR);	/* RSV+FAT+DIR */
+		if (tsect < sysect) return FR_NO_FILESYSTEM;		/* (Invalid volume size) */
+		nclst = (tsect - sysect) / fs->csize;				/* Number of clusters */
+		if (!nclst) return FR_NO_FILESYSTEM;				/* (Invalid volume size) */
+		fmt = FS_FAT12;
+		if (nclst >= MIN_FAT16) fmt = FS_FAT16;
+		if (nclst >= MIN_FAT32) fmt = FS_FAT32;
+
+		/* Boundaries and Limits */
+		fs->n_fatent = nclst + 2;							/* Number of FAT entries */
+		fs->database = bsect + sysect;						/* Data start sector */
+		fs->fatbase = bsect + nrsv; 						/* FAT start sector */
+		if (fmt == FS_FAT32) {
+			if (fs->n_rootdir) return FR_NO_FILESYSTEM;		/* (BPB_RootEntCnt must be 0) */
+			fs->dirbase = LD_DWORD(fs->win+BPB_RootClus);	/* Root directory start cluster */
+			szbfat = fs->n_fatent * 4;						/* (Required FAT size) */
+		} else {
+			if (!fs->n_rootdir)	return FR_NO_FILESYSTEM;	/* (BPB_RootEntCnt must not be 0) */
+			fs->dirbase = fs->fatbase + fasize;				/* Root directory start sector */
+			szbfat = (fmt == FS_FAT16) ?					/* (Required FAT size) */
+				fs->n_fatent * 2 : fs->n_fatent * 3 / 2 + (fs->n_fatent & 1);
+		}
+		if (fs->fsize < (szbfat + (SS(fs) - 1)) / SS(fs))	/* (BPB_FATSz must not be less than required) */
+			return FR_NO_FILESYSTEM;
 	}
-	if (fs->fsize < (szbfat + (SS(fs) - 1)) / SS(fs))	/* (BPB_FATSz must not be less than required) */
-		return FR_NO_FILESYSTEM;
 
 #if !_FS_READONLY
 	/* Initialize cluster allocation information */
@@ -2182,13 +3605,19 @@ FRESULT chk_mounted (	/* FR_OK(0): successful, !=0: any error occurred */
 			LD_DWORD(fs->win+FSI_StrucSig) == 0x61417272) {
 				fs->last_clust = LD_DWORD(fs->win+FSI_Nxt_Free);
 				fs->free_clust = LD_DWORD(fs->win+FSI_Free_Count);
+				if (fs->last_clust >= fs->n_fatent) fs->last_clust = 0;	/* Ignore broken hints */
+				if (fs->free_clust > fs->n_fatent - 2) fs->free_clust = 0xFFFFFFFF;
 		}
 	}
+#if _USE_FREEMAP
+	fmap_init(fs);
+#endif
 #endif
 	fs->fs_type = fmt;		/* FAT sub-type */
 	fs->id = ++Fsid;		/* File system mount ID */
-	fs->winsect = 0;		/* Invalidate sector cache */
-	fs->wflag = 0;
+#if _USE_DIRINDEX
+	fs->dix_valid = 0;		/* Forget the index of the old volume */
+#endif
 #if _FS_RPATH
 	fs->cdir = 0;			/* Current directory (root dir) */
 #endif
@@ -2261,10 +3690,16 @@ FRESULT f_mount (
 		if (!ff_del_syncobj(rfs->sobj)) return FR_INT_ERR;
 #endif
 		rfs->fs_type = 0;		/* Clear old fs object */
+#if _USE_FREEMAP
+		rfs->alloc_hint = 0;
+#endif
 	}
 
 	if (fs) {
 		fs->fs_type = 0;		/* Clear new fs object */
+#if _USE_FREEMAP
+		fs->alloc_hint = 0;
+#endif
 #if _FS_REENTRANT				/* Create sync object for the new volume */
 		if (!ff_cre_syncobj(vol, &fs->sobj)) return FR_INT_ERR;
 #endif
@@ -2316,6 +3751,11 @@ FRESULT f_open (
 				res = chk_lock(&dj, (mode & ~FA_READ) ? 1 : 0);
 #endif
 		}
+#if _FS_EXFAT
+		if (res == FR_OK && dj.fs->fs_type == FS_EXFAT && (mode & FA_WRITE) && !(mode & FA_CREATE_ALWAYS)
+			&& LD_QWORD(dj.xent+XDIR_ValidFileSize) < LD_QWORD(dj.xent+XDIR_FileSize))
+			res = FR_DENIED;					/* Cannot write a file that has data beyond the valid length */
+#endif
 		/* Create or Open a file */
 		if (mode & (FA_CREATE_ALWAYS | FA_OPEN_ALWAYS | FA_CREATE_NEW)) {
 			DWORD dw, cl;
@@ -2323,7 +3763,7 @@ FRESULT f_open (
 			if (res != FR_OK) {					/* No file, create new */
 				if (res == FR_NO_FILE)			/* There is no file to open, create a new entry */
 #if _FS_LOCK
-					res = enq_lock() ? dir_register(&dj) : FR_TOO_MANY_OPEN_FILES;
+					res = enq_lock(dj.fs) ? dir_register(&dj) : FR_TOO_MANY_OPEN_FILES;
 #else
 					res = dir_register(&dj);
 #endif
@@ -2331,13 +3771,30 @@ FRESULT f_open (
 				dir = dj.dir;					/* New entry */
 			}
 			else {								/* Any object is already existing */
-				if (dir[DIR_Attr] & (AM_RDO | AM_DIR)) {	/* Cannot overwrite it (R/O or DIR) */
+				if (OBJ_ATTR(&dj) & (AM_RDO | AM_DIR)) {	/* Cannot overwrite it (R/O or DIR) */
 					res = FR_DENIED;
 				} else {
 					if (mode & FA_CREATE_NEW)	/* Cannot create as new file */
 						res = FR_EXIST;
 				}
 			}
+#if _FS_EXFAT
+			if (res == FR_OK && (mode & FA_CREATE_ALWAYS) && dj.fs->fs_type == FS_EXFAT) {	/* Truncate the set */
+				cl = LD_DWORD(dj.xent+XDIR_FstClus);
+				dw = xdir_cend(dj.fs, dj.xent);
+				ST_DWORD(dj.xent+XDIR_FstClus, 0);
+				ST_QWORD(dj.xent+XDIR_FileSize, 0);
+				ST_QWORD(dj.xent+XDIR_ValidFileSize, 0);
+				dj.xent[XDIR_GenFlags] = XGF_ALLOC;
+				ST_WORD(dj.xent+XDIR_Attr, 0);
+				ST_DWORD(dj.xent+XDIR_CrtTime, get_fattime());
+				res = xdir_store(&dj);
+				if (res == FR_OK && cl) {			/* Remove the cluster chain if exist */
+					res = remove_xchain(dj.fs, cl, dw);
+					if (res == FR_OK) dj.fs->last_clust = cl - 1;	/* Reuse the cluster hole */
+				}
+			} else
+#endif
 			if (res == FR_OK && (mode & FA_CREATE_ALWAYS)) {	/* Truncate it if overwrite mode */
 				dw = get_fattime();					/* Created time */
 				ST_DWORD(dir+DIR_CrtTime, dw);
@@ -2358,10 +3815,10 @@ FRESULT f_open (
 		}
 		else {	/* Open an existing file */
 			if (res == FR_OK) {						/* Follow succeeded */
-				if (dir[DIR_Attr] & AM_DIR) {		/* It is a directory */
+				if (OBJ_ATTR(&dj) & AM_DIR) {		/* It is a directory */
 					res = FR_NO_FILE;
 				} else {
-					if ((mode & FA_WRITE) && (dir[DIR_Attr] & AM_RDO)) /* R/O violation */
+					if ((mode & FA_WRITE) && (OBJ_ATTR(&dj) & AM_RDO)) /* R/O violation */
 						res = FR_DENIED;
 				}
 			}
@@ -2371,6 +3828,11 @@ FRESULT f_open (
 				mode |= FA__WRITTEN;
 			fp->dir_sect = dj.fs->winsect;			/* Pointer to the directory entry */
 			fp->dir_ptr = dir;
+#if _FS_EXFAT
+			fp->dir_sclust = dj.sclust;			/* Where the entry set is (exFAT) */
+			fp->dir_cend = dj.cend;
+			fp->dir_index = dj.xindex;
+#endif
 #if _FS_LOCK
 			fp->lockid = inc_lock(&dj, (mode & ~FA_READ) ? 1 : 0);
 			if (!fp->lockid) res = FR_INT_ERR;
@@ -2383,7 +3845,7 @@ FRESULT f_open (
 			if (!dir) {						/* Current dir itself */
 				res = FR_INVALID_NAME;
 			} else {
-				if (dir[DIR_Attr] & AM_DIR)	/* It is a directory */
+				if (OBJ_ATTR(&dj) & AM_DIR)	/* It is a directory */
 					res = FR_NO_FILE;
 			}
 		}
@@ -2394,10 +3856,22 @@ FRESULT f_open (
 			fp->flag = mode;					/* File access mode */
 			fp->sclust = ld_clust(dj.fs, dir);	/* File start cluster */
 			fp->fsize = LD_DWORD(dir+DIR_FileSize);	/* File size */
+#if _FS_EXFAT
+			fp->cend = 0;
+			if (dj.fs->fs_type == FS_EXFAT) {	/* From the entry set, the file ends at the valid data */
+				fp->sclust = LD_DWORD(dj.xent+XDIR_FstClus);
+				fp->fsize = LD_QWORD(dj.xent+XDIR_ValidFileSize);
+				fp->cend = xdir_cend(dj.fs, dj.xent);
+			}
+#endif
 			fp->fptr = 0;						/* File pointer */
 			fp->dsect = 0;
 #if _USE_FASTSEEK
 			fp->cltbl = 0;						/* Normal seek mode */
+#endif
+#if _USE_EXTCACHE
+			fp->ext_ncl = 0; fp->ext_n = 0;		/* Empty extent cache */
+			if (fp->sclust) ext_add(fp, 0, fp->sclust);
 #endif
 			fp->fs = dj.fs; fp->id = dj.fs->id;	/* Validate file object */
 		}
@@ -2421,9 +3895,10 @@ FRESULT f_read (
 )
 {
 	FRESULT res;
-	DWORD clst, sect, remain;
-	UINT rcnt, cc;
-	BYTE csect, *rbuff = buff;
+	DWORD clst, sect;
+	FSIZE_t remain;
+	UINT rcnt, cc, csect;
+	BYTE *rbuff = buff;
 
 
 	*br = 0;	/* Clear read byte counter */
@@ -2440,7 +3915,7 @@ FRESULT f_read (
 	for ( ;  btr;								/* Repeat until all data read */
 		rbuff += rcnt, fp->fptr += rcnt, *br += rcnt, btr -= rcnt) {
 		if ((fp->fptr % SS(fp->fs)) == 0) {		/* On the sector boundary? */
-			csect = (BYTE)(fp->fptr / SS(fp->fs) & (fp->fs->csize - 1));	/* Sector offset in the cluster */
+			csect = (UINT)((DWORD)(fp->fptr / SS(fp->fs)) & (fp->fs->csize - 1));	/* Sector offset in the cluster */
 			if (!csect) {						/* On the cluster boundary? */
 				if (fp->fptr == 0) {			/* On the top of the file? */
 					clst = fp->sclust;			/* Follow from the origin */
@@ -2450,7 +3925,11 @@ FRESULT f_read (
 						clst = clmt_clust(fp, fp->fptr);	/* Get cluster# from the CLMT */
 					else
 #endif
-						clst = get_fat(fp->fs, fp->clust);	/* Follow cluster chain on the FAT */
+#if _USE_EXTCACHE
+						clst = ext_next(fp, (DWORD)(fp->fptr / SS(fp->fs) / fp->fs->csize), fp->clust, 0);	/* Look up the extent cache */
+#else
+						clst = FOLLOW_CLUST(fp, fp->clust);	/* Follow cluster chain */
+#endif
 				}
 				if (clst < 2) ABORT(fp->fs, FR_INT_ERR);
 				if (clst == 0xFFFFFFFF) ABORT(fp->fs, FR_DISK_ERR);
@@ -2461,14 +3940,29 @@ FRESULT f_read (
 			sect += csect;
 			cc = btr / SS(fp->fs);				/* When remaining bytes >= sector size, */
 			if (cc) {							/* Read maximum contiguous sectors directly */
+#if _USE_EXTCACHE
+				if (csect + cc > fp->fs->csize) {	/* Clip at the end of the contiguous clusters */
+					clst = ext_run(fp, (csect + cc + fp->fs->csize - 1) / fp->fs->csize, 0);
+					if (clst == 0xFFFFFFFF) ABORT(fp->fs, FR_DISK_ERR);
+					if (csect + cc > clst * fp->fs->csize)
+						cc = clst * fp->fs->csize - csect;
+				}
+#else
 				if (csect + cc > fp->fs->csize)	/* Clip at cluster boundary */
 					cc = fp->fs->csize - csect;
-				if (disk_read(fp->fs->drv, rbuff, sect, (BYTE)cc) != RES_OK)
+#endif
+				if (disk_read(fp->fs->drv, rbuff, sect, cc) != RES_OK)
 					ABORT(fp->fs, FR_DISK_ERR);
+#if _USE_EXTCACHE
+				fp->clust += (csect + cc - 1) / fp->fs->csize;	/* Cluster of the last sector read */
+#endif
 #if !_FS_READONLY && _FS_MINIMIZE <= 2			/* Replace one of the read sectors with cached data if it contains a dirty sector */
 #if _FS_TINY
 				if (fp->fs->wflag && fp->fs->winsect - sect < cc)
 					mem_cpy(rbuff + ((fp->fs->winsect - sect) * SS(fp->fs)), fp->fs->win, SS(fp->fs));
+#if _USE_WINCACHE
+				wc_direct(fp->fs, rbuff, sect, cc, 0);
+#endif
 #else
 				if ((fp->flag & FA__DIRTY) && fp->dsect - sect < cc)
 					mem_cpy(rbuff + ((fp->dsect - sect) * SS(fp->fs)), fp->buf, SS(fp->fs));
@@ -2523,9 +4017,8 @@ FRESULT f_write (
 {
 	FRESULT res;
 	DWORD clst, sect;
-	UINT wcnt, cc;
+	UINT wcnt, cc, csect;
 	const BYTE *wbuff = buff;
-	BYTE csect;
 
 
 	*bw = 0;	/* Clear write byte counter */
@@ -2536,24 +4029,38 @@ FRESULT f_write (
 		LEAVE_FF(fp->fs, FR_INT_ERR);
 	if (!(fp->flag & FA_WRITE))				/* Check access mode */
 		LEAVE_FF(fp->fs, FR_DENIED);
+#if _FS_EXFAT
+	if (fp->fs->fs_type != FS_EXFAT)
+#endif
 	if ((DWORD)(fp->fsize + btw) < fp->fsize) btw = 0;	/* File size cannot reach 4GB */
 
 	for ( ;  btw;							/* Repeat until all data written */
 		wbuff += wcnt, fp->fptr += wcnt, *bw += wcnt, btw -= wcnt) {
 		if ((fp->fptr % SS(fp->fs)) == 0) {	/* On the sector boundary? */
-			csect = (BYTE)(fp->fptr / SS(fp->fs) & (fp->fs->csize - 1));	/* Sector offset in the cluster */
+			csect = (UINT)((DWORD)(fp->fptr / SS(fp->fs)) & (fp->fs->csize - 1));	/* Sector offset in the cluster */
 			if (!csect) {					/* On the cluster boundary? */
+#if _USE_FREEMAP
+				fp->fs->alloc_hint = (btw - 1) / ((DWORD)fp->fs->csize * SS(fp->fs)) + 1;	/* Clusters left to write */
+#endif
 				if (fp->fptr == 0) {		/* On the top of the file? */
 					clst = fp->sclust;		/* Follow from the origin */
-					if (clst == 0)			/* When no cluster is allocated, */
-						fp->sclust = clst = create_chain(fp->fs, 0);	/* Create a new cluster chain */
+					if (clst == 0) {		/* When no cluster is allocated, */
+						fp->sclust = clst = STRETCH_CLUST(fp, 0);	/* Create a new cluster chain */
+#if _USE_EXTCACHE
+						if (clst >= 2 && clst != 0xFFFFFFFF) ext_add(fp, 0, clst);
+#endif
+					}
 				} else {					/* Middle or end of the file */
 #if _USE_FASTSEEK
 					if (fp->cltbl)
 						clst = clmt_clust(fp, fp->fptr);	/* Get cluster# from the CLMT */
 					else
 #endif
-						clst = create_chain(fp->fs, fp->clust);	/* Follow or stretch cluster chain on the FAT */
+#if _USE_EXTCACHE
+						clst = ext_next(fp, (DWORD)(fp->fptr / SS(fp->fs) / fp->fs->csize), fp->clust, 1);	/* Look up the extent cache or stretch the chain */
+#else
+						clst = STRETCH_CLUST(fp, fp->clust);	/* Follow or stretch cluster chain */
+#endif
 				}
 				if (clst == 0) break;		/* Could not allocate a new cluster (disk full) */
 				if (clst == 1) ABORT(fp->fs, FR_INT_ERR);
@@ -2575,15 +4082,30 @@ FRESULT f_write (
 			sect += csect;
 			cc = btw / SS(fp->fs);			/* When remaining bytes >= sector size, */
 			if (cc) {						/* Write maximum contiguous sectors directly */
+#if _USE_EXTCACHE
+				if (csect + cc > fp->fs->csize) {	/* Clip at the end of the contiguous clusters, allocating ahead */
+					clst = ext_run(fp, (csect + cc + fp->fs->csize - 1) / fp->fs->csize, 1);
+					if (clst == 0xFFFFFFFF) ABORT(fp->fs, FR_DISK_ERR);
+					if (csect + cc > clst * fp->fs->csize)
+						cc = clst * fp->fs->csize - csect;
+				}
+#else
 				if (csect + cc > fp->fs->csize)	/* Clip at cluster boundary */
 					cc = fp->fs->csize - csect;
-				if (disk_write(fp->fs->drv, wbuff, sect, (BYTE)cc) != RES_OK)
+#endif
+				if (disk_write(fp->fs->drv, wbuff, sect, cc) != RES_OK)
 					ABORT(fp->fs, FR_DISK_ERR);
+#if _USE_EXTCACHE
+				fp->clust += (csect + cc - 1) / fp->fs->csize;	/* Cluster of the last sector written */
+#endif
 #if _FS_TINY
 				if (fp->fs->winsect - sect < cc) {	/* Refill sector cache if it gets invalidated by the direct write */
 					mem_cpy(fp->fs->win, wbuff + ((fp->fs->winsect - sect) * SS(fp->fs)), SS(fp->fs));
 					fp->fs->wflag = 0;
 				}
+#if _USE_WINCACHE
+				wc_direct(fp->fs, (BYTE*)wbuff, sect, cc, 1);
+#endif
 #else
 				if (fp->dsect - sect < cc) { /* Refill sector cache if it gets invalidated by the direct write */
 					mem_cpy(fp->buf, wbuff + ((fp->dsect - sect) * SS(fp->fs)), SS(fp->fs));
@@ -2622,6 +4144,9 @@ FRESULT f_write (
 
 	if (fp->fptr > fp->fsize) fp->fsize = fp->fptr;	/* Update file size if needed */
 	fp->flag |= FA__WRITTEN;						/* Set file change flag */
+#if _USE_FREEMAP
+	fp->fs->alloc_hint = 0;
+#endif
 
 	LEAVE_FF(fp->fs, FR_OK);
 }
@@ -2640,6 +4165,9 @@ FRESULT f_sync (
 	FRESULT res;
 	DWORD tim;
 	BYTE *dir;
+#if _FS_EXFAT
+	DIR dj;
+#endif
 
 
 	res = validate(fp);					/* Check validity of the object */
@@ -2651,6 +4179,27 @@ FRESULT f_sync (
 					LEAVE_FF(fp->fs, FR_DISK_ERR);
 				fp->flag &= ~FA__DIRTY;
 			}
+#endif
+#if _FS_EXFAT
+			if (fp->fs->fs_type == FS_EXFAT) {	/* Update the entry set */
+				dj.fs = fp->fs;
+				dj.sclust = fp->dir_sclust; dj.cend = fp->dir_cend; dj.xindex = fp->dir_index;
+				res = xdir_load(&dj);
+				if (res == FR_OK) {
+					dj.xent[XDIR_Attr] |= AM_ARC;						/* Set archive bit */
+					dj.xent[XDIR_GenFlags] = fp->cend ? XGF_ALLOC | XGF_NOFAT : XGF_ALLOC;
+					ST_DWORD(dj.xent+XDIR_FstClus, fp->sclust);		/* Update start cluster */
+					ST_QWORD(dj.xent+XDIR_FileSize, fp->fsize);		/* Update file size */
+					ST_QWORD(dj.xent+XDIR_ValidFileSize, fp->fsize);
+					ST_DWORD(dj.xent+XDIR_ModTime, get_fattime());	/* Update updated time */
+					res = xdir_store(&dj);
+				}
+				if (res == FR_OK) {
+					fp->flag &= ~FA__WRITTEN;
+					res = sync(fp->fs);
+				}
+				LEAVE_FF(fp->fs, res);
+			}
 #endif
 			/* Update the directory entry */
 			res = move_window(fp->fs, fp->dir_sect);
@@ -2705,11 +4254,11 @@ FRESULT f_close (
 		FATFS *fs = fp->fs;;
 		res = validate(fp);
 		if (res == FR_OK) {
-			res = dec_lock(fp->lockid);	
+			res = dec_lock(fp->fs, fp->lockid);	
 			unlock_fs(fs, FR_OK);
 		}
 #else
-		res = dec_lock(fp->lockid);
+		res = dec_lock(fp->fs, fp->lockid);
 #endif
 	}
 #endif
@@ -2758,11 +4307,21 @@ FRESULT f_chdir (
 			if (!dj.dir) {
 				dj.fs->cdir = dj.sclust;	/* Start directory itself */
 			} else {
-				if (dj.dir[DIR_Attr] & AM_DIR)	/* Reached to the directory */
+				if (OBJ_ATTR(&dj) & AM_DIR)	/* Reached to the directory */
 					dj.fs->cdir = ld_clust(dj.fs, dj.dir);
 				else
 					res = FR_NO_PATH;		/* Reached but a file */
 			}
+#if _FS_EXFAT
+			if (res == FR_OK && dj.fs->fs_type == FS_EXFAT) {	/* Keep where the directory and its entry set are */
+				if (dj.dir) xdir_enter(&dj);
+				dj.fs->cdir = dj.sclust;
+				dj.fs->cdc_cend = dj.cend;
+				dj.fs->cdc_pclust = dj.pclust;
+				dj.fs->cdc_pcend = dj.pcend;
+				dj.fs->cdc_pindex = dj.pindex;
+			}
+#endif
 		}
 		if (res == FR_NO_FILE) res = FR_NO_PATH;
 	}
@@ -2793,6 +4352,11 @@ FRESULT f_getcwd (
 		i = sz_path;		/* Bottom of buffer (dir stack base) */
 		dj.sclust = dj.fs->cdir;			/* Start to follow upper dir from current dir */
 		while ((ccl = dj.sclust) != 0) {	/* Repeat while current dir is a sub-dir */
+#if _FS_EXFAT
+			if (dj.fs->fs_type == FS_EXFAT) {	/* No ".." entry to go up with */
+				res = FR_DENIED; break;
+			}
+#endif
 			res = dir_sdi(&dj, 1);			/* Get parent dir */
 			if (res != FR_OK) break;
 			res = dir_read(&dj);
@@ -2852,7 +4416,7 @@ FRESULT f_getcwd (
 
 FRESULT f_lseek (
 	FIL *fp,		/* Pointer to the file object */
-	DWORD ofs		/* File pointer from top of file */
+	FSIZE_t ofs		/* File pointer from top of file */
 )
 {
 	FRESULT res;
@@ -2877,7 +4441,7 @@ FRESULT f_lseek (
 					tcl = cl; ncl = 0; ulen += 2;	/* Top, length and used items */
 					do {
 						pcl = cl; ncl++;
-						cl = get_fat(fp->fs, cl);
+						cl = FOLLOW_CLUST(fp, cl);
 						if (cl <= 1) ABORT(fp->fs, FR_INT_ERR);
 						if (cl == 0xFFFFFFFF) ABORT(fp->fs, FR_DISK_ERR);
 					} while (cl == pcl + 1);
@@ -2900,7 +4464,7 @@ FRESULT f_lseek (
 				fp->clust = clmt_clust(fp, ofs - 1);
 				dsc = clust2sect(fp->fs, fp->clust);
 				if (!dsc) ABORT(fp->fs, FR_INT_ERR);
-				dsc += (ofs - 1) / SS(fp->fs) & (fp->fs->csize - 1);
+				dsc += (DWORD)((ofs - 1) / SS(fp->fs)) & (fp->fs->csize - 1);
 				if (fp->fptr % SS(fp->fs) && dsc != fp->dsect) {	/* Refill sector cache if needed */
 #if !_FS_TINY
 #if !_FS_READONLY
@@ -2922,57 +4486,92 @@ FRESULT f_lseek (
 
 	/* Normal Seek */
 	{
-		DWORD clst, bcs, nsect, ifptr;
+		DWORD clst, bcs, nsect;
+		FSIZE_t ifptr;
 
 		if (ofs > fp->fsize					/* In read-only mode, clip offset with the file size */
 #if !_FS_READONLY
 			 && !(fp->flag & FA_WRITE)
 #endif
 			) ofs = fp->fsize;
+#if _FS_EXFAT
+		if (fp->fs->fs_type != FS_EXFAT && ofs > 0xFFFFFFFF)	/* Clip offset at the 4GB limit of FAT */
+			ofs = 0xFFFFFFFF;
+#endif
 
 		ifptr = fp->fptr;
 		fp->fptr = nsect = 0;
 		if (ofs) {
 			bcs = (DWORD)fp->fs->csize * SS(fp->fs);	/* Cluster size (byte) */
+#if _USE_FREEMAP
+			if (fp->flag & FA_WRITE)
+				fp->fs->alloc_hint = (DWORD)((ofs - 1) / bcs + 1);	/* Expanding the file wants one run */
+#endif
 			if (ifptr > 0 &&
 				(ofs - 1) / bcs >= (ifptr - 1) / bcs) {	/* When seek to same or following cluster, */
-				fp->fptr = (ifptr - 1) & ~(bcs - 1);	/* start from the current cluster */
+				fp->fptr = (ifptr - 1) & ~(FSIZE_t)(bcs - 1);	/* start from the current cluster */
 				ofs -= fp->fptr;
 				clst = fp->clust;
 			} else {									/* When seek to back cluster, */
 				clst = fp->sclust;						/* start from the first cluster */
 #if !_FS_READONLY
 				if (clst == 0) {						/* If no cluster chain, create a new chain */
-					clst = create_chain(fp->fs, 0);
+					clst = STRETCH_CLUST(fp, 0);
 					if (clst == 1) ABORT(fp->fs, FR_INT_ERR);
 					if (clst == 0xFFFFFFFF) ABORT(fp->fs, FR_DISK_ERR);
 					fp->sclust = clst;
+#if _USE_EXTCACHE
+					ext_add(fp, 0, clst);
+#endif
 				}
 #endif
 				fp->clust = clst;
 			}
+#if _USE_EXTCACHE
+			if (clst != 0 && fp->ext_ncl) {				/* Jump ahead on the cached part of the chain */
+				DWORD ci = (DWORD)(fp->fptr / bcs), tci = (DWORD)((fp->fptr + ofs - 1) / bcs);
+
+				if (tci >= fp->ext_ncl) tci = fp->ext_ncl - 1;
+				if (tci > ci) {
+					clst = fp->clust = ext_find(fp, tci);
+					fp->fptr += (tci - ci) * bcs;
+					ofs -= (tci - ci) * bcs;
+				}
+			}
+#endif
 			if (clst != 0) {
 				while (ofs > bcs) {						/* Cluster following loop */
 #if !_FS_READONLY
 					if (fp->flag & FA_WRITE) {			/* Check if in write mode or not */
-						clst = create_chain(fp->fs, clst);	/* Force stretch if in write mode */
+#if _USE_EXTCACHE
+						clst = ext_next(fp, (DWORD)(fp->fptr / bcs) + 1, clst, 1);
+#else
+						clst = STRETCH_CLUST(fp, clst);	/* Force stretch if in write mode */
+#endif
 						if (clst == 0) {				/* When disk gets full, clip file size */
 							ofs = bcs; break;
 						}
 					} else
 #endif
-						clst = get_fat(fp->fs, clst);	/* Follow cluster chain if not in write mode */
+#if _USE_EXTCACHE
+						clst = ext_next(fp, (DWORD)(fp->fptr / bcs) + 1, clst, 0);
+#else
+						clst = FOLLOW_CLUST(fp, clst);	/* Follow cluster chain if not in write mode */
+#endif
 					if (clst == 0xFFFFFFFF) ABORT(fp->fs, FR_DISK_ERR);
 					if (clst <= 1 || clst >= fp->fs->n_fatent) ABORT(fp->fs, FR_INT_ERR);
 					fp->clust = clst;
 					fp->fptr += bcs;
 					ofs -= bcs;
 				}
+#if _USE_FREEMAP
+				fp->fs->alloc_hint = 0;
+#endif
 				fp->fptr += ofs;
 				if (ofs % SS(fp->fs)) {
 					nsect = clust2sect(fp->fs, clst);	/* Current sector */
 					if (!nsect) ABORT(fp->fs, FR_INT_ERR);
-					nsect += ofs / SS(fp->fs);
+					nsect += (DWORD)(ofs / SS(fp->fs));
 				}
 			}
 		}
@@ -3028,8 +4627,11 @@ FRESULT f_opendir (
 		FREE_BUF();
 		if (res == FR_OK) {						/* Follow completed */
 			if (dj->dir) {						/* It is not the root dir */
-				if (dj->dir[DIR_Attr] & AM_DIR) {	/* The object is a directory */
+				if (OBJ_ATTR(dj) & AM_DIR) {	/* The object is a directory */
 					dj->sclust = ld_clust(fs, dj->dir);
+#if _FS_EXFAT
+					if (fs->fs_type == FS_EXFAT) xdir_enter(dj);
+#endif
 				} else {						/* The object is not a directory */
 					res = FR_NO_PATH;
 				}
@@ -3154,13 +4756,32 @@ FRESULT f_getfree (
 			/* Get number of free clusters */
 			fat = fs->fs_type;
 			n = 0;
+#if _USE_FREEMAP
+			mem_set(fs->fmap, 0xFF, _FREEMAP_SIZE);	/* Build the free cluster map on the way */
+#endif
+#if _FS_EXFAT
+			if (fat == FS_EXFAT) {		/* Count clear bits on the allocation bitmap */
+				for (clst = 0; clst < fs->n_fatent - 2; clst++) {
+					if (!(clst % (SS(fs) * 8))) {
+						res = move_window(fs, fs->bitbase + clst / (SS(fs) * 8));
+						if (res != FR_OK) break;
+					}
+					if (!(fs->win[clst / 8 % SS(fs)] & (1 << (clst % 8)))) n++;
+				}
+			} else
+#endif
 			if (fat == FS_FAT12) {
 				clst = 2;
 				do {
 					stat = get_fat(fs, clst);
 					if (stat == 0xFFFFFFFF) { res = FR_DISK_ERR; break; }
 					if (stat == 1) { res = FR_INT_ERR; break; }
-					if (stat == 0) n++;
+					if (stat == 0) {
+						n++;
+#if _USE_FREEMAP
+						fmap_clear(fs, clst);
+#endif
+					}
 				} while (++clst < fs->n_fatent);
 			} else {
 				clst = fs->n_fatent;
@@ -3174,14 +4795,23 @@ FRESULT f_getfree (
 						i = SS(fs);
 					}
 					if (fat == FS_FAT16) {
-						if (LD_WORD(p) == 0) n++;
+						stat = LD_WORD(p);
 						p += 2; i -= 2;
 					} else {
-						if ((LD_DWORD(p) & 0x0FFFFFFF) == 0) n++;
+						stat = LD_DWORD(p) & 0x0FFFFFFF;
 						p += 4; i -= 4;
 					}
+					if (stat == 0) {
+						n++;
+#if _USE_FREEMAP
+						fmap_clear(fs, fs->n_fatent - clst);
+#endif
+					}
 				} while (--clst);
 			}
+#if _USE_FREEMAP
+			if (res != FR_OK) mem_set(fs->fmap, 0, _FREEMAP_SIZE);	/* Incomplete scan, forget it */
+#endif
 			fs->free_clust = n;
 			if (fat == FS_FAT32) fs->fsi_flag = 1;
 			*nclst = n;
@@ -3220,16 +4850,28 @@ FRESULT f_truncate (
 		if (fp->fsize > fp->fptr) {
 			fp->fsize = fp->fptr;	/* Set file size to current R/W point */
 			fp->flag |= FA__WRITTEN;
+#if _USE_EXTCACHE
+			ext_trim(fp, (DWORD)((fp->fptr + (DWORD)fp->fs->csize * SS(fp->fs) - 1) / ((DWORD)fp->fs->csize * SS(fp->fs))));
+#endif
 			if (fp->fptr == 0) {	/* When set file size to zero, remove entire cluster chain */
-				res = remove_chain(fp->fs, fp->sclust);
+				res = REMOVE_CHAIN(fp);
 				fp->sclust = 0;
+#if _FS_EXFAT
+				fp->cend = 0;
+			} else if (fp->cend) {	/* Contiguous on exFAT, free the clusters after the current one */
+				res = FR_OK;
+				if (fp->cend > fp->clust) {
+					res = remove_xchain(fp->fs, fp->clust + 1, fp->cend);
+					fp->cend = fp->clust;
+				}
+#endif
 			} else {				/* When truncate a part of the file, remove remaining clusters */
 				ncl = get_fat(fp->fs, fp->clust);
 				res = FR_OK;
 				if (ncl == 0xFFFFFFFF) res = FR_DISK_ERR;
 				if (ncl == 1) res = FR_INT_ERR;
 				if (res == FR_OK && ncl < fp->fs->n_fatent) {
-					res = put_fat(fp->fs, fp->clust, 0x0FFFFFFF);
+					res = put_fat(fp->fs, fp->clust, 0xFFFFFFFF);
 					if (res == FR_OK) res = remove_chain(fp->fs, ncl);
 				}
 			}
@@ -3243,6 +4885,144 @@ FRESULT f_truncate (
 
 
 
+#if _USE_EXPAND
+/*-----------------------------------------------------------------------*/
+/* Allocate a Contiguous Block to the File                               */
+/*-----------------------------------------------------------------------*/
+
+static
+DWORD find_run (	/* 0:No run that long, 1:Internal error, 0xFFFFFFFF:Disk error, >=2:Top of the run */
+	FATFS *fs,		/* File system object */
+	DWORD stcl,		/* Cluster# to start the search at */
+	DWORD tcl		/* Number of contiguous free clusters wanted */
+)
+{
+	DWORD clst, scl, ncl, cs;
+	BYTE back = 0;
+#if _USE_FREEMAP
+	DWORD mask = ((DWORD)1 << fs->fmap_shift) - 1;
+#endif
+
+
+	scl = clst = stcl; ncl = 0;
+	for (;;) {
+#if _FS_EXFAT
+		if (fs->fs_type == FS_EXFAT) {	/* Look at the allocation bitmap */
+			cs = clst - 2;
+			if (move_window(fs, fs->bitbase + cs / 8 / SS(fs))) return 0xFFFFFFFF;
+			cs = fs->win[cs / 8 % SS(fs)] & (1 << (cs % 8));
+		} else
+#endif
+		{
+#if _USE_FREEMAP
+			if (fmap_full(fs, clst) && (stcl < (clst & ~mask) || stcl > (clst | mask))) {
+				cs = clst | mask;		/* Skip the group known to have no free cluster */
+				clst = (cs < fs->n_fatent - 1) ? cs : fs->n_fatent - 1;
+				cs = 1;
+			} else
+#endif
+			{
+				cs = get_fat(fs, clst);
+				if (cs == 0xFFFFFFFF || cs == 1) return cs;
+			}
+		}
+		if (cs == 0) {					/* A free cluster */
+			if (++ncl == tcl) return scl;
+		} else {						/* In use, a run can start at the next one */
+			scl = clst + 1; ncl = 0;
+		}
+		if (++clst >= fs->n_fatent) {	/* Wrap around, a run does not */
+			scl = clst = 2; ncl = 0;
+		}
+		if (clst == stcl) back = 1;		/* Came round to the start point, */
+		if (back && !ncl) return 0;		/* a run that reaches it is still followed to its end */
+	}
+}
+
+
+FRESULT f_expand (
+	FIL* fp,		/* Pointer to the file object, opened for writing and still empty */
+	FSIZE_t fsz,	/* File size to be reserved */
+	BYTE opt		/* 0:Find the run and let the following writes take it, 1:Allocate it now */
+)
+{
+	FRESULT res;
+	FATFS *fs;
+	DWORD bcs, tcl, scl, clst, fcl;
+
+
+	res = validate(fp);						/* Check validity of the object */
+	if (res != FR_OK) LEAVE_FF(fp->fs, res);
+	fs = fp->fs;
+	if (fp->flag & FA__ERROR)				/* Check abort flag */
+		LEAVE_FF(fs, FR_INT_ERR);
+	if (!(fp->flag & FA_WRITE) || fp->fsize || fp->sclust || !fsz)	/* Only an empty file can be expanded */
+		LEAVE_FF(fs, FR_DENIED);
+#if _FS_EXFAT
+	if (fs->fs_type != FS_EXFAT && fsz > 0xFFFFFFFF)	/* Beyond the 4GB limit of FAT */
+		LEAVE_FF(fs, FR_DENIED);
+#endif
+	bcs = (DWORD)fs->csize * SS(fs);
+	tcl = (DWORD)((fsz + bcs - 1) / bcs);	/* Number of clusters required */
+	if (tcl > fs->n_fatent - 2) LEAVE_FF(fs, FR_DENIED);
+
+	clst = fs->last_clust;					/* Search from the suggested start point */
+	if (clst < 2 || clst >= fs->n_fatent) clst = 2;
+	scl = find_run(fs, clst, tcl);
+	if (scl == 0) LEAVE_FF(fs, FR_DENIED);	/* No contiguous space that long */
+	if (scl == 1) ABORT(fs, FR_INT_ERR);
+	if (scl == 0xFFFFFFFF) ABORT(fs, FR_DISK_ERR);
+
+	if (!opt) {								/* Point the allocator at the run */
+		fs->last_clust = scl - 1;
+		LEAVE_FF(fs, FR_OK);
+	}
+
+#if _FS_EXFAT
+	if (fs->fs_type == FS_EXFAT) {			/* Mark the run in use, it needs no FAT chain */
+		res = change_bitmap(fs, scl, tcl, 1);
+		fp->cend = scl + tcl - 1;
+	} else
+#endif
+	{
+		for (clst = scl; res == FR_OK && clst < scl + tcl - 1; clst++)	/* Link the run on the FAT */
+			res = put_fat(fs, clst, clst + 1);
+		if (res == FR_OK) res = put_fat(fs, clst, 0x0FFFFFFF);
+	}
+	if (res != FR_OK) {						/* Give back what was taken before the error */
+		fcl = fs->free_clust;				/* the run was counted free all along */
+#if _FS_EXFAT
+		if (fs->fs_type == FS_EXFAT)
+			change_bitmap(fs, scl, tcl, 0);
+		else
+#endif
+			remove_chain(fs, scl);			/* the part linked so far ends at a free entry */
+		fs->free_clust = fcl;
+		ABORT(fs, res);
+	}
+
+	fs->last_clust = scl + tcl - 1;
+	if (fs->free_clust != 0xFFFFFFFF) {
+		fs->free_clust -= tcl;
+		fs->fsi_flag = 1;
+	}
+#if _USE_EXTCACHE
+	fp->ext_clst[0] = scl;					/* The whole chain is one extent */
+	fp->ext_len[0] = tcl;
+	fp->ext_n = 1;
+	fp->ext_ncl = tcl;
+#endif
+	fp->sclust = scl;						/* The file has the run and its size now */
+	fp->fsize = fsz;
+	fp->flag |= FA__WRITTEN;
+
+	LEAVE_FF(fs, FR_OK);
+}
+#endif /* _USE_EXPAND */
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Delete a File or Directory                                            */
 /*-----------------------------------------------------------------------*/
@@ -3255,6 +5035,9 @@ FRESULT f_unlink (
 	DIR dj, sdj;
 	BYTE *dir;
 	DWORD dclst;
+#if _FS_EXFAT
+	DWORD dcend = 0;
+#endif
 	DEF_NAMEBUF;
 
 
@@ -3272,33 +5055,60 @@ FRESULT f_unlink (
 			if (!dir) {
 				res = FR_INVALID_NAME;		/* Cannot remove the start directory */
 			} else {
-				if (dir[DIR_Attr] & AM_RDO)
+				if (OBJ_ATTR(&dj) & AM_RDO)
 					res = FR_DENIED;		/* Cannot remove R/O object */
 			}
 			dclst = ld_clust(dj.fs, dir);
-			if (res == FR_OK && (dir[DIR_Attr] & AM_DIR)) {	/* Is it a sub-dir? */
+#if _FS_EXFAT
+			if (dj.fs->fs_type == FS_EXFAT) {
+				dclst = LD_DWORD(dj.xent+XDIR_FstClus);
+				dcend = xdir_cend(dj.fs, dj.xent);
+			}
+#endif
+			if (res == FR_OK && (OBJ_ATTR(&dj) & AM_DIR)) {	/* Is it a sub-dir? */
 				if (dclst < 2) {
 					res = FR_INT_ERR;
 				} else {
 					mem_cpy(&sdj, &dj, sizeof (DIR));	/* Check if the sub-dir is empty or not */
 					sdj.sclust = dclst;
-					res = dir_sdi(&sdj, 2);		/* Exclude dot entries */
-					if (res == FR_OK) {
-						res = dir_read(&sdj);
-						if (res == FR_OK		/* Not empty dir */
-#if _FS_RPATH
-						|| dclst == dj.fs->cdir	/* Current dir */
+#if _FS_EXFAT
+					sdj.cend = dcend;
+					if (dj.fs->fs_type == FS_EXFAT) {	/* No dot entries, look for any file entry */
+						res = dir_sdi(&sdj, 0);
+						while (res == FR_OK) {
+							res = move_window(sdj.fs, sdj.sect);
+							if (res != FR_OK) break;
+							if (sdj.dir[XDIR_Type] == 0) res = FR_NO_FILE;
+							else if (sdj.dir[XDIR_Type] == ET_FILEDIR) break;
+							else res = dir_next(&sdj, 0);
+						}
+					} else
 #endif
-						) res = FR_DENIED;
-						if (res == FR_NO_FILE) res = FR_OK;	/* Empty */
+					{
+						res = dir_sdi(&sdj, 2);		/* Exclude dot entries */
+						if (res == FR_OK) res = dir_read(&sdj);
 					}
+					if (res == FR_OK		/* Not empty dir */
+#if _FS_RPATH
+					|| dclst == dj.fs->cdir	/* Current dir */
+#endif
+					) res = FR_DENIED;
+					if (res == FR_NO_FILE) res = FR_OK;	/* Empty */
 				}
 			}
 			if (res == FR_OK) {
 				res = dir_remove(&dj);		/* Remove the directory entry */
 				if (res == FR_OK) {
+#if _USE_DIRINDEX
+					if (dj.fs->dix_valid && dj.fs->dix_clu == dclst)	/* The indexed directory has gone */
+						dj.fs->dix_valid = 0;
+#endif
 					if (dclst)				/* Remove the cluster chain if exist */
+#if _FS_EXFAT
+						res = remove_xchain(dj.fs, dclst, dcend);
+#else
 						res = remove_chain(dj.fs, dclst);
+#endif
 					if (res == FR_OK) res = sync(dj.fs);
 				}
 			}
@@ -3321,8 +5131,12 @@ FRESULT f_mkdir (
 {
 	FRESULT res;
 	DIR dj;
-	BYTE *dir, n;
+	BYTE *dir;
+	UINT n;
 	DWORD dsc, dcl, pcl, tim = get_fattime();
+#if _FS_EXFAT
+	DWORD dcend = 0;
+#endif
 	DEF_NAMEBUF;
 
 
@@ -3334,7 +5148,11 @@ FRESULT f_mkdir (
 		if (_FS_RPATH && res == FR_NO_FILE && (dj.fn[NS] & NS_DOT))
 			res = FR_INVALID_NAME;
 		if (res == FR_NO_FILE) {				/* Can create a new directory */
+#if _FS_EXFAT
+			dcl = next_clust(dj.fs, 0, &dcend, 0, 1);	/* Allocate a cluster for the new directory table */
+#else
 			dcl = create_chain(dj.fs, 0);		/* Allocate a cluster for the new directory table */
+#endif
 			res = FR_OK;
 			if (dcl == 0) res = FR_DENIED;		/* No space to allocate a new cluster */
 			if (dcl == 1) res = FR_INT_ERR;
@@ -3355,6 +5173,10 @@ FRESULT f_mkdir (
 				if (dj.fs->fs_type == FS_FAT32 && pcl == dj.fs->dirbase)
 					pcl = 0;
 				st_clust(dir+SZ_DIR, pcl);
+#if _FS_EXFAT
+				if (dj.fs->fs_type == FS_EXFAT)		/* No dot entries on exFAT */
+					mem_set(dir, 0, SS(dj.fs));
+#endif
 				for (n = dj.fs->csize; n; n--) {	/* Write dot entries and clear following sectors */
 					dj.fs->winsect = dsc++;
 					dj.fs->wflag = 1;
@@ -3365,7 +5187,22 @@ FRESULT f_mkdir (
 			}
 			if (res == FR_OK) res = dir_register(&dj);	/* Register the object to the directoy */
 			if (res != FR_OK) {
+#if _FS_EXFAT
+				remove_xchain(dj.fs, dcl, dcend);	/* Could not register, remove cluster chain */
+#else
 				remove_chain(dj.fs, dcl);			/* Could not register, remove cluster chain */
+#endif
+#if _FS_EXFAT
+			} else if (dj.fs->fs_type == FS_EXFAT) {
+				dj.xent[XDIR_Attr] = AM_DIR;		/* Attribute */
+				ST_DWORD(dj.xent+XDIR_ModTime, tim);	/* Modified time */
+				ST_DWORD(dj.xent+XDIR_FstClus, dcl);	/* Table start cluster, one contiguous cluster */
+				dj.xent[XDIR_GenFlags] = XGF_ALLOC | XGF_NOFAT;
+				ST_QWORD(dj.xent+XDIR_FileSize, (DWORD)dj.fs->csize * SS(dj.fs));
+				ST_QWORD(dj.xent+XDIR_ValidFileSize, (DWORD)dj.fs->csize * SS(dj.fs));
+				res = xdir_store(&dj);
+				if (res == FR_OK) res = sync(dj.fs);
+#endif
 			} else {
 				dir = dj.dir;
 				dir[DIR_Attr] = AM_DIR;				/* Attribute */
@@ -3413,9 +5250,17 @@ FRESULT f_chmod (
 				res = FR_INVALID_NAME;
 			} else {						/* File or sub directory */
 				mask &= AM_RDO|AM_HID|AM_SYS|AM_ARC;	/* Valid attribute mask */
-				dir[DIR_Attr] = (value & mask) | (dir[DIR_Attr] & (BYTE)~mask);	/* Apply attribute change */
-				dj.fs->wflag = 1;
-				res = sync(dj.fs);
+#if _FS_EXFAT
+				if (dj.fs->fs_type == FS_EXFAT) {
+					dj.xent[XDIR_Attr] = (value & mask) | (dj.xent[XDIR_Attr] & (BYTE)~mask);
+					res = xdir_store(&dj);
+				} else
+#endif
+				{
+					dir[DIR_Attr] = (value & mask) | (dir[DIR_Attr] & (BYTE)~mask);	/* Apply attribute change */
+					dj.fs->wflag = 1;
+				}
+				if (res == FR_OK) res = sync(dj.fs);
 			}
 		}
 	}
@@ -3453,10 +5298,18 @@ FRESULT f_utime (
 			if (!dir) {					/* Root directory */
 				res = FR_INVALID_NAME;
 			} else {					/* File or sub-directory */
-				ST_WORD(dir+DIR_WrtTime, fno->ftime);
-				ST_WORD(dir+DIR_WrtDate, fno->fdate);
-				dj.fs->wflag = 1;
-				res = sync(dj.fs);
+#if _FS_EXFAT
+				if (dj.fs->fs_type == FS_EXFAT) {
+					ST_DWORD(dj.xent+XDIR_ModTime, (DWORD)fno->fdate << 16 | fno->ftime);
+					res = xdir_store(&dj);
+				} else
+#endif
+				{
+					ST_WORD(dir+DIR_WrtTime, fno->ftime);
+					ST_WORD(dir+DIR_WrtDate, fno->fdate);
+					dj.fs->wflag = 1;
+				}
+				if (res == FR_OK) res = sync(dj.fs);
 			}
 		}
 	}
@@ -3504,6 +5357,18 @@ FRESULT f_rename (
 				if (res == FR_NO_FILE) { 				/* Is it a valid path and no name collision? */
 /* Start critical section that an interruption or error can cause cross-link */
 					res = dir_register(&djn);			/* Register the new entry */
+#if _FS_EXFAT
+					if (res == FR_OK && djn.fs->fs_type == FS_EXFAT) {	/* Copy the object except for name, no ".." to update */
+						mem_cpy(djn.xent+XDIR_Attr, djo.xent+XDIR_Attr, SZ_DIR - XDIR_Attr);
+						djn.xent[XDIR_Attr] |= AM_ARC;
+						djn.xent[XDIR_GenFlags] = djo.xent[XDIR_GenFlags];
+						mem_cpy(djn.xent+XDIR_ValidFileSize, djo.xent+XDIR_ValidFileSize, 8);
+						mem_cpy(djn.xent+XDIR_FstClus, djo.xent+XDIR_FstClus, 4 + 8);
+						res = xdir_store(&djn);
+						if (res == FR_OK) res = dir_remove(&djo);
+						if (res == FR_OK) res = sync(djo.fs);
+					} else
+#endif
 					if (res == FR_OK) {
 						dir = djn.dir;					/* Copy object information except for name */
 						mem_cpy(dir+13, buf+2, 19);
@@ -3558,9 +5423,9 @@ FRESULT f_forward (
 )
 {
 	FRESULT res;
-	DWORD remain, clst, sect;
-	UINT rcnt;
-	BYTE csect;
+	DWORD clst, sect;
+	FSIZE_t remain;
+	UINT rcnt, csect;
 
 
 	*bf = 0;	/* Clear transfer byte counter */
@@ -3579,11 +5444,11 @@ FRESULT f_forward (
 
 	for ( ;  btr && (*func)(0, 0);					/* Repeat until all data transferred or stream becomes busy */
 		fp->fptr += rcnt, *bf += rcnt, btr -= rcnt) {
-		csect = (BYTE)(fp->fptr / SS(fp->fs) & (fp->fs->csize - 1));	/* Sector offset in the cluster */
+		csect = (UINT)((DWORD)(fp->fptr / SS(fp->fs)) & (fp->fs->csize - 1));	/* Sector offset in the cluster */
 		if ((fp->fptr % SS(fp->fs)) == 0) {			/* On the sector boundary? */
 			if (!csect) {							/* On the cluster boundary? */
 				clst = (fp->fptr == 0) ?			/* On the top of the file? */
-					fp->sclust : get_fat(fp->fs, fp->clust);
+					fp->sclust : FOLLOW_CLUST(fp, fp->clust);
 				if (clst <= 1) ABORT(fp->fs, FR_INT_ERR);
 				if (clst == 0xFFFFFFFF) ABORT(fp->fs, FR_DISK_ERR);
 				fp->clust = clst;					/* Update current cluster */
@@ -3612,7 +5477,9 @@ FRESULT f_forward (
 /* Create File System on the Drive                                       */
 /*-----------------------------------------------------------------------*/
 #define N_ROOTDIR	512		/* Number of root dir entries for FAT12/16 */
+#ifndef N_FATS
 #define N_FATS		1		/* Number of FAT copies (1 or 2) */
+#endif
 
 
 FRESULT f_mkfs (
@@ -72,12 +72,22 @@ typedef char TCHAR;
 
 
 
+/* Type of file size and offset */
+
+#if _FS_EXFAT
+typedef QWORD FSIZE_t;		/* exFAT files can exceed 4GB */
+#else
+typedef DWORD FSIZE_t;
+#endif
+
+
+
 /* File system object structure (FATFS) */
 
 typedef struct {
 	BYTE	fs_type;		/* FAT sub-type (0:Not mounted) */
 	BYTE	drv;			/* Physical drive number */
-	BYTE	csize;			/* Sectors per cluster (1,2,4...128) */
+	WORD	csize;			/* Sectors per cluster (1,2,4...32768) */
 	BYTE	n_fats;			/* Number of FAT copies (1,2) */
 	BYTE	wflag;			/* win[] dirty flag (1:must be written back) */
 	BYTE	fsi_flag;		/* fsinfo dirty flag (1:must be written back) */
@@ -89,19 +99,56 @@ typedef struct {
 #if _FS_REENTRANT
 	_SYNC_t	sobj;			/* Identifier of sync object */
 #endif
+#if _FS_LOCK
+	DWORD	flk_clu[_FS_LOCK];	/* File lock table: directory of each open file */
+	WORD	flk_idx[_FS_LOCK];	/* Its index in the directory */
+	WORD	flk_ctr[_FS_LOCK];	/* Open counter (0:blank entry, 0x01..0xFF:read open count, 0x100:write mode) */
+#endif
 #if !_FS_READONLY
 	DWORD	last_clust;		/* Last allocated cluster */
 	DWORD	free_clust;		/* Number of free clusters */
 	DWORD	fsi_sector;		/* fsinfo sector (FAT32) */
 #endif
+#if _USE_FREEMAP
+	DWORD	alloc_hint;		/* Number of clusters the pending write needs (0:unknown) */
+	BYTE	fmap_shift;		/* Clusters per free map bit (log2) */
+	BYTE	fmap[_FREEMAP_SIZE];	/* Free cluster map (1:group has no free cluster) */
+#endif
+#if _USE_DIRINDEX
+	BYTE	dix_valid;		/* Directory index valid flag (1:dix_clu is indexed) */
+	WORD	dix_free;		/* No blank entry below this index */
+	WORD	dix_used;		/* Index slots in use, deleted ones included */
+	DWORD	dix_clu;		/* Start cluster of the indexed directory */
+	WORD	dix_slot[_DIRINDEX_SIZE / 3];	/* Entry index + 1 (0:blank, 0xFFFF:deleted) */
+	BYTE	dix_tag[_DIRINDEX_SIZE / 3];	/* Upper bits of the name hash */
+#endif
 #if _FS_RPATH
 	DWORD	cdir;			/* Current directory start cluster (0:root) */
+#if _FS_EXFAT
+	DWORD	cdc_cend;		/* exFAT: Last cluster of the current directory if it is contiguous (0:on the FAT) */
+	DWORD	cdc_pclust;		/* exFAT: Start cluster of the directory holding its entry */
+	DWORD	cdc_pcend;		/* exFAT: Last cluster of that directory if it is contiguous */
+	WORD	cdc_pindex;		/* exFAT: Index of its entry set in that directory */
+#endif
 #endif
 	DWORD	n_fatent;		/* Number of FAT entries (= number of clusters + 2) */
 	DWORD	fsize;			/* Sectors per FAT */
 	DWORD	fatbase;		/* FAT start sector */
 	DWORD	dirbase;		/* Root directory start sector (FAT32:Cluster#) */
 	DWORD	database;		/* Data start sector */
+#if _FS_EXFAT
+	DWORD	bitbase;		/* Allocation bitmap start sector (exFAT) */
+#endif
+#if _USE_WINCACHE
+	DWORD	wc_hit;			/* Window requests served from memory */
+	DWORD	wc_miss;		/* Window requests read from the disk */
+	DWORD	wc_wrt;			/* Sectors written back from the window and its cache */
+	DWORD	wc_clock;		/* Use counter */
+	DWORD	wc_sect[_WINCACHE_WAYS];	/* Sector held in each cache line (0:empty) */
+	DWORD	wc_age[_WINCACHE_WAYS];		/* Last use of each cache line */
+	BYTE	wc_dirty[_WINCACHE_WAYS];	/* Cache line dirty flags (1:must be written back) */
+	BYTE	wc_buf[_WINCACHE_WAYS][_MAX_SS];	/* Sectors parked behind the window */
+#endif
 	DWORD	winsect;		/* Current sector appearing in the win[] */
 	BYTE	win[_MAX_SS];	/* Disk access window for Directory, FAT (and Data on tiny cfg) */
 } FATFS;
@@ -115,20 +162,34 @@ typedef struct {
 	WORD	id;				/* File system mount ID of the related file system object */
 	BYTE	flag;			/* File status flags */
 	BYTE	pad1;
-	DWORD	fptr;			/* File read/write pointer (0ed on file open) */
-	DWORD	fsize;			/* File size */
+	FSIZE_t	fptr;			/* File read/write pointer (0ed on file open) */
+	FSIZE_t	fsize;			/* File size */
 	DWORD	sclust;			/* File data start cluster (0:no data cluster, always 0 when fsize is 0) */
 	DWORD	clust;			/* Current cluster of fpter */
 	DWORD	dsect;			/* Current data sector of fpter */
+#if _FS_EXFAT
+	DWORD	cend;			/* exFAT: Last cluster if the chain is contiguous (0:on the FAT or no cluster) */
+#endif
 #if !_FS_READONLY
 	DWORD	dir_sect;		/* Sector containing the directory entry */
 	BYTE*	dir_ptr;		/* Pointer to the directory entry in the window */
+#if _FS_EXFAT
+	DWORD	dir_sclust;		/* exFAT: Start cluster of the directory holding the entry set (0:root) */
+	DWORD	dir_cend;		/* exFAT: Last cluster of that directory if it is contiguous */
+	WORD	dir_index;		/* exFAT: Index of the file entry of the set */
+#endif
 #endif
 #if _USE_FASTSEEK
 	DWORD*	cltbl;			/* Pointer to the cluster link map table (null on file open) */
 #endif
+#if _USE_EXTCACHE
+	DWORD	ext_ncl;		/* Number of clusters from top of the file covered by the extent cache */
+	BYTE	ext_n;			/* Number of extents in use */
+	DWORD	ext_clst[_EXTCACHE_SIZE];	/* First cluster of each extent */
+	DWORD	ext_len[_EXTCACHE_SIZE];	/* Number of clusters in each extent */
+#endif
 #if _FS_LOCK
-	UINT	lockid;			/* File lock ID (index of file semaphore table Files[]) */
+	UINT	lockid;			/* File lock ID (index of the file lock table of the volume + 1) */
 #endif
 #if !_FS_TINY
 	BYTE	buf[_MAX_SS];	/* File data read/write buffer */
@@ -152,6 +213,15 @@ typedef struct {
 	WCHAR*	lfn;			/* Pointer to the LFN working buffer */
 	WORD	lfn_idx;		/* Last matched LFN index number (0xFFFF:No LFN) */
 #endif
+#if _FS_EXFAT
+	DWORD	cend;			/* exFAT: Last cluster of the table if it is contiguous (0:on the FAT) */
+	DWORD	pclust;			/* exFAT: Start cluster of the directory holding the entry of this table */
+	DWORD	pcend;			/* exFAT: Last cluster of that directory if it is contiguous */
+	WORD	pindex;			/* exFAT: Index of the entry set of this table in that directory */
+	WORD	xindex;			/* exFAT: Index of the file entry of the found object */
+	BYTE	xgrow;			/* exFAT: Number of clusters dir_next() has added to the table */
+	BYTE	xent[64];		/* exFAT: File and stream extension entries of the found object */
+#endif
 } DIR;
 
 
@@ -159,7 +229,7 @@ typedef struct {
 /* File status structure (FILINFO) */
 
 typedef struct {
-	DWORD	fsize;			/* File size */
+	FSIZE_t	fsize;			/* File size */
 	WORD	fdate;			/* Last modified date */
 	WORD	ftime;			/* Last modified time */
 	BYTE	fattrib;		/* Attribute */
@@ -205,7 +275,7 @@ typedef enum {
 FRESULT f_mount (BYTE, FATFS*);						/* Mount/Unmount a logical drive */
 FRESULT f_open (FIL*, const TCHAR*, BYTE);			/* Open or create a file */
 FRESULT f_read (FIL*, void*, UINT, UINT*);			/* Read data from a file */
-FRESULT f_lseek (FIL*, DWORD);						/* Move file pointer of a file object */
+FRESULT f_lseek (FIL*, FSIZE_t);					/* Move file pointer of a file object */
 FRESULT f_close (FIL*);								/* Close an open file object */
 FRESULT f_opendir (DIR*, const TCHAR*);				/* Open an existing directory */
 FRESULT f_readdir (DIR*, FILINFO*);					/* Read a directory item */
@@ -213,6 +283,7 @@ FRESULT f_stat (const TCHAR*, FILINFO*);			/* Get file status */
 FRESULT f_write (FIL*, const void*, UINT, UINT*);	/* Write data to a file */
 FRESULT f_getfree (const TCHAR*, DWORD*, FATFS**);	/* Get number of free clusters on the drive */
 FRESULT f_truncate (FIL*);							/* Truncate file */
+FRESULT f_expand (FIL*, FSIZE_t, BYTE);			/* Allocate a contiguous block to the file */
 FRESULT f_sync (FIL*);								/* Flush cached data of a writing file */
 FRESULT f_unlink (const TCHAR*);					/* Delete an existing file or directory */
 FRESULT	f_mkdir (const TCHAR*);						/* Create a new directory */
@@ -296,6 +367,7 @@ int ff_del_syncobj (_SYNC_t);		/* Delete a sync object */
 #define FS_FAT12	1
 #define FS_FAT16	2
 #define FS_FAT32	3
+#define FS_EXFAT	4
 
 
 /* File attribute bits for directory entry */
@@ -330,6 +402,11 @@ int ff_del_syncobj (_SYNC_t);		/* Delete a sync object */
 #define	ST_DWORD(ptr,val)	*(BYTE*)(ptr)=(BYTE)(val); *((BYTE*)(ptr)+1)=(BYTE)((WORD)(val)>>8); *((BYTE*)(ptr)+2)=(BYTE)((DWORD)(val)>>16); *((BYTE*)(ptr)+3)=(BYTE)((DWORD)(val)>>24)
 #endif
 
+#if _FS_EXFAT			/* 64-bit fields of the exFAT structures */
+#define	LD_QWORD(ptr)		(QWORD)(((QWORD)LD_DWORD((BYTE*)(ptr)+4)<<32)|LD_DWORD(ptr))
+#define	ST_QWORD(ptr,val)	{ ST_DWORD(ptr,(DWORD)(val)); ST_DWORD((BYTE*)(ptr)+4,(DWORD)((QWORD)(val)>>32)); }
+#endif
+
 #ifdef __cplusplus
 }
 #endif
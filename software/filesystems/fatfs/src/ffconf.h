@@ -40,7 +40,9 @@
 /* To enable string functions, set _USE_STRFUNC to 1 or 2. */
 
 
+#ifndef _USE_MKFS
 #define	_USE_MKFS		0	/* 0:Disable or 1:Enable */
+#endif
 /* To enable f_mkfs function, set _USE_MKFS to 1 and set _FS_READONLY to 0 */
 
 
@@ -52,6 +54,71 @@
 /* To enable fast seek feature, set _USE_FASTSEEK to 1. */
 
 
+#define	_USE_EXPAND		1	/* 0:Disable or 1:Enable */
+/* To enable f_expand function, set _USE_EXPAND to 1, set _FS_READONLY to 0 and
+/  set _FS_MINIMIZE to 0. f_expand gives an empty file one contiguous cluster
+/  run for the size it is going to have, linked on the FAT in a single pass, so
+/  the data that follows is written to consecutive sectors without FAT updates
+/  in between. */
+
+
+#define	_USE_EXTCACHE	1	/* 0:Disable or 1:Enable */
+#define	_EXTCACHE_SIZE	8	/* Number of extents cached per file object (1-255) */
+/* To enable the cluster extent cache, set _USE_EXTCACHE to 1. Each file object
+/  remembers the contiguous cluster runs of its chain as they are followed, so
+/  that seeking, appending and multi-cluster direct transfers do not walk the
+/  FAT cluster by cluster again. Fragments beyond _EXTCACHE_SIZE are followed
+/  on the FAT as usual. Each extent takes 8 bytes in the file object. */
+
+
+#define	_USE_FREEMAP	1	/* 0:Disable or 1:Enable */
+#define	_FREEMAP_SIZE	512	/* Size of the free cluster map in each file system object (bytes) */
+/* To enable the free cluster map, set _USE_FREEMAP to 1 (requires _FS_READONLY 0).
+/  Each bit of the map covers a group of clusters and is set once the group is
+/  known to have no free cluster, so the allocator skips it without reading the
+/  FAT. Groups are sized so the map covers the volume (one cluster per bit when
+/  it fits). The map starts empty at mount, fills in as the allocator scans and
+/  is built completely by the full scan of f_getfree(). The allocator also looks
+/  for a free run as long as the pending write instead of the first free cluster. */
+
+
+#define	_USE_WINCACHE	1	/* 0:Disable or 1:Enable */
+#define	_WINCACHE_WAYS	4	/* Number of sectors cached behind the window (1-255) */
+/* To enable the window cache, set _USE_WINCACHE to 1. When the sector window
+/  moves, the sector it held is parked in one of _WINCACHE_WAYS cache lines of
+/  the file system object (_MAX_SS bytes each) instead of being written back,
+/  so FAT and directory sectors that are used by turns stay in memory. Dirty
+/  lines are written, to all FAT copies for a FAT sector, when they are evicted
+/  or on sync (f_sync, f_close and the functions that change directories).
+/  wc_hit, wc_miss and wc_wrt in the file system object count window requests
+/  served from memory, sectors read and sectors written. */
+
+
+#define	_USE_DIRINDEX	1	/* 0:Disable or 1:Enable */
+#define	_DIRINDEX_SIZE	6144	/* Memory for the directory index in each file system object (bytes) */
+/* To enable the directory index, set _USE_DIRINDEX to 1. The first lookup
+/  that scans a whole directory records where each short name lives in a hash
+/  table of _DIRINDEX_SIZE / 3 slots, so later lookups and creations in that
+/  directory read one sector instead of the whole table. One directory per
+/  volume is indexed at a time (the index is kept in the file system object),
+/  and directories with more entries than 3/4 of the slots are not indexed.
+/  On LFN cfg, only lookups by short name use the index. */
+
+
+
+#define	_FS_EXFAT	1	/* 0:Disable or 1:Enable */
+/* To enable exFAT volumes (SDXC cards), set _FS_EXFAT to 1. File sizes and
+/  offsets (FSIZE_t) become 64-bit. Clusters are allocated on the allocation
+/  bitmap and a file or directory that stays contiguous is kept without a FAT
+/  chain (NoFatChain), so it is followed without reading the FAT at all. The
+/  chain is written to the FAT only when the object cannot grow in place.
+/  Limits on exFAT volumes: on non-LFN cfg, only objects whose name fits 8.3
+/  in ASCII can be found and listed, directories hold up to 65535 entries,
+/  files with a valid data length shorter than their size are opened read
+/  only up to the valid data, ".." and f_getcwd() in a sub-directory are
+/  not available on _FS_RPATH cfg and f_mkfs creates FAT volumes only. */
+
+
 
 /*---------------------------------------------------------------------------/
 / Locale and Namespace Configurations
@@ -170,21 +237,28 @@
 /* A header file that defines sync object types on the O/S, such as
 /  windows.h, ucos_ii.h and semphr.h, must be included prior to ff.h. */
 
-#define _FS_REENTRANT	0		/* 0:Disable or 1:Enable */
+#define _FS_REENTRANT	1		/* 0:Disable or 1:Enable */
 #define _FS_TIMEOUT		1000	/* Timeout period in unit of time ticks */
-#define	_SYNC_t			HANDLE	/* O/S dependent type of sync object. e.g. HANDLE, OS_EVENT*, ID and etc.. */
+#define	_SYNC_t			void*	/* O/S dependent type of sync object. e.g. HANDLE, OS_EVENT*, ID and etc.. */
 
 /* The _FS_REENTRANT option switches the reentrancy (thread safe) of the FatFs module.
 /
 /   0: Disable reentrancy. _SYNC_t and _FS_TIMEOUT have no effect.
 /   1: Enable reentrancy. Also user provided synchronization handlers,
 /      ff_req_grant, ff_rel_grant, ff_del_syncobj and ff_cre_syncobj
-/      function must be added to the project. */
+/      function must be added to the project.
+/
+/  fatfslpc/ff_sync.c provides them: one lock per volume, so the volumes are
+/  used concurrently and calls on the same volume take turns. The time ticks
+/  are milliseconds. Without an RTOS a waiting call runs the wait function set
+/  by ff_sync_set_wait (the yield of a cooperative scheduler), an RTOS plugs in
+/  its mutexes with ff_sync_set_ops before the volumes are mounted. */
 
 
-#define	_FS_LOCK	0	/* 0:Disable or >=1:Enable */
+#define	_FS_LOCK	8	/* 0:Disable or >=1:Enable */
 /* To enable file lock control feature, set _FS_LOCK to 1 or greater.
-   The value defines how many files can be opened simultaneously. */
+   The value defines how many files can be opened simultaneously on each
+   volume, the lock table is kept in the file system object. */
 
 
 #endif /* _FFCONFIG */
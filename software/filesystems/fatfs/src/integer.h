@@ -9,6 +9,7 @@
 
 #include <windows.h>
 #include <tchar.h>
+typedef unsigned __int64 QWORD;
 
 #else			/* Embedded platform */
 
@@ -32,6 +33,9 @@ typedef long			LONG;
 typedef unsigned long	ULONG;
 typedef unsigned long	DWORD;
 
+/* This type must be 64-bit integer */
+typedef unsigned long long QWORD;
+
 #endif
 
 #endif
@@ -0,0 +1,186 @@
+/*
+ * @brief Chan FATFS volume locks for re-entrant configurations
+ *
+ * @note
+ * Copyright(C) NXP Semiconductors, 2012
+ * All rights reserved.
+ *
+ * @par
+ * Software that is described herein is for illustrative purposes only
+ * which provides customers with programming information regarding the
+ * LPC products.  This software is supplied "AS IS" without any warranties of
+ * any kind, and NXP Semiconductors and its licensor disclaim any and
+ * all warranties, express or implied, including all implied warranties of
+ * merchantability, fitness for a particular purpose and non-infringement of
+ * intellectual property rights.  NXP Semiconductors assumes no responsibility
+ * or liability for the use of the software, conveys no license or rights under any
+ * patent, copyright, mask work right, or any other intellectual property rights in
+ * or to any products. NXP Semiconductors reserves the right to make changes
+ * in the software without notification. NXP Semiconductors also makes no
+ * representation or warranty that such application will be suitable for the
+ * specified use without further testing or modification.
+ *
+ * @par
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation is hereby granted, under NXP Semiconductors' and its
+ * licensor's relevant copyrights in the software, without fee, provided that it
+ * is used in conjunction with NXP Semiconductors microcontrollers.  This
+ * copyright, permission, and disclaimer notice must appear in all copies of
+ * this code.
+ */
+
+#include "board.h"
+#include "chip.h"
+#include "ff.h"
+#include "ff_sync.h"
+
+#if _FS_REENTRANT
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+/* Built-in lock of a volume. The locks are not recursive, FatFs keeps one sector window per volume
+   and a nested call would move it under the call that holds the lock. Without a wait function only
+   the context that took the lock can find it busy at the same level, so such a call (e.g. from a disk
+   driver callback) is reported and fails at once with FR_TIMEOUT instead of waiting for itself. */
+typedef struct {
+	const FF_SYNC_OPS_T *ops;	/* RTOS mutex, NULL for the flag below */
+	void *mutex;
+	volatile BYTE locked;
+	uint32_t owner;				/* exception number of the context holding the flag, 0 for thread mode */
+} FF_SYNC_OBJ_T;
+
+static FF_SYNC_OBJ_T SyncObj[_VOLUMES];
+
+/* Context number, interrupt mask and time base of the built-in locks. A host build on RAM disks
+   (prj/sim/fatfs_sim_test.c, FATFS_SIM) has no Cortex-M core to ask and takes them from the test. */
+#ifdef FATFS_SIM
+uint32_t FatfsSim_GetIPSR(void);
+uint32_t FatfsSim_GetCounter(void);
+#define SYNC_CONTEXT()          FatfsSim_GetIPSR()
+#define SYNC_COUNTER()          FatfsSim_GetCounter()
+#define SYNC_MASK(primask)      ((primask) = 0)
+#define SYNC_UNMASK(primask)    ((void) (primask))
+#else
+#define SYNC_CONTEXT()          __get_IPSR()
+#define SYNC_COUNTER()          Chip_RIT_GetCounter(LPC_RITIMER)
+#define SYNC_MASK(primask)      do { (primask) = __get_PRIMASK(); __disable_irq(); } while (0)
+#define SYNC_UNMASK(primask)    __set_PRIMASK(primask)
+#endif
+static const FF_SYNC_OPS_T *SyncOps;
+static FF_SYNC_WAIT_FUNC_T SyncWait;
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+/* Take a built-in lock if it is free */
+static int sync_try(FF_SYNC_OBJ_T *so)
+{
+	uint32_t primask;
+	int taken;
+
+	SYNC_MASK(primask);
+	taken = !so->locked;
+	if (taken) {
+		so->locked = 1;
+		so->owner = SYNC_CONTEXT();
+	}
+	SYNC_UNMASK(primask);
+	return taken;
+}
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Use the mutexes of an RTOS for the volumes */
+void ff_sync_set_ops(const FF_SYNC_OPS_T *ops)
+{
+	SyncOps = ops;
+}
+
+/* Set the function run while waiting for a built-in lock */
+void ff_sync_set_wait(FF_SYNC_WAIT_FUNC_T func)
+{
+	SyncWait = func;
+}
+
+/* Create the sync object of a volume, called by f_mount() */
+int ff_cre_syncobj(BYTE vol, _SYNC_t *sobj)
+{
+	FF_SYNC_OBJ_T *so = &SyncObj[vol];
+
+	so->ops = SyncOps;
+	so->mutex = NULL;
+	so->locked = 0;
+	if (so->ops) {
+		so->mutex = so->ops->Create(vol);
+		if (!so->mutex) {
+			return 0;
+		}
+	}
+	*sobj = so;
+	return 1;
+}
+
+/* Delete the sync object of a volume, called by f_mount() */
+int ff_del_syncobj(_SYNC_t sobj)
+{
+	FF_SYNC_OBJ_T *so = (FF_SYNC_OBJ_T *) sobj;
+
+	if (so->ops) {
+		so->ops->Delete(so->mutex);
+		so->mutex = NULL;
+	}
+	return 1;
+}
+
+/* Get the volume for one FatFs call, 0 when it stays busy for _FS_TIMEOUT milliseconds */
+int ff_req_grant(_SYNC_t sobj)
+{
+	FF_SYNC_OBJ_T *so = (FF_SYNC_OBJ_T *) sobj;
+	int32_t deadline;
+
+	if (so->ops) {
+		return so->ops->Take(so->mutex, _FS_TIMEOUT);
+	}
+	if (sync_try(so)) {
+		return 1;
+	}
+	if (!SyncWait && so->owner == SYNC_CONTEXT()) {
+		DEBUGSTR("FatFs: nested call on a locked volume\r\n");
+		return 0;
+	}
+
+	deadline = (int32_t) SYNC_COUNTER() + (int32_t) ((SystemCoreClock / 1000) * _FS_TIMEOUT);
+	do {
+		if (SyncWait) {
+			SyncWait();
+		}
+		if (sync_try(so)) {
+			return 1;
+		}
+	} while (((int32_t) SYNC_COUNTER() - deadline) < 0);
+	return 0;
+}
+
+/* Give the volume back at the end of a FatFs call */
+void ff_rel_grant(_SYNC_t sobj)
+{
+	FF_SYNC_OBJ_T *so = (FF_SYNC_OBJ_T *) sobj;
+
+	if (so->ops) {
+		so->ops->Give(so->mutex);
+	}
+	else {
+		so->locked = 0;
+	}
+}
+
+#endif /* _FS_REENTRANT */
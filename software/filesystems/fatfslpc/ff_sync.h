@@ -0,0 +1,76 @@
+/*
+ * @brief Chan FATFS volume locks for re-entrant configurations
+ *
+ * @note
+ * Copyright(C) NXP Semiconductors, 2012
+ * All rights reserved.
+ *
+ * @par
+ * Software that is described herein is for illustrative purposes only
+ * which provides customers with programming information regarding the
+ * LPC products.  This software is supplied "AS IS" without any warranties of
+ * any kind, and NXP Semiconductors and its licensor disclaim any and
+ * all warranties, express or implied, including all implied warranties of
+ * merchantability, fitness for a particular purpose and non-infringement of
+ * intellectual property rights.  NXP Semiconductors assumes no responsibility
+ * or liability for the use of the software, conveys no license or rights under any
+ * patent, copyright, mask work right, or any other intellectual property rights in
+ * or to any products. NXP Semiconductors reserves the right to make changes
+ * in the software without notification. NXP Semiconductors also makes no
+ * representation or warranty that such application will be suitable for the
+ * specified use without further testing or modification.
+ *
+ * @par
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation is hereby granted, under NXP Semiconductors' and its
+ * licensor's relevant copyrights in the software, without fee, provided that it
+ * is used in conjunction with NXP Semiconductors microcontrollers.  This
+ * copyright, permission, and disclaimer notice must appear in all copies of
+ * this code.
+ */
+
+#ifndef __FF_SYNC_H_
+#define __FF_SYNC_H_
+
+#include "integer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Mutex operations of an RTOS. Until they are installed each volume uses a built-in lock, taken
+ * with interrupts masked, and a call finding its volume busy runs the wait function until the
+ * lock is released or _FS_TIMEOUT milliseconds have passed. The locks are not recursive: with no
+ * wait function set, a call on a volume from inside a call on the same volume fails at once.
+ */
+typedef struct {
+	void *(*Create)(BYTE vol);			/* Create the mutex of a volume, NULL on failure */
+	int (*Take)(void *obj, DWORD ms);	/* Take the mutex within ms milliseconds, 1 when taken */
+	void (*Give)(void *obj);			/* Release the mutex */
+	void (*Delete)(void *obj);			/* Delete the mutex */
+} FF_SYNC_OPS_T;
+
+/** Function run while a volume is used by another task, e.g. the yield of a cooperative scheduler */
+typedef void (*FF_SYNC_WAIT_FUNC_T)(void);
+
+/**
+ * @brief	Use the mutexes of an RTOS for the volumes
+ * @param	ops		: mutex operations, NULL for the built-in locks
+ * @return	Nothing
+ * @note	Volumes mounted before keep the locks they were mounted with, set this before f_mount().
+ */
+void ff_sync_set_ops (const FF_SYNC_OPS_T *ops);
+
+/**
+ * @brief	Set the function run while waiting for a built-in lock
+ * @param	func	: wait function, NULL to spin
+ * @return	Nothing
+ */
+void ff_sync_set_wait (FF_SYNC_WAIT_FUNC_T func);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __FF_SYNC_H_ */
@@ -52,6 +52,10 @@ static volatile WORD Timer2;
 
 static CARD_HANDLE_T *hCard;
 
+/* Sectors moved by one card command, as many as the DMA descriptors of the SD driver cover. A project
+   that defines a larger SDIF_DMA_DESC_COUNT moves longer runs with one command. */
+#define MMC_MAX_SECTORS     ((SDIF_DMA_DESC_COUNT * MCI_DMADES1_MAXTR) / MMC_SECTOR_SIZE)
+
 /*****************************************************************************
  * Public types/enumerations/variables
  ****************************************************************************/
@@ -116,8 +120,8 @@ STATIC DRESULT local_disk_ioctl(BYTE drv, BYTE ctrl, void *buff)
 	res = RES_ERROR;
 
 	switch (ctrl) {
-	case CTRL_SYNC:	/* Make sure that no pending write process */
-		if (FSMCI_CardReadyWait(hCard, 50)) {
+	case CTRL_SYNC:	/* Make sure that no pending write process, nor data in the card cache */
+		if (FSMCI_CardReadyWait(hCard, 50) && FSMCI_CardFlushCache(hCard)) {
 			res = RES_OK;
 		}
 		break;
@@ -173,8 +177,10 @@ STATIC DRESULT local_disk_ioctl(BYTE drv, BYTE ctrl, void *buff)
 }
 
 /* Read Sector(s) */
-STATIC DRESULT local_disk_read(BYTE drv, BYTE *buff, DWORD sector, BYTE count)
+STATIC DRESULT local_disk_read(BYTE drv, BYTE *buff, DWORD sector, UINT count)
 {
+	UINT n;
+
 	if (drv || !count) {
 		return RES_PARERR;
 	}
@@ -182,11 +188,18 @@ STATIC DRESULT local_disk_read(BYTE drv, BYTE *buff, DWORD sector, BYTE count)
 		return RES_NOTRDY;
 	}
 
-	if (FSMCI_CardReadSectors(hCard, buff, sector, count)) {
-		return RES_OK;
+	/* One multiple block read per DMA chain */
+	while (count) {
+		n = MIN(count, MMC_MAX_SECTORS);
+		if (!FSMCI_CardReadSectors(hCard, buff, sector, n)) {
+			return RES_ERROR;
+		}
+		buff += n * MMC_SECTOR_SIZE;
+		sector += n;
+		count -= n;
 	}
 
-	return RES_ERROR;
+	return RES_OK;
 }
 
 /* Get Disk Status */
@@ -200,8 +213,9 @@ STATIC DSTATUS local_disk_status(BYTE drv)
 }
 
 /* Write Sector(s) */
-STATIC DRESULT local_disk_write(BYTE drv, const BYTE *buff, DWORD sector, BYTE count)
+STATIC DRESULT local_disk_write(BYTE drv, const BYTE *buff, DWORD sector, UINT count)
 {
+	UINT n;
 
 	if (drv || !count) {
 		return RES_PARERR;
@@ -210,11 +224,18 @@ STATIC DRESULT local_disk_write(BYTE drv, const BYTE *buff, DWORD sector, BYTE c
 		return RES_NOTRDY;
 	}
 
-	if ( FSMCI_CardWriteSectors(hCard, (void *) buff, sector, count)) {
-		return RES_OK;
+	/* One multiple block write per DMA chain */
+	while (count) {
+		n = MIN(count, MMC_MAX_SECTORS);
+		if (!FSMCI_CardWriteSectors(hCard, (void *) buff, sector, n)) {
+			return RES_ERROR;
+		}
+		buff += n * MMC_SECTOR_SIZE;
+		sector += n;
+		count -= n;
 	}
 
-	return RES_ERROR;
+	return RES_OK;
 }
 
 
@@ -237,7 +258,7 @@ DSTATUS MMC_disk_status (void)
 DRESULT MMC_disk_read (
 	BYTE *buff,		/* Data buffer to store read data */
 	DWORD sector,	/* Sector address (LBA) */
-	BYTE count		/* Number of sectors to read (1..128) */
+	UINT count		/* Number of sectors to read (1..) */
 )
 {
 	return local_disk_read(0, buff, sector, count);
@@ -246,7 +267,7 @@ DRESULT MMC_disk_read (
 DRESULT MMC_disk_write (
 	const BYTE *buff,	/* Data to be written */
 	DWORD sector,		/* Sector address (LBA) */
-	BYTE count			/* Number of sectors to write (1..128) */
+	UINT count			/* Number of sectors to write (1..) */
 )
 {
 	return local_disk_write(0, buff, sector, count);
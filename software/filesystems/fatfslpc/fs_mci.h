@@ -15,13 +15,13 @@ DSTATUS MMC_disk_status (void);
 DRESULT MMC_disk_read (
 	BYTE *buff,		/* Data buffer to store read data */
 	DWORD sector,	/* Sector address (LBA) */
-	BYTE count		/* Number of sectors to read (1..128) */
+	UINT count		/* Number of sectors to read (1..) */
 );
 
 DRESULT MMC_disk_write (
 	const BYTE *buff,	/* Data to be written */
 	DWORD sector,		/* Sector address (LBA) */
-	BYTE count			/* Number of sectors to write (1..128) */
+	UINT count			/* Number of sectors to write (1..) */
 );
 
 DRESULT MMC_disk_ioctl (
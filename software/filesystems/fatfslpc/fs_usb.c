@@ -52,6 +52,13 @@ static volatile WORD Timer2;
 
 static DISK_HANDLE_T *hDisk;
 
+/* Blocks moved by one READ(10)/WRITE(10), the most its 16-bit transfer length holds */
+#define USB_MAX_SECTORS     0xFFFF
+
+/* Time a busy disk gets to become ready again on CTRL_SYNC, in milliseconds. TEST UNIT READY is
+   retried while the disk reports NOT READY, e.g. while it flushes its own write cache. */
+#define USB_SYNC_TIMEOUT    5000
+
 /*****************************************************************************
  * Public types/enumerations/variables
  ****************************************************************************/
@@ -116,7 +123,7 @@ STATIC DRESULT local_disk_ioctl(BYTE drv, BYTE ctrl, void *buff)
 
 	switch (ctrl) {
 	case CTRL_SYNC:	/* Make sure that no pending write process */
-		if (FSUSB_DiskReadyWait(hDisk, 50)) {
+		if (FSUSB_DiskReadyWait(hDisk, USB_SYNC_TIMEOUT)) {
 			res = RES_OK;
 		}
 		break;
@@ -145,8 +152,9 @@ STATIC DRESULT local_disk_ioctl(BYTE drv, BYTE ctrl, void *buff)
 }
 
 /* Read Sector(s) */
-STATIC DRESULT local_disk_read(BYTE drv, BYTE *buff, DWORD sector, BYTE count)
+STATIC DRESULT local_disk_read(BYTE drv, BYTE *buff, DWORD sector, UINT count)
 {
+	UINT n;
 
 	if (drv || !count) {
 		return RES_PARERR;
@@ -154,11 +162,19 @@ STATIC DRESULT local_disk_read(BYTE drv, BYTE *buff, DWORD sector, BYTE count)
 	if (Stat & STA_NOINIT) {
 		return RES_NOTRDY;
 	}
-	if (FSUSB_DiskReadSectors(hDisk, buff, sector, count)) {
-		return RES_OK;
+
+	/* One command per USB_MAX_SECTORS */
+	while (count) {
+		n = MIN(count, USB_MAX_SECTORS);
+		if (!FSUSB_DiskReadSectors(hDisk, buff, sector, n)) {
+			return RES_ERROR;
+		}
+		buff += n * FSUSB_DiskGetSectorSz(hDisk);
+		sector += n;
+		count -= n;
 	}
 
-	return RES_ERROR;
+	return RES_OK;
 }
 
 /* Get Disk Status */
@@ -171,8 +187,9 @@ STATIC DSTATUS local_disk_status(BYTE drv)
 }
 
 /* Write Sector(s) */
-STATIC DRESULT local_disk_write(BYTE drv, const BYTE *buff, DWORD sector, BYTE count)
+STATIC DRESULT local_disk_write(BYTE drv, const BYTE *buff, DWORD sector, UINT count)
 {
+	UINT n;
 
 	if (drv || !count) {
 		return RES_PARERR;
@@ -181,11 +198,18 @@ STATIC DRESULT local_disk_write(BYTE drv, const BYTE *buff, DWORD sector, BYTE c
 		return RES_NOTRDY;
 	}
 
-	if (FSUSB_DiskWriteSectors(hDisk, (void *) buff, sector, count)) {
-		return RES_OK;
+	/* One command per USB_MAX_SECTORS */
+	while (count) {
+		n = MIN(count, USB_MAX_SECTORS);
+		if (!FSUSB_DiskWriteSectors(hDisk, (void *) buff, sector, n)) {
+			return RES_ERROR;
+		}
+		buff += n * FSUSB_DiskGetSectorSz(hDisk);
+		sector += n;
+		count -= n;
 	}
 
-	return RES_ERROR;
+	return RES_OK;
 }
 
 
@@ -203,7 +227,7 @@ DSTATUS USB_disk_status ()
 DRESULT USB_disk_read (
 	BYTE *buff,		/* Data buffer to store read data */
 	DWORD sector,	/* Sector address (LBA) */
-	BYTE count		/* Number of sectors to read (1..128) */
+	UINT count		/* Number of sectors to read (1..) */
 )
 {
 	return local_disk_read(0, buff, sector, count);
@@ -212,7 +236,7 @@ DRESULT USB_disk_read (
 DRESULT USB_disk_write (
 	const BYTE *buff,	/* Data to be written */
 	DWORD sector,		/* Sector address (LBA) */
-	BYTE count			/* Number of sectors to write (1..128) */
+	UINT count			/* Number of sectors to write (1..) */
 )
 {
 	return local_disk_write(0, buff, sector, count);
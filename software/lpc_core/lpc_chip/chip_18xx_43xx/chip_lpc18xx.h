@@ -208,6 +208,16 @@ typedef IP_LCD_001_T LPC_LCD_T;
 #define LPC_ADC1                  ((IP_ADC_001_T              *) LPC_ADC1_BASE)
 #define LPC_GPIO_PORT             ((IP_GPIO_001_T             *) LPC_GPIO_PORT_BASE)
 
+#ifdef SDMMC_SIM
+/* Host build against lpc_sim/sdmmc_sim.c: the SDIO block and the RI timer are the ones of the model */
+IP_SDMMC_001_T *SdmmcSim_GetRegs(void);
+IP_RITIMER_001_T *SdmmcSim_GetRit(void);
+#undef LPC_SDMMC
+#undef LPC_RITIMER
+#define LPC_SDMMC                 (SdmmcSim_GetRegs())
+#define LPC_RITIMER               (SdmmcSim_GetRit())
+#endif
+
 /**
  * @}
  */
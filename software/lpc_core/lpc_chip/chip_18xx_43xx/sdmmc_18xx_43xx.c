@@ -39,6 +39,27 @@
 /* Global instance of the current card */
 static mci_card_struct *g_card_info;
 
+/* Header block of a packed write */
+static uint32_t g_packed_hdr[MMC_SECTOR_SIZE / 4];
+
+#if SDIO_STATS
+/* Command statistics, and the started transfer they wait to book */
+static MCI_STATS_T g_stats;
+static uint32_t g_cycles_per_us = 1;
+static uint32_t g_xfer_cmd;
+static uint32_t g_xfer_bytes;
+static uint32_t g_xfer_start;
+
+/* Cycle counter the latencies are timed with. The host build on the software model of the block
+   (lpc_sim/sdmmc_sim.h) has no DWT, the model counts the cycles. */
+#ifdef SDMMC_SIM
+uint32_t SdmmcSim_GetCycles(void);
+#define SDIO_CYCCNT()   SdmmcSim_GetCycles()
+#else
+#define SDIO_CYCCNT()   (DWT->CYCCNT)
+#endif
+#endif
+
 /* Helper definition: all SD error conditions in the status word */
 #define SD_INT_ERROR (MCI_INT_RESP_ERR | MCI_INT_RCRC | MCI_INT_DCRC | \
 					  MCI_INT_RTO | MCI_INT_DTO | MCI_INT_HTO | MCI_INT_FRUN | MCI_INT_HLE | \
@@ -52,12 +73,146 @@ static mci_card_struct *g_card_info;
  * Private functions
  ****************************************************************************/
 
+/* Builds the CIU command register value of a CMD_* command */
+static uint32_t prv_cmd_reg(uint32_t cmd)
+{
+	uint32_t cmd_reg;
+
+	cmd_reg = ((cmd & CMD_MASK_CMD) >> CMD_SHIFT_CMD) |
+			  ((cmd & CMD_BIT_INIT)  ? MCI_CMD_INIT : 0) |
+			  ((cmd & CMD_BIT_DATA)  ? (MCI_CMD_DAT_EXP | MCI_CMD_PRV_DAT_WAIT) : 0) |
+			  (((cmd & CMD_MASK_RESP) == CMD_RESP_R2) ? MCI_CMD_RESP_LONG : 0) |
+			  ((cmd & CMD_MASK_RESP) ? MCI_CMD_RESP_EXP : 0) |
+			  ((cmd & CMD_BIT_WRITE)  ? MCI_CMD_DAT_WR : 0) |
+			  ((cmd & CMD_BIT_STREAM) ? MCI_CMD_STRM_MODE : 0) |
+			  ((cmd & CMD_BIT_BUSY) ? MCI_CMD_STOP : 0) |
+			  ((cmd & CMD_BIT_AUTO_STOP)  ? MCI_CMD_SEND_STOP : 0) |
+			  MCI_CMD_START;
+
+	/* wait for previos data finsh for select/deselect commands */
+	if (((cmd & CMD_MASK_CMD) >> CMD_SHIFT_CMD) == MMC_SELECT_CARD) {
+		cmd_reg |= MCI_CMD_PRV_DAT_WAIT;
+	}
+
+	return cmd_reg;
+}
+
+#if SDIO_STATS
+/* Statistics class of a command */
+static uint32_t prv_stat_class(uint32_t cmd)
+{
+	switch ((cmd & CMD_MASK_CMD) >> CMD_SHIFT_CMD) {
+	case MMC_READ_SINGLE_BLOCK:
+		return MCI_STAT_READ_SINGLE;
+
+	case MMC_READ_MULTIPLE_BLOCK:
+		return MCI_STAT_READ_MULTIPLE;
+
+	case MMC_WRITE_BLOCK:
+		return MCI_STAT_WRITE_SINGLE;
+
+	case MMC_WRITE_MULTIPLE_BLOCK:
+		return MCI_STAT_WRITE_MULTIPLE;
+
+	case MMC_SEND_STATUS:
+		return MCI_STAT_STATUS;
+
+	case SD_APP_SET_ERASE_COUNT:	/* CMD23 without the APP prefix */
+		return (cmd & CMD_BIT_APP) ? MCI_STAT_ERASE : MCI_STAT_OTHER;
+
+	case SD_ERASE_WR_BLK_START:
+	case SD_ERASE_WR_BLK_END:
+	case MMC_ERASE_GROUP_START:
+	case MMC_ERASE_GROUP_END:
+	case SD_ERASE:
+		return MCI_STAT_ERASE;
+
+	default:
+		return MCI_STAT_OTHER;
+	}
+}
+
+/* Time elapsed since a cycle count, in usec */
+static uint32_t prv_stat_us(uint32_t start)
+{
+	return (SDIO_CYCCNT() - start) / g_cycles_per_us;
+}
+
+/* Books a command ended after its data, with the status it ended with */
+static void prv_stat_cmd(uint32_t cmd, uint32_t start, uint32_t bytes, uint32_t status)
+{
+	MCI_CMD_STAT_T *stat = &g_stats.cmd[prv_stat_class(cmd)];
+	uint32_t us = prv_stat_us(start);
+	uint32_t bin = 0;
+
+	while ((bin < (MCI_STAT_BINS - 1)) && (us >= ((uint32_t) MCI_STAT_BIN0_US << bin))) {
+		bin++;
+	}
+	stat->hist[bin]++;
+	stat->count++;
+	stat->time_us += us;
+	if (us > stat->max_us) {
+		stat->max_us = us;
+	}
+
+	if (status & SD_INT_ERROR) {
+		stat->errors++;
+		if (status & (MCI_INT_RCRC | MCI_INT_DCRC)) {
+			stat->crc_errors++;
+		}
+		if (status & (MCI_INT_RTO | MCI_INT_DTO | MCI_INT_HTO)) {
+			stat->timeouts++;
+		}
+	}
+	else {
+		stat->bytes += bytes;
+	}
+}
+
+/* Books a command sent again because the card was not ready */
+static void prv_stat_retry(uint32_t cmd)
+{
+	g_stats.cmd[prv_stat_class(cmd)].retries++;
+}
+
+/* Books a wait for a card programming a write */
+static void prv_stat_busy(uint32_t start)
+{
+	uint32_t us = prv_stat_us(start);
+
+	g_stats.busy_waits++;
+	g_stats.busy_us += us;
+	if (us > g_stats.busy_max_us) {
+		g_stats.busy_max_us = us;
+	}
+}
+
+/* Cycle count a latency is timed from */
+static uint32_t prv_stat_start(void)
+{
+	return SDIO_CYCCNT();
+}
+
+#else
+static uint32_t prv_stat_start(void) { return 0; }
+static void prv_stat_cmd(uint32_t cmd, uint32_t start, uint32_t bytes, uint32_t status) {}
+static void prv_stat_retry(uint32_t cmd) {}
+static void prv_stat_busy(uint32_t start) {}
+#endif /* SDIO_STATS */
+
 /* Function to execute a command */
 static int32_t sdmmc_execute_command(LPC_SDMMC_T *pSDMMC, uint32_t cmd, uint32_t arg, uint32_t wait_status)
 {
 	int32_t step = (cmd & CMD_BIT_APP) ? 2 : 1;
 	int32_t status = 0;
 	uint32_t cmd_reg = 0;
+	uint32_t start = prv_stat_start();
+	uint32_t bytes = (cmd & CMD_BIT_DATA) ? pSDMMC->BYTCNT : 0;
+
+	/* the bus belongs to the started transfer until its completion */
+	if (g_card_info->xfer_state != MCI_XFER_IDLE) {
+		return MCI_INT_HLE;
+	}
 
 	if (!wait_status) {
 		wait_status = (cmd & CMD_MASK_RESP) ? MCI_INT_CMD_DONE : MCI_INT_DATA_OVER;
@@ -84,21 +239,7 @@ static int32_t sdmmc_execute_command(LPC_SDMMC_T *pSDMMC, uint32_t cmd, uint32_t
 
 		switch (step) {
 		case 1:	/* Execute command */
-			cmd_reg = ((cmd & CMD_MASK_CMD) >> CMD_SHIFT_CMD) |
-					  ((cmd & CMD_BIT_INIT)  ? MCI_CMD_INIT : 0) |
-					  ((cmd & CMD_BIT_DATA)  ? (MCI_CMD_DAT_EXP | MCI_CMD_PRV_DAT_WAIT) : 0) |
-					  (((cmd & CMD_MASK_RESP) == CMD_RESP_R2) ? MCI_CMD_RESP_LONG : 0) |
-					  ((cmd & CMD_MASK_RESP) ? MCI_CMD_RESP_EXP : 0) |
-					  ((cmd & CMD_BIT_WRITE)  ? MCI_CMD_DAT_WR : 0) |
-					  ((cmd & CMD_BIT_STREAM) ? MCI_CMD_STRM_MODE : 0) |
-					  ((cmd & CMD_BIT_BUSY) ? MCI_CMD_STOP : 0) |
-					  ((cmd & CMD_BIT_AUTO_STOP)  ? MCI_CMD_SEND_STOP : 0) |
-					  MCI_CMD_START;
-
-			/* wait for previos data finsh for select/deselect commands */
-			if (((cmd & CMD_MASK_CMD) >> CMD_SHIFT_CMD) == MMC_SELECT_CARD) {
-				cmd_reg |= MCI_CMD_PRV_DAT_WAIT;
-			}
+			cmd_reg = prv_cmd_reg(cmd);
 
 			/* wait for command to be accepted by CIU */
 			if (IP_SDMMC_SendCmd(pSDMMC, cmd_reg, arg) == 0) {
@@ -125,6 +266,8 @@ static int32_t sdmmc_execute_command(LPC_SDMMC_T *pSDMMC, uint32_t cmd, uint32_t
 
 		/* We return an error if there is a timeout, even if we've fetched  a response */
 		if (status & SD_INT_ERROR) {
+			g_card_info->tran_state = 0;
+			prv_stat_cmd(cmd, start, bytes, status);
 			return status;
 		}
 
@@ -142,6 +285,7 @@ static int32_t sdmmc_execute_command(LPC_SDMMC_T *pSDMMC, uint32_t cmd, uint32_t
 		}
 	}
 
+	prv_stat_cmd(cmd, start, bytes, 0);
 	return 0;
 }
 
@@ -151,6 +295,20 @@ static int32_t prv_card_acquired(void)
 	return g_card_info->cid[0] != 0;
 }
 
+/* Check value of the card identity and bus mode, from cid to clk_rate */
+static uint32_t prv_card_check(void)
+{
+	const uint32_t *p = g_card_info->cid;
+	const uint32_t *end = &g_card_info->clk_rate;
+	uint32_t check = 0x5D3C0A17;
+
+	while (p <= end) {
+		check = ((check << 5) | (check >> 27)) ^ *p++;
+	}
+
+	return check;
+}
+
 /* Helper function to get a bit field withing multi-word  buffer. Used to get
    fields with-in CSD & EXT-CSD */
 static uint32_t prv_get_bits(int32_t start, int32_t end, uint32_t *data)
@@ -159,7 +317,7 @@ static uint32_t prv_get_bits(int32_t start, int32_t end, uint32_t *data)
 	uint32_t i = end >> 5;
 	uint32_t j = start & 0x1f;
 
-	if (i == (start >> 5)) {
+	if (i == (uint32_t) (start >> 5)) {
 		v = (data[i] >> j);
 	}
 	else {
@@ -207,7 +365,7 @@ static void prv_process_csd(LPC_SDMMC_T *pSDMMC)
 			IP_SDMMC_SetBlockSize(pSDMMC, MMC_SECTOR_SIZE);
 
 			/* send EXT_CSD command */
-			IP_SDMMC_DmaSetup(pSDMMC, &g_card_info->sdif_dev, (uint32_t) g_card_info->ext_csd, MMC_SECTOR_SIZE);
+			IP_SDMMC_DmaSetup(pSDMMC, &g_card_info->sdif_dev, MCI_BUS_ADDR(g_card_info->ext_csd), MMC_SECTOR_SIZE);
 
 			status = sdmmc_execute_command(pSDMMC, CMD_SEND_EXT_CSD, 0, 0 | MCI_INT_DATA_OVER);
 			if ((status & SD_INT_ERROR) == 0) {
@@ -216,15 +374,9 @@ static void prv_process_csd(LPC_SDMMC_T *pSDMMC)
 					g_card_info->blocknr = g_card_info->ext_csd[53];/* bytes 212:215 represent sec count */
 
 				}
-				/* switch to 52MHz clock if card type is set to 1 or else set to 26MHz */
-				if ((g_card_info->ext_csd[49] & 0xFF) == 1) {
-					/* for type 1 MMC cards high speed is 52MHz */
-					g_card_info->speed = MMC_HIGH_BUS_MAX_CLOCK;
-				}
-				else {
-					/* for type 0 MMC cards high speed is 26MHz */
-					g_card_info->speed = MMC_LOW_BUS_MAX_CLOCK;
-				}
+				/* 26MHz is within the backward compatible timing of MMC 4.x cards, faster
+				   clocks need the high speed timing set by prv_mmc_set_bus_mode() */
+				g_card_info->speed = MMC_LOW_BUS_MAX_CLOCK;
 			}
 		}
 	}
@@ -232,11 +384,55 @@ static void prv_process_csd(LPC_SDMMC_T *pSDMMC)
 	g_card_info->device_size = g_card_info->blocknr << 9;	/* blocknr * 512 */
 }
 
+/* Waits for the end of the last transfer. After a write the card holds DAT0 low until it has
+   programmed the blocks, after a multiple block transfer the CIU sends the auto-stop. The controller
+   has no busy-clear interrupt, so its status is polled here, just before the next command, which
+   leaves the programming time to the caller. Short writes are done within the spins, long ones in
+   1 msec steps. A card still busy after MS_PROGRAM_TIMEOUT is asked for its state by the next
+   transfer. */
+static void prv_wait_busy(LPC_SDMMC_T *pSDMMC)
+{
+	int32_t spins = PRG_BUSY_SPINS;
+	int32_t ms = MS_PROGRAM_TIMEOUT;
+	uint32_t start;
+
+	if (!g_card_info->busy_pending) {
+		return;
+	}
+	g_card_info->busy_pending = 0;
+	if (!IP_SDMMC_CiuBusy(pSDMMC) && !IP_SDMMC_CardBusy(pSDMMC)) {
+		return;
+	}
+
+	start = prv_stat_start();
+	while (IP_SDMMC_CiuBusy(pSDMMC) || IP_SDMMC_CardBusy(pSDMMC)) {
+		if (spins > 0) {
+			spins--;
+		}
+		else if (ms-- > 0) {
+			g_card_info->msdelay_func(1);
+		}
+		else {
+			g_card_info->tran_state = 0;
+			break;
+		}
+	}
+	prv_stat_busy(start);
+}
+
 /* Puts current selected card in trans state */
 static int32_t prv_set_trans_state(LPC_SDMMC_T *pSDMMC)
 {
 	uint32_t status;
 
+	prv_wait_busy(pSDMMC);
+
+	/* a card left in trans state by the last transfer is still there, its state is only asked
+	   after an error */
+	if (g_card_info->tran_state) {
+		return 0;
+	}
+
 	/* get current state of the card */
 	status = sdmmc_execute_command(pSDMMC, CMD_SEND_STATUS, g_card_info->rca << 16, 0);
 	if (status & MCI_INT_RTO) {
@@ -260,14 +456,50 @@ static int32_t prv_set_trans_state(LPC_SDMMC_T *pSDMMC)
 		/*do nothing */
 		break;
 
+	case SDMMC_DATA_ST:
+	case SDMMC_RCV_ST:
+		/* a transfer aborted by Chip_SDMMC_AbortXfer() left the card moving data, stop it */
+		status = sdmmc_execute_command(pSDMMC, CMD_STOP, 0, 0);
+		if (status != 0) {
+			return -1;
+		}
+		prv_wait_busy(pSDMMC);
+		break;
+
 	default:
 		/* card shouldn't be in other states so return */
 		return -1;
 	}
 
+	g_card_info->tran_state = 1;
 	return 0;
 }
 
+/* Routes the bus to the current card */
+static void prv_select_bus(void)
+{
+	if (g_card_info->bus_select_cb) {
+		g_card_info->bus_select_cb();
+	}
+}
+
+/* Sets the host side of the bus mode of an acquired card: bus width, DDR and block size (the clock
+   is set by each data transfer) */
+static void prv_set_host_mode(LPC_SDMMC_T *pSDMMC)
+{
+	if (g_card_info->card_type & CARD_TYPE_8BIT) {
+		IP_SDMMC_SetCardType(pSDMMC, MCI_CTYPE_8BIT);
+	}
+	else if (g_card_info->card_type & CARD_TYPE_4BIT) {
+		IP_SDMMC_SetCardType(pSDMMC, MCI_CTYPE_4BIT);
+	}
+	else {
+		IP_SDMMC_SetCardType(pSDMMC, 0);
+	}
+	pSDMMC->UHS_REG = (g_card_info->card_type & CARD_TYPE_DDR) ? MCI_UHS_DDR : 0;
+	IP_SDMMC_SetBlkSize(pSDMMC, MMC_SECTOR_SIZE);
+}
+
 /* Sets card data width and block size */
 static int32_t prv_set_card_params(LPC_SDMMC_T *pSDMMC)
 {
@@ -283,9 +515,9 @@ static int32_t prv_set_card_params(LPC_SDMMC_T *pSDMMC)
 		/* if positive response */
 		IP_SDMMC_SetCardType(pSDMMC, MCI_CTYPE_4BIT);
 		pSDMMC->CTYPE = MCI_CTYPE_4BIT;
+		g_card_info->card_type |= CARD_TYPE_4BIT;
 	}
-#elif SDIO_BUS_WIDTH > 4
-#error 8-bit mode not supported yet!
+	/* MMC cards are switched with EXT_CSD in prv_mmc_set_bus_mode() */
 #endif
 
 	/* set block length */
@@ -298,6 +530,439 @@ static int32_t prv_set_card_params(LPC_SDMMC_T *pSDMMC)
 	return 0;
 }
 
+/* Reads EXT_CSD of an MMC card in trans state */
+static int32_t prv_read_ext_csd(LPC_SDMMC_T *pSDMMC)
+{
+	IP_SDMMC_SetBlockSize(pSDMMC, MMC_SECTOR_SIZE);
+	IP_SDMMC_DmaSetup(pSDMMC, &g_card_info->sdif_dev, MCI_BUS_ADDR(g_card_info->ext_csd), MMC_SECTOR_SIZE);
+
+	return sdmmc_execute_command(pSDMMC, CMD_SEND_EXT_CSD, 0, 0 | MCI_INT_DATA_OVER) & SD_INT_ERROR;
+}
+
+/* Checks a new bus mode with a data transfer: EXT_CSD must read back without error and unchanged */
+static int32_t prv_mmc_check_bus(LPC_SDMMC_T *pSDMMC, uint32_t sec_count)
+{
+	if (prv_read_ext_csd(pSDMMC) != 0) {
+		return -1;
+	}
+
+	return (g_card_info->ext_csd[EXT_CSD_SEC_COUNT / 4] == sec_count) ? 0 : -1;
+}
+
+/* Writes one byte of EXT_CSD with CMD6 and waits up to ms msec until the card is done switching */
+static int32_t prv_mmc_switch(LPC_SDMMC_T *pSDMMC, uint32_t index, uint32_t value, int32_t ms)
+{
+	int32_t tries = ms;
+
+	if (sdmmc_execute_command(pSDMMC, CMD_MMC_SWITCH, MMC_SWITCH_ARG(index, value), 0) != 0) {
+		return -1;
+	}
+
+	/* R1b: the card is busy until it is back in trans state */
+	do {
+		if (sdmmc_execute_command(pSDMMC, CMD_SEND_STATUS, g_card_info->rca << 16, 0) != 0) {
+			return -1;
+		}
+		if (R1_CURRENT_STATE(g_card_info->response[0]) == SDMMC_TRAN_ST) {
+			return (g_card_info->response[0] & R1_SWITCH_ERROR) ? -1 : 0;
+		}
+		prv_stat_retry(CMD_SEND_STATUS);
+		g_card_info->msdelay_func(1);
+	} while (--tries > 0);
+
+	return -1;
+}
+
+/* Sets the bus width of an MMC card and the host, DDR when ddr is set */
+static int32_t prv_mmc_set_width(LPC_SDMMC_T *pSDMMC, uint32_t width, uint32_t ddr, uint32_t sec_count)
+{
+	uint32_t value = EXT_CSD_BUS_WIDTH_1;
+	uint32_t ctype = 0;
+
+	if (width == 8) {
+		value = EXT_CSD_BUS_WIDTH_8;
+		ctype = MCI_CTYPE_8BIT;
+	}
+	else if (width == 4) {
+		value = EXT_CSD_BUS_WIDTH_4;
+		ctype = MCI_CTYPE_4BIT;
+	}
+	if (ddr) {
+		value += EXT_CSD_BUS_WIDTH_DDR;
+	}
+
+	if (prv_mmc_switch(pSDMMC, EXT_CSD_BUS_WIDTH, value, SWITCH_RETRIES) != 0) {
+		return -1;
+	}
+	IP_SDMMC_SetCardType(pSDMMC, ctype);
+	pSDMMC->UHS_REG = ddr ? MCI_UHS_DDR : 0;
+
+	return prv_mmc_check_bus(pSDMMC, sec_count);
+}
+
+/* Moves an MMC 4.x card to its widest bus, then to high speed timing and DDR, falling back
+   to the last mode that passed its check */
+static void prv_mmc_set_bus_mode(LPC_SDMMC_T *pSDMMC)
+{
+	uint32_t width = 1;
+	uint32_t type, sec_count;
+
+	/* the switch command and EXT_CSD came with MMC 4.0 */
+	if ((prv_get_bits(122, 125, (uint32_t *) g_card_info->csd) < 4) || (prv_read_ext_csd(pSDMMC) != 0)) {
+		return;
+	}
+	g_card_info->card_type |= CARD_TYPE_CMD23;
+	type = ((uint8_t *) g_card_info->ext_csd)[EXT_CSD_CARD_TYPE];
+	sec_count = g_card_info->ext_csd[EXT_CSD_SEC_COUNT / 4];
+
+#if SDIO_BUS_WIDTH > 4
+	if (prv_mmc_set_width(pSDMMC, 8, 0, sec_count) == 0) {
+		width = 8;
+	}
+#endif
+#if SDIO_BUS_WIDTH > 1
+	if ((width == 1) && (prv_mmc_set_width(pSDMMC, 4, 0, sec_count) == 0)) {
+		width = 4;
+	}
+#endif
+	if (width == 1) {
+		prv_mmc_set_width(pSDMMC, 1, 0, sec_count);
+	}
+	else {
+		g_card_info->card_type |= (width == 8) ? CARD_TYPE_8BIT : CARD_TYPE_4BIT;
+	}
+
+	if (!(type & (EXT_CSD_CARD_TYPE_26 | EXT_CSD_CARD_TYPE_52)) ||
+		(prv_mmc_switch(pSDMMC, EXT_CSD_HS_TIMING, 1, SWITCH_RETRIES) != 0)) {
+		return;
+	}
+	g_card_info->speed = (type & EXT_CSD_CARD_TYPE_52) ? MMC_HIGH_BUS_MAX_CLOCK : MMC_LOW_BUS_MAX_CLOCK;
+	if (prv_mmc_check_bus(pSDMMC, sec_count) != 0) {
+		/* high speed timing also runs at 26MHz, the fallback when 52MHz fails */
+		g_card_info->speed = MMC_LOW_BUS_MAX_CLOCK;
+		if (prv_mmc_check_bus(pSDMMC, sec_count) != 0) {
+			return;
+		}
+	}
+	g_card_info->card_type |= CARD_TYPE_HS;
+
+#if SDIO_DDR_MODE
+	/* DDR52 is set on top of high speed at 52MHz, with a 4 or 8 bit bus */
+	if ((type & EXT_CSD_CARD_TYPE_DDR52) && (width > 1) && (g_card_info->speed == MMC_HIGH_BUS_MAX_CLOCK)) {
+		if (prv_mmc_set_width(pSDMMC, width, 1, sec_count) == 0) {
+			g_card_info->card_type |= CARD_TYPE_DDR;
+		}
+		else {
+			prv_mmc_set_width(pSDMMC, width, 0, sec_count);
+		}
+	}
+#endif
+}
+
+/* Byte of the EXT_CSD of an MMC 4.x card, 0 on other cards (no EXT_CSD read, or the buffer holds
+   the SD switch status) */
+static uint32_t prv_ext_csd(uint32_t index)
+{
+	if ((g_card_info->card_type & CARD_TYPE_SD) || !(g_card_info->card_type & CARD_TYPE_CMD23)) {
+		return 0;
+	}
+
+	return ((uint8_t *) g_card_info->ext_csd)[index];
+}
+
+/* Blocks of a partition, 0 when the card does not have it. The RPMB is never accessed as blocks. */
+static uint32_t prv_part_blocks(uint32_t part)
+{
+	uint32_t index, mult;
+
+	if (part == MMC_PART_USER) {
+		return g_card_info->blocknr;
+	}
+	if ((part == MMC_PART_BOOT1) || (part == MMC_PART_BOOT2)) {
+		return prv_ext_csd(EXT_CSD_BOOT_SIZE_MULT) * ((128 * 1024) / MMC_SECTOR_SIZE);
+	}
+
+	/* general purpose partitions are there once their setting is completed */
+	if ((part < MMC_PART_GP1) || (part >= MMC_PART_COUNT) || (prv_ext_csd(EXT_CSD_REV) < EXT_CSD_REV_4_41) ||
+		!(prv_ext_csd(EXT_CSD_PART_SETTING) & EXT_CSD_PART_SETTING_DONE)) {
+		return 0;
+	}
+	index = EXT_CSD_GP_SIZE_MULT + 3 * (part - MMC_PART_GP1);
+	mult = prv_ext_csd(index) | (prv_ext_csd(index + 1) << 8) | (prv_ext_csd(index + 2) << 16);
+
+	/* in write protect groups of erase groups of 512KB */
+	return mult * prv_ext_csd(EXT_CSD_HC_WP_GRP_SIZE) * prv_ext_csd(EXT_CSD_HC_ERASE_GRP_SIZE) *
+		   ((512 * 1024) / MMC_SECTOR_SIZE);
+}
+
+/* Puts an MMC 4.x card on its user area, where a boot loader may have left another partition,
+   and turns its cache on */
+static void prv_mmc_set_features(LPC_SDMMC_T *pSDMMC)
+{
+	uint32_t config = prv_ext_csd(EXT_CSD_PART_CONFIG);
+
+	g_card_info->part = MMC_PART_USER;
+	if ((config & EXT_CSD_PART_ACCESS_MSK) &&
+		(prv_mmc_switch(pSDMMC, EXT_CSD_PART_CONFIG, config & ~EXT_CSD_PART_ACCESS_MSK, SWITCH_RETRIES) != 0)) {
+		g_card_info->part = config & EXT_CSD_PART_ACCESS_MSK;
+	}
+
+#if SDIO_MMC_CACHE
+	if ((prv_ext_csd(EXT_CSD_REV) >= EXT_CSD_REV_4_5) &&
+		(prv_ext_csd(EXT_CSD_CACHE_SIZE) | prv_ext_csd(EXT_CSD_CACHE_SIZE + 1) |
+		 prv_ext_csd(EXT_CSD_CACHE_SIZE + 2) | prv_ext_csd(EXT_CSD_CACHE_SIZE + 3)) &&
+		(prv_mmc_switch(pSDMMC, EXT_CSD_CACHE_CTRL, 1, SWITCH_RETRIES) == 0)) {
+		g_card_info->card_type |= CARD_TYPE_CACHE;
+	}
+#endif
+}
+
+/* Reads the SCR of an SD card, CMD23 support is taken from it */
+static int32_t prv_sd_read_scr(LPC_SDMMC_T *pSDMMC)
+{
+	int32_t status;
+
+	/* ACMD51 has data, the APP prefix is sent on its own so it waits for its command done only */
+	if (sdmmc_execute_command(pSDMMC, CMD_APP_CMD, g_card_info->rca << 16, 0) != 0) {
+		return -1;
+	}
+	IP_SDMMC_SetBlockSize(pSDMMC, SD_SCR_SIZE);
+	IP_SDMMC_DmaSetup(pSDMMC, &g_card_info->sdif_dev, MCI_BUS_ADDR(g_card_info->scr), SD_SCR_SIZE);
+
+	status = sdmmc_execute_command(pSDMMC, CMD_SD_SEND_SCR, 0, 0 | MCI_INT_DATA_OVER);
+	IP_SDMMC_SetBlkSize(pSDMMC, MMC_SECTOR_SIZE);
+
+	if (status & SD_INT_ERROR) {
+		return -1;
+	}
+	if (SD_SCR_CMD23((uint8_t *) g_card_info->scr)) {
+		g_card_info->card_type |= CARD_TYPE_CMD23;
+	}
+
+	return 0;
+}
+
+/* Announces a multiple block transfer to the card: ACMD23 pre-erase before long SD writes, and
+   CMD23 with the block count when the card has it, the transfer then ends without a stop command.
+   Returns the command to send. */
+static uint32_t prv_set_block_count(LPC_SDMMC_T *pSDMMC, uint32_t cmd, int32_t num_blocks)
+{
+	/* a failed pre-erase only costs the speed up */
+	if ((cmd & CMD_BIT_WRITE) && (g_card_info->card_type & CARD_TYPE_SD) && g_card_info->pre_erase_min &&
+		(num_blocks >= (int32_t) g_card_info->pre_erase_min) && (num_blocks <= SD_MAX_ERASE_COUNT)) {
+		sdmmc_execute_command(pSDMMC, CMD_SD_SET_ERASE_COUNT, num_blocks, 0);
+	}
+
+	if ((g_card_info->card_type & CARD_TYPE_CMD23) && (num_blocks <= MMC_MAX_BLOCK_COUNT)) {
+		if (sdmmc_execute_command(pSDMMC, CMD_SET_BLOCK_COUNT, num_blocks, 0) == 0) {
+			return cmd & ~CMD_BIT_AUTO_STOP;
+		}
+	}
+
+	return cmd;
+}
+
+/* Sends SD CMD6 and reads its 64 byte status in the EXT_CSD buffer (unused by SD cards) */
+static int32_t prv_sd_switch(LPC_SDMMC_T *pSDMMC, uint32_t arg)
+{
+	int32_t status;
+
+	IP_SDMMC_SetBlockSize(pSDMMC, SD_SWITCH_STATUS_SIZE);
+	IP_SDMMC_DmaSetup(pSDMMC, &g_card_info->sdif_dev, MCI_BUS_ADDR(g_card_info->ext_csd), SD_SWITCH_STATUS_SIZE);
+
+	status = sdmmc_execute_command(pSDMMC, CMD_SD_SWITCH, arg, 0 | MCI_INT_DATA_OVER);
+	IP_SDMMC_SetBlkSize(pSDMMC, MMC_SECTOR_SIZE);
+
+	return (status & SD_INT_ERROR) ? -1 : 0;
+}
+
+/* Moves an SD card to high speed (50MHz) when it has the switch function */
+static void prv_sd_set_bus_mode(LPC_SDMMC_T *pSDMMC)
+{
+	uint8_t *sw_status = (uint8_t *) g_card_info->ext_csd;
+
+	/* the switch function is command class 10 (SD 1.10 and later) */
+	if (!(prv_get_bits(84, 95, (uint32_t *) g_card_info->csd) & (1 << 10))) {
+		return;
+	}
+
+	/* check mode tells whether the card can switch without changing anything */
+	if ((prv_sd_switch(pSDMMC, SD_SWITCH_CHECK) != 0) || !SD_SWITCH_HS_SUPPORT(sw_status) ||
+		(SD_SWITCH_GRP1_RESULT(sw_status) != 1)) {
+		return;
+	}
+	if ((prv_sd_switch(pSDMMC, SD_SWITCH_SET) != 0) || (SD_SWITCH_GRP1_RESULT(sw_status) != 1)) {
+		return;
+	}
+
+	/* the card runs high speed timing 8 clocks after the status, check it with another transfer.
+	   High speed cards keep working at the default clock, the fallback. */
+	g_card_info->speed = SD_HS_MAX_CLOCK;
+	if (prv_sd_switch(pSDMMC, SD_SWITCH_CHECK) != 0) {
+		g_card_info->speed = SD_MAX_CLOCK;
+		return;
+	}
+	g_card_info->card_type |= CARD_TYPE_HS;
+}
+
+/* Posts a command of a started transfer, its end raises the SDIO interrupt */
+static void prv_post_xfer_command(LPC_SDMMC_T *pSDMMC, uint32_t cmd_reg, uint32_t arg, uint32_t wait_status)
+{
+	IP_SDMMC_SetRawIntStatus(pSDMMC, 0xFFFFFFFF);
+	g_card_info->evsetup_cb(wait_status | SD_INT_ERROR);
+	IP_SDMMC_StartCmd(pSDMMC, cmd_reg, arg);
+}
+
+/* Number of blocks in a list of buffers, 0 when the total is not a whole number of blocks */
+static int32_t prv_sg_blocks(const IP_SDMMC_SG_T *sg, uint32_t count)
+{
+	uint32_t total = 0;
+
+	while (count--) {
+		total += sg[count].size;
+	}
+
+	return (total % MMC_SECTOR_SIZE) ? 0 : (int32_t) (total / MMC_SECTOR_SIZE);
+}
+
+/* Address of a block in the commands: the block number on high capacity cards, the byte offset on others */
+static uint32_t prv_card_index(int32_t block)
+{
+	return (g_card_info->card_type & CARD_TYPE_HC) ? (uint32_t) block : ((uint32_t) block << 9);
+}
+
+/* Most writes of a packed write command, 0 when the card has no packed commands */
+static uint32_t prv_packed_max(void)
+{
+	uint32_t max = prv_ext_csd(EXT_CSD_MAX_PACKED_WRITES);
+
+	if (prv_ext_csd(EXT_CSD_REV) < EXT_CSD_REV_4_5) {
+		return 0;
+	}
+
+	return (max < PACKED_WRITE_MAX) ? max : PACKED_WRITE_MAX;
+}
+
+/* Sends writes in one packed write command: CMD23 with the packed bit and the blocks of the header
+   and all the data, then CMD25 at the address of the first write */
+static int32_t prv_mmc_packed_write(LPC_SDMMC_T *pSDMMC, const MCI_PACKED_WRITE_T *writes, uint32_t count)
+{
+	IP_SDMMC_SG_T sg[1 + PACKED_WRITE_MAX];
+	uint32_t cmd = CMD_WRITE_MULTIPLE;
+	uint32_t blocks = 1;
+	int32_t status;
+	uint32_t i;
+
+	/* the header and the descriptors of a started transfer are in use until it ends */
+	if (g_card_info->xfer_state != MCI_XFER_IDLE) {
+		return -1;
+	}
+
+	memset(g_packed_hdr, 0, sizeof(g_packed_hdr));
+	g_packed_hdr[0] = (count << 16) | (MMC_PACKED_WRITE << 8) | MMC_PACKED_VERSION;
+	sg[0].addr = MCI_BUS_ADDR(g_packed_hdr);
+	sg[0].size = MMC_SECTOR_SIZE;
+	for (i = 0; i < count; i++) {
+		if ((writes[i].num_blocks <= 0) || (writes[i].start_block < 0) ||
+			(((uint32_t) writes[i].start_block + (uint32_t) writes[i].num_blocks) > prv_part_blocks(g_card_info->part))) {
+			return -1;
+		}
+		g_packed_hdr[2 * (i + 1)] = writes[i].num_blocks;
+		g_packed_hdr[2 * (i + 1) + 1] = prv_card_index(writes[i].start_block);
+		sg[i + 1].addr = MCI_BUS_ADDR(writes[i].buffer);
+		sg[i + 1].size = writes[i].num_blocks * MMC_SECTOR_SIZE;
+		blocks += writes[i].num_blocks;
+	}
+
+	if ((blocks > MMC_MAX_BLOCK_COUNT) ||
+		(IP_SDMMC_DmaSetupSG(pSDMMC, &g_card_info->sdif_dev, sg, count + 1) == 0)) {
+		return -1;
+	}
+	if ((prv_set_trans_state(pSDMMC) != 0) ||
+		(sdmmc_execute_command(pSDMMC, CMD_SET_BLOCK_COUNT, blocks | MMC_CMD23_PACKED, 0) != 0)) {
+		return -1;
+	}
+
+	pSDMMC->BYTCNT = blocks * MMC_SECTOR_SIZE;
+	status = sdmmc_execute_command(pSDMMC, cmd & ~CMD_BIT_AUTO_STOP, g_packed_hdr[3], 0 | MCI_INT_DATA_OVER);
+	if (status != 0) {
+		/* the card may still wait for the rest of the announced blocks */
+		sdmmc_execute_command(pSDMMC, CMD_STOP, 0, 0);
+	}
+	g_card_info->busy_pending = 1;
+
+	return (status != 0) ? -1 : 0;
+}
+
+/* Starts a read or write without waiting for its end */
+static int32_t prv_start_xfer(LPC_SDMMC_T *pSDMMC, uint32_t write, const IP_SDMMC_SG_T *sg, uint32_t count,
+							  int32_t start_block, MCI_XFER_DONE_FUNC_T done_cb, void *arg)
+{
+	int32_t num_blocks = prv_sg_blocks(sg, count);
+	int32_t bytes = num_blocks * MMC_SECTOR_SIZE;
+	uint32_t index;
+	uint32_t cmd;
+
+	if ((g_card_info->xfer_state != MCI_XFER_IDLE) || (num_blocks <= 0) || (start_block < 0) ||
+		(((uint32_t) start_block + (uint32_t) num_blocks) > prv_part_blocks(g_card_info->part))) {
+		return 0;
+	}
+
+	/* the descriptors go first, a list they cannot hold is refused before the card is told anything */
+	if (IP_SDMMC_DmaSetupSG(pSDMMC, &g_card_info->sdif_dev, sg, count) == 0) {
+		return 0;
+	}
+
+	/* put card in trans state */
+	if (prv_set_trans_state(pSDMMC) != 0) {
+		return 0;
+	}
+	if (num_blocks == 1) {
+		cmd = write ? CMD_WRITE_SINGLE : CMD_READ_SINGLE;
+	}
+	else {
+		cmd = prv_set_block_count(pSDMMC, write ? CMD_WRITE_MULTIPLE : CMD_READ_MULTIPLE, num_blocks);
+	}
+
+	/* block number or byte offset, as the card addresses it */
+	index = prv_card_index(start_block);
+
+	pSDMMC->BYTCNT = bytes;
+	IP_SDMMC_SetClearIntFifo(pSDMMC);
+	IP_SDMMC_SetClock(pSDMMC, Chip_Clock_GetRate(CLK_MX_SDIO), g_card_info->speed);
+
+	g_card_info->xfer_done_cb = done_cb;
+	g_card_info->xfer_arg = arg;
+	g_card_info->xfer_state = write ? MCI_XFER_WRITE : MCI_XFER_READ;
+#if SDIO_STATS
+	g_xfer_cmd = cmd;
+	g_xfer_bytes = bytes;
+	g_xfer_start = prv_stat_start();
+#endif
+
+	/* a multiple block transfer also waits for its auto-stop, the CIU is busy until then */
+	g_card_info->xfer_wait = MCI_INT_DATA_OVER | ((cmd & CMD_BIT_AUTO_STOP) ? MCI_INT_ACD : 0);
+	prv_post_xfer_command(pSDMMC, prv_cmd_reg(cmd), index, g_card_info->xfer_wait);
+
+	return bytes;
+}
+
+/* Ends the started transfer and calls its completion */
+static void prv_end_xfer(uint32_t status)
+{
+#if SDIO_STATS
+	prv_stat_cmd(g_xfer_cmd, g_xfer_start, g_xfer_bytes, status);
+#endif
+	if (status) {
+		g_card_info->tran_state = 0;
+	}
+	g_card_info->busy_pending = 1;
+	g_card_info->xfer_state = MCI_XFER_IDLE;
+	if (g_card_info->xfer_done_cb) {
+		g_card_info->xfer_done_cb(g_card_info->xfer_arg, status);
+	}
+}
+
 /*****************************************************************************
  * Public functions
  ****************************************************************************/
@@ -307,6 +972,19 @@ void Chip_SDMMC_Init(LPC_SDMMC_T *pSDMMC)
 {
 	Chip_Clock_EnableOpts(CLK_MX_SDIO, true, true, 1);
 	IP_SDMMC_Init(pSDMMC);
+
+#if SDIO_STATS
+	/* the statistics time the commands with the cycle counter, the core runs on the SDIO branch clock */
+#ifndef SDMMC_SIM
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+	g_cycles_per_us = Chip_Clock_GetRate(CLK_MX_SDIO) / 1000000;
+	if (g_cycles_per_us == 0) {
+		g_cycles_per_us = 1;
+	}
+	memset(&g_stats, 0, sizeof(g_stats));
+#endif
 }
 
 /* Shutdown the MCI card controller */
@@ -344,6 +1022,47 @@ int32_t Chip_SDMMC_GetState(LPC_SDMMC_T *pSDMMC)
 	return (int32_t) R1_CURRENT_STATE(g_card_info->response[0]);
 }
 
+/* Gets the command statistics */
+void Chip_SDMMC_GetStats(LPC_SDMMC_T *pSDMMC, MCI_STATS_T *stats)
+{
+	uint32_t div = pSDMMC->CLKDIV & 0xFF;
+	uint32_t rate = Chip_Clock_GetRate(CLK_MX_SDIO);
+
+#if SDIO_STATS
+	memcpy(stats, &g_stats, sizeof(*stats));
+#else
+	memset(stats, 0, sizeof(*stats));
+#endif
+
+	/* the divider halves the clock once more */
+	stats->bus_clock = pSDMMC->CLKENA ? (div ? (rate / (2 * div)) : rate) : 0;
+	if (g_card_info) {
+		stats->card_type = g_card_info->card_type;
+		memcpy(stats->cid, g_card_info->cid, sizeof(stats->cid));
+	}
+}
+
+/* Clears the command statistics */
+void Chip_SDMMC_ResetStats(LPC_SDMMC_T *pSDMMC)
+{
+#if SDIO_STATS
+	memset(&g_stats, 0, sizeof(g_stats));
+#endif
+}
+
+/* Tells whether the card is still busy with the last transfer */
+int32_t Chip_SDMMC_CardBusy(LPC_SDMMC_T *pSDMMC)
+{
+	if (g_card_info->xfer_state != MCI_XFER_IDLE) {
+		return 1;
+	}
+	if (g_card_info->busy_pending && !IP_SDMMC_CiuBusy(pSDMMC) && !IP_SDMMC_CardBusy(pSDMMC)) {
+		g_card_info->busy_pending = 0;
+	}
+
+	return g_card_info->busy_pending;
+}
+
 /* Function to enumerate the SD/MMC/SDHC/MMC+ cards */
 uint32_t Chip_SDMMC_Acquire(LPC_SDMMC_T *pSDMMC, mci_card_struct *pcardinfo)
 {
@@ -355,9 +1074,17 @@ uint32_t Chip_SDMMC_Acquire(LPC_SDMMC_T *pSDMMC, mci_card_struct *pcardinfo)
 	uint32_t command = 0;
 
 	g_card_info = pcardinfo;
+	prv_select_bus();
 
-	/* clear card type */
+	/* clear card type and the bus mode of a previous card */
 	IP_SDMMC_SetCardType(pSDMMC, 0);
+	pSDMMC->UHS_REG = 0;
+	g_card_info->card_type &= ~(CARD_TYPE_4BIT | CARD_TYPE_8BIT | CARD_TYPE_HS | CARD_TYPE_DDR | CARD_TYPE_CMD23 |
+								CARD_TYPE_CACHE);
+	g_card_info->busy_pending = 0;
+	g_card_info->tran_state = 0;
+	g_card_info->card_check = 0;
+	g_card_info->part = MMC_PART_USER;
 
 	/* set high speed for the card as 20MHz */
 	g_card_info->speed = MMC_MAX_CLOCK;
@@ -423,6 +1150,7 @@ uint32_t Chip_SDMMC_Acquire(LPC_SDMMC_T *pSDMMC, mci_card_struct *pcardinfo)
 		case 3:		/* Initial wait for OCR clear */
 		case 13:
 			while ((ocr & OCR_ALL_READY) && --tries > 0) {
+				prv_stat_retry(command);
 				g_card_info->msdelay_func(MS_ACQUIRE_DELAY);
 				status = sdmmc_execute_command(pSDMMC, command, 0, 0);
 				ocr = g_card_info->response[0] | (ocr & OCR_HC_CCS);
@@ -446,6 +1174,9 @@ uint32_t Chip_SDMMC_Acquire(LPC_SDMMC_T *pSDMMC, mci_card_struct *pcardinfo)
 				g_card_info->msdelay_func(MS_ACQUIRE_DELAY);
 				status = sdmmc_execute_command(pSDMMC, command, ocr, 0);
 				r = g_card_info->response[0];
+				if (!(r & OCR_ALL_READY)) {
+					prv_stat_retry(command);
+				}
 			} while (!(r & OCR_ALL_READY) && --tries > 0);
 
 			if (r & OCR_ALL_READY) {
@@ -501,11 +1232,113 @@ uint32_t Chip_SDMMC_Acquire(LPC_SDMMC_T *pSDMMC, mci_card_struct *pcardinfo)
 		if (prv_set_card_params(pSDMMC) != 0) {
 			return 0;
 		}
+
+		/* Negotiate the fastest bus mode, a mode that fails is not used */
+		if (g_card_info->card_type & CARD_TYPE_SD) {
+			prv_sd_read_scr(pSDMMC);
+			prv_sd_set_bus_mode(pSDMMC);
+		}
+		else {
+			prv_mmc_set_bus_mode(pSDMMC);
+			prv_mmc_set_features(pSDMMC);
+		}
+		g_card_info->card_check = prv_card_check();
 	}
 
 	return prv_card_acquired();
 }
 
+/* Makes an acquired card the card of the calls that follow */
+int32_t Chip_SDMMC_SelectCard(LPC_SDMMC_T *pSDMMC, mci_card_struct *pcardinfo)
+{
+	if (pcardinfo == g_card_info) {
+		return 0;
+	}
+	if (g_card_info && (g_card_info->xfer_state != MCI_XFER_IDLE)) {
+		return -1;
+	}
+
+	/* the auto-stop of the last transfer goes to the card it was for, the programming that follows
+	   does not need the bus */
+	while (IP_SDMMC_CiuBusy(pSDMMC)) {}
+
+	g_card_info = pcardinfo;
+	prv_select_bus();
+	prv_set_host_mode(pSDMMC);
+
+	return 0;
+}
+
+/* Get the card the calls run on */
+mci_card_struct *Chip_SDMMC_GetCard(LPC_SDMMC_T *pSDMMC)
+{
+	return g_card_info;
+}
+
+/* Takes back the card of an earlier Chip_SDMMC_Acquire() without enumerating it again */
+uint32_t Chip_SDMMC_Reacquire(LPC_SDMMC_T *pSDMMC, mci_card_struct *pcardinfo)
+{
+	uint32_t scr[2];
+	uint32_t state;
+
+	g_card_info = pcardinfo;
+	prv_select_bus();
+	g_card_info->xfer_state = MCI_XFER_IDLE;
+	g_card_info->busy_pending = 0;
+	g_card_info->tran_state = 0;
+
+	if (!prv_card_acquired() || (g_card_info->card_check != prv_card_check())) {
+		return 0;
+	}
+
+	/* a card out of an enumeration does not answer at the address */
+	if (sdmmc_execute_command(pSDMMC, CMD_SEND_STATUS, g_card_info->rca << 16, 0) != 0) {
+		return 0;
+	}
+	state = R1_CURRENT_STATE(g_card_info->response[0]);
+	if (state == SDMMC_TRAN_ST) {
+		/* deselect has no response */
+		sdmmc_execute_command(pSDMMC, CMD_DESELECT_CARD, 0, MCI_INT_CMD_DONE);
+		state = SDMMC_STBY_ST;
+	}
+	if (state != SDMMC_STBY_ST) {
+		return 0;
+	}
+
+	/* the CID is only sent in stand-by state */
+	if ((sdmmc_execute_command(pSDMMC, CMD_SEND_CID, g_card_info->rca << 16, 0) != 0) ||
+		(memcmp(g_card_info->response, g_card_info->cid, sizeof(g_card_info->cid)) != 0)) {
+		return 0;
+	}
+	if (sdmmc_execute_command(pSDMMC, CMD_SELECT_CARD, g_card_info->rca << 16, 0) != 0) {
+		return 0;
+	}
+
+	/* the card kept its bus width, timing and block length, set the host side again and check it
+	   with a data transfer */
+	prv_set_host_mode(pSDMMC);
+
+	if (g_card_info->card_type & CARD_TYPE_SD) {
+		memcpy(scr, g_card_info->scr, sizeof(scr));
+		if ((prv_sd_read_scr(pSDMMC) != 0) || (memcmp(scr, g_card_info->scr, sizeof(scr)) != 0)) {
+			return 0;
+		}
+	}
+	else if (prv_mmc_check_bus(pSDMMC, g_card_info->ext_csd[EXT_CSD_SEC_COUNT / 4]) != 0) {
+		return 0;
+	}
+
+	/* the card also kept its partition and cache, as read back in EXT_CSD */
+	g_card_info->part = prv_ext_csd(EXT_CSD_PART_CONFIG) & EXT_CSD_PART_ACCESS_MSK;
+	if (!(prv_ext_csd(EXT_CSD_CACHE_CTRL) & 1)) {
+		g_card_info->card_type &= ~CARD_TYPE_CACHE;
+	}
+
+	g_card_info->tran_state = 1;
+	g_card_info->card_check = prv_card_check();
+	return 1;
+}
+
 /* Get the device size of SD/MMC card (after enumeration) */
 int32_t Chip_SDMMC_GetDeviceSize(LPC_SDMMC_T *pSDMMC)
 {
@@ -518,15 +1351,84 @@ int32_t Chip_SDMMC_GetDeviceBlocks(LPC_SDMMC_T *pSDMMC)
 	return g_card_info->blocknr;
 }
 
+/* Get the number of blocks in a partition of an MMC card */
+int32_t Chip_SDMMC_GetPartBlocks(LPC_SDMMC_T *pSDMMC, uint32_t part)
+{
+	return prv_part_blocks(part);
+}
+
+/* Selects the partition of an MMC card accessed by the transfers */
+int32_t Chip_SDMMC_SetPartition(LPC_SDMMC_T *pSDMMC, uint32_t part)
+{
+	uint32_t config;
+
+	if (part == g_card_info->part) {
+		return 0;
+	}
+	if ((prv_part_blocks(part) == 0) || (g_card_info->xfer_state != MCI_XFER_IDLE) ||
+		(prv_set_trans_state(pSDMMC) != 0)) {
+		return -1;
+	}
+
+	config = (prv_ext_csd(EXT_CSD_PART_CONFIG) & ~EXT_CSD_PART_ACCESS_MSK) | part;
+	if (prv_mmc_switch(pSDMMC, EXT_CSD_PART_CONFIG, config, SWITCH_RETRIES) != 0) {
+		return -1;
+	}
+	g_card_info->part = part;
+
+	return 0;
+}
+
+/* Get the type of the acquired card */
+uint32_t Chip_SDMMC_GetCardType(LPC_SDMMC_T *pSDMMC)
+{
+	return g_card_info->card_type;
+}
+
+/* Writes the cache of an MMC card to the flash */
+int32_t Chip_SDMMC_FlushCache(LPC_SDMMC_T *pSDMMC)
+{
+	if (!(g_card_info->card_type & CARD_TYPE_CACHE)) {
+		return 0;
+	}
+	if ((g_card_info->xfer_state != MCI_XFER_IDLE) || (prv_set_trans_state(pSDMMC) != 0)) {
+		return -1;
+	}
+
+	return prv_mmc_switch(pSDMMC, EXT_CSD_FLUSH_CACHE, 1, MS_CACHE_FLUSH_TIMEOUT);
+}
+
 /* Performs the read of data from the SD/MMC card */
 int32_t Chip_SDMMC_ReadBlocks(LPC_SDMMC_T *pSDMMC, void *buffer, int32_t start_block, int32_t num_blocks)
 {
+	IP_SDMMC_SG_T sg;
+
+	sg.addr = MCI_BUS_ADDR(buffer);
+	sg.size = num_blocks * MMC_SECTOR_SIZE;
+	return Chip_SDMMC_ReadBlocksSG(pSDMMC, &sg, 1, start_block);
+}
+
+/* Performs the read of data from the SD/MMC card to a list of buffers */
+int32_t Chip_SDMMC_ReadBlocksSG(LPC_SDMMC_T *pSDMMC, const IP_SDMMC_SG_T *sg, uint32_t count, int32_t start_block)
+{
+	int32_t num_blocks = prv_sg_blocks(sg, count);
 	int32_t cbRead = (num_blocks) * MMC_SECTOR_SIZE;
 	int32_t status = 0;
-	int32_t index;
+	uint32_t index;
+	uint32_t cmd;
+
+	/* a started transfer owns the descriptors and BYTCNT until it ends */
+	if (g_card_info->xfer_state != MCI_XFER_IDLE) {
+		return 0;
+	}
 
 	/* if card is not acquired return immediately */
-	if (( start_block < 0) || ( (start_block + num_blocks) > g_card_info->blocknr) ) {
+	if ((num_blocks == 0) || ( start_block < 0) || ( ((uint32_t) start_block + (uint32_t) num_blocks) > prv_part_blocks(g_card_info->part)) ) {
+		return 0;
+	}
+
+	/* the descriptors go first, a list they cannot hold is refused before the card is told anything */
+	if (IP_SDMMC_DmaSetupSG(pSDMMC, &g_card_info->sdif_dev, sg, count) == 0) {
 		return 0;
 	}
 
@@ -535,32 +1437,22 @@ int32_t Chip_SDMMC_ReadBlocks(LPC_SDMMC_T *pSDMMC, void *buffer, int32_t start_b
 		return 0;
 	}
 
+	/* Select single or multiple read based on number of blocks */
+	cmd = (num_blocks == 1) ? CMD_READ_SINGLE : prv_set_block_count(pSDMMC, CMD_READ_MULTIPLE, num_blocks);
+
 	/* set number of bytes to read */
 	pSDMMC->BYTCNT = cbRead;
 
-	/* if high capacity card use block indexing */
-	if (g_card_info->card_type & CARD_TYPE_HC) {
-		index = start_block;
-	}
-	else {	/*fix at 512 bytes*/
-		index = start_block << 9;	// \* g_card_info->block_len;
-
-	}
-	IP_SDMMC_DmaSetup(pSDMMC, &g_card_info->sdif_dev, (uint32_t) buffer, cbRead);
+	/* block number or byte offset, as the card addresses it */
+	index = prv_card_index(start_block);
 
-	/* Select single or multiple read based on number of blocks */
-	if (num_blocks == 1) {
-		status = sdmmc_execute_command(pSDMMC, CMD_READ_SINGLE, index, 0 | MCI_INT_DATA_OVER);
-	}
-	else {
-		status = sdmmc_execute_command(pSDMMC, CMD_READ_MULTIPLE, index, 0 | MCI_INT_DATA_OVER);
-	}
+	status = sdmmc_execute_command(pSDMMC, cmd, index, 0 | MCI_INT_DATA_OVER);
 
 	if (status != 0) {
 		cbRead = 0;
 	}
-	/*Wait for card program to finish*/
-	while (Chip_SDMMC_GetState(pSDMMC) != SDMMC_TRAN_ST) ;
+	/* the auto-stop may still run, the next command waits for it */
+	g_card_info->busy_pending = 1;
 
 	return cbRead;
 }
@@ -568,50 +1460,172 @@ int32_t Chip_SDMMC_ReadBlocks(LPC_SDMMC_T *pSDMMC, void *buffer, int32_t start_b
 /* Performs write of data to the SD/MMC card */
 int32_t Chip_SDMMC_WriteBlocks(LPC_SDMMC_T *pSDMMC, void *buffer, int32_t start_block, int32_t num_blocks)
 {
+	IP_SDMMC_SG_T sg;
+
+	sg.addr = MCI_BUS_ADDR(buffer);
+	sg.size = num_blocks * MMC_SECTOR_SIZE;
+	return Chip_SDMMC_WriteBlocksSG(pSDMMC, &sg, 1, start_block);
+}
+
+/* Performs write of data from a list of buffers to the SD/MMC card */
+int32_t Chip_SDMMC_WriteBlocksSG(LPC_SDMMC_T *pSDMMC, const IP_SDMMC_SG_T *sg, uint32_t count, int32_t start_block)
+{
+	int32_t num_blocks = prv_sg_blocks(sg, count);
 	int32_t cbWrote = num_blocks *  MMC_SECTOR_SIZE;
 	int32_t status;
-	int32_t index;
+	uint32_t index;
+	uint32_t cmd;
+
+	/* a started transfer owns the descriptors and BYTCNT until it ends */
+	if (g_card_info->xfer_state != MCI_XFER_IDLE) {
+		return 0;
+	}
 
 	/* if card is not acquired return immediately */
-	if (( start_block < 0) || ( (start_block + num_blocks) > g_card_info->blocknr) ) {
+	if ((num_blocks == 0) || ( start_block < 0) || ( ((uint32_t) start_block + (uint32_t) num_blocks) > prv_part_blocks(g_card_info->part)) ) {
 		return 0;
 	}
 
-	/*Wait for card program to finish*/
-	while (Chip_SDMMC_GetState(pSDMMC) != SDMMC_TRAN_ST) ;
+	/* the descriptors go first, a list they cannot hold is refused before the card is told anything */
+	if (IP_SDMMC_DmaSetupSG(pSDMMC, &g_card_info->sdif_dev, sg, count) == 0) {
+		return 0;
+	}
 
 	/* put card in trans state */
 	if (prv_set_trans_state(pSDMMC) != 0) {
 		return 0;
 	}
 
+	/* Select single or multiple write based on number of blocks */
+	cmd = (num_blocks == 1) ? CMD_WRITE_SINGLE : prv_set_block_count(pSDMMC, CMD_WRITE_MULTIPLE, num_blocks);
+
 	/* set number of bytes to write */
 	pSDMMC->BYTCNT = cbWrote;
 
-	/* if high capacity card use block indexing */
-	if (g_card_info->card_type & CARD_TYPE_HC) {
-		index = start_block;
-	}
-	else {	/*fix at 512 bytes*/
-		index = start_block << 9;	// * g_card_info->block_len;
+	/* block number or byte offset, as the card addresses it */
+	index = prv_card_index(start_block);
+
+	status = sdmmc_execute_command(pSDMMC, cmd, index, 0 | MCI_INT_DATA_OVER);
+
+	/* the card programs the blocks now, the next command waits for it */
+	g_card_info->busy_pending = 1;
 
+	if (status != 0) {
+		cbWrote = 0;
 	}
-	IP_SDMMC_DmaSetup(pSDMMC, &g_card_info->sdif_dev, (uint32_t) buffer, cbWrote);
 
-	/* Select single or multiple write based on number of blocks */
-	if (num_blocks == 1) {
-		status = sdmmc_execute_command(pSDMMC, CMD_WRITE_SINGLE, index, 0 | MCI_INT_DATA_OVER);
+	return cbWrote;
+}
+
+/* Performs writes to several places of the SD/MMC card */
+int32_t Chip_SDMMC_WriteBlocksPacked(LPC_SDMMC_T *pSDMMC, const MCI_PACKED_WRITE_T *writes, uint32_t count)
+{
+	uint32_t max = prv_packed_max();
+	int32_t cbWrote = 0;
+	uint32_t n, i;
+
+	while (count > 0) {
+		n = (max > 1) ? ((count < max) ? count : max) : 1;
+
+		/* a single write goes alone, the writes of a packed command that failed are sent again
+		   one by one (the card reports the failed one, but writing them all again is harmless) */
+		if ((n == 1) || (prv_mmc_packed_write(pSDMMC, writes, n) != 0)) {
+			for (i = 0; i < n; i++) {
+				if (Chip_SDMMC_WriteBlocks(pSDMMC, writes[i].buffer, writes[i].start_block,
+										   writes[i].num_blocks) == 0) {
+					return 0;
+				}
+			}
+		}
+		for (i = 0; i < n; i++) {
+			cbWrote += writes[i].num_blocks * MMC_SECTOR_SIZE;
+		}
+		writes += n;
+		count -= n;
 	}
-	else {
-		status = sdmmc_execute_command(pSDMMC, CMD_WRITE_MULTIPLE, index, 0 | MCI_INT_DATA_OVER);
+
+	return cbWrote;
+}
+
+/* Starts a read of data from the SD/MMC card and returns at once */
+int32_t Chip_SDMMC_StartReadBlocks(LPC_SDMMC_T *pSDMMC, void *buffer, int32_t start_block, int32_t num_blocks,
+								   MCI_XFER_DONE_FUNC_T done_cb, void *arg)
+{
+	IP_SDMMC_SG_T sg;
+
+	sg.addr = MCI_BUS_ADDR(buffer);
+	sg.size = num_blocks * MMC_SECTOR_SIZE;
+	return prv_start_xfer(pSDMMC, 0, &sg, 1, start_block, done_cb, arg);
+}
+
+/* Starts a read of data from the SD/MMC card to a list of buffers */
+int32_t Chip_SDMMC_StartReadBlocksSG(LPC_SDMMC_T *pSDMMC, const IP_SDMMC_SG_T *sg, uint32_t count, int32_t start_block,
+									 MCI_XFER_DONE_FUNC_T done_cb, void *arg)
+{
+	return prv_start_xfer(pSDMMC, 0, sg, count, start_block, done_cb, arg);
+}
+
+/* Starts a write of data to the SD/MMC card and returns at once */
+int32_t Chip_SDMMC_StartWriteBlocks(LPC_SDMMC_T *pSDMMC, void *buffer, int32_t start_block, int32_t num_blocks,
+									MCI_XFER_DONE_FUNC_T done_cb, void *arg)
+{
+	IP_SDMMC_SG_T sg;
+
+	sg.addr = MCI_BUS_ADDR(buffer);
+	sg.size = num_blocks * MMC_SECTOR_SIZE;
+	return prv_start_xfer(pSDMMC, 1, &sg, 1, start_block, done_cb, arg);
+}
+
+/* Starts a write of data from a list of buffers to the SD/MMC card */
+int32_t Chip_SDMMC_StartWriteBlocksSG(LPC_SDMMC_T *pSDMMC, const IP_SDMMC_SG_T *sg, uint32_t count, int32_t start_block,
+									  MCI_XFER_DONE_FUNC_T done_cb, void *arg)
+{
+	return prv_start_xfer(pSDMMC, 1, sg, count, start_block, done_cb, arg);
+}
+
+/* Tells whether a started transfer is in flight */
+int32_t Chip_SDMMC_XferPending(LPC_SDMMC_T *pSDMMC)
+{
+	return g_card_info->xfer_state != MCI_XFER_IDLE;
+}
+
+/* Ends a started transfer that did not complete, without waiting for the card */
+void Chip_SDMMC_AbortXfer(LPC_SDMMC_T *pSDMMC)
+{
+	if (g_card_info->xfer_state == MCI_XFER_IDLE) {
+		return;
 	}
 
-	/*Wait for card program to finish*/
-//	while (Chip_SDMMC_GetState(pSDMMC) != SDMMC_TRAN_ST) ;
+	/* no more interrupt for it, the DMA and the FIFO drop what they hold */
+	Chip_SDMMC_SetIntMask(pSDMMC, 0);
+	pSDMMC->CTRL |= MCI_CTRL_DMA_RESET;
+	while (pSDMMC->CTRL & MCI_CTRL_DMA_RESET) {}
+	IP_SDMMC_SetClearIntFifo(pSDMMC);
 
-	if (status != 0) {
-		cbWrote = 0;
+	/* the card state is asked again before the next transfer, which stops a card still in data state */
+	prv_end_xfer(MCI_INT_DTO);
+}
+
+/* Runs a started transfer from the SDIO interrupt */
+void Chip_SDMMC_IRQHandler(LPC_SDMMC_T *pSDMMC)
+{
+	uint32_t status = Chip_SDMMC_GetIntStatus(pSDMMC);
+
+	if (g_card_info->xfer_state == MCI_XFER_IDLE) {
+		return;
+	}
+	if (status & SD_INT_ERROR) {
+		prv_end_xfer(status & SD_INT_ERROR);
+		return;
 	}
 
-	return cbWrote;
+	g_card_info->xfer_wait &= ~status;
+	if (g_card_info->xfer_wait) {
+		/* not the end of the data yet, wait again */
+		g_card_info->evsetup_cb(g_card_info->xfer_wait | SD_INT_ERROR);
+		return;
+	}
+
+	/* the blocks of a write are programmed from now on, the next command waits for it */
+	prv_end_xfer(0);
 }
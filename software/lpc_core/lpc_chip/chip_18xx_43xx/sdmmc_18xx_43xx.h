@@ -51,6 +51,8 @@ extern "C" {
    Send relative address   CMD3   R1        x
    Send relative address   CMD3   R6    x
    Program DSR             CMD4   NA        x
+   Switch                  CMD6   R1b       x
+   Switch function         CMD6   R1    x
    Select/deselect card    CMD7   R1b       x
    Select/deselect card    CMD7   R1    x
    Send CSD                CMD9   R2    x   x
@@ -180,6 +182,7 @@ typedef enum CHIP_SDMMC_STATE {
 #define MMC_ALL_SEND_CID          2		/* bcr                     R2  */
 #define MMC_SET_RELATIVE_ADDR     3		/* ac   [31:16] RCA        R1  */
 #define MMC_SET_DSR               4		/* bc   [31:16] RCA            */
+#define MMC_SWITCH                6		/* ac   [31:0]  see below  R1b */
 #define MMC_SELECT_CARD           7		/* ac   [31:16] RCA        R1  */
 #define MMC_SEND_EXT_CSD          8		/* bc                      R1  */
 #define MMC_SEND_CSD              9		/* ac   [31:16] RCA        R2  */
@@ -228,10 +231,17 @@ typedef enum CHIP_SDMMC_STATE {
 /* class 8 */
 /* This is basically the same command as for MMC with some quirks. */
 #define SD_SEND_RELATIVE_ADDR     3		/* ac                      R6  */
+#define SD_SWITCH                 6		/* adtc [31:0]  see below  R1  */
 #define SD_CMD8                   8		/* bcr  [31:0]  OCR        R3  */
 
+/* class 5 */
+#define SD_ERASE_WR_BLK_START    32		/* ac   [31:0]  data addr  R1  */
+#define SD_ERASE_WR_BLK_END      33		/* ac   [31:0]  data addr  R1  */
+#define SD_ERASE                 38		/* ac   [31:0]  erase arg  R1b */
+
 /* Application commands */
 #define SD_APP_SET_BUS_WIDTH      6		/* ac   [1:0]   bus width  R1   */
+#define SD_APP_SET_ERASE_COUNT   23		/* ac   [22:0]  blocks     R1   */
 #define SD_APP_OP_COND           41		/* bcr  [31:0]  OCR        R1 (R4)  */
 #define SD_APP_SEND_SCR          51		/* adtc                    R1   */
 
@@ -272,6 +282,7 @@ typedef enum CHIP_SDMMC_STATE {
 #define R1_STATUS(x)            (x & 0xFFFFE000)
 #define R1_CURRENT_STATE(x)     ((x & 0x00001E00) >> 9)	/* sx, b (4 bits) */
 #define R1_READY_FOR_DATA       (1 << 8)/* sx, a */
+#define R1_SWITCH_ERROR         (1 << 7)/* sx, c */
 #define R1_APP_CMD              (1 << 5)/* sr, c */
 
 #define OCR_ALL_READY           (1UL << 31)		/* Card Power up status bit */
@@ -282,6 +293,75 @@ typedef enum CHIP_SDMMC_STATE {
 #define SD_SEND_IF_ECHO_MSK     0x000000FF
 #define SD_SEND_IF_RESP         0x000000AA
 
+/* SD CMD6 arguments: mode (check or set) and the function of each of the 6 groups, 0xF keeps the
+   current one. Only group 1 (access mode) is changed, function 1 is high speed. The card answers
+   with a 64 byte status: byte 13 bit 1 tells high speed is supported, the low nibble of byte 16
+   is the function group 1 will run (0xF when it cannot switch). */
+#define SD_SWITCH_CHECK         0x00FFFFF1
+#define SD_SWITCH_SET           0x80FFFFF1
+#define SD_SWITCH_STATUS_SIZE   64
+#define SD_SWITCH_HS_SUPPORT(s) ((s)[13] & 0x02)
+#define SD_SWITCH_GRP1_RESULT(s) ((s)[16] & 0x0F)
+
+/* SD configuration register (ACMD51), 8 bytes sent MSB first: byte 3 bit 1 tells CMD23 support */
+#define SD_SCR_SIZE             8
+#define SD_SCR_CMD23(s)         ((s)[3] & 0x02)
+
+/* Most blocks announced by CMD23 (16 bits on MMC) and by ACMD23 */
+#define MMC_MAX_BLOCK_COUNT     0xFFFF
+#define SD_MAX_ERASE_COUNT      0x7FFFFF
+
+/* MMC CMD6 argument writing one byte of EXT_CSD */
+#define MMC_SWITCH_WRITE_BYTE   3
+#define MMC_SWITCH_ARG(idx, val) ((MMC_SWITCH_WRITE_BYTE << 24) | ((idx) << 16) | ((val) << 8))
+
+/* EXT_CSD bytes used for the bus mode */
+#define EXT_CSD_BUS_WIDTH       183
+#define EXT_CSD_HS_TIMING       185
+#define EXT_CSD_CARD_TYPE       196
+#define EXT_CSD_SEC_COUNT       212		/* 4 bytes */
+
+/* EXT_CSD bytes of the partitions, the cache and the packed commands */
+#define EXT_CSD_FLUSH_CACHE     32
+#define EXT_CSD_CACHE_CTRL      33
+#define EXT_CSD_GP_SIZE_MULT    143		/* 3 bytes for each of the 4 general purpose partitions */
+#define EXT_CSD_PART_SETTING    155
+#define EXT_CSD_PART_CONFIG     179
+#define EXT_CSD_REV             192
+#define EXT_CSD_HC_WP_GRP_SIZE  221
+#define EXT_CSD_HC_ERASE_GRP_SIZE 224
+#define EXT_CSD_BOOT_SIZE_MULT  226		/* 128KB units */
+#define EXT_CSD_CACHE_SIZE      249		/* 4 bytes */
+#define EXT_CSD_MAX_PACKED_WRITES 500
+
+#define EXT_CSD_REV_4_41        5		/* general purpose partitions */
+#define EXT_CSD_REV_4_5         6		/* cache and packed commands */
+#define EXT_CSD_PART_ACCESS_MSK 0x07	/* PART_CONFIG bits selecting the partition accessed */
+#define EXT_CSD_PART_SETTING_DONE 0x01
+
+/* Partitions of an MMC card, the PART_CONFIG value selecting them */
+#define MMC_PART_USER           0
+#define MMC_PART_BOOT1          1
+#define MMC_PART_BOOT2          2
+#define MMC_PART_RPMB           3		/* authenticated frames only, not accessed as blocks */
+#define MMC_PART_GP1            4		/* general purpose partitions 1 to 4 */
+#define MMC_PART_COUNT          8
+
+/* Packed write: CMD23 with the packed bit announces a header block followed by the data of all the
+   writes, the header lists the CMD23 and CMD25 arguments of each write in 8 byte entries after its own */
+#define MMC_CMD23_PACKED        (1 << 30)
+#define MMC_PACKED_VERSION      1
+#define MMC_PACKED_WRITE        2
+
+#define EXT_CSD_BUS_WIDTH_1     0
+#define EXT_CSD_BUS_WIDTH_4     1
+#define EXT_CSD_BUS_WIDTH_8     2
+#define EXT_CSD_BUS_WIDTH_DDR   4		/* added to the 4 or 8 bit value */
+
+#define EXT_CSD_CARD_TYPE_26    (1 << 0)	/* high speed up to 26MHz */
+#define EXT_CSD_CARD_TYPE_52    (1 << 1)	/* high speed up to 52MHz */
+#define EXT_CSD_CARD_TYPE_DDR52 (1 << 2)	/* dual data rate at 52MHz, 1.8V or 3V I/O */
+
 #define CMD_MASK_RESP       (0x3UL << 28)
 #define CMD_RESP(r)         (((r) & 0x3) << 28)
 #define CMD_RESP_R0         (0 << 28)
@@ -309,7 +389,14 @@ typedef enum CHIP_SDMMC_STATE {
 #define CMD_MMC_SET_RCA     CMD(MMC_SET_RELATIVE_ADDR, 1) | CMD_BIT_LS
 #define CMD_SD_SEND_RCA     CMD(SD_SEND_RELATIVE_ADDR, 1) | CMD_BIT_LS
 #define CMD_SEND_CSD        CMD(MMC_SEND_CSD, 2) | CMD_BIT_LS
+#define CMD_SEND_CID        CMD(MMC_SEND_CID, 2) | CMD_BIT_LS
 #define CMD_SEND_EXT_CSD    CMD(MMC_SEND_EXT_CSD, 1) | CMD_BIT_LS | CMD_BIT_DATA
+#define CMD_MMC_SWITCH      CMD(MMC_SWITCH, 1)
+#define CMD_SD_SWITCH       CMD(SD_SWITCH, 1) | CMD_BIT_DATA
+#define CMD_APP_CMD         CMD(MMC_APP_CMD, 1)
+#define CMD_SD_SEND_SCR     CMD(SD_APP_SEND_SCR, 1) | CMD_BIT_DATA	/* after CMD_APP_CMD */
+#define CMD_SD_SET_ERASE_COUNT CMD(SD_APP_SET_ERASE_COUNT, 1) | CMD_BIT_APP
+#define CMD_SET_BLOCK_COUNT CMD(MMC_SET_BLOCK_COUNT, 1)
 #define CMD_DESELECT_CARD   CMD(MMC_SELECT_CARD, 0)
 #define CMD_SELECT_CARD     CMD(MMC_SELECT_CARD, 1)
 #define CMD_SET_BLOCKLEN    CMD(MMC_SET_BLOCKLEN, 1)
@@ -326,6 +413,10 @@ typedef enum CHIP_SDMMC_STATE {
 #define CARD_TYPE_SD    (1 << 0)
 #define CARD_TYPE_4BIT  (1 << 1)
 #define CARD_TYPE_8BIT  (1 << 2)
+#define CARD_TYPE_HS    (1 << 3)	/*!< high speed timing (SD 50MHz, MMC 26/52MHz) */
+#define CARD_TYPE_DDR   (1 << 4)	/*!< MMC dual data rate */
+#define CARD_TYPE_CMD23 (1 << 5)	/*!< multiple block transfers announced with SET_BLOCK_COUNT */
+#define CARD_TYPE_CACHE (1 << 6)	/*!< MMC volatile cache on, see Chip_SDMMC_FlushCache() */
 #define CARD_TYPE_HC    (OCR_HC_CCS)/*!< high capacity card > 2GB */
 
 #define MMC_SECTOR_SIZE 512
@@ -336,12 +427,81 @@ typedef enum CHIP_SDMMC_STATE {
 #define MS_ACQUIRE_DELAY      (10)			/*!< inter-command acquire oper condition delay in msec*/
 #define INIT_OP_RETRIES       50			/*!< initial OP_COND retries */
 #define SET_OP_RETRIES        1000			/*!< set OP_COND retries */
-#define SDIO_BUS_WIDTH        4				/*!< Max bus width supported */
+#define SWITCH_RETRIES        100			/*!< 1 msec status polls while a card switches mode */
+#ifndef SDIO_BUS_WIDTH
+#define SDIO_BUS_WIDTH        4				/*!< Max bus width supported (1, 4, or 8 for eMMC with DAT4-7 wired) */
+#endif
+#ifndef SDIO_DDR_MODE
+#define SDIO_DDR_MODE         0				/*!< Try MMC DDR52 (needs SD delay settings tuned for the board) */
+#endif
+#ifndef SDIO_MMC_CACHE
+#define SDIO_MMC_CACHE        1				/*!< Turn on the cache of MMC 4.5 cards (writes may be lost on power
+												 loss until Chip_SDMMC_FlushCache()) */
+#endif
+#ifndef SDIO_STATS
+#define SDIO_STATS            1				/*!< Keep command statistics (see Chip_SDMMC_GetStats()) */
+#endif
 #define SD_MMC_ENUM_CLOCK       400000		/*!< Typical enumeration clock rate */
 #define MMC_MAX_CLOCK           20000000	/*!< Max MMC clock rate */
 #define MMC_LOW_BUS_MAX_CLOCK   26000000	/*!< Type 0 MMC card max clock rate */
 #define MMC_HIGH_BUS_MAX_CLOCK  52000000	/*!< Type 1 MMC card max clock rate */
 #define SD_MAX_CLOCK            25000000	/*!< Max SD clock rate */
+#define SD_HS_MAX_CLOCK         50000000	/*!< Max SD clock rate in high speed mode */
+#define MS_PROGRAM_TIMEOUT      250			/*!< max msec a card may stay busy programming a write */
+#define PRG_BUSY_SPINS          2000		/*!< busy flag polls before the wait sleeps in 1 msec steps */
+#define MS_CACHE_FLUSH_TIMEOUT  2000		/*!< max msec an MMC card may take to flush its cache */
+#define PACKED_WRITE_MAX        8			/*!< Most writes sent in one packed write command */
+
+/** @brief States of a transfer started with Chip_SDMMC_StartReadBlocks/StartWriteBlocks
+ */
+#define MCI_XFER_IDLE           0			/*!< No transfer in flight */
+#define MCI_XFER_READ           1			/*!< Read data phase */
+#define MCI_XFER_WRITE          2			/*!< Write data phase */
+
+/** @brief Command classes of the statistics
+ */
+#define MCI_STAT_READ_SINGLE    0			/*!< CMD17 */
+#define MCI_STAT_READ_MULTIPLE  1			/*!< CMD18 */
+#define MCI_STAT_WRITE_SINGLE   2			/*!< CMD24 */
+#define MCI_STAT_WRITE_MULTIPLE 3			/*!< CMD25 */
+#define MCI_STAT_STATUS         4			/*!< CMD13 */
+#define MCI_STAT_ERASE          5			/*!< Erase commands and the ACMD23 pre-erase */
+#define MCI_STAT_OTHER          6			/*!< All other commands */
+#define MCI_STAT_CLASSES        7
+#define MCI_STAT_BINS           16			/*!< Latency histogram bins */
+#define MCI_STAT_BIN0_US        16			/*!< Latency below which the first bin counts, in usec, doubled by each bin */
+
+/* Statistics of a command class */
+typedef struct {
+	uint32_t count;								/*!< Commands sent */
+	uint32_t bytes;								/*!< Data moved by the commands that succeeded */
+	uint32_t errors;							/*!< Commands that ended with an error */
+	uint32_t crc_errors;						/*!< Errors with a response or data CRC error */
+	uint32_t timeouts;							/*!< Errors with a response or data timeout */
+	uint32_t retries;							/*!< Commands sent again because the card was not ready */
+	uint32_t time_us;							/*!< Total latency, from the command to the end of its data */
+	uint32_t max_us;							/*!< Longest latency */
+	uint32_t hist[MCI_STAT_BINS];				/*!< Latencies below MCI_STAT_BIN0_US << bin usec, the last
+													 bin counts the longer ones */
+} MCI_CMD_STAT_T;
+
+/* Statistics of the SD/MMC commands since Chip_SDMMC_Init() or Chip_SDMMC_ResetStats() */
+typedef struct {
+	MCI_CMD_STAT_T cmd[MCI_STAT_CLASSES];		/*!< Indexed with MCI_STAT_* */
+	uint32_t busy_waits;						/*!< Commands held while the card programmed a write */
+	uint32_t busy_us;							/*!< Time they waited */
+	uint32_t busy_max_us;						/*!< Longest wait */
+	uint32_t bus_clock;							/*!< Card clock now (Hz) */
+	uint32_t card_type;							/*!< CARD_TYPE_* of the card */
+	uint32_t cid[4];							/*!< CID of the card */
+} MCI_STATS_T;
+
+/* One write of Chip_SDMMC_WriteBlocksPacked() */
+typedef struct {
+	void *buffer;								/*!< Data, word aligned */
+	int32_t start_block;
+	int32_t num_blocks;
+} MCI_PACKED_WRITE_T;
 
 /* Function prototype for event setup function */
 typedef void (*MCI_EVSETUP_FUNC_T)(uint32_t);
@@ -352,11 +512,19 @@ typedef uint32_t (*MCI_WAIT_CB_FUNC_T)(void);
 /* Function prototype for milliSecond delay function */
 typedef void (*MCI_MSDELAY_FUNC_T)(uint32_t);
 
-/* Card specific setup data */
+/* Function prototype for the completion of a started transfer, status is 0 or the MCI_INT_* errors */
+typedef void (*MCI_XFER_DONE_FUNC_T)(void *arg, uint32_t status);
+
+/* Function prototype routing the bus to one card, e.g. the GPIO of a bus switch between two slots */
+typedef void (*MCI_BUS_SELECT_FUNC_T)(void);
+
+/* Card specific setup data, the handle of a card: filled by Chip_SDMMC_Acquire(), the calls that
+   follow run on it until Chip_SDMMC_SelectCard() picks another one */
 typedef struct _mci_card_struct {
 	uint32_t response[4];						/*!< Most recent response */
 	uint32_t cid[4];							/*!< CID of acquired card  */
 	uint32_t csd[4];							/*!< CSD of acquired card */
+	uint32_t scr[2];							/*!< SCR of acquired SD card, as sent (MSB first) */
 	uint32_t ext_csd[512 / 4];
 	uint32_t card_type;
 	uint32_t rca;								/*!< Relative address assigned to card */
@@ -365,10 +533,25 @@ typedef struct _mci_card_struct {
 	uint32_t device_size;
 	uint32_t blocknr;
 	uint32_t clk_rate;
+	uint32_t card_check;						/*!< Check value of the fields above from cid on, set
+													 once the card is acquired */
 	sdif_device sdif_dev;
 	MCI_EVSETUP_FUNC_T evsetup_cb;
 	MCI_WAIT_CB_FUNC_T waitfunc_cb;
 	MCI_MSDELAY_FUNC_T msdelay_func;
+	MCI_BUS_SELECT_FUNC_T bus_select_cb;		/*!< Routes the bus to the card, NULL for a card alone on
+													 the bus */
+	uint32_t pre_erase_min;						/*!< SD writes of this many blocks or more are pre-erased
+													 with ACMD23 (large sequential writes), 0 for none */
+	MCI_XFER_DONE_FUNC_T xfer_done_cb;			/*!< Completion of the transfer in flight */
+	void *xfer_arg;
+	uint32_t xfer_state;						/*!< MCI_XFER_* */
+	uint32_t xfer_wait;							/*!< MCI_INT_* still expected in the data phase */
+	uint32_t busy_pending;						/*!< The last transfer may still keep the card (programming
+													 a write) or the CIU (auto-stop) busy */
+	uint32_t tran_state;						/*!< Card known to be in trans state, a transfer does
+													 not ask for its state first */
+	uint32_t part;								/*!< MMC_PART_* accessed by the transfers */
 } mci_card_struct;
 
 /**
@@ -447,14 +630,73 @@ uint32_t Chip_SDMMC_GetIntStatus(LPC_SDMMC_T *pSDMMC);
  */
 int32_t Chip_SDMMC_GetState(LPC_SDMMC_T *pSDMMC);
 
+/**
+ * @brief	Tells whether the card is still busy with the last transfer
+ * @param	pSDMMC	: SDMMC peripheral selected
+ * @return	!0 while a started transfer is in flight or the card programs written blocks
+ * Reads the DAT0 busy status of the controller, no command is sent to the card.
+ */
+int32_t Chip_SDMMC_CardBusy(LPC_SDMMC_T *pSDMMC);
+
+/**
+ * @brief	Gets the command statistics
+ * @param	pSDMMC	: SDMMC peripheral selected
+ * @param	stats	: Filled with the statistics and the card they were taken on
+ * @return	Nothing
+ * The latencies are timed with the DWT cycle counter, started by Chip_SDMMC_Init(). The counters
+ * stay at 0 with SDIO_STATS set to 0.
+ */
+void Chip_SDMMC_GetStats(LPC_SDMMC_T *pSDMMC, MCI_STATS_T *stats);
+
+/**
+ * @brief	Clears the command statistics
+ * @param	pSDMMC	: SDMMC peripheral selected
+ * @return	Nothing
+ */
+void Chip_SDMMC_ResetStats(LPC_SDMMC_T *pSDMMC);
+
 /**
  * @brief	Function to enumerate the SD/MMC/SDHC/MMC+ cards
  * @param	pSDMMC		: SDMMC peripheral selected
  * @param	pcardinfo	: Pointer to pre-allocated card info structure
  * @return	1 if a card is acquired, otherwise 0
+ * The bus is then set to the fastest mode both sides support: SD cards with the switch function run
+ * at 50MHz in high speed, MMC cards at the widest bus up to SDIO_BUS_WIDTH and 26 or 52MHz high speed
+ * (DDR52 with SDIO_DDR_MODE). Each mode is checked with a data transfer and dropped if it fails,
+ * card_type tells the mode kept (CARD_TYPE_4BIT/8BIT/HS/DDR), and CARD_TYPE_CMD23 whether multiple
+ * block transfers are announced with SET_BLOCK_COUNT (SD cards telling it in their SCR, MMC 4.x).
  */
 uint32_t Chip_SDMMC_Acquire(LPC_SDMMC_T *pSDMMC, mci_card_struct *pcardinfo);
 
+/**
+ * @brief	Makes an acquired card the card of the calls that follow
+ * @param	pSDMMC		: SDMMC peripheral selected
+ * @param	pcardinfo	: Card info filled by Chip_SDMMC_Acquire()
+ * @return	0 on success, -1 while a started transfer is in flight
+ * The bus is routed to the card with its bus_select_cb and the host is set to its bus mode. A card
+ * left while programming a write keeps programming, the next transfer on it waits for the end.
+ */
+int32_t Chip_SDMMC_SelectCard(LPC_SDMMC_T *pSDMMC, mci_card_struct *pcardinfo);
+
+/**
+ * @brief	Get the card the calls run on
+ * @param	pSDMMC	: SDMMC peripheral selected
+ * @return	Card info of the last Chip_SDMMC_Acquire() or Chip_SDMMC_SelectCard()
+ */
+mci_card_struct *Chip_SDMMC_GetCard(LPC_SDMMC_T *pSDMMC);
+
+/**
+ * @brief	Takes back the card of an earlier Chip_SDMMC_Acquire() without enumerating it again
+ * @param	pSDMMC		: SDMMC peripheral selected
+ * @param	pcardinfo	: Card info filled by Chip_SDMMC_Acquire(), e.g. kept in RAM over a warm reset
+ * @return	1 if the same card is still there and ready, otherwise 0 (acquire it then)
+ * A card that kept its power is still addressed and in its bus mode. It is found at its address,
+ * its CID is compared with the acquired one and a data transfer checks the bus mode. A card info
+ * holding random data (cold boot) or a power cycled or replaced card is refused within a few
+ * commands. The callbacks of pcardinfo must be set.
+ */
+uint32_t Chip_SDMMC_Reacquire(LPC_SDMMC_T *pSDMMC, mci_card_struct *pcardinfo);
+
 /**
  * @brief	Get the device size of SD/MMC card (after enumeration)
  * @param	pSDMMC	: SDMMC peripheral selected
@@ -472,6 +714,39 @@ int32_t Chip_SDMMC_GetDeviceSize(LPC_SDMMC_T *pSDMMC);
  */
 int32_t Chip_SDMMC_GetDeviceBlocks(LPC_SDMMC_T *pSDMMC);
 
+/**
+ * @brief	Get the number of blocks in a partition of an MMC card
+ * @param	pSDMMC	: SDMMC peripheral selected
+ * @param	part	: MMC_PART_*
+ * @return	Number of 512 bytes blocks, 0 for a partition the card does not have and for the RPMB
+ * @note	The user area (MMC_PART_USER) is the whole card on SD cards and MMC cards before 4.x.
+ */
+int32_t Chip_SDMMC_GetPartBlocks(LPC_SDMMC_T *pSDMMC, uint32_t part);
+
+/**
+ * @brief	Selects the partition of an MMC card accessed by the transfers
+ * @param	pSDMMC	: SDMMC peripheral selected
+ * @param	part	: MMC_PART_*
+ * @return	0 on success, -1 for a partition the card does not have or a failed switch
+ * @note	The boot configuration kept in PART_CONFIG is left as it is. The card is on the user area
+ * after Chip_SDMMC_Acquire().
+ */
+int32_t Chip_SDMMC_SetPartition(LPC_SDMMC_T *pSDMMC, uint32_t part);
+
+/**
+ * @brief	Get the type of the acquired card
+ * @param	pSDMMC	: SDMMC peripheral selected
+ * @return	CARD_TYPE_* flags
+ */
+uint32_t Chip_SDMMC_GetCardType(LPC_SDMMC_T *pSDMMC);
+
+/**
+ * @brief	Writes the cache of an MMC card to the flash
+ * @param	pSDMMC	: SDMMC peripheral selected
+ * @return	0 on success, at once for a card without cache (CARD_TYPE_CACHE clear), -1 on error
+ */
+int32_t Chip_SDMMC_FlushCache(LPC_SDMMC_T *pSDMMC);
+
 /**
  * @brief	Performs the read of data from the SD/MMC card
  * @param	pSDMMC		: SDMMC peripheral selected
@@ -492,6 +767,120 @@ int32_t Chip_SDMMC_ReadBlocks(LPC_SDMMC_T *pSDMMC, void *buffer, int32_t start_b
  */
 int32_t Chip_SDMMC_WriteBlocks(LPC_SDMMC_T *pSDMMC, void *buffer, int32_t start_block, int32_t num_blocks);
 
+/**
+ * @brief	Performs the read of data from the SD/MMC card to a list of buffers, in one command
+ * @param	pSDMMC		: SDMMC peripheral selected
+ * @param	sg			: Buffers filled in order, word aligned, sizes adding up to whole blocks
+ * @param	count		: Number of buffers
+ * @param	start_block	: Start block number
+ * @return	Bytes read, or 0 on error (also when the list needs more than SDIF_DMA_DESC_COUNT descriptors)
+ */
+int32_t Chip_SDMMC_ReadBlocksSG(LPC_SDMMC_T *pSDMMC, const IP_SDMMC_SG_T *sg, uint32_t count, int32_t start_block);
+
+/**
+ * @brief	Performs write of data from a list of buffers to the SD/MMC card, in one command
+ * @param	pSDMMC		: SDMMC peripheral selected
+ * @param	sg			: Buffers written in order, word aligned, sizes adding up to whole blocks
+ * @param	count		: Number of buffers
+ * @param	start_block	: Start block number
+ * @return	Number of bytes actually written, or 0 on error
+ */
+int32_t Chip_SDMMC_WriteBlocksSG(LPC_SDMMC_T *pSDMMC, const IP_SDMMC_SG_T *sg, uint32_t count, int32_t start_block);
+
+/**
+ * @brief	Performs writes to several places of the SD/MMC card
+ * @param	pSDMMC		: SDMMC peripheral selected
+ * @param	writes		: Writes done, in order
+ * @param	count		: Number of writes
+ * @return	Number of bytes actually written, or 0 on error
+ * MMC 4.5 cards get up to PACKED_WRITE_MAX writes (or their own limit) in one packed write command,
+ * which saves the command and programming overhead of each short write. Other cards, and the writes
+ * of a packed command that fails, are written one by one.
+ * This is for applications that gather short scattered writes themselves (logs, records). The FatFs
+ * glue (fs_mci.c) does not use it: each disk_write() of FatFs is one run of blocks.
+ */
+int32_t Chip_SDMMC_WriteBlocksPacked(LPC_SDMMC_T *pSDMMC, const MCI_PACKED_WRITE_T *writes, uint32_t count);
+
+/**
+ * @brief	Starts a read of data from the SD/MMC card and returns at once
+ * @param	pSDMMC		: SDMMC peripheral selected
+ * @param	buffer		: Pointer to data buffer to copy to, untouched until the completion
+ * @param	start_block	: Start block number
+ * @param	num_blocks	: Number of block to read
+ * @param	done_cb		: Completion, called from Chip_SDMMC_IRQHandler()
+ * @param	arg			: Passed to done_cb
+ * @return	Bytes to be read, or 0 when the transfer could not be started (done_cb is not called)
+ * The card runs the transfer from the SDIO interrupt. Meanwhile the other SDMMC functions fail
+ * (Chip_SDMMC_GetState() returns -1), see Chip_SDMMC_XferPending().
+ */
+int32_t Chip_SDMMC_StartReadBlocks(LPC_SDMMC_T *pSDMMC, void *buffer, int32_t start_block, int32_t num_blocks,
+								   MCI_XFER_DONE_FUNC_T done_cb, void *arg);
+
+/**
+ * @brief	Starts a write of data to the SD/MMC card and returns at once
+ * @param	pSDMMC		: SDMMC peripheral selected
+ * @param	buffer		: Pointer to data buffer to copy from, untouched until the completion
+ * @param	start_block	: Start block number
+ * @param	num_blocks	: Number of block to write
+ * @param	done_cb		: Completion, called from Chip_SDMMC_IRQHandler()
+ * @param	arg			: Passed to done_cb
+ * @return	Bytes to be written, or 0 when the transfer could not be started (done_cb is not called)
+ * The completion comes once the blocks are in the card. The card programs them after that,
+ * the next command waits for the end (see Chip_SDMMC_CardBusy()).
+ */
+int32_t Chip_SDMMC_StartWriteBlocks(LPC_SDMMC_T *pSDMMC, void *buffer, int32_t start_block, int32_t num_blocks,
+									MCI_XFER_DONE_FUNC_T done_cb, void *arg);
+
+/**
+ * @brief	Starts a read of data from the SD/MMC card to a list of buffers and returns at once
+ * @param	pSDMMC		: SDMMC peripheral selected
+ * @param	sg			: Buffers filled in order, the list itself may be reused once this returns
+ * @param	count		: Number of buffers
+ * @param	start_block	: Start block number
+ * @param	done_cb		: Completion, called from Chip_SDMMC_IRQHandler()
+ * @param	arg			: Passed to done_cb
+ * @return	Bytes to be read, or 0 when the transfer could not be started (done_cb is not called)
+ */
+int32_t Chip_SDMMC_StartReadBlocksSG(LPC_SDMMC_T *pSDMMC, const IP_SDMMC_SG_T *sg, uint32_t count, int32_t start_block,
+									 MCI_XFER_DONE_FUNC_T done_cb, void *arg);
+
+/**
+ * @brief	Starts a write of data from a list of buffers to the SD/MMC card and returns at once
+ * @param	pSDMMC		: SDMMC peripheral selected
+ * @param	sg			: Buffers written in order, the list itself may be reused once this returns
+ * @param	count		: Number of buffers
+ * @param	start_block	: Start block number
+ * @param	done_cb		: Completion, called from Chip_SDMMC_IRQHandler()
+ * @param	arg			: Passed to done_cb
+ * @return	Bytes to be written, or 0 when the transfer could not be started (done_cb is not called)
+ */
+int32_t Chip_SDMMC_StartWriteBlocksSG(LPC_SDMMC_T *pSDMMC, const IP_SDMMC_SG_T *sg, uint32_t count, int32_t start_block,
+									  MCI_XFER_DONE_FUNC_T done_cb, void *arg);
+
+/**
+ * @brief	Tells whether a started transfer is in flight
+ * @param	pSDMMC	: SDMMC peripheral selected
+ * @return	!0 until the completion of the transfer has been called
+ */
+int32_t Chip_SDMMC_XferPending(LPC_SDMMC_T *pSDMMC);
+
+/**
+ * @brief	Ends a started transfer that did not complete in time, e.g. when its interrupt was lost
+ * @param	pSDMMC	: SDMMC peripheral selected
+ * @return	None
+ * The completion is called with MCI_INT_DTO. The DMA stops at once, the card is stopped by the next
+ * command. Nothing is done when no transfer is pending.
+ */
+void Chip_SDMMC_AbortXfer(LPC_SDMMC_T *pSDMMC);
+
+/**
+ * @brief	Runs a started transfer, to be called from the SDIO interrupt while one is pending
+ * @param	pSDMMC	: SDMMC peripheral selected
+ * @return	None
+ * The next step is armed through the card's evsetup_cb, the completion is called from here.
+ */
+void Chip_SDMMC_IRQHandler(LPC_SDMMC_T *pSDMMC);
+
 /**
  * @}
  */
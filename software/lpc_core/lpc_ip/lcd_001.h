@@ -234,7 +234,7 @@ STATIC INLINE void IP_LCD_Disable(IP_LCD_001_T *pLCD) {
  */
 STATIC INLINE void IP_LCD_SetUPFrameBuffer(IP_LCD_001_T *pLCD, void *buffer)
 {
-	pLCD->UPBASE = (uint32_t) buffer;
+	pLCD->UPBASE = (uint32_t) (uintptr_t) buffer;
 }
 
 /**
@@ -245,7 +245,7 @@ STATIC INLINE void IP_LCD_SetUPFrameBuffer(IP_LCD_001_T *pLCD, void *buffer)
  */
 STATIC INLINE void IP_LCD_SetLPFrameBuffer(IP_LCD_001_T *pLCD, void *buffer)
 {
-	pLCD->LPBASE = (uint32_t) buffer;
+	pLCD->LPBASE = (uint32_t) (uintptr_t) buffer;
 }
 
 /**
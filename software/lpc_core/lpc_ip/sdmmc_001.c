@@ -62,7 +62,7 @@ void IP_SDMMC_Init(IP_SDMMC_001_T *pSDMMC)
 	pSDMMC->INTMASK = 0;
 
 	/* Clear the interrupts for the host controller */
-	pSDMMC->RINTSTS = 0xFFFFFFFF;
+	MCI_CLEAR_STATUS(pSDMMC->RINTSTS, 0xFFFFFFFF);
 
 	/* Put in max timeout */
 	pSDMMC->TMOUT = 0xFFFFFFFF;
@@ -150,11 +150,19 @@ int32_t IP_SDMMC_SendCmd(IP_SDMMC_001_T *pSDMMC, uint32_t cmd, uint32_t arg)
 		}
 
 		while (--delay > 1) {}
+		MCI_POLL_YIELD();
 	}
 
 	return (tmo < 1) ? 1 : 0;
 }
 
+/* Post a command to the CIU without waiting for it to be taken */
+void IP_SDMMC_StartCmd(IP_SDMMC_001_T *pSDMMC, uint32_t cmd, uint32_t arg)
+{
+	pSDMMC->CMDARG = arg;
+	pSDMMC->CMD = MCI_CMD_START | cmd;
+}
+
 /* Read the response from the last command */
 void IP_SDMMC_GetResponse(IP_SDMMC_001_T *pSDMMC, uint32_t *resp)
 {
@@ -215,7 +223,7 @@ void IP_SDMMC_SetClearIntFifo(IP_SDMMC_001_T *pSDMMC)
 	while (pSDMMC->CTRL & MCI_CTRL_FIFO_RESET) {}
 
 	/* Clear interrupt status */
-	pSDMMC->RINTSTS = 0xFFFFFFFF;
+	MCI_CLEAR_STATUS(pSDMMC->RINTSTS, 0xFFFFFFFF);
 }
 
 /* Returns the raw SD interface interrupt status */
@@ -227,7 +235,7 @@ uint32_t IP_SDMMC_GetRawIntStatus(IP_SDMMC_001_T *pSDMMC)
 /* Sets the raw SD interface interrupt status */
 void IP_SDMMC_SetRawIntStatus(IP_SDMMC_001_T *pSDMMC, uint32_t iVal)
 {
-	pSDMMC->RINTSTS = iVal;
+	MCI_CLEAR_STATUS(pSDMMC->RINTSTS, iVal);
 }
 
 /* Sets the SD interface interrupt mask */
@@ -239,51 +247,83 @@ void IP_SDMMC_SetIntMask(IP_SDMMC_001_T *pSDMMC, uint32_t iVal)
 /* Setup DMA descriptors */
 void IP_SDMMC_DmaSetup(IP_SDMMC_001_T *pSDMMC, sdif_device *psdif_dev, uint32_t addr, uint32_t size)
 {
-	int i = 0;
-	uint32_t ctrl, maxs;
+	IP_SDMMC_SG_T sg;
 
-	/* Reset DMA */
-	pSDMMC->CTRL |= MCI_CTRL_DMA_RESET | MCI_CTRL_FIFO_RESET;
-	while (pSDMMC->CTRL & MCI_CTRL_DMA_RESET) {}
-
-	/* Build a descriptor list using the chained DMA method */
-	while (size > 0) {
-		/* Limit size of the transfer to maximum buffer size */
-		maxs = size;
-		if (maxs > MCI_DMADES1_MAXTR) {
-			maxs = MCI_DMADES1_MAXTR;
-		}
-		size -= maxs;
-
-		/* Set buffer size */
-		psdif_dev->mci_dma_dd[i].des1 = MCI_DMADES1_BS1(maxs);
-
-		/* Setup buffer address (chained) */
-		psdif_dev->mci_dma_dd[i].des2 = addr + (i * MCI_DMADES1_MAXTR);
+	sg.addr = addr;
+	sg.size = size;
+	IP_SDMMC_DmaSetupSG(pSDMMC, psdif_dev, &sg, 1);
+}
 
-		/* Setup basic control */
-		ctrl = MCI_DMADES0_OWN | MCI_DMADES0_CH;
-		if (i == 0) {
-			ctrl |= MCI_DMADES0_FS;	/* First DMA buffer */
+/* Setup DMA descriptors for a list of buffers */
+uint32_t IP_SDMMC_DmaSetupSG(IP_SDMMC_001_T *pSDMMC, sdif_device *psdif_dev, const IP_SDMMC_SG_T *sg, uint32_t count)
+{
+	uint32_t i = 0, n, total = 0, left;
+	uint32_t ctrl, maxs, addr, size;
 
+	/* Check the list fits the descriptors before touching the DMA */
+	for (n = 0; n < count; n++) {
+		if ((sg[n].addr & 3) || (sg[n].size & 3)) {
+			return 0;
 		}
-		/* No more data? Then this is the last descriptor */
-		if (!size) {
-			ctrl |= MCI_DMADES0_LD;
-		}
-		else {
-			ctrl |= MCI_DMADES0_DIC;
-		}
+		i += (sg[n].size + MCI_DMADES1_MAXTR - 1) / MCI_DMADES1_MAXTR;
+		total += sg[n].size;
+	}
+	if ((i == 0) || (i > SDIF_DMA_DESC_COUNT)) {
+		return 0;
+	}
 
-		/* Another descriptor is needed */
-		psdif_dev->mci_dma_dd[i].des3 = (uint32_t) &psdif_dev->mci_dma_dd[i + 1];
-		psdif_dev->mci_dma_dd[i].des0 = ctrl;
+	/* Reset DMA */
+	pSDMMC->CTRL |= MCI_CTRL_DMA_RESET | MCI_CTRL_FIFO_RESET;
+	while (pSDMMC->CTRL & MCI_CTRL_DMA_RESET) {}
 
-		i++;
+	/* Build a descriptor list using the chained DMA method, the buffers one after the other */
+	i = 0;
+	left = total;
+	for (n = 0; n < count; n++) {
+		addr = sg[n].addr;
+		size = sg[n].size;
+		while (size > 0) {
+			/* Limit size of the transfer to maximum buffer size */
+			maxs = size;
+			if (maxs > MCI_DMADES1_MAXTR) {
+				maxs = MCI_DMADES1_MAXTR;
+			}
+			size -= maxs;
+			left -= maxs;
+
+			/* Set buffer size */
+			psdif_dev->mci_dma_dd[i].des1 = MCI_DMADES1_BS1(maxs);
+
+			/* Setup buffer address (chained) */
+			psdif_dev->mci_dma_dd[i].des2 = addr;
+			addr += maxs;
+
+			/* Setup basic control */
+			ctrl = MCI_DMADES0_OWN | MCI_DMADES0_CH;
+			if (i == 0) {
+				ctrl |= MCI_DMADES0_FS;	/* First DMA buffer */
+
+			}
+			/* No more data? Then this is the last descriptor */
+			if (!left) {
+				ctrl |= MCI_DMADES0_LD;
+			}
+			else {
+				ctrl |= MCI_DMADES0_DIC;
+			}
+
+			/* Another descriptor is needed */
+			psdif_dev->mci_dma_dd[i].des3 = MCI_BUS_ADDR(&psdif_dev->mci_dma_dd[i + 1]);
+			psdif_dev->mci_dma_dd[i].des0 = ctrl;
+
+			i++;
+		}
 	}
 
 	/* Set DMA derscriptor base address */
-	pSDMMC->DBADDR = (uint32_t) &psdif_dev->mci_dma_dd[0];
+	pSDMMC->DBADDR = MCI_BUS_ADDR(&psdif_dev->mci_dma_dd[0]);
+
+	return total;
 }
 
 /**
@@ -153,6 +153,10 @@ typedef struct {				/*!< SDMMC Structure        */
 #define MCI_CTYPE_8BIT          (1 << 16)		/*!< Enable 4-bit mode */
 #define MCI_CTYPE_4BIT          (1 << 0)		/*!< Enable 8-bit mode */
 
+/** @brief SDIO UHS-1 register defines
+ */
+#define MCI_UHS_DDR             (1 << 16)		/*!< Double data rate on the data lines */
+
 /** @brief SDIO Interrupt status & mask register defines
  */
 #define MCI_INT_SDIO            (1 << 16)		/*!< SDIO interrupt */
@@ -199,6 +203,9 @@ typedef struct {				/*!< SDMMC Structure        */
 /** @brief SDIO status register definess
  */
 #define MCI_STS_GET_FCNT(x)     (((x) >> 17) & 0x1FF)
+#define MCI_STS_DATA_SM_BUSY    (1 << 10)		/*!< Data transmit or receive state machine busy */
+#define MCI_STS_DATA_BUSY       (1 << 9)		/*!< Card holds DAT0 low (busy programming) */
+#define MCI_STS_CMD_FSM(x)      (((x) >> 4) & 0xF)	/*!< Command state machine, 0 when idle */
 
 /** @brief SDIO FIFO threshold defines
  */
@@ -232,6 +239,32 @@ typedef struct {				/*!< SDMMC Structure        */
  */
 #define SD_FIFO_SZ              32				/*!< Size of SDIO FIFOs (32-bit wide) */
 
+/** @brief Write to a write-1-to-clear status register, address of a buffer or descriptor as the
+ * DMA sees it, and a pause in a counted polling loop. A host build of the driver on the software
+ * model of the block (lpc_sim/sdmmc_sim.h) passes the status writes to the model, which could not
+ * tell them from its own updates in plain memory, has the model map its pointers, which may be 64
+ * bits wide, and gives the model thread the CPU while it polls, so that a loaded or single-core host
+ * does not run out the count before the model has looked at the registers.
+ */
+#ifdef SDMMC_SIM
+void SdmmcSim_Clear(volatile uint32_t *reg, uint32_t bits);
+uint32_t SdmmcSim_BusAddr(const volatile void *ptr);
+void SdmmcSim_Yield(void);
+#define MCI_CLEAR_STATUS(reg, bits) SdmmcSim_Clear(&(reg), (bits))
+#define MCI_BUS_ADDR(ptr)           SdmmcSim_BusAddr(ptr)
+#define MCI_POLL_YIELD()            SdmmcSim_Yield()
+#else
+#define MCI_CLEAR_STATUS(reg, bits) ((reg) = (bits))
+#define MCI_BUS_ADDR(ptr)           ((uint32_t) (ptr))
+#define MCI_POLL_YIELD()
+#endif
+
+/** @brief Number of chained DMA descriptors, one per MCI_DMADES1_MAXTR bytes of each buffer of a transfer
+ */
+#ifndef SDIF_DMA_DESC_COUNT
+#define SDIF_DMA_DESC_COUNT     (1 + (0x10000 / MCI_DMADES1_MAXTR))
+#endif
+
 /** Function prototype for SD interface IRQ callback */
 typedef uint32_t (*MCI_IRQ_CB_FUNC_T)(uint32_t);
 
@@ -250,11 +283,18 @@ typedef struct {
 	volatile uint32_t des3;						/*!< Buffer address pointer 2 */
 } pSDMMC_DMA_T;
 
+/** @brief  One buffer of a scatter-gather transfer, address and size word aligned
+ */
+typedef struct {
+	uint32_t addr;								/*!< Buffer address, MCI_BUS_ADDR() of the buffer */
+	uint32_t size;								/*!< Buffer size in bytes */
+} IP_SDMMC_SG_T;
+
 /** @brief  SDIO device type
  */
 typedef struct _sdif_device {
 	// MCI_IRQ_CB_FUNC_T irq_cb;
-	pSDMMC_DMA_T mci_dma_dd[1 + (0x10000 / MCI_DMADES1_MAXTR)];
+	pSDMMC_DMA_T mci_dma_dd[SDIF_DMA_DESC_COUNT];
 	// uint32_t sdio_clk_rate;
 	// uint32_t sdif_slot_clk_rate;
 	// int32_t clock_enabled;
@@ -329,6 +369,38 @@ int32_t IP_SDMMC_CardNDetect(IP_SDMMC_001_T *pSDMMC);
  */
 int32_t IP_SDMMC_SendCmd(IP_SDMMC_001_T *pSDMMC, uint32_t cmd, uint32_t arg);
 
+/**
+ * @brief	Post a command to the Card interface unit (CIU) without waiting for it to be taken
+ * @param	pSDMMC	: Pointer to IP_SDMMC_001_T structure
+ * @param	cmd		: Command with all flags set
+ * @param	arg		: Argument for the command
+ * @return	None
+ * The CIU must be idle, a command posted while it is busy raises MCI_INT_HLE.
+ */
+void IP_SDMMC_StartCmd(IP_SDMMC_001_T *pSDMMC, uint32_t cmd, uint32_t arg);
+
+/**
+ * @brief	Tells whether the card holds DAT0 low, as it does while it programs written blocks
+ * @param	pSDMMC	: Pointer to IP_SDMMC_001_T structure
+ * @return	!0 while the card is busy
+ */
+STATIC INLINE int32_t IP_SDMMC_CardBusy(IP_SDMMC_001_T *pSDMMC)
+{
+	return (pSDMMC->STATUS & MCI_STS_DATA_BUSY) != 0;
+}
+
+/**
+ * @brief	Tells whether the CIU still runs a command or a data transfer (e.g. an auto-stop)
+ * @param	pSDMMC	: Pointer to IP_SDMMC_001_T structure
+ * @return	!0 while the CIU is busy
+ */
+STATIC INLINE int32_t IP_SDMMC_CiuBusy(IP_SDMMC_001_T *pSDMMC)
+{
+	uint32_t status = pSDMMC->STATUS;
+
+	return (status & MCI_STS_DATA_SM_BUSY) || MCI_STS_CMD_FSM(status);
+}
+
 /**
  * @brief	Read the response from the last command
  * @param	pSDMMC	: Pointer to IP_SDMMC_001_T structure
@@ -389,11 +461,22 @@ void IP_SDMMC_SetIntMask(IP_SDMMC_001_T *pSDMMC, uint32_t iVal);
  * @param	pSDMMC		: Pointer to IP_SDMMC_001_T structure
  * @param	psdif_dev	: SD interface device
  * @param	addr		: Address of buffer (source or destination)
- * @param	size		: size of buffer in bytes (64K max)
+ * @param	size		: size of buffer in bytes (SDIF_DMA_DESC_COUNT * MCI_DMADES1_MAXTR max)
  * @return	None
  */
 void IP_SDMMC_DmaSetup(IP_SDMMC_001_T *pSDMMC, sdif_device *psdif_dev, uint32_t addr, uint32_t size);
 
+/**
+ * @brief	Setup DMA descriptors for a list of buffers moved as one transfer
+ * @param	pSDMMC		: Pointer to IP_SDMMC_001_T structure
+ * @param	psdif_dev	: SD interface device
+ * @param	sg			: Buffers in transfer order
+ * @param	count		: Number of buffers
+ * @return	Total size in bytes, or 0 when a buffer is not word aligned or SDIF_DMA_DESC_COUNT
+ *			descriptors are not enough (each buffer takes one per MCI_DMADES1_MAXTR bytes)
+ */
+uint32_t IP_SDMMC_DmaSetupSG(IP_SDMMC_001_T *pSDMMC, sdif_device *psdif_dev, const IP_SDMMC_SG_T *sg, uint32_t count);
+
 /* Sets the transfer block size */
 void IP_SDMMC_SetBlockSize(IP_SDMMC_001_T *pSDMMC, uint32_t blk_size);
 
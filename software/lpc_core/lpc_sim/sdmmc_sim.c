@@ -0,0 +1,1338 @@
+/*
+ * @brief Host model of the SD/MMC controller and of a card, to run the SD driver off target
+ *
+ * @note
+ * Copyright(C) NXP Semiconductors, 2012
+ * All rights reserved.
+ *
+ * @par
+ * Software that is described herein is for illustrative purposes only
+ * which provides customers with programming information regarding the
+ * LPC products.  This software is supplied "AS IS" without any warranties of
+ * any kind, and NXP Semiconductors and its licensor disclaim any and
+ * all warranties, express or implied, including all implied warranties of
+ * merchantability, fitness for a particular purpose and non-infringement of
+ * intellectual property rights.  NXP Semiconductors assumes no responsibility
+ * or liability for the use of the software, conveys no license or rights under any
+ * patent, copyright, mask work right, or any other intellectual property rights in
+ * or to any products. NXP Semiconductors reserves the right to make changes
+ * in the software without notification. NXP Semiconductors also makes no
+ * representation or warranty that such application will be suitable for the
+ * specified use without further testing or modification.
+ *
+ * @par
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation is hereby granted, under NXP Semiconductors' and its
+ * licensor's relevant copyrights in the software, without fee, provided that it
+ * is used in conjunction with NXP Semiconductors microcontrollers.  This
+ * copyright, permission, and disclaimer notice must appear in all copies of
+ * this code.
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "chip.h"
+#include "sdmmc_sim.h"
+
+/*****************************************************************************
+ * Private types/enumerations/variables
+ ****************************************************************************/
+
+/* Rate of the SDIO base clock when the setup gives none */
+#define SDMMC_SIM_BASE_CLOCK    180000000
+
+/* IDMAC status bits */
+#define SIM_IDSTS_TI            (1 << 0)	/* transmit done */
+#define SIM_IDSTS_RI            (1 << 1)	/* receive done */
+#define SIM_IDSTS_DU            (1 << 4)	/* descriptor unavailable */
+#define SIM_IDSTS_NIS           (1 << 8)
+#define SIM_IDSTS_AIS           (1 << 9)
+
+#define SIM_STS_FIFO_EMPTY      (1 << 2)
+#define SIM_STS_CMD_BUSY        (1 << 4)	/* in the command state machine field */
+
+/* Registers the driver only reads are written by the model */
+#define SIM_REG(r)              (*(volatile uint32_t *) &SimRegs.r)
+
+/* Polling period of the model thread. It sleeps between two looks at the registers, the wakeups
+   preempt a core thread spinning on a register on a host with a single CPU. */
+#define SIM_POLL_US             20
+
+/* Most writes of a packed write header */
+#define SIM_PACKED_MAX          64
+
+/* Bus addresses of a 64-bit host: the top bits select a region of host memory, 0 stands for NULL */
+#define SIM_BUS_REGIONS         8
+#define SIM_BUS_REGION_BITS     29
+
+/* Card: registers, state and the data phase its last command set up */
+typedef struct {
+	int Fd;							/* image */
+	uint32_t Blocks;
+	uint32_t State;					/* CHIP_SDMMC_STATE_T */
+	uint32_t Rca;
+	uint32_t InitLeft;				/* op cond polls before ready */
+	uint32_t Errors;				/* R1 error bits of the next response */
+	uint8_t App;					/* CMD55 taken, the next command is an ACMD */
+	uint8_t Width;					/* data lines, 1, 4 or 8 */
+	uint8_t Ddr;
+	uint8_t Timing;					/* high speed timing */
+	uint32_t BlockCount;			/* CMD23, 0 for a transfer ended by CMD12 */
+	uint8_t Packed;					/* CMD23 announced a packed write */
+	uint32_t EraseStart;
+	uint32_t EraseEnd;
+	uint64_t BusyUntil;				/* DAT0 busy until, 0 when not busy */
+	uint32_t Cid[4];
+	uint32_t Csd[4];
+	uint8_t Scr[SD_SCR_SIZE];
+	uint8_t SwitchStatus[SD_SWITCH_STATUS_SIZE];
+	uint8_t ExtCsd[MMC_SECTOR_SIZE];
+} SIM_CARD_T;
+
+/* Data phase of the last command */
+typedef struct {
+	uint8_t Write;
+	uint8_t Active;
+	uint8_t *Reg;					/* card register read instead of the image */
+	uint32_t Block;					/* next block of the image */
+	uint32_t Count;					/* blocks of the command, 0 until the stop */
+	uint32_t Done;
+	uint32_t Packed;				/* writes of the packed header, 0 for a plain write */
+	uint32_t PackedIndex;
+	uint32_t PackedLeft;
+	uint32_t PackedArg[SIM_PACKED_MAX][2];
+} SIM_DATA_T;
+
+static SDMMC_SIM_CFG_T SimCfg;
+static LPC_SDMMC_T SimRegs __attribute__((aligned(16)));
+static LPC_RITIMER_T SimRit;
+static SIM_CARD_T SimCard;
+static SIM_DATA_T SimData;
+static SDMMC_SIM_STATS_T SimStats;
+static uint8_t SimBlock[MMC_SECTOR_SIZE];
+
+static pthread_t SimThread;
+static pthread_t SimCpu;
+static uint64_t SimEpoch;
+static volatile int32_t SimRun;
+static volatile int32_t SimPowerOff;
+static volatile int32_t SimIrqEnabled;
+static volatile int32_t SimIrqPosted;
+static void (*SimIrqHandler)(void);
+static volatile uint32_t SimInjectIndex = 0xFF;
+static volatile uint32_t SimInjectStatus;
+static uint32_t SimCiuStatus;
+
+static pSDMMC_DMA_T *SimDesc;		/* descriptor of the transfer in use */
+static uint32_t SimDescOffset;
+
+static uintptr_t SimBusRegion[SIM_BUS_REGIONS];	/* base of each region with bit 0 set, 0 while unused */
+
+/*****************************************************************************
+ * Public types/enumerations/variables
+ ****************************************************************************/
+
+/*****************************************************************************
+ * Private functions
+ ****************************************************************************/
+
+/* Time since the start of the model in usec */
+static uint64_t sim_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000) + (ts.tv_nsec / 1000) - SimEpoch;
+}
+
+/* Posts the SDIO interrupt to the core thread while a masked status is raised and the IRQ is enabled */
+static void sim_irq(void)
+{
+	if (SimIrqEnabled && !SimIrqPosted && (SimRegs.CTRL & MCI_CTRL_INT_ENABLE) &&
+		(SimRegs.RINTSTS & SimRegs.INTMASK)) {
+		SimIrqPosted = 1;
+		pthread_kill(SimCpu, SDMMC_SIM_IRQ_SIGNAL);
+	}
+}
+
+/* The SDIO interrupt, taken by the core thread */
+static void sim_irq_signal(int sig)
+{
+	SimIrqPosted = 0;
+	if (SimIrqEnabled && SimIrqHandler && (SimRegs.RINTSTS & SimRegs.INTMASK)) {
+		SimIrqHandler();
+	}
+}
+
+/* Tells whether the card holds DAT0 low, the end of the programming moves it on */
+static int32_t sim_card_busy(void)
+{
+	if (SimCard.BusyUntil && (sim_now() >= SimCard.BusyUntil)) {
+		SimCard.BusyUntil = 0;
+		if (SimCard.State == SDMMC_PRG_ST) {
+			SimCard.State = SDMMC_TRAN_ST;
+		}
+		else if (SimCard.State == SDMMC_DIS_ST) {
+			SimCard.State = SDMMC_STBY_ST;
+		}
+	}
+
+	return SimCard.BusyUntil != 0;
+}
+
+/* What the block does on its own: resets complete, STATUS follows the CIU and DAT0, the interrupt
+   line follows the status */
+static void sim_service(void)
+{
+	uint32_t resets = SimRegs.CTRL & (MCI_CTRL_RESET | MCI_CTRL_FIFO_RESET | MCI_CTRL_DMA_RESET);
+
+	if (resets) {
+		__atomic_fetch_and(&SIM_REG(CTRL), ~resets, __ATOMIC_SEQ_CST);
+	}
+	if (SimRegs.BMOD & MCI_BMOD_SWR) {
+		__atomic_fetch_and(&SIM_REG(BMOD), ~MCI_BMOD_SWR, __ATOMIC_SEQ_CST);
+	}
+
+	SIM_REG(STATUS) = SimCiuStatus | SIM_STS_FIFO_EMPTY | (sim_card_busy() ? MCI_STS_DATA_BUSY : 0);
+	SIM_REG(MINTSTS) = SimRegs.RINTSTS & SimRegs.INTMASK;
+	sim_irq();
+}
+
+/* Sleeps up to one polling period */
+static void sim_sleep(uint64_t us)
+{
+	struct timespec ts;
+
+	ts.tv_sec = 0;
+	ts.tv_nsec = (long) (((us < SIM_POLL_US) ? us : SIM_POLL_US) * 1000);
+	nanosleep(&ts, NULL);
+}
+
+/* Lets time pass, the block keeps serving its registers */
+static void sim_wait(uint64_t us)
+{
+	uint64_t end = sim_now() + us;
+	uint64_t now;
+
+	sim_service();
+	while (SimRun && ((now = sim_now()) < end)) {
+		sim_sleep(end - now);
+		sim_service();
+	}
+}
+
+/* Raises interrupt status bits */
+static void sim_raise(uint32_t bits)
+{
+	__atomic_fetch_or(&SIM_REG(RINTSTS), bits, __ATOMIC_SEQ_CST);
+	sim_service();
+}
+
+/* Card clock in Hz, from the divider set by the driver */
+static uint32_t sim_clock(void)
+{
+	uint32_t div = SimRegs.CLKDIV & 0xFF;
+
+	if (!(SimRegs.CLKENA & MCI_CLKEN_ENABLE)) {
+		return 0;
+	}
+
+	return div ? (SimCfg.BaseClock / (2 * div)) : SimCfg.BaseClock;
+}
+
+/* Data lines the host drives */
+static uint32_t sim_lines(void)
+{
+	if (SimRegs.CTYPE & MCI_CTYPE_8BIT) {
+		return 8;
+	}
+
+	return (SimRegs.CTYPE & MCI_CTYPE_4BIT) ? 4 : 1;
+}
+
+/* Time to move bytes on some lines of the bus */
+static uint64_t sim_bus_us(uint32_t bytes, uint32_t lines)
+{
+	uint64_t clk = sim_clock();
+
+	if (!clk) {
+		clk = SD_MMC_ENUM_CLOCK;
+	}
+	if ((lines > 1) && (SimRegs.UHS_REG & MCI_UHS_DDR)) {
+		clk *= 2;
+	}
+
+	return (((uint64_t) bytes * 8 * 1000000) + (clk * lines) - 1) / (clk * lines);
+}
+
+/* Tells whether data moves without error: host and card agree on the width and DDR, and the clock
+   is within the timing of the card */
+static int32_t sim_bus_ok(void)
+{
+	uint32_t ddr = (SimRegs.UHS_REG & MCI_UHS_DDR) != 0;
+	uint32_t max;
+
+	if ((sim_lines() != SimCard.Width) || (ddr != SimCard.Ddr)) {
+		return 0;
+	}
+	if (SimCfg.Type == SDMMC_SIM_MMC) {
+		max = (SimCard.Timing && SimCfg.HighSpeed) ? MMC_HIGH_BUS_MAX_CLOCK : MMC_LOW_BUS_MAX_CLOCK;
+	}
+	else {
+		max = SimCard.Timing ? SD_HS_MAX_CLOCK : SD_MAX_CLOCK;
+	}
+
+	return sim_clock() <= max;
+}
+
+/* Sets a bit field of a register held as words, bit 0 in the LSB of word 0 */
+static void sim_set_bits(uint32_t *reg, uint32_t start, uint32_t end, uint32_t value)
+{
+	uint32_t i;
+
+	for (i = start; i <= end; i++, value >>= 1) {
+		if (value & 1) {
+			reg[i >> 5] |= 1UL << (i & 31);
+		}
+		else {
+			reg[i >> 5] &= ~(1UL << (i & 31));
+		}
+	}
+}
+
+/* Builds the CID, CSD, SCR and EXT_CSD of the card for the size of the image */
+static void sim_card_build(void)
+{
+	SIM_CARD_T *c = &SimCard;
+	uint32_t c_size;
+	uint8_t rev;
+
+	memset(c->Cid, 0, sizeof(c->Cid));
+	memset(c->Csd, 0, sizeof(c->Csd));
+	sim_set_bits(c->Cid, 120, 127, 0x4C);			/* MID */
+	sim_set_bits(c->Cid, 104, 119, 0x5349);			/* OID */
+	sim_set_bits(c->Cid, 72, 103, 0x4D4F4445);		/* product name */
+	sim_set_bits(c->Cid, 64, 71, 0x4C);
+	sim_set_bits(c->Cid, 24, 55, 0x18304330);		/* serial number */
+	sim_set_bits(c->Cid, 0, 7, 0x01);				/* CRC and end bit */
+
+	sim_set_bits(c->Csd, 0, 7, 0x01);
+	sim_set_bits(c->Csd, 80, 83, 9);				/* READ_BL_LEN 512 */
+	sim_set_bits(c->Csd, 96, 103, 0x32);			/* TRAN_SPEED 25MHz */
+	switch (SimCfg.Type) {
+	case SDMMC_SIM_SDHC:
+		c_size = (c->Blocks >> 10) - 1;
+		sim_set_bits(c->Csd, 126, 127, 1);			/* CSD 2.0 */
+		sim_set_bits(c->Csd, 84, 95, 0x5B5);		/* classes, 10 is the switch function */
+		sim_set_bits(c->Csd, 48, 69, c_size);
+		c->Blocks = (c_size + 1) << 10;
+		break;
+
+	case SDMMC_SIM_SDSC:
+		c_size = (c->Blocks >> 9) - 1;
+		if (c_size > 0xFFF) {
+			c_size = 0xFFF;
+		}
+		sim_set_bits(c->Csd, 84, 95, 0x5B5);
+		sim_set_bits(c->Csd, 62, 73, c_size);
+		sim_set_bits(c->Csd, 47, 49, 7);			/* C_SIZE_MULT 512 */
+		c->Blocks = (c_size + 1) << 9;
+		break;
+
+	default:
+		/* the size of an MMC 4.x card is SEC_COUNT of EXT_CSD */
+		c_size = (c->Blocks >> 9) - 1;
+		if (c_size > 0xFFF) {
+			c_size = 0xFFF;
+		}
+		sim_set_bits(c->Csd, 126, 127, 2);
+		sim_set_bits(c->Csd, 122, 125, 4);			/* SPEC_VERS 4.x */
+		sim_set_bits(c->Csd, 84, 95, 0x0F5);
+		sim_set_bits(c->Csd, 62, 73, c_size);
+		sim_set_bits(c->Csd, 47, 49, 7);
+		break;
+	}
+
+	memset(c->Scr, 0, sizeof(c->Scr));
+	c->Scr[0] = 0x02;								/* SD 2.0 */
+	c->Scr[1] = 0x05;								/* 1 and 4 bit bus */
+	c->Scr[2] = 0x80;
+	c->Scr[3] = SimCfg.Cmd23 ? 0x02 : 0;
+
+	rev = SimCfg.MmcRev ? SimCfg.MmcRev : EXT_CSD_REV_4_41;
+	memset(c->ExtCsd, 0, sizeof(c->ExtCsd));
+	c->ExtCsd[EXT_CSD_REV] = rev;
+	c->ExtCsd[194] = 2;								/* CSD_STRUCTURE */
+	c->ExtCsd[EXT_CSD_CARD_TYPE] = EXT_CSD_CARD_TYPE_26 | (SimCfg.HighSpeed ? EXT_CSD_CARD_TYPE_52 : 0) |
+								   (SimCfg.Ddr ? EXT_CSD_CARD_TYPE_DDR52 : 0);
+	c->ExtCsd[EXT_CSD_SEC_COUNT] = (uint8_t) c->Blocks;
+	c->ExtCsd[EXT_CSD_SEC_COUNT + 1] = (uint8_t) (c->Blocks >> 8);
+	c->ExtCsd[EXT_CSD_SEC_COUNT + 2] = (uint8_t) (c->Blocks >> 16);
+	c->ExtCsd[EXT_CSD_SEC_COUNT + 3] = (uint8_t) (c->Blocks >> 24);
+	c->ExtCsd[EXT_CSD_HC_WP_GRP_SIZE] = 1;
+	c->ExtCsd[EXT_CSD_HC_ERASE_GRP_SIZE] = 1;
+	c->ExtCsd[504] = 1;								/* S_CMD_SET */
+	if (rev >= EXT_CSD_REV_4_5) {
+		c->ExtCsd[EXT_CSD_CACHE_SIZE + 1] = 0x04;	/* 1MB, in KB */
+		c->ExtCsd[EXT_CSD_MAX_PACKED_WRITES] = 8;
+	}
+}
+
+/* Back to idle state, as after CMD0 or a power cycle */
+static void sim_card_reset(void)
+{
+	SIM_CARD_T *c = &SimCard;
+
+	c->State = SDMMC_IDLE_ST;
+	c->Rca = 0;
+	c->InitLeft = SimCfg.InitPolls;
+	c->Errors = 0;
+	c->App = 0;
+	c->Width = 1;
+	c->Ddr = 0;
+	c->Timing = 0;
+	c->BlockCount = 0;
+	c->Packed = 0;
+	c->ExtCsd[EXT_CSD_BUS_WIDTH] = 0;
+	c->ExtCsd[EXT_CSD_HS_TIMING] = 0;
+	c->ExtCsd[EXT_CSD_PART_CONFIG] = 0;
+	c->ExtCsd[EXT_CSD_CACHE_CTRL] = 0;
+	SimData.Active = 0;
+}
+
+/* R1 card status: errors since the last one, state when the command came, ready for data */
+static uint32_t sim_r1(void)
+{
+	uint32_t r1 = SimCard.Errors | (SimCard.State << 9);
+
+	if (!sim_card_busy()) {
+		r1 |= R1_READY_FOR_DATA;
+	}
+	if (SimCard.App) {
+		r1 |= R1_APP_CMD;
+	}
+	SimCard.Errors = 0;
+
+	return r1;
+}
+
+static void sim_resp(uint32_t r0)
+{
+	SIM_REG(RESP0) = r0;
+}
+
+static void sim_resp_long(const uint32_t *r)
+{
+	SIM_REG(RESP0) = r[0];
+	SIM_REG(RESP1) = r[1];
+	SIM_REG(RESP2) = r[2];
+	SIM_REG(RESP3) = r[3];
+}
+
+/* A command the card does not take in its state: no response */
+static int32_t sim_illegal(void)
+{
+	SimCard.Errors |= R1_ILLEGAL_COMMAND;
+	return 0;
+}
+
+/* Starts programming for some time */
+static void sim_card_program(uint32_t us)
+{
+	uint64_t now = sim_now();
+
+	SimCard.State = SDMMC_PRG_ST;
+	if (SimCard.BusyUntil < now) {
+		SimCard.BusyUntil = now;
+	}
+	SimCard.BusyUntil += us;
+	SimStats.BusyUs += us;
+}
+
+/* ACMD41 / CMD1: ready after InitPolls polls with a voltage window, with CCS once ready on high
+   capacity cards */
+static void sim_op_cond(uint32_t arg)
+{
+	uint32_t ocr = OCR_VOLTAGE_RANGE_MSK;
+
+	if (SimCfg.Type == SDMMC_SIM_MMC) {
+		ocr |= OCR_HC_CCS | 0x80;				/* sector mode, 1.8V */
+	}
+	if (arg & OCR_VOLTAGE_RANGE_MSK) {
+		if (SimCard.InitLeft) {
+			SimCard.InitLeft--;
+		}
+		else {
+			ocr |= OCR_ALL_READY;
+			if ((SimCfg.Type == SDMMC_SIM_SDHC) && (arg & OCR_HC_CCS)) {
+				ocr |= OCR_HC_CCS;
+			}
+			SimCard.State = SDMMC_READY_ST;
+		}
+	}
+	sim_resp(ocr);
+}
+
+/* Block of a data command address, or error */
+static int32_t sim_card_block(uint32_t arg, uint32_t count, uint32_t *block)
+{
+	*block = (SimCfg.Type == SDMMC_SIM_SDSC) ? (arg >> 9) : arg;
+	if ((SimCfg.Type == SDMMC_SIM_SDSC) && (arg & (MMC_SECTOR_SIZE - 1))) {
+		SimCard.Errors |= R1_ADDRESS_ERROR;
+		return 0;
+	}
+	if ((*block + (count ? count : 1)) > SimCard.Blocks) {
+		SimCard.Errors |= R1_OUT_OF_RANGE;
+		return 0;
+	}
+	if ((SimCfg.Type == SDMMC_SIM_MMC) && (SimCard.ExtCsd[EXT_CSD_PART_CONFIG] & EXT_CSD_PART_ACCESS_MSK)) {
+		/* only the user area is in the image */
+		SimCard.Errors |= R1_ADDRESS_ERROR;
+		return 0;
+	}
+
+	return 1;
+}
+
+/* Sets up the data phase of a command */
+static void sim_card_data(uint32_t write, uint8_t *reg, uint32_t block, uint32_t count)
+{
+	memset(&SimData, 0, sizeof(SimData) - sizeof(SimData.PackedArg));
+	SimData.Active = 1;
+	SimData.Write = write;
+	SimData.Reg = reg;
+	SimData.Block = block;
+	SimData.Count = count;
+	SimCard.State = write ? SDMMC_RCV_ST : SDMMC_DATA_ST;
+}
+
+/* SD CMD6: builds the switch status, the set mode moves the card to the function */
+static void sim_sd_switch(uint32_t arg)
+{
+	uint8_t *s = SimCard.SwitchStatus;
+	uint32_t fn = arg & 0xF;
+	uint32_t result;
+
+	if (fn == 0xF) {
+		result = SimCard.Timing;
+	}
+	else if ((fn == 0) || ((fn == 1) && SimCfg.HighSpeed)) {
+		result = fn;
+	}
+	else {
+		result = 0xF;
+	}
+
+	memset(s, 0, SD_SWITCH_STATUS_SIZE);
+	s[1] = 100;										/* max current */
+	s[13] = 0x01 | (SimCfg.HighSpeed ? 0x02 : 0);	/* functions of group 1 */
+	s[16] = (uint8_t) result;
+	s[17] = 1;
+	if ((arg & 0x80000000) && (result != 0xF)) {
+		SimCard.Timing = (uint8_t) result;
+	}
+}
+
+/* MMC CMD6: writes a byte of EXT_CSD and programs for SwitchBusy usec */
+static void sim_mmc_switch(uint32_t arg)
+{
+	uint32_t index = (arg >> 16) & 0xFF;
+	uint32_t value = (arg >> 8) & 0xFF;
+	uint32_t rev = SimCard.ExtCsd[EXT_CSD_REV];
+	int32_t ok = ((arg >> 24) & 3) == MMC_SWITCH_WRITE_BYTE;
+
+	switch (index) {
+	case EXT_CSD_BUS_WIDTH:
+		ok &= ((value & 3) <= EXT_CSD_BUS_WIDTH_8) && !((value & EXT_CSD_BUS_WIDTH_DDR) &&
+													  (!SimCfg.Ddr || !(value & 3)));
+		if (ok) {
+			SimCard.Width = ((value & 3) == EXT_CSD_BUS_WIDTH_8) ? 8 : ((value & 3) == EXT_CSD_BUS_WIDTH_4) ? 4 : 1;
+			SimCard.Ddr = (value & EXT_CSD_BUS_WIDTH_DDR) != 0;
+		}
+		break;
+
+	case EXT_CSD_HS_TIMING:
+		ok &= value <= 1;
+		if (ok) {
+			SimCard.Timing = (uint8_t) value;
+		}
+		break;
+
+	case EXT_CSD_PART_CONFIG:
+		ok &= (value & EXT_CSD_PART_ACCESS_MSK) == MMC_PART_USER;
+		break;
+
+	case EXT_CSD_CACHE_CTRL:
+	case EXT_CSD_FLUSH_CACHE:
+		ok &= (rev >= EXT_CSD_REV_4_5) && (value <= 1);
+		break;
+
+	default:
+		ok = 0;
+		break;
+	}
+
+	sim_resp(sim_r1());
+	if (!ok) {
+		SimCard.Errors |= R1_SWITCH_ERROR;
+	}
+	else if (index != EXT_CSD_FLUSH_CACHE) {
+		SimCard.ExtCsd[index] = (uint8_t) value;
+	}
+	sim_card_program(SimCfg.SwitchBusy);
+}
+
+/* Erases the blocks from EraseStart to EraseEnd, they read as 0 */
+static void sim_card_erase(void)
+{
+	uint32_t block;
+
+	memset(SimBlock, 0, sizeof(SimBlock));
+	for (block = SimCard.EraseStart; (block <= SimCard.EraseEnd) && (block < SimCard.Blocks); block++) {
+		if (pwrite(SimCard.Fd, SimBlock, MMC_SECTOR_SIZE, (off_t) block * MMC_SECTOR_SIZE) < 0) {
+			SimCard.Errors |= R1_ERROR;
+			break;
+		}
+	}
+	sim_card_program(SimCfg.SwitchBusy);
+}
+
+/* CMD12 during a transfer, the card ends its data phase */
+static uint32_t sim_card_stop(void)
+{
+	uint32_t r1 = sim_r1();
+
+	if (SimCard.State == SDMMC_RCV_ST) {
+		sim_card_program(SimCfg.WriteBusy + (SimData.Done * SimCfg.WriteBusyBlock));
+	}
+	else {
+		SimCard.State = SDMMC_TRAN_ST;
+	}
+	SimData.Active = 0;
+
+	return r1;
+}
+
+/* Runs a command on the card, returns 0 when it does not answer */
+static int32_t sim_card_command(uint32_t index, uint32_t arg, uint32_t app)
+{
+	SIM_CARD_T *c = &SimCard;
+	int32_t sd = SimCfg.Type != SDMMC_SIM_MMC;
+	int32_t addressed = ((arg >> 16) == c->Rca) && c->Rca;
+	uint32_t state, block, count;
+
+	sim_card_busy();
+	state = c->State;
+	c->App = 0;
+
+	if (app && sd) {
+		switch (index) {
+		case SD_APP_SET_BUS_WIDTH:
+			if (state != SDMMC_TRAN_ST) {
+				return sim_illegal();
+			}
+			sim_resp(sim_r1());
+			c->Width = ((arg & 3) == 2) ? 4 : 1;
+			return 1;
+
+		case SD_APP_SET_ERASE_COUNT:
+			if (state != SDMMC_TRAN_ST) {
+				return sim_illegal();
+			}
+			sim_resp(sim_r1());
+			return 1;
+
+		case SD_APP_OP_COND:
+			if ((state != SDMMC_IDLE_ST) && (state != SDMMC_READY_ST)) {
+				return sim_illegal();
+			}
+			sim_op_cond(arg);
+			return 1;
+
+		case SD_APP_SEND_SCR:
+			if (state != SDMMC_TRAN_ST) {
+				return sim_illegal();
+			}
+			sim_resp(sim_r1());
+			sim_card_data(0, c->Scr, 0, 1);
+			return 1;
+
+		default:
+			return sim_illegal();
+		}
+	}
+
+	switch (index) {
+	case MMC_GO_IDLE_STATE:
+		sim_card_reset();
+		return 1;
+
+	case MMC_SEND_OP_COND:
+		if (sd || ((state != SDMMC_IDLE_ST) && (state != SDMMC_READY_ST))) {
+			return sim_illegal();
+		}
+		sim_op_cond(arg);
+		return 1;
+
+	case MMC_ALL_SEND_CID:
+		if (state != SDMMC_READY_ST) {
+			return 0;
+		}
+		sim_resp_long(c->Cid);
+		c->State = SDMMC_IDENT_ST;
+		return 1;
+
+	case MMC_SET_RELATIVE_ADDR:
+		if ((state != SDMMC_IDENT_ST) && (state != SDMMC_STBY_ST)) {
+			return sim_illegal();
+		}
+		if (sd) {
+			/* R6: the published RCA and a short status */
+			c->Rca = 0xB368;
+			sim_resp((c->Rca << 16) | (state << 9) | R1_READY_FOR_DATA);
+		}
+		else {
+			c->Rca = arg >> 16;
+			sim_resp(sim_r1());
+		}
+		c->State = SDMMC_STBY_ST;
+		return 1;
+
+	case MMC_SWITCH:
+		if (state != SDMMC_TRAN_ST) {
+			return sim_illegal();
+		}
+		if (sd) {
+			sim_resp(sim_r1());
+			sim_sd_switch(arg);
+			sim_card_data(0, c->SwitchStatus, 0, 1);
+		}
+		else {
+			sim_mmc_switch(arg);
+		}
+		return 1;
+
+	case MMC_SELECT_CARD:
+		if (!addressed) {
+			/* deselected, without response */
+			if (state == SDMMC_TRAN_ST) {
+				c->State = SDMMC_STBY_ST;
+			}
+			else if (state == SDMMC_PRG_ST) {
+				c->State = SDMMC_DIS_ST;
+			}
+			return 0;
+		}
+		if ((state != SDMMC_STBY_ST) && (state != SDMMC_DIS_ST)) {
+			return sim_illegal();
+		}
+		sim_resp(sim_r1());
+		c->State = (state == SDMMC_DIS_ST) ? SDMMC_PRG_ST : SDMMC_TRAN_ST;
+		return 1;
+
+	case MMC_SEND_EXT_CSD:
+		if (sd) {
+			/* SD_CMD8, echoes the voltage and the check pattern */
+			if (state != SDMMC_IDLE_ST) {
+				return sim_illegal();
+			}
+			sim_resp(arg & 0xFFF);
+			return 1;
+		}
+		if (state != SDMMC_TRAN_ST) {
+			return sim_illegal();
+		}
+		sim_resp(sim_r1());
+		sim_card_data(0, c->ExtCsd, 0, 1);
+		return 1;
+
+	case MMC_SEND_CSD:
+	case MMC_SEND_CID:
+		if ((state != SDMMC_STBY_ST) || !addressed) {
+			return 0;
+		}
+		sim_resp_long((index == MMC_SEND_CSD) ? c->Csd : c->Cid);
+		return 1;
+
+	case MMC_STOP_TRANSMISSION:
+		if ((state != SDMMC_DATA_ST) && (state != SDMMC_RCV_ST)) {
+			return sim_illegal();
+		}
+		sim_resp(sim_card_stop());
+		return 1;
+
+	case MMC_SEND_STATUS:
+		if (!addressed) {
+			return 0;
+		}
+		sim_resp(sim_r1());
+		return 1;
+
+	case MMC_SET_BLOCKLEN:
+		if (state != SDMMC_TRAN_ST) {
+			return sim_illegal();
+		}
+		if (arg != MMC_SECTOR_SIZE) {
+			c->Errors |= R1_BLOCK_LEN_ERROR;
+		}
+		sim_resp(sim_r1());
+		return 1;
+
+	case MMC_SET_BLOCK_COUNT:
+		if ((state != SDMMC_TRAN_ST) || (sd && !SimCfg.Cmd23)) {
+			return sim_illegal();
+		}
+		c->BlockCount = arg & MMC_MAX_BLOCK_COUNT;
+		c->Packed = !sd && (arg & MMC_CMD23_PACKED);
+		sim_resp(sim_r1());
+		return 1;
+
+	case MMC_READ_SINGLE_BLOCK:
+	case MMC_READ_MULTIPLE_BLOCK:
+	case MMC_WRITE_BLOCK:
+	case MMC_WRITE_MULTIPLE_BLOCK:
+		if (state != SDMMC_TRAN_ST) {
+			return sim_illegal();
+		}
+		count = ((index == MMC_READ_SINGLE_BLOCK) || (index == MMC_WRITE_BLOCK)) ? 1 : c->BlockCount;
+		c->BlockCount = 0;
+		if (c->Packed && (index == MMC_WRITE_MULTIPLE_BLOCK)) {
+			/* the address is the one of the first write, the header gives them all */
+			c->Packed = 0;
+			sim_resp(sim_r1());
+			sim_card_data(1, NULL, 0, count);
+			SimData.Packed = 1;
+			return 1;
+		}
+		c->Packed = 0;
+		if (!sim_card_block(arg, count, &block)) {
+			sim_resp(sim_r1());
+			return 1;
+		}
+		sim_resp(sim_r1());
+		sim_card_data((index == MMC_WRITE_BLOCK) || (index == MMC_WRITE_MULTIPLE_BLOCK), NULL, block, count);
+		return 1;
+
+	case SD_ERASE_WR_BLK_START:
+	case MMC_ERASE_GROUP_START:
+	case SD_ERASE_WR_BLK_END:
+	case MMC_ERASE_GROUP_END:
+		if ((state != SDMMC_TRAN_ST) || (sd != ((index == SD_ERASE_WR_BLK_START) || (index == SD_ERASE_WR_BLK_END)))) {
+			return sim_illegal();
+		}
+		block = (SimCfg.Type == SDMMC_SIM_SDSC) ? (arg >> 9) : arg;
+		if ((index == SD_ERASE_WR_BLK_START) || (index == MMC_ERASE_GROUP_START)) {
+			c->EraseStart = block;
+		}
+		else {
+			c->EraseEnd = block;
+		}
+		sim_resp(sim_r1());
+		return 1;
+
+	case SD_ERASE:
+		if (state != SDMMC_TRAN_ST) {
+			return sim_illegal();
+		}
+		sim_resp(sim_r1());
+		sim_card_erase();
+		return 1;
+
+	case MMC_APP_CMD:
+		if ((c->Rca && !addressed) || (!sd && (state == SDMMC_IDLE_ST))) {
+			return 0;
+		}
+		c->App = 1;
+		sim_resp(sim_r1());
+		return 1;
+
+	default:
+		return sim_illegal();
+	}
+}
+
+/* Moves bytes between a block buffer and the buffers of the descriptor chain, 0 when the chain has
+   no descriptor owned by the DMA */
+static int32_t sim_dma(uint8_t *block, uint32_t len, uint32_t to_host)
+{
+	uint32_t size, n;
+	uint8_t *buf;
+
+	while (len) {
+		if (!SimDesc || !(SimDesc->des0 & MCI_DMADES0_OWN)) {
+			__atomic_fetch_or(&SIM_REG(IDSTS), SIM_IDSTS_DU | SIM_IDSTS_AIS, __ATOMIC_SEQ_CST);
+			return 0;
+		}
+		size = SimDesc->des1 & 0x1FFF;
+		buf = (uint8_t *) SdmmcSim_BusPtr(SimDesc->des2) + SimDescOffset;
+		n = ((size - SimDescOffset) < len) ? (size - SimDescOffset) : len;
+		if (to_host) {
+			memcpy(buf, block, n);
+		}
+		else {
+			memcpy(block, buf, n);
+		}
+		block += n;
+		len -= n;
+		SimDescOffset += n;
+
+		if (SimDescOffset >= size) {
+			/* the descriptor goes back to the driver */
+			SimDescOffset = 0;
+			SimStats.Descriptors++;
+			n = SimDesc->des0;
+			SimDesc->des0 = n & ~MCI_DMADES0_OWN;
+			if (n & MCI_DMADES0_LD) {
+				SimDesc = NULL;
+			}
+			else if (n & MCI_DMADES0_CH) {
+				SimDesc = (pSDMMC_DMA_T *) SdmmcSim_BusPtr(SimDesc->des3);
+			}
+			else {
+				SimDesc = (pSDMMC_DMA_T *) ((uint8_t *) (SimDesc + 1) + (((SimRegs.BMOD >> 2) & 0x1F) * 4));
+			}
+		}
+	}
+
+	return 1;
+}
+
+/* Parses the header block of a packed write */
+static int32_t sim_packed_header(const uint32_t *hdr)
+{
+	uint32_t count = (hdr[0] >> 16) & 0xFF;
+	uint32_t i, blocks = 1;
+
+	if (((hdr[0] & 0xFFFF) != ((MMC_PACKED_WRITE << 8) | MMC_PACKED_VERSION)) || !count ||
+		(count > SIM_PACKED_MAX)) {
+		return 0;
+	}
+	for (i = 0; i < count; i++) {
+		SimData.PackedArg[i][0] = hdr[2 * (i + 1)];
+		SimData.PackedArg[i][1] = hdr[2 * (i + 1) + 1];
+		blocks += SimData.PackedArg[i][0];
+		if ((SimData.PackedArg[i][1] + SimData.PackedArg[i][0]) > SimCard.Blocks) {
+			return 0;
+		}
+	}
+	SimData.Packed = count;
+	SimData.PackedIndex = 0;
+	SimData.PackedLeft = SimData.PackedArg[0][0];
+	SimData.Block = SimData.PackedArg[0][1];
+
+	return blocks == SimData.Count;
+}
+
+/* Image block of the next data block of a packed write */
+static void sim_packed_next(void)
+{
+	if (--SimData.PackedLeft || (++SimData.PackedIndex >= SimData.Packed)) {
+		return;
+	}
+	SimData.PackedLeft = SimData.PackedArg[SimData.PackedIndex][0];
+	SimData.Block = SimData.PackedArg[SimData.PackedIndex][1] - 1;
+}
+
+/* Data phase of a command: the blocks move one by one between the card and the descriptors at the bus
+   rate. Returns the interrupt status at its end. */
+static uint32_t sim_data(uint32_t cmd, uint32_t inject)
+{
+	uint32_t write = (cmd & MCI_CMD_DAT_WR) != 0;
+	uint32_t blksz = SimRegs.BLKSIZ;
+	uint32_t bytes = SimRegs.BYTCNT;
+	uint32_t lines = sim_lines();
+	int32_t ok = sim_bus_ok();
+	uint64_t us;
+
+	if (!SimData.Active || (SimData.Write != write) || !blksz || (blksz > MMC_SECTOR_SIZE)) {
+		/* the card sends no data, or takes none (no CRC status) */
+		sim_wait(1000);
+		return MCI_INT_DATA_OVER | (write ? MCI_INT_EBE : MCI_INT_DTO);
+	}
+	if (!(SimRegs.BMOD & MCI_BMOD_DE) || !(SimRegs.CTRL & MCI_CTRL_USE_INT_DMAC)) {
+		/* the FIFO is not modelled, nothing reads it */
+		return MCI_INT_DATA_OVER | MCI_INT_HTO;
+	}
+	SimDesc = (pSDMMC_DMA_T *) SdmmcSim_BusPtr(SimRegs.DBADDR);
+	SimDescOffset = 0;
+	if (!ok) {
+		SimStats.CrcErrors++;
+	}
+
+	if (!write) {
+		sim_wait(SimData.Reg ? SimCfg.CmdLatency : SimCfg.ReadLatency);
+	}
+	while (bytes >= blksz) {
+		if (!SimData.Reg && (SimData.Block >= SimCard.Blocks)) {
+			SimCard.Errors |= R1_OUT_OF_RANGE;
+			return MCI_INT_DATA_OVER | (write ? MCI_INT_EBE : MCI_INT_DTO);
+		}
+
+		if (!write) {
+			if (SimData.Reg) {
+				memcpy(SimBlock, SimData.Reg + (SimData.Done * blksz), blksz);
+			}
+			else if (pread(SimCard.Fd, SimBlock, blksz, (off_t) SimData.Block * MMC_SECTOR_SIZE) != (ssize_t) blksz) {
+				SimCard.Errors |= R1_ERROR;
+			}
+			if (!ok) {
+				SimBlock[0] ^= 0xFF;		/* the data the host samples is wrong */
+			}
+			if (!sim_dma(SimBlock, blksz, 1)) {
+				return MCI_INT_DATA_OVER | MCI_INT_HTO;
+			}
+			if (!SimData.Reg) {
+				SimStats.BlocksRead++;
+			}
+		}
+		else {
+			if (!sim_dma(SimBlock, blksz, 0)) {
+				return MCI_INT_DATA_OVER | MCI_INT_HTO;
+			}
+			if (!ok) {
+				/* the card answers the block with a CRC error and takes no more */
+				SimCard.Errors |= R1_COM_CRC_ERROR;
+				return MCI_INT_DATA_OVER | MCI_INT_DCRC;
+			}
+			if (SimData.Packed == 1) {
+				if (!sim_packed_header((const uint32_t *) SimBlock)) {
+					SimCard.Errors |= R1_ERROR;
+					return MCI_INT_DATA_OVER | MCI_INT_DCRC;
+				}
+				SimData.Block--;
+			}
+			else {
+				if (pwrite(SimCard.Fd, SimBlock, blksz, (off_t) SimData.Block * MMC_SECTOR_SIZE) != (ssize_t) blksz) {
+					SimCard.Errors |= R1_ERROR;
+				}
+				SimStats.BlocksWritten++;
+				if (SimData.Packed) {
+					sim_packed_next();
+				}
+			}
+		}
+
+		us = sim_bus_us(blksz, lines);
+		SimStats.BusUs += us;
+		sim_wait(us);
+
+		/* a command posted meanwhile is refused, the CIU is still busy with this one */
+		if (SimRegs.CMD & MCI_CMD_START) {
+			__atomic_fetch_and(&SIM_REG(CMD), ~MCI_CMD_START, __ATOMIC_SEQ_CST);
+			SimStats.Overlaps++;
+			sim_raise(MCI_INT_HLE);
+		}
+
+		bytes -= blksz;
+		SimData.Block++;
+		SimData.Done++;
+		if (SimData.Count && (SimData.Done == SimData.Count)) {
+			/* a single block or a counted transfer ends without a stop */
+			if (write) {
+				sim_card_program(SimCfg.WriteBusy + (SimData.Done * SimCfg.WriteBusyBlock));
+			}
+			else {
+				SimCard.State = SDMMC_TRAN_ST;
+			}
+			SimData.Active = 0;
+			break;
+		}
+	}
+
+	__atomic_fetch_or(&SIM_REG(IDSTS), (write ? SIM_IDSTS_TI : SIM_IDSTS_RI) | SIM_IDSTS_NIS, __ATOMIC_SEQ_CST);
+	return MCI_INT_DATA_OVER | (ok ? 0 : MCI_INT_DCRC) | (inject & ~MCI_INT_RTO);
+}
+
+/* Runs a command posted in the CMD register, with its data and its auto-stop */
+static void sim_command(uint32_t cmd, uint32_t arg)
+{
+	uint32_t index = cmd & 0x3F;
+	uint32_t app = SimCard.App;
+	uint32_t inject = 0;
+	uint32_t status;
+	int32_t answer;
+
+	/* clock updates only load the divider */
+	if (cmd & MCI_CMD_UPD_CLK) {
+		__atomic_fetch_and(&SIM_REG(CMD), ~MCI_CMD_START, __ATOMIC_SEQ_CST);
+		return;
+	}
+
+	/* the CIU takes the command once the card is done with the last one */
+	if (cmd & MCI_CMD_PRV_DAT_WAIT) {
+		while (SimRun && sim_card_busy()) {
+			sim_service();
+			sim_sleep(SIM_POLL_US);
+		}
+	}
+	SimCiuStatus = SIM_STS_CMD_BUSY | ((cmd & MCI_CMD_DAT_EXP) ? MCI_STS_DATA_SM_BUSY : 0);
+	__atomic_fetch_and(&SIM_REG(CMD), ~MCI_CMD_START, __ATOMIC_SEQ_CST);
+	sim_service();
+	SimStats.Commands++;
+	if (app) {
+		SimStats.AppCommands++;
+	}
+
+	if (SimInjectIndex == index) {
+		inject = SimInjectStatus;
+		SimInjectIndex = 0xFF;
+	}
+
+	/* 48 bit command, the card latency and its response (136 bits for R2) */
+	sim_wait(sim_bus_us(6, 1) + ((cmd & MCI_CMD_RESP_EXP) ?
+								 (SimCfg.CmdLatency + sim_bus_us((cmd & MCI_CMD_RESP_LONG) ? 17 : 6, 1)) : 0));
+
+	if (index != MMC_APP_CMD) {
+		SimData.Active &= (index == MMC_STOP_TRANSMISSION) || (index == MMC_SEND_STATUS);
+	}
+	answer = (inject & MCI_INT_RTO) ? 0 : sim_card_command(index, arg, app);
+
+	status = MCI_INT_CMD_DONE;
+	if ((cmd & MCI_CMD_RESP_EXP) && !answer) {
+		status |= MCI_INT_RTO;
+	}
+	if (!(cmd & MCI_CMD_DAT_EXP)) {
+		SimCiuStatus = 0;
+		sim_raise(status | (inject & ~MCI_INT_RTO));
+		return;
+	}
+	sim_raise(status);
+	if (status & MCI_INT_RTO) {
+		SimCiuStatus = 0;
+		sim_service();
+		return;
+	}
+
+	SimCiuStatus = MCI_STS_DATA_SM_BUSY;
+	status = sim_data(cmd, inject);
+
+	if (cmd & MCI_CMD_SEND_STOP) {
+		/* the data is over, the CIU sends CMD12 on its own, the response goes to RESP1 */
+		SimCiuStatus = SIM_STS_CMD_BUSY;
+		sim_raise(status);
+		sim_wait(sim_bus_us(12, 1) + SimCfg.CmdLatency);
+		SimStats.Commands++;
+		if ((SimCard.State == SDMMC_DATA_ST) || (SimCard.State == SDMMC_RCV_ST)) {
+			SIM_REG(RESP1) = sim_card_stop();
+			status = MCI_INT_ACD;
+		}
+		else {
+			status = MCI_INT_ACD | MCI_INT_RTO;
+		}
+	}
+	SimCiuStatus = 0;
+	sim_raise(status);
+}
+
+/* The block: takes the commands posted in its CMD register */
+static void *sim_thread(void *arg)
+{
+	while (SimRun) {
+		if (SimPowerOff) {
+			sim_card_reset();
+			SimCard.BusyUntil = 0;
+			SimPowerOff = 0;
+		}
+		if (SimRegs.CMD & MCI_CMD_START) {
+			sim_command(SimRegs.CMD, SimRegs.CMDARG);
+		}
+		sim_service();
+		sim_sleep(SIM_POLL_US);
+	}
+
+	return NULL;
+}
+
+/*****************************************************************************
+ * Public functions
+ ****************************************************************************/
+
+/* Start the model */
+LPC_SDMMC_T *SdmmcSim_Start(const SDMMC_SIM_CFG_T *pCfg)
+{
+	struct sigaction sa;
+	struct stat st;
+
+	SimCfg = *pCfg;
+	if (!SimCfg.BaseClock) {
+		SimCfg.BaseClock = SDMMC_SIM_BASE_CLOCK;
+	}
+
+	memset(&SimCard, 0, sizeof(SimCard));
+	memset(&SimData, 0, sizeof(SimData));
+	memset(&SimStats, 0, sizeof(SimStats));
+	SimCard.Fd = open(SimCfg.Image, O_RDWR);
+	if (SimCard.Fd < 0) {
+		return NULL;
+	}
+	if ((fstat(SimCard.Fd, &st) != 0) || (st.st_size < (1024 * MMC_SECTOR_SIZE))) {
+		close(SimCard.Fd);
+		return NULL;
+	}
+	SimCard.Blocks = (uint32_t) (st.st_size / MMC_SECTOR_SIZE);
+	sim_card_build();
+	sim_card_reset();
+
+	SimEpoch = 0;
+	SimEpoch = sim_now();
+	memset(&SimRegs, 0, sizeof(SimRegs));
+	SIM_REG(VERID) = 0x5342240A;
+	SIM_REG(CDETECT) = 0;				/* card in the slot */
+	SIM_REG(WRTPRT) = SimCfg.WriteProtect ? 1 : 0;
+	SIM_REG(STATUS) = SIM_STS_FIFO_EMPTY;
+
+	SimCpu = pthread_self();
+	SimIrqEnabled = 0;
+	SimIrqPosted = 0;
+	SimInjectIndex = 0xFF;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = sim_irq_signal;
+	sa.sa_flags = SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SDMMC_SIM_IRQ_SIGNAL, &sa, NULL);
+
+	SimRun = 1;
+	if (pthread_create(&SimThread, NULL, sim_thread, NULL) != 0) {
+		SimRun = 0;
+		close(SimCard.Fd);
+		return NULL;
+	}
+
+	return &SimRegs;
+}
+
+/* Stop the model */
+void SdmmcSim_Stop(void)
+{
+	if (!SimRun) {
+		return;
+	}
+	SimRun = 0;
+	pthread_join(SimThread, NULL);
+	close(SimCard.Fd);
+}
+
+/* Set the SDIO interrupt handler */
+void SdmmcSim_SetIrqHandler(void (*func)(void))
+{
+	SimIrqHandler = func;
+}
+
+/* Enable or disable the SDIO interrupt */
+void SdmmcSim_EnableIrq(int32_t enable)
+{
+	SimIrqEnabled = enable;
+}
+
+/* Write to a write-1-to-clear status register */
+void SdmmcSim_Clear(volatile uint32_t *reg, uint32_t bits)
+{
+	__atomic_fetch_and((uint32_t *) reg, ~bits, __ATOMIC_SEQ_CST);
+}
+
+/* Let the model thread run while the driver polls */
+void SdmmcSim_Yield(void)
+{
+	sim_sleep(SIM_POLL_US);
+}
+
+/* Power the card off and on */
+void SdmmcSim_PowerCycle(void)
+{
+	SimPowerOff = 1;
+	while (SimRun && SimPowerOff) {
+		sched_yield();
+	}
+}
+
+/* Make the next command with an index end with error interrupts */
+void SdmmcSim_InjectError(uint32_t index, uint32_t status)
+{
+	SimInjectStatus = status;
+	SimInjectIndex = index;
+}
+
+/* Get the model counters */
+void SdmmcSim_GetStats(SDMMC_SIM_STATS_T *stats)
+{
+	*stats = SimStats;
+}
+
+/* Get the model time */
+uint64_t SdmmcSim_GetTimeUs(void)
+{
+	return sim_now();
+}
+
+/* Get the cycle count of a core clocked by the SDIO base clock */
+uint32_t SdmmcSim_GetCycles(void)
+{
+	return (uint32_t) (sim_now() * (SimCfg.BaseClock / 1000000));
+}
+
+/* Register block of the model, LPC_SDMMC of a host build */
+LPC_SDMMC_T *SdmmcSim_GetRegs(void)
+{
+	return &SimRegs;
+}
+
+/* RI timer counting at the core clock, LPC_RITIMER of a host build */
+LPC_RITIMER_T *SdmmcSim_GetRit(void)
+{
+	SimRit.COUNTER = SdmmcSim_GetCycles();
+	return &SimRit;
+}
+
+/* Map a pointer to the 32-bit address the DMA of the block is given */
+uint32_t SdmmcSim_BusAddr(const volatile void *ptr)
+{
+	uintptr_t base = (uintptr_t) ptr & ~(((uintptr_t) 1 << SIM_BUS_REGION_BITS) - 1);
+	uint32_t region;
+
+	if (ptr == NULL) {
+		return 0;
+	}
+	for (region = 1; region < SIM_BUS_REGIONS; region++) {
+		if (SimBusRegion[region] == 0) {
+			/* the driver and its interrupt handler may race for a free slot */
+			__sync_bool_compare_and_swap(&SimBusRegion[region], 0, base | 1);
+		}
+		if (SimBusRegion[region] == (base | 1)) {
+			return (region << SIM_BUS_REGION_BITS) | (uint32_t) ((uintptr_t) ptr - base);
+		}
+	}
+	fprintf(stderr, "sdmmc_sim: more than %d memory regions handed to the DMA\n", SIM_BUS_REGIONS - 1);
+	abort();
+}
+
+/* Map a bus address back to the pointer it was made from */
+void *SdmmcSim_BusPtr(uint32_t addr)
+{
+	uintptr_t base = SimBusRegion[addr >> SIM_BUS_REGION_BITS] & ~(uintptr_t) 1;
+
+	if (base == 0) {
+		return NULL;
+	}
+	return (void *) (base + (addr & (((uint32_t) 1 << SIM_BUS_REGION_BITS) - 1)));
+}
+
+/* Clock calls of the driver, answered with the base clock of the model */
+void Chip_Clock_EnableOpts(CHIP_CCU_CLK_T clk, bool autoen, bool wakeupen, int div)
+{}
+
+void Chip_Clock_Disable(CHIP_CCU_CLK_T clk)
+{}
+
+uint32_t Chip_Clock_GetRate(CHIP_CCU_CLK_T clk)
+{
+	return SimCfg.BaseClock;
+}
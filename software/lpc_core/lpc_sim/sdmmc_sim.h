@@ -0,0 +1,225 @@
+/*
+ * @brief Host model of the SD/MMC controller and of a card, to run the SD driver off target
+ *
+ * @note
+ * Copyright(C) NXP Semiconductors, 2012
+ * All rights reserved.
+ *
+ * @par
+ * Software that is described herein is for illustrative purposes only
+ * which provides customers with programming information regarding the
+ * LPC products.  This software is supplied "AS IS" without any warranties of
+ * any kind, and NXP Semiconductors and its licensor disclaim any and
+ * all warranties, express or implied, including all implied warranties of
+ * merchantability, fitness for a particular purpose and non-infringement of
+ * intellectual property rights.  NXP Semiconductors assumes no responsibility
+ * or liability for the use of the software, conveys no license or rights under any
+ * patent, copyright, mask work right, or any other intellectual property rights in
+ * or to any products. NXP Semiconductors reserves the right to make changes
+ * in the software without notification. NXP Semiconductors also makes no
+ * representation or warranty that such application will be suitable for the
+ * specified use without further testing or modification.
+ *
+ * @par
+ * Permission to use, copy, modify, and distribute this software and its
+ * documentation is hereby granted, under NXP Semiconductors' and its
+ * licensor's relevant copyrights in the software, without fee, provided that it
+ * is used in conjunction with NXP Semiconductors microcontrollers.  This
+ * copyright, permission, and disclaimer notice must appear in all copies of
+ * this code.
+ */
+
+#ifndef __SDMMC_SIM_H_
+#define __SDMMC_SIM_H_
+
+#include "chip.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @defgroup SDMMC_SIM SIM: SD/MMC controller and card model
+ * The model stands for the SDIO block and the card in its slot, so that sdmmc_18xx_43xx.c and
+ * sdmmc_001.c run unchanged on a Linux host: command sequencing, IDMAC descriptor chains, interrupts
+ * and bus timing. The card is an SD or MMC state machine backed by an image file.
+ *
+ * Build the driver with this file and a test program, not with clock_18xx_43xx.c (the clock calls
+ * of the driver are answered here):
+ *	- -DSDMMC_SIM: sdmmc_001.c passes the write-1-to-clear status writes to SdmmcSim_Clear(), the
+ *	  addresses given to the DMA through SdmmcSim_BusAddr(), its polling loops yield with SdmmcSim_Yield()
+ *	  and the statistics read SdmmcSim_GetCycles() instead of the DWT cycle counter. LPC_SDMMC and
+ *	  LPC_RITIMER of chip_lpc18xx.h are the register block and a RI timer of the model, so application
+ *	  code using them builds unchanged
+ *	- -lpthread
+ *
+ * prj/sim/Makefile builds it that way with the sdmmc_sim_test program. Any 32 or 64-bit Linux host will
+ * do: SdmmcSim_BusAddr() maps host memory into the 32-bit address space of the descriptors, in regions of
+ * 2^29 bytes. A buffer must not straddle a region boundary, which the driver buffers never come near.
+ *
+ * SdmmcSim_Start() returns the register block, the pSDMMC of all the driver calls. The model runs in a
+ * thread of its own and watches the registers as the block would: a command is taken when its start bit
+ * is written, the data moves by the descriptors at the bus rate set in CLKDIV/CTYPE/UHS_REG. The SDIO
+ * interrupt is the SDMMC_SIM_IRQ_SIGNAL sent to the thread that started the model, its handler runs the
+ * function of SdmmcSim_SetIrqHandler() between two instructions of the code it interrupts, like the core
+ * does. Where the target enables and disables SDIO_IRQn in the NVIC, the test program calls
+ * SdmmcSim_EnableIrq().
+ *
+ * The card checks the bus mode: data moved with a bus width, DDR setting or clock the card is not set
+ * for ends with a data CRC error, as on a board.
+ * @{
+ */
+
+/** Signal standing for the SDIO interrupt */
+#ifndef SDMMC_SIM_IRQ_SIGNAL
+#define SDMMC_SIM_IRQ_SIGNAL    SIGUSR1
+#endif
+
+/** Card types */
+#define SDMMC_SIM_SDSC          0			/*!< SD up to 2GB, byte addresses */
+#define SDMMC_SIM_SDHC          1			/*!< SDHC/SDXC, block addresses */
+#define SDMMC_SIM_MMC           2			/*!< MMC 4.x / eMMC, block addresses */
+
+/** @brief Model setup, times in usec
+ */
+typedef struct {
+	const char *Image;				/*!< Image file of the card data, its size gives the card size */
+	uint32_t Type;					/*!< SDMMC_SIM_* */
+	uint32_t BaseClock;				/*!< SDIO base clock in Hz, also returned by Chip_Clock_GetRate() */
+	uint32_t CmdLatency;			/*!< From a command to its response (NCR) */
+	uint32_t ReadLatency;			/*!< From a read command to its first block (NAC) */
+	uint32_t WriteBusy;				/*!< DAT0 busy after the blocks of a write */
+	uint32_t WriteBusyBlock;		/*!< More busy time for each block written */
+	uint32_t SwitchBusy;			/*!< Busy after an MMC switch (CMD6) or an erase */
+	uint32_t InitPolls;				/*!< ACMD41/CMD1 answered busy before the card is ready */
+	uint8_t HighSpeed;				/*!< SD high speed (CMD6), MMC 52MHz */
+	uint8_t Ddr;					/*!< MMC DDR52 */
+	uint8_t Cmd23;					/*!< SD: CMD23 support in the SCR */
+	uint8_t MmcRev;					/*!< MMC EXT_CSD_REV, 6 (4.5) for the cache and the packed writes */
+	uint8_t WriteProtect;			/*!< Write protect switch of the slot */
+} SDMMC_SIM_CFG_T;
+
+/** @brief Model counters
+ */
+typedef struct {
+	uint32_t Commands;				/*!< Commands taken, auto-stops included */
+	uint32_t AppCommands;			/*!< Of which ACMDs */
+	uint32_t BlocksRead;
+	uint32_t BlocksWritten;
+	uint32_t Descriptors;			/*!< DMA descriptors given back to the driver */
+	uint32_t CrcErrors;				/*!< Data moved with a bus mode the card was not set for */
+	uint32_t Overlaps;				/*!< Commands posted while the CIU was busy (MCI_INT_HLE) */
+	uint64_t BusUs;					/*!< Time data moved on the bus */
+	uint64_t BusyUs;				/*!< Time the card held DAT0 busy */
+} SDMMC_SIM_STATS_T;
+
+/**
+ * @brief	Start the model
+ * @param	pCfg	: Card and timing setup, copied
+ * @return	Register block to pass to the driver, NULL when the image cannot be opened
+ * The calling thread is the core the SDIO interrupt is sent to.
+ */
+LPC_SDMMC_T *SdmmcSim_Start(const SDMMC_SIM_CFG_T *pCfg);
+
+/**
+ * @brief	Stop the model and close the image
+ * @return	Nothing
+ */
+void SdmmcSim_Stop(void);
+
+/**
+ * @brief	Set the SDIO interrupt handler
+ * @param	func	: Handler, SDIO_IRQHandler() of the target
+ * @return	Nothing
+ */
+void SdmmcSim_SetIrqHandler(void (*func)(void));
+
+/**
+ * @brief	Enable or disable the SDIO interrupt, NVIC_EnableIRQ/NVIC_DisableIRQ(SDIO_IRQn) of the target
+ * @param	enable	: !0 to enable
+ * @return	Nothing
+ */
+void SdmmcSim_EnableIrq(int32_t enable);
+
+/**
+ * @brief	Write to a write-1-to-clear status register of the block
+ * @param	reg		: Register
+ * @param	bits	: Bits to clear
+ * @return	Nothing
+ */
+void SdmmcSim_Clear(volatile uint32_t *reg, uint32_t bits);
+
+/**
+ * @brief	Give the model thread the CPU for a polling period, MCI_POLL_YIELD() of the driver
+ * @return	Nothing
+ */
+void SdmmcSim_Yield(void);
+
+/**
+ * @brief	Power the card off and on, it is back in idle state for Chip_SDMMC_Acquire()
+ * @return	Nothing
+ * A warm reset of the target keeps the card powered: the model is left as it is for Chip_SDMMC_Reacquire().
+ */
+void SdmmcSim_PowerCycle(void);
+
+/**
+ * @brief	Make the next command with an index end with error interrupts
+ * @param	index	: Command index, e.g. MMC_READ_MULTIPLE_BLOCK
+ * @param	status	: MCI_INT_* errors to raise, MCI_INT_RTO for a card that does not answer
+ * @return	Nothing
+ */
+void SdmmcSim_InjectError(uint32_t index, uint32_t status);
+
+/**
+ * @brief	Get the model counters
+ * @param	stats	: Filled with the counters since SdmmcSim_Start()
+ * @return	Nothing
+ */
+void SdmmcSim_GetStats(SDMMC_SIM_STATS_T *stats);
+
+/**
+ * @brief	Get the model time
+ * @return	usec, the time base of the latencies (for the msdelay_func of the card)
+ */
+uint64_t SdmmcSim_GetTimeUs(void);
+
+/**
+ * @brief	Get the cycle counter, DWT->CYCCNT of a core clocked by the SDIO base clock
+ * @return	Cycles since SdmmcSim_Start(), wraps at 32 bits
+ */
+uint32_t SdmmcSim_GetCycles(void);
+
+/**
+ * @brief	Get the register block of the model, what LPC_SDMMC stands for with -DSDMMC_SIM
+ * @return	Register block, the one SdmmcSim_Start() returns
+ */
+LPC_SDMMC_T *SdmmcSim_GetRegs(void);
+
+/**
+ * @brief	Get the RI timer, what LPC_RITIMER stands for with -DSDMMC_SIM
+ * @return	Timer whose COUNTER is SdmmcSim_GetCycles() when read, set SystemCoreClock to the base clock
+ */
+LPC_RITIMER_T *SdmmcSim_GetRit(void);
+
+/**
+ * @brief	Map a buffer or descriptor pointer to the address the DMA is given
+ * @param	ptr		: Host pointer, NULL maps to 0
+ * @return	32-bit bus address, the model aborts when host memory spans too many regions
+ */
+uint32_t SdmmcSim_BusAddr(const volatile void *ptr);
+
+/**
+ * @brief	Map a bus address back to a host pointer
+ * @param	addr	: Address from SdmmcSim_BusAddr(), or an offset from one
+ * @return	Host pointer, NULL for 0
+ */
+void *SdmmcSim_BusPtr(uint32_t addr);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SDMMC_SIM_H_ */